@@ -1,6 +1,7 @@
 #ifndef FEATURE_TRACKING_FEATURE_DETECTION_EXTRACTION_H_
 #define FEATURE_TRACKING_FEATURE_DETECTION_EXTRACTION_H_
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -15,6 +16,7 @@
 #include <opencv2/video/tracking.hpp>
 
 #include "feature-tracking/feature-tracking-types.h"
+#include "feature-tracking/image-pyramid.h"
 
 namespace feature_tracking {
 
@@ -25,6 +27,15 @@ class FeatureDetectorExtractor {
   void detectAndExtractFeatures(aslam::VisualFrame* frame) const;
   cv::Ptr<cv::DescriptorExtractor> getExtractorPtr() const;
 
+  // Pyramid of the image of the last frame passed to detectAndExtractFeatures,
+  // only built if the image pyramid cache is used.
+  const ImagePyramid& getImagePyramid() const {
+    return *CHECK_NOTNULL(image_pyramid_.get());
+  }
+  bool usesImagePyramidCache() const {
+    return use_image_pyramid_cache_;
+  }
+
  private:
   void initialize();
 
@@ -47,6 +58,13 @@ class FeatureDetectorExtractor {
   cv::Ptr<cv::FeatureDetector> detector_;
   cv::Ptr<cv::DescriptorExtractor> extractor_;
 
+  // Single level detectors for every level of the image pyramid.
+  std::vector<cv::Ptr<cv::FeatureDetector>> pyramid_level_detectors_;
+  bool use_image_pyramid_cache_;
+  // Rebuilt for every frame in reused buffers. Detection and extraction of
+  // one camera run sequentially, hence the pyramid isn't guarded.
+  std::unique_ptr<ImagePyramid> image_pyramid_;
+
  public:
   // Descriptor extractor settings are stored in this struct.
   const SweFeatureTrackingExtractorSettings extractor_settings_;
@@ -1,7 +1,8 @@
 #ifndef FEATURE_TRACKING_GRIDED_DETECTOR_H_
 #define FEATURE_TRACKING_GRIDED_DETECTOR_H_
 #include <algorithm>
-#include <array>
+#include <cmath>
+#include <mutex>
 #include <vector>
 
 #include <aslam/frames/visual-frame.h>
@@ -10,10 +11,19 @@
 #include <maplab-common/threading-helpers.h>
 #include <opencv2/core/version.hpp>
 #include <opencv2/features2d.hpp>
+#include <opencv2/imgproc.hpp>
 #include <opencv2/xfeatures2d.hpp>
 
+#include "feature-tracking/feature-tracking-types.h"
+#include "feature-tracking/image-pyramid.h"
+
 namespace feature_tracking {
 
+// Removes all keypoints for which another keypoint within the given radius
+// has a response that is larger by more than a factor of 1 / ratio_threshold.
+// The keypoints are bucketed into a grid with cells at least as large as the
+// radius, such that only the keypoints in the 3x3 neighboring cells of a
+// keypoint need to be tested. The order of the remaining keypoints is kept.
 // TODO(magehrig): Local non-maximum suppression only on octave level for
 //                 improved scale invariance.
 inline void localNonMaximumSuppression(
@@ -25,111 +35,105 @@ inline void localNonMaximumSuppression(
   CHECK_LE(ratio_threshold, 1.0f);
   CHECK_GT(image_height, 0u);
 
-  if (keypoints->empty()) {
+  const size_t num_keypoints = keypoints->size();
+  if (num_keypoints < 2u) {
     return;
   }
 
-  const float radius_sq = radius * radius;
-  const size_t num_keypoints = keypoints->size();
+  float min_x = (*keypoints)[0].pt.x;
+  float max_x = min_x;
+  float min_y = (*keypoints)[0].pt.y;
+  float max_y = min_y;
+  for (const cv::KeyPoint& keypoint : *keypoints) {
+    min_x = std::min(min_x, keypoint.pt.x);
+    max_x = std::max(max_x, keypoint.pt.x);
+    min_y = std::min(min_y, keypoint.pt.y);
+    max_y = std::max(max_y, keypoint.pt.y);
+  }
+
+  // Cells larger than the radius keep the grid at O(num_keypoints) cells for
+  // small radii, the 3x3 neighborhood still covers the full radius.
+  const float extent_x = max_x - min_x;
+  const float extent_y = max_y - min_y;
+  const float cell_size = std::max(
+      {radius, std::sqrt(extent_x * extent_y / num_keypoints),
+       std::max(extent_x, extent_y) / num_keypoints});
+  const float inverse_cell_size = 1.0f / cell_size;
+  const int num_cols = static_cast<int>(extent_x * inverse_cell_size) + 1;
+  const int num_rows = static_cast<int>(extent_y * inverse_cell_size) + 1;
 
   struct KeyPointData {
-    KeyPointData(const cv::KeyPoint& keypoint, const size_t _keypoint_index)
-        : coordinates{keypoint.pt.x, keypoint.pt.y},  // NOLINT
-          response(keypoint.response),
-          keypoint_index(_keypoint_index) {}
-    std::array<float, 2> coordinates;
+    float x;
+    float y;
     float response;
     size_t keypoint_index;
   };
 
-  typedef std::vector<KeyPointData>::const_iterator KeyPointDataIterator;
-
-  std::function<bool(const KeyPointData&, KeyPointDataIterator)>  // NOLINT
-      IsInsideCircle = [radius_sq](
-          const KeyPointData& keypoint_1,
-          KeyPointDataIterator keypoint_iterator_2) -> bool {
-    const float x_diff =
-        keypoint_1.coordinates[0] - keypoint_iterator_2->coordinates[0];
-    const float y_diff =
-        keypoint_1.coordinates[1] - keypoint_iterator_2->coordinates[1];
-    return (x_diff * x_diff + y_diff * y_diff) < radius_sq;
-  };
-
-  std::function<size_t(const int, const int, const int)> Clamp =
-      [](  // NOLINT
-          const int lower, const int upper, const int in) -> size_t {
-    return std::min<int>(std::max<int>(in, lower), upper);
-  };
-
-  std::vector<KeyPointData> keypoint_data_vector;
-  keypoint_data_vector.reserve(num_keypoints);
+  // Counting sort of the keypoints by cell, cell_begin[i] is the index of the
+  // first keypoint in cell i.
+  std::vector<int> keypoint_cells(num_keypoints);
+  std::vector<size_t> cell_begin(num_rows * num_cols + 1, 0u);
   for (size_t i = 0u; i < num_keypoints; ++i) {
-    keypoint_data_vector.emplace_back((*keypoints)[i], i);
+    const cv::Point2f& point = (*keypoints)[i].pt;
+    const int col = std::min(
+        static_cast<int>((point.x - min_x) * inverse_cell_size), num_cols - 1);
+    const int row = std::min(
+        static_cast<int>((point.y - min_y) * inverse_cell_size), num_rows - 1);
+    keypoint_cells[i] = row * num_cols + col;
+    ++cell_begin[keypoint_cells[i] + 1];
   }
-
-  // Create LUT of keypoints in y axis.
-  std::sort(
-      keypoint_data_vector.begin(), keypoint_data_vector.end(),
-      [](const KeyPointData& lhs, const KeyPointData& rhs) -> bool {
-        return lhs.coordinates[1] < rhs.coordinates[1];
-      });
-
-  std::vector<size_t> corner_row_LUT;
-  corner_row_LUT.reserve(image_height);
-
-  size_t num_kpts_below_y = 0u;
-  for (size_t y = 0u; y < image_height; ++y) {
-    while (num_kpts_below_y < num_keypoints &&
-           y > keypoint_data_vector[num_kpts_below_y].coordinates[1]) {
-      ++num_kpts_below_y;
+  for (size_t cell_idx = 1u; cell_idx < cell_begin.size(); ++cell_idx) {
+    cell_begin[cell_idx] += cell_begin[cell_idx - 1u];
+  }
+  std::vector<KeyPointData> bucketed_keypoints(num_keypoints);
+  {
+    std::vector<size_t> cell_end(cell_begin.begin(), cell_begin.end() - 1);
+    for (size_t i = 0u; i < num_keypoints; ++i) {
+      const cv::KeyPoint& keypoint = (*keypoints)[i];
+      bucketed_keypoints[cell_end[keypoint_cells[i]]++] = {
+          keypoint.pt.x, keypoint.pt.y, keypoint.response, i};
     }
-    corner_row_LUT.push_back(num_kpts_below_y);
   }
-  CHECK_EQ(num_kpts_below_y, keypoint_data_vector.size());
 
-  // Create a list of keypoints to reject.
+  // A keypoint is suppressed if any keypoint within the radius has a response
+  // above its own response divided by the ratio threshold.
+  const float radius_sq = radius * radius;
   std::vector<bool> erase_keypoints(num_keypoints, false);
-
   for (size_t i = 0u; i < num_keypoints; ++i) {
-    const KeyPointData& current_keypoint_data = keypoint_data_vector[i];
-    const size_t y_top = Clamp(
-        0, static_cast<int>(image_height - 1),
-        std::floor(current_keypoint_data.coordinates[1] - radius));
-    const size_t y_bottom = Clamp(
-        0, static_cast<int>(image_height - 1),
-        std::ceil(current_keypoint_data.coordinates[1] + radius));
-    CHECK_LT(y_top, image_height);
-    CHECK_LE(y_bottom, image_height);
-
-    CHECK_LT(corner_row_LUT[y_top], keypoint_data_vector.size());
-    CHECK_LE(corner_row_LUT[y_bottom], keypoint_data_vector.size());
-    KeyPointDataIterator nearest_corners_begin =
-        keypoint_data_vector.begin() + corner_row_LUT[y_top];
-    KeyPointDataIterator nearest_corners_end =
-        keypoint_data_vector.begin() + corner_row_LUT[y_bottom];
-
-    for (KeyPointDataIterator it = nearest_corners_begin;
-         it != nearest_corners_end; ++it) {
-      if (it->keypoint_index == current_keypoint_data.keypoint_index ||
-          erase_keypoints[it->keypoint_index] ||
-          !IsInsideCircle(current_keypoint_data, it)) {
-        continue;
-      }
-      const float response_threshold =
-          ratio_threshold * current_keypoint_data.response;
-      if (response_threshold > it->response) {
-        erase_keypoints[it->keypoint_index] = true;
+    const KeyPointData& keypoint = bucketed_keypoints[i];
+    const int cell_idx = keypoint_cells[keypoint.keypoint_index];
+    const int row = cell_idx / num_cols;
+    const int col = cell_idx - row * num_cols;
+    const int col_begin = std::max(col - 1, 0);
+    const int col_end = std::min(col + 1, num_cols - 1);
+
+    bool is_suppressed = false;
+    for (int neighbor_row = std::max(row - 1, 0);
+         !is_suppressed && neighbor_row <= std::min(row + 1, num_rows - 1);
+         ++neighbor_row) {
+      // The cells of a row range are contiguous in the bucketed keypoints.
+      const size_t begin = cell_begin[neighbor_row * num_cols + col_begin];
+      const size_t end = cell_begin[neighbor_row * num_cols + col_end + 1];
+      for (size_t j = begin; j < end; ++j) {
+        const KeyPointData& neighbor = bucketed_keypoints[j];
+        const float x_diff = keypoint.x - neighbor.x;
+        const float y_diff = keypoint.y - neighbor.y;
+        if (j != i && x_diff * x_diff + y_diff * y_diff < radius_sq &&
+            ratio_threshold * neighbor.response > keypoint.response) {
+          is_suppressed = true;
+          break;
+        }
       }
     }
+    erase_keypoints[keypoint.keypoint_index] = is_suppressed;
   }
 
-  // Remove the flaged non-maximum keypoints.
-  std::vector<bool>::iterator it_erase = erase_keypoints.begin();
-
+  // Remove the flagged non-maximum keypoints.
+  std::vector<bool>::const_iterator it_erase = erase_keypoints.begin();
   std::vector<cv::KeyPoint>::iterator it_erase_from = std::remove_if(
       keypoints->begin(), keypoints->end(),
       [&it_erase](const cv::KeyPoint & /*keypoint*/) -> bool {
-        return *it_erase++ == true;
+        return *it_erase++;
       });
   keypoints->erase(it_erase_from, keypoints->end());
 }
@@ -204,6 +208,140 @@ inline void detectKeypointsGrided(
   cv::KeyPointsFilter::retainBest(*keypoints, max_total_keypoints);
 }
 
+// Creates a single level ORB detector for every level of the pyramid that the
+// ORB detector with the given settings would build. The features are
+// distributed over the levels in the same way as the ORB detector does, i.e.
+// proportional to the area of the level.
+inline void createPyramidLevelOrbDetectors(
+    const SweFeatureTrackingDetectorSettings& detector_settings,
+    int edge_threshold,
+    std::vector<cv::Ptr<cv::FeatureDetector>>* level_detectors) {
+  CHECK_NOTNULL(level_detectors)->clear();
+  const int num_levels = detector_settings.orb_detector_pyramid_levels;
+  const int num_features = detector_settings.orb_detector_number_features;
+  const float factor = 1.0f / detector_settings.orb_detector_scale_factor;
+  float num_desired_features_per_level =
+      num_features * (1.0f - factor) /
+      (1.0f - std::pow(factor, static_cast<float>(num_levels)));
+  int num_assigned_features = 0;
+  for (int level = 0; level < num_levels; ++level) {
+    int num_level_features = 0;
+    if (level < num_levels - 1) {
+      num_level_features = cvRound(num_desired_features_per_level);
+      num_desired_features_per_level *= factor;
+    } else {
+      num_level_features = std::max(num_features - num_assigned_features, 0);
+    }
+    num_assigned_features += num_level_features;
+    level_detectors->emplace_back(cv::ORB::create(
+        num_level_features, detector_settings.orb_detector_scale_factor,
+        /*nlevels=*/1, edge_threshold, /*firstLevel=*/0,
+        detector_settings.orb_detector_WTA_K,
+        detector_settings.orb_detector_score_type,
+        detector_settings.orb_detector_patch_size,
+        detector_settings.orb_detector_fast_threshold));
+  }
+}
+
+// Same as detectKeypointsGrided but runs a single level detector per level of
+// an already built image pyramid instead of letting the detector build its own
+// pyramid for every grid cell. level_detectors[i] detects on level i, the
+// keypoints are returned in level 0 coordinates with the octave set to the
+// level they were detected on. The detection mask has the size of level 0 and
+// is downscaled to every level with nearest neighbor interpolation, like the
+// ORB detector does with the mask of its own pyramid.
+inline void detectKeypointsGridedOnPyramid(
+    const std::vector<cv::Ptr<cv::FeatureDetector>>& level_detectors,
+    const ImagePyramid& image_pyramid, const cv::Mat& detection_mask,
+    size_t max_total_keypoints, float nonmaxsuppression_radius,
+    float nonmaxsuppression_ratio_threshold, size_t grid_rows,
+    size_t grid_cols, std::vector<cv::KeyPoint>* keypoints) {
+  CHECK_NOTNULL(keypoints)->clear();
+  CHECK_GE(grid_rows, 1u);
+  CHECK_GE(grid_cols, 1u);
+  CHECK_EQ(level_detectors.size(), image_pyramid.getNumLevels());
+
+  const cv::Mat& image = image_pyramid.getLevel(0u);
+  if (image.empty() || max_total_keypoints < grid_rows * grid_cols) {
+    return;
+  }
+  keypoints->reserve(max_total_keypoints);
+
+  // Only allocates if a mask is given.
+  std::vector<cv::Mat> level_masks;
+  if (!detection_mask.empty()) {
+    CHECK_EQ(detection_mask.size(), image.size());
+    level_masks.resize(level_detectors.size());
+    level_masks[0u] = detection_mask;
+    for (size_t level = 1u; level < level_masks.size(); ++level) {
+      cv::resize(
+          detection_mask, level_masks[level],
+          image_pyramid.getLevel(level).size(), 0.0, 0.0, cv::INTER_NEAREST);
+    }
+  }
+
+  std::mutex m_keypoints;
+  auto detectFeaturesOfGridCells = [&](const std::vector<size_t>& range) {
+    std::vector<cv::KeyPoint> level_keypoints;
+    for (int cell_idx : range) {
+      int celly = cell_idx / grid_cols;
+      int cellx = cell_idx - celly * grid_cols;
+
+      std::vector<cv::KeyPoint> sub_keypoints;
+      for (size_t level = 0u; level < level_detectors.size(); ++level) {
+        const cv::Mat& level_image = image_pyramid.getLevel(level);
+        const float scale = image_pyramid.getScale(level);
+
+        cv::Range row_range(
+            (celly * level_image.rows) / grid_rows,
+            ((celly + 1) * level_image.rows) / grid_rows);
+        cv::Range col_range(
+            (cellx * level_image.cols) / grid_cols,
+            ((cellx + 1) * level_image.cols) / grid_cols);
+        if (row_range.size() <= 0 || col_range.size() <= 0) {
+          continue;
+        }
+
+        cv::Mat sub_mask;
+        if (!level_masks.empty()) {
+          sub_mask = level_masks[level](row_range, col_range);
+        }
+
+        level_keypoints.clear();
+        level_detectors[level]->detect(
+            level_image(row_range, col_range), level_keypoints, sub_mask);
+
+        for (cv::KeyPoint& keypoint : level_keypoints) {
+          keypoint.pt.x = (keypoint.pt.x + col_range.start) * scale;
+          keypoint.pt.y = (keypoint.pt.y + row_range.start) * scale;
+          keypoint.size *= scale;
+          keypoint.octave = static_cast<int>(level);
+        }
+        sub_keypoints.insert(
+            sub_keypoints.end(), level_keypoints.begin(),
+            level_keypoints.end());
+      }
+
+      if (nonmaxsuppression_radius > 0.0) {
+        localNonMaximumSuppression(
+            image.rows, nonmaxsuppression_radius,
+            nonmaxsuppression_ratio_threshold, &sub_keypoints);
+      }
+
+      std::unique_lock<std::mutex> lock(m_keypoints);
+      keypoints->insert(
+          keypoints->end(), sub_keypoints.begin(), sub_keypoints.end());
+    }
+  };
+
+  const size_t num_cells = grid_rows * grid_cols;
+  const size_t num_threads = std::max(size_t(1u), num_cells / 2u);
+  common::ParallelProcess(
+      num_cells, detectFeaturesOfGridCells, /*kAlwaysParallelize=*/true,
+      num_threads);
+  cv::KeyPointsFilter::retainBest(*keypoints, max_total_keypoints);
+}
+
 }  // namespace feature_tracking
 
 #endif  // FEATURE_TRACKING_GRIDED_DETECTOR_H_
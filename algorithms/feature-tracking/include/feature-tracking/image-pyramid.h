@@ -0,0 +1,46 @@
+#ifndef FEATURE_TRACKING_IMAGE_PYRAMID_H_
+#define FEATURE_TRACKING_IMAGE_PYRAMID_H_
+
+#include <vector>
+
+#include <glog/logging.h>
+#include <opencv2/core/core.hpp>
+
+namespace feature_tracking {
+
+// Image pyramid of a frame that is built once and then shared by everything
+// that works on the frame at multiple scales. Level 0 references the input
+// image without copying it, every further level is downscaled from the
+// previous one by the scale factor. The buffers of the levels are reused
+// when the pyramid is rebuilt for an image of the same size and type, hence
+// building the pyramid doesn't allocate in steady state.
+class ImagePyramid {
+ public:
+  ImagePyramid(const size_t num_levels, const float scale_factor);
+
+  void build(const cv::Mat& image);
+
+  size_t getNumLevels() const {
+    return levels_.size();
+  }
+
+  const cv::Mat& getLevel(const size_t level) const {
+    CHECK_LT(level, levels_.size());
+    return levels_[level];
+  }
+
+  // Scale of the given level w.r.t. level 0, i.e. the factor that converts
+  // pixel coordinates of the level to level 0.
+  float getScale(const size_t level) const {
+    CHECK_LT(level, scales_.size());
+    return scales_[level];
+  }
+
+ private:
+  std::vector<cv::Mat> levels_;
+  std::vector<float> scales_;
+};
+
+}  // namespace feature_tracking
+
+#endif  // FEATURE_TRACKING_IMAGE_PYRAMID_H_
@@ -29,6 +29,12 @@ class VOFeatureTrackingPipeline : public FeatureTrackingPipeline {
       aslam::FrameToFrameMatchesList* inlier_matches_kp1_k,
       aslam::FrameToFrameMatchesList* outlier_matches_kp1_k);
 
+  /// Number of nframes for which detection and tracking took longer than
+  /// the latency budget given by the flags.
+  size_t getNumNFramesOverLatencyBudget() const {
+    return num_nframes_over_latency_budget_;
+  }
+
  private:
   virtual void initialize(const aslam::NCamera::ConstPtr& ncamera) override;
   virtual void trackFeaturesNFrame(
@@ -56,6 +62,7 @@ class VOFeatureTrackingPipeline : public FeatureTrackingPipeline {
   std::unique_ptr<aslam::ThreadPool> thread_pool_;
 
   bool has_feature_extraction_been_performed_on_first_nframe_;
+  size_t num_nframes_over_latency_budget_;
 };
 }  // namespace feature_tracking
 
@@ -16,6 +16,12 @@
 #include "feature-tracking/grided-detector.h"
 
 DEFINE_bool(use_grided_detections, true, "Use multiple detectors on a grid?");
+DEFINE_bool(
+    swe_feature_tracking_detector_use_image_pyramid_cache, false,
+    "Build the image pyramid of a frame once and detect on its levels instead "
+    "of building a pyramid for every grid cell. Only used for grided "
+    "detections. Compare BM_GridedDetection and "
+    "BM_GridedDetectionOnPyramidCache before enabling it by default.");
 
 namespace feature_tracking {
 
@@ -48,6 +54,21 @@ void FeatureDetectorExtractor::initialize() {
       detector_settings_.orb_detector_patch_size,
       detector_settings_.orb_detector_fast_threshold);
 
+  // The ORB detector builds its pyramid starting at the first level, the
+  // cached pyramid always starts at the raw image.
+  use_image_pyramid_cache_ =
+      FLAGS_use_grided_detections &&
+      FLAGS_swe_feature_tracking_detector_use_image_pyramid_cache &&
+      detector_settings_.orb_detector_first_level == 0;
+  image_pyramid_.reset(new ImagePyramid(
+      detector_settings_.orb_detector_pyramid_levels,
+      detector_settings_.orb_detector_scale_factor));
+  if (use_image_pyramid_cache_) {
+    createPyramidLevelOrbDetectors(
+        detector_settings_, orb_detector_edge_threshold,
+        &pyramid_level_detectors_);
+  }
+
   switch (extractor_settings_.descriptor_type) {
     case SweFeatureTrackingExtractorSettings::DescriptorType::kBrisk:
       extractor_ = new brisk::BriskDescriptorExtractor(
@@ -91,12 +112,24 @@ void FeatureDetectorExtractor::detectAndExtractFeatures(
     // the image.
     constexpr size_t kNumGridCols = 3;
     constexpr size_t kNumGridRows = 2;
-    detectKeypointsGrided(
-        detector_, image, /*detection_mask=*/cv::Mat(),
-        detector_settings_.max_feature_count,
-        detector_settings_.detector_nonmaxsuppression_radius,
-        detector_settings_.detector_nonmaxsuppression_ratio_threshold,
-        kNumGridCols, kNumGridRows, &keypoints_cv);
+    if (use_image_pyramid_cache_) {
+      timing::Timer timer_pyramid("image pyramid");
+      image_pyramid_->build(image);
+      timer_pyramid.Stop();
+      detectKeypointsGridedOnPyramid(
+          pyramid_level_detectors_, *image_pyramid_,
+          /*detection_mask=*/cv::Mat(), detector_settings_.max_feature_count,
+          detector_settings_.detector_nonmaxsuppression_radius,
+          detector_settings_.detector_nonmaxsuppression_ratio_threshold,
+          kNumGridCols, kNumGridRows, &keypoints_cv);
+    } else {
+      detectKeypointsGrided(
+          detector_, image, /*detection_mask=*/cv::Mat(),
+          detector_settings_.max_feature_count,
+          detector_settings_.detector_nonmaxsuppression_radius,
+          detector_settings_.detector_nonmaxsuppression_ratio_threshold,
+          kNumGridCols, kNumGridRows, &keypoints_cv);
+    }
   } else {
     detector_->detect(image, keypoints_cv);
 
@@ -286,6 +286,8 @@ void FeatureTrackingPipeline::runTrackingAndTriangulationForMission(
         map->getVertex_T_G_I(vertex_id_kp1);
     trackFeaturesNFrame(T_Ik_Ikp1, nframe_k.get(), nframe_kp1.get());
 
+    // The observations are reset directly on the vertices.
+    map->dropCovisibilityGraph();
     if (!processed_first_nframe_) {
       map->getVertex(vertex_id_k).resetObservedLandmarkIdsToInvalid();
       extractAndTriangulateTerminatedFeatureTracks(nframe_k, map);
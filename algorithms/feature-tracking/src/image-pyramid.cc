@@ -0,0 +1,32 @@
+#include "feature-tracking/image-pyramid.h"
+
+#include <cmath>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+namespace feature_tracking {
+
+ImagePyramid::ImagePyramid(const size_t num_levels, const float scale_factor)
+    : levels_(num_levels), scales_(num_levels) {
+  CHECK_GT(num_levels, 0u);
+  CHECK_GT(scale_factor, 1.0f);
+  for (size_t level = 0u; level < num_levels; ++level) {
+    scales_[level] = std::pow(scale_factor, static_cast<float>(level));
+  }
+}
+
+void ImagePyramid::build(const cv::Mat& image) {
+  CHECK(!image.empty());
+  levels_[0] = image;
+  for (size_t level = 1u; level < levels_.size(); ++level) {
+    const cv::Size level_size(
+        cvRound(image.cols / scales_[level]),
+        cvRound(image.rows / scales_[level]));
+    // Resizing into a buffer of the same size and type doesn't reallocate it.
+    cv::resize(
+        levels_[level - 1u], levels_[level], level_size, 0.0, 0.0,
+        cv::INTER_LINEAR);
+  }
+}
+
+}  // namespace feature_tracking
@@ -24,6 +24,11 @@ DEFINE_bool(
 DEFINE_bool(
     detection_visualize_keypoints, false,
     "Visualize the raw keypoint detections to a ros topic.");
+DEFINE_double(
+    swe_feature_tracking_nframe_latency_budget_ms, 50.0,
+    "Latency budget for detecting and tracking the features of all cameras of "
+    "an nframe. Exceeding nframes are counted and reported. 0 disables the "
+    "budget.");
 
 namespace feature_tracking {
 
@@ -68,6 +73,20 @@ void VOFeatureTrackingPipeline::trackFeaturesNFrame(
   outlier_matches_kp1_k->resize(num_cameras);
 
   CHECK(thread_pool_);
+  if (!has_feature_extraction_been_performed_on_first_nframe_) {
+    // The keypoints of the first nframe are detected and described
+    // concurrently for all cameras before any camera starts tracking.
+    for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
+      const FeatureDetectorExtractor* detector_extractor =
+          detectors_extractors_[camera_idx].get();
+      aslam::VisualFrame* frame_k = nframe_k->getFrameShared(camera_idx).get();
+      thread_pool_->enqueue([detector_extractor, frame_k]() {
+        detector_extractor->detectAndExtractFeatures(frame_k);
+      });
+    }
+    thread_pool_->waitForEmptyQueue();
+    has_feature_extraction_been_performed_on_first_nframe_ = true;
+  }
   for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
     aslam::VisualFrame* frame_kp1 =
         nframe_kp1->getFrameShared(camera_idx).get();
@@ -79,7 +98,15 @@ void VOFeatureTrackingPipeline::trackFeaturesNFrame(
   }
   thread_pool_->waitForEmptyQueue();
 
-  timer_eval.Stop();
+  const double latency_ms = timer_eval.Stop() * 1000.0;
+  if (FLAGS_swe_feature_tracking_nframe_latency_budget_ms > 0.0 &&
+      latency_ms > FLAGS_swe_feature_tracking_nframe_latency_budget_ms) {
+    ++num_nframes_over_latency_budget_;
+    VLOG(1) << "Feature tracking of nframe took " << latency_ms
+            << " ms, the latency budget is "
+            << FLAGS_swe_feature_tracking_nframe_latency_budget_ms << " ms ("
+            << num_nframes_over_latency_budget_ << " nframes over budget).";
+  }
 }
 
 void VOFeatureTrackingPipeline::trackFeaturesSingleCamera(
@@ -96,11 +123,6 @@ void VOFeatureTrackingPipeline::trackFeaturesSingleCamera(
   inlier_matches_kp1_k->clear();
   outlier_matches_kp1_k->clear();
 
-  // Initialize keypoints and descriptors in frame_k, if there aren't any.
-  if (!has_feature_extraction_been_performed_on_first_nframe_) {
-    detectors_extractors_[camera_idx]->detectAndExtractFeatures(frame_k);
-    has_feature_extraction_been_performed_on_first_nframe_ = true;
-  }
   detectors_extractors_[camera_idx]->detectAndExtractFeatures(frame_kp1);
 
   if (FLAGS_detection_visualize_keypoints) {
@@ -217,11 +239,13 @@ void VOFeatureTrackingPipeline::initialize(
 }
 
 VOFeatureTrackingPipeline::VOFeatureTrackingPipeline()
-    : has_feature_extraction_been_performed_on_first_nframe_(false) {}
+    : has_feature_extraction_been_performed_on_first_nframe_(false),
+      num_nframes_over_latency_budget_(0u) {}
 
 VOFeatureTrackingPipeline::VOFeatureTrackingPipeline(
     const aslam::NCamera::ConstPtr& ncamera)
-    : has_feature_extraction_been_performed_on_first_nframe_(false) {
+    : has_feature_extraction_been_performed_on_first_nframe_(false),
+      num_nframes_over_latency_budget_(0u) {
   initialize(ncamera);
 }
 
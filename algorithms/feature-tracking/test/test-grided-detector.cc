@@ -0,0 +1,223 @@
+#include <random>
+#include <vector>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <opencv2/core/core.hpp>
+#include <opencv2/features2d.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "feature-tracking/feature-tracking-types.h"
+#include "feature-tracking/grided-detector.h"
+#include "feature-tracking/image-pyramid.h"
+
+namespace feature_tracking {
+
+// Tests every pair of keypoints.
+void bruteForceNonMaximumSuppression(
+    const float radius, const float ratio_threshold,
+    std::vector<cv::KeyPoint>* keypoints) {
+  CHECK_NOTNULL(keypoints);
+  std::vector<cv::KeyPoint> remaining_keypoints;
+  for (size_t i = 0u; i < keypoints->size(); ++i) {
+    const cv::KeyPoint& keypoint = (*keypoints)[i];
+    bool is_suppressed = false;
+    for (size_t j = 0u; j < keypoints->size(); ++j) {
+      const cv::KeyPoint& neighbor = (*keypoints)[j];
+      const float x_diff = keypoint.pt.x - neighbor.pt.x;
+      const float y_diff = keypoint.pt.y - neighbor.pt.y;
+      is_suppressed |= i != j &&
+                       x_diff * x_diff + y_diff * y_diff < radius * radius &&
+                       ratio_threshold * neighbor.response > keypoint.response;
+    }
+    if (!is_suppressed) {
+      remaining_keypoints.push_back(keypoint);
+    }
+  }
+  keypoints->swap(remaining_keypoints);
+}
+
+TEST(GridedDetector, LocalNonMaximumSuppressionMatchesBruteForce) {
+  constexpr size_t kImageWidth = 752u;
+  constexpr size_t kImageHeight = 480u;
+  std::mt19937 random_engine(42u);
+  std::uniform_real_distribution<float> x_distribution(0.f, kImageWidth);
+  std::uniform_real_distribution<float> y_distribution(0.f, kImageHeight);
+  std::uniform_real_distribution<float> response_distribution(0.f, 100.f);
+
+  for (const size_t num_keypoints : {0u, 1u, 10u, 500u, 3000u}) {
+    for (const float radius : {0.5f, 8.f, 40.f}) {
+      std::vector<cv::KeyPoint> keypoints;
+      for (size_t i = 0u; i < num_keypoints; ++i) {
+        keypoints.emplace_back(
+            x_distribution(random_engine), y_distribution(random_engine), 31.f,
+            -1.f, response_distribution(random_engine));
+      }
+      constexpr float kRatioThreshold = 0.9f;
+      std::vector<cv::KeyPoint> expected_keypoints = keypoints;
+      bruteForceNonMaximumSuppression(
+          radius, kRatioThreshold, &expected_keypoints);
+      localNonMaximumSuppression(
+          kImageHeight, radius, kRatioThreshold, &keypoints);
+
+      ASSERT_EQ(keypoints.size(), expected_keypoints.size());
+      for (size_t i = 0u; i < keypoints.size(); ++i) {
+        EXPECT_EQ(keypoints[i].pt, expected_keypoints[i].pt);
+        EXPECT_EQ(keypoints[i].response, expected_keypoints[i].response);
+      }
+    }
+  }
+}
+
+// Blurred noise, which has corners at all scales.
+cv::Mat createTexturedImage(const int width, const int height) {
+  cv::Mat image(height, width, CV_8UC1);
+  cv::RNG random_number_generator(42u);
+  random_number_generator.fill(image, cv::RNG::UNIFORM, 0, 255);
+  cv::GaussianBlur(image, image, cv::Size(5, 5), 1.5);
+  return image;
+}
+
+TEST(GridedDetector, DetectionOnPyramidMatchesDetectionPerGridCell) {
+  constexpr size_t kNumGridRows = 2u;
+  constexpr size_t kNumGridCols = 3u;
+  const cv::Mat image = createTexturedImage(752, 480);
+  const SweFeatureTrackingDetectorSettings settings;
+  const int num_levels = settings.orb_detector_pyramid_levels;
+
+  const cv::Ptr<cv::FeatureDetector> detector = cv::ORB::create(
+      settings.orb_detector_number_features, settings.orb_detector_scale_factor,
+      num_levels, /*edgeThreshold=*/0, /*firstLevel=*/0,
+      settings.orb_detector_WTA_K, settings.orb_detector_score_type,
+      settings.orb_detector_patch_size, settings.orb_detector_fast_threshold);
+  std::vector<cv::KeyPoint> keypoints;
+  detectKeypointsGrided(
+      detector, image, /*detection_mask=*/cv::Mat(),
+      settings.max_feature_count, settings.detector_nonmaxsuppression_radius,
+      settings.detector_nonmaxsuppression_ratio_threshold, kNumGridRows,
+      kNumGridCols, &keypoints);
+
+  std::vector<cv::Ptr<cv::FeatureDetector>> level_detectors;
+  createPyramidLevelOrbDetectors(
+      settings, /*edge_threshold=*/0, &level_detectors);
+  ImagePyramid image_pyramid(num_levels, settings.orb_detector_scale_factor);
+  image_pyramid.build(image);
+  std::vector<cv::KeyPoint> pyramid_keypoints;
+  detectKeypointsGridedOnPyramid(
+      level_detectors, image_pyramid, /*detection_mask=*/cv::Mat(),
+      settings.max_feature_count, settings.detector_nonmaxsuppression_radius,
+      settings.detector_nonmaxsuppression_ratio_threshold, kNumGridRows,
+      kNumGridCols, &pyramid_keypoints);
+
+  // The levels are only interpolated differently at the borders of the grid
+  // cells, so both detect about the same keypoints. The ORB detector
+  // downscales every cell on its own, which changes the detections whose
+  // FAST circle of radius 3 crosses an interior cell border. These bands of 6
+  // level pixels along the 1712 pixels of interior borders cover 3% of level 0
+  // and up to 10% of the coarsest level, hence the 10% tolerance.
+  ASSERT_FALSE(keypoints.empty());
+  const double num_keypoints = keypoints.size();
+  EXPECT_NEAR(pyramid_keypoints.size(), num_keypoints, 0.1 * num_keypoints);
+
+  std::vector<int> num_keypoints_per_level(num_levels, 0);
+  for (const cv::KeyPoint& keypoint : keypoints) {
+    ASSERT_GE(keypoint.octave, 0);
+    ASSERT_LT(keypoint.octave, num_levels);
+    ++num_keypoints_per_level[keypoint.octave];
+  }
+  std::vector<int> num_pyramid_keypoints_per_level(num_levels, 0);
+  for (const cv::KeyPoint& keypoint : pyramid_keypoints) {
+    ASSERT_GE(keypoint.octave, 0);
+    ASSERT_LT(keypoint.octave, num_levels);
+    ++num_pyramid_keypoints_per_level[keypoint.octave];
+    // The coordinates and the size refer to level 0, like the ones of the ORB
+    // detector.
+    EXPECT_GE(keypoint.pt.x, 0.f);
+    EXPECT_LT(keypoint.pt.x, image.cols);
+    EXPECT_GE(keypoint.pt.y, 0.f);
+    EXPECT_LT(keypoint.pt.y, image.rows);
+    EXPECT_NEAR(
+        keypoint.size, settings.orb_detector_patch_size *
+                           image_pyramid.getScale(keypoint.octave),
+        1e-3);
+  }
+  // Both distribute the features over the levels in the same way, only the
+  // border keypoints above may shift between neighboring levels.
+  for (int level = 0; level < num_levels; ++level) {
+    EXPECT_NEAR(
+        num_pyramid_keypoints_per_level[level] /
+            static_cast<double>(pyramid_keypoints.size()),
+        num_keypoints_per_level[level] / num_keypoints, 0.05)
+        << "Level " << level;
+  }
+
+  // Most keypoints are found on the same level at about the same position.
+  // Keypoints with equal scores are ordered arbitrarily by retainBest and the
+  // non-maximum suppression drops different ones of two close keypoints, so
+  // not every keypoint has a counterpart even away from the cell borders.
+  int num_matched_keypoints = 0;
+  for (const cv::KeyPoint& keypoint : keypoints) {
+    const float max_distance = 2.f * image_pyramid.getScale(keypoint.octave);
+    for (const cv::KeyPoint& pyramid_keypoint : pyramid_keypoints) {
+      if (pyramid_keypoint.octave == keypoint.octave &&
+          cv::norm(pyramid_keypoint.pt - keypoint.pt) < max_distance) {
+        EXPECT_NEAR(pyramid_keypoint.size, keypoint.size, 1e-3);
+        ++num_matched_keypoints;
+        break;
+      }
+    }
+  }
+  EXPECT_GT(num_matched_keypoints, 0.7 * num_keypoints);
+}
+
+TEST(GridedDetector, DetectionOnPyramidRespectsTheDetectionMask) {
+  constexpr size_t kNumGridRows = 2u;
+  constexpr size_t kNumGridCols = 3u;
+  constexpr int kMaskedCols = 300;
+  const cv::Mat image = createTexturedImage(752, 480);
+  cv::Mat detection_mask(image.size(), CV_8UC1, cv::Scalar(255));
+  detection_mask.colRange(0, kMaskedCols).setTo(0);
+  const SweFeatureTrackingDetectorSettings settings;
+  const int num_levels = settings.orb_detector_pyramid_levels;
+
+  const cv::Ptr<cv::FeatureDetector> detector = cv::ORB::create(
+      settings.orb_detector_number_features, settings.orb_detector_scale_factor,
+      num_levels, /*edgeThreshold=*/0, /*firstLevel=*/0,
+      settings.orb_detector_WTA_K, settings.orb_detector_score_type,
+      settings.orb_detector_patch_size, settings.orb_detector_fast_threshold);
+  std::vector<cv::KeyPoint> keypoints;
+  detectKeypointsGrided(
+      detector, image, detection_mask, settings.max_feature_count,
+      settings.detector_nonmaxsuppression_radius,
+      settings.detector_nonmaxsuppression_ratio_threshold, kNumGridRows,
+      kNumGridCols, &keypoints);
+
+  std::vector<cv::Ptr<cv::FeatureDetector>> level_detectors;
+  createPyramidLevelOrbDetectors(
+      settings, /*edge_threshold=*/0, &level_detectors);
+  ImagePyramid image_pyramid(num_levels, settings.orb_detector_scale_factor);
+  image_pyramid.build(image);
+  std::vector<cv::KeyPoint> pyramid_keypoints;
+  detectKeypointsGridedOnPyramid(
+      level_detectors, image_pyramid, detection_mask,
+      settings.max_feature_count, settings.detector_nonmaxsuppression_radius,
+      settings.detector_nonmaxsuppression_ratio_threshold, kNumGridRows,
+      kNumGridCols, &pyramid_keypoints);
+
+  // Same tolerance as without a mask.
+  ASSERT_FALSE(keypoints.empty());
+  const double num_keypoints = keypoints.size();
+  EXPECT_NEAR(pyramid_keypoints.size(), num_keypoints, 0.1 * num_keypoints);
+
+  // The downscaled masks move the mask border by up to one pixel of the
+  // level.
+  for (const cv::KeyPoint& keypoint : pyramid_keypoints) {
+    EXPECT_GE(
+        keypoint.pt.x, kMaskedCols - image_pyramid.getScale(keypoint.octave));
+  }
+}
+
+}  // namespace feature_tracking
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,56 @@
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <opencv2/core/core.hpp>
+
+#include "feature-tracking/image-pyramid.h"
+
+namespace feature_tracking {
+
+TEST(ImagePyramidTest, LevelsHaveScaledSizes) {
+  constexpr size_t kNumLevels = 4u;
+  constexpr float kScaleFactor = 1.2f;
+  ImagePyramid image_pyramid(kNumLevels, kScaleFactor);
+  cv::Mat image(480, 752, CV_8UC1);
+  cv::randu(image, 0, 255);
+  image_pyramid.build(image);
+
+  ASSERT_EQ(image_pyramid.getNumLevels(), kNumLevels);
+  // Level 0 references the image.
+  EXPECT_EQ(image_pyramid.getLevel(0u).data, image.data);
+  EXPECT_FLOAT_EQ(image_pyramid.getScale(0u), 1.0f);
+  for (size_t level = 1u; level < kNumLevels; ++level) {
+    const cv::Mat& level_image = image_pyramid.getLevel(level);
+    const float scale = image_pyramid.getScale(level);
+    EXPECT_FLOAT_EQ(scale, kScaleFactor * image_pyramid.getScale(level - 1u));
+    EXPECT_EQ(level_image.type(), image.type());
+    EXPECT_EQ(level_image.cols, cvRound(image.cols / scale));
+    EXPECT_EQ(level_image.rows, cvRound(image.rows / scale));
+  }
+}
+
+TEST(ImagePyramidTest, ReusesLevelBuffers) {
+  constexpr size_t kNumLevels = 8u;
+  ImagePyramid image_pyramid(kNumLevels, 1.2f);
+  cv::Mat image(480, 752, CV_8UC1);
+  cv::randu(image, 0, 255);
+  image_pyramid.build(image);
+
+  std::vector<const uchar*> level_buffers;
+  for (size_t level = 1u; level < kNumLevels; ++level) {
+    level_buffers.push_back(image_pyramid.getLevel(level).data);
+  }
+
+  cv::Mat other_image(480, 752, CV_8UC1);
+  cv::randu(other_image, 0, 255);
+  image_pyramid.build(other_image);
+  EXPECT_EQ(image_pyramid.getLevel(0u).data, other_image.data);
+  for (size_t level = 1u; level < kNumLevels; ++level) {
+    EXPECT_EQ(image_pyramid.getLevel(level).data, level_buffers[level - 1u]);
+  }
+}
+
+}  // namespace feature_tracking
+
+MAPLAB_UNITTEST_ENTRYPOINT
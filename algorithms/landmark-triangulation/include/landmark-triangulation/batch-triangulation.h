@@ -0,0 +1,70 @@
+#ifndef LANDMARK_TRIANGULATION_BATCH_TRIANGULATION_H_
+#define LANDMARK_TRIANGULATION_BATCH_TRIANGULATION_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/memory.h>
+#include <vi-map/landmark-quality-metrics.h>
+
+namespace landmark_triangulation {
+
+// The observations of many landmarks in contiguous arrays, the observations of
+// landmark i are the entries [observation_offsets[i],
+// observation_offsets[i + 1]) of the per-observation arrays.
+struct TriangulationBatch {
+  // Allocates the per-observation arrays for the given number of observations
+  // per landmark and fills in the offsets.
+  void resize(const std::vector<size_t>& num_observations_per_landmark);
+
+  inline size_t numLandmarks() const {
+    return observation_offsets.empty() ? 0u : observation_offsets.size() - 1u;
+  }
+  inline size_t numObservations() const {
+    return observation_offsets.empty() ? 0u : observation_offsets.back();
+  }
+
+  std::vector<size_t> observation_offsets;
+  // Bearing vector of the keypoint in the global frame. Zero if the keypoint
+  // could not be back-projected, such an observation is only used for the
+  // quality metrics.
+  Aligned<std::vector, Eigen::Vector3d> G_bearing_vectors;
+  // Position and optical axis of the observing camera in the global frame.
+  Aligned<std::vector, Eigen::Vector3d> p_G_C;
+  Aligned<std::vector, Eigen::Vector3d> G_optical_axes;
+};
+
+struct TriangulationBatchResult {
+  enum class Status : uint8_t {
+    kWellConstrained,
+    kNotWellConstrained,
+    kTooFewObservations,
+    kTooFewMeasurements,
+    kUnobservable
+  };
+
+  inline bool wasTriangulationSuccessful(const size_t landmark_idx) const {
+    return status[landmark_idx] == Status::kWellConstrained ||
+           status[landmark_idx] == Status::kNotWellConstrained;
+  }
+
+  // Only valid if the triangulation was successful.
+  Aligned<std::vector, Eigen::Vector3d> p_G_fi;
+  std::vector<Status> status;
+};
+
+// Triangulates all landmarks of the batch by solving the linear multi-view
+// triangulation problem in its reduced 3x3 normal equation form, equivalent to
+// aslam::linearTriangulateFromNViews. The quality of every triangulated
+// landmark is scored in the same pass, with the same criteria as
+// vi_map::isLandmarkWellConstrained.
+void triangulateBatch(
+    const TriangulationBatch& batch,
+    const vi_map::LandmarkWellConstrainedSettings& settings,
+    const size_t num_threads, TriangulationBatchResult* result);
+
+}  // namespace landmark_triangulation
+
+#endif  // LANDMARK_TRIANGULATION_BATCH_TRIANGULATION_H_
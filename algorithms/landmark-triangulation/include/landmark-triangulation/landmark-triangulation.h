@@ -1,6 +1,7 @@
 #ifndef LANDMARK_TRIANGULATION_LANDMARK_TRIANGULATION_H_
 #define LANDMARK_TRIANGULATION_LANDMARK_TRIANGULATION_H_
 
+#include <cstddef>
 #include <string>
 
 #include <aslam/common/memory.h>
@@ -16,5 +17,13 @@ bool retriangulateLandmarksOfMission(
 void retriangulateLandmarksOfVertex(
     const pose_graph::VertexId& storing_vertex_id, vi_map::VIMap* map);
 
+// Retriangulates only the landmarks that the map reports as dirty, i.e. whose
+// observations changed or whose observer or storing vertices moved since the
+// last retriangulation. Clears the dirty state of the map afterwards and
+// returns the number of retriangulated landmarks.
+size_t retriangulateDirtyLandmarks(vi_map::VIMap* map);
+size_t retriangulateDirtyLandmarks(
+    const size_t num_threads, vi_map::VIMap* map);
+
 }  // namespace landmark_triangulation
 #endif  // LANDMARK_TRIANGULATION_LANDMARK_TRIANGULATION_H_
@@ -0,0 +1,150 @@
+#include "landmark-triangulation/batch-triangulation.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <glog/logging.h>
+#include <maplab-common/parallel-process.h>
+
+namespace landmark_triangulation {
+namespace {
+
+// Same rank loss tolerance as aslam::linearTriangulateFromNViews.
+constexpr double kRankLossTolerance = 1e-5;
+
+typedef TriangulationBatchResult::Status Status;
+
+// The triangulated point p_G_fi minimizes the distance to the observation rays
+// p_G_C_i + alpha_i * b_i. Eliminating the alphas leaves the 3x3 system
+//   sum_i (I - b_i * b_i^T / |b_i|^2) * p_G_fi =
+//       sum_i (p_G_C_i - b_i * (b_i^T * p_G_C_i) / |b_i|^2).
+Status triangulateLandmark(
+    const TriangulationBatch& batch, const size_t begin, const size_t end,
+    Eigen::Vector3d* p_G_fi) {
+  CHECK_NOTNULL(p_G_fi);
+  if (end - begin < 2u) {
+    return Status::kTooFewObservations;
+  }
+
+  Eigen::Matrix3d sum_b_b_normalized = Eigen::Matrix3d::Zero();
+  Eigen::Vector3d sum_p_G_C = Eigen::Vector3d::Zero();
+  Eigen::Vector3d sum_b_dot_p_normalized = Eigen::Vector3d::Zero();
+  int num_measurements = 0;
+  for (size_t i = begin; i < end; ++i) {
+    const Eigen::Vector3d& G_bearing_vector = batch.G_bearing_vectors[i];
+    const double squared_norm = G_bearing_vector.squaredNorm();
+    if (squared_norm == 0.0) {
+      continue;
+    }
+    const Eigen::Vector3d b_normalized = G_bearing_vector / squared_norm;
+    sum_b_b_normalized.noalias() += b_normalized * G_bearing_vector.transpose();
+    sum_p_G_C += batch.p_G_C[i];
+    sum_b_dot_p_normalized +=
+        b_normalized * G_bearing_vector.dot(batch.p_G_C[i]);
+    ++num_measurements;
+  }
+  if (num_measurements < 2) {
+    return Status::kTooFewMeasurements;
+  }
+
+  const Eigen::Matrix3d A =
+      num_measurements * Eigen::Matrix3d::Identity() - sum_b_b_normalized;
+  const Eigen::Vector3d b = sum_p_G_C - sum_b_dot_p_normalized;
+  Eigen::ColPivHouseholderQR<Eigen::Matrix3d> qr(A);
+  qr.setThreshold(kRankLossTolerance);
+  if (qr.rank() < 3) {
+    return Status::kUnobservable;
+  }
+  *p_G_fi = qr.solve(b);
+  return Status::kWellConstrained;
+}
+
+// Same criteria as vi_map::isLandmarkWellConstrained, the incidence rays are
+// collected in a buffer that is reused across landmarks.
+bool isWellConstrained(
+    const TriangulationBatch& batch, const size_t begin, const size_t end,
+    const Eigen::Vector3d& p_G_fi,
+    const vi_map::LandmarkWellConstrainedSettings& settings,
+    Aligned<std::vector, Eigen::Vector3d>* G_normalized_incidence_rays) {
+  CHECK_NOTNULL(G_normalized_incidence_rays)->clear();
+  if (end - begin < settings.min_observers) {
+    return false;
+  }
+
+  double signed_distance_to_closest_observer =
+      std::numeric_limits<double>::max();
+  for (size_t i = begin; i < end; ++i) {
+    const Eigen::Vector3d G_incidence_ray = batch.p_G_C[i] - p_G_fi;
+    const double distance = G_incidence_ray.norm();
+    // Negative if the landmark is behind the camera.
+    const double signed_distance =
+        distance *
+        (batch.G_optical_axes[i].dot(-G_incidence_ray) < 0.0 ? -1.0 : 1.0);
+    signed_distance_to_closest_observer =
+        std::min(signed_distance_to_closest_observer, signed_distance);
+    if (distance > 0) {
+      G_normalized_incidence_rays->emplace_back(G_incidence_ray / distance);
+    }
+  }
+  return vi_map::isLandmarkWellConstrained(
+      *G_normalized_incidence_rays, signed_distance_to_closest_observer,
+      settings);
+}
+
+}  // namespace
+
+void TriangulationBatch::resize(
+    const std::vector<size_t>& num_observations_per_landmark) {
+  const size_t num_landmarks = num_observations_per_landmark.size();
+  observation_offsets.resize(num_landmarks + 1u);
+  observation_offsets[0] = 0u;
+  for (size_t landmark_idx = 0u; landmark_idx < num_landmarks;
+       ++landmark_idx) {
+    observation_offsets[landmark_idx + 1u] =
+        observation_offsets[landmark_idx] +
+        num_observations_per_landmark[landmark_idx];
+  }
+  const size_t num_observations = observation_offsets.back();
+  G_bearing_vectors.resize(num_observations);
+  p_G_C.resize(num_observations);
+  G_optical_axes.resize(num_observations);
+}
+
+void triangulateBatch(
+    const TriangulationBatch& batch,
+    const vi_map::LandmarkWellConstrainedSettings& settings,
+    const size_t num_threads, TriangulationBatchResult* result) {
+  CHECK_NOTNULL(result);
+  CHECK_GT(num_threads, 0u);
+  const size_t num_landmarks = batch.numLandmarks();
+  CHECK_EQ(batch.G_bearing_vectors.size(), batch.numObservations());
+  CHECK_EQ(batch.p_G_C.size(), batch.numObservations());
+  CHECK_EQ(batch.G_optical_axes.size(), batch.numObservations());
+
+  result->p_G_fi.resize(num_landmarks);
+  result->status.resize(num_landmarks);
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      num_landmarks,
+      [&](const std::vector<size_t>& range) {
+        Aligned<std::vector, Eigen::Vector3d> G_normalized_incidence_rays;
+        for (const size_t landmark_idx : range) {
+          const size_t begin = batch.observation_offsets[landmark_idx];
+          const size_t end = batch.observation_offsets[landmark_idx + 1u];
+          Eigen::Vector3d& p_G_fi = result->p_G_fi[landmark_idx];
+          Status status = triangulateLandmark(batch, begin, end, &p_G_fi);
+          if (status == Status::kWellConstrained &&
+              !isWellConstrained(
+                  batch, begin, end, p_G_fi, settings,
+                  &G_normalized_incidence_rays)) {
+            status = Status::kNotWellConstrained;
+          }
+          result->status[landmark_idx] = status;
+        }
+      },
+      kAlwaysParallelize, num_threads);
+}
+
+}  // namespace landmark_triangulation
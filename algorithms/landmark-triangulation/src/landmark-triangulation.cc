@@ -1,16 +1,15 @@
 #include "landmark-triangulation/landmark-triangulation.h"
 
-#include <functional>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <aslam/common/statistics/statistics.h>
-#include <aslam/triangulation/triangulation.h>
-#include <maplab-common/multi-threaded-progress-bar.h>
 #include <maplab-common/parallel-process.h>
 #include <vi-map/landmark-quality-metrics.h>
 #include <vi-map/vi-map.h>
 
+#include "landmark-triangulation/batch-triangulation.h"
 #include "landmark-triangulation/pose-interpolator.h"
 
 namespace landmark_triangulation {
@@ -18,14 +17,13 @@ typedef AlignedUnorderedMap<aslam::FrameId, aslam::Transformation>
     FrameToPoseMap;
 
 namespace {
-void interpolateVisualFramePosesAllMissions(
-    const vi_map::VIMap& map, FrameToPoseMap* interpolated_frame_poses) {
+void interpolateVisualFramePosesOfMissions(
+    const vi_map::VIMap& map, const vi_map::MissionIdList& mission_ids,
+    FrameToPoseMap* interpolated_frame_poses) {
   CHECK_NOTNULL(interpolated_frame_poses)->clear();
-  // Loop over all missions, vertices and frames and add the interpolated poses
+  // Loop over the missions, vertices and frames and add the interpolated poses
   // to the map.
   size_t total_num_frames = 0u;
-  vi_map::MissionIdList mission_ids;
-  map.getAllMissionIds(&mission_ids);
   for (const vi_map::MissionId mission_id : mission_ids) {
     // Check if there is IMU data.
     std::unordered_map<pose_graph::VertexId, int64_t> vertex_to_time_map;
@@ -110,136 +108,207 @@ void interpolateVisualFramePosesAllMissions(
   }
 }
 
-void retriangulateLandmarksOfVertex(
-    const FrameToPoseMap& interpolated_frame_poses,
-    pose_graph::VertexId storing_vertex_id, vi_map::VIMap* map) {
-  CHECK_NOTNULL(map);
-  vi_map::Vertex& storing_vertex = map->getVertex(storing_vertex_id);
-  vi_map::LandmarkStore& landmark_store = storing_vertex.getLandmarks();
-
-  const aslam::Transformation& T_M_I_storing = storing_vertex.get_T_M_I();
-  const aslam::Transformation& T_G_M_storing =
-      const_cast<const vi_map::VIMap*>(map)
-          ->getMissionBaseFrameForVertex(storing_vertex_id)
-          .get_T_G_M();
-  const aslam::Transformation T_G_I_storing = T_G_M_storing * T_M_I_storing;
-
-  for (vi_map::Landmark& landmark : landmark_store) {
-    // The following have one entry per measurement:
-    Eigen::Matrix3Xd G_bearing_vectors;
-    Eigen::Matrix3Xd p_G_C_vector;
-
-    landmark.setQuality(vi_map::Landmark::Quality::kBad);
-
-    const vi_map::KeypointIdentifierList& observations =
-        landmark.getObservations();
-    if (observations.size() < 2u) {
-      statistics::StatsCollector stats(
-          "Landmark triangulation failed too few observations.");
-      stats.IncrementOne();
-      continue;
-    }
-
-    G_bearing_vectors.resize(Eigen::NoChange, observations.size());
-    p_G_C_vector.resize(Eigen::NoChange, observations.size());
-
-    int num_measurements = 0;
-    for (const vi_map::KeypointIdentifier& observation : observations) {
-      const pose_graph::VertexId& observer_id = observation.frame_id.vertex_id;
-      CHECK(map->hasVertex(observer_id))
-          << "Observer " << observer_id << " of store landmark "
-          << landmark.id() << " not in currently loaded map!";
-
-      const vi_map::Vertex& observer =
-          const_cast<const vi_map::VIMap*>(map)->getVertex(observer_id);
-      const aslam::VisualFrame& visual_frame =
-          observer.getVisualFrame(observation.frame_id.frame_index);
-      const aslam::Transformation& T_G_M_observer =
-          const_cast<const vi_map::VIMap*>(map)
-              ->getMissionBaseFrameForVertex(observer_id)
-              .get_T_G_M();
-
-      // If there are precomputed/interpolated T_M_I, use those.
-      aslam::Transformation T_G_I_observer;
-      FrameToPoseMap::const_iterator it =
-          interpolated_frame_poses.find(visual_frame.getId());
-      if (it != interpolated_frame_poses.end()) {
-        const aslam::Transformation& T_M_I_observer = it->second;
-        T_G_I_observer = T_G_M_observer * T_M_I_observer;
-      } else {
-        const aslam::Transformation& T_M_I_observer = observer.get_T_M_I();
-        T_G_I_observer = T_G_M_observer * T_M_I_observer;
-      }
-
-      Eigen::Vector2d measurement =
-          visual_frame.getKeypointMeasurement(observation.keypoint_index);
+void interpolateVisualFramePosesAllMissions(
+    const vi_map::VIMap& map, FrameToPoseMap* interpolated_frame_poses) {
+  vi_map::MissionIdList mission_ids;
+  map.getAllMissionIds(&mission_ids);
+  interpolateVisualFramePosesOfMissions(
+      map, mission_ids, interpolated_frame_poses);
+}
 
-      Eigen::Vector3d C_bearing_vector;
-      bool projection_result =
-          observer.getCamera(observation.frame_id.frame_index)
-              ->backProject3(measurement, &C_bearing_vector);
-      if (!projection_result) {
-        statistics::StatsCollector stats(
-            "Landmark triangulation failed proj failed.");
-        stats.IncrementOne();
-        continue;
-      }
+// Returns the missions of all vertices that observe any of the landmarks.
+void getObserverMissions(
+    const vi_map::VIMap& map, const vi_map::LandmarkIdList& landmark_ids,
+    vi_map::MissionIdList* mission_ids) {
+  CHECK_NOTNULL(mission_ids)->clear();
+  vi_map::MissionIdSet mission_id_set;
+  for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
+    map.getLandmark(landmark_id)
+        .forEachObservation(
+            [&](const vi_map::KeypointIdentifier& observation) {
+              mission_id_set.emplace(
+                  map.getMissionIdForVertex(observation.frame_id.vertex_id));
+            });
+  }
+  mission_ids->assign(mission_id_set.begin(), mission_id_set.end());
+}
 
-      const aslam::CameraId& cam_id =
-          observer.getCamera(observation.frame_id.frame_index)->getId();
-      aslam::Transformation T_G_C =
-          (T_G_I_observer *
-           observer.getNCameras()->get_T_C_B(cam_id).inverse());
-      G_bearing_vectors.col(num_measurements) =
-          T_G_C.getRotationMatrix() * C_bearing_vector;
-      p_G_C_vector.col(num_measurements) = T_G_C.getPosition();
-      ++num_measurements;
-    }
-    G_bearing_vectors.conservativeResize(Eigen::NoChange, num_measurements);
-    p_G_C_vector.conservativeResize(Eigen::NoChange, num_measurements);
+// Gathers the observations of the given landmarks into a triangulation batch.
+// Observations whose keypoint can't be back-projected get a zero bearing
+// vector, they still count for the landmark quality.
+void gatherTriangulationBatch(
+    const vi_map::VIMap& map, const vi_map::LandmarkIdList& landmark_ids,
+    const FrameToPoseMap& interpolated_frame_poses, const size_t num_threads,
+    TriangulationBatch* batch, size_t* num_failed_projections) {
+  CHECK_NOTNULL(batch);
+  CHECK_NOTNULL(num_failed_projections);
+  const size_t num_landmarks = landmark_ids.size();
+
+  std::vector<size_t> num_observations_per_landmark(num_landmarks);
+  for (size_t landmark_idx = 0u; landmark_idx < num_landmarks;
+       ++landmark_idx) {
+    num_observations_per_landmark[landmark_idx] =
+        map.getLandmark(landmark_ids[landmark_idx]).numberOfObservations();
+  }
+  batch->resize(num_observations_per_landmark);
 
-    if (num_measurements < 2) {
-      statistics::StatsCollector stats("Landmark triangulation too few meas.");
-      stats.IncrementOne();
-      continue;
-    }
+  std::vector<size_t> num_failed_projections_per_landmark(num_landmarks, 0u);
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      num_landmarks,
+      [&](const std::vector<size_t>& range) {
+        for (const size_t landmark_idx : range) {
+          const vi_map::Landmark& landmark =
+              map.getLandmark(landmark_ids[landmark_idx]);
+          size_t observation_idx = batch->observation_offsets[landmark_idx];
+          for (const vi_map::KeypointIdentifier& observation :
+               landmark.getObservations()) {
+            const pose_graph::VertexId& observer_id =
+                observation.frame_id.vertex_id;
+            CHECK(map.hasVertex(observer_id))
+                << "Observer " << observer_id << " of store landmark "
+                << landmark.id() << " not in currently loaded map!";
+
+            const vi_map::Vertex& observer = map.getVertex(observer_id);
+            const aslam::VisualFrame& visual_frame =
+                observer.getVisualFrame(observation.frame_id.frame_index);
+            const aslam::Transformation& T_G_M_observer =
+                map.getMissionBaseFrameForVertex(observer_id).get_T_G_M();
+
+            // If there are precomputed/interpolated T_M_I, use those.
+            FrameToPoseMap::const_iterator it =
+                interpolated_frame_poses.find(visual_frame.getId());
+            const aslam::Transformation T_G_I_observer =
+                T_G_M_observer * (it != interpolated_frame_poses.end()
+                                      ? it->second
+                                      : observer.get_T_M_I());
+
+            const aslam::Camera::ConstPtr camera =
+                observer.getCamera(observation.frame_id.frame_index);
+            const aslam::Transformation T_G_C =
+                T_G_I_observer *
+                observer.getNCameras()->get_T_C_B(camera->getId()).inverse();
+            batch->p_G_C[observation_idx] = T_G_C.getPosition();
+            batch->G_optical_axes[observation_idx] =
+                T_G_C.getRotationMatrix().col(2);
+
+            Eigen::Vector3d C_bearing_vector;
+            if (camera->backProject3(
+                    visual_frame.getKeypointMeasurement(
+                        observation.keypoint_index),
+                    &C_bearing_vector)) {
+              batch->G_bearing_vectors[observation_idx] =
+                  T_G_C.getRotationMatrix() * C_bearing_vector;
+            } else {
+              batch->G_bearing_vectors[observation_idx].setZero();
+              ++num_failed_projections_per_landmark[landmark_idx];
+            }
+            ++observation_idx;
+          }
+          CHECK_EQ(
+              observation_idx, batch->observation_offsets[landmark_idx + 1u]);
+        }
+      },
+      kAlwaysParallelize, num_threads);
 
-    Eigen::Vector3d p_G_fi;
-    aslam::TriangulationResult triangulation_result =
-        aslam::linearTriangulateFromNViews(
-            G_bearing_vectors, p_G_C_vector, &p_G_fi);
+  *num_failed_projections = 0u;
+  for (const size_t num_failed : num_failed_projections_per_landmark) {
+    *num_failed_projections += num_failed;
+  }
+}
 
-    if (triangulation_result.wasTriangulationSuccessful()) {
-      landmark.set_p_B(T_G_I_storing.inverse() * p_G_fi);
-      constexpr bool kReEvaluateQuality = true;
-      if (vi_map::isLandmarkWellConstrained(
-              *map, landmark, kReEvaluateQuality)) {
+void addTriangulationStatistics(
+    const TriangulationBatchResult& result,
+    const size_t num_failed_projections) {
+  typedef TriangulationBatchResult::Status Status;
+  for (size_t i = 0u; i < num_failed_projections; ++i) {
+    statistics::StatsCollector stats(
+        "Landmark triangulation failed proj failed.");
+    stats.IncrementOne();
+  }
+  for (const Status status : result.status) {
+    switch (status) {
+      case Status::kWellConstrained: {
         statistics::StatsCollector stats_good("Landmark good");
         stats_good.IncrementOne();
-        landmark.setQuality(vi_map::Landmark::Quality::kGood);
-      } else {
+        break;
+      }
+      case Status::kNotWellConstrained: {
         statistics::StatsCollector stats("Landmark bad after triangulation");
         stats.IncrementOne();
+        break;
       }
-    } else {
-      statistics::StatsCollector stats("Landmark triangulation failed");
-      stats.IncrementOne();
-      if (triangulation_result.status() ==
-          aslam::TriangulationResult::UNOBSERVABLE) {
+      case Status::kTooFewObservations: {
         statistics::StatsCollector stats(
-            "Landmark triangulation failed - unobservable");
+            "Landmark triangulation failed too few observations.");
         stats.IncrementOne();
-      } else if (
-          triangulation_result.status() ==
-          aslam::TriangulationResult::UNINITIALIZED) {
+        break;
+      }
+      case Status::kTooFewMeasurements: {
         statistics::StatsCollector stats(
-            "Landmark triangulation failed - uninitialized");
+            "Landmark triangulation too few meas.");
         stats.IncrementOne();
+        break;
       }
+      case Status::kUnobservable: {
+        statistics::StatsCollector stats("Landmark triangulation failed");
+        stats.IncrementOne();
+        statistics::StatsCollector stats_unobservable(
+            "Landmark triangulation failed - unobservable");
+        stats_unobservable.IncrementOne();
+        break;
+      }
+      default:
+        LOG(FATAL) << "Unknown triangulation status "
+                   << static_cast<int>(status) << '.';
     }
   }
 }
 
+// Gathers the observations of the landmarks, triangulates them with the batch
+// kernel and writes the positions and qualities back to the map.
+void retriangulateLandmarkList(
+    const vi_map::LandmarkIdList& landmark_ids,
+    const FrameToPoseMap& interpolated_frame_poses, const size_t num_threads,
+    vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  CHECK_GT(num_threads, 0u);
+
+  TriangulationBatch batch;
+  size_t num_failed_projections = 0u;
+  gatherTriangulationBatch(
+      *map, landmark_ids, interpolated_frame_poses, num_threads, &batch,
+      &num_failed_projections);
+
+  const vi_map::LandmarkWellConstrainedSettings settings;
+  TriangulationBatchResult result;
+  triangulateBatch(batch, settings, num_threads, &result);
+
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      landmark_ids.size(),
+      [&](const std::vector<size_t>& range) {
+        for (const size_t landmark_idx : range) {
+          const vi_map::LandmarkId& landmark_id = landmark_ids[landmark_idx];
+          vi_map::Landmark& landmark = map->getLandmark(landmark_id);
+          if (result.wasTriangulationSuccessful(landmark_idx)) {
+            const aslam::Transformation T_G_I_storing = map->getVertex_T_G_I(
+                map->getLandmarkStoreVertexId(landmark_id));
+            landmark.set_p_B(
+                T_G_I_storing.inverse() * result.p_G_fi[landmark_idx]);
+          }
+          landmark.setQuality(
+              result.status[landmark_idx] ==
+                      TriangulationBatchResult::Status::kWellConstrained
+                  ? vi_map::Landmark::Quality::kGood
+                  : vi_map::Landmark::Quality::kBad);
+        }
+      },
+      kAlwaysParallelize, num_threads);
+
+  addTriangulationStatistics(result, num_failed_projections);
+}
+
 bool retriangulateLandmarksOfMission(
     const vi_map::MissionId& mission_id,
     const FrameToPoseMap& interpolated_frame_poses, vi_map::VIMap* map) {
@@ -249,27 +318,19 @@ bool retriangulateLandmarksOfMission(
   pose_graph::VertexIdList relevant_vertex_ids;
   map->getAllVertexIdsInMissionAlongGraph(mission_id, &relevant_vertex_ids);
 
-  const size_t num_vertices = relevant_vertex_ids.size();
-  VLOG(1) << "Retriangulating landmarks of " << num_vertices << " vertices.";
-
-  common::MultiThreadedProgressBar progress_bar;
-  std::function<void(const std::vector<size_t>&)> retriangulator =
-      [&relevant_vertex_ids, map, &progress_bar,
-       &interpolated_frame_poses](const std::vector<size_t>& batch) {
-        progress_bar.setNumElements(batch.size());
-        size_t num_processed = 0u;
-        for (size_t item : batch) {
-          CHECK_LT(item, relevant_vertex_ids.size());
-          retriangulateLandmarksOfVertex(
-              interpolated_frame_poses, relevant_vertex_ids[item], map);
-          progress_bar.update(++num_processed);
-        }
-      };
+  vi_map::LandmarkIdList landmark_ids;
+  for (const pose_graph::VertexId& vertex_id : relevant_vertex_ids) {
+    for (const vi_map::Landmark& landmark :
+         map->getVertex(vertex_id).getLandmarks()) {
+      landmark_ids.emplace_back(landmark.id());
+    }
+  }
+  VLOG(1) << "Retriangulating " << landmark_ids.size() << " landmarks of "
+          << relevant_vertex_ids.size() << " vertices.";
 
-  static constexpr bool kAlwaysParallelize = false;
-  const size_t num_threads = common::getNumHardwareThreads();
-  common::ParallelProcess(
-      num_vertices, retriangulator, kAlwaysParallelize, num_threads);
+  retriangulateLandmarkList(
+      landmark_ids, interpolated_frame_poses, common::getNumHardwareThreads(),
+      map);
   return true;
 }
 }  // namespace
@@ -285,6 +346,7 @@ bool retriangulateLandmarks(vi_map::VIMap* map) {
   for (const vi_map::MissionId& mission_id : all_mission_ids) {
     retriangulateLandmarksOfMission(mission_id, interpolated_frame_poses, map);
   }
+  map->clearDirtyState(common::getNumHardwareThreads());
   return true;
 }
 
@@ -298,9 +360,40 @@ bool retriangulateLandmarksOfMission(
 void retriangulateLandmarksOfVertex(
     const pose_graph::VertexId& storing_vertex_id, vi_map::VIMap* map) {
   CHECK_NOTNULL(map);
-  FrameToPoseMap empty_frame_to_pose_map;
-  retriangulateLandmarksOfVertex(
-      empty_frame_to_pose_map, storing_vertex_id, map);
+  vi_map::LandmarkIdList landmark_ids;
+  map->getVertex(storing_vertex_id).getStoredLandmarkIdList(&landmark_ids);
+  const FrameToPoseMap empty_frame_to_pose_map;
+  constexpr size_t kNumThreads = 1u;
+  retriangulateLandmarkList(
+      landmark_ids, empty_frame_to_pose_map, kNumThreads, map);
+}
+
+size_t retriangulateDirtyLandmarks(vi_map::VIMap* map) {
+  return retriangulateDirtyLandmarks(common::getNumHardwareThreads(), map);
+}
+
+size_t retriangulateDirtyLandmarks(
+    const size_t num_threads, vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  CHECK_GT(num_threads, 0u);
+
+  vi_map::LandmarkIdList dirty_landmark_ids;
+  map->getDirtyLandmarks(num_threads, &dirty_landmark_ids);
+  VLOG(1) << "Retriangulating " << dirty_landmark_ids.size()
+          << " dirty landmarks.";
+
+  // Same frame poses as retriangulateLandmarks, but only interpolated for the
+  // missions that observe dirty landmarks.
+  vi_map::MissionIdList observer_mission_ids;
+  getObserverMissions(*map, dirty_landmark_ids, &observer_mission_ids);
+  FrameToPoseMap interpolated_frame_poses;
+  interpolateVisualFramePosesOfMissions(
+      *map, observer_mission_ids, &interpolated_frame_poses);
+  retriangulateLandmarkList(
+      dirty_landmark_ids, interpolated_frame_poses, num_threads, map);
+
+  map->clearDirtyState(num_threads);
+  return dirty_landmark_ids.size();
 }
 
 }  // namespace landmark_triangulation
@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/memory.h>
+#include <aslam/triangulation/triangulation.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/test/testing-predicates.h>
+#include <vi-map/landmark-quality-metrics.h>
+
+#include "landmark-triangulation/batch-triangulation.h"
+
+namespace landmark_triangulation {
+
+class BatchTriangulationTest : public ::testing::Test {
+ protected:
+  typedef TriangulationBatchResult::Status Status;
+
+  BatchTriangulationTest() : random_engine_(42u) {}
+
+  Eigen::Vector3d randomVector(const double scale) {
+    std::uniform_real_distribution<double> distribution(-scale, scale);
+    return Eigen::Vector3d(
+        distribution(random_engine_), distribution(random_engine_),
+        distribution(random_engine_));
+  }
+
+  // Adds landmarks observed from cameras around them with noisy bearing
+  // vectors. Some landmarks are behind some of their observers and some
+  // observations failed to back-project.
+  void generateBatch(const size_t num_landmarks) {
+    std::uniform_int_distribution<size_t> num_observations_distribution(2u, 8u);
+    std::uniform_real_distribution<double> unit_distribution(0.0, 1.0);
+    std::vector<size_t> num_observations_per_landmark(num_landmarks);
+    for (size_t& num_observations : num_observations_per_landmark) {
+      num_observations = num_observations_distribution(random_engine_);
+    }
+    batch_.resize(num_observations_per_landmark);
+
+    constexpr double kLandmarkRange = 20.0;
+    constexpr double kObserverDistance = 5.0;
+    constexpr double kBearingNoise = 0.01;
+    constexpr double kFailedProjectionProbability = 0.05;
+    constexpr double kBehindCameraProbability = 0.02;
+    for (size_t landmark_idx = 0u; landmark_idx < num_landmarks;
+         ++landmark_idx) {
+      const Eigen::Vector3d p_G_fi = randomVector(kLandmarkRange);
+      for (size_t i = batch_.observation_offsets[landmark_idx];
+           i < batch_.observation_offsets[landmark_idx + 1u]; ++i) {
+        batch_.p_G_C[i] = p_G_fi + randomVector(kObserverDistance);
+        const Eigen::Vector3d G_direction = p_G_fi - batch_.p_G_C[i];
+        batch_.G_optical_axes[i] =
+            (G_direction.normalized() + randomVector(0.3)).normalized();
+        if (unit_distribution(random_engine_) < kBehindCameraProbability) {
+          batch_.G_optical_axes[i] *= -1.0;
+        }
+        if (unit_distribution(random_engine_) < kFailedProjectionProbability) {
+          batch_.G_bearing_vectors[i].setZero();
+        } else {
+          batch_.G_bearing_vectors[i] =
+              G_direction + G_direction.norm() * randomVector(kBearingNoise);
+        }
+      }
+    }
+  }
+
+  // Triangulates every landmark separately in the way the per-landmark
+  // retriangulation did.
+  void triangulateReference(TriangulationBatchResult* result) const {
+    CHECK_NOTNULL(result);
+    const size_t num_landmarks = batch_.numLandmarks();
+    result->p_G_fi.resize(num_landmarks);
+    result->status.resize(num_landmarks);
+    for (size_t landmark_idx = 0u; landmark_idx < num_landmarks;
+         ++landmark_idx) {
+      const size_t begin = batch_.observation_offsets[landmark_idx];
+      const size_t end = batch_.observation_offsets[landmark_idx + 1u];
+      Status& status = result->status[landmark_idx];
+      if (end - begin < 2u) {
+        status = Status::kTooFewObservations;
+        continue;
+      }
+
+      Eigen::Matrix3Xd G_bearing_vectors(3, end - begin);
+      Eigen::Matrix3Xd p_G_C_vector(3, end - begin);
+      int num_measurements = 0;
+      for (size_t i = begin; i < end; ++i) {
+        if (batch_.G_bearing_vectors[i].isZero()) {
+          continue;
+        }
+        G_bearing_vectors.col(num_measurements) = batch_.G_bearing_vectors[i];
+        p_G_C_vector.col(num_measurements) = batch_.p_G_C[i];
+        ++num_measurements;
+      }
+      G_bearing_vectors.conservativeResize(Eigen::NoChange, num_measurements);
+      p_G_C_vector.conservativeResize(Eigen::NoChange, num_measurements);
+      if (num_measurements < 2) {
+        status = Status::kTooFewMeasurements;
+        continue;
+      }
+
+      Eigen::Vector3d& p_G_fi = result->p_G_fi[landmark_idx];
+      const aslam::TriangulationResult triangulation_result =
+          aslam::linearTriangulateFromNViews(
+              G_bearing_vectors, p_G_C_vector, &p_G_fi);
+      if (!triangulation_result.wasTriangulationSuccessful()) {
+        status = Status::kUnobservable;
+        continue;
+      }
+
+      Aligned<std::vector, Eigen::Vector3d> G_normalized_incidence_rays;
+      double signed_distance_to_closest_observer =
+          std::numeric_limits<double>::max();
+      for (size_t i = begin; i < end; ++i) {
+        const Eigen::Vector3d G_incidence_ray = batch_.p_G_C[i] - p_G_fi;
+        const double distance = G_incidence_ray.norm();
+        const double p_C_fi_z = batch_.G_optical_axes[i].dot(-G_incidence_ray);
+        signed_distance_to_closest_observer = std::min(
+            signed_distance_to_closest_observer,
+            distance * (p_C_fi_z < 0.0 ? -1.0 : 1.0));
+        if (distance > 0) {
+          G_normalized_incidence_rays.emplace_back(G_incidence_ray / distance);
+        }
+      }
+      const bool is_well_constrained =
+          (end - begin >= settings_.min_observers) &&
+          vi_map::isLandmarkWellConstrained(
+              G_normalized_incidence_rays,
+              signed_distance_to_closest_observer, settings_);
+      status = is_well_constrained ? Status::kWellConstrained
+                                   : Status::kNotWellConstrained;
+    }
+  }
+
+  std::mt19937 random_engine_;
+  vi_map::LandmarkWellConstrainedSettings settings_;
+  TriangulationBatch batch_;
+};
+
+TEST_F(BatchTriangulationTest, MatchesPerLandmarkTriangulation) {
+  constexpr size_t kNumLandmarks = 2000u;
+  generateBatch(kNumLandmarks);
+
+  // Degenerate landmarks: a single observation, a single measurement and
+  // parallel observation rays from the same position.
+  const std::vector<size_t> degenerate_observations = {1u, 2u, 3u};
+  const size_t num_observations = batch_.numObservations();
+  for (const size_t num_degenerate_observations : degenerate_observations) {
+    batch_.observation_offsets.emplace_back(
+        batch_.observation_offsets.back() + num_degenerate_observations);
+  }
+  const size_t num_all_observations = batch_.observation_offsets.back();
+  batch_.G_bearing_vectors.resize(
+      num_all_observations, Eigen::Vector3d::UnitX());
+  batch_.p_G_C.resize(num_all_observations, Eigen::Vector3d::Zero());
+  batch_.G_optical_axes.resize(
+      num_all_observations, Eigen::Vector3d::UnitX());
+  batch_.G_bearing_vectors[num_observations + 2u].setZero();
+
+  TriangulationBatchResult reference_result;
+  triangulateReference(&reference_result);
+  TriangulationBatchResult result;
+  constexpr size_t kNumThreads = 1u;
+  triangulateBatch(batch_, settings_, kNumThreads, &result);
+
+  ASSERT_EQ(result.status.size(), batch_.numLandmarks());
+  size_t num_well_constrained = 0u;
+  size_t num_not_well_constrained = 0u;
+  for (size_t landmark_idx = 0u; landmark_idx < batch_.numLandmarks();
+       ++landmark_idx) {
+    EXPECT_EQ(
+        result.status[landmark_idx], reference_result.status[landmark_idx])
+        << "Landmark " << landmark_idx;
+    if (result.wasTriangulationSuccessful(landmark_idx) &&
+        reference_result.wasTriangulationSuccessful(landmark_idx)) {
+      EXPECT_NEAR_EIGEN(
+          result.p_G_fi[landmark_idx], reference_result.p_G_fi[landmark_idx],
+          1e-8);
+    }
+    num_well_constrained +=
+        result.status[landmark_idx] == Status::kWellConstrained;
+    num_not_well_constrained +=
+        result.status[landmark_idx] == Status::kNotWellConstrained;
+  }
+  EXPECT_GT(num_well_constrained, 0u);
+  EXPECT_GT(num_not_well_constrained, 0u);
+
+  const size_t first_degenerate_idx = kNumLandmarks;
+  EXPECT_EQ(result.status[first_degenerate_idx], Status::kTooFewObservations);
+  EXPECT_EQ(
+      result.status[first_degenerate_idx + 1u], Status::kTooFewMeasurements);
+  EXPECT_EQ(result.status[first_degenerate_idx + 2u], Status::kUnobservable);
+}
+
+TEST_F(BatchTriangulationTest, ParallelMatchesSequential) {
+  constexpr size_t kNumLandmarks = 5000u;
+  generateBatch(kNumLandmarks);
+
+  TriangulationBatchResult sequential_result;
+  triangulateBatch(batch_, settings_, 1u, &sequential_result);
+  TriangulationBatchResult parallel_result;
+  constexpr size_t kNumThreads = 4u;
+  triangulateBatch(batch_, settings_, kNumThreads, &parallel_result);
+
+  EXPECT_EQ(sequential_result.status, parallel_result.status);
+  for (size_t landmark_idx = 0u; landmark_idx < kNumLandmarks;
+       ++landmark_idx) {
+    if (sequential_result.wasTriangulationSuccessful(landmark_idx)) {
+      EXPECT_EQ(
+          sequential_result.p_G_fi[landmark_idx],
+          parallel_result.p_G_fi[landmark_idx]);
+    }
+  }
+}
+
+}  // namespace landmark_triangulation
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -1,3 +1,5 @@
+#include <vector>
+
 #include <Eigen/Core>
 
 #include <map-manager/map-manager.h>
@@ -43,6 +45,128 @@ TEST_F(ViMappingTest, TestLandmarkTriangulation) {
       kPrecision, kMinPassingLandmarkFraction);
 }
 
+TEST_F(ViMappingTest, TestDirtyLandmarkTriangulation) {
+  constexpr size_t kNumThreads = 4u;
+  vi_map::VIMap* map = test_app_.getMapMutable();
+
+  // A freshly loaded map has no pose snapshot, so everything is dirty.
+  vi_map::LandmarkIdList dirty_landmark_ids;
+  map->getDirtyLandmarks(kNumThreads, &dirty_landmark_ids);
+  EXPECT_EQ(dirty_landmark_ids.size(), map->numLandmarks());
+  map->clearDirtyState(kNumThreads);
+  map->getDirtyLandmarks(kNumThreads, &dirty_landmark_ids);
+  EXPECT_TRUE(dirty_landmark_ids.empty());
+
+  // Moving a vertex makes the landmarks it stores and observes dirty.
+  pose_graph::VertexIdList vertex_ids;
+  map->getAllVertexIds(&vertex_ids);
+  ASSERT_FALSE(vertex_ids.empty());
+  vi_map::Vertex& moved_vertex = map->getVertex(vertex_ids.front());
+  const pose::Transformation T_M_I = moved_vertex.get_T_M_I();
+  pose::Transformation T_I_I_moved;
+  T_I_I_moved.getPosition() << 0.1, 0.0, 0.0;
+  moved_vertex.set_T_M_I(T_M_I * T_I_I_moved);
+  pose_graph::VertexIdList dirty_vertex_ids;
+  map->getDirtyVertices(kNumThreads, &dirty_vertex_ids);
+  ASSERT_EQ(dirty_vertex_ids.size(), 1u);
+  EXPECT_EQ(dirty_vertex_ids.front(), moved_vertex.id());
+  map->getDirtyLandmarks(kNumThreads, &dirty_landmark_ids);
+  vi_map::LandmarkIdList stored_landmark_ids;
+  moved_vertex.getStoredLandmarkIdList(&stored_landmark_ids);
+  EXPECT_GE(dirty_landmark_ids.size(), stored_landmark_ids.size());
+  EXPECT_LT(dirty_landmark_ids.size(), map->numLandmarks());
+  moved_vertex.set_T_M_I(T_M_I);
+  map->getDirtyLandmarks(kNumThreads, &dirty_landmark_ids);
+  EXPECT_TRUE(dirty_landmark_ids.empty());
+
+  // Once all vertices are dirty, retriangulating the dirty landmarks in
+  // parallel matches the full retriangulation.
+  corruptLandmarks();
+  for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+    map->markVertexDirty(vertex_id);
+  }
+  EXPECT_EQ(
+      retriangulateDirtyLandmarks(kNumThreads, map), map->numLandmarks());
+  EXPECT_EQ(retriangulateDirtyLandmarks(kNumThreads, map), 0u);
+
+  vi_map::LandmarkIdList landmark_ids;
+  map->getAllLandmarkIds(&landmark_ids);
+  std::vector<Eigen::Vector3d> p_B_dirty;
+  for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
+    p_B_dirty.emplace_back(map->getLandmark(landmark_id).get_p_B());
+  }
+  corruptLandmarks();
+  EXPECT_TRUE(retriangulateLandmarks(map));
+  for (size_t i = 0u; i < landmark_ids.size(); ++i) {
+    EXPECT_NEAR_EIGEN(
+        map->getLandmark(landmark_ids[i]).get_p_B(), p_B_dirty[i], 1e-12);
+  }
+}
+
+TEST_F(ViMappingTest, TestDirtyLandmarkTriangulationAfterLoopClosureMerge) {
+  constexpr size_t kNumThreads = 4u;
+  vi_map::VIMap* map = test_app_.getMapMutable();
+  EXPECT_TRUE(retriangulateLandmarks(map));
+
+  // The map operations of the loop closure handler: landmarks of the query
+  // vertex are merged into map landmarks and query keypoints without a
+  // landmark are associated with map landmarks.
+  pose_graph::VertexIdList vertex_ids;
+  map->getAllVertexIds(&vertex_ids);
+  ASSERT_GE(vertex_ids.size(), 2u);
+  const vi_map::Vertex& query_vertex = map->getVertex(vertex_ids.back());
+  const vi_map::Vertex& map_vertex = map->getVertex(vertex_ids.front());
+  vi_map::LandmarkIdList query_landmark_ids;
+  query_vertex.getStoredLandmarkIdList(&query_landmark_ids);
+  vi_map::LandmarkIdList map_landmark_ids;
+  map_vertex.getStoredLandmarkIdList(&map_landmark_ids);
+  constexpr size_t kNumMerges = 5u;
+  ASSERT_GE(query_landmark_ids.size(), kNumMerges);
+  ASSERT_GE(map_landmark_ids.size(), kNumMerges + 1u);
+  for (size_t i = 0u; i < kNumMerges; ++i) {
+    map->mergeLandmarks(query_landmark_ids[i], map_landmark_ids[i]);
+  }
+  const vi_map::LandmarkId& reassociated_landmark_id =
+      map_landmark_ids[kNumMerges];
+  bool has_reassociated_keypoint = false;
+  for (size_t frame_idx = 0u;
+       frame_idx < query_vertex.numFrames() && !has_reassociated_keypoint;
+       ++frame_idx) {
+    const vi_map::LandmarkIdList& observed_landmark_ids =
+        query_vertex.getFrameObservedLandmarkIds(frame_idx);
+    for (size_t keypoint_idx = 0u; keypoint_idx < observed_landmark_ids.size();
+         ++keypoint_idx) {
+      if (!observed_landmark_ids[keypoint_idx].isValid()) {
+        map->associateKeypointWithExistingLandmark(
+            query_vertex.id(), frame_idx, keypoint_idx,
+            reassociated_landmark_id);
+        has_reassociated_keypoint = true;
+        break;
+      }
+    }
+  }
+  ASSERT_TRUE(has_reassociated_keypoint);
+
+  vi_map::LandmarkIdList dirty_landmark_ids;
+  map->getDirtyLandmarks(kNumThreads, &dirty_landmark_ids);
+  EXPECT_EQ(dirty_landmark_ids.size(), kNumMerges + 1u);
+
+  // Retriangulating only the merged and reassociated landmarks gives the same
+  // map as retriangulating all landmarks.
+  EXPECT_EQ(retriangulateDirtyLandmarks(kNumThreads, map), kNumMerges + 1u);
+  vi_map::LandmarkIdList landmark_ids;
+  map->getAllLandmarkIds(&landmark_ids);
+  std::vector<Eigen::Vector3d> p_B_dirty;
+  for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
+    p_B_dirty.emplace_back(map->getLandmark(landmark_id).get_p_B());
+  }
+  EXPECT_TRUE(retriangulateLandmarks(map));
+  for (size_t i = 0u; i < landmark_ids.size(); ++i) {
+    EXPECT_NEAR_EIGEN(
+        map->getLandmark(landmark_ids[i]).get_p_B(), p_B_dirty[i], 1e-12);
+  }
+}
+
 void checkLandmarkQualityInView(
     const vi_map::VIMap& map, int expected_num_unknown_quality,
     int expected_num_good_quality, int expected_num_bad_quality) {
@@ -167,6 +167,7 @@ void alignAndCooptimizeMissionsWithoutLandmarkMerge(
         revert_item.frame_index_query, revert_item.keypoint_index_query,
         revert_item.landmark_result);
   }
+  map->dropCovisibilityGraph();
 }
 
 }  // namespace localization_evaluator
@@ -2,6 +2,7 @@
 #define INVERTED_MULTI_INDEX_INVERTED_MULTI_INDEX_COMMON_H_
 
 #include <algorithm>
+#include <cstdint>
 #include <functional>
 #include <limits>
 #include <queue>
@@ -229,6 +230,50 @@ void AddDescriptor(
   }
 }
 
+// Adds the dimensions and the coefficients of the given matrix to a 64 bit
+// FNV-1a hash.
+inline void AddMatrixToFingerprint(
+    const Eigen::MatrixXf& matrix, uint64_t* fingerprint) {
+  CHECK_NOTNULL(fingerprint);
+  constexpr uint64_t kFnvPrime = 1099511628211ull;
+  auto hash_bytes = [fingerprint](const void* data, size_t num_bytes) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0u; i < num_bytes; ++i) {
+      *fingerprint ^= bytes[i];
+      *fingerprint *= kFnvPrime;
+    }
+  };
+  const int64_t rows = matrix.rows();
+  const int64_t cols = matrix.cols();
+  hash_bytes(&rows, sizeof(rows));
+  hash_bytes(&cols, sizeof(cols));
+  hash_bytes(matrix.data(), sizeof(float) * matrix.size());
+}
+
+// Computes a fingerprint (64 bit FNV-1a hash) of the two lower dimensional
+// vocabularies that form the product vocabulary. It is used to verify that
+// precomputed visual word assignments refer to the same vocabulary.
+inline uint64_t ComputeVocabularyFingerprint(
+    const Eigen::MatrixXf& words_1, const Eigen::MatrixXf& words_2) {
+  constexpr uint64_t kFnvOffsetBasis = 14695981039346656037ull;
+  uint64_t fingerprint = kFnvOffsetBasis;
+  AddMatrixToFingerprint(words_1, &fingerprint);
+  AddMatrixToFingerprint(words_2, &fingerprint);
+  return fingerprint;
+}
+
+// Same as above, but additionally covers the cluster centers of the product
+// quantizers used to encode the residuals.
+inline uint64_t ComputeVocabularyFingerprint(
+    const Eigen::MatrixXf& words_1, const Eigen::MatrixXf& words_2,
+    const Eigen::MatrixXf& quantizer_centers_1,
+    const Eigen::MatrixXf& quantizer_centers_2) {
+  uint64_t fingerprint = ComputeVocabularyFingerprint(words_1, words_2);
+  AddMatrixToFingerprint(quantizer_centers_1, &fingerprint);
+  AddMatrixToFingerprint(quantizer_centers_2, &fingerprint);
+  return fingerprint;
+}
+
 }  // namespace common
 }  // namespace inverted_multi_index
 }  // namespace loop_closure
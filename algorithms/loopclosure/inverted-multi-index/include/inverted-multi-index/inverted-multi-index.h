@@ -57,7 +57,9 @@ class InvertedMultiIndex {
             common::NNSearch::createKDTreeLinearHeap(
                 words_2_, kDimSubVectors, common::kCollectTouchStatistics)),
         num_closest_words_for_nn_search_(num_closest_words_for_nn_search),
-        max_db_descriptor_index_(0) {
+        max_db_descriptor_index_(0),
+        vocabulary_fingerprint_(
+            common::ComputeVocabularyFingerprint(words_1_, words_2_)) {
     CHECK_EQ(words_1.rows(), kDimSubVectors);
     CHECK_GT(words_1.cols(), 0);
     CHECK_EQ(words_2.rows(), kDimSubVectors);
@@ -82,22 +84,89 @@ class InvertedMultiIndex {
     max_db_descriptor_index_ = 0;
   }
 
+  // Returns a fingerprint of the product vocabulary. Visual word indices
+  // computed with GetWordIndex are only valid for indices with the same
+  // fingerprint.
+  inline uint64_t GetVocabularyFingerprint() const {
+    return vocabulary_fingerprint_;
+  }
+
+  // Returns the index of the visual word of the product vocabulary the given
+  // descriptor is assigned to.
+  // This function is thread-safe.
+  template <typename DerivedQuery>
+  inline int GetWordIndex(
+      const Eigen::MatrixBase<DerivedQuery>& descriptor) const {
+    std::vector<std::pair<int, int> > closest_word;
+    common::FindClosestWords<kDimSubVectors>(
+        descriptor, 1, *words_1_index_, *words_2_index_, words_1_.cols(),
+        words_2_.cols(), &closest_word);
+    CHECK(!closest_word.empty());
+    return closest_word[0].first * words_2_.cols() + closest_word[0].second;
+  }
+
+  // Returns the number of words of the product vocabulary.
+  inline int GetNumWords() const {
+    return words_1_.cols() * words_2_.cols();
+  }
+
+  // Returns the indices of the words of the product vocabulary that are
+  // searched for neighbors of the given query, in ascending order of distance.
+  // This function is thread-safe.
+  template <typename DerivedQuery>
+  inline void GetClosestWordIndices(
+      const Eigen::MatrixBase<DerivedQuery>& query_feature,
+      std::vector<int>* word_indices) const {
+    CHECK_NOTNULL(word_indices)->clear();
+    std::vector<std::pair<int, int> > closest_words;
+    common::FindClosestWords<kDimSubVectors>(
+        query_feature, num_closest_words_for_nn_search_, *words_1_index_,
+        *words_2_index_, words_1_.cols(), words_2_.cols(), &closest_words);
+    word_indices->reserve(closest_words.size());
+    for (const std::pair<int, int>& closest_word : closest_words) {
+      word_indices->push_back(
+          closest_word.first * words_2_.cols() + closest_word.second);
+    }
+  }
+
+  // Calls the given function with the word index and the inverted file of
+  // every word that has descriptors assigned, in no particular order.
+  inline void ForEachInvertedFile(
+      const std::function<void(int, const InvFile&)>& function) const {
+    for (const std::pair<int, int>& word_index_element : word_index_map_) {
+      function(
+          word_index_element.first,
+          inverted_files_[word_index_element.second]);
+    }
+  }
+
   // Adds a set of database descriptors to the inverted multi-index.
   // Each column defines a database descriptor.
   void AddDescriptors(const DescriptorMatrixType& descriptors) {
     const int num_descriptors = descriptors.cols();
-    std::vector<std::pair<int, int> > closest_word;
-
     for (int i = 0; i < num_descriptors; ++i) {
-      common::FindClosestWords<kDimSubVectors>(
-          descriptors.col(i), 1, *words_1_index_, *words_2_index_,
-          words_1_.cols(), words_2_.cols(), &closest_word);
-      CHECK(!closest_word.empty());
-      const int word_index =
-          closest_word[0].first * words_2_.cols() + closest_word[0].second;
+      common::AddDescriptor<float, 2 * kDimSubVectors>(
+          descriptors.col(i), max_db_descriptor_index_,
+          GetWordIndex(descriptors.col(i)), &word_index_map_,
+          &inverted_files_);
+      ++max_db_descriptor_index_;
+    }
+  }
 
+  // Adds a set of database descriptors for which the visual words have already
+  // been computed using GetWordIndex. This skips the search in the vocabulary
+  // and is therefore considerably cheaper than AddDescriptors.
+  void AddDescriptors(
+      const DescriptorMatrixType& descriptors,
+      const Eigen::VectorXi& word_indices) {
+    const int num_descriptors = descriptors.cols();
+    CHECK_EQ(num_descriptors, word_indices.rows());
+    const int num_words = words_1_.cols() * words_2_.cols();
+    for (int i = 0; i < num_descriptors; ++i) {
+      CHECK_GE(word_indices(i), 0);
+      CHECK_LT(word_indices(i), num_words);
       common::AddDescriptor<float, 2 * kDimSubVectors>(
-          descriptors.col(i), max_db_descriptor_index_, word_index,
+          descriptors.col(i), max_db_descriptor_index_, word_indices(i),
           &word_index_map_, &inverted_files_);
       ++max_db_descriptor_index_;
     }
@@ -130,21 +199,16 @@ class InvertedMultiIndex {
         const_cast<Eigen::MatrixBase<DerivedDistances>&>(out_distances);
 
     // Finds the closest visual words.
-    std::vector<std::pair<int, int> > closest_words;
-    common::FindClosestWords<kDimSubVectors>(
-        query_feature, num_closest_words_for_nn_search_, *words_1_index_,
-        *words_2_index_, words_1_.cols(), words_2_.cols(), &closest_words);
+    std::vector<int> closest_word_indices;
+    GetClosestWordIndices(query_feature, &closest_word_indices);
 
     // Performs exhaustive search through all descriptors assigned to the
     // closest words.
     std::vector<std::pair<float, int> > nearest_neighbors;
     nearest_neighbors.reserve(num_neighbors + 1);
-    const int num_words_to_use = static_cast<int>(closest_words.size());
     std::unordered_map<int, int>::const_iterator word_index_map_it;
 
-    for (int i = 0; i < num_words_to_use; ++i) {
-      const int word_index =
-          closest_words[i].first * words_2_.cols() + closest_words[i].second;
+    for (const int word_index : closest_word_indices) {
       word_index_map_it = word_index_map_.find(word_index);
       if (word_index_map_it == word_index_map_.end())
         continue;
@@ -284,6 +348,8 @@ class InvertedMultiIndex {
   Aligned<std::vector, InvFile> inverted_files_;
   // The maximum index of the descriptor indices.
   int max_db_descriptor_index_;
+  // Identifies the product vocabulary, see GetVocabularyFingerprint.
+  uint64_t vocabulary_fingerprint_;
 };
 }  // namespace inverted_multi_index
 }  // namespace loop_closure
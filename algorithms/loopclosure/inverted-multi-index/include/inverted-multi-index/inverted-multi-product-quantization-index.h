@@ -2,6 +2,7 @@
 #define INVERTED_MULTI_INDEX_INVERTED_MULTI_PRODUCT_QUANTIZATION_INDEX_H_
 
 #include <algorithm>
+#include <cstdint>
 #include <functional>
 #include <limits>
 #include <queue>
@@ -50,6 +51,8 @@ class InvertedMultiProductQuantizationIndex {
   typedef Eigen::Matrix<float, kOriginalDescDim / 2, 1> HalfInputDescriptorType;
   // The type of the quantized descriptors that is stored.
   typedef Eigen::Matrix<DataType, kNumComponents, 1> StoredDescriptorType;
+  typedef Eigen::Matrix<DataType, kNumComponents, Eigen::Dynamic>
+      StoredDescriptorMatrixType;
 
   typedef common::InvertedFile<DataType, kNumComponents> InvFile;
   typedef product_quantization::ProductQuantization<
@@ -81,7 +84,9 @@ class InvertedMultiProductQuantizationIndex {
                 words_2_, kOriginalDescDim / 2,
                 common::kCollectTouchStatistics)),
         num_closest_words_for_nn_search_(num_closest_words_for_nn_search),
-        max_db_descriptor_index_(0) {
+        max_db_descriptor_index_(0),
+        vocabulary_fingerprint_(common::ComputeVocabularyFingerprint(
+            words_1, words_2, quantizer_centers_1, quantizer_centers_2)) {
     static_assert(
         kNumComponents % 2 == 0,
         "The number of components needs to be a multiple of 2.");
@@ -101,7 +106,7 @@ class InvertedMultiProductQuantizationIndex {
     CHECK_EQ(quantizer_centers_1.rows(), kNumDimPerComp);
     CHECK_EQ(quantizer_centers_2.rows(), kNumDimPerComp);
     CHECK_EQ(quantizer_centers_1.cols(), num_cols_per_pq * words_1.cols());
-    CHECK_EQ(quantizer_centers_1.cols(), num_cols_per_pq * words_1.cols());
+    CHECK_EQ(quantizer_centers_2.cols(), num_cols_per_pq * words_2.cols());
 
     CHECK_GT(num_closest_words_for_nn_search_, 0);
 
@@ -114,7 +119,7 @@ class InvertedMultiProductQuantizationIndex {
 
     quantizers_words_2_.resize(words_2.cols());
     index = 0;
-    for (int i = 0; i < words_1.cols(); ++i, index += num_cols_per_pq) {
+    for (int i = 0; i < words_2.cols(); ++i, index += num_cols_per_pq) {
       quantizers_words_2_[i].SetClusterCenters(
           quantizer_centers_2.block<kNumDimPerComp, num_cols_per_pq>(0, index));
     }
@@ -129,6 +134,13 @@ class InvertedMultiProductQuantizationIndex {
     return max_db_descriptor_index_;
   }
 
+  // Identifies the vocabulary and the product quantizers. Quantized
+  // descriptors can only be added to an index with the same fingerprint as the
+  // index they were quantized with.
+  inline uint64_t GetVocabularyFingerprint() const {
+    return vocabulary_fingerprint_;
+  }
+
   // Clears the inverted multi-index by removing all references to the database
   // descriptors stored in it. Does NOT remove the underlying quantization.
   inline void Clear() {
@@ -141,38 +153,10 @@ class InvertedMultiProductQuantizationIndex {
   // Each column defines a database descriptor.
   void AddDescriptors(const InputDescriptorMatrixType& descriptors) {
     const int num_descriptors = descriptors.cols();
-    std::vector<std::pair<int, int> > closest_word;
-
+    int word_index;
+    StoredDescriptorType quantized_residual;
     for (int i = 0; i < num_descriptors; ++i) {
-      common::FindClosestWords<kOriginalDescDim / 2>(
-          descriptors.col(i), 1, *words_1_index_, *words_2_index_,
-          words_1_.cols(), words_2_.cols(), &closest_word);
-      CHECK(!closest_word.empty());
-      const int word1 = closest_word[0].first;
-      const int word2 = closest_word[0].second;
-      const int word_index = word1 * words_2_.cols() + word2;
-
-      // Quantizes the descriptor using the product quantizers belonging to the
-      // product word: We first compute the residual between the descriptor and
-      // the cluster center before quantizing the residual.
-      HalfInputDescriptorType residual_part_1;
-      ComputeResidual(
-          descriptors.col(i).template head<kOriginalDescDim / 2>(), words_1_,
-          word1, &residual_part_1);
-      HalfInputDescriptorType residual_part_2;
-      ComputeResidual(
-          descriptors.col(i).template tail<kOriginalDescDim / 2>(), words_2_,
-          word2, &residual_part_2);
-
-      StoredDescriptorType quantized_residual;
-      Eigen::Matrix<DataType, kHalfNumComponents, 1> quantized_part;
-      quantizers_words_1_[closest_word[0].first].Quantize(
-          residual_part_1, &quantized_part);
-      quantized_residual.template head<kHalfNumComponents>() = quantized_part;
-      quantizers_words_2_[closest_word[0].second].Quantize(
-          residual_part_2, &quantized_part);
-      quantized_residual.template tail<kHalfNumComponents>() = quantized_part;
-
+      QuantizeDescriptor(descriptors.col(i), &word_index, &quantized_residual);
       common::AddDescriptor<DataType, kNumComponents>(
           quantized_residual, max_db_descriptor_index_, word_index,
           &word_index_map_, &inverted_files_);
@@ -180,6 +164,63 @@ class InvertedMultiProductQuantizationIndex {
     }
   }
 
+  // Adds a set of database descriptors that were already quantized with
+  // QuantizeDescriptor, e.g. by an index with the same vocabulary fingerprint.
+  // Each column of quantized_residuals holds the product quantized residual of
+  // the descriptor assigned to the word with the same index in word_indices.
+  void AddQuantizedDescriptors(
+      const StoredDescriptorMatrixType& quantized_residuals,
+      const Eigen::VectorXi& word_indices) {
+    CHECK_EQ(quantized_residuals.cols(), word_indices.rows());
+    const int num_words = words_1_.cols() * words_2_.cols();
+    for (int i = 0; i < word_indices.rows(); ++i) {
+      CHECK_GE(word_indices(i), 0);
+      CHECK_LT(word_indices(i), num_words);
+      for (int j = 0; j < kNumComponents; ++j) {
+        CHECK_LT(static_cast<int>(quantized_residuals(j, i)), kNumCenters);
+      }
+      common::AddDescriptor<DataType, kNumComponents>(
+          quantized_residuals.col(i), max_db_descriptor_index_,
+          word_indices(i), &word_index_map_, &inverted_files_);
+      ++max_db_descriptor_index_;
+    }
+  }
+
+  // Assigns the descriptor to the closest word of the product vocabulary and
+  // quantizes the residual with the product quantizers belonging to the word:
+  // We first compute the residual between the descriptor and the cluster
+  // center before quantizing the residual.
+  template <typename DerivedQuery>
+  void QuantizeDescriptor(
+      const Eigen::MatrixBase<DerivedQuery>& descriptor, int* word_index,
+      StoredDescriptorType* quantized_residual) const {
+    CHECK_NOTNULL(word_index);
+    CHECK_NOTNULL(quantized_residual);
+    std::vector<std::pair<int, int> > closest_word;
+    common::FindClosestWords<kOriginalDescDim / 2>(
+        descriptor, 1, *words_1_index_, *words_2_index_, words_1_.cols(),
+        words_2_.cols(), &closest_word);
+    CHECK(!closest_word.empty());
+    const int word1 = closest_word[0].first;
+    const int word2 = closest_word[0].second;
+    *word_index = word1 * words_2_.cols() + word2;
+
+    HalfInputDescriptorType residual_part_1;
+    ComputeResidual(
+        descriptor.template head<kOriginalDescDim / 2>(), words_1_, word1,
+        &residual_part_1);
+    HalfInputDescriptorType residual_part_2;
+    ComputeResidual(
+        descriptor.template tail<kOriginalDescDim / 2>(), words_2_, word2,
+        &residual_part_2);
+
+    Eigen::Matrix<DataType, kHalfNumComponents, 1> quantized_part;
+    quantizers_words_1_[word1].Quantize(residual_part_1, &quantized_part);
+    quantized_residual->template head<kHalfNumComponents>() = quantized_part;
+    quantizers_words_2_[word2].Quantize(residual_part_2, &quantized_part);
+    quantized_residual->template tail<kHalfNumComponents>() = quantized_part;
+  }
+
   // Finds the n nearest neighbors for a given query feature.
   // This function is thread-safe.
   template <typename DerivedQuery, typename DerivedIndices,
@@ -333,6 +374,8 @@ class InvertedMultiProductQuantizationIndex {
   Aligned<std::vector, InvFile> inverted_files_;
   // The maximum index of the descriptor indices.
   int max_db_descriptor_index_;
+  // Fingerprint of the vocabulary and the product quantizers.
+  uint64_t vocabulary_fingerprint_;
 };
 }  // namespace inverted_multi_index
 }  // namespace loop_closure
@@ -1,3 +1,4 @@
+#include <random>
 #include <utility>
 #include <vector>
 
@@ -8,6 +9,7 @@
 
 #include <inverted-multi-index/inverted-multi-index-common.h>
 #include <inverted-multi-index/inverted-multi-index.h>
+#include <inverted-multi-index/inverted-multi-product-quantization-index.h>
 
 namespace loop_closure {
 namespace inverted_multi_index {
@@ -228,6 +230,174 @@ TEST_F(InvertedMultiIndexTest, GetNNearestNeighborsWorks) {
             expected_indices.block(0, 0, num_elements, 1), 1e-9));
   }
 }
+
+TEST_F(InvertedMultiIndexTest, AddDescriptorsWithPrecomputedWordsWorks) {
+  FLAGS_lc_knn_epsilon = 0.2;
+
+  constexpr int kNumDescriptors = 200;
+  Eigen::MatrixXf descriptors =
+      (Eigen::MatrixXf::Random(6, kNumDescriptors).array() + 1.f) / 2.f;
+
+  TestableInvertedMultiIndex index(words1_, words2_, 10);
+  TestableInvertedMultiIndex precomputed_index(words1_, words2_, 10);
+  ASSERT_EQ(
+      index.GetVocabularyFingerprint(),
+      precomputed_index.GetVocabularyFingerprint());
+
+  Eigen::VectorXi word_indices(kNumDescriptors);
+  for (int i = 0; i < kNumDescriptors; ++i) {
+    word_indices(i) = index.GetWordIndex(descriptors.col(i));
+  }
+  index.AddDescriptors(descriptors);
+  precomputed_index.AddDescriptors(descriptors, word_indices);
+
+  EXPECT_EQ(
+      index.max_db_descriptor_index_,
+      precomputed_index.max_db_descriptor_index_);
+  ASSERT_EQ(index.word_index_map_, precomputed_index.word_index_map_);
+  ASSERT_EQ(
+      index.inverted_files_.size(), precomputed_index.inverted_files_.size());
+  for (size_t i = 0u; i < index.inverted_files_.size(); ++i) {
+    EXPECT_EQ(
+        index.inverted_files_[i].indices_,
+        precomputed_index.inverted_files_[i].indices_);
+    ASSERT_EQ(
+        index.inverted_files_[i].descriptors_.size(),
+        precomputed_index.inverted_files_[i].descriptors_.size());
+    for (size_t j = 0u; j < index.inverted_files_[i].descriptors_.size();
+         ++j) {
+      EXPECT_NEAR_EIGEN(
+          index.inverted_files_[i].descriptors_[j],
+          precomputed_index.inverted_files_[i].descriptors_[j], 1e-12);
+    }
+  }
+
+  // A different vocabulary must not share the fingerprint.
+  Eigen::MatrixXf other_words2 = words2_;
+  other_words2(0, 0) += 0.1f;
+  TestableInvertedMultiIndex other_index(words1_, other_words2, 10);
+  EXPECT_NE(
+      index.GetVocabularyFingerprint(), other_index.GetVocabularyFingerprint());
+}
+
+// Fraction of the queries whose source descriptor is among the neighbors.
+double computeRecall(const Eigen::MatrixXi& indices) {
+  int num_found = 0;
+  for (int query_idx = 0; query_idx < indices.cols(); ++query_idx) {
+    num_found += (indices.col(query_idx).array() == query_idx).any() ? 1 : 0;
+  }
+  return static_cast<double>(num_found) / indices.cols();
+}
+
+TEST(InvertedMultiIndexRecallTest, ProductQuantizedRecallMatchesUncompressed) {
+  constexpr int kDimSubVectors = 2;
+  constexpr int kNumComponents = 4;
+  constexpr int kNumCenters = 16;
+  constexpr int kNumWords = 4;
+  constexpr int kNumDescriptors = 10000;
+  constexpr int kNumQueries = 200;
+  constexpr int kNumNeighbors = 5;
+  constexpr int kNumClosestWords = 4;
+  constexpr float kDescriptorSigma = 0.5f;
+  constexpr float kQuerySigma = 0.1f;
+  typedef InvertedMultiProductQuantizationIndex<unsigned char, kNumComponents,
+                                                1, kNumCenters>
+      ProductQuantizationIndex;
+
+  // Descriptors scattered around the words of a fixed product vocabulary.
+  FLAGS_lc_knn_epsilon = 0.0;
+  std::mt19937 random_engine(42u);
+  std::uniform_real_distribution<float> word_distribution(-4.f, 4.f);
+  std::normal_distribution<float> descriptor_noise(0.f, kDescriptorSigma);
+  std::normal_distribution<float> query_noise(0.f, kQuerySigma);
+  std::uniform_int_distribution<int> word_index_distribution(
+      0, kNumWords - 1);
+  Eigen::MatrixXf words_1(kDimSubVectors, kNumWords);
+  Eigen::MatrixXf words_2(kDimSubVectors, kNumWords);
+  for (int i = 0; i < words_1.size(); ++i) {
+    words_1(i) = word_distribution(random_engine);
+    words_2(i) = word_distribution(random_engine);
+  }
+  Eigen::MatrixXf descriptors(2 * kDimSubVectors, kNumDescriptors);
+  for (int col = 0; col < kNumDescriptors; ++col) {
+    descriptors.col(col).head<kDimSubVectors>() =
+        words_1.col(word_index_distribution(random_engine));
+    descriptors.col(col).tail<kDimSubVectors>() =
+        words_2.col(word_index_distribution(random_engine));
+    for (int row = 0; row < descriptors.rows(); ++row) {
+      descriptors(row, col) += descriptor_noise(random_engine);
+    }
+  }
+  // The query i is a noisy copy of the database descriptor i.
+  Eigen::MatrixXf queries = descriptors.leftCols(kNumQueries);
+  for (int i = 0; i < queries.size(); ++i) {
+    queries(i) += query_noise(random_engine);
+  }
+
+  // Scalar quantizers uniformly covering +-3 sigma of the residuals, the same
+  // for every word and component.
+  Eigen::MatrixXf quantizer_centers(1, kNumComponents / 2 * kNumCenters);
+  for (int component = 0; component < kNumComponents / 2; ++component) {
+    for (int center = 0; center < kNumCenters; ++center) {
+      quantizer_centers(0, component * kNumCenters + center) =
+          kDescriptorSigma *
+          (-3.f + 6.f * (center + 0.5f) / static_cast<float>(kNumCenters));
+    }
+  }
+  const Eigen::MatrixXf quantizer_centers_1 =
+      quantizer_centers.replicate(1, kNumWords);
+  const Eigen::MatrixXf quantizer_centers_2 = quantizer_centers_1;
+
+  InvertedMultiIndex<kDimSubVectors> index(
+      words_1, words_2, kNumClosestWords);
+  index.AddDescriptors(descriptors);
+  ProductQuantizationIndex product_quantization_index(
+      words_1, words_2, quantizer_centers_1, quantizer_centers_2,
+      kNumClosestWords);
+  product_quantization_index.AddDescriptors(descriptors);
+
+  // Summary maps insert descriptors that were quantized beforehand.
+  ProductQuantizationIndex prequantized_index(
+      words_1, words_2, quantizer_centers_1, quantizer_centers_2,
+      kNumClosestWords);
+  Eigen::VectorXi word_indices(kNumDescriptors);
+  ProductQuantizationIndex::StoredDescriptorMatrixType quantized_residuals(
+      kNumComponents, kNumDescriptors);
+  for (int i = 0; i < kNumDescriptors; ++i) {
+    ProductQuantizationIndex::StoredDescriptorType quantized_residual;
+    prequantized_index.QuantizeDescriptor(
+        descriptors.col(i), &word_indices(i), &quantized_residual);
+    quantized_residuals.col(i) = quantized_residual;
+  }
+  prequantized_index.AddQuantizedDescriptors(
+      quantized_residuals, word_indices);
+
+  Eigen::MatrixXi indices(kNumNeighbors, kNumQueries);
+  Eigen::MatrixXf distances(kNumNeighbors, kNumQueries);
+  Eigen::MatrixXi product_quantization_indices(kNumNeighbors, kNumQueries);
+  Eigen::MatrixXi prequantized_indices(kNumNeighbors, kNumQueries);
+  for (int i = 0; i < kNumQueries; ++i) {
+    const Eigen::Matrix<float, 2 * kDimSubVectors, 1> query = queries.col(i);
+    index.GetNNearestNeighbors(
+        query, kNumNeighbors, indices.col(i), distances.col(i));
+    product_quantization_index.GetNNearestNeighbors(
+        query, kNumNeighbors, product_quantization_indices.col(i),
+        distances.col(i));
+    prequantized_index.GetNNearestNeighbors(
+        query, kNumNeighbors, prequantized_indices.col(i), distances.col(i));
+  }
+
+  // With this seed, the recall is 0.98 for the uncompressed and 0.945 for the
+  // product quantized descriptors, i.e. the one byte per dimension codes cost
+  // a few percent of recall. The bounds leave some slack for the random number
+  // distributions of other standard libraries.
+  const double recall = computeRecall(indices);
+  const double product_quantization_recall =
+      computeRecall(product_quantization_indices);
+  EXPECT_GE(recall, 0.95);
+  EXPECT_GE(product_quantization_recall, recall - 0.07);
+  EXPECT_EQ(prequantized_indices, product_quantization_indices);
+}
 }  // namespace
 }  // namespace inverted_multi_index
 }  // namespace loop_closure
@@ -157,6 +157,67 @@ TEST_F(InvertedMultiProductQuantizationIndexTest, GetNNearestNeighborsWorks) {
   EXPECT_THAT(actual_distances, ContainerEq(expected_distances));
   EXPECT_THAT(actual_indices, ContainerEq(expected_indices));
 }
+
+TEST_F(
+    InvertedMultiProductQuantizationIndexTest,
+    AddQuantizedDescriptorsWorks) {
+  TestableInvertedMultiPQIndex index(
+      words1_, words2_, quantizer_centers_1_, quantizer_centers_2_, 16);
+  TestableInvertedMultiPQIndex precomputed_index(
+      words1_, words2_, quantizer_centers_1_, quantizer_centers_2_, 16);
+  EXPECT_EQ(
+      index.GetVocabularyFingerprint(),
+      precomputed_index.GetVocabularyFingerprint());
+
+  Eigen::VectorXi word_indices(descriptors_.cols());
+  TestableInvertedMultiPQIndex::StoredDescriptorMatrixType quantized_residuals(
+      4, descriptors_.cols());
+  for (int i = 0; i < descriptors_.cols(); ++i) {
+    TestableInvertedMultiPQIndex::StoredDescriptorType quantized_residual;
+    index.QuantizeDescriptor(
+        descriptors_.col(i), &word_indices(i), &quantized_residual);
+    quantized_residuals.col(i) = quantized_residual;
+  }
+  EXPECT_EQ(0, word_indices(0));
+  EXPECT_EQ(0, word_indices(1));
+  EXPECT_EQ(14, word_indices(2));
+  EXPECT_EQ(5, word_indices(3));
+  EXPECT_EQ(11, word_indices(4));
+
+  index.AddDescriptors(descriptors_);
+  precomputed_index.AddQuantizedDescriptors(quantized_residuals, word_indices);
+
+  EXPECT_EQ(
+      index.max_db_descriptor_index_,
+      precomputed_index.max_db_descriptor_index_);
+  EXPECT_THAT(
+      precomputed_index.word_index_map_, ContainerEq(index.word_index_map_));
+  ASSERT_EQ(
+      index.inverted_files_.size(), precomputed_index.inverted_files_.size());
+  for (size_t i = 0u; i < index.inverted_files_.size(); ++i) {
+    EXPECT_THAT(
+        precomputed_index.inverted_files_[i].indices_,
+        ContainerEq(index.inverted_files_[i].indices_));
+    ASSERT_EQ(
+        index.inverted_files_[i].descriptors_.size(),
+        precomputed_index.inverted_files_[i].descriptors_.size());
+    for (size_t j = 0u; j < index.inverted_files_[i].descriptors_.size();
+         ++j) {
+      EXPECT_TRUE(
+          ::common::MatricesEqual(
+              index.inverted_files_[i].descriptors_[j],
+              precomputed_index.inverted_files_[i].descriptors_[j]));
+    }
+  }
+
+  // Changing the quantizers has to change the fingerprint.
+  Eigen::MatrixXf other_quantizer_centers_2 = quantizer_centers_2_;
+  other_quantizer_centers_2(0, 0) = -0.25;
+  TestableInvertedMultiPQIndex other_index(
+      words1_, words2_, quantizer_centers_1_, other_quantizer_centers_2, 16);
+  EXPECT_NE(
+      index.GetVocabularyFingerprint(), other_index.GetVocabularyFingerprint());
+}
 }  // namespace
 }  // namespace inverted_multi_index
 }  // namespace loop_closure
@@ -10,11 +10,13 @@
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
+#include <aslam/common/hash-id.h>
 #include <aslam/common/memory.h>
 #include <descriptor-projection/descriptor-projection.h>
 #include <localization-summary-map/unique-id.h>
 #include <loopclosure-common/types.h>
 #include <maplab-common/file-serializable.h>
+#include <maplab-common/mapped-memory.h>
 #include <vi-map/mission-baseframe.h>
 #include <vi-map/unique-id.h>
 #include <vi-map/vi-map.h>
@@ -65,9 +67,27 @@ class LoopDetectorNode final
       const vi_map::LandmarkIdSet& landmark_id_set,
       const vi_map::VIMap& map);
 
-  void addLocalizationSummaryMapToDatabase(
+  // Uses the precomputed visual words of the summary map if they were
+  // computed with the vocabulary of this loop detector. Returns false if the
+  // loop detector backend can't search the projected descriptors of summary
+  // maps.
+  bool addLocalizationSummaryMapToDatabase(
       const summary_map::LocalizationSummaryMap& localization_summary_map);
 
+  // Computes the visual word assignment of all summary map observations and
+  // stores it in the summary map. Returns false if the loop detector backend
+  // doesn't support precomputed visual words or if the summary map holds
+  // product quantized descriptors.
+  bool computeLocalizationSummaryMapWordIndices(
+      summary_map::LocalizationSummaryMap* localization_summary_map) const;
+
+  // Replaces the projected descriptors of the summary map by their product
+  // quantized representation w.r.t. the codebook of this loop detector.
+  // Returns false if the loop detector backend doesn't use product
+  // quantization.
+  bool productQuantizeLocalizationSummaryMap(
+      summary_map::LocalizationSummaryMap* localization_summary_map) const;
+
   bool findVertexInDatabase(
       const vi_map::Vertex& query_vertex, const bool merge_landmarks,
       const bool add_lc_edges, vi_map::VIMap* map, pose::Transformation* T_G_I,
@@ -88,6 +108,19 @@ class LoopDetectorNode final
       vi_map::VertexKeyPointToStructureMatchList* inlier_structure_matches)
       const;
 
+  // Localizes the nframe against the given subset of the summary map
+  // observations only, e.g. those of the landmarks close to a pose prior. The
+  // descriptors are matched exhaustively, such that the database doesn't need
+  // to contain the summary map and the cost only depends on the size of the
+  // subset. The matches are filtered like those of the database search.
+  bool findNFrameInSummaryMapObservations(
+      const aslam::VisualNFrame& n_frame, const bool skip_untracked_keypoints,
+      const summary_map::LocalizationSummaryMap& localization_summary_map,
+      const std::vector<int>& observation_indices, pose::Transformation* T_G_I,
+      unsigned int* num_of_lc_matches,
+      vi_map::VertexKeyPointToStructureMatchList* inlier_structure_matches)
+      const;
+
   void detectLoopClosuresMissionToDatabase(
       const MissionId& mission_id, const bool merge_landmarks,
       const bool add_lc_edges, int* num_vertex_candidate_links,
@@ -108,6 +141,10 @@ class LoopDetectorNode final
 
   std::string printStatus() const;
 
+  // Memory used by the projection matrix and the vocabulary, which every loop
+  // detector node loads on construction, independent of its database.
+  size_t getVocabularyNumBytes() const;
+
   void serialize(
       proto::LoopDetectorNode* proto_loop_detector_node) const override;
   void deserialize(
@@ -115,11 +152,52 @@ class LoopDetectorNode final
 
   static const std::string& getDefaultSerializationFilename();
 
+  // Publishes the database as a read-only shared memory object or file that
+  // other processes can attach to instead of building their own copy. If the
+  // database has been built from a single summary map, its ID is published
+  // along. The loop detector node owns the name: An existing object or file of
+  // the same name is replaced, e.g. one left behind by a crashed publisher,
+  // and the name is removed again once the node is destroyed. Processes that
+  // are attached keep their mapping in both cases.
+  bool publishMappedDatabase(
+      const common::MappedMemory::Type type, const std::string& name);
+  // Replaces the content of the database with a published one. The database
+  // stays read-only until it is cleared.
+  bool attachMappedDatabase(
+      const common::MappedMemory::Type type, const std::string& name);
+  // Same, for a database that has been built from the given summary map with
+  // addLocalizationSummaryMapToDatabase. Returns false if it has been
+  // published with the ID of another summary map.
+  bool attachMappedDatabase(
+      const common::MappedMemory::Type type, const std::string& name,
+      const summary_map::LocalizationSummaryMap& localization_summary_map);
+
  private:
   typedef std::vector<size_t> SupsampledToFullIndexMap;
   typedef std::unordered_map<loop_closure::KeyframeId, SupsampledToFullIndexMap>
       KeyframeToKeypointReindexMap;
 
+  // Attaches to a published database. If source_id is valid, the database
+  // must have been published with the same ID.
+  bool attachMappedDatabase(
+      const common::MappedMemory::Type type, const std::string& name,
+      const aslam::HashId& source_id);
+
+  // Converts all valid frames of the nframe with keypoints to projected
+  // images.
+  void convertLocalizationNFrameToProjectedImages(
+      const aslam::VisualNFrame& n_frame, const bool skip_untracked_keypoints,
+      loop_closure::ProjectedImagePtrList* projected_image_ptr_list,
+      KeyframeToKeypointReindexMap* keyframe_to_keypoint_reindexing,
+      std::vector<vi_map::LandmarkIdList>* query_vertex_observed_landmark_ids)
+      const;
+
+  // Maps the keypoint indices of the matches, which refer to the projected
+  // images, back to the keypoint indices of the frames.
+  void correctKeypointIndicesOfMatches(
+      const KeyframeToKeypointReindexMap& keyframe_to_keypoint_reindexing,
+      loop_closure::FrameToMatches* frame_matches_list) const;
+
   void findNearestNeighborMatchesForNFrame(
       const aslam::VisualNFrame& n_frame, const bool skip_untracked_keypoints,
       std::vector<vi_map::LandmarkIdList>* query_vertex_landmark_ids,
@@ -531,15 +531,11 @@ void LoopClosureHandler::updateQueryKeyframeInvalidLandmarkAssociations(
       // if we should not replace the id to the newer one.
       map_landmark_id = getLandmarkIdAfterMerges(map_landmark_id);
 
-      query_vertex->setObservedLandmarkId(
-          query_frame_idx, query_keypoint_idx, map_landmark_id);
-
-      vi_map::Vertex& map_landmark_vertex =
-          map_->getLandmarkStoreVertex(map_landmark_id);
-
-      map_landmark_vertex.getLandmarks()
-          .getLandmark(map_landmark_id).addObservation(
-              query_vertex->id(), query_frame_idx, query_keypoint_idx);
+      // Goes through the map, such that the landmark is marked dirty for the
+      // incremental retriangulation.
+      map_->associateKeypointWithExistingLandmark(
+          query_vertex->id(), query_frame_idx, query_keypoint_idx,
+          map_landmark_id);
     }
   }
 }
@@ -4,6 +4,7 @@
 #include <mutex>
 #include <sstream>  // NOLINT
 #include <string>
+#include <unordered_map>
 
 #include <Eigen/Geometry>
 #include <aslam/common/statistics/statistics.h>
@@ -17,6 +18,7 @@
 #include <maplab-common/geometry.h>
 #include <maplab-common/multi-threaded-progress-bar.h>
 #include <maplab-common/parallel-process.h>
+#include <maplab-common/profiler.h>
 #include <maplab-common/file-system-tools.h>
 #include <maplab-common/progress-bar.h>
 #include <matching-based-loopclosure/detector-settings.h>
@@ -33,6 +35,17 @@ DEFINE_bool(
     "If underconstrained landmarks should be filtered for the "
     "loop-closure.");
 DEFINE_bool(lc_use_random_pnp_seed, true, "Use random seed for pnp RANSAC.");
+DEFINE_bool(
+    lc_precompute_summary_map_word_indices, true,
+    "If the visual word assignment of the localization summary map should be "
+    "computed and stored alongside the map. This avoids quantizing all "
+    "summary map descriptors again when building the localization index.");
+DEFINE_bool(
+    lc_product_quantize_summary_map, false,
+    "If the descriptors of the localization summary map should only be stored "
+    "in product quantized form, using the codebook of the loop-closure "
+    "backend. Requires --lc_detector_engine="
+    "inverted_multi_index_product_quantization.");
 
 namespace loop_detector_node {
 LoopDetectorNode::LoopDetectorNode()
@@ -60,6 +73,11 @@ std::string LoopDetectorNode::printStatus() const {
   return ss.str();
 }
 
+size_t LoopDetectorNode::getVocabularyNumBytes() const {
+  CHECK(loop_detector_);
+  return loop_detector_->VocabularyNumBytes();
+}
+
 bool LoopDetectorNode::convertFrameMatchesToConstraint(
     const loop_closure::FrameIdMatchesPair& query_frame_id_and_matches,
     vi_map::LoopClosureConstraint* constraint_ptr) const {
@@ -292,6 +310,7 @@ bool LoopDetectorNode::hasMissionInDatabase(
 
 void LoopDetectorNode::addMissionToDatabase(
     const vi_map::MissionId& mission_id, const vi_map::VIMap& map) {
+  MAPLAB_PROFILE_ZONE("Loop Closure: Add mission to database");
   CHECK(map.hasMission(mission_id));
   missions_in_database_.emplace(mission_id);
 
@@ -313,10 +332,18 @@ void LoopDetectorNode::addVerticesToDatabase(
     progress_bar.increment();
     addVertexToDatabase(vertex_id, map);
   }
+  loop_detector_->FinishInsertions();
 }
 
-void LoopDetectorNode::addLocalizationSummaryMapToDatabase(
+bool LoopDetectorNode::addLocalizationSummaryMapToDatabase(
     const summary_map::LocalizationSummaryMap& localization_summary_map) {
+  MAPLAB_PROFILE_ZONE("Loop Closure: Add summary map to database");
+  if (!loop_detector_->SearchesProjectedDescriptors()) {
+    LOG(ERROR) << "The summary map stores projected descriptors, which the "
+               << "loop-closure backend can't search. The summary map was "
+               << "built for another --lc_detector_engine.";
+    return false;
+  }
   CHECK(
       summary_maps_in_database_.emplace(localization_summary_map.id()).second);
 
@@ -357,15 +384,61 @@ void LoopDetectorNode::addLocalizationSummaryMapToDatabase(
   vi_map::LandmarkIdList observed_landmark_ids;
   localization_summary_map.getAllLandmarkIds(&observed_landmark_ids);
 
-  const Eigen::MatrixXf& projected_descriptors =
-      localization_summary_map.projectedDescriptors();
-
-  const int descriptor_dimensionality = projected_descriptors.rows();
-
   const Eigen::Matrix<unsigned int, Eigen::Dynamic, 1>&
       observation_to_landmark_index =
           localization_summary_map.observationToLandmarkIndex();
 
+  // Product quantized descriptors can be added to the index directly if they
+  // were quantized with the codebook of the index. Otherwise, the projected
+  // descriptors are reconstructed from the codes.
+  bool use_product_quantized_descriptors = false;
+  Eigen::MatrixXf reconstructed_descriptors;
+  if (localization_summary_map.hasProductQuantizedDescriptors()) {
+    uint64_t vocabulary_fingerprint;
+    if (loop_detector_->GetProductQuantizationFingerprint(
+            &vocabulary_fingerprint) &&
+        vocabulary_fingerprint == localization_summary_map
+                                      .productQuantizationCodebook()
+                                      .vocabulary_fingerprint) {
+      use_product_quantized_descriptors = true;
+    } else {
+      LOG(WARNING) << "The product quantized descriptors of the summary map "
+                   << "don't match the current loop-closure backend. The "
+                   << "descriptors are approximately reconstructed instead.";
+      localization_summary_map.getProjectedDescriptors(
+          &reconstructed_descriptors);
+    }
+  }
+  const Eigen::MatrixXf& projected_descriptors =
+      localization_summary_map.hasProductQuantizedDescriptors()
+          ? reconstructed_descriptors
+          : localization_summary_map.projectedDescriptors();
+  const int descriptor_dimensionality = projected_descriptors.rows();
+  const Eigen::VectorXi& product_quantized_word_indices =
+      localization_summary_map.productQuantizedWordIndices();
+  const loop_closure::ProductQuantizedDescriptorMatrix&
+      product_quantized_residuals =
+          localization_summary_map.productQuantizedResiduals();
+  loop_closure::ProductQuantizedDescriptorMatrix quantized_residuals;
+
+  // Use the stored visual word assignment if it was computed with the same
+  // vocabulary, otherwise all descriptors need to be quantized again.
+  bool use_precomputed_word_indices = false;
+  if (localization_summary_map.hasObservationWordIndices()) {
+    uint64_t vocabulary_fingerprint;
+    if (loop_detector_->GetVocabularyFingerprint(&vocabulary_fingerprint) &&
+        vocabulary_fingerprint ==
+            localization_summary_map.vocabularyFingerprint()) {
+      use_precomputed_word_indices = true;
+    } else {
+      LOG(WARNING) << "The precomputed visual words of the summary map don't "
+                   << "match the current vocabulary and will be ignored.";
+    }
+  }
+  const Eigen::VectorXi& observation_word_indices =
+      localization_summary_map.observationWordIndices();
+  Eigen::VectorXi word_indices;
+
   for (size_t observer_idx = 0; observer_idx < observer_observations.size();
        ++observer_idx) {
     std::shared_ptr<loop_closure::ProjectedImage> projected_image_ptr =
@@ -384,14 +457,33 @@ void LoopDetectorNode::addLocalizationSummaryMapToDatabase(
     projected_image.landmarks.resize(observations.size());
     // Measurements have no meaning, so we add a zero block.
     projected_image.measurements.setZero(2, observations.size());
-    projected_image.projected_descriptors.resize(
-        descriptor_dimensionality, observations.size());
+    if (use_product_quantized_descriptors) {
+      word_indices.resize(observations.size());
+      quantized_residuals.resize(
+          product_quantized_residuals.rows(), observations.size());
+    } else {
+      projected_image.projected_descriptors.resize(
+          descriptor_dimensionality, observations.size());
+      if (use_precomputed_word_indices) {
+        word_indices.resize(observations.size());
+      }
+    }
 
     for (size_t i = 0; i < observations.size(); ++i) {
       const int observation_index = observations[i];
-      CHECK_LT(observation_index, projected_descriptors.cols());
-      projected_image.projected_descriptors.col(i) =
-          projected_descriptors.col(observation_index);
+      if (use_product_quantized_descriptors) {
+        CHECK_LT(observation_index, product_quantized_residuals.cols());
+        word_indices(i) = product_quantized_word_indices(observation_index);
+        quantized_residuals.col(i) =
+            product_quantized_residuals.col(observation_index);
+      } else {
+        CHECK_LT(observation_index, projected_descriptors.cols());
+        projected_image.projected_descriptors.col(i) =
+            projected_descriptors.col(observation_index);
+        if (use_precomputed_word_indices) {
+          word_indices(i) = observation_word_indices(observation_index);
+        }
+      }
 
       CHECK_LT(observation_index, observation_to_landmark_index.rows());
       const size_t landmark_index =
@@ -399,8 +491,97 @@ void LoopDetectorNode::addLocalizationSummaryMapToDatabase(
       CHECK_LT(landmark_index, observed_landmark_ids.size());
       projected_image.landmarks[i] = observed_landmark_ids[landmark_index];
     }
-    loop_detector_->Insert(projected_image_ptr);
+    if (use_product_quantized_descriptors) {
+      loop_detector_->InsertProductQuantized(
+          projected_image_ptr, word_indices, quantized_residuals);
+    } else if (use_precomputed_word_indices) {
+      loop_detector_->InsertWithWordIndices(projected_image_ptr, word_indices);
+    } else {
+      loop_detector_->Insert(projected_image_ptr);
+    }
+  }
+  loop_detector_->FinishInsertions();
+  return true;
+}
+
+bool LoopDetectorNode::computeLocalizationSummaryMapWordIndices(
+    summary_map::LocalizationSummaryMap* localization_summary_map) const {
+  CHECK_NOTNULL(localization_summary_map);
+  if (localization_summary_map->hasProductQuantizedDescriptors()) {
+    LOG(WARNING) << "The summary map holds product quantized descriptors, "
+                 << "which already contain their visual words.";
+    return false;
+  }
+  const Eigen::MatrixXf& projected_descriptors =
+      localization_summary_map->projectedDescriptors();
+  if (projected_descriptors.cols() == 0) {
+    return false;
+  }
+  Eigen::VectorXi word_indices;
+  uint64_t vocabulary_fingerprint;
+  if (!loop_detector_->ComputeWordIndices(
+          projected_descriptors, &word_indices, &vocabulary_fingerprint)) {
+    VLOG(1) << "The loop detector backend doesn't support precomputed "
+            << "visual words.";
+    return false;
+  }
+  localization_summary_map->setObservationWordIndices(
+      word_indices, vocabulary_fingerprint);
+  return true;
+}
+
+bool LoopDetectorNode::productQuantizeLocalizationSummaryMap(
+    summary_map::LocalizationSummaryMap* localization_summary_map) const {
+  CHECK_NOTNULL(localization_summary_map);
+  if (localization_summary_map->hasProductQuantizedDescriptors()) {
+    return true;
   }
+  const Eigen::MatrixXf& projected_descriptors =
+      localization_summary_map->projectedDescriptors();
+  if (projected_descriptors.cols() == 0) {
+    return false;
+  }
+  Eigen::VectorXi word_indices;
+  loop_closure::ProductQuantizedDescriptorMatrix quantized_residuals;
+  loop_closure::ProductQuantizationCodebook codebook;
+  if (!loop_detector_->ProductQuantizeDescriptors(
+          projected_descriptors, &word_indices, &quantized_residuals,
+          &codebook)) {
+    LOG(ERROR) << "The loop detector backend doesn't support product "
+               << "quantized descriptors. Use --lc_detector_engine="
+               << matching_based_loopclosure::
+                      kMatchingLDInvertedMultiIndexProductQuantizationString
+               << ".";
+    return false;
+  }
+
+  // Report how much memory is saved and how well the descriptors are
+  // approximated by the codes.
+  const size_t num_bytes_uncompressed =
+      localization_summary_map->getDescriptorMemoryBytes();
+  Eigen::MatrixXf reconstructed_descriptors;
+  codebook.reconstructDescriptors(
+      word_indices, quantized_residuals, &reconstructed_descriptors);
+  const double mean_squared_reconstruction_error =
+      (reconstructed_descriptors - projected_descriptors)
+          .colwise()
+          .squaredNorm()
+          .mean();
+  const double mean_squared_norm =
+      projected_descriptors.colwise().squaredNorm().mean();
+
+  localization_summary_map->setProductQuantizedDescriptors(
+      codebook, word_indices, quantized_residuals);
+  const size_t num_bytes_compressed =
+      localization_summary_map->getDescriptorMemoryBytes();
+  LOG(INFO) << "Product quantized " << word_indices.rows()
+            << " summary map descriptors: " << num_bytes_uncompressed
+            << " bytes -> " << num_bytes_compressed << " bytes (codebook: "
+            << codebook.getNumBytes() << " bytes), relative squared "
+            << "reconstruction error: "
+            << mean_squared_reconstruction_error /
+                   std::max(mean_squared_norm, 1e-12);
+  return true;
 }
 
 void LoopDetectorNode::addLandmarkSetToDatabase(
@@ -441,6 +622,7 @@ void LoopDetectorNode::addLandmarkSetToDatabase(
 
     loop_detector_->Insert(projected_image);
   }
+  loop_detector_->FinishInsertions();
 }
 
 bool LoopDetectorNode::findNFrameInSummaryMapDatabase(
@@ -449,6 +631,7 @@ bool LoopDetectorNode::findNFrameInSummaryMapDatabase(
     pose::Transformation* T_G_I, unsigned int* num_of_lc_matches,
     vi_map::VertexKeyPointToStructureMatchList* inlier_structure_matches)
     const {
+  MAPLAB_PROFILE_ZONE("Loop Closure: Find nframe in summary map");
   CHECK_NOTNULL(T_G_I);
   CHECK_NOTNULL(num_of_lc_matches);
   CHECK_NOTNULL(inlier_structure_matches);
@@ -493,6 +676,7 @@ bool LoopDetectorNode::findNFrameInDatabase(
     unsigned int* num_of_lc_matches,
     vi_map::VertexKeyPointToStructureMatchList* inlier_structure_matches,
     pose_graph::VertexId* vertex_id_closest_to_structure_matches) const {
+  MAPLAB_PROFILE_ZONE("Loop Closure: Find nframe in database");
   CHECK_NOTNULL(map);
   CHECK_NOTNULL(T_G_I);
   CHECK_NOTNULL(num_of_lc_matches);
@@ -518,26 +702,20 @@ bool LoopDetectorNode::findNFrameInDatabase(
       inlier_structure_matches, vertex_id_closest_to_structure_matches);
 }
 
-void LoopDetectorNode::findNearestNeighborMatchesForNFrame(
+void LoopDetectorNode::convertLocalizationNFrameToProjectedImages(
     const aslam::VisualNFrame& n_frame, const bool skip_untracked_keypoints,
-    std::vector<vi_map::LandmarkIdList>* query_vertex_observed_landmark_ids,
-    unsigned int* num_of_lc_matches,
-    loop_closure::FrameToMatches* frame_matches_list) const {
+    loop_closure::ProjectedImagePtrList* projected_image_ptr_list,
+    KeyframeToKeypointReindexMap* keyframe_to_keypoint_reindexing,
+    std::vector<vi_map::LandmarkIdList>* query_vertex_observed_landmark_ids)
+    const {
+  CHECK_NOTNULL(projected_image_ptr_list)->clear();
+  CHECK_NOTNULL(keyframe_to_keypoint_reindexing)->clear();
   CHECK_NOTNULL(query_vertex_observed_landmark_ids)->clear();
-  CHECK_NOTNULL(num_of_lc_matches);
-  CHECK_NOTNULL(frame_matches_list);
-
-  *num_of_lc_matches = 0u;
 
-  timing::Timer timer_preprocess("Loop Closure: preprocess frames");
   const size_t num_frames = n_frame.getNumFrames();
-  loop_closure::ProjectedImagePtrList projected_image_ptr_list;
-  projected_image_ptr_list.reserve(num_frames);
+  projected_image_ptr_list->reserve(num_frames);
   query_vertex_observed_landmark_ids->resize(num_frames);
-  std::vector<loop_closure::KeyframeId> frame_ids;
-  frame_ids.reserve(num_frames);
-  KeyframeToKeypointReindexMap keyframe_to_keypoint_reindexing;
-  keyframe_to_keypoint_reindexing.reserve(num_frames);
+  keyframe_to_keypoint_reindexing->reserve(num_frames);
 
   const pose_graph::VertexId query_vertex_id(
       common::createRandomId<pose_graph::VertexId>());
@@ -551,45 +729,166 @@ void LoopDetectorNode::findNearestNeighborMatchesForNFrame(
         // Skip frame if zero measurements found.
         continue;
       }
-      frame_ids.emplace_back(query_vertex_id, frame_idx);
+      const loop_closure::KeyframeId frame_id(query_vertex_id, frame_idx);
 
-      projected_image_ptr_list.push_back(
+      projected_image_ptr_list->push_back(
           std::make_shared<loop_closure::ProjectedImage>());
       convertLocalizationFrameToProjectedImage(
-          n_frame, frame_ids.back(), skip_untracked_keypoints,
-          projected_image_ptr_list.back(), &keyframe_to_keypoint_reindexing,
+          n_frame, frame_id, skip_untracked_keypoints,
+          projected_image_ptr_list->back(), keyframe_to_keypoint_reindexing,
           &(*query_vertex_observed_landmark_ids)[frame_idx]);
     }
   }
+}
+
+void LoopDetectorNode::correctKeypointIndicesOfMatches(
+    const KeyframeToKeypointReindexMap& keyframe_to_keypoint_reindexing,
+    loop_closure::FrameToMatches* frame_matches_list) const {
+  CHECK_NOTNULL(frame_matches_list);
+  // For the pose recovery with RANSAC, the keypoint indices of the frame are
+  // decisive, not those stored in the projected image. Therefore, the
+  // keypoint indices of the matches (inferred from the projected image) have to
+  // be mapped back to the keypoint indices of the frame.
+  for (loop_closure::FrameToMatches::value_type& frame_matches :
+       *frame_matches_list) {
+    for (loop_closure::Match& match : frame_matches.second) {
+      KeyframeToKeypointReindexMap::const_iterator iter_keyframe_supsampling =
+          keyframe_to_keypoint_reindexing.find(
+              match.keypoint_id_query.frame_id);
+      CHECK(iter_keyframe_supsampling != keyframe_to_keypoint_reindexing.end());
+      match.keypoint_id_query.keypoint_index =
+          iter_keyframe_supsampling
+              ->second[match.keypoint_id_query.keypoint_index];
+    }
+  }
+}
+
+void LoopDetectorNode::findNearestNeighborMatchesForNFrame(
+    const aslam::VisualNFrame& n_frame, const bool skip_untracked_keypoints,
+    std::vector<vi_map::LandmarkIdList>* query_vertex_observed_landmark_ids,
+    unsigned int* num_of_lc_matches,
+    loop_closure::FrameToMatches* frame_matches_list) const {
+  CHECK_NOTNULL(query_vertex_observed_landmark_ids)->clear();
+  CHECK_NOTNULL(num_of_lc_matches);
+  CHECK_NOTNULL(frame_matches_list);
+
+  *num_of_lc_matches = 0u;
+
+  timing::Timer timer_preprocess("Loop Closure: preprocess frames");
+  loop_closure::ProjectedImagePtrList projected_image_ptr_list;
+  KeyframeToKeypointReindexMap keyframe_to_keypoint_reindexing;
+  convertLocalizationNFrameToProjectedImages(
+      n_frame, skip_untracked_keypoints, &projected_image_ptr_list,
+      &keyframe_to_keypoint_reindexing, query_vertex_observed_landmark_ids);
   timer_preprocess.Stop();
   constexpr bool kParallelFindIfPossible = true;
   loop_detector_->Find(
       projected_image_ptr_list, kParallelFindIfPossible, frame_matches_list);
 
   // Correct the indices in case untracked keypoints were removed.
-  // For the pose recovery with RANSAC, the keypoint indices of the frame are
-  // decisive, not those stored in the projected image. Therefore, the
-  // keypoint indices of the matches (inferred from the projected image) have to
-  // be mapped back to the keypoint indices of the frame.
   if (skip_untracked_keypoints) {
-    for (loop_closure::FrameToMatches::value_type& frame_matches :
-         *frame_matches_list) {
-      for (loop_closure::Match& match : frame_matches.second) {
-        KeyframeToKeypointReindexMap::const_iterator iter_keyframe_supsampling =
-            keyframe_to_keypoint_reindexing.find(
-                match.keypoint_id_query.frame_id);
-        CHECK(
-            iter_keyframe_supsampling != keyframe_to_keypoint_reindexing.end());
-        match.keypoint_id_query.keypoint_index =
-            iter_keyframe_supsampling
-                ->second[match.keypoint_id_query.keypoint_index];
-      }
-    }
+    correctKeypointIndicesOfMatches(
+        keyframe_to_keypoint_reindexing, frame_matches_list);
   }
 
   *num_of_lc_matches = loop_closure::getNumberOfMatches(*frame_matches_list);
 }
 
+bool LoopDetectorNode::findNFrameInSummaryMapObservations(
+    const aslam::VisualNFrame& n_frame, const bool skip_untracked_keypoints,
+    const summary_map::LocalizationSummaryMap& localization_summary_map,
+    const std::vector<int>& observation_indices, pose::Transformation* T_G_I,
+    unsigned int* num_of_lc_matches,
+    vi_map::VertexKeyPointToStructureMatchList* inlier_structure_matches)
+    const {
+  CHECK_NOTNULL(T_G_I);
+  CHECK_NOTNULL(num_of_lc_matches);
+  CHECK_NOTNULL(inlier_structure_matches)->clear();
+
+  *num_of_lc_matches = 0u;
+  if (observation_indices.empty()) {
+    return false;
+  }
+
+  timing::Timer timer_preprocess("Loop Closure: preprocess frames");
+  loop_closure::ProjectedImagePtrList projected_image_ptr_list;
+  KeyframeToKeypointReindexMap keyframe_to_keypoint_reindexing;
+  std::vector<vi_map::LandmarkIdList> query_vertex_observed_landmark_ids;
+  convertLocalizationNFrameToProjectedImages(
+      n_frame, skip_untracked_keypoints, &projected_image_ptr_list,
+      &keyframe_to_keypoint_reindexing, &query_vertex_observed_landmark_ids);
+
+  // The candidates are grouped into keyframes by their observer, like in the
+  // database, such that the covisibility filtering applies. The keyframe IDs
+  // only need to be distinct, the pose is recovered from the landmark
+  // positions alone.
+  loop_closure::CandidateDescriptors candidates;
+  localization_summary_map.getProjectedDescriptors(
+      observation_indices, &candidates.projected_descriptors);
+  const Eigen::Matrix<unsigned int, Eigen::Dynamic, 1>&
+      observation_to_landmark_index =
+          localization_summary_map.observationToLandmarkIndex();
+  const Eigen::Matrix<unsigned int, Eigen::Dynamic, 1>& observer_indices =
+      localization_summary_map.observerIndices();
+  std::unordered_map<unsigned int, loop_closure::KeyframeId>
+      observer_index_to_keyframe_id;
+  candidates.keyframe_ids.reserve(observation_indices.size());
+  candidates.landmarks.reserve(observation_indices.size());
+  for (const int observation_index : observation_indices) {
+    CHECK_LT(observation_index, observation_to_landmark_index.rows());
+    CHECK_LT(observation_index, observer_indices.rows());
+    std::unordered_map<unsigned int, loop_closure::KeyframeId>::iterator it =
+        observer_index_to_keyframe_id.find(observer_indices(observation_index));
+    if (it == observer_index_to_keyframe_id.end()) {
+      constexpr unsigned int kFrameIndex = 0u;
+      it = observer_index_to_keyframe_id
+               .emplace(
+                   observer_indices(observation_index),
+                   loop_closure::KeyframeId(
+                       common::createRandomId<pose_graph::VertexId>(),
+                       kFrameIndex))
+               .first;
+    }
+    candidates.keyframe_ids.push_back(it->second);
+    candidates.landmarks.push_back(
+        localization_summary_map.getLandmarkIdForIndex(
+            observation_to_landmark_index(observation_index)));
+  }
+  timer_preprocess.Stop();
+
+  timing::Timer timer_find("Loop Closure: find in summary map observations");
+  loop_closure::FrameToMatches frame_matches_list;
+  loop_detector_->FindInCandidates(
+      projected_image_ptr_list, candidates, &frame_matches_list);
+  timer_find.Stop();
+
+  // Correct the indices in case untracked keypoints were removed.
+  if (skip_untracked_keypoints) {
+    correctKeypointIndicesOfMatches(
+        keyframe_to_keypoint_reindexing, &frame_matches_list);
+  }
+  *num_of_lc_matches = loop_closure::getNumberOfMatches(frame_matches_list);
+
+  timing::Timer timer_compute_relative("lc compute absolute transform");
+  constexpr bool kMergeLandmarks = false;
+  constexpr bool kAddLoopclosureEdges = false;
+  loop_closure_handler::LoopClosureHandler handler(
+      &localization_summary_map, &landmark_id_old_to_new_);
+
+  constexpr pose_graph::VertexId* kVertexIdClosestToStructureMatches = nullptr;
+  const bool success = computeAbsoluteTransformFromFrameMatches(
+      n_frame, query_vertex_observed_landmark_ids, frame_matches_list,
+      kMergeLandmarks, kAddLoopclosureEdges, handler, T_G_I,
+      inlier_structure_matches, kVertexIdClosestToStructureMatches);
+
+  if (visualizer_ && success) {
+    visualizer_->visualizeKeyframeToStructureMatch(
+        *inlier_structure_matches, T_G_I->getPosition(),
+        localization_summary_map);
+  }
+  return success;
+}
+
 bool LoopDetectorNode::findVertexInDatabase(
     const vi_map::Vertex& query_vertex, const bool merge_landmarks,
     const bool add_lc_edges, vi_map::VIMap* map, pose::Transformation* T_G_I,
@@ -767,6 +1066,7 @@ void LoopDetectorNode::queryVertexInDatabase(
     loop_closure_handler::LoopClosureHandler::MergedLandmark3dPositionVector*
         landmark_pairs_merged,
     std::mutex* map_mutex) const {
+  MAPLAB_PROFILE_ZONE("Loop Closure: Query vertex");
   CHECK_NOTNULL(map);
   CHECK_NOTNULL(raw_constraint);
   CHECK_NOTNULL(inlier_constraint);
@@ -876,6 +1176,7 @@ void LoopDetectorNode::detectLoopClosuresVerticesToDatabase(
     double* summary_landmark_match_inlier_ratio, vi_map::VIMap* map,
     pose::Transformation* T_G_M_estimate,
     vi_map::LoopClosureConstraintVector* inlier_constraints) const {
+  MAPLAB_PROFILE_ZONE("Loop Closure: Detect loop closures");
   CHECK(!vertices.empty());
   CHECK_NOTNULL(num_vertex_candidate_links);
   CHECK_NOTNULL(summary_landmark_match_inlier_ratio);
@@ -1072,6 +1373,7 @@ bool LoopDetectorNode::handleLoopClosures(
         landmark_pairs_merged,
     pose_graph::VertexId* vertex_id_closest_to_structure_matches,
     std::mutex* map_mutex) const {
+  MAPLAB_PROFILE_ZONE("Loop Closure: Handle loop closures");
   CHECK_NOTNULL(num_inliers);
   CHECK_NOTNULL(inlier_ratio);
   CHECK_NOTNULL(map);
@@ -1129,4 +1431,49 @@ const std::string& LoopDetectorNode::getDefaultSerializationFilename() {
   return serialization_filename_;
 }
 
+bool LoopDetectorNode::publishMappedDatabase(
+    const common::MappedMemory::Type type, const std::string& name) {
+  const std::vector<loop_closure::DatasetId> dataset_ids(
+      missions_in_database_.begin(), missions_in_database_.end());
+  aslam::HashId source_id;
+  if (summary_maps_in_database_.size() == 1u) {
+    summary_maps_in_database_.begin()->toHashId(&source_id);
+  }
+  return loop_detector_->publishMappedDatabase(
+      type, name, dataset_ids, source_id);
+}
+
+bool LoopDetectorNode::attachMappedDatabase(
+    const common::MappedMemory::Type type, const std::string& name) {
+  return attachMappedDatabase(type, name, aslam::HashId());
+}
+
+bool LoopDetectorNode::attachMappedDatabase(
+    const common::MappedMemory::Type type, const std::string& name,
+    const aslam::HashId& source_id) {
+  std::vector<loop_closure::DatasetId> dataset_ids;
+  if (!loop_detector_->attachMappedDatabase(
+          type, name, source_id, &dataset_ids)) {
+    return false;
+  }
+  missions_in_database_.clear();
+  missions_in_database_.insert(dataset_ids.begin(), dataset_ids.end());
+  summary_maps_in_database_.clear();
+  VLOG(1) << "Attached to the loop detector database " << name << " with "
+          << loop_detector_->NumEntries() << " keyframes.";
+  return true;
+}
+
+bool LoopDetectorNode::attachMappedDatabase(
+    const common::MappedMemory::Type type, const std::string& name,
+    const summary_map::LocalizationSummaryMap& localization_summary_map) {
+  aslam::HashId summary_map_id;
+  localization_summary_map.id().toHashId(&summary_map_id);
+  if (!attachMappedDatabase(type, name, summary_map_id)) {
+    return false;
+  }
+  summary_maps_in_database_.emplace(localization_summary_map.id());
+  return true;
+}
+
 }  // namespace loop_detector_node
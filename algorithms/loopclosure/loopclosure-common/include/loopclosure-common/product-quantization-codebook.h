@@ -0,0 +1,55 @@
+#ifndef LOOPCLOSURE_COMMON_PRODUCT_QUANTIZATION_CODEBOOK_H_
+#define LOOPCLOSURE_COMMON_PRODUCT_QUANTIZATION_CODEBOOK_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <Eigen/Core>
+
+namespace loop_closure {
+// Each column holds the product quantized residual of one descriptor.
+typedef Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic>
+    ProductQuantizedDescriptorMatrix;
+
+// Codebook of the inverted multi-index with product quantized residuals. A
+// descriptor is represented by the index of its word in the product vocabulary
+// (word_index = word_1 * words_2.cols() + word_2) and by the product quantized
+// residuals of its two halves. The first num_components entries of a code
+// quantize the residual w.r.t. word_1, the next num_components entries the
+// residual w.r.t. word_2. The quantizer centers of word_i in the first
+// vocabulary are stored in the columns
+// [i * num_components * num_centers, (i + 1) * num_components * num_centers)
+// of quantizer_centers_1, ordered by component; analogously for the second
+// vocabulary.
+struct ProductQuantizationCodebook {
+  ProductQuantizationCodebook();
+
+  bool empty() const;
+  int descriptorDimensionality() const;
+  int codeLength() const;
+
+  // Approximately reconstructs the descriptors from their word indices and
+  // product quantized residuals.
+  void reconstructDescriptors(
+      const Eigen::VectorXi& word_indices,
+      const ProductQuantizedDescriptorMatrix& quantized_residuals,
+      Eigen::MatrixXf* descriptors) const;
+
+  // Memory used by the codebook in bytes.
+  size_t getNumBytes() const;
+
+  bool operator==(const ProductQuantizationCodebook& other) const;
+
+  Eigen::MatrixXf words_1;
+  Eigen::MatrixXf words_2;
+  Eigen::MatrixXf quantizer_centers_1;
+  Eigen::MatrixXf quantizer_centers_2;
+  // The number of components per half of the descriptor.
+  int num_components;
+  int num_centers;
+  int num_dimensions_per_component;
+  uint64_t vocabulary_fingerprint;
+};
+}  // namespace loop_closure
+
+#endif  // LOOPCLOSURE_COMMON_PRODUCT_QUANTIZATION_CODEBOOK_H_
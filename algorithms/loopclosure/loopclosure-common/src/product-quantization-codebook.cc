@@ -0,0 +1,97 @@
+#include "loopclosure-common/product-quantization-codebook.h"
+
+#include <glog/logging.h>
+
+namespace loop_closure {
+namespace {
+bool haveSameSizeAndCoefficients(
+    const Eigen::MatrixXf& lhs, const Eigen::MatrixXf& rhs) {
+  return lhs.rows() == rhs.rows() && lhs.cols() == rhs.cols() && lhs == rhs;
+}
+}  // namespace
+
+ProductQuantizationCodebook::ProductQuantizationCodebook()
+    : num_components(0),
+      num_centers(0),
+      num_dimensions_per_component(0),
+      vocabulary_fingerprint(0u) {}
+
+bool ProductQuantizationCodebook::empty() const {
+  return words_1.cols() == 0 || words_2.cols() == 0;
+}
+
+int ProductQuantizationCodebook::descriptorDimensionality() const {
+  return words_1.rows() + words_2.rows();
+}
+
+int ProductQuantizationCodebook::codeLength() const {
+  return 2 * num_components;
+}
+
+void ProductQuantizationCodebook::reconstructDescriptors(
+    const Eigen::VectorXi& word_indices,
+    const ProductQuantizedDescriptorMatrix& quantized_residuals,
+    Eigen::MatrixXf* descriptors) const {
+  CHECK_NOTNULL(descriptors);
+  CHECK(!empty());
+  CHECK_EQ(word_indices.rows(), quantized_residuals.cols());
+  CHECK_EQ(quantized_residuals.rows(), codeLength());
+  CHECK_EQ(words_1.rows(), num_components * num_dimensions_per_component);
+  CHECK_EQ(words_2.rows(), num_components * num_dimensions_per_component);
+
+  const int half_dimensionality = words_1.rows();
+  const int num_cols_per_quantizer = num_components * num_centers;
+  CHECK_EQ(quantizer_centers_1.cols(), num_cols_per_quantizer * words_1.cols());
+  CHECK_EQ(quantizer_centers_2.cols(), num_cols_per_quantizer * words_2.cols());
+
+  const int num_words_2 = words_2.cols();
+  descriptors->resize(descriptorDimensionality(), word_indices.rows());
+  for (int i = 0; i < word_indices.rows(); ++i) {
+    const int word_1 = word_indices(i) / num_words_2;
+    const int word_2 = word_indices(i) % num_words_2;
+    CHECK_LT(word_1, words_1.cols());
+
+    descriptors->col(i).head(half_dimensionality) = words_1.col(word_1);
+    descriptors->col(i).tail(half_dimensionality) = words_2.col(word_2);
+    for (int component = 0; component < num_components; ++component) {
+      const int row = component * num_dimensions_per_component;
+      const int center_offset = component * num_centers;
+      const int center_1 = quantized_residuals(component, i);
+      const int center_2 = quantized_residuals(num_components + component, i);
+      CHECK_LT(center_1, num_centers);
+      CHECK_LT(center_2, num_centers);
+      descriptors->block(row, i, num_dimensions_per_component, 1) +=
+          quantizer_centers_1.col(
+              word_1 * num_cols_per_quantizer + center_offset + center_1);
+      descriptors->block(
+          half_dimensionality + row, i, num_dimensions_per_component, 1) +=
+          quantizer_centers_2.col(
+              word_2 * num_cols_per_quantizer + center_offset + center_2);
+    }
+  }
+}
+
+size_t ProductQuantizationCodebook::getNumBytes() const {
+  return sizeof(float) *
+         (words_1.size() + words_2.size() + quantizer_centers_1.size() +
+          quantizer_centers_2.size());
+}
+
+bool ProductQuantizationCodebook::operator==(
+    const ProductQuantizationCodebook& other) const {
+  bool is_same = true;
+  is_same &= haveSameSizeAndCoefficients(words_1, other.words_1);
+  is_same &= haveSameSizeAndCoefficients(words_2, other.words_2);
+  is_same &= haveSameSizeAndCoefficients(
+      quantizer_centers_1, other.quantizer_centers_1);
+  is_same &= haveSameSizeAndCoefficients(
+      quantizer_centers_2, other.quantizer_centers_2);
+  is_same &= num_components == other.num_components;
+  is_same &= num_centers == other.num_centers;
+  is_same &=
+      num_dimensions_per_component == other.num_dimensions_per_component;
+  is_same &= vocabulary_fingerprint == other.vocabulary_fingerprint;
+  return is_same;
+}
+
+}  // namespace loop_closure
@@ -0,0 +1,228 @@
+#ifndef MATCHING_BASED_LOOPCLOSURE_COVISIBILITY_FILTER_H_
+#define MATCHING_BASED_LOOPCLOSURE_COVISIBILITY_FILTER_H_
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+#include <loopclosure-common/types.h>
+
+#include "matching-based-loopclosure/scoring.h"
+
+namespace matching_based_loopclosure {
+
+// Buffers of the covisibility filtering. The IDs (keyframes or vertices) are
+// numbered in the iteration order of the ID to matches map. The buffers keep
+// their capacity, so reusing them avoids allocations once they are large
+// enough.
+template <typename IdType>
+struct CovisibilityFilterBuffers {
+  // Scores of the IDs, used to select the relevant IDs.
+  scoring::ScoreList<IdType> scores;
+  std::vector<std::pair<int, scoring::ScoreType>> indexed_scores;
+  // Only the matches of relevant IDs are considered.
+  std::vector<unsigned char> is_id_relevant;
+
+  // Union-find forest over the IDs. The number of distinct matches of a
+  // component is stored at its root.
+  std::vector<int> id_parents;
+  std::vector<size_t> component_sizes;
+  // The matches of the relevant IDs with the index of their ID, sorted by
+  // landmark.
+  std::vector<std::pair<const loop_closure::Match*, int>> sorted_matches;
+
+  // The matches of the largest component.
+  std::vector<const loop_closure::Match*> component_matches;
+};
+
+// Buffers of the covisibility filtering that are reused across the queries of
+// a loop detector. Every query checks out its own buffers, so concurrent
+// queries never share them, and returns them when it is done. Once the
+// buffers are as large as needed by the queries, the filtering doesn't
+// allocate anymore.
+template <typename IdType>
+class CovisibilityFilterBufferPool {
+ public:
+  typedef std::unique_ptr<CovisibilityFilterBuffers<IdType>> BuffersPtr;
+
+  CovisibilityFilterBufferPool() : num_created_buffers_(0u) {}
+
+  // Takes buffers from the pool, or creates new ones if all are in use by
+  // other queries.
+  BuffersPtr acquire() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!buffers_.empty()) {
+        BuffersPtr buffers = std::move(buffers_.back());
+        buffers_.pop_back();
+        return buffers;
+      }
+      ++num_created_buffers_;
+    }
+    return BuffersPtr(new CovisibilityFilterBuffers<IdType>);
+  }
+
+  void release(BuffersPtr buffers) {
+    CHECK(buffers != nullptr);
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffers_.emplace_back(std::move(buffers));
+  }
+
+  // The largest number of buffers that have been in use at the same time.
+  size_t getNumCreatedBuffers() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return num_created_buffers_;
+  }
+
+ private:
+  mutable std::mutex mutex_;
+  std::vector<BuffersPtr> buffers_;
+  size_t num_created_buffers_;
+};
+
+namespace internal {
+// Orders by landmark first, so that all matches of a landmark are adjacent,
+// and then by query keypoint, so that the matches of a (keypoint, landmark)
+// pair are adjacent.
+inline bool isMatchLess(
+    const loop_closure::Match& lhs, const loop_closure::Match& rhs) {
+  if (lhs.landmark_result != rhs.landmark_result) {
+    return lhs.landmark_result < rhs.landmark_result;
+  }
+  if (lhs.keypoint_id_query.frame_id != rhs.keypoint_id_query.frame_id) {
+    return lhs.keypoint_id_query.frame_id < rhs.keypoint_id_query.frame_id;
+  }
+  if (lhs.keypoint_id_query.keypoint_index !=
+      rhs.keypoint_id_query.keypoint_index) {
+    return lhs.keypoint_id_query.keypoint_index <
+           rhs.keypoint_id_query.keypoint_index;
+  }
+  return lhs.keyframe_id_result < rhs.keyframe_id_result;
+}
+
+inline bool haveSameKeypointAndLandmark(
+    const loop_closure::Match& lhs, const loop_closure::Match& rhs) {
+  return lhs.landmark_result == rhs.landmark_result &&
+         lhs.keypoint_id_query == rhs.keypoint_id_query;
+}
+
+inline int findComponentRoot(const int id_index, std::vector<int>* parents) {
+  CHECK_NOTNULL(parents);
+  int root = id_index;
+  while ((*parents)[root] != root) {
+    // Path halving.
+    (*parents)[root] = (*parents)[(*parents)[root]];
+    root = (*parents)[root];
+  }
+  return root;
+}
+}  // namespace internal
+
+// Finds the largest set of matches whose IDs are connected by commonly matched
+// landmarks. Only the IDs marked in buffers->is_id_relevant are considered and
+// equal matches count once. Of several equally large components, the one with
+// the first ID is taken. The matches of the component are stored in
+// buffers->component_matches, keeping only one match per (query keypoint,
+// landmark) pair if make_matches_unique is set. Returns the number of distinct
+// matches of the component.
+template <typename IdType>
+size_t findLargestCovisibilityComponent(
+    const loop_closure::IdToMatches<IdType>& id_to_matches,
+    const bool make_matches_unique,
+    CovisibilityFilterBuffers<IdType>* buffers) {
+  CHECK_NOTNULL(buffers);
+  const int num_ids = id_to_matches.size();
+  CHECK_EQ(buffers->is_id_relevant.size(), static_cast<size_t>(num_ids));
+  std::vector<int>& id_parents = buffers->id_parents;
+  std::vector<size_t>& component_sizes = buffers->component_sizes;
+  std::vector<std::pair<const loop_closure::Match*, int>>& sorted_matches =
+      buffers->sorted_matches;
+  buffers->component_matches.clear();
+
+  id_parents.resize(num_ids);
+  component_sizes.assign(num_ids, 0u);
+  sorted_matches.clear();
+  int id_index = 0;
+  for (const typename loop_closure::IdToMatches<IdType>::value_type&
+           id_matches_pair : id_to_matches) {
+    id_parents[id_index] = id_index;
+    if (buffers->is_id_relevant[id_index] != 0u) {
+      for (const loop_closure::Match& match : id_matches_pair.second) {
+        sorted_matches.emplace_back(&match, id_index);
+      }
+    }
+    ++id_index;
+  }
+  if (sorted_matches.empty()) {
+    return 0u;
+  }
+  std::sort(
+      sorted_matches.begin(), sorted_matches.end(),
+      [](const std::pair<const loop_closure::Match*, int>& lhs,
+         const std::pair<const loop_closure::Match*, int>& rhs) {
+        return internal::isMatchLess(*lhs.first, *rhs.first);
+      });
+
+  // Count the distinct matches of every ID and connect the IDs that share a
+  // landmark. Equal matches are adjacent and belong to the same ID.
+  for (size_t i = 0u; i < sorted_matches.size(); ++i) {
+    const loop_closure::Match& match = *sorted_matches[i].first;
+    if (i > 0u) {
+      const loop_closure::Match& previous_match = *sorted_matches[i - 1u].first;
+      if (match == previous_match) {
+        continue;
+      }
+      if (match.landmark_result == previous_match.landmark_result) {
+        const int root =
+            internal::findComponentRoot(sorted_matches[i].second, &id_parents);
+        const int previous_root = internal::findComponentRoot(
+            sorted_matches[i - 1u].second, &id_parents);
+        id_parents[root] = previous_root;
+      }
+    }
+    ++component_sizes[sorted_matches[i].second];
+  }
+
+  // Accumulate the sizes at the roots and find the largest component.
+  for (int id = 0; id < num_ids; ++id) {
+    const int root = internal::findComponentRoot(id, &id_parents);
+    if (root != id) {
+      component_sizes[root] += component_sizes[id];
+      component_sizes[id] = 0u;
+    }
+  }
+  size_t max_component_size = 0u;
+  int max_component_root = -1;
+  for (int id = 0; id < num_ids; ++id) {
+    const int root = internal::findComponentRoot(id, &id_parents);
+    if (component_sizes[root] > max_component_size) {
+      max_component_size = component_sizes[root];
+      max_component_root = root;
+    }
+  }
+
+  const loop_closure::Match* last_component_match = nullptr;
+  for (size_t i = 0u; i < sorted_matches.size(); ++i) {
+    const loop_closure::Match& match = *sorted_matches[i].first;
+    if ((i > 0u && match == *sorted_matches[i - 1u].first) ||
+        internal::findComponentRoot(sorted_matches[i].second, &id_parents) !=
+            max_component_root) {
+      continue;
+    }
+    if (make_matches_unique && last_component_match != nullptr &&
+        internal::haveSameKeypointAndLandmark(match, *last_component_match)) {
+      // Skip duplicate (keypoint to landmark) structure matches.
+      continue;
+    }
+    buffers->component_matches.push_back(&match);
+    last_component_match = &match;
+  }
+  return max_component_size;
+}
+
+}  // namespace matching_based_loopclosure
+
+#endif  // MATCHING_BASED_LOOPCLOSURE_COVISIBILITY_FILTER_H_
@@ -17,6 +17,7 @@ static const std::string kMatchingLDInvertedMultiIndexString =
 static const std::string
     kMatchingLDInvertedMultiIndexProductQuantizationString =
         "inverted_multi_index_product_quantization";
+static const std::string kMatchingLDHammingString = "hamming";
 
 struct MatchingBasedEngineSettings {
   MatchingBasedEngineSettings();
@@ -31,6 +32,7 @@ struct MatchingBasedEngineSettings {
     kMatchingLDInvertedIndex,
     kMatchingLDInvertedMultiIndex,
     kMatchingLDInvertedMultiIndexProductQuantization,
+    kMatchingLDHamming,
   };
 
   void setKeyframeScoringFunctionType(
@@ -50,6 +52,10 @@ struct MatchingBasedEngineSettings {
   size_t min_verify_matches_num;
   float fraction_best_scores;
   int num_nearest_neighbors;
+  // Settings of the Hamming index, which searches the raw binary descriptors.
+  int descriptor_size_bits;
+  int hamming_max_substring_radius;
+  int hamming_max_distance;
 };
 
 }  // namespace matching_based_loopclosure
@@ -0,0 +1,99 @@
+#ifndef MATCHING_BASED_LOOPCLOSURE_EXHAUSTIVE_SEARCH_H_
+#define MATCHING_BASED_LOOPCLOSURE_EXHAUSTIVE_SEARCH_H_
+#include <algorithm>
+#include <limits>
+
+#include <Eigen/Core>
+#include <glog/logging.h>
+
+namespace loop_closure {
+namespace exhaustive_search {
+
+// Number of candidates whose distances to all queries are computed by one
+// matrix product. Bounds the size of the distance buffer.
+constexpr int kCandidateBlockSize = 1024;
+
+// Finds the num_neighbors closest candidates of every query by comparing it
+// with all candidates. The squared distances of a block of candidates to all
+// queries are computed with a single matrix product,
+// |c - q|^2 = |c|^2 + |q|^2 - 2 c^T q, into the given buffer, which keeps its
+// memory across calls. The candidate_squared_norms are the squared norms of
+// the candidate columns. Like for the index backends, the distances are
+// squared, candidates farther than max_squared_distance are left out and
+// missing neighbors have the index -1 and an infinite distance.
+inline void GetNNearestNeighbors(
+    const Eigen::MatrixXf& candidates,
+    const Eigen::RowVectorXf& candidate_squared_norms,
+    const Eigen::MatrixXf& queries, const int num_neighbors,
+    const float max_squared_distance, Eigen::MatrixXf* distance_buffer,
+    Eigen::MatrixXi* indices, Eigen::MatrixXf* distances) {
+  CHECK_NOTNULL(distance_buffer);
+  CHECK_NOTNULL(indices);
+  CHECK_NOTNULL(distances);
+  CHECK_GT(num_neighbors, 0);
+  CHECK_EQ(candidates.rows(), queries.rows());
+  CHECK_EQ(candidate_squared_norms.cols(), candidates.cols());
+
+  const int num_queries = queries.cols();
+  indices->setConstant(num_neighbors, num_queries, -1);
+  distances->setConstant(
+      num_neighbors, num_queries, std::numeric_limits<float>::infinity());
+  if (num_queries == 0 || candidates.cols() == 0) {
+    return;
+  }
+  const Eigen::RowVectorXf query_squared_norms =
+      queries.colwise().squaredNorm();
+
+  const int block_size =
+      std::min<int>(kCandidateBlockSize, candidates.cols());
+  if (distance_buffer->rows() < block_size ||
+      distance_buffer->cols() < num_queries) {
+    distance_buffer->resize(
+        std::max<int>(block_size, distance_buffer->rows()),
+        std::max<int>(num_queries, distance_buffer->cols()));
+  }
+
+  for (int block_start = 0; block_start < candidates.cols();
+       block_start += block_size) {
+    const int num_block_candidates =
+        std::min<int>(block_size, candidates.cols() - block_start);
+    Eigen::Block<Eigen::MatrixXf> block_distances =
+        distance_buffer->topLeftCorner(num_block_candidates, num_queries);
+    block_distances.noalias() =
+        -2.0f *
+        candidates.middleCols(block_start, num_block_candidates).transpose() *
+        queries;
+
+    for (int query_idx = 0; query_idx < num_queries; ++query_idx) {
+      float* query_distances = distances->col(query_idx).data();
+      int* query_indices = indices->col(query_idx).data();
+      for (int i = 0; i < num_block_candidates; ++i) {
+        // Rounding can make the distance slightly negative for identical
+        // descriptors.
+        const float squared_distance = std::max(
+            block_distances(i, query_idx) +
+                candidate_squared_norms(block_start + i) +
+                query_squared_norms(query_idx),
+            0.0f);
+        if (squared_distance > max_squared_distance ||
+            squared_distance >= query_distances[num_neighbors - 1]) {
+          continue;
+        }
+        // Insert into the neighbors, which are sorted by distance.
+        int position = num_neighbors - 1;
+        while (position > 0 &&
+               query_distances[position - 1] > squared_distance) {
+          query_distances[position] = query_distances[position - 1];
+          query_indices[position] = query_indices[position - 1];
+          --position;
+        }
+        query_distances[position] = squared_distance;
+        query_indices[position] = block_start + i;
+      }
+    }
+  }
+}
+
+}  // namespace exhaustive_search
+}  // namespace loop_closure
+#endif  // MATCHING_BASED_LOOPCLOSURE_EXHAUSTIVE_SEARCH_H_
@@ -0,0 +1,117 @@
+#ifndef MATCHING_BASED_LOOPCLOSURE_HAMMING_INDEX_INTERFACE_H_
+#define MATCHING_BASED_LOOPCLOSURE_HAMMING_INDEX_INTERFACE_H_
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/reader-writer-lock.h>
+#include <aslam/common/timer.h>
+#include <glog/logging.h>
+#include <matching-based-loopclosure/hamming-index.h>
+#include <matching-based-loopclosure/helpers.h>
+#include <matching-based-loopclosure/index-interface.h>
+
+namespace loop_closure {
+using hamming_index::HammingIndex;
+// Searches the raw binary descriptors instead of projected ones. The
+// "projection" packs the descriptor bytes into the bits of the floats of the
+// projected descriptor matrix, four bytes per float, so the descriptors pass
+// through the projected image pipeline at their original size. The floats are
+// only containers and must not be used for arithmetic.
+class HammingIndexInterface : public IndexInterface {
+ public:
+  typedef HammingIndex Index;
+
+  HammingIndexInterface(
+      const int num_descriptor_bits, const int max_substring_radius,
+      const int max_distance)
+      : num_descriptor_bytes_(num_descriptor_bits / 8),
+        num_packed_rows_(num_descriptor_bytes_ / sizeof(float)) {
+    CHECK_EQ(num_descriptor_bytes_ % sizeof(float), 0u);
+    index_.reset(
+        new Index(num_descriptor_bits, max_substring_radius, max_distance));
+  }
+
+  virtual bool SearchesProjectedDescriptors() const {
+    return false;
+  }
+
+  virtual int GetNumDescriptorsInIndex() const {
+    aslam::ScopedReadLock lock(&index_mutex_);
+    return index_->GetNumDescriptorsInIndex();
+  }
+
+  virtual void Clear() {
+    aslam::ScopedWriteLock lock(&index_mutex_);
+    index_->Clear();
+  }
+
+  virtual void AddDescriptors(const Eigen::MatrixXf& descriptors) {
+    Index::DescriptorMatrixType binary_descriptors;
+    UnpackDescriptors(descriptors, &binary_descriptors);
+    aslam::ScopedWriteLock lock(&index_mutex_);
+    index_->AddDescriptors(binary_descriptors);
+  }
+
+  virtual void GetNNearestNeighborsForFeatures(
+      const Eigen::MatrixXf& query_features, int num_neighbors,
+      Eigen::MatrixXi* indices, Eigen::MatrixXf* distances) const {
+    CHECK_NOTNULL(indices);
+    CHECK_NOTNULL(distances);
+    Index::DescriptorMatrixType binary_query_features;
+    UnpackDescriptors(query_features, &binary_query_features);
+    // Queries only read the index, so they can run concurrently.
+    aslam::ScopedReadLock lock(&index_mutex_);
+    index_->GetNNearestNeighbors(
+        binary_query_features, num_neighbors, indices, distances);
+  }
+
+  virtual void ProjectDescriptors(
+      const DescriptorContainer& descriptors,
+      Eigen::MatrixXf* projected_descriptors) const {
+    CHECK_NOTNULL(projected_descriptors);
+    CHECK_EQ(descriptors.rows(), num_descriptor_bytes_);
+    timing::Timer timer_proj("PL 1.1 project");
+    projected_descriptors->resize(num_packed_rows_, descriptors.cols());
+    memcpy(
+        projected_descriptors->data(), descriptors.data(),
+        descriptors.size() * sizeof(unsigned char));
+    timer_proj.Stop();
+  }
+
+  virtual void ProjectDescriptors(
+      const std::vector<aslam::common::FeatureDescriptorConstRef>& descriptors,
+      Eigen::MatrixXf* projected_descriptors) const {
+    CHECK_NOTNULL(projected_descriptors);
+    timing::Timer timer_proj("PL 1.1 project");
+    projected_descriptors->resize(num_packed_rows_, descriptors.size());
+    for (size_t i = 0u; i < descriptors.size(); ++i) {
+      CHECK_EQ(static_cast<int>(descriptors[i].size()), num_descriptor_bytes_);
+      memcpy(
+          projected_descriptors->col(i).data(), descriptors[i].data(),
+          num_descriptor_bytes_);
+    }
+    timer_proj.Stop();
+  }
+
+ private:
+  void UnpackDescriptors(
+      const Eigen::MatrixXf& packed_descriptors,
+      Index::DescriptorMatrixType* descriptors) const {
+    CHECK_NOTNULL(descriptors);
+    CHECK_EQ(packed_descriptors.rows(), num_packed_rows_)
+        << "The descriptors were not projected by the Hamming index.";
+    descriptors->resize(num_descriptor_bytes_, packed_descriptors.cols());
+    memcpy(
+        descriptors->data(), packed_descriptors.data(),
+        packed_descriptors.size() * sizeof(float));
+  }
+
+  const int num_descriptor_bytes_;
+  const int num_packed_rows_;
+  std::shared_ptr<Index> index_;
+  mutable aslam::ReaderWriterMutex index_mutex_;
+};
+}  // namespace loop_closure
+#endif  // MATCHING_BASED_LOOPCLOSURE_HAMMING_INDEX_INTERFACE_H_
@@ -0,0 +1,280 @@
+#ifndef MATCHING_BASED_LOOPCLOSURE_HAMMING_INDEX_H_
+#define MATCHING_BASED_LOOPCLOSURE_HAMMING_INDEX_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+#include <glog/logging.h>
+#include <vocabulary-tree/hamming.h>
+
+namespace loop_closure {
+namespace hamming_index {
+// Exact k-nearest-neighbor search on binary descriptors in Hamming space with
+// multi-index hashing (M. Norouzi et al., Fast Exact Search in Hamming Space
+// with Multi-Index Hashing, TPAMI 2014). Every descriptor is split into m
+// disjoint 16 bit substrings, each of which is indexed in its own table with
+// one bucket per substring value that occurs in the descriptors. Two
+// descriptors closer than m * (r + 1) share at least one substring that
+// differs in no more than r bits. A query therefore probes all tables with the
+// keys within increasing substring radii r and compares the candidates on the
+// full descriptors, until the k-th neighbor is closer than m * (r + 1). The
+// radius is bounded by max_substring_radius, neighbors that are further away
+// than m * (max_substring_radius + 1) can be missed.
+class HammingIndex {
+ public:
+  // One descriptor per column.
+  typedef Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic>
+      DescriptorMatrixType;
+  static constexpr int kSubstringBits = 16;
+  // The descriptors need to be aligned for the SIMD distance computation.
+  static constexpr int kDescriptorAlignmentBytes = 16;
+
+  HammingIndex(
+      const int num_descriptor_bits, const int max_substring_radius,
+      const int max_distance)
+      : num_descriptor_bits_(num_descriptor_bits),
+        num_descriptor_bytes_(num_descriptor_bits / 8),
+        num_substrings_(num_descriptor_bits / kSubstringBits),
+        max_substring_radius_(max_substring_radius),
+        max_distance_(max_distance),
+        num_descriptors_(0) {
+    CHECK(
+        num_descriptor_bits_ == 128 || num_descriptor_bits_ == 256 ||
+        num_descriptor_bits_ == 384 || num_descriptor_bits_ == 512)
+        << "Unsupported descriptor size: " << num_descriptor_bits_ << " bits.";
+    CHECK_GE(max_substring_radius_, 0);
+    CHECK_LE(max_substring_radius_, kSubstringBits);
+    CHECK_GE(max_distance_, 0);
+    substring_tables_.resize(num_substrings_);
+
+    // Groups all substring flip masks by the number of flipped bits.
+    flip_masks_by_radius_.resize(max_substring_radius_ + 1);
+    for (uint32_t mask = 0u; mask < (1u << kSubstringBits); ++mask) {
+      const int radius = PopCount(mask);
+      if (radius <= max_substring_radius_) {
+        flip_masks_by_radius_[radius].push_back(static_cast<uint16_t>(mask));
+      }
+    }
+  }
+
+  inline void Clear() {
+    descriptors_.clear();
+    for (SubstringTable& table : substring_tables_) {
+      table.clear();
+    }
+    num_descriptors_ = 0;
+  }
+
+  inline int GetNumDescriptorsInIndex() const {
+    return num_descriptors_;
+  }
+
+  inline int GetNumDescriptorBits() const {
+    return num_descriptor_bits_;
+  }
+
+  void AddDescriptors(const DescriptorMatrixType& descriptors) {
+    CHECK_EQ(descriptors.rows(), num_descriptor_bytes_);
+    const int num_new_descriptors = descriptors.cols();
+    descriptors_.insert(
+        descriptors_.end(), descriptors.data(),
+        descriptors.data() + descriptors.size());
+    for (int i = 0; i < num_new_descriptors; ++i) {
+      const unsigned char* descriptor = descriptors.col(i).data();
+      for (int substring_idx = 0; substring_idx < num_substrings_;
+           ++substring_idx) {
+        const uint16_t key = GetSubstring(descriptor, substring_idx);
+        substring_tables_[substring_idx][key].push_back(num_descriptors_ + i);
+      }
+    }
+    num_descriptors_ += num_new_descriptors;
+  }
+
+  // Finds the num_neighbors closest descriptors within max_distance for every
+  // query descriptor, sorted by increasing distance. Missing results are
+  // marked with an index of -1 and an infinite distance. Thread-safe with
+  // respect to other queries.
+  void GetNNearestNeighbors(
+      const DescriptorMatrixType& query_descriptors, const int num_neighbors,
+      Eigen::MatrixXi* indices, Eigen::MatrixXf* distances) const {
+    CHECK_NOTNULL(indices);
+    CHECK_NOTNULL(distances);
+    CHECK_GT(num_neighbors, 0);
+    CHECK_EQ(query_descriptors.rows(), num_descriptor_bytes_);
+    CHECK_EQ(
+        reinterpret_cast<uintptr_t>(query_descriptors.data()) %
+            kDescriptorAlignmentBytes,
+        0u);
+    const int num_queries = query_descriptors.cols();
+    CHECK_EQ(indices->rows(), num_neighbors)
+        << "The indices parameter must be pre-allocated to hold all results.";
+    CHECK_EQ(distances->rows(), num_neighbors)
+        << "The distances parameter must be pre-allocated to hold all results.";
+    CHECK_EQ(indices->cols(), num_queries);
+    CHECK_EQ(distances->cols(), num_queries);
+
+    indices->setConstant(-1);
+    distances->setConstant(std::numeric_limits<float>::infinity());
+
+    // Descriptors that were already compared with the current query are
+    // marked with the stamp of the query.
+    std::unique_ptr<VisitedBuffer> visited = AcquireVisitedBuffer();
+    std::vector<uint32_t>& visited_stamps = visited->stamps;
+    // Max-heap of the closest (distance, index) pairs so far.
+    std::vector<std::pair<int, int>> neighbors;
+    neighbors.reserve(num_neighbors + 1);
+    for (int query_idx = 0; query_idx < num_queries; ++query_idx) {
+      const unsigned char* query = query_descriptors.col(query_idx).data();
+      neighbors.clear();
+      const uint32_t stamp = visited->NextStamp();
+      for (int radius = 0; radius <= max_substring_radius_; ++radius) {
+        for (int substring_idx = 0; substring_idx < num_substrings_;
+             ++substring_idx) {
+          const SubstringTable& table = substring_tables_[substring_idx];
+          const uint16_t query_key = GetSubstring(query, substring_idx);
+          for (const uint16_t flip_mask : flip_masks_by_radius_[radius]) {
+            const SubstringTable::const_iterator bucket =
+                table.find(static_cast<uint16_t>(query_key ^ flip_mask));
+            if (bucket == table.end()) {
+              continue;
+            }
+            for (const int descriptor_idx : bucket->second) {
+              if (visited_stamps[descriptor_idx] == stamp) {
+                continue;
+              }
+              visited_stamps[descriptor_idx] = stamp;
+
+              const int distance = loop_closure::HammingDistance(
+                  GetDescriptor(descriptor_idx), query, num_descriptor_bits_);
+              if (distance > max_distance_) {
+                continue;
+              }
+              if (static_cast<int>(neighbors.size()) < num_neighbors) {
+                neighbors.emplace_back(distance, descriptor_idx);
+                std::push_heap(neighbors.begin(), neighbors.end());
+              } else if (distance < neighbors.front().first) {
+                std::pop_heap(neighbors.begin(), neighbors.end());
+                neighbors.back() = std::make_pair(distance, descriptor_idx);
+                std::push_heap(neighbors.begin(), neighbors.end());
+              }
+            }
+          }
+        }
+
+        // No descriptor that was not yet visited is closer than this.
+        const int min_unvisited_distance = num_substrings_ * (radius + 1);
+        if (min_unvisited_distance > max_distance_ ||
+            (static_cast<int>(neighbors.size()) == num_neighbors &&
+             neighbors.front().first <= min_unvisited_distance)) {
+          break;
+        }
+      }
+
+      std::sort_heap(neighbors.begin(), neighbors.end());
+      for (size_t i = 0u; i < neighbors.size(); ++i) {
+        (*distances)(i, query_idx) = neighbors[i].first;
+        (*indices)(i, query_idx) = neighbors[i].second;
+      }
+    }
+    ReleaseVisitedBuffer(std::move(visited));
+  }
+
+ private:
+  // Descriptor indices by substring value, only for the values that occur.
+  typedef std::unordered_map<uint16_t, std::vector<int>> SubstringTable;
+
+  // Visited marks of the descriptors, reused across queries. A descriptor was
+  // visited by the current query if its stamp equals the stamp of the query,
+  // so the marks never need to be reset between queries.
+  struct VisitedBuffer {
+    VisitedBuffer() : stamp(0u) {}
+
+    uint32_t NextStamp() {
+      ++stamp;
+      if (stamp == 0u) {
+        std::fill(stamps.begin(), stamps.end(), 0u);
+        stamp = 1u;
+      }
+      return stamp;
+    }
+
+    std::vector<uint32_t> stamps;
+    uint32_t stamp;
+  };
+
+  // Takes a buffer from the pool, or creates one if all are in use by other
+  // queries. The buffer covers all descriptors of the index.
+  std::unique_ptr<VisitedBuffer> AcquireVisitedBuffer() const {
+    std::unique_ptr<VisitedBuffer> visited;
+    {
+      std::lock_guard<std::mutex> lock(visited_buffers_mutex_);
+      if (!visited_buffers_.empty()) {
+        visited = std::move(visited_buffers_.back());
+        visited_buffers_.pop_back();
+      }
+    }
+    if (visited == nullptr) {
+      visited.reset(new VisitedBuffer);
+    }
+    if (static_cast<int>(visited->stamps.size()) < num_descriptors_) {
+      visited->stamps.resize(num_descriptors_, 0u);
+    }
+    return visited;
+  }
+
+  void ReleaseVisitedBuffer(std::unique_ptr<VisitedBuffer> visited) const {
+    std::lock_guard<std::mutex> lock(visited_buffers_mutex_);
+    visited_buffers_.emplace_back(std::move(visited));
+  }
+
+  static int PopCount(uint32_t value) {
+    int count = 0;
+    for (; value != 0u; value &= value - 1u) {
+      ++count;
+    }
+    return count;
+  }
+
+  inline uint16_t GetSubstring(
+      const unsigned char* descriptor, const int substring_idx) const {
+    uint16_t substring;
+    memcpy(
+        &substring, descriptor + substring_idx * (kSubstringBits / 8),
+        sizeof(substring));
+    return substring;
+  }
+
+  inline const unsigned char* GetDescriptor(const int descriptor_idx) const {
+    return descriptors_.data() + descriptor_idx * num_descriptor_bytes_;
+  }
+
+  const int num_descriptor_bits_;
+  const int num_descriptor_bytes_;
+  const int num_substrings_;
+  const int max_substring_radius_;
+  const int max_distance_;
+
+  int num_descriptors_;
+  // The descriptors are stored back to back, the descriptor size is a multiple
+  // of the alignment, so every descriptor is aligned.
+  std::vector<unsigned char, Eigen::aligned_allocator<unsigned char>>
+      descriptors_;
+  std::vector<SubstringTable> substring_tables_;
+  std::vector<std::vector<uint16_t>> flip_masks_by_radius_;
+
+  // One buffer per concurrent query.
+  mutable std::vector<std::unique_ptr<VisitedBuffer>> visited_buffers_;
+  mutable std::mutex visited_buffers_mutex_;
+};
+}  // namespace hamming_index
+}  // namespace loop_closure
+
+#endif  // MATCHING_BASED_LOOPCLOSURE_HAMMING_INDEX_H_
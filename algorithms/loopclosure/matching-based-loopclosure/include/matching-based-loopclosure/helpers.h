@@ -47,6 +47,14 @@ inline void ProjectDescriptors(
 
 }  // namespace internal
 
+// Descriptors that are searched exhaustively instead of through the index,
+// with the keyframe that observed and the landmark of every column.
+struct CandidateDescriptors {
+  Eigen::MatrixXf projected_descriptors;
+  std::vector<KeyframeId> keyframe_ids;
+  std::vector<PointLandmarkId> landmarks;
+};
+
 template <typename IdType>
 inline size_t getNumberOfMatches(
     const loop_closure::IdToMatches<IdType>& id_to_matches) {
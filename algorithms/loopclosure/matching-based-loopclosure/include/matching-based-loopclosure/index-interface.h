@@ -19,9 +19,21 @@ class IndexInterface {
       const DescriptorContainer& descriptors,
       Eigen::MatrixXf* projected_descriptors) const = 0;
 
+  // Whether the index searches descriptors projected with the projection
+  // matrix, like the ones stored in localization summary maps.
+  virtual bool SearchesProjectedDescriptors() const {
+    return true;
+  }
+
   // The number of individual descriptors in the index.
   virtual int GetNumDescriptorsInIndex() const = 0;
 
+  // Memory used by the projection matrix and the vocabulary, which every
+  // index loads on construction, independent of the descriptors it holds.
+  virtual size_t GetVocabularyNumBytes() const {
+    return 0u;
+  }
+
   // Use the projection matrix specific to the used index to project the
   // binary descriptors to a lower dimensional, real valued space.
   virtual void ProjectDescriptors(
@@ -31,6 +43,10 @@ class IndexInterface {
   // Add descriptors to the index. Can be done lazily.
   virtual void AddDescriptors(const Eigen::MatrixXf& descriptors) = 0;
 
+  // Blocks until the lazy part of adding descriptors is done. Called after
+  // adding many descriptors at once.
+  virtual void FinishAddingDescriptors() {}
+
   // Return the indices and distances of the num_neighbors closest descriptors
   // for every descriptor from the query_features matrix.
   virtual void GetNNearestNeighborsForFeatures(
@@ -78,6 +78,13 @@ class InvertedIndexInterface : public IndexInterface {
     return index_->GetNumDescriptorsInIndex();
   }
 
+  // The index keeps its own copy of the words.
+  virtual size_t GetVocabularyNumBytes() const {
+    return (vocabulary_.projection_matrix_.size() +
+            2u * vocabulary_.words_.size()) *
+           sizeof(float);
+  }
+
   virtual void Clear() {
     index_->Clear();
   }
@@ -1,5 +1,6 @@
 #ifndef MATCHING_BASED_LOOPCLOSURE_INVERTED_MULTI_INDEX_INTERFACE_H_
 #define MATCHING_BASED_LOOPCLOSURE_INVERTED_MULTI_INDEX_INTERFACE_H_
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -10,6 +11,7 @@
 #include <descriptor-projection/descriptor-projection.h>
 #include <inverted-multi-index/inverted-multi-index.h>
 #include <inverted-multi-index/inverted-multi-product-quantization-index.h>
+#include <loopclosure-common/product-quantization-codebook.h>
 #include <maplab-common/binary-serialization.h>
 
 #include "matching-based-loopclosure/helpers.h"
@@ -126,6 +128,14 @@ class InvertedMultiIndexInterface : public IndexInterface {
     return index_->GetNumDescriptorsInIndex();
   }
 
+  // The index keeps its own copy of the words.
+  virtual size_t GetVocabularyNumBytes() const {
+    return (vocabulary_.projection_matrix_.size() +
+            2u * (vocabulary_.words_first_half_.size() +
+                  vocabulary_.words_second_half_.size())) *
+           sizeof(float);
+  }
+
   virtual void Clear() {
     index_->Clear();
   }
@@ -140,6 +150,51 @@ class InvertedMultiIndexInterface : public IndexInterface {
     index_->AddDescriptors(descriptors);
   }
 
+  // Adds descriptors whose visual words have been computed beforehand using
+  // GetWordIndex. No vocabulary search is performed.
+  void AddDescriptors(
+      const Eigen::MatrixXf& descriptors, const Eigen::VectorXi& word_indices) {
+    CHECK_EQ(descriptors.rows(), 2 * kSubSpaceDimensionality);
+    CHECK(index_ != nullptr);
+    index_->AddDescriptors(descriptors, word_indices);
+  }
+
+  // Returns the visual word of the product vocabulary the given descriptor is
+  // assigned to.
+  template <typename DerivedQuery>
+  inline int GetWordIndex(
+      const Eigen::MatrixBase<DerivedQuery>& descriptor) const {
+    CHECK_EQ(descriptor.rows(), 2 * kSubSpaceDimensionality);
+    CHECK(index_ != nullptr);
+    return index_->GetWordIndex(descriptor);
+  }
+
+  inline uint64_t GetVocabularyFingerprint() const {
+    CHECK(index_ != nullptr);
+    return index_->GetVocabularyFingerprint();
+  }
+
+  inline int GetNumWords() const {
+    CHECK(index_ != nullptr);
+    return index_->GetNumWords();
+  }
+
+  // Returns the words of the product vocabulary that are searched for
+  // neighbors of the given query.
+  template <typename DerivedQuery>
+  inline void GetClosestWordIndices(
+      const Eigen::MatrixBase<DerivedQuery>& query_feature,
+      std::vector<int>* word_indices) const {
+    CHECK(index_ != nullptr);
+    index_->GetClosestWordIndices(query_feature, word_indices);
+  }
+
+  inline void ForEachInvertedFile(
+      const std::function<void(int, const Index::InvFile&)>& function) const {
+    CHECK(index_ != nullptr);
+    index_->ForEachInvertedFile(function);
+  }
+
   template <typename DerivedQuery, typename DerivedIndices,
             typename DerivedDistances>
   inline void GetNNearestNeighbors(
@@ -241,7 +296,7 @@ class InvertedMultiIndexInterface : public IndexInterface {
 using inverted_multi_index::InvertedMultiProductQuantizationIndex;
 class InvertedMultiProductQuantizationIndexInterface : public IndexInterface {
  public:
-  typedef int DataType;
+  typedef unsigned char DataType;
   enum {
     kSubSpaceDimensionality = 5,
     kNumSubSpaceComponents = 5,
@@ -293,6 +348,16 @@ class InvertedMultiProductQuantizationIndexInterface : public IndexInterface {
     return index_->GetNumDescriptorsInIndex();
   }
 
+  // The index keeps its own copy of the words and the quantizer centers.
+  virtual size_t GetVocabularyNumBytes() const {
+    return (vocabulary_.projection_matrix_.size() +
+            2u * (vocabulary_.words_first_half_.size() +
+                  vocabulary_.words_second_half_.size() +
+                  vocabulary_.quantizer_centers_1.size() +
+                  vocabulary_.quantizer_centers_2.size())) *
+           sizeof(float);
+  }
+
   virtual void Clear() {
     index_->Clear();
   }
@@ -307,6 +372,45 @@ class InvertedMultiProductQuantizationIndexInterface : public IndexInterface {
     index_->AddDescriptors(descriptors);
   }
 
+  // Adds descriptors that have been quantized beforehand using
+  // QuantizeDescriptors with the same vocabulary.
+  void AddQuantizedDescriptors(
+      const ProductQuantizedDescriptorMatrix& quantized_residuals,
+      const Eigen::VectorXi& word_indices) {
+    CHECK_EQ(quantized_residuals.rows(), kNumComponents);
+    CHECK(index_ != nullptr);
+    index_->AddQuantizedDescriptors(quantized_residuals, word_indices);
+  }
+
+  // Computes the word of the product vocabulary and the product quantized
+  // residual of the given descriptor.
+  template <typename DerivedQuery>
+  inline void QuantizeDescriptor(
+      const Eigen::MatrixBase<DerivedQuery>& descriptor, int* word_index,
+      Index::StoredDescriptorType* quantized_residual) const {
+    CHECK_EQ(descriptor.rows(), 2 * kSubSpaceDimensionality);
+    CHECK(index_ != nullptr);
+    index_->QuantizeDescriptor(descriptor, word_index, quantized_residual);
+  }
+
+  inline uint64_t GetVocabularyFingerprint() const {
+    CHECK(index_ != nullptr);
+    return index_->GetVocabularyFingerprint();
+  }
+
+  void GetCodebook(ProductQuantizationCodebook* codebook) const {
+    CHECK_NOTNULL(codebook);
+    codebook->words_1 = vocabulary_.words_first_half_;
+    codebook->words_2 = vocabulary_.words_second_half_;
+    codebook->quantizer_centers_1 = vocabulary_.quantizer_centers_1;
+    codebook->quantizer_centers_2 = vocabulary_.quantizer_centers_2;
+    codebook->num_components = vocabulary_.number_of_components;
+    codebook->num_centers = vocabulary_.number_of_centers;
+    codebook->num_dimensions_per_component =
+        vocabulary_.number_of_dimensions_per_component;
+    codebook->vocabulary_fingerprint = GetVocabularyFingerprint();
+  }
+
   template <typename DerivedQuery, typename DerivedIndices,
             typename DerivedDistances>
   inline void GetNNearestNeighbors(
@@ -35,6 +35,10 @@ class KDTreeIndexInterface : public IndexInterface {
     return index_->GetNumDescriptorsInIndex();
   }
 
+  virtual size_t GetVocabularyNumBytes() const {
+    return projection_matrix_.size() * sizeof(float);
+  }
+
   virtual void Clear() {
     index_->Clear();
   }
@@ -44,6 +48,11 @@ class KDTreeIndexInterface : public IndexInterface {
     CHECK(index_ != nullptr);
     index_->AddDescriptors(descriptors);
   }
+  virtual void FinishAddingDescriptors() {
+    std::lock_guard<std::mutex> lock(index_mutex_);
+    CHECK(index_ != nullptr);
+    index_->FinishMerges();
+  }
   template <typename DerivedQuery, typename DerivedIndices,
             typename DerivedDistances>
   inline void GetNNearestNeighbors(
@@ -2,8 +2,13 @@
 #define MATCHING_BASED_LOOPCLOSURE_KD_TREE_INDEX_H_
 
 #include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <functional>
+#include <future>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <queue>
 #include <tuple>
 #include <unordered_map>
@@ -18,6 +23,21 @@
 
 namespace loop_closure {
 namespace kd_tree_index {
+// The index is a forest of static kd-trees over consecutive ranges of the
+// descriptors (logarithmic method). Every AddDescriptors call adds a tree for
+// the new descriptors. Whenever a tree holds no more descriptors than all newer
+// trees together, it is merged with them into a single tree in the background.
+// Every tree is thus larger than all newer trees together, so there are
+// O(log n) trees and every descriptor is part of O(log n) tree builds. Queries
+// search all trees and merge the results, they never rebuild a tree.
+//
+// The forest is immutable once published. Adding descriptors and taking over
+// finished merges publish a new forest, queries search the forest that was
+// current when they started. Queries can therefore run concurrently with each
+// other and with adding descriptors. Queries also take over a finished merge
+// if no update is in progress, such that an index that doesn't grow anymore
+// ends up with the merged trees without blocking anyone. Bulk insertions
+// should call FinishMerges once all descriptors are added.
 template <int kDimVectors>
 class KDTreeIndex {
  public:
@@ -34,65 +54,61 @@ class KDTreeIndex {
   // Epsilon approximation factor for kd-tree backtracking.
   static constexpr float kSearchNNEpsilon = 0.1;
 
-  KDTreeIndex() {}
+  KDTreeIndex()
+      : forest_(std::make_shared<Forest>()),
+        pending_merge_begin_(0u),
+        pending_merge_num_trees_(0u) {}
+
+  ~KDTreeIndex() {
+    WaitForPendingMerge();
+  }
 
   inline void Clear() {
-    index_data_.resize(Eigen::NoChange, 0);
-    index_.reset();
-    pending_descriptor_blocks_.clear();
+    std::lock_guard<std::mutex> lock(update_mutex_);
+    WaitForPendingMerge();
+    pending_merge_ = std::future<Tree>();
+    PublishForest(std::make_shared<Forest>());
   }
 
   inline int GetNumDescriptorsInIndex() const {
-    int num_descriptors = index_data_.cols();
-    for (const std::shared_ptr<Eigen::MatrixXf>& pending_block :
-         pending_descriptor_blocks_) {
-      num_descriptors += pending_block->cols();
+    const std::shared_ptr<const Forest> forest = GetForest();
+    if (forest->empty()) {
+      return 0;
     }
-    return num_descriptors;
+    return forest->back().offset + forest->back().data->cols();
   }
 
-  // Adds descriptors to an internal waiting list. These descriptors will be
-  // added on the next time the index is queried.
-  void AddDescriptors(const DescriptorMatrixType& descriptors) {
-    pending_descriptor_blocks_.push_back(
-        aligned_shared<Eigen::MatrixXf>(descriptors));
+  inline size_t GetNumTrees() const {
+    return GetForest()->size();
   }
 
-  void RefreshIndex() const {
-    if (pending_descriptor_blocks_.empty())
+  // Adds a tree for the descriptors, merging trees in the background if
+  // necessary.
+  void AddDescriptors(const DescriptorMatrixType& descriptors) {
+    if (descriptors.cols() == 0) {
       return;
-
-    int total_num_descriptors_to_add = 0;
-    for (const std::shared_ptr<Eigen::MatrixXf>& descriptor_block :
-         pending_descriptor_blocks_) {
-      CHECK(descriptor_block != nullptr);
-      total_num_descriptors_to_add += descriptor_block->cols();
-    }
-    int old_num_descriptors = index_data_.cols();
-    int new_num_descriptors =
-        total_num_descriptors_to_add + old_num_descriptors;
-
-    index_data_.conservativeResize(kDimVectors, new_num_descriptors);
-
-    int curr_offset = old_num_descriptors;
-    for (const std::shared_ptr<Eigen::MatrixXf>& descriptor_block :
-         pending_descriptor_blocks_) {
-      const DescriptorMatrixType& descriptors = *descriptor_block;
-      int num_descriptors = descriptors.cols();
-      index_data_.block(0, curr_offset, kDimVectors, num_descriptors) =
-          descriptors;
-      curr_offset += num_descriptors;
     }
+    std::lock_guard<std::mutex> lock(update_mutex_);
+    ApplyFinishedMerge();
+    std::shared_ptr<Forest> forest = std::make_shared<Forest>(*GetForest());
+    const int num_descriptors = forest->empty()
+                                    ? 0
+                                    : forest->back().offset +
+                                          forest->back().data->cols();
+    forest->emplace_back(
+        BuildTree(
+            num_descriptors, aligned_shared<Eigen::MatrixXf>(descriptors)));
+    PublishForest(forest);
+    StartMergeIfNecessary();
+  }
 
-    if (index_data_.cols() == 0) {
-      pending_descriptor_blocks_.clear();
-      index_.reset();
-      return;
-    }
-    index_.reset(
-        NNSearch::createKDTreeLinearHeap(
-            index_data_, kDimVectors, kCollectTouchStatistics));
-    pending_descriptor_blocks_.clear();
+  // Blocks until no more trees need to be merged.
+  void FinishMerges() {
+    std::lock_guard<std::mutex> lock(update_mutex_);
+    do {
+      WaitForPendingMerge();
+      ApplyFinishedMerge();
+    } while (pending_merge_.valid());
   }
 
   // Finds the n nearest neighbors for a given query feature.
@@ -108,25 +124,201 @@ class KDTreeIndex {
     CHECK_EQ(distances->rows(), num_neighbors)
         << "The distances parameter must be pre-allocated to hold all results.";
 
-    // Lazy refresh of the index if more data was added in the meantime.
-    RefreshIndex();
-    if (!index_) {
+    TryApplyFinishedMerge();
+    const std::shared_ptr<const Forest> forest = GetForest();
+    if (forest->empty()) {
       indices->setConstant(-1);
       distances->setConstant(std::numeric_limits<float>::infinity());
       LOG(WARNING) << "The kd-tree index is not available.";
       return;
     }
-    const NNSearch& index_ref = *index_;
-    index_ref.knn(
-        query_features, *indices, *distances, num_neighbors, kSearchNNEpsilon,
-        kSearchOptionsDefault, FLAGS_lc_knn_max_radius);
+
+    if (forest->size() == 1u &&
+        forest->front().data->cols() >= static_cast<int>(num_neighbors)) {
+      forest->front().index->knn(
+          query_features, *indices, *distances, num_neighbors,
+          kSearchNNEpsilon, kSearchOptionsDefault, FLAGS_lc_knn_max_radius);
+      return;
+    }
+
+    // Search every tree and keep the num_neighbors closest results of all
+    // trees. Distances are comparable across trees, the results of every tree
+    // are sorted.
+    const int num_queries = query_features.cols();
+    indices->setConstant(-1);
+    distances->setConstant(std::numeric_limits<float>::infinity());
+    Eigen::MatrixXi tree_indices;
+    Eigen::MatrixXf tree_distances;
+    std::vector<std::pair<float, int>> candidates;
+    for (const Tree& tree : *forest) {
+      const int num_tree_neighbors =
+          std::min<int>(num_neighbors, tree.data->cols());
+      tree_indices.resize(num_tree_neighbors, num_queries);
+      tree_distances.resize(num_tree_neighbors, num_queries);
+      tree.index->knn(
+          query_features, tree_indices, tree_distances, num_tree_neighbors,
+          kSearchNNEpsilon, kSearchOptionsDefault, FLAGS_lc_knn_max_radius);
+
+      for (int query_idx = 0; query_idx < num_queries; ++query_idx) {
+        candidates.clear();
+        for (int i = 0; i < num_neighbors; ++i) {
+          if ((*indices)(i, query_idx) < 0) {
+            break;
+          }
+          candidates.emplace_back(
+              (*distances)(i, query_idx), (*indices)(i, query_idx));
+        }
+        for (int i = 0; i < num_tree_neighbors; ++i) {
+          const float distance = tree_distances(i, query_idx);
+          if (tree_indices(i, query_idx) < 0 || std::isinf(distance)) {
+            break;
+          }
+          candidates.emplace_back(
+              distance, tree.offset + tree_indices(i, query_idx));
+        }
+        const int num_results =
+            std::min<int>(num_neighbors, candidates.size());
+        std::partial_sort(
+            candidates.begin(), candidates.begin() + num_results,
+            candidates.end());
+        for (int i = 0; i < num_results; ++i) {
+          (*distances)(i, query_idx) = candidates[i].first;
+          (*indices)(i, query_idx) = candidates[i].second;
+        }
+      }
+    }
   }
 
  protected:
-  mutable std::shared_ptr<NNSearch> index_;
-  mutable Eigen::MatrixXf index_data_;
-  mutable std::vector<std::shared_ptr<Eigen::MatrixXf> >
-      pending_descriptor_blocks_;
+  struct Tree {
+    // Index of the first descriptor of the tree within the whole index.
+    int offset;
+    // The search keeps a reference to the data, which therefore must not move.
+    std::shared_ptr<Eigen::MatrixXf> data;
+    std::shared_ptr<NNSearch> index;
+  };
+  // Ordered by offset, covering all descriptors.
+  typedef std::vector<Tree> Forest;
+
+  static Tree BuildTree(
+      const int offset, const std::shared_ptr<Eigen::MatrixXf>& data) {
+    CHECK(data != nullptr);
+    CHECK_GT(data->cols(), 0);
+    Tree tree;
+    tree.offset = offset;
+    tree.data = data;
+    tree.index.reset(
+        NNSearch::createKDTreeLinearHeap(
+            *data, kDimVectors, kCollectTouchStatistics));
+    return tree;
+  }
+
+  static Tree MergeTrees(const std::vector<Tree>& trees) {
+    CHECK(!trees.empty());
+    int num_descriptors = 0;
+    for (const Tree& tree : trees) {
+      CHECK_EQ(tree.offset, trees.front().offset + num_descriptors);
+      num_descriptors += tree.data->cols();
+    }
+    std::shared_ptr<Eigen::MatrixXf> data =
+        aligned_shared<Eigen::MatrixXf>(kDimVectors, num_descriptors);
+    for (const Tree& tree : trees) {
+      data->block(0, tree.offset - trees.front().offset, kDimVectors,
+                  tree.data->cols()) = *tree.data;
+    }
+    return BuildTree(trees.front().offset, data);
+  }
+
+  std::shared_ptr<const Forest> GetForest() const {
+    std::lock_guard<std::mutex> lock(forest_mutex_);
+    return forest_;
+  }
+
+  void PublishForest(const std::shared_ptr<const Forest>& forest) const {
+    CHECK(forest != nullptr);
+    std::lock_guard<std::mutex> lock(forest_mutex_);
+    forest_ = forest;
+  }
+
+  // Starts merging the oldest tree that holds no more descriptors than all
+  // newer trees together with all newer trees. Only one merge runs at a time.
+  // Requires update_mutex_ to be held.
+  void StartMergeIfNecessary() const {
+    if (pending_merge_.valid()) {
+      return;
+    }
+    const std::shared_ptr<const Forest> forest = GetForest();
+    size_t merge_begin = forest->size();
+    int num_newer_descriptors = 0;
+    for (size_t tree_idx = forest->size(); tree_idx-- > 0u;) {
+      const int num_tree_descriptors = (*forest)[tree_idx].data->cols();
+      if (num_tree_descriptors <= num_newer_descriptors) {
+        merge_begin = tree_idx;
+      }
+      num_newer_descriptors += num_tree_descriptors;
+    }
+    if (merge_begin == forest->size()) {
+      return;
+    }
+
+    // The trees are immutable, so the merge can run on copies of the
+    // pointers while the index keeps answering queries with the old trees.
+    std::vector<Tree> trees_to_merge(
+        forest->begin() + merge_begin, forest->end());
+    pending_merge_begin_ = merge_begin;
+    pending_merge_num_trees_ = trees_to_merge.size();
+    pending_merge_ = std::async(
+        std::launch::async, &KDTreeIndex::MergeTrees,
+        std::move(trees_to_merge));
+  }
+
+  // Same as ApplyFinishedMerge, but skipped if an update is in progress. Does
+  // not block, hence it can be called from the queries. The merged forest
+  // holds the same descriptors at the same indices, so the index doesn't
+  // change logically.
+  void TryApplyFinishedMerge() const {
+    std::unique_lock<std::mutex> lock(update_mutex_, std::try_to_lock);
+    if (lock.owns_lock()) {
+      ApplyFinishedMerge();
+    }
+  }
+
+  // Publishes a forest with the merged trees replaced by the result of the
+  // merge if it is done. Requires update_mutex_ to be held.
+  void ApplyFinishedMerge() const {
+    if (!pending_merge_.valid() ||
+        pending_merge_.wait_for(std::chrono::seconds(0)) !=
+            std::future_status::ready) {
+      return;
+    }
+    const Tree merged_tree = pending_merge_.get();
+    std::shared_ptr<Forest> forest = std::make_shared<Forest>(*GetForest());
+    CHECK_LE(pending_merge_begin_ + pending_merge_num_trees_, forest->size());
+    CHECK_EQ(merged_tree.offset, (*forest)[pending_merge_begin_].offset);
+    (*forest)[pending_merge_begin_] = merged_tree;
+    forest->erase(
+        forest->begin() + pending_merge_begin_ + 1u,
+        forest->begin() + pending_merge_begin_ + pending_merge_num_trees_);
+    PublishForest(forest);
+    StartMergeIfNecessary();
+  }
+
+  void WaitForPendingMerge() {
+    if (pending_merge_.valid()) {
+      pending_merge_.wait();
+    }
+  }
+
+  // The current forest, replaced as a whole on every update. Mutable as the
+  // queries take over finished merges.
+  mutable std::shared_ptr<const Forest> forest_;
+  mutable std::mutex forest_mutex_;
+
+  // Serializes the updates of the forest and guards the pending merge.
+  mutable std::mutex update_mutex_;
+  mutable std::future<Tree> pending_merge_;
+  mutable size_t pending_merge_begin_;
+  mutable size_t pending_merge_num_trees_;
 };
 }  // namespace kd_tree_index
 }  // namespace loop_closure
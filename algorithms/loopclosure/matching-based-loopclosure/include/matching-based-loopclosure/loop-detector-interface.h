@@ -1,11 +1,17 @@
 #ifndef MATCHING_BASED_LOOPCLOSURE_LOOP_DETECTOR_INTERFACE_H_
 #define MATCHING_BASED_LOOPCLOSURE_LOOP_DETECTOR_INTERFACE_H_
 
+#include <cstdint>
 #include <memory>
+#include <string>
 #include <vector>
 
+#include <Eigen/Core>
+#include <aslam/common/hash-id.h>
 #include <descriptor-projection/descriptor-projection.h>
+#include <loopclosure-common/product-quantization-codebook.h>
 #include <loopclosure-common/types.h>
+#include <maplab-common/mapped-memory.h>
 
 #include "matching-based-loopclosure/helpers.h"
 #include "matching-based-loopclosure/matching_based_loop_detector.pb.h"
@@ -24,12 +30,73 @@ class LoopDetector {
       const bool parallelize_if_possible,
       loop_closure::FrameToMatches* frame_matches) const = 0;
 
+  // Same as Find, but the images are matched exhaustively against the given
+  // candidates instead of the database, e.g. against the observations of the
+  // landmarks around a pose prior. The number of neighbors, the maximum
+  // distance and the covisibility filtering are the same as in Find.
+  virtual void FindInCandidates(
+      const loop_closure::ProjectedImagePtrList& projected_image_ptr_list,
+      const loop_closure::CandidateDescriptors& candidates,
+      loop_closure::FrameToMatches* frame_matches) const = 0;
+
   // Add the provided image (consisting of projected descriptors) to the
   // descriptor index backend.
   virtual void Insert(
       const std::shared_ptr<loop_closure::ProjectedImage>&
           projected_image_ptr) = 0;
 
+  // Completes the work deferred by the insertions, e.g. merging the trees of
+  // the kd-tree backend, such that the following queries are as fast as
+  // possible. Called at the end of bulk insertions.
+  virtual void FinishInsertions() = 0;
+
+  // Add the provided image to the database. The projected descriptors are
+  // assigned to the given visual words, as computed by ComputeWordIndices,
+  // instead of being quantized again.
+  virtual void InsertWithWordIndices(
+      const std::shared_ptr<loop_closure::ProjectedImage>& projected_image_ptr,
+      const Eigen::VectorXi& word_indices) = 0;
+
+  // Computes the visual word of the index backend for every column of the
+  // projected descriptors and returns the fingerprint of the vocabulary used.
+  // Returns false if the backend doesn't support precomputed visual words.
+  virtual bool ComputeWordIndices(
+      const Eigen::MatrixXf& projected_descriptors,
+      Eigen::VectorXi* word_indices,
+      uint64_t* vocabulary_fingerprint) const = 0;
+
+  // Returns false if the backend doesn't support precomputed visual words.
+  virtual bool GetVocabularyFingerprint(
+      uint64_t* vocabulary_fingerprint) const = 0;
+
+  // Add the provided image to the database using only the product quantized
+  // representation of its descriptors, as computed by
+  // ProductQuantizeDescriptors. The projected descriptors of the image are
+  // ignored.
+  virtual void InsertProductQuantized(
+      const std::shared_ptr<loop_closure::ProjectedImage>& projected_image_ptr,
+      const Eigen::VectorXi& word_indices,
+      const loop_closure::ProductQuantizedDescriptorMatrix&
+          quantized_residuals) = 0;
+
+  // Computes the visual word and the product quantized residual of every
+  // column of the projected descriptors, together with the codebook required
+  // to decode them. Returns false if the backend doesn't store product
+  // quantized descriptors.
+  virtual bool ProductQuantizeDescriptors(
+      const Eigen::MatrixXf& projected_descriptors,
+      Eigen::VectorXi* word_indices,
+      loop_closure::ProductQuantizedDescriptorMatrix* quantized_residuals,
+      loop_closure::ProductQuantizationCodebook* codebook) const = 0;
+
+  // Returns false if the backend doesn't store product quantized descriptors.
+  virtual bool GetProductQuantizationFingerprint(
+      uint64_t* vocabulary_fingerprint) const = 0;
+
+  // Whether the backend searches descriptors projected with the projection
+  // matrix, which is the representation stored in localization summary maps.
+  virtual bool SearchesProjectedDescriptors() const = 0;
+
   // Transforms an image into a set of projected descriptors.
   virtual void ProjectDescriptors(
       const std::vector<aslam::common::FeatureDescriptorConstRef>& descriptors,
@@ -43,6 +110,8 @@ class LoopDetector {
   virtual void Clear() = 0;
   virtual size_t NumEntries() const = 0;
   virtual int NumDescriptors() const = 0;
+  // Memory used by the projection matrix and the vocabulary of the backend.
+  virtual size_t VocabularyNumBytes() const = 0;
 
   virtual void serialize(
       matching_based_loopclosure::proto::MatchingBasedLoopDetector*
@@ -50,6 +119,29 @@ class LoopDetector {
   virtual void deserialize(
       const matching_based_loopclosure::proto::MatchingBasedLoopDetector&
           matching_based_loop_detector) = 0;
+
+  // Publishes an immutable copy of the database, together with the given
+  // dataset ids and the ID of the data the database was built from, to a
+  // shared memory object or a file. Other processes can attach to it with
+  // attachMappedDatabase instead of building their own database. An existing
+  // object or file of the same name is replaced, e.g. one left behind by a
+  // crashed publisher. Processes attached to it keep their mapping. The loop
+  // detector owns the name and removes it when it is destroyed or publishes
+  // again. Returns false if the database can't be published.
+  virtual bool publishMappedDatabase(
+      const common::MappedMemory::Type type, const std::string& name,
+      const std::vector<loop_closure::DatasetId>& dataset_ids,
+      const aslam::HashId& source_id) = 0;
+
+  // Replaces the database by a read-only mapping of a published database and
+  // returns the dataset ids it has been published with. The database is
+  // searched in place, nothing is copied or rebuilt. If source_id is valid,
+  // the database must have been published with the same source ID. Returns
+  // false if there is no compatible database with the given name.
+  virtual bool attachMappedDatabase(
+      const common::MappedMemory::Type type, const std::string& name,
+      const aslam::HashId& source_id,
+      std::vector<loop_closure::DatasetId>* dataset_ids) = 0;
 };
 
 }  // namespace loop_detector
@@ -0,0 +1,200 @@
+#ifndef MATCHING_BASED_LOOPCLOSURE_MAPPED_DATABASE_H_
+#define MATCHING_BASED_LOOPCLOSURE_MAPPED_DATABASE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <aslam/common/hash-id.h>
+#include <descriptor-projection/descriptor-projection.h>
+#include <glog/logging.h>
+#include <loopclosure-common/types.h>
+#include <maplab-common/macros.h>
+#include <maplab-common/mapped-memory.h>
+
+namespace matching_based_loopclosure {
+
+// Immutable flat layout of the database of the matching-based loop detector
+// with the inverted multi-index backend. The layout only contains plain arrays
+// without pointers, so it can be placed in a shared memory object or a file
+// and searched in place by any number of processes that map it read-only. The
+// mapping consists of the header followed by the sections:
+//   word offsets: num_words + 1 offsets, the descriptors of word w are the ones
+//     in [word_offsets[w], word_offsets[w + 1]).
+//   descriptors: the projected descriptors, column-major, ordered by word.
+//     The descriptor indices returned by the search are the column indices.
+//   keypoints: the keyframe and keypoint of every descriptor.
+//   keyframes: the keyframes with their metadata.
+//   landmark ids: the landmarks observed by the keypoints of all keyframes.
+//   dataset ids: the datasets (missions) of the database.
+// All IDs are stored as the two 64 bit words of their hash.
+class MappedDatabase {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(MappedDatabase);
+
+  static constexpr uint64_t kMagic = 0x4244504d50414d4cull;
+  static constexpr uint32_t kVersion = 2u;
+  // Sections start at multiples of the cache line size.
+  static constexpr uint64_t kSectionAlignmentBytes = 64u;
+
+  struct Header {
+    // Written last by the publisher, the database is incomplete as long as
+    // the magic is missing.
+    uint64_t magic;
+    uint32_t version;
+    uint32_t descriptor_dimensions;
+    uint64_t vocabulary_fingerprint;
+    // Hash of the ID of the data the database was built from, e.g. of the
+    // localization summary map. Zero if the source has no ID.
+    uint64_t source_id[2];
+    uint64_t size_bytes;
+    uint32_t num_words;
+    uint32_t num_descriptors;
+    uint32_t num_keyframes;
+    uint32_t num_dataset_ids;
+    uint64_t num_landmarks;
+    // Byte offsets of the sections w.r.t. the beginning of the header.
+    uint64_t word_offsets_offset;
+    uint64_t descriptors_offset;
+    uint64_t keypoints_offset;
+    uint64_t keyframes_offset;
+    uint64_t landmark_ids_offset;
+    uint64_t dataset_ids_offset;
+  };
+
+  struct Keypoint {
+    uint32_t keyframe_index;
+    uint32_t keypoint_index;
+  };
+
+  struct Keyframe {
+    uint64_t vertex_id[2];
+    uint64_t dataset_id[2];
+    int64_t timestamp_nanoseconds;
+    // The landmarks of the keypoints of the keyframe are stored at
+    // [first_landmark_index, first_landmark_index + num_landmarks).
+    uint64_t first_landmark_index;
+    uint32_t frame_index;
+    uint32_t num_landmarks;
+  };
+
+  // Computes the section offsets and the total size of a database with the
+  // counts given in the header.
+  static void computeLayout(Header* header);
+
+  // Maps a published database read-only. Returns nullptr if it doesn't exist,
+  // isn't a complete database of the current version or any of its offsets
+  // and indices is out of range.
+  static ConstPtr attach(
+      const common::MappedMemory::Type type, const std::string& name);
+
+  inline const Header& getHeader() const {
+    return *header_;
+  }
+
+  inline int getNumDescriptors() const {
+    return static_cast<int>(header_->num_descriptors);
+  }
+
+  inline int getNumKeyframes() const {
+    return static_cast<int>(header_->num_keyframes);
+  }
+
+  // Returns the range of descriptor indices assigned to the given word.
+  inline void getWordDescriptorRange(
+      const int word_index, int* begin, int* end) const {
+    CHECK_NOTNULL(begin);
+    CHECK_NOTNULL(end);
+    DCHECK_GE(word_index, 0);
+    DCHECK_LT(static_cast<uint32_t>(word_index), header_->num_words);
+    *begin = static_cast<int>(word_offsets_[word_index]);
+    *end = static_cast<int>(word_offsets_[word_index + 1]);
+  }
+
+  inline const float* getDescriptor(const int descriptor_index) const {
+    DCHECK_GE(descriptor_index, 0);
+    DCHECK_LT(descriptor_index, getNumDescriptors());
+    return descriptors_ +
+           static_cast<size_t>(descriptor_index) *
+               header_->descriptor_dimensions;
+  }
+
+  inline const Keypoint& getKeypoint(const int descriptor_index) const {
+    DCHECK_GE(descriptor_index, 0);
+    DCHECK_LT(descriptor_index, getNumDescriptors());
+    return keypoints_[descriptor_index];
+  }
+
+  inline const Keyframe& getKeyframe(const int keyframe_index) const {
+    DCHECK_GE(keyframe_index, 0);
+    DCHECK_LT(keyframe_index, getNumKeyframes());
+    return keyframes_[keyframe_index];
+  }
+
+  inline loop_closure::KeyframeId getKeyframeId(
+      const int keyframe_index) const {
+    const Keyframe& keyframe = getKeyframe(keyframe_index);
+    return loop_closure::KeyframeId(
+        idFromUint64<loop_closure::VertexId>(keyframe.vertex_id),
+        keyframe.frame_index);
+  }
+
+  inline loop_closure::PointLandmarkId getLandmarkId(
+      const uint64_t landmark_index) const {
+    DCHECK_LT(landmark_index, header_->num_landmarks);
+    return idFromUint64<loop_closure::PointLandmarkId>(
+        landmark_ids_ + 2u * landmark_index);
+  }
+
+  void getDatasetIds(std::vector<loop_closure::DatasetId>* dataset_ids) const;
+
+  inline aslam::HashId getSourceId() const {
+    aslam::HashId source_id;
+    source_id.fromUint64(header_->source_id);
+    return source_id;
+  }
+
+  template <typename IdType>
+  static inline void idToUint64(const IdType& id, uint64_t* words) {
+    CHECK_NOTNULL(words);
+    aslam::HashId hash_id;
+    id.toHashId(&hash_id);
+    hash_id.toUint64(words);
+  }
+
+  template <typename IdType>
+  static inline IdType idFromUint64(const uint64_t* words) {
+    aslam::HashId hash_id;
+    hash_id.fromUint64(CHECK_NOTNULL(words));
+    IdType id;
+    id.fromHashId(hash_id);
+    return id;
+  }
+
+  template <typename SectionType>
+  static inline SectionType* getSection(uint8_t* data, const uint64_t offset) {
+    return reinterpret_cast<SectionType*>(CHECK_NOTNULL(data) + offset);
+  }
+
+ private:
+  explicit MappedDatabase(std::unique_ptr<common::MappedMemory> memory);
+
+  // Checks that the word offsets are monotonic and cover all descriptors and
+  // that all keyframe, keypoint and landmark indices are in range.
+  bool hasConsistentIndices() const;
+
+  // Keeps the memory mapped as long as the database is in use.
+  std::unique_ptr<common::MappedMemory> memory_;
+  const Header* header_;
+  const uint32_t* word_offsets_;
+  const float* descriptors_;
+  const Keypoint* keypoints_;
+  const Keyframe* keyframes_;
+  const uint64_t* landmark_ids_;
+  const uint64_t* dataset_ids_;
+};
+
+}  // namespace matching_based_loopclosure
+
+#endif  // MATCHING_BASED_LOOPCLOSURE_MAPPED_DATABASE_H_
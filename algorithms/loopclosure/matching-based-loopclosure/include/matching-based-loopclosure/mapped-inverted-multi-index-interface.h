@@ -0,0 +1,135 @@
+#ifndef MATCHING_BASED_LOOPCLOSURE_MAPPED_INVERTED_MULTI_INDEX_INTERFACE_H_
+#define MATCHING_BASED_LOOPCLOSURE_MAPPED_INVERTED_MULTI_INDEX_INTERFACE_H_
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+#include <glog/logging.h>
+#include <inverted-multi-index/inverted-multi-index-common.h>
+
+#include "matching-based-loopclosure/index-interface.h"
+#include "matching-based-loopclosure/inverted-multi-index-interface.h"
+#include "matching-based-loopclosure/mapped-database.h"
+
+namespace loop_closure {
+// Searches the descriptors of a mapped database in place. The vocabulary and
+// the projection are taken from an inverted multi-index interface, which needs
+// to have the vocabulary the database has been published with. The mapped
+// database is immutable, descriptors can't be added or removed.
+class MappedInvertedMultiIndexInterface : public IndexInterface {
+ public:
+  enum {
+    kDescriptorDimensionality =
+        2 * InvertedMultiIndexInterface::kSubSpaceDimensionality
+  };
+  typedef Eigen::Matrix<float, kDescriptorDimensionality, 1> DescriptorType;
+
+  MappedInvertedMultiIndexInterface(
+      const std::shared_ptr<const InvertedMultiIndexInterface>&
+          vocabulary_interface,
+      const matching_based_loopclosure::MappedDatabase::ConstPtr& database)
+      : vocabulary_interface_(vocabulary_interface), database_(database) {
+    CHECK(vocabulary_interface_ != nullptr);
+    CHECK(database_ != nullptr);
+    CHECK_EQ(
+        database_->getHeader().descriptor_dimensions,
+        static_cast<uint32_t>(kDescriptorDimensionality));
+    CHECK_EQ(
+        database_->getHeader().num_words,
+        static_cast<uint32_t>(vocabulary_interface_->GetNumWords()));
+    CHECK_EQ(
+        database_->getHeader().vocabulary_fingerprint,
+        vocabulary_interface_->GetVocabularyFingerprint());
+  }
+
+  virtual int GetNumDescriptorsInIndex() const {
+    return database_->getNumDescriptors();
+  }
+
+  virtual size_t GetVocabularyNumBytes() const {
+    return vocabulary_interface_->GetVocabularyNumBytes();
+  }
+
+  virtual void Clear() {
+    LOG(FATAL) << "A mapped database is read-only.";
+  }
+
+  virtual void AddDescriptors(const Eigen::MatrixXf& /*descriptors*/) {
+    LOG(FATAL) << "A mapped database is read-only.";
+  }
+
+  // Same search as in the inverted multi-index: all descriptors of the
+  // closest words are compared with the query. The descriptors of a word are
+  // stored contiguously.
+  virtual void GetNNearestNeighborsForFeatures(
+      const Eigen::MatrixXf& query_features, int num_neighbors,
+      Eigen::MatrixXi* indices, Eigen::MatrixXf* distances) const {
+    CHECK_NOTNULL(indices);
+    CHECK_NOTNULL(distances);
+    CHECK_GT(num_neighbors, 0);
+    CHECK_EQ(query_features.rows(), kDescriptorDimensionality);
+    CHECK_EQ(indices->rows(), num_neighbors)
+        << "The indices parameter must be pre-allocated to hold all results.";
+    CHECK_EQ(distances->rows(), num_neighbors)
+        << "The distances parameter must be pre-allocated to hold all results.";
+    CHECK_EQ(indices->cols(), query_features.cols());
+    CHECK_EQ(distances->cols(), query_features.cols());
+
+    std::vector<int> closest_word_indices;
+    std::vector<std::pair<float, int> > nearest_neighbors;
+    nearest_neighbors.reserve(num_neighbors + 1);
+    for (int query_idx = 0; query_idx < query_features.cols(); ++query_idx) {
+      const DescriptorType query_feature = query_features.col(query_idx);
+      vocabulary_interface_->GetClosestWordIndices(
+          query_feature, &closest_word_indices);
+
+      nearest_neighbors.clear();
+      for (const int word_index : closest_word_indices) {
+        int begin, end;
+        database_->getWordDescriptorRange(word_index, &begin, &end);
+        for (int descriptor_idx = begin; descriptor_idx < end;
+             ++descriptor_idx) {
+          const float distance =
+              (Eigen::Map<const DescriptorType>(
+                   database_->getDescriptor(descriptor_idx)) -
+               query_feature)
+                  .squaredNorm();
+          inverted_multi_index::common::InsertNeighbor(
+              descriptor_idx, distance, num_neighbors, &nearest_neighbors);
+        }
+      }
+
+      for (size_t i = 0u; i < nearest_neighbors.size(); ++i) {
+        (*indices)(i, query_idx) = nearest_neighbors[i].second;
+        (*distances)(i, query_idx) = nearest_neighbors[i].first;
+      }
+      for (int i = nearest_neighbors.size(); i < num_neighbors; ++i) {
+        (*indices)(i, query_idx) = -1;
+        (*distances)(i, query_idx) = std::numeric_limits<float>::infinity();
+      }
+    }
+  }
+
+  virtual void ProjectDescriptors(
+      const DescriptorContainer& descriptors,
+      Eigen::MatrixXf* projected_descriptors) const {
+    vocabulary_interface_->ProjectDescriptors(
+        descriptors, projected_descriptors);
+  }
+
+  virtual void ProjectDescriptors(
+      const std::vector<aslam::common::FeatureDescriptorConstRef>& descriptors,
+      Eigen::MatrixXf* projected_descriptors) const {
+    vocabulary_interface_->ProjectDescriptors(
+        descriptors, projected_descriptors);
+  }
+
+ private:
+  const std::shared_ptr<const InvertedMultiIndexInterface>
+      vocabulary_interface_;
+  const matching_based_loopclosure::MappedDatabase::ConstPtr database_;
+};
+}  // namespace loop_closure
+#endif  // MATCHING_BASED_LOOPCLOSURE_MAPPED_INVERTED_MULTI_INDEX_INTERFACE_H_
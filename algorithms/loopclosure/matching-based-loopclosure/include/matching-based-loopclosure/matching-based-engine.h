@@ -2,6 +2,7 @@
 #define MATCHING_BASED_LOOPCLOSURE_MATCHING_BASED_ENGINE_H_
 
 #include <memory>
+#include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -10,9 +11,11 @@
 #include <aslam/common/reader-writer-lock.h>
 #include <descriptor-projection/descriptor-projection.h>
 
+#include "matching-based-loopclosure/covisibility-filter.h"
 #include "matching-based-loopclosure/detector-settings.h"
 #include "matching-based-loopclosure/index-interface.h"
 #include "matching-based-loopclosure/loop-detector-interface.h"
+#include "matching-based-loopclosure/mapped-database.h"
 #include "matching-based-loopclosure/matching_based_loop_detector.pb.h"
 #include "matching-based-loopclosure/scoring.h"
 
@@ -23,7 +26,8 @@ class MatchingBasedLoopDetector : public loop_detector::LoopDetector {
   explicit MatchingBasedLoopDetector(
       const MatchingBasedEngineSettings& settings);
 
-  virtual ~MatchingBasedLoopDetector() = default;
+  // Removes the name of the published database, if any.
+  virtual ~MatchingBasedLoopDetector();
 
   // Find a set of provided images (consisting of projected descriptors), that
   // belong to the same vertex, in the database.
@@ -32,11 +36,51 @@ class MatchingBasedLoopDetector : public loop_detector::LoopDetector {
       const bool parallelize_if_possible,
       loop_closure::FrameToMatches* frame_matches) const override;
 
+  void FindInCandidates(
+      const loop_closure::ProjectedImagePtrList& projected_image_ptr_list,
+      const loop_closure::CandidateDescriptors& candidates,
+      loop_closure::FrameToMatches* frame_matches) const override;
+
   // Add the provided image (consisting of projected descriptors) to the
   // descriptor index backend.
   void Insert(
       const loop_closure::ProjectedImage::Ptr& projected_image_ptr) override;
 
+  // Add the provided image to the database, using precomputed visual words for
+  // its projected descriptors. Only supported by the inverted multi-index.
+  void InsertWithWordIndices(
+      const loop_closure::ProjectedImage::Ptr& projected_image_ptr,
+      const Eigen::VectorXi& word_indices) override;
+
+  bool ComputeWordIndices(
+      const Eigen::MatrixXf& projected_descriptors,
+      Eigen::VectorXi* word_indices,
+      uint64_t* vocabulary_fingerprint) const override;
+
+  bool GetVocabularyFingerprint(
+      uint64_t* vocabulary_fingerprint) const override;
+
+  // Add the provided image to the database, using only the product quantized
+  // representation of its descriptors. Only supported by the inverted
+  // multi-index with product quantization.
+  void InsertProductQuantized(
+      const loop_closure::ProjectedImage::Ptr& projected_image_ptr,
+      const Eigen::VectorXi& word_indices,
+      const loop_closure::ProductQuantizedDescriptorMatrix& quantized_residuals)
+      override;
+
+  bool ProductQuantizeDescriptors(
+      const Eigen::MatrixXf& projected_descriptors,
+      Eigen::VectorXi* word_indices,
+      loop_closure::ProductQuantizedDescriptorMatrix* quantized_residuals,
+      loop_closure::ProductQuantizationCodebook* codebook) const override;
+
+  bool GetProductQuantizationFingerprint(
+      uint64_t* vocabulary_fingerprint) const override;
+
+  // False for the Hamming index, which searches the raw binary descriptors.
+  bool SearchesProjectedDescriptors() const override;
+
   // Transforms an image into a set of projected descriptors.
   void ProjectDescriptors(
       const loop_closure::DescriptorContainer& descriptors,
@@ -47,6 +91,8 @@ class MatchingBasedLoopDetector : public loop_detector::LoopDetector {
       const std::vector<aslam::common::FeatureDescriptorConstRef>& descriptors,
       Eigen::MatrixXf* projected_descriptors) const override;
 
+  void FinishInsertions() override;
+
   void Clear() override;
 
   void serialize(proto::MatchingBasedLoopDetector* matching_based_loop_detector)
@@ -55,6 +101,16 @@ class MatchingBasedLoopDetector : public loop_detector::LoopDetector {
       const proto::MatchingBasedLoopDetector& matching_based_loop_detector)
       override;
 
+  // Only supported by the inverted multi-index.
+  bool publishMappedDatabase(
+      const common::MappedMemory::Type type, const std::string& name,
+      const std::vector<loop_closure::DatasetId>& dataset_ids,
+      const aslam::HashId& source_id) override;
+  bool attachMappedDatabase(
+      const common::MappedMemory::Type type, const std::string& name,
+      const aslam::HashId& source_id,
+      std::vector<loop_closure::DatasetId>* dataset_ids) override;
+
  private:
   typedef std::unordered_map<loop_closure::KeyframeId,
                              loop_closure::ProjectedImage::Ptr>
@@ -69,46 +125,58 @@ class MatchingBasedLoopDetector : public loop_detector::LoopDetector {
       KeyframeToMatchesMap;
   typedef loop_closure::IdToMatches<loop_closure::VertexId> VertexToMatchesMap;
 
-  template <typename IdType>
-  using IdToScoreMap = std::unordered_map<IdType, scoring::ScoreType>;
-
   void setKeyframeScoringFunction();
   void setDetectorEngine();
 
+  // Adds the projected image to the database and assigns descriptor indices
+  // to its keypoints. Doesn't touch the index backend. The write lock needs
+  // to be held by the caller.
+  void insertIntoDatabase(const loop_closure::ProjectedImage& projected_image);
+
   size_t NumEntries() const override {
-    return database_.size();
+    return mapped_database_ != nullptr ? mapped_database_->getNumKeyframes()
+                                       : database_.size();
   }
 
   int NumDescriptors() const override {
     return index_interface_->GetNumDescriptorsInIndex();
   }
 
+  size_t VocabularyNumBytes() const override {
+    return index_interface_->GetVocabularyNumBytes();
+  }
+
   // Find the largest connected subgraph of keyframes or vertices and landmarks
-  // to be passed to RANSAC. This is just a plain BFS over landmarks and
-  // keyframes or vertices. This function adds matches to the already existing
-  // matches. There is an option to pass a mutex that is used to lock the
-  // (output) frame matches.
+  // to be passed to RANSAC. The keyframes or vertices are connected if they
+  // share a matched landmark. This function adds matches to the already
+  // existing matches. There is an option to pass a mutex that is used to lock
+  // the (output) frame matches. The buffers must not be shared between
+  // threads, reusing them for several filterings saves their allocations.
+  // The keyframes are scored relative to the searched descriptors, given by
+  // their number per keyframe and in total.
   template <typename IdType>
   void doCovisibilityFiltering(
       const loop_closure::IdToMatches<IdType>& id_to_matches,
       const bool make_matches_unique,
+      const KeyframeIdToNumDescriptorsMap& keyframe_id_to_num_descriptors,
+      const size_t num_descriptors, CovisibilityFilterBuffers<IdType>* buffers,
       loop_closure::FrameToMatches* frame_matches,
       std::mutex* frame_matches_mutex = nullptr) const;
+  // Marks the keyframes that see a lot of the matched landmarks as relevant,
+  // only their matches are considered by the covisibility filtering.
   template <typename IdType>
   void computeRelevantIdsForFiltering(
-      const loop_closure::IdToMatches<IdType>& frame_to_matches,
-      IdToScoreMap<IdType>* frame_to_score_map) const;
-  // Skip match if not in the set of keyframes that see a lot of the matched
-  // landmarks.
-  template <typename IdType>
-  bool skipMatch(
-      const IdToScoreMap<IdType>& frame_to_score_map,
-      const loop_closure::Match& match) const;
-  template <typename IdType>
-  typename loop_closure::IdToMatches<IdType>::const_iterator
-  getIteratorForMatch(
-      const loop_closure::IdToMatches<IdType>& frame_to_matches,
-      const loop_closure::Match& match) const;
+      const loop_closure::IdToMatches<IdType>& id_to_matches,
+      const KeyframeIdToNumDescriptorsMap& keyframe_id_to_num_descriptors,
+      const size_t num_descriptors,
+      CovisibilityFilterBuffers<IdType>* buffers) const;
+  // Groups the keyframe matches of all query images by vertex and keeps the
+  // largest covisible component, with unique matches.
+  void doVertexCovisibilityFiltering(
+      const loop_closure::FrameToMatches& keyframe_matches,
+      const KeyframeIdToNumDescriptorsMap& keyframe_id_to_num_descriptors,
+      const size_t num_descriptors,
+      loop_closure::FrameToMatches* frame_matches) const;
 
   // Returns true if the match has been successfully retrieved. Returns false,
   // if the match was too close in time to the query vertex.
@@ -116,7 +184,11 @@ class MatchingBasedLoopDetector : public loop_detector::LoopDetector {
       int nn_match_descriptor_index,
       const loop_closure::ProjectedImage& projected_image_query,
       int keypoint_index_query, loop_closure::Match* structure_match) const;
-  int getNumNeighborsToSearch() const;
+  bool getMatchForMappedDescriptorIndex(
+      int nn_match_descriptor_index,
+      const loop_closure::ProjectedImage& projected_image_query,
+      int keypoint_index_query, loop_closure::Match* structure_match) const;
+  int getNumNeighborsToSearch(const int num_descriptors_in_db) const;
 
   const MatchingBasedEngineSettings settings_;
   Database database_;
@@ -124,8 +196,19 @@ class MatchingBasedLoopDetector : public loop_detector::LoopDetector {
   DescriptorIndexToKeypointIdMap descriptor_index_to_keypoint_id_;
   int descriptor_index_;
   std::shared_ptr<loop_closure::IndexInterface> index_interface_;
+  // Replaces the database, the descriptor index and the index backend while
+  // a mapped database is attached.
+  MappedDatabase::ConstPtr mapped_database_;
+  // The last database published by this loop detector. Only kept to remove
+  // its name again.
+  std::unique_ptr<common::MappedMemory> published_memory_;
   scoring::computeScoresFunction<loop_closure::KeyframeId>
       compute_keyframe_scores_;
+  // Buffers of the covisibility filtering, checked out by every query.
+  mutable CovisibilityFilterBufferPool<loop_closure::KeyframeId>
+      keyframe_filter_buffer_pool_;
+  mutable CovisibilityFilterBufferPool<loop_closure::VertexId>
+      vertex_filter_buffer_pool_;
   mutable aslam::ReaderWriterMutex read_write_mutex;
 };
 }  // namespace matching_based_loopclosure
@@ -28,6 +28,14 @@ DEFINE_int32(
 DEFINE_int32(
     lc_num_words_for_nn_search, 10,
     "Number of nearest words to retrieve in the inverted index.");
+DEFINE_int32(
+    lc_hamming_max_substring_radius, 1,
+    "Maximum number of differing bits per 16 bit substring that the Hamming "
+    "index probes. Neighbors closer than (descriptor bits / 16) * (radius + 1) "
+    "are always found.");
+DEFINE_int32(
+    lc_hamming_max_distance, 70,
+    "Maximum Hamming distance of the neighbors returned by the Hamming index.");
 
 namespace matching_based_loopclosure {
 
@@ -38,44 +46,42 @@ MatchingBasedEngineSettings::MatchingBasedEngineSettings()
       min_image_time_seconds(FLAGS_lc_min_image_time_seconds),
       min_verify_matches_num(FLAGS_lc_min_verify_matches_num),
       fraction_best_scores(FLAGS_lc_fraction_best_scores),
-      num_nearest_neighbors(FLAGS_lc_num_neighbors) {
+      num_nearest_neighbors(FLAGS_lc_num_neighbors),
+      hamming_max_substring_radius(FLAGS_lc_hamming_max_substring_radius),
+      hamming_max_distance(FLAGS_lc_hamming_max_distance) {
   CHECK_GT(num_closest_words_for_nn_search, 0);
   CHECK_GE(min_image_time_seconds, 0.0);
   CHECK_GE(min_verify_matches_num, 0u);
   CHECK_GT(fraction_best_scores, 0.f);
   CHECK_LT(fraction_best_scores, 1.f);
   CHECK_GE(num_nearest_neighbors, -1);
+  CHECK_GE(hamming_max_substring_radius, 0);
+  CHECK_GE(hamming_max_distance, 0);
 
   setKeyframeScoringFunctionType(FLAGS_lc_scoring_function);
   setDetectorEngineType(FLAGS_lc_detector_engine);
 
-  const std::string loop_closure_files_path = getLoopClosureFilePath();
-  const bool use_default_projection_matrix_filepath =
-      projection_matrix_filename.empty();
-  const bool use_default_projected_quantizer_filepath =
-      projected_quantizer_filename.empty();
+  // The default files are only looked up if no file has been given, such
+  // that MAPLAB_LOOPCLOSURE_DIR doesn't need to be set otherwise.
+  std::string descriptor_name;
   if (FLAGS_feature_descriptor_type == loop_closure::kFeatureDescriptorFREAK) {
-    if (use_default_projection_matrix_filepath) {
-      projection_matrix_filename =
-          std::string(loop_closure_files_path) + "/projection_matrix_freak.dat";
-    }
-    if (use_default_projected_quantizer_filepath) {
-      projected_quantizer_filename =
-          std::string(loop_closure_files_path) +
-          "/inverted_multi_index_quantizer_freak.dat";
-    }
+    descriptor_size_bits = loop_closure::kFreakDescriptorLengthBits;
+    descriptor_name = "freak";
   } else {
     CHECK_EQ(
         FLAGS_feature_descriptor_type, loop_closure::kFeatureDescriptorBRISK);
-    if (use_default_projection_matrix_filepath) {
-      projection_matrix_filename =
-          std::string(loop_closure_files_path) + "/projection_matrix_brisk.dat";
-    }
-    if (use_default_projected_quantizer_filepath) {
-      projected_quantizer_filename =
-          std::string(loop_closure_files_path) +
-          "/inverted_multi_index_quantizer_brisk.dat";
-    }
+    descriptor_size_bits = loop_closure::kBriskDescriptorLengthBits;
+    descriptor_name = "brisk";
+  }
+  if (projection_matrix_filename.empty()) {
+    projection_matrix_filename = getLoopClosureFilePath() +
+                                 "/projection_matrix_" + descriptor_name +
+                                 ".dat";
+  }
+  if (projected_quantizer_filename.empty()) {
+    projected_quantizer_filename = getLoopClosureFilePath() +
+                                   "/inverted_multi_index_quantizer_" +
+                                   descriptor_name + ".dat";
   }
 }
 
@@ -106,6 +112,8 @@ void MatchingBasedEngineSettings::setDetectorEngineType(
       kMatchingLDInvertedMultiIndexProductQuantizationString) {
     detector_engine_type =
         DetectorEngineType::kMatchingLDInvertedMultiIndexProductQuantization;
+  } else if (detector_engine_string == kMatchingLDHammingString) {
+    detector_engine_type = DetectorEngineType::kMatchingLDHamming;
   } else {
     LOG(FATAL) << "Unknown loop detector engine type: "
                << detector_engine_string;
@@ -0,0 +1,166 @@
+#include "matching-based-loopclosure/mapped-database.h"
+
+#include <atomic>
+#include <type_traits>
+
+namespace matching_based_loopclosure {
+
+// The layout must not depend on the compiler, it is shared between processes.
+static_assert(
+    std::is_trivially_copyable<MappedDatabase::Header>::value &&
+        sizeof(MappedDatabase::Header) == 120u,
+    "Unexpected header layout.");
+static_assert(
+    sizeof(MappedDatabase::Keypoint) == 8u, "Unexpected keypoint layout.");
+static_assert(
+    sizeof(MappedDatabase::Keyframe) == 56u, "Unexpected keyframe layout.");
+
+constexpr uint64_t MappedDatabase::kMagic;
+constexpr uint32_t MappedDatabase::kVersion;
+constexpr uint64_t MappedDatabase::kSectionAlignmentBytes;
+
+namespace {
+uint64_t alignSectionOffset(const uint64_t offset) {
+  const uint64_t kAlignment = MappedDatabase::kSectionAlignmentBytes;
+  return (offset + kAlignment - 1u) / kAlignment * kAlignment;
+}
+}  // namespace
+
+void MappedDatabase::computeLayout(Header* header) {
+  CHECK_NOTNULL(header);
+  CHECK_GT(header->descriptor_dimensions, 0u);
+  CHECK_GT(header->num_words, 0u);
+  uint64_t offset = sizeof(Header);
+  header->word_offsets_offset = alignSectionOffset(offset);
+  offset = header->word_offsets_offset +
+           (static_cast<uint64_t>(header->num_words) + 1u) * sizeof(uint32_t);
+  header->descriptors_offset = alignSectionOffset(offset);
+  offset = header->descriptors_offset +
+           static_cast<uint64_t>(header->num_descriptors) *
+               header->descriptor_dimensions * sizeof(float);
+  header->keypoints_offset = alignSectionOffset(offset);
+  offset = header->keypoints_offset +
+           static_cast<uint64_t>(header->num_descriptors) * sizeof(Keypoint);
+  header->keyframes_offset = alignSectionOffset(offset);
+  offset = header->keyframes_offset +
+           static_cast<uint64_t>(header->num_keyframes) * sizeof(Keyframe);
+  header->landmark_ids_offset = alignSectionOffset(offset);
+  offset = header->landmark_ids_offset +
+           header->num_landmarks * 2u * sizeof(uint64_t);
+  header->dataset_ids_offset = alignSectionOffset(offset);
+  offset = header->dataset_ids_offset +
+           static_cast<uint64_t>(header->num_dataset_ids) * 2u *
+               sizeof(uint64_t);
+  header->size_bytes = offset;
+}
+
+MappedDatabase::ConstPtr MappedDatabase::attach(
+    const common::MappedMemory::Type type, const std::string& name) {
+  std::unique_ptr<common::MappedMemory> memory =
+      common::MappedMemory::openReadOnly(type, name);
+  if (memory == nullptr) {
+    return nullptr;
+  }
+  if (memory->size() < sizeof(Header)) {
+    LOG(ERROR) << name << " is too small to hold a loop detector database.";
+    return nullptr;
+  }
+  const Header& header = *reinterpret_cast<const Header*>(memory->data());
+  if (header.magic != kMagic) {
+    LOG(ERROR) << name << " is not a loop detector database or is still "
+               << "being published.";
+    return nullptr;
+  }
+  // Pairs with the release fence of the publisher, the content is complete
+  // once the magic is visible.
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (header.version != kVersion) {
+    LOG(ERROR) << name << " has been published with version "
+               << header.version << ", expected version " << kVersion << ".";
+    return nullptr;
+  }
+
+  // Guards against truncated or corrupted databases.
+  if (header.descriptor_dimensions == 0u || header.num_words == 0u) {
+    LOG(ERROR) << name << " has no descriptor dimensions or no words.";
+    return nullptr;
+  }
+  Header expected_layout = header;
+  computeLayout(&expected_layout);
+  if (expected_layout.size_bytes != memory->size() ||
+      expected_layout.word_offsets_offset != header.word_offsets_offset ||
+      expected_layout.descriptors_offset != header.descriptors_offset ||
+      expected_layout.keypoints_offset != header.keypoints_offset ||
+      expected_layout.keyframes_offset != header.keyframes_offset ||
+      expected_layout.landmark_ids_offset != header.landmark_ids_offset ||
+      expected_layout.dataset_ids_offset != header.dataset_ids_offset) {
+    LOG(ERROR) << "The layout of " << name << " is inconsistent.";
+    return nullptr;
+  }
+  ConstPtr database(new MappedDatabase(std::move(memory)));
+  if (!database->hasConsistentIndices()) {
+    LOG(ERROR) << "The indices of " << name << " are inconsistent.";
+    return nullptr;
+  }
+  return database;
+}
+
+MappedDatabase::MappedDatabase(std::unique_ptr<common::MappedMemory> memory)
+    : memory_(std::move(memory)) {
+  CHECK(memory_ != nullptr);
+  const uint8_t* data = memory_->data();
+  header_ = reinterpret_cast<const Header*>(data);
+  word_offsets_ =
+      reinterpret_cast<const uint32_t*>(data + header_->word_offsets_offset);
+  descriptors_ =
+      reinterpret_cast<const float*>(data + header_->descriptors_offset);
+  keypoints_ =
+      reinterpret_cast<const Keypoint*>(data + header_->keypoints_offset);
+  keyframes_ =
+      reinterpret_cast<const Keyframe*>(data + header_->keyframes_offset);
+  landmark_ids_ =
+      reinterpret_cast<const uint64_t*>(data + header_->landmark_ids_offset);
+  dataset_ids_ =
+      reinterpret_cast<const uint64_t*>(data + header_->dataset_ids_offset);
+}
+
+bool MappedDatabase::hasConsistentIndices() const {
+  if (word_offsets_[0] != 0u ||
+      word_offsets_[header_->num_words] != header_->num_descriptors) {
+    return false;
+  }
+  for (uint32_t word = 0u; word < header_->num_words; ++word) {
+    if (word_offsets_[word] > word_offsets_[word + 1u]) {
+      return false;
+    }
+  }
+  for (uint32_t i = 0u; i < header_->num_keyframes; ++i) {
+    const Keyframe& keyframe = keyframes_[i];
+    if (keyframe.first_landmark_index > header_->num_landmarks ||
+        keyframe.num_landmarks >
+            header_->num_landmarks - keyframe.first_landmark_index) {
+      return false;
+    }
+  }
+  for (uint32_t i = 0u; i < header_->num_descriptors; ++i) {
+    const Keypoint& keypoint = keypoints_[i];
+    if (keypoint.keyframe_index >= header_->num_keyframes ||
+        keypoint.keypoint_index >=
+            keyframes_[keypoint.keyframe_index].num_landmarks) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void MappedDatabase::getDatasetIds(
+    std::vector<loop_closure::DatasetId>* dataset_ids) const {
+  CHECK_NOTNULL(dataset_ids)->clear();
+  dataset_ids->reserve(header_->num_dataset_ids);
+  for (uint32_t i = 0u; i < header_->num_dataset_ids; ++i) {
+    dataset_ids->push_back(
+        idFromUint64<loop_closure::DatasetId>(dataset_ids_ + 2u * i));
+  }
+}
+
+}  // namespace matching_based_loopclosure
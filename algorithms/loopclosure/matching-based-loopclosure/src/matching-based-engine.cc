@@ -1,4 +1,7 @@
 #include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -9,6 +12,7 @@
 #include <vector>
 
 #include <descriptor-projection/descriptor-projection.h>
+#include <loopclosure-common/flags.h>
 #include <loopclosure-common/types.h>
 #include <maplab-common/conversions.h>
 #include <maplab-common/parallel-process.h>
@@ -16,15 +20,24 @@
 #include <vi-map/loop-constraint.h>
 
 #include "matching-based-loopclosure/detector-settings.h"
+#include "matching-based-loopclosure/exhaustive-search.h"
+#include "matching-based-loopclosure/hamming-index-interface.h"
 #include "matching-based-loopclosure/helpers.h"
 #include "matching-based-loopclosure/inverted-index-interface.h"
 #include "matching-based-loopclosure/inverted-multi-index-interface.h"
 #include "matching-based-loopclosure/kd-tree-index-interface.h"
+#include "matching-based-loopclosure/mapped-database.h"
+#include "matching-based-loopclosure/mapped-inverted-multi-index-interface.h"
 #include "matching-based-loopclosure/matching-based-engine.h"
 #include "matching-based-loopclosure/scoring.h"
 
 namespace matching_based_loopclosure {
 
+namespace {
+const char kMappedDatabaseIsReadOnly[] =
+    "The mapped database is read-only, clear the loop detector first.";
+}  // namespace
+
 MatchingBasedLoopDetector::MatchingBasedLoopDetector(
     const MatchingBasedEngineSettings& settings)
     : settings_(settings), descriptor_index_(0) {
@@ -38,6 +51,12 @@ MatchingBasedLoopDetector::MatchingBasedLoopDetector(
           << "\n\tproj matrix: " << settings_.projection_matrix_filename;
 }
 
+MatchingBasedLoopDetector::~MatchingBasedLoopDetector() {
+  if (published_memory_ != nullptr) {
+    published_memory_->removeCreatedName();
+  }
+}
+
 void MatchingBasedLoopDetector::ProjectDescriptors(
     const aslam::VisualFrame::DescriptorsT& descriptors,
     Eigen::MatrixXf* projected_descriptors) const {
@@ -64,7 +83,8 @@ void MatchingBasedLoopDetector::Find(
   timing::Timer timer_find("Loop Closure: Find projected images of vertex.");
   aslam::ScopedReadLock lock(&read_write_mutex);
 
-  const int num_neighbors_to_search = getNumNeighborsToSearch();
+  const int num_neighbors_to_search =
+      getNumNeighborsToSearch(index_interface_->GetNumDescriptorsInIndex());
   const size_t num_query_frames = projected_image_ptr_list.size();
   // Vertex to landmark covisibility filtering only makes sense, if more than
   // one camera is associated with the query vertex.
@@ -78,6 +98,9 @@ void MatchingBasedLoopDetector::Find(
 
   std::function<void(const std::vector<size_t>&)> query_helper = [&](
       const std::vector<size_t>& range) {
+    // Every worker uses the same buffers for all query frames of its range.
+    CovisibilityFilterBufferPool<loop_closure::KeyframeId>::BuffersPtr
+        buffers = keyframe_filter_buffer_pool_.acquire();
     for (const size_t job_index : range) {
       const loop_closure::ProjectedImage& projected_image_query =
           *projected_image_ptr_list[job_index];
@@ -129,8 +152,11 @@ void MatchingBasedLoopDetector::Find(
       // removing non-unique matches can split covisibility clusters.
       doCovisibilityFiltering(
           keyframe_to_matches_map, !use_vertex_covis_filter,
+          keyframe_id_to_num_descriptors_,
+          static_cast<size_t>(NumDescriptors()), buffers.get(),
           &temporary_frame_matches, covis_frame_matches_mutex_ptr);
     }
+    keyframe_filter_buffer_pool_.release(std::move(buffers));
   };
   if (parallelize) {
     static const size_t kNumHardwareThreads = common::getNumHardwareThreads();
@@ -148,26 +174,128 @@ void MatchingBasedLoopDetector::Find(
   }
 
   if (use_vertex_covis_filter) {
-    // Convert keyframe matches to vertex matches.
-    const size_t num_frame_matches =
-        loop_closure::getNumberOfMatches(temporary_frame_matches);
-    VertexToMatchesMap vertex_to_matches_map;
-    // Conservative reserve to avoid rehashing.
-    vertex_to_matches_map.reserve(num_frame_matches);
-    for (const loop_closure::FrameToMatches::value_type& id_frame_matches_pair :
-         temporary_frame_matches) {
-      for (const loop_closure::Match& match : id_frame_matches_pair.second) {
-        vertex_to_matches_map[match.keyframe_id_result.vertex_id].push_back(
-            match);
+    doVertexCovisibilityFiltering(
+        temporary_frame_matches, keyframe_id_to_num_descriptors_,
+        static_cast<size_t>(NumDescriptors()), frame_matches_ptr);
+  } else {
+    frame_matches_ptr->swap(temporary_frame_matches);
+  }
+  CHECK_LE(frame_matches_ptr->size(), projected_image_ptr_list.size())
+      << "There cannot be more query frames than projected images.";
+}
+
+void MatchingBasedLoopDetector::FindInCandidates(
+    const loop_closure::ProjectedImagePtrList& projected_image_ptr_list,
+    const loop_closure::CandidateDescriptors& candidates,
+    loop_closure::FrameToMatches* frame_matches_ptr) const {
+  CHECK_NOTNULL(frame_matches_ptr)->clear();
+  const int num_candidates = candidates.projected_descriptors.cols();
+  CHECK_EQ(
+      static_cast<size_t>(num_candidates), candidates.keyframe_ids.size());
+  CHECK_EQ(static_cast<size_t>(num_candidates), candidates.landmarks.size());
+  if (projected_image_ptr_list.empty() || num_candidates == 0) {
+    return;
+  }
+  CHECK(doProjectedImagesBelongToSameVertex(projected_image_ptr_list));
+
+  timing::Timer timer_find("Loop Closure: Find projected images in candidates");
+  // The keyframes are scored relative to the candidates, like they are scored
+  // relative to the database in Find.
+  KeyframeIdToNumDescriptorsMap keyframe_id_to_num_candidates;
+  for (const loop_closure::KeyframeId& keyframe_id : candidates.keyframe_ids) {
+    ++keyframe_id_to_num_candidates[keyframe_id];
+  }
+  const Eigen::RowVectorXf candidate_squared_norms =
+      candidates.projected_descriptors.colwise().squaredNorm();
+  const int num_neighbors_to_search = getNumNeighborsToSearch(num_candidates);
+  // The distances of the nearest neighbor search are squared.
+  const float max_squared_distance =
+      FLAGS_lc_knn_max_radius * FLAGS_lc_knn_max_radius;
+  const bool use_vertex_covis_filter = projected_image_ptr_list.size() > 1u;
+
+  // The buffers are reused for all query images.
+  Eigen::MatrixXf distance_buffer;
+  Eigen::MatrixXi indices;
+  Eigen::MatrixXf distances;
+  loop_closure::FrameToMatches temporary_frame_matches;
+  CovisibilityFilterBufferPool<loop_closure::KeyframeId>::BuffersPtr buffers =
+      keyframe_filter_buffer_pool_.acquire();
+  for (const loop_closure::ProjectedImage::Ptr& projected_image_query_ptr :
+       projected_image_ptr_list) {
+    CHECK(projected_image_query_ptr);
+    const loop_closure::ProjectedImage& projected_image_query =
+        *projected_image_query_ptr;
+    timing::Timer timer_get_nn("Loop Closure: Get neighbors in candidates");
+    loop_closure::exhaustive_search::GetNNearestNeighbors(
+        candidates.projected_descriptors, candidate_squared_norms,
+        projected_image_query.projected_descriptors, num_neighbors_to_search,
+        max_squared_distance, &distance_buffer, &indices, &distances);
+    timer_get_nn.Stop();
+
+    // The candidates carry no timestamps, so unlike in Find, no matches are
+    // skipped for being too close in time.
+    KeyframeToMatchesMap keyframe_to_matches_map;
+    for (int keypoint_idx = 0; keypoint_idx < indices.cols(); ++keypoint_idx) {
+      for (int nn_search_idx = 0; nn_search_idx < indices.rows();
+           ++nn_search_idx) {
+        const int candidate_idx = indices(nn_search_idx, keypoint_idx);
+        if (candidate_idx == -1) {
+          break;  // No more results for this feature.
+        }
+        loop_closure::Match structure_match;
+        structure_match.keypoint_id_query.frame_id =
+            projected_image_query.keyframe_id;
+        structure_match.keypoint_id_query.keypoint_index =
+            static_cast<size_t>(keypoint_idx);
+        structure_match.keyframe_id_result =
+            candidates.keyframe_ids[candidate_idx];
+        structure_match.landmark_result = candidates.landmarks[candidate_idx];
+        keyframe_to_matches_map[structure_match.keyframe_id_result].push_back(
+            structure_match);
       }
     }
     doCovisibilityFiltering(
-        vertex_to_matches_map, use_vertex_covis_filter, frame_matches_ptr);
+        keyframe_to_matches_map, !use_vertex_covis_filter,
+        keyframe_id_to_num_candidates, static_cast<size_t>(num_candidates),
+        buffers.get(), &temporary_frame_matches);
+  }
+  keyframe_filter_buffer_pool_.release(std::move(buffers));
+
+  if (use_vertex_covis_filter) {
+    doVertexCovisibilityFiltering(
+        temporary_frame_matches, keyframe_id_to_num_candidates,
+        static_cast<size_t>(num_candidates), frame_matches_ptr);
   } else {
     frame_matches_ptr->swap(temporary_frame_matches);
   }
-  CHECK_LE(frame_matches_ptr->size(), projected_image_ptr_list.size())
-      << "There cannot be more query frames than projected images.";
+}
+
+void MatchingBasedLoopDetector::doVertexCovisibilityFiltering(
+    const loop_closure::FrameToMatches& keyframe_matches,
+    const KeyframeIdToNumDescriptorsMap& keyframe_id_to_num_descriptors,
+    const size_t num_descriptors,
+    loop_closure::FrameToMatches* frame_matches_ptr) const {
+  CHECK_NOTNULL(frame_matches_ptr);
+  // Convert keyframe matches to vertex matches.
+  const size_t num_frame_matches =
+      loop_closure::getNumberOfMatches(keyframe_matches);
+  VertexToMatchesMap vertex_to_matches_map;
+  // Conservative reserve to avoid rehashing.
+  vertex_to_matches_map.reserve(num_frame_matches);
+  for (const loop_closure::FrameToMatches::value_type& id_frame_matches_pair :
+       keyframe_matches) {
+    for (const loop_closure::Match& match : id_frame_matches_pair.second) {
+      vertex_to_matches_map[match.keyframe_id_result.vertex_id].push_back(
+          match);
+    }
+  }
+  constexpr bool kMakeMatchesUnique = true;
+  CovisibilityFilterBufferPool<loop_closure::VertexId>::BuffersPtr buffers =
+      vertex_filter_buffer_pool_.acquire();
+  doCovisibilityFiltering(
+      vertex_to_matches_map, kMakeMatchesUnique, keyframe_id_to_num_descriptors,
+      num_descriptors, buffers.get(), frame_matches_ptr);
+  vertex_filter_buffer_pool_.release(std::move(buffers));
 }
 
 bool MatchingBasedLoopDetector::getMatchForDescriptorIndex(
@@ -176,6 +304,11 @@ bool MatchingBasedLoopDetector::getMatchForDescriptorIndex(
     int keypoint_index_query, loop_closure::Match* structure_match_ptr) const {
   CHECK_GE(nn_match_descriptor_index, 0);
   CHECK_NOTNULL(structure_match_ptr);
+  if (mapped_database_ != nullptr) {
+    return getMatchForMappedDescriptorIndex(
+        nn_match_descriptor_index, projected_image_query, keypoint_index_query,
+        structure_match_ptr);
+  }
   loop_closure::Match& structure_match = *structure_match_ptr;
 
   const DescriptorIndexToKeypointIdMap::const_iterator iter_keypoint_id_result =
@@ -217,19 +350,238 @@ bool MatchingBasedLoopDetector::getMatchForDescriptorIndex(
   return true;
 }
 
+bool MatchingBasedLoopDetector::getMatchForMappedDescriptorIndex(
+    int nn_match_descriptor_index,
+    const loop_closure::ProjectedImage& projected_image_query,
+    int keypoint_index_query, loop_closure::Match* structure_match_ptr) const {
+  CHECK(mapped_database_ != nullptr);
+  CHECK_LT(nn_match_descriptor_index, mapped_database_->getNumDescriptors());
+  CHECK_NOTNULL(structure_match_ptr);
+  loop_closure::Match& structure_match = *structure_match_ptr;
+
+  const MappedDatabase::Keypoint& keypoint_result =
+      mapped_database_->getKeypoint(nn_match_descriptor_index);
+  const MappedDatabase::Keyframe& keyframe_result =
+      mapped_database_->getKeyframe(keypoint_result.keyframe_index);
+
+  // Skip matches to images which are too close in time.
+  if (std::abs(
+          projected_image_query.timestamp_nanoseconds -
+          keyframe_result.timestamp_nanoseconds) <
+          settings_.min_image_time_seconds * kSecondsToNanoSeconds &&
+      projected_image_query.dataset_id ==
+          MappedDatabase::idFromUint64<loop_closure::DatasetId>(
+              keyframe_result.dataset_id)) {
+    return false;
+  }
+
+  structure_match.keypoint_id_query.frame_id =
+      projected_image_query.keyframe_id;
+  structure_match.keypoint_id_query.keypoint_index =
+      static_cast<size_t>(keypoint_index_query);
+  structure_match.keyframe_id_result =
+      mapped_database_->getKeyframeId(keypoint_result.keyframe_index);
+
+  CHECK_LT(keypoint_result.keypoint_index, keyframe_result.num_landmarks);
+  structure_match.landmark_result = mapped_database_->getLandmarkId(
+      keyframe_result.first_landmark_index + keypoint_result.keypoint_index);
+  CHECK(structure_match.isValid());
+  return true;
+}
+
 void MatchingBasedLoopDetector::Insert(
     const loop_closure::ProjectedImage::Ptr& projected_image_ptr) {
   CHECK(projected_image_ptr != nullptr);
+  CHECK(mapped_database_ == nullptr) << kMappedDatabaseIsReadOnly;
   const loop_closure::ProjectedImage& projected_image = *projected_image_ptr;
 
+  CHECK_EQ(
+      projected_image.projected_descriptors.cols(),
+      static_cast<int>(projected_image.landmarks.size()));
+
   aslam::ScopedWriteLock lock(&read_write_mutex);
-  CHECK(projected_image.keyframe_id.isValid());
+  CHECK(index_interface_ != nullptr);
+  index_interface_->AddDescriptors(projected_image.projected_descriptors);
+  insertIntoDatabase(projected_image);
+}
+
+void MatchingBasedLoopDetector::FinishInsertions() {
+  aslam::ScopedWriteLock lock(&read_write_mutex);
+  CHECK(index_interface_ != nullptr);
+  index_interface_->FinishAddingDescriptors();
+}
+
+void MatchingBasedLoopDetector::InsertWithWordIndices(
+    const loop_closure::ProjectedImage::Ptr& projected_image_ptr,
+    const Eigen::VectorXi& word_indices) {
+  CHECK(projected_image_ptr != nullptr);
+  CHECK(mapped_database_ == nullptr) << kMappedDatabaseIsReadOnly;
+  const loop_closure::ProjectedImage& projected_image = *projected_image_ptr;
+  CHECK_EQ(
+      projected_image.projected_descriptors.cols(), word_indices.rows());
   CHECK_EQ(
       projected_image.projected_descriptors.cols(),
       static_cast<int>(projected_image.landmarks.size()));
-  for (int keypoint_idx = 0;
-       keypoint_idx < projected_image.projected_descriptors.cols();
-       ++keypoint_idx) {
+
+  std::shared_ptr<loop_closure::InvertedMultiIndexInterface>
+      inverted_multi_index_interface =
+          std::dynamic_pointer_cast<loop_closure::InvertedMultiIndexInterface>(
+              index_interface_);
+  CHECK(inverted_multi_index_interface)
+      << "Precomputed visual words are only supported by the inverted "
+      << "multi-index.";
+
+  aslam::ScopedWriteLock lock(&read_write_mutex);
+  inverted_multi_index_interface->AddDescriptors(
+      projected_image.projected_descriptors, word_indices);
+  insertIntoDatabase(projected_image);
+}
+
+bool MatchingBasedLoopDetector::ComputeWordIndices(
+    const Eigen::MatrixXf& projected_descriptors, Eigen::VectorXi* word_indices,
+    uint64_t* vocabulary_fingerprint) const {
+  CHECK_NOTNULL(word_indices);
+  CHECK_NOTNULL(vocabulary_fingerprint);
+  std::shared_ptr<loop_closure::InvertedMultiIndexInterface>
+      inverted_multi_index_interface =
+          std::dynamic_pointer_cast<loop_closure::InvertedMultiIndexInterface>(
+              index_interface_);
+  if (!inverted_multi_index_interface) {
+    return false;
+  }
+  *vocabulary_fingerprint =
+      inverted_multi_index_interface->GetVocabularyFingerprint();
+
+  // The vocabulary is immutable, so the word assignment can be computed in
+  // parallel without holding the database lock.
+  word_indices->resize(projected_descriptors.cols());
+  std::function<void(const std::vector<size_t>&)> assign_words =
+      [&](const std::vector<size_t>& range) {
+        for (const size_t descriptor_idx : range) {
+          (*word_indices)(descriptor_idx) =
+              inverted_multi_index_interface->GetWordIndex(
+                  projected_descriptors.col(descriptor_idx));
+        }
+      };
+  constexpr bool kAlwaysParallelize = false;
+  const size_t num_threads = common::getNumHardwareThreads();
+  common::ParallelProcess(
+      projected_descriptors.cols(), assign_words, kAlwaysParallelize,
+      num_threads);
+  return true;
+}
+
+bool MatchingBasedLoopDetector::GetVocabularyFingerprint(
+    uint64_t* vocabulary_fingerprint) const {
+  CHECK_NOTNULL(vocabulary_fingerprint);
+  std::shared_ptr<loop_closure::InvertedMultiIndexInterface>
+      inverted_multi_index_interface =
+          std::dynamic_pointer_cast<loop_closure::InvertedMultiIndexInterface>(
+              index_interface_);
+  if (!inverted_multi_index_interface) {
+    if (mapped_database_ != nullptr) {
+      *vocabulary_fingerprint =
+          mapped_database_->getHeader().vocabulary_fingerprint;
+      return true;
+    }
+    return false;
+  }
+  *vocabulary_fingerprint =
+      inverted_multi_index_interface->GetVocabularyFingerprint();
+  return true;
+}
+
+void MatchingBasedLoopDetector::InsertProductQuantized(
+    const loop_closure::ProjectedImage::Ptr& projected_image_ptr,
+    const Eigen::VectorXi& word_indices,
+    const loop_closure::ProductQuantizedDescriptorMatrix& quantized_residuals) {
+  CHECK(projected_image_ptr != nullptr);
+  CHECK(mapped_database_ == nullptr) << kMappedDatabaseIsReadOnly;
+  const loop_closure::ProjectedImage& projected_image = *projected_image_ptr;
+  CHECK_EQ(
+      static_cast<int>(projected_image.landmarks.size()), word_indices.rows());
+
+  std::shared_ptr<loop_closure::InvertedMultiProductQuantizationIndexInterface>
+      product_quantization_index_interface = std::dynamic_pointer_cast<
+          loop_closure::InvertedMultiProductQuantizationIndexInterface>(
+          index_interface_);
+  CHECK(product_quantization_index_interface)
+      << "Product quantized descriptors are only supported by the inverted "
+      << "multi-index with product quantization.";
+
+  aslam::ScopedWriteLock lock(&read_write_mutex);
+  product_quantization_index_interface->AddQuantizedDescriptors(
+      quantized_residuals, word_indices);
+  insertIntoDatabase(projected_image);
+}
+
+bool MatchingBasedLoopDetector::ProductQuantizeDescriptors(
+    const Eigen::MatrixXf& projected_descriptors, Eigen::VectorXi* word_indices,
+    loop_closure::ProductQuantizedDescriptorMatrix* quantized_residuals,
+    loop_closure::ProductQuantizationCodebook* codebook) const {
+  CHECK_NOTNULL(word_indices);
+  CHECK_NOTNULL(quantized_residuals);
+  CHECK_NOTNULL(codebook);
+  typedef loop_closure::InvertedMultiProductQuantizationIndexInterface
+      ProductQuantizationIndexInterface;
+  std::shared_ptr<ProductQuantizationIndexInterface>
+      product_quantization_index_interface =
+          std::dynamic_pointer_cast<ProductQuantizationIndexInterface>(
+              index_interface_);
+  if (!product_quantization_index_interface) {
+    return false;
+  }
+  product_quantization_index_interface->GetCodebook(codebook);
+
+  word_indices->resize(projected_descriptors.cols());
+  quantized_residuals->resize(
+      ProductQuantizationIndexInterface::kNumComponents,
+      projected_descriptors.cols());
+  std::function<void(const std::vector<size_t>&)> quantize_descriptors =
+      [&](const std::vector<size_t>& range) {
+        ProductQuantizationIndexInterface::Index::StoredDescriptorType
+            quantized_residual;
+        for (const size_t descriptor_idx : range) {
+          product_quantization_index_interface->QuantizeDescriptor(
+              projected_descriptors.col(descriptor_idx),
+              &(*word_indices)(descriptor_idx), &quantized_residual);
+          quantized_residuals->col(descriptor_idx) = quantized_residual;
+        }
+      };
+  constexpr bool kAlwaysParallelize = false;
+  const size_t num_threads = common::getNumHardwareThreads();
+  common::ParallelProcess(
+      projected_descriptors.cols(), quantize_descriptors, kAlwaysParallelize,
+      num_threads);
+  return true;
+}
+
+bool MatchingBasedLoopDetector::GetProductQuantizationFingerprint(
+    uint64_t* vocabulary_fingerprint) const {
+  CHECK_NOTNULL(vocabulary_fingerprint);
+  std::shared_ptr<loop_closure::InvertedMultiProductQuantizationIndexInterface>
+      product_quantization_index_interface = std::dynamic_pointer_cast<
+          loop_closure::InvertedMultiProductQuantizationIndexInterface>(
+          index_interface_);
+  if (!product_quantization_index_interface) {
+    return false;
+  }
+  *vocabulary_fingerprint =
+      product_quantization_index_interface->GetVocabularyFingerprint();
+  return true;
+}
+
+bool MatchingBasedLoopDetector::SearchesProjectedDescriptors() const {
+  CHECK(index_interface_ != nullptr);
+  return index_interface_->SearchesProjectedDescriptors();
+}
+
+void MatchingBasedLoopDetector::insertIntoDatabase(
+    const loop_closure::ProjectedImage& projected_image) {
+  CHECK(projected_image.keyframe_id.isValid());
+  const int num_descriptors =
+      static_cast<int>(projected_image.landmarks.size());
+  for (int keypoint_idx = 0; keypoint_idx < num_descriptors; ++keypoint_idx) {
     CHECK(
         descriptor_index_to_keypoint_id_
             .emplace(
@@ -240,15 +592,11 @@ void MatchingBasedLoopDetector::Insert(
             .second);
     ++descriptor_index_;
   }
-  CHECK(index_interface_ != nullptr);
-  index_interface_->AddDescriptors(projected_image.projected_descriptors);
 
   const loop_closure::KeyframeId& frame_id = projected_image.keyframe_id;
   CHECK(frame_id.isValid());
-  CHECK(
-      keyframe_id_to_num_descriptors_
-          .emplace(frame_id, projected_image.projected_descriptors.cols())
-          .second);
+  CHECK(keyframe_id_to_num_descriptors_.emplace(frame_id, num_descriptors)
+            .second);
   // Remove the descriptors before adding the projected image to the database.
   std::shared_ptr<loop_closure::ProjectedImage> projected_copy(
       new loop_closure::ProjectedImage(projected_image));
@@ -261,10 +609,227 @@ void MatchingBasedLoopDetector::Clear() {
   aslam::ScopedWriteLock lock(&read_write_mutex);
   database_.clear();
   descriptor_index_to_keypoint_id_.clear();
-  index_interface_->Clear();
+  keyframe_id_to_num_descriptors_.clear();
+  if (mapped_database_ != nullptr) {
+    // Detaches from the mapped database and starts over with an empty index.
+    mapped_database_.reset();
+    setDetectorEngine();
+  } else {
+    index_interface_->Clear();
+  }
   descriptor_index_ = 0;
 }
 
+bool MatchingBasedLoopDetector::publishMappedDatabase(
+    const common::MappedMemory::Type type, const std::string& name,
+    const std::vector<loop_closure::DatasetId>& dataset_ids,
+    const aslam::HashId& source_id) {
+  aslam::ScopedWriteLock lock(&read_write_mutex);
+  CHECK(mapped_database_ == nullptr)
+      << "The loop detector is attached to a mapped database already.";
+  std::shared_ptr<const loop_closure::InvertedMultiIndexInterface>
+      inverted_multi_index_interface = std::dynamic_pointer_cast<
+          const loop_closure::InvertedMultiIndexInterface>(index_interface_);
+  CHECK(inverted_multi_index_interface)
+      << "Only the inverted multi-index can be mapped.";
+
+  MappedDatabase::Header header;
+  memset(&header, 0, sizeof(header));
+  header.version = MappedDatabase::kVersion;
+  header.descriptor_dimensions =
+      2u * loop_closure::InvertedMultiIndexInterface::kSubSpaceDimensionality;
+  header.vocabulary_fingerprint =
+      inverted_multi_index_interface->GetVocabularyFingerprint();
+  if (source_id.isValid()) {
+    source_id.toUint64(header.source_id);
+  }
+  header.num_words = inverted_multi_index_interface->GetNumWords();
+  header.num_descriptors = descriptor_index_to_keypoint_id_.size();
+  header.num_keyframes = database_.size();
+  header.num_dataset_ids = dataset_ids.size();
+  for (const Database::value_type& keyframe_id_image : database_) {
+    header.num_landmarks += keyframe_id_image.second->landmarks.size();
+  }
+  MappedDatabase::computeLayout(&header);
+
+  // Whatever is left under the name is replaced, e.g. the previously
+  // published database or the one of a crashed publisher. Attached processes
+  // keep their mapping of it.
+  if (published_memory_ != nullptr) {
+    published_memory_->removeCreatedName();
+    published_memory_.reset();
+  }
+  common::MappedMemory::remove(type, name);
+  std::unique_ptr<common::MappedMemory> memory =
+      common::MappedMemory::create(type, name, header.size_bytes);
+  if (memory == nullptr) {
+    return false;
+  }
+  uint8_t* data = memory->mutableData();
+
+  std::unordered_map<loop_closure::KeyframeId, uint32_t> keyframe_id_to_index;
+  keyframe_id_to_index.reserve(database_.size());
+  MappedDatabase::Keyframe* keyframes =
+      MappedDatabase::getSection<MappedDatabase::Keyframe>(
+          data, header.keyframes_offset);
+  uint64_t* landmark_ids =
+      MappedDatabase::getSection<uint64_t>(data, header.landmark_ids_offset);
+  uint64_t landmark_index = 0u;
+  for (const Database::value_type& keyframe_id_image : database_) {
+    const loop_closure::ProjectedImage& projected_image =
+        *keyframe_id_image.second;
+    const uint32_t keyframe_index = keyframe_id_to_index.size();
+    keyframe_id_to_index.emplace(keyframe_id_image.first, keyframe_index);
+
+    MappedDatabase::Keyframe& keyframe = keyframes[keyframe_index];
+    MappedDatabase::idToUint64(
+        projected_image.keyframe_id.vertex_id, keyframe.vertex_id);
+    MappedDatabase::idToUint64(projected_image.dataset_id, keyframe.dataset_id);
+    keyframe.timestamp_nanoseconds = projected_image.timestamp_nanoseconds;
+    keyframe.first_landmark_index = landmark_index;
+    keyframe.frame_index = projected_image.keyframe_id.frame_index;
+    keyframe.num_landmarks = projected_image.landmarks.size();
+    for (const loop_closure::PointLandmarkId& landmark_id :
+         projected_image.landmarks) {
+      MappedDatabase::idToUint64(
+          landmark_id, landmark_ids + 2u * landmark_index);
+      ++landmark_index;
+    }
+  }
+  CHECK_EQ(landmark_index, header.num_landmarks);
+
+  // The descriptors are renumbered in the order of their words, such that the
+  // descriptors of every word form one contiguous range.
+  uint32_t* word_offsets =
+      MappedDatabase::getSection<uint32_t>(data, header.word_offsets_offset);
+  float* descriptors =
+      MappedDatabase::getSection<float>(data, header.descriptors_offset);
+  MappedDatabase::Keypoint* keypoints =
+      MappedDatabase::getSection<MappedDatabase::Keypoint>(
+          data, header.keypoints_offset);
+  inverted_multi_index_interface->ForEachInvertedFile(
+      [&](int word_index,
+          const loop_closure::InvertedMultiIndexInterface::Index::InvFile&
+              inverted_file) {
+        CHECK_LT(static_cast<uint32_t>(word_index), header.num_words);
+        word_offsets[word_index + 1] = inverted_file.indices_.size();
+      });
+  for (uint32_t word_index = 0u; word_index < header.num_words;
+       ++word_index) {
+    word_offsets[word_index + 1] += word_offsets[word_index];
+  }
+  CHECK_EQ(word_offsets[header.num_words], header.num_descriptors);
+  inverted_multi_index_interface->ForEachInvertedFile(
+      [&](int word_index,
+          const loop_closure::InvertedMultiIndexInterface::Index::InvFile&
+              inverted_file) {
+        uint32_t descriptor_index = word_offsets[word_index];
+        for (size_t i = 0u; i < inverted_file.indices_.size(); ++i) {
+          memcpy(
+              descriptors +
+                  static_cast<size_t>(descriptor_index) *
+                      header.descriptor_dimensions,
+              inverted_file.descriptors_[i].data(),
+              header.descriptor_dimensions * sizeof(float));
+          const loop_closure::KeypointId& keypoint_id =
+              descriptor_index_to_keypoint_id_.at(inverted_file.indices_[i]);
+          keypoints[descriptor_index].keyframe_index =
+              keyframe_id_to_index.at(keypoint_id.frame_id);
+          keypoints[descriptor_index].keypoint_index =
+              keypoint_id.keypoint_index;
+          ++descriptor_index;
+        }
+      });
+
+  uint64_t* mapped_dataset_ids =
+      MappedDatabase::getSection<uint64_t>(data, header.dataset_ids_offset);
+  for (size_t i = 0u; i < dataset_ids.size(); ++i) {
+    MappedDatabase::idToUint64(dataset_ids[i], mapped_dataset_ids + 2u * i);
+  }
+
+  // The magic is written last, attaching processes ignore the database until
+  // all sections are visible.
+  memcpy(data, &header, sizeof(header));
+  std::atomic_thread_fence(std::memory_order_release);
+  reinterpret_cast<MappedDatabase::Header*>(data)->magic =
+      MappedDatabase::kMagic;
+  memory->seal();
+  published_memory_ = std::move(memory);
+  return true;
+}
+
+bool MatchingBasedLoopDetector::attachMappedDatabase(
+    const common::MappedMemory::Type type, const std::string& name,
+    const aslam::HashId& source_id,
+    std::vector<loop_closure::DatasetId>* dataset_ids) {
+  CHECK_NOTNULL(dataset_ids);
+  MappedDatabase::ConstPtr mapped_database = MappedDatabase::attach(type, name);
+  if (mapped_database == nullptr) {
+    return false;
+  }
+
+  aslam::ScopedWriteLock lock(&read_write_mutex);
+  CHECK(mapped_database_ == nullptr)
+      << "The loop detector is attached to a mapped database already, clear "
+      << "it first.";
+  CHECK(database_.empty())
+      << "Only an empty loop detector can be attached to a mapped database.";
+  std::shared_ptr<loop_closure::InvertedMultiIndexInterface>
+      inverted_multi_index_interface =
+          std::dynamic_pointer_cast<loop_closure::InvertedMultiIndexInterface>(
+              index_interface_);
+  if (!inverted_multi_index_interface) {
+    LOG(ERROR) << "Only the inverted multi-index backend can be attached to "
+               << name << '.';
+    return false;
+  }
+  constexpr uint32_t kMappedDescriptorDimensionality =
+      loop_closure::MappedInvertedMultiIndexInterface::
+          kDescriptorDimensionality;
+  const MappedDatabase::Header& header = mapped_database->getHeader();
+  const uint32_t num_words = inverted_multi_index_interface->GetNumWords();
+  if (header.vocabulary_fingerprint !=
+          inverted_multi_index_interface->GetVocabularyFingerprint() ||
+      header.num_words != num_words ||
+      header.descriptor_dimensions != kMappedDescriptorDimensionality) {
+    LOG(ERROR) << name << " has been published with a different vocabulary.";
+    return false;
+  }
+  if (source_id.isValid() && mapped_database->getSourceId() != source_id) {
+    LOG(ERROR) << name << " has been built from "
+               << mapped_database->getSourceId().hexString() << " instead of "
+               << source_id.hexString() << '.';
+    return false;
+  }
+
+  // The scoring only needs the number of descriptors per keyframe, everything
+  // else is looked up in the mapped database.
+  KeyframeIdToNumDescriptorsMap keyframe_id_to_num_descriptors;
+  keyframe_id_to_num_descriptors.reserve(mapped_database->getNumKeyframes());
+  for (int keyframe_index = 0;
+       keyframe_index < mapped_database->getNumKeyframes(); ++keyframe_index) {
+    if (!keyframe_id_to_num_descriptors
+             .emplace(
+                 mapped_database->getKeyframeId(keyframe_index),
+                 mapped_database->getKeyframe(keyframe_index).num_landmarks)
+             .second) {
+      LOG(ERROR) << name << " contains keyframe " << keyframe_index
+                 << " more than once.";
+      return false;
+    }
+  }
+  keyframe_id_to_num_descriptors_.swap(keyframe_id_to_num_descriptors);
+  descriptor_index_to_keypoint_id_.clear();
+  descriptor_index_ = mapped_database->getNumDescriptors();
+  inverted_multi_index_interface->Clear();
+  index_interface_.reset(
+      new loop_closure::MappedInvertedMultiIndexInterface(
+          inverted_multi_index_interface, mapped_database));
+  mapped_database_ = mapped_database;
+  mapped_database_->getDatasetIds(dataset_ids);
+  return true;
+}
+
 void MatchingBasedLoopDetector::setKeyframeScoringFunction() {
   typedef MatchingBasedEngineSettings::KeyframeScoringFunctionType
       ScoringFunctionType;
@@ -320,6 +885,14 @@ void MatchingBasedLoopDetector::setDetectorEngine() {
               settings_.num_closest_words_for_nn_search));
       break;
     }
+    case DetectorEngineType::kMatchingLDHamming: {
+      index_interface_.reset(
+          new loop_closure::HammingIndexInterface(
+              settings_.descriptor_size_bits,
+              settings_.hamming_max_substring_radius,
+              settings_.hamming_max_distance));
+      break;
+    }
     default: {
       LOG(FATAL) << "Invalid selection ("
                  << settings_.detector_engine_type_string
@@ -329,12 +902,12 @@ void MatchingBasedLoopDetector::setDetectorEngine() {
   }
 }
 
-int MatchingBasedLoopDetector::getNumNeighborsToSearch() const {
+int MatchingBasedLoopDetector::getNumNeighborsToSearch(
+    const int num_descriptors_in_db) const {
   // Determine the best number of neighbors for a given database size.
 
   int num_neighbors_to_search = settings_.num_nearest_neighbors;
   if (num_neighbors_to_search == -1) {
-    int num_descriptors_in_db = index_interface_->GetNumDescriptorsInIndex();
     if (num_descriptors_in_db < 1e4) {
       num_neighbors_to_search = 1;
     } else if (num_descriptors_in_db < 1e5) {
@@ -359,6 +932,8 @@ void MatchingBasedLoopDetector::serialize(
       settings_.detector_engine_type_string,
       kMatchingLDInvertedMultiIndexString)
       << "Only the inverted multi-index can be serialized at the moment.";
+  CHECK(mapped_database_ == nullptr)
+      << "A mapped database can't be serialized.";
 
   for (const DescriptorIndexToKeypointIdMap::value_type&
            descriptor_index_keypoint_pair : descriptor_index_to_keypoint_id_) {
@@ -12,7 +12,7 @@
 #include <glog/logging.h>
 #include <loopclosure-common/types.h>
 #include <vi-map/vi-map.h>
-#include <vocabulary-tree/tree-builder.h>
+#include <vocabulary-tree/parallel-kmeans.h>
 
 #include "matching-based-loopclosure/detector-settings.h"
 #include "matching-based-loopclosure/inverted-index-interface.h"
@@ -33,6 +33,20 @@ DEFINE_int32(
 DEFINE_int32(
     lc_product_quantization_num_words, 256,
     "Number of words in the product vocabulary.");
+DEFINE_int32(
+    lc_kmeans_max_iterations, 100,
+    "Maximum number of k-means iterations for training a vocabulary.");
+DEFINE_int32(
+    lc_kmeans_mini_batch_size, 0,
+    "If non-zero, the vocabularies are trained with mini-batch k-means on "
+    "random batches of this many descriptors.");
+DEFINE_double(
+    lc_kmeans_center_movement_tolerance, 1e-4,
+    "K-means stops once no center moves further than this in an iteration.");
+DEFINE_string(
+    lc_training_descriptor_dump_filename, "",
+    "If set, the projected training descriptors are written to this file, e.g. "
+    "to benchmark the vocabulary training on them.");
 
 DECLARE_string(load_map);
 
@@ -41,34 +55,58 @@ using descriptor_projection::FeatureAllocator;
 using descriptor_projection::ProjectedDescriptorType;
 
 namespace loop_closure {
-typedef loop_closure::TreeBuilder<
-    ProjectedDescriptorType,
-    loop_closure::distance::L2<ProjectedDescriptorType>, FeatureAllocator>
-    ProjectedTreeBuilder;
+namespace {
+ParallelKmeansSettings GetKmeansSettings() {
+  CHECK_GT(FLAGS_lc_kmeans_max_iterations, 0);
+  CHECK_GE(FLAGS_lc_kmeans_mini_batch_size, 0);
+  ParallelKmeansSettings settings;
+  settings.max_iterations = FLAGS_lc_kmeans_max_iterations;
+  settings.mini_batch_size = FLAGS_lc_kmeans_mini_batch_size;
+  settings.center_movement_tolerance =
+      FLAGS_lc_kmeans_center_movement_tolerance;
+  return settings;
+}
+
+void DescriptorVectorToMatrix(
+    const DescriptorVector& descriptors, int descriptor_dimensionality,
+    Eigen::MatrixXf* descriptor_matrix) {
+  CHECK_NOTNULL(descriptor_matrix);
+  descriptor_matrix->resize(descriptor_dimensionality, descriptors.size());
+  for (size_t i = 0; i < descriptors.size(); ++i) {
+    CHECK_EQ(descriptors[i].rows(), descriptor_dimensionality);
+    descriptor_matrix->col(i) = descriptors[i];
+  }
+}
+}  // namespace
 
 void MakeVocabulary(
     int num_words, const DescriptorVector& descriptors,
     int descriptor_dimensionality, Eigen::MatrixXf* words) {
   CHECK_NOTNULL(words);
   CHECK(!descriptors.empty());
-
-  ProjectedDescriptorType descriptor_zero;
-  descriptor_zero.setConstant(descriptor_dimensionality, 1, 0);
-
-  // Create tree.
-  static constexpr int kLevels = 1;
-  ProjectedTreeBuilder builder(descriptor_zero);
-  builder.kmeans().SetRestarts(1);
-  builder.Build(descriptors, num_words, kLevels);
-  VLOG(3) << "Done. Got " << builder.tree().centers().size() << " centers";
-
-  const descriptor_projection::DescriptorVector& centers =
-      builder.tree().centers();
-  words->resize(descriptor_dimensionality, centers.size());
-  for (size_t i = 0; i < centers.size(); ++i) {
-    CHECK_EQ(centers[i].rows(), descriptor_dimensionality);
-    words->block(0, i, descriptor_dimensionality, 1) = centers[i];
+  CHECK_GT(num_words, 0);
+
+  Eigen::MatrixXf descriptor_matrix;
+  DescriptorVectorToMatrix(
+      descriptors, descriptor_dimensionality, &descriptor_matrix);
+
+  // With no more descriptors than words, the descriptors are the words and
+  // the remaining words are zero.
+  if (descriptor_matrix.cols() <= num_words) {
+    LOG(WARNING) << "Only " << descriptor_matrix.cols()
+                 << " descriptors to train a vocabulary of " << num_words
+                 << " words. The descriptors are used as words and the "
+                 << "remaining " << num_words - descriptor_matrix.cols()
+                 << " words are zero.";
+    words->setZero(descriptor_dimensionality, num_words);
+    words->leftCols(descriptor_matrix.cols()) = descriptor_matrix;
+    return;
   }
+
+  const ParallelKmeans kmeans(GetKmeansSettings());
+  std::vector<unsigned int> membership;
+  kmeans.Cluster(descriptor_matrix, num_words, words, &membership);
+  VLOG(3) << "Done. Got " << words->cols() << " centers";
 }
 
 void LoadBinaryFeaturesFromDataset(
@@ -155,19 +193,14 @@ void MakeProductVocabularies(
   Aligned<std::vector, DescriptorVector> descriptors_v1;
   descriptors_v1.resize(base_vocabulary.cols());
 
-  for (const ProjectedDescriptorType& projected_descriptor :
-       input_descriptors) {
-    int best_word = 0;
-    float best_distance = std::numeric_limits<float>::max();
-    for (int i = 0; i < base_vocabulary.cols(); ++i) {
-      float distance =
-          (base_vocabulary.col(i) - projected_descriptor).squaredNorm();
-      if (distance < best_distance) {
-        best_distance = distance;
-        best_word = i;
-      }
-    }
-    descriptors_v1[best_word].push_back(projected_descriptor);
+  Eigen::MatrixXf descriptor_matrix;
+  DescriptorVectorToMatrix(
+      input_descriptors, base_vocabulary.rows(), &descriptor_matrix);
+  std::vector<unsigned int> best_words;
+  ParallelKmeans(GetKmeansSettings())
+      .Assign(descriptor_matrix, base_vocabulary, &best_words, nullptr);
+  for (size_t i = 0; i < input_descriptors.size(); ++i) {
+    descriptors_v1[best_words[i]].push_back(input_descriptors[i]);
   }
 
   const int kHalfDescriptorLength = FLAGS_lc_target_dimensionality / 2;
@@ -383,6 +416,19 @@ void TrainProjectedVocabulary(const vi_map::VIMap& map) {
   ProjectDescriptors(
       projection_matrix, raw_descriptors, &projected_descriptors);
 
+  if (!FLAGS_lc_training_descriptor_dump_filename.empty()) {
+    Eigen::MatrixXf descriptor_matrix;
+    DescriptorVectorToMatrix(
+        projected_descriptors, FLAGS_lc_target_dimensionality,
+        &descriptor_matrix);
+    std::ofstream out(
+        FLAGS_lc_training_descriptor_dump_filename.c_str(),
+        std::ios_base::binary);
+    CHECK(out.is_open()) << "Failed to write descriptors to "
+                         << FLAGS_lc_training_descriptor_dump_filename;
+    common::Serialize(descriptor_matrix, &out);
+  }
+
   MakeVocabularies(projection_matrix, projected_descriptors);
   std::cout << "Done." << std::endl;
 }
@@ -0,0 +1,280 @@
+#include <atomic>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <queue>
+#include <random>
+#include <set>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <loopclosure-common/types.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/unique-id.h>
+
+#include "matching-based-loopclosure/covisibility-filter.h"
+
+namespace {
+// Counts the heap allocations of the test.
+std::atomic<size_t> num_allocations(0u);
+}  // namespace
+
+void* operator new(size_t size) {
+  ++num_allocations;
+  void* memory = std::malloc(size);
+  if (memory == nullptr) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void operator delete(void* memory) noexcept {
+  std::free(memory);
+}
+
+void operator delete(void* memory, size_t /*size*/) noexcept {
+  std::free(memory);
+}
+
+namespace matching_based_loopclosure {
+
+struct MatchLess {
+  bool operator()(
+      const loop_closure::Match& lhs, const loop_closure::Match& rhs) const {
+    return internal::isMatchLess(lhs, rhs);
+  }
+};
+typedef std::set<loop_closure::Match, MatchLess> MatchSet;
+
+constexpr int kNumVertices = 5;
+constexpr int kNumFramesPerVertex = 4;
+constexpr int kNumLandmarks = 200;
+constexpr int kNumQueryKeypoints = 50;
+
+class CovisibilityFilterTest : public ::testing::Test {
+ protected:
+  CovisibilityFilterTest() : random_engine_(42u) {
+    for (int i = 0; i < kNumVertices + 1; ++i) {
+      pose_graph::VertexId vertex_id;
+      common::generateIdFromInt(i, &vertex_id);
+      vertex_ids_.push_back(vertex_id);
+    }
+    for (int i = 0; i < kNumLandmarks; ++i) {
+      vi_map::LandmarkId landmark_id;
+      common::generateIdFromInt(i, &landmark_id);
+      landmark_ids_.push_back(landmark_id);
+    }
+  }
+
+  // Random matches of query keypoints to landmarks seen by database
+  // keyframes, including some duplicates, and a random subset of relevant
+  // keyframes.
+  void generateRandomMatches(
+      loop_closure::FrameToMatches* frame_to_matches,
+      std::vector<unsigned char>* is_frame_relevant) {
+    frame_to_matches->clear();
+    std::uniform_int_distribution<int> num_matches_distribution(0, 12);
+    std::uniform_int_distribution<int> landmark_distribution(
+        0, kNumLandmarks - 1);
+    std::uniform_int_distribution<int> keypoint_distribution(
+        0, kNumQueryKeypoints - 1);
+    std::bernoulli_distribution duplicate_distribution(0.1);
+    for (int vertex_idx = 0; vertex_idx < kNumVertices; ++vertex_idx) {
+      for (int frame_idx = 0; frame_idx < kNumFramesPerVertex; ++frame_idx) {
+        const vi_map::VisualFrameIdentifier frame_id(
+            vertex_ids_[vertex_idx], frame_idx);
+        loop_closure::MatchVector& matches = (*frame_to_matches)[frame_id];
+        const int num_matches = num_matches_distribution(random_engine_);
+        for (int i = 0; i < num_matches; ++i) {
+          if (!matches.empty() && duplicate_distribution(random_engine_)) {
+            matches.push_back(matches.back());
+            continue;
+          }
+          loop_closure::Match match;
+          match.keypoint_id_query = vi_map::KeypointIdentifier(
+              vertex_ids_[kNumVertices], 0u,
+              keypoint_distribution(random_engine_));
+          match.keyframe_id_result = frame_id;
+          match.landmark_result =
+              landmark_ids_[landmark_distribution(random_engine_)];
+          matches.push_back(match);
+        }
+        if (matches.empty()) {
+          frame_to_matches->erase(frame_id);
+        }
+      }
+    }
+    std::bernoulli_distribution relevance_distribution(0.7);
+    is_frame_relevant->resize(frame_to_matches->size());
+    for (unsigned char& is_relevant : *is_frame_relevant) {
+      is_relevant = relevance_distribution(random_engine_) ? 1u : 0u;
+    }
+  }
+
+  // Breadth-first search over the relevant keyframes, which are connected if
+  // they share a landmark.
+  static size_t findLargestComponentReference(
+      const loop_closure::FrameToMatches& frame_to_matches,
+      const std::vector<unsigned char>& is_frame_relevant,
+      MatchSet* largest_component) {
+    std::unordered_set<loop_closure::KeyframeId> relevant_frames;
+    std::map<vi_map::LandmarkId, std::vector<loop_closure::KeyframeId>>
+        landmark_frames;
+    size_t frame_idx = 0u;
+    for (const loop_closure::FrameToMatches::value_type& frame_matches :
+         frame_to_matches) {
+      if (is_frame_relevant[frame_idx++] != 0u) {
+        relevant_frames.insert(frame_matches.first);
+        for (const loop_closure::Match& match : frame_matches.second) {
+          landmark_frames[match.landmark_result].push_back(frame_matches.first);
+        }
+      }
+    }
+
+    std::unordered_set<loop_closure::KeyframeId> visited_frames;
+    size_t max_component_size = 0u;
+    for (const loop_closure::FrameToMatches::value_type& frame_matches :
+         frame_to_matches) {
+      if (relevant_frames.count(frame_matches.first) == 0u ||
+          !visited_frames.insert(frame_matches.first).second) {
+        continue;
+      }
+      MatchSet component;
+      std::queue<loop_closure::KeyframeId> exploration_queue;
+      exploration_queue.push(frame_matches.first);
+      while (!exploration_queue.empty()) {
+        const loop_closure::KeyframeId frame_id = exploration_queue.front();
+        exploration_queue.pop();
+        for (const loop_closure::Match& match : frame_to_matches.at(frame_id)) {
+          component.insert(match);
+          for (const loop_closure::KeyframeId& covisible_frame_id :
+               landmark_frames[match.landmark_result]) {
+            if (visited_frames.insert(covisible_frame_id).second) {
+              exploration_queue.push(covisible_frame_id);
+            }
+          }
+        }
+      }
+      if (component.size() > max_component_size) {
+        max_component_size = component.size();
+        *largest_component = component;
+      }
+    }
+    return max_component_size;
+  }
+
+  std::mt19937 random_engine_;
+  std::vector<pose_graph::VertexId> vertex_ids_;
+  std::vector<vi_map::LandmarkId> landmark_ids_;
+};
+
+TEST_F(CovisibilityFilterTest, MatchesReferenceImplementation) {
+  constexpr int kNumTrials = 200;
+  // The buffers are shared by all trials, like in the loop detector.
+  CovisibilityFilterBuffers<loop_closure::KeyframeId> buffers;
+  loop_closure::FrameToMatches frame_to_matches;
+  for (int trial = 0; trial < kNumTrials; ++trial) {
+    generateRandomMatches(&frame_to_matches, &buffers.is_id_relevant);
+    MatchSet expected_component;
+    const size_t expected_component_size = findLargestComponentReference(
+        frame_to_matches, buffers.is_id_relevant, &expected_component);
+
+    constexpr bool kMakeMatchesUnique = false;
+    const size_t component_size = findLargestCovisibilityComponent(
+        frame_to_matches, kMakeMatchesUnique, &buffers);
+    ASSERT_EQ(component_size, expected_component_size);
+    ASSERT_EQ(buffers.component_matches.size(), component_size);
+    MatchSet component;
+    for (const loop_closure::Match* match : buffers.component_matches) {
+      component.insert(*match);
+    }
+    EXPECT_TRUE(component == expected_component);
+  }
+}
+
+TEST_F(CovisibilityFilterTest, MakesMatchesUnique) {
+  constexpr int kNumTrials = 200;
+  CovisibilityFilterBuffers<loop_closure::KeyframeId> buffers;
+  loop_closure::FrameToMatches frame_to_matches;
+  for (int trial = 0; trial < kNumTrials; ++trial) {
+    generateRandomMatches(&frame_to_matches, &buffers.is_id_relevant);
+    MatchSet expected_component;
+    const size_t expected_component_size = findLargestComponentReference(
+        frame_to_matches, buffers.is_id_relevant, &expected_component);
+    std::set<std::pair<size_t, vi_map::LandmarkId>> expected_unique_pairs;
+    for (const loop_closure::Match& match : expected_component) {
+      expected_unique_pairs.emplace(
+          match.keypoint_id_query.keypoint_index, match.landmark_result);
+    }
+
+    constexpr bool kMakeMatchesUnique = true;
+    const size_t component_size = findLargestCovisibilityComponent(
+        frame_to_matches, kMakeMatchesUnique, &buffers);
+    ASSERT_EQ(component_size, expected_component_size);
+    std::set<std::pair<size_t, vi_map::LandmarkId>> unique_pairs;
+    for (const loop_closure::Match* match : buffers.component_matches) {
+      EXPECT_EQ(expected_component.count(*match), 1u);
+      EXPECT_TRUE(
+          unique_pairs
+              .emplace(
+                  match->keypoint_id_query.keypoint_index,
+                  match->landmark_result)
+              .second);
+    }
+    EXPECT_TRUE(unique_pairs == expected_unique_pairs);
+  }
+}
+
+TEST_F(CovisibilityFilterTest, IgnoresIrrelevantIds) {
+  loop_closure::FrameToMatches frame_to_matches;
+  CovisibilityFilterBuffers<loop_closure::KeyframeId> buffers;
+  generateRandomMatches(&frame_to_matches, &buffers.is_id_relevant);
+  buffers.is_id_relevant.assign(frame_to_matches.size(), 0u);
+  constexpr bool kMakeMatchesUnique = false;
+  EXPECT_EQ(
+      findLargestCovisibilityComponent(
+          frame_to_matches, kMakeMatchesUnique, &buffers),
+      0u);
+  EXPECT_TRUE(buffers.component_matches.empty());
+}
+
+TEST_F(CovisibilityFilterTest, PooledBuffersDontAllocate) {
+  typedef CovisibilityFilterBufferPool<loop_closure::KeyframeId> BufferPool;
+  BufferPool buffer_pool;
+  loop_closure::FrameToMatches frame_to_matches;
+  constexpr bool kMakeMatchesUnique = false;
+  {
+    BufferPool::BuffersPtr buffers = buffer_pool.acquire();
+    generateRandomMatches(&frame_to_matches, &buffers->is_id_relevant);
+    findLargestCovisibilityComponent(
+        frame_to_matches, kMakeMatchesUnique, buffers.get());
+    buffer_pool.release(std::move(buffers));
+  }
+
+  // The next query gets the buffers of the previous one, which are large
+  // enough already.
+  const size_t num_allocations_before = num_allocations;
+  BufferPool::BuffersPtr buffers = buffer_pool.acquire();
+  const size_t component_size = findLargestCovisibilityComponent(
+      frame_to_matches, kMakeMatchesUnique, buffers.get());
+  const CovisibilityFilterBuffers<loop_closure::KeyframeId>* buffers_ptr =
+      buffers.get();
+  buffer_pool.release(std::move(buffers));
+  EXPECT_EQ(num_allocations - num_allocations_before, 0u);
+  EXPECT_GT(component_size, 0u);
+  EXPECT_EQ(buffer_pool.getNumCreatedBuffers(), 1u);
+
+  // Concurrent queries get their own buffers.
+  BufferPool::BuffersPtr first_buffers = buffer_pool.acquire();
+  BufferPool::BuffersPtr second_buffers = buffer_pool.acquire();
+  EXPECT_EQ(first_buffers.get(), buffers_ptr);
+  EXPECT_NE(second_buffers.get(), buffers_ptr);
+  EXPECT_EQ(buffer_pool.getNumCreatedBuffers(), 2u);
+  buffer_pool.release(std::move(first_buffers));
+  buffer_pool.release(std::move(second_buffers));
+}
+
+}  // namespace matching_based_loopclosure
+
+MAPLAB_UNITTEST_ENTRYPOINT
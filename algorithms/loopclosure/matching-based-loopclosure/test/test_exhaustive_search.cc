@@ -0,0 +1,120 @@
+#include <limits>
+#include <random>
+
+#include <Eigen/Core>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "matching-based-loopclosure/exhaustive-search.h"
+
+namespace loop_closure {
+namespace exhaustive_search {
+
+class ExhaustiveSearchTest : public ::testing::Test {
+ protected:
+  static constexpr int kDimensions = 10;
+
+  ExhaustiveSearchTest() : random_engine_(42u) {}
+
+  Eigen::MatrixXf randomDescriptors(const int num_descriptors) {
+    std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+    Eigen::MatrixXf descriptors(kDimensions, num_descriptors);
+    for (int i = 0; i < descriptors.size(); ++i) {
+      descriptors(i) = distribution(random_engine_);
+    }
+    return descriptors;
+  }
+
+  // Compares with a linear search that computes every distance on its own.
+  void expectSameAsLinearSearch(
+      const Eigen::MatrixXf& candidates, const Eigen::MatrixXf& queries,
+      const int num_neighbors, const float max_squared_distance,
+      const Eigen::MatrixXi& indices, const Eigen::MatrixXf& distances) {
+    ASSERT_EQ(num_neighbors, indices.rows());
+    ASSERT_EQ(queries.cols(), indices.cols());
+    for (int query_idx = 0; query_idx < queries.cols(); ++query_idx) {
+      Eigen::VectorXf squared_distances =
+          (candidates.colwise() - queries.col(query_idx))
+              .colwise()
+              .squaredNorm()
+              .transpose();
+      for (int neighbor_idx = 0; neighbor_idx < num_neighbors;
+           ++neighbor_idx) {
+        int expected_index;
+        const float expected_distance =
+            squared_distances.minCoeff(&expected_index);
+        if (expected_distance > max_squared_distance) {
+          EXPECT_EQ(-1, indices(neighbor_idx, query_idx));
+          EXPECT_EQ(
+              std::numeric_limits<float>::infinity(),
+              distances(neighbor_idx, query_idx));
+          continue;
+        }
+        EXPECT_EQ(expected_index, indices(neighbor_idx, query_idx));
+        EXPECT_NEAR(
+            expected_distance, distances(neighbor_idx, query_idx), 1e-4f);
+        squared_distances(expected_index) =
+            std::numeric_limits<float>::infinity();
+      }
+    }
+  }
+
+  std::mt19937 random_engine_;
+};
+
+TEST_F(ExhaustiveSearchTest, MatchesLinearSearchAcrossBlocks) {
+  // More candidates than fit into a single block.
+  const Eigen::MatrixXf candidates =
+      randomDescriptors(2 * kCandidateBlockSize + 17);
+  const Eigen::RowVectorXf candidate_squared_norms =
+      candidates.colwise().squaredNorm();
+  const Eigen::MatrixXf queries = randomDescriptors(50);
+
+  constexpr int kNumNeighbors = 3;
+  const float kUnlimitedDistance = std::numeric_limits<float>::max();
+  Eigen::MatrixXf distance_buffer;
+  Eigen::MatrixXi indices;
+  Eigen::MatrixXf distances;
+  GetNNearestNeighbors(
+      candidates, candidate_squared_norms, queries, kNumNeighbors,
+      kUnlimitedDistance, &distance_buffer, &indices, &distances);
+  expectSameAsLinearSearch(
+      candidates, queries, kNumNeighbors, kUnlimitedDistance, indices,
+      distances);
+  EXPECT_LE(distance_buffer.rows(), kCandidateBlockSize);
+}
+
+TEST_F(ExhaustiveSearchTest, RespectsMaxDistance) {
+  const Eigen::MatrixXf candidates = randomDescriptors(100);
+  const Eigen::RowVectorXf candidate_squared_norms =
+      candidates.colwise().squaredNorm();
+  const Eigen::MatrixXf queries = randomDescriptors(50);
+
+  // Only few candidates are within the distance, most neighbors are missing.
+  constexpr int kNumNeighbors = 5;
+  constexpr float kMaxSquaredDistance = 0.3f;
+  Eigen::MatrixXf distance_buffer;
+  Eigen::MatrixXi indices;
+  Eigen::MatrixXf distances;
+  GetNNearestNeighbors(
+      candidates, candidate_squared_norms, queries, kNumNeighbors,
+      kMaxSquaredDistance, &distance_buffer, &indices, &distances);
+  expectSameAsLinearSearch(
+      candidates, queries, kNumNeighbors, kMaxSquaredDistance, indices,
+      distances);
+  EXPECT_TRUE((indices.array() == -1).any());
+
+  // Candidates identical to the queries are found at distance zero.
+  GetNNearestNeighbors(
+      candidates, candidate_squared_norms, candidates.leftCols(10),
+      kNumNeighbors, kMaxSquaredDistance, &distance_buffer, &indices,
+      &distances);
+  for (int query_idx = 0; query_idx < 10; ++query_idx) {
+    EXPECT_EQ(query_idx, indices(0, query_idx));
+    EXPECT_NEAR(0.0f, distances(0, query_idx), 1e-4f);
+  }
+}
+
+}  // namespace exhaustive_search
+}  // namespace loop_closure
+
+MAPLAB_UNITTEST_ENTRYPOINT
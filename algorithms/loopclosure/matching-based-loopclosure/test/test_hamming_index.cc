@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <vocabulary-tree/hamming.h>
+
+#include "matching-based-loopclosure/hamming-index-interface.h"
+#include "matching-based-loopclosure/hamming-index.h"
+
+namespace loop_closure {
+namespace hamming_index {
+
+constexpr int kBriskBits = 384;
+constexpr int kFreakBits = 512;
+
+class HammingIndexTest : public ::testing::Test {
+ protected:
+  typedef HammingIndex::DescriptorMatrixType DescriptorMatrixType;
+
+  HammingIndexTest() : random_engine_(42u) {}
+
+  DescriptorMatrixType randomDescriptors(
+      const int num_bits, const int num_descriptors) {
+    std::uniform_int_distribution<int> distribution(0, 255);
+    DescriptorMatrixType descriptors(num_bits / 8, num_descriptors);
+    for (int i = 0; i < descriptors.size(); ++i) {
+      descriptors(i) = static_cast<unsigned char>(distribution(random_engine_));
+    }
+    return descriptors;
+  }
+
+  // Copies of the given descriptors with num_flipped_bits distinct bits
+  // flipped.
+  DescriptorMatrixType flipBits(
+      const DescriptorMatrixType& descriptors, const int num_flipped_bits) {
+    const int num_bits = descriptors.rows() * 8;
+    std::vector<int> bits(num_bits);
+    for (int bit = 0; bit < num_bits; ++bit) {
+      bits[bit] = bit;
+    }
+    DescriptorMatrixType flipped_descriptors = descriptors;
+    for (int col = 0; col < descriptors.cols(); ++col) {
+      std::shuffle(bits.begin(), bits.end(), random_engine_);
+      for (int i = 0; i < num_flipped_bits; ++i) {
+        flipped_descriptors(bits[i] / 8, col) ^= 1u << (bits[i] % 8);
+      }
+    }
+    return flipped_descriptors;
+  }
+
+  static void bruteForceNearestNeighbors(
+      const DescriptorMatrixType& database, const DescriptorMatrixType& queries,
+      const int num_neighbors, const int max_distance, Eigen::MatrixXi* indices,
+      Eigen::MatrixXf* distances) {
+    const int num_bits = database.rows() * 8;
+    indices->setConstant(num_neighbors, queries.cols(), -1);
+    distances->setConstant(
+        num_neighbors, queries.cols(), std::numeric_limits<float>::infinity());
+    std::vector<std::pair<int, int>> candidates;
+    for (int query_idx = 0; query_idx < queries.cols(); ++query_idx) {
+      candidates.clear();
+      for (int i = 0; i < database.cols(); ++i) {
+        const int distance = HammingDistance(
+            database.col(i).data(), queries.col(query_idx).data(), num_bits);
+        if (distance <= max_distance) {
+          candidates.emplace_back(distance, i);
+        }
+      }
+      const int num_results = std::min<int>(num_neighbors, candidates.size());
+      std::partial_sort(
+          candidates.begin(), candidates.begin() + num_results,
+          candidates.end());
+      for (int i = 0; i < num_results; ++i) {
+        (*distances)(i, query_idx) = candidates[i].first;
+        (*indices)(i, query_idx) = candidates[i].second;
+      }
+    }
+  }
+
+  // The index must return the same neighbor distances as a linear search as
+  // long as all neighbors are closer than the exact search bound.
+  void expectSameAsBruteForce(const int num_bits) {
+    constexpr int kNumDescriptors = 5000;
+    constexpr int kNumNearDuplicates = 50;
+    constexpr int kNumQueries = 200;
+    constexpr int kNumNeighbors = 3;
+    constexpr int kMaxSubstringRadius = 2;
+    const int num_substrings = num_bits / HammingIndex::kSubstringBits;
+    const int max_distance = num_substrings * (kMaxSubstringRadius + 1) - 1;
+
+    // Some descriptors have near duplicates in a second batch, so that
+    // queries have several close neighbors.
+    DescriptorMatrixType database(
+        num_bits / 8, kNumDescriptors + kNumNearDuplicates);
+    database.leftCols(kNumDescriptors) =
+        randomDescriptors(num_bits, kNumDescriptors);
+    database.rightCols(kNumNearDuplicates) =
+        flipBits(database.leftCols(kNumNearDuplicates), 5);
+    HammingIndex index(num_bits, kMaxSubstringRadius, max_distance);
+    index.AddDescriptors(database.leftCols(kNumDescriptors));
+    index.AddDescriptors(database.rightCols(kNumNearDuplicates));
+    ASSERT_EQ(index.GetNumDescriptorsInIndex(), database.cols());
+
+    // Half of the queries have close neighbors, the others have none.
+    DescriptorMatrixType queries(num_bits / 8, kNumQueries);
+    queries.leftCols(kNumQueries / 2) =
+        flipBits(database.leftCols(kNumQueries / 2), num_substrings);
+    queries.rightCols(kNumQueries / 2) =
+        randomDescriptors(num_bits, kNumQueries / 2);
+
+    Eigen::MatrixXi indices(kNumNeighbors, kNumQueries);
+    Eigen::MatrixXf distances(kNumNeighbors, kNumQueries);
+    index.GetNNearestNeighbors(queries, kNumNeighbors, &indices, &distances);
+    Eigen::MatrixXi expected_indices;
+    Eigen::MatrixXf expected_distances;
+    bruteForceNearestNeighbors(
+        database, queries, kNumNeighbors, max_distance, &expected_indices,
+        &expected_distances);
+
+    EXPECT_TRUE(distances == expected_distances);
+    for (int query_idx = 0; query_idx < kNumQueries; ++query_idx) {
+      if (query_idx < kNumQueries / 2) {
+        EXPECT_GE(indices(0, query_idx), 0);
+      } else {
+        EXPECT_EQ(indices(0, query_idx), -1);
+      }
+      for (int i = 0; i < kNumNeighbors; ++i) {
+        const int descriptor_idx = indices(i, query_idx);
+        EXPECT_EQ(descriptor_idx < 0, expected_indices(i, query_idx) < 0);
+        if (descriptor_idx >= 0) {
+          EXPECT_EQ(
+              HammingDistance(
+                  database.col(descriptor_idx).data(),
+                  queries.col(query_idx).data(), num_bits),
+              distances(i, query_idx));
+        }
+      }
+    }
+  }
+
+  std::mt19937 random_engine_;
+};
+
+TEST_F(HammingIndexTest, BriskMatchesBruteForce) {
+  expectSameAsBruteForce(kBriskBits);
+}
+
+TEST_F(HammingIndexTest, FreakMatchesBruteForce) {
+  expectSameAsBruteForce(kFreakBits);
+}
+
+TEST_F(HammingIndexTest, ClearRemovesAllDescriptors) {
+  HammingIndex index(kBriskBits, 2, 70);
+  const DescriptorMatrixType descriptors = randomDescriptors(kBriskBits, 100);
+  index.AddDescriptors(descriptors);
+  index.Clear();
+  EXPECT_EQ(index.GetNumDescriptorsInIndex(), 0);
+
+  Eigen::MatrixXi indices(1, descriptors.cols());
+  Eigen::MatrixXf distances(1, descriptors.cols());
+  index.GetNNearestNeighbors(descriptors, 1, &indices, &distances);
+  EXPECT_TRUE((indices.array() == -1).all());
+
+  index.AddDescriptors(descriptors.rightCols(1));
+  index.GetNNearestNeighbors(descriptors, 1, &indices, &distances);
+  EXPECT_EQ(indices(0, descriptors.cols() - 1), 0);
+  EXPECT_EQ(distances(0, descriptors.cols() - 1), 0.0f);
+}
+
+TEST_F(HammingIndexTest, InterfaceKeepsDescriptorsPacked) {
+  HammingIndexInterface index_interface(kBriskBits, 1, 70);
+  EXPECT_FALSE(index_interface.SearchesProjectedDescriptors());
+  const DescriptorMatrixType descriptors = randomDescriptors(kBriskBits, 100);
+
+  // The projected descriptors hold the descriptor bytes without expansion.
+  Eigen::MatrixXf packed_descriptors;
+  index_interface.ProjectDescriptors(descriptors, &packed_descriptors);
+  ASSERT_EQ(
+      packed_descriptors.size() * sizeof(float),
+      static_cast<size_t>(descriptors.size()));
+  EXPECT_EQ(packed_descriptors.cols(), descriptors.cols());
+  EXPECT_EQ(
+      memcmp(
+          packed_descriptors.data(), descriptors.data(), descriptors.size()),
+      0);
+
+  index_interface.AddDescriptors(packed_descriptors);
+  EXPECT_EQ(index_interface.GetNumDescriptorsInIndex(), descriptors.cols());
+  Eigen::MatrixXi indices(1, descriptors.cols());
+  Eigen::MatrixXf distances(1, descriptors.cols());
+  index_interface.GetNNearestNeighborsForFeatures(
+      packed_descriptors, 1, &indices, &distances);
+  for (int i = 0; i < descriptors.cols(); ++i) {
+    EXPECT_EQ(indices(0, i), i);
+    EXPECT_EQ(distances(0, i), 0.0f);
+  }
+}
+
+}  // namespace hamming_index
+}  // namespace loop_closure
+
+MAPLAB_UNITTEST_ENTRYPOINT
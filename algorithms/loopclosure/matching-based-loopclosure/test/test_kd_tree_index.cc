@@ -0,0 +1,194 @@
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <Eigen/Core>
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "matching-based-loopclosure/kd-tree-index.h"
+
+namespace loop_closure {
+namespace kd_tree_index {
+
+class KDTreeIndexTest : public ::testing::Test {
+ protected:
+  static constexpr int kDimensions = 10;
+  typedef KDTreeIndex<kDimensions> Index;
+
+  KDTreeIndexTest() : random_engine_(42u) {}
+
+  Index::DescriptorMatrixType randomDescriptors(const int num_descriptors) {
+    std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+    Index::DescriptorMatrixType descriptors(kDimensions, num_descriptors);
+    for (int col = 0; col < num_descriptors; ++col) {
+      for (int row = 0; row < kDimensions; ++row) {
+        descriptors(row, col) = distribution(random_engine_);
+      }
+    }
+    return descriptors;
+  }
+
+  // Adds blocks of random size and returns all added descriptors.
+  Eigen::MatrixXf addRandomBlocks(const int num_blocks) {
+    std::uniform_int_distribution<int> block_size_distribution(1, 200);
+    Eigen::MatrixXf all_descriptors(kDimensions, 0);
+    for (int block_idx = 0; block_idx < num_blocks; ++block_idx) {
+      const Index::DescriptorMatrixType descriptors =
+          randomDescriptors(block_size_distribution(random_engine_));
+      index_.AddDescriptors(descriptors);
+      all_descriptors.conservativeResize(
+          Eigen::NoChange, all_descriptors.cols() + descriptors.cols());
+      all_descriptors.rightCols(descriptors.cols()) = descriptors;
+    }
+    return all_descriptors;
+  }
+
+  // Every descriptor of the index must be its own nearest neighbor.
+  void expectSelfMatches(
+      const Eigen::MatrixXf& all_descriptors, const int first_query_idx,
+      const int num_queries) {
+    constexpr int kNumNeighbors = 5;
+    Eigen::MatrixXi indices(kNumNeighbors, num_queries);
+    Eigen::MatrixXf distances(kNumNeighbors, num_queries);
+    index_.GetNNearestNeighbors(
+        all_descriptors.middleCols(first_query_idx, num_queries),
+        kNumNeighbors, &indices, &distances);
+    for (int query_idx = 0; query_idx < num_queries; ++query_idx) {
+      EXPECT_EQ(indices(0, query_idx), first_query_idx + query_idx);
+      EXPECT_EQ(distances(0, query_idx), 0.0f);
+      for (int i = 1; i < kNumNeighbors; ++i) {
+        if (indices(i, query_idx) < 0) {
+          break;
+        }
+        EXPECT_LE(distances(i - 1, query_idx), distances(i, query_idx));
+        EXPECT_NEAR(
+            (all_descriptors.col(indices(i, query_idx)) -
+             all_descriptors.col(first_query_idx + query_idx))
+                .squaredNorm(),
+            distances(i, query_idx), 1e-5);
+      }
+    }
+  }
+
+  std::mt19937 random_engine_;
+  Index index_;
+};
+
+TEST_F(KDTreeIndexTest, EmptyIndex) {
+  constexpr int kNumNeighbors = 3;
+  Eigen::MatrixXi indices(kNumNeighbors, 1);
+  Eigen::MatrixXf distances(kNumNeighbors, 1);
+  index_.GetNNearestNeighbors(
+      randomDescriptors(1), kNumNeighbors, &indices, &distances);
+  EXPECT_EQ(indices(0, 0), -1);
+  EXPECT_EQ(index_.GetNumDescriptorsInIndex(), 0);
+  EXPECT_EQ(index_.GetNumTrees(), 0u);
+}
+
+TEST_F(KDTreeIndexTest, ForestHasLogarithmicNumberOfTrees) {
+  constexpr int kNumBlocks = 200;
+  const Eigen::MatrixXf all_descriptors = addRandomBlocks(kNumBlocks);
+  index_.FinishMerges();
+
+  const int num_descriptors = all_descriptors.cols();
+  EXPECT_EQ(index_.GetNumDescriptorsInIndex(), num_descriptors);
+  EXPECT_GT(index_.GetNumTrees(), 0u);
+  EXPECT_LE(index_.GetNumTrees(), std::log2(num_descriptors) + 1.0);
+  expectSelfMatches(all_descriptors, 0, num_descriptors);
+
+  index_.Clear();
+  EXPECT_EQ(index_.GetNumDescriptorsInIndex(), 0);
+  EXPECT_EQ(index_.GetNumTrees(), 0u);
+}
+
+TEST_F(KDTreeIndexTest, QueriesWhileMerging) {
+  constexpr int kNumBlocks = 100;
+  Eigen::MatrixXf all_descriptors(kDimensions, 0);
+  for (int block_idx = 0; block_idx < kNumBlocks; ++block_idx) {
+    const int first_new_idx = all_descriptors.cols();
+    const Eigen::MatrixXf new_descriptors = addRandomBlocks(1);
+    all_descriptors.conservativeResize(
+        Eigen::NoChange, all_descriptors.cols() + new_descriptors.cols());
+    all_descriptors.rightCols(new_descriptors.cols()) = new_descriptors;
+
+    // The new descriptors are found right away, merges may still be running.
+    expectSelfMatches(all_descriptors, first_new_idx, new_descriptors.cols());
+  }
+  expectSelfMatches(all_descriptors, 0, all_descriptors.cols());
+}
+
+TEST_F(KDTreeIndexTest, QueriesTakeOverFinishedMerges) {
+  // Two equally sized blocks start a merge into a single tree.
+  constexpr int kNumBlockDescriptors = 1000;
+  Eigen::MatrixXf all_descriptors(kDimensions, 2 * kNumBlockDescriptors);
+  all_descriptors.leftCols(kNumBlockDescriptors) =
+      randomDescriptors(kNumBlockDescriptors);
+  all_descriptors.rightCols(kNumBlockDescriptors) =
+      randomDescriptors(kNumBlockDescriptors);
+  index_.AddDescriptors(all_descriptors.leftCols(kNumBlockDescriptors));
+  index_.AddDescriptors(all_descriptors.rightCols(kNumBlockDescriptors));
+
+  // Without adding more descriptors or calling FinishMerges, the queries
+  // publish the merged tree once the merge is done.
+  const std::chrono::steady_clock::time_point deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(30);
+  while (index_.GetNumTrees() > 1u &&
+         std::chrono::steady_clock::now() < deadline) {
+    expectSelfMatches(all_descriptors, 0, 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_EQ(index_.GetNumTrees(), 1u);
+  expectSelfMatches(all_descriptors, 0, all_descriptors.cols());
+}
+
+TEST_F(KDTreeIndexTest, ConcurrentQueriesWhileMerging) {
+  // Two equally sized large blocks start a merge that takes a while.
+  constexpr int kNumLargeBlockDescriptors = 10000;
+  Eigen::MatrixXf all_descriptors(kDimensions, 2 * kNumLargeBlockDescriptors);
+  all_descriptors.leftCols(kNumLargeBlockDescriptors) =
+      randomDescriptors(kNumLargeBlockDescriptors);
+  all_descriptors.rightCols(kNumLargeBlockDescriptors) =
+      randomDescriptors(kNumLargeBlockDescriptors);
+  index_.AddDescriptors(all_descriptors.leftCols(kNumLargeBlockDescriptors));
+  index_.AddDescriptors(all_descriptors.rightCols(kNumLargeBlockDescriptors));
+
+  // Query the existing descriptors from several threads while more
+  // descriptors are added and finished merges are taken over.
+  constexpr int kNumThreads = 4;
+  constexpr int kNumQueriesPerThread = 500;
+  constexpr int kNumNeighbors = 3;
+  std::vector<std::thread> threads;
+  for (int thread_idx = 0; thread_idx < kNumThreads; ++thread_idx) {
+    threads.emplace_back([&, thread_idx]() {
+      Eigen::MatrixXi indices(kNumNeighbors, 1);
+      Eigen::MatrixXf distances(kNumNeighbors, 1);
+      for (int i = 0; i < kNumQueriesPerThread; ++i) {
+        const int query_idx = (thread_idx * kNumQueriesPerThread + i) * 7 %
+                              all_descriptors.cols();
+        index_.GetNNearestNeighbors(
+            all_descriptors.col(query_idx), kNumNeighbors, &indices,
+            &distances);
+        EXPECT_EQ(indices(0, 0), query_idx);
+        EXPECT_EQ(distances(0, 0), 0.0f);
+      }
+    });
+  }
+  const Eigen::MatrixXf added_descriptors = addRandomBlocks(50);
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  all_descriptors.conservativeResize(
+      Eigen::NoChange, all_descriptors.cols() + added_descriptors.cols());
+  all_descriptors.rightCols(added_descriptors.cols()) = added_descriptors;
+  index_.FinishMerges();
+  EXPECT_EQ(index_.GetNumDescriptorsInIndex(), all_descriptors.cols());
+  expectSelfMatches(all_descriptors, 0, all_descriptors.cols());
+}
+
+}  // namespace kd_tree_index
+}  // namespace loop_closure
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,366 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/hash-id.h>
+#include <descriptor-projection/flags.h>
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+#include <loopclosure-common/types.h>
+#include <maplab-common/mapped-memory.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/unique-id.h>
+#include <unistd.h>
+
+#include "matching-based-loopclosure/covisibility-filter.h"
+#include "matching-based-loopclosure/detector-settings.h"
+#include "matching-based-loopclosure/inverted-multi-index-interface.h"
+#include "matching-based-loopclosure/mapped-database.h"
+#include "matching-based-loopclosure/matching-based-engine.h"
+
+namespace matching_based_loopclosure {
+
+struct MatchLess {
+  bool operator()(
+      const loop_closure::Match& lhs, const loop_closure::Match& rhs) const {
+    return internal::isMatchLess(lhs, rhs);
+  }
+};
+typedef std::set<loop_closure::Match, MatchLess> MatchSet;
+
+constexpr int kNumVertices = 20;
+constexpr int kNumFramesPerVertex = 2;
+constexpr int kNumKeypointsPerFrame = 100;
+constexpr int kDescriptorDimensionality = 10;
+constexpr int kNumWordsPerHalf = 16;
+
+class MappedDatabaseTest : public ::testing::Test {
+ protected:
+  MappedDatabaseTest()
+      : random_engine_(42u),
+        name_("test_mapped_database_" + std::to_string(getpid()) + ".bin"),
+        quantizer_filename_(
+            "test_mapped_database_quantizer_" + std::to_string(getpid()) +
+            ".dat") {
+    common::generateId(&dataset_id_);
+  }
+
+  virtual void SetUp() {
+    // The settings use a random vocabulary instead of the default files in
+    // MAPLAB_LOOPCLOSURE_DIR.
+    FLAGS_lc_target_dimensionality = kDescriptorDimensionality;
+    writeRandomVocabulary();
+    FLAGS_lc_projected_quantizer_filename = quantizer_filename_;
+    // Only read by the KD-tree engine.
+    FLAGS_lc_projection_matrix_filename = quantizer_filename_;
+    settings_.reset(new MatchingBasedEngineSettings);
+    settings_->setDetectorEngineType(kMatchingLDInvertedMultiIndexString);
+  }
+
+  virtual void TearDown() {
+    common::MappedMemory::remove(common::MappedMemory::Type::kFile, name_);
+    std::remove(quantizer_filename_.c_str());
+  }
+
+  void writeRandomVocabulary() {
+    std::normal_distribution<float> distribution(0.f, 1.f);
+    loop_closure::InvertedMultiIndexVocabulary vocabulary;
+    vocabulary.projection_matrix_.setIdentity(
+        kDescriptorDimensionality, kDescriptorDimensionality);
+    vocabulary.words_first_half_.resize(
+        kDescriptorDimensionality / 2, kNumWordsPerHalf);
+    vocabulary.words_second_half_.resize(
+        kDescriptorDimensionality / 2, kNumWordsPerHalf);
+    for (int i = 0; i < vocabulary.words_first_half_.size(); ++i) {
+      vocabulary.words_first_half_(i) = distribution(random_engine_);
+      vocabulary.words_second_half_(i) = distribution(random_engine_);
+    }
+    std::ofstream out_stream(quantizer_filename_, std::ios_base::binary);
+    ASSERT_TRUE(out_stream.is_open());
+    vocabulary.Save(&out_stream);
+  }
+
+  loop_closure::ProjectedImage::Ptr randomProjectedImage(
+      const int vertex_index, const int frame_index) {
+    std::normal_distribution<float> distribution(0.f, 1.f);
+    loop_closure::ProjectedImage::Ptr projected_image(
+        new loop_closure::ProjectedImage);
+    common::generateIdFromInt(
+        vertex_index, &projected_image->keyframe_id.vertex_id);
+    projected_image->keyframe_id.frame_index = frame_index;
+    projected_image->dataset_id = dataset_id_;
+    projected_image->timestamp_nanoseconds = 0;
+    projected_image->projected_descriptors.resize(
+        kDescriptorDimensionality, kNumKeypointsPerFrame);
+    for (int i = 0; i < projected_image->projected_descriptors.size(); ++i) {
+      projected_image->projected_descriptors(i) = distribution(random_engine_);
+    }
+    projected_image->measurements.setZero(2, kNumKeypointsPerFrame);
+    for (int i = 0; i < kNumKeypointsPerFrame; ++i) {
+      vi_map::LandmarkId landmark_id;
+      common::generateId(&landmark_id);
+      projected_image->landmarks.push_back(landmark_id);
+    }
+    return projected_image;
+  }
+
+  loop_closure::ProjectedImagePtrList insertRandomImages(
+      loop_detector::LoopDetector* loop_detector) {
+    CHECK_NOTNULL(loop_detector);
+    loop_closure::ProjectedImagePtrList database_images;
+    for (int vertex_idx = 0; vertex_idx < kNumVertices; ++vertex_idx) {
+      for (int frame_idx = 0; frame_idx < kNumFramesPerVertex; ++frame_idx) {
+        database_images.push_back(randomProjectedImage(vertex_idx, frame_idx));
+        loop_detector->Insert(database_images.back());
+      }
+    }
+    return database_images;
+  }
+
+  MappedDatabase::Header readPublishedHeader() const {
+    MappedDatabase::Header header;
+    std::ifstream in_stream(name_, std::ios_base::binary);
+    CHECK(in_stream.is_open());
+    CHECK(in_stream.read(reinterpret_cast<char*>(&header), sizeof(header)));
+    return header;
+  }
+
+  void overwritePublishedValue(const uint64_t offset, const uint32_t value) {
+    std::fstream stream(
+        name_, std::ios_base::binary | std::ios_base::in | std::ios_base::out);
+    CHECK(stream.is_open());
+    stream.seekp(offset);
+    CHECK(stream.write(reinterpret_cast<const char*>(&value), sizeof(value)));
+  }
+
+  google::FlagSaver flag_saver_;
+  std::mt19937 random_engine_;
+  const std::string name_;
+  const std::string quantizer_filename_;
+  std::unique_ptr<MatchingBasedEngineSettings> settings_;
+  loop_closure::DatasetId dataset_id_;
+};
+
+TEST_F(MappedDatabaseTest, MappedDatabaseFindsTheSameMatches) {
+  MatchingBasedLoopDetector matching_based_loop_detector(*settings_);
+  loop_detector::LoopDetector& loop_detector = matching_based_loop_detector;
+  const loop_closure::ProjectedImagePtrList database_images =
+      insertRandomImages(&loop_detector);
+
+  const std::vector<loop_closure::DatasetId> dataset_ids = {dataset_id_};
+  aslam::HashId source_id;
+  source_id.randomize();
+  // Publishing again replaces the previously published database.
+  ASSERT_TRUE(
+      loop_detector.publishMappedDatabase(
+          common::MappedMemory::Type::kFile, name_, dataset_ids,
+          aslam::HashId()));
+  ASSERT_TRUE(
+      loop_detector.publishMappedDatabase(
+          common::MappedMemory::Type::kFile, name_, dataset_ids, source_id));
+
+  MatchingBasedLoopDetector matching_based_mapped_loop_detector(*settings_);
+  loop_detector::LoopDetector& mapped_loop_detector =
+      matching_based_mapped_loop_detector;
+  std::vector<loop_closure::DatasetId> mapped_dataset_ids;
+  ASSERT_TRUE(
+      mapped_loop_detector.attachMappedDatabase(
+          common::MappedMemory::Type::kFile, name_, source_id,
+          &mapped_dataset_ids));
+  EXPECT_EQ(mapped_dataset_ids, dataset_ids);
+  EXPECT_EQ(mapped_loop_detector.NumEntries(), loop_detector.NumEntries());
+  EXPECT_EQ(
+      mapped_loop_detector.NumDescriptors(), loop_detector.NumDescriptors());
+
+  for (int vertex_idx = 0; vertex_idx < kNumVertices; vertex_idx += 5) {
+    // Queries from a different vertex and dataset, which should match the
+    // database image they are copied from.
+    loop_closure::ProjectedImage::Ptr query(new loop_closure::ProjectedImage(
+        *database_images[vertex_idx * kNumFramesPerVertex]));
+    common::generateIdFromInt(
+        kNumVertices + vertex_idx, &query->keyframe_id.vertex_id);
+    common::generateId(&query->dataset_id);
+    const loop_closure::ProjectedImagePtrList query_images = {query};
+
+    loop_closure::FrameToMatches frame_matches;
+    loop_detector.Find(query_images, false, &frame_matches);
+    loop_closure::FrameToMatches mapped_frame_matches;
+    mapped_loop_detector.Find(query_images, false, &mapped_frame_matches);
+
+    ASSERT_FALSE(frame_matches.empty());
+    ASSERT_EQ(frame_matches.size(), mapped_frame_matches.size());
+    for (const loop_closure::FrameToMatches::value_type& frame_id_matches :
+         frame_matches) {
+      const loop_closure::FrameToMatches::const_iterator mapped_it =
+          mapped_frame_matches.find(frame_id_matches.first);
+      ASSERT_TRUE(mapped_it != mapped_frame_matches.end());
+      ASSERT_EQ(frame_id_matches.second.size(), mapped_it->second.size());
+      const MatchSet matches(
+          frame_id_matches.second.begin(), frame_id_matches.second.end());
+      const MatchSet mapped_matches(
+          mapped_it->second.begin(), mapped_it->second.end());
+      EXPECT_TRUE(matches == mapped_matches);
+    }
+  }
+
+  // A cleared loop detector is writable again.
+  mapped_loop_detector.Clear();
+  EXPECT_EQ(mapped_loop_detector.NumEntries(), 0u);
+  mapped_loop_detector.Insert(database_images.front());
+  EXPECT_EQ(mapped_loop_detector.NumEntries(), 1u);
+}
+
+TEST_F(MappedDatabaseTest, AttachFailsIfNameDoesNotExist) {
+  MatchingBasedLoopDetector matching_based_loop_detector(*settings_);
+  loop_detector::LoopDetector& loop_detector = matching_based_loop_detector;
+  std::vector<loop_closure::DatasetId> dataset_ids;
+  EXPECT_FALSE(
+      loop_detector.attachMappedDatabase(
+          common::MappedMemory::Type::kFile, name_, aslam::HashId(),
+          &dataset_ids));
+  EXPECT_EQ(loop_detector.NumEntries(), 0u);
+}
+
+TEST_F(MappedDatabaseTest, AttachFailsIfSourceIdDiffers) {
+  MatchingBasedLoopDetector matching_based_loop_detector(*settings_);
+  loop_detector::LoopDetector& loop_detector = matching_based_loop_detector;
+  insertRandomImages(&loop_detector);
+  aslam::HashId source_id;
+  source_id.randomize();
+  ASSERT_TRUE(
+      loop_detector.publishMappedDatabase(
+          common::MappedMemory::Type::kFile, name_, {dataset_id_}, source_id));
+
+  MatchingBasedLoopDetector matching_based_mapped_loop_detector(*settings_);
+  loop_detector::LoopDetector& mapped_loop_detector =
+      matching_based_mapped_loop_detector;
+  aslam::HashId other_source_id;
+  other_source_id.randomize();
+  std::vector<loop_closure::DatasetId> dataset_ids;
+  EXPECT_FALSE(
+      mapped_loop_detector.attachMappedDatabase(
+          common::MappedMemory::Type::kFile, name_, other_source_id,
+          &dataset_ids));
+  EXPECT_EQ(mapped_loop_detector.NumEntries(), 0u);
+  // The source ID is only checked if one is expected.
+  EXPECT_TRUE(
+      mapped_loop_detector.attachMappedDatabase(
+          common::MappedMemory::Type::kFile, name_, aslam::HashId(),
+          &dataset_ids));
+  EXPECT_EQ(mapped_loop_detector.NumEntries(), loop_detector.NumEntries());
+}
+
+TEST_F(MappedDatabaseTest, AttachFailsIfBackendIsNotTheInvertedMultiIndex) {
+  MatchingBasedLoopDetector matching_based_loop_detector(*settings_);
+  loop_detector::LoopDetector& loop_detector = matching_based_loop_detector;
+  insertRandomImages(&loop_detector);
+  ASSERT_TRUE(
+      loop_detector.publishMappedDatabase(
+          common::MappedMemory::Type::kFile, name_, {dataset_id_},
+          aslam::HashId()));
+
+  MatchingBasedEngineSettings hamming_settings;
+  hamming_settings.setDetectorEngineType(kMatchingLDHammingString);
+  MatchingBasedLoopDetector matching_based_hamming_loop_detector(
+      hamming_settings);
+  loop_detector::LoopDetector& hamming_loop_detector =
+      matching_based_hamming_loop_detector;
+  std::vector<loop_closure::DatasetId> dataset_ids;
+  EXPECT_FALSE(
+      hamming_loop_detector.attachMappedDatabase(
+          common::MappedMemory::Type::kFile, name_, aslam::HashId(),
+          &dataset_ids));
+  EXPECT_EQ(hamming_loop_detector.NumEntries(), 0u);
+}
+
+TEST_F(MappedDatabaseTest, AttachFailsIfIndicesAreOutOfRange) {
+  MatchingBasedLoopDetector matching_based_loop_detector(*settings_);
+  loop_detector::LoopDetector& loop_detector = matching_based_loop_detector;
+  insertRandomImages(&loop_detector);
+
+  // Every corruption is applied to a freshly published database.
+  auto expect_attach_fails_after = [&](
+      const std::function<void(const MappedDatabase::Header&)>& corrupt) {
+    ASSERT_TRUE(
+        loop_detector.publishMappedDatabase(
+            common::MappedMemory::Type::kFile, name_, {dataset_id_},
+            aslam::HashId()));
+    corrupt(readPublishedHeader());
+    MatchingBasedLoopDetector matching_based_mapped_loop_detector(*settings_);
+    loop_detector::LoopDetector& mapped_loop_detector =
+        matching_based_mapped_loop_detector;
+    std::vector<loop_closure::DatasetId> dataset_ids;
+    EXPECT_FALSE(
+        mapped_loop_detector.attachMappedDatabase(
+            common::MappedMemory::Type::kFile, name_, aslam::HashId(),
+            &dataset_ids));
+    EXPECT_EQ(mapped_loop_detector.NumEntries(), 0u);
+  };
+
+  // The second word starts after the end of all descriptors.
+  expect_attach_fails_after([&](const MappedDatabase::Header& header) {
+    overwritePublishedValue(
+        header.word_offsets_offset + sizeof(uint32_t),
+        header.num_descriptors + 1u);
+  });
+  // The first keypoint belongs to a keyframe that doesn't exist.
+  expect_attach_fails_after([&](const MappedDatabase::Header& header) {
+    overwritePublishedValue(
+        header.keypoints_offset +
+            offsetof(MappedDatabase::Keypoint, keyframe_index),
+        header.num_keyframes);
+  });
+  // The landmarks of the first keyframe exceed the landmark section.
+  expect_attach_fails_after([&](const MappedDatabase::Header& header) {
+    overwritePublishedValue(
+        header.keyframes_offset +
+            offsetof(MappedDatabase::Keyframe, num_landmarks),
+        static_cast<uint32_t>(header.num_landmarks) + 1u);
+  });
+}
+
+TEST_F(MappedDatabaseTest, PublisherRemovesTheNameOnDestruction) {
+  std::unique_ptr<loop_detector::LoopDetector> loop_detector(
+      new MatchingBasedLoopDetector(*settings_));
+  insertRandomImages(loop_detector.get());
+  ASSERT_TRUE(
+      loop_detector->publishMappedDatabase(
+          common::MappedMemory::Type::kFile, name_, {dataset_id_},
+          aslam::HashId()));
+  const size_t num_entries = loop_detector->NumEntries();
+
+  MatchingBasedLoopDetector matching_based_mapped_loop_detector(*settings_);
+  loop_detector::LoopDetector& mapped_loop_detector =
+      matching_based_mapped_loop_detector;
+  std::vector<loop_closure::DatasetId> dataset_ids;
+  ASSERT_TRUE(
+      mapped_loop_detector.attachMappedDatabase(
+          common::MappedMemory::Type::kFile, name_, aslam::HashId(),
+          &dataset_ids));
+
+  // The attached loop detector keeps its mapping, but nobody else can attach
+  // anymore.
+  loop_detector.reset();
+  EXPECT_FALSE(
+      common::MappedMemory::remove(common::MappedMemory::Type::kFile, name_));
+  EXPECT_EQ(mapped_loop_detector.NumEntries(), num_entries);
+  MatchingBasedLoopDetector matching_based_other_loop_detector(*settings_);
+  loop_detector::LoopDetector& other_loop_detector =
+      matching_based_other_loop_detector;
+  EXPECT_FALSE(
+      other_loop_detector.attachMappedDatabase(
+          common::MappedMemory::Type::kFile, name_, aslam::HashId(),
+          &dataset_ids));
+}
+
+}  // namespace matching_based_loopclosure
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -6,6 +6,8 @@ inline unsigned int HammingDistance128(
     const unsigned char d1[16], const unsigned char d2[16]);
 inline unsigned int HammingDistance256(
     const unsigned char d1[32], const unsigned char d2[32]);
+inline unsigned int HammingDistance384(
+    const unsigned char d1[48], const unsigned char d2[48]);
 inline unsigned int HammingDistance512(
     const unsigned char d1[64], const unsigned char d2[64]);
 inline unsigned int HammingDistance(
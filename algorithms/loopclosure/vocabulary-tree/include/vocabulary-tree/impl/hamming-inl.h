@@ -267,6 +267,26 @@ inline unsigned int HammingDistance256(
 #endif  // __ARM_NEON__
 }
 
+// Hamming distance for 384 bits.
+inline unsigned int HammingDistance384(
+    const unsigned char d1[48], const unsigned char d2[48]) {
+#ifdef __ARM_NEON__
+#ifdef __aarch64__
+  const uint8x16_t* a = reinterpret_cast<const uint8x16_t*>(d1);
+  const uint8x16_t* b = reinterpret_cast<const uint8x16_t*>(d2);
+
+  return NEONPopcntofXORed(a, b, 3);
+#else
+  return HammingDistance256(d1, d2) + HammingDistance128(d1 + 32, d2 + 32);
+#endif
+#else
+  const __m128i* a = reinterpret_cast<const __m128i*>(d1);
+  const __m128i* b = reinterpret_cast<const __m128i*>(d2);
+
+  return SSSE3PopcntofXORed<3>(a, b);
+#endif
+}
+
 // Hamming distance for 512 bits.
 inline unsigned int HammingDistance512(
     const unsigned char d1[64], const unsigned char d2[64]) {
@@ -295,6 +315,8 @@ inline unsigned int HammingDistance(
       return HammingDistance128(d1, d2);
     case 256:
       return HammingDistance256(d1, d2);
+    case 384:
+      return HammingDistance384(d1, d2);
     case 512:
       return HammingDistance512(d1, d2);
     default:
@@ -0,0 +1,76 @@
+#ifndef VOCABULARY_TREE_PARALLEL_KMEANS_H_
+#define VOCABULARY_TREE_PARALLEL_KMEANS_H_
+
+#include <cstddef>
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace loop_closure {
+
+struct ParallelKmeansSettings {
+  ParallelKmeansSettings();
+
+  // Number of threads used for the assignment and update steps.
+  size_t num_threads;
+  size_t max_iterations;
+  // If non-zero, every iteration updates the centers from a random sample of
+  // this many descriptors (mini-batch k-means) instead of from all
+  // descriptors.
+  size_t mini_batch_size;
+  // The clustering stops once no center moves further than this in an
+  // iteration.
+  double center_movement_tolerance;
+  int random_seed;
+};
+
+// K-means for floating point descriptors stored as the columns of a matrix.
+// The centers are initialized with k-means++. Every iteration assigns the
+// descriptors in chunks across threads, computing the distances of a chunk to
+// all centers with a single matrix product. Full iterations recompute the
+// centers in parallel, mini-batch iterations move the centers towards the
+// descriptors of a random sample. The results do not depend on the number of
+// threads.
+class ParallelKmeans {
+ public:
+  explicit ParallelKmeans(const ParallelKmeansSettings& settings);
+
+  const ParallelKmeansSettings& settings() const {
+    return settings_;
+  }
+
+  // Partitions the columns of descriptors into num_centers clusters. Returns
+  // the sum of the squared distances of the descriptors to their centers.
+  double Cluster(
+      const Eigen::MatrixXf& descriptors, size_t num_centers,
+      Eigen::MatrixXf* centers, std::vector<unsigned int>* membership) const;
+
+  // Assigns every descriptor to its closest center. The squared distances to
+  // the assigned centers are optional.
+  void Assign(
+      const Eigen::MatrixXf& descriptors, const Eigen::MatrixXf& centers,
+      std::vector<unsigned int>* membership,
+      std::vector<float>* squared_distances) const;
+
+ private:
+  void InitializeCentersKMeansPlusPlus(
+      const Eigen::MatrixXf& descriptors, size_t num_centers,
+      std::mt19937* generator, Eigen::MatrixXf* centers) const;
+
+  // Both return the largest distance a center moved.
+  double UpdateCentersFull(
+      const Eigen::MatrixXf& descriptors,
+      const std::vector<unsigned int>& membership,
+      const std::vector<float>& squared_distances,
+      Eigen::MatrixXf* centers) const;
+  double UpdateCentersMiniBatch(
+      const Eigen::MatrixXf& batch, const std::vector<unsigned int>& membership,
+      std::vector<size_t>* center_counts, Eigen::MatrixXf* centers) const;
+
+  const ParallelKmeansSettings settings_;
+};
+
+}  // namespace loop_closure
+
+#endif  // VOCABULARY_TREE_PARALLEL_KMEANS_H_
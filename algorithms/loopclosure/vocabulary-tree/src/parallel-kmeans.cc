@@ -0,0 +1,296 @@
+#include "vocabulary-tree/parallel-kmeans.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+#include <glog/logging.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
+
+namespace loop_closure {
+namespace {
+
+// The descriptors are processed in chunks of fixed size, so the results do not
+// depend on how the chunks are distributed over the threads.
+constexpr size_t kChunkSize = 256u;
+
+// Calls functor(begin, end) for consecutive ranges of at most kChunkSize
+// items, distributed over the given number of threads.
+template <typename Functor>
+void ParallelProcessChunks(
+    const size_t num_items, const size_t num_threads, const Functor& functor) {
+  const size_t num_chunks = (num_items + kChunkSize - 1u) / kChunkSize;
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      num_chunks,
+      [&](const std::vector<size_t>& range) {
+        for (const size_t chunk_idx : range) {
+          const size_t begin = chunk_idx * kChunkSize;
+          functor(begin, std::min(begin + kChunkSize, num_items));
+        }
+      },
+      kAlwaysParallelize, num_threads);
+}
+
+}  // namespace
+
+ParallelKmeansSettings::ParallelKmeansSettings()
+    : num_threads(common::getNumHardwareThreads()),
+      max_iterations(100u),
+      mini_batch_size(0u),
+      center_movement_tolerance(1e-4),
+      random_seed(42) {}
+
+ParallelKmeans::ParallelKmeans(const ParallelKmeansSettings& settings)
+    : settings_(settings) {
+  CHECK_GT(settings_.num_threads, 0u);
+  CHECK_GE(settings_.center_movement_tolerance, 0.0);
+}
+
+double ParallelKmeans::Cluster(
+    const Eigen::MatrixXf& descriptors, const size_t num_centers,
+    Eigen::MatrixXf* centers, std::vector<unsigned int>* membership) const {
+  CHECK_NOTNULL(centers);
+  CHECK_NOTNULL(membership);
+  CHECK_GT(num_centers, 0u);
+  CHECK_LE(num_centers, static_cast<size_t>(descriptors.cols()))
+      << "Cannot cluster " << descriptors.cols() << " descriptors into "
+      << num_centers << " clusters.";
+
+  std::mt19937 generator(settings_.random_seed);
+  InitializeCentersKMeansPlusPlus(
+      descriptors, num_centers, &generator, centers);
+
+  std::vector<float> squared_distances;
+  if (settings_.mini_batch_size == 0u) {
+    for (size_t iteration = 0u; iteration < settings_.max_iterations;
+         ++iteration) {
+      Assign(descriptors, *centers, membership, &squared_distances);
+      const double max_center_movement = UpdateCentersFull(
+          descriptors, *membership, squared_distances, centers);
+      VLOG(3) << "Iteration " << iteration
+              << ", max center movement: " << max_center_movement;
+      if (max_center_movement <= settings_.center_movement_tolerance) {
+        break;
+      }
+    }
+  } else {
+    std::uniform_int_distribution<int> descriptor_distribution(
+        0, descriptors.cols() - 1);
+    Eigen::MatrixXf batch(descriptors.rows(), settings_.mini_batch_size);
+    std::vector<unsigned int> batch_membership;
+    std::vector<size_t> center_counts(num_centers, 0u);
+    for (size_t iteration = 0u; iteration < settings_.max_iterations;
+         ++iteration) {
+      for (int i = 0; i < batch.cols(); ++i) {
+        batch.col(i) = descriptors.col(descriptor_distribution(generator));
+      }
+      Assign(batch, *centers, &batch_membership, nullptr);
+      const double max_center_movement = UpdateCentersMiniBatch(
+          batch, batch_membership, &center_counts, centers);
+      VLOG(3) << "Mini-batch iteration " << iteration
+              << ", max center movement: " << max_center_movement;
+      if (max_center_movement <= settings_.center_movement_tolerance) {
+        break;
+      }
+    }
+  }
+
+  Assign(descriptors, *centers, membership, &squared_distances);
+  return std::accumulate(
+      squared_distances.begin(), squared_distances.end(), 0.0);
+}
+
+void ParallelKmeans::Assign(
+    const Eigen::MatrixXf& descriptors, const Eigen::MatrixXf& centers,
+    std::vector<unsigned int>* membership,
+    std::vector<float>* squared_distances) const {
+  CHECK_NOTNULL(membership);
+  CHECK_GT(centers.cols(), 0);
+  CHECK_EQ(descriptors.rows(), centers.rows());
+  const size_t num_descriptors = descriptors.cols();
+  membership->resize(num_descriptors);
+  if (squared_distances != nullptr) {
+    squared_distances->resize(num_descriptors);
+  }
+
+  const Eigen::VectorXf center_squared_norms =
+      centers.colwise().squaredNorm().transpose();
+  ParallelProcessChunks(
+      num_descriptors, settings_.num_threads,
+      [&](const size_t begin, const size_t end) {
+        // |d - c|^2 - |d|^2 for all centers c and descriptors d of the chunk.
+        Eigen::MatrixXf chunk_distances =
+            -2.0f * centers.transpose() *
+            descriptors.middleCols(begin, end - begin);
+        chunk_distances.colwise() += center_squared_norms;
+        for (size_t i = begin; i < end; ++i) {
+          Eigen::MatrixXf::Index closest_center;
+          const float distance =
+              chunk_distances.col(i - begin).minCoeff(&closest_center);
+          (*membership)[i] = closest_center;
+          if (squared_distances != nullptr) {
+            (*squared_distances)[i] =
+                std::max(0.0f, distance + descriptors.col(i).squaredNorm());
+          }
+        }
+      });
+}
+
+void ParallelKmeans::InitializeCentersKMeansPlusPlus(
+    const Eigen::MatrixXf& descriptors, const size_t num_centers,
+    std::mt19937* generator, Eigen::MatrixXf* centers) const {
+  CHECK_NOTNULL(generator);
+  CHECK_NOTNULL(centers);
+  const size_t num_descriptors = descriptors.cols();
+  centers->resize(descriptors.rows(), num_centers);
+
+  // Every new center is drawn with a probability proportional to the squared
+  // distance of the descriptor to the closest center so far.
+  std::vector<float> min_squared_distances(
+      num_descriptors, std::numeric_limits<float>::max());
+  std::vector<double> cumulative_squared_distances(num_descriptors);
+  std::uniform_int_distribution<size_t> descriptor_distribution(
+      0u, num_descriptors - 1u);
+  size_t descriptor_idx = descriptor_distribution(*generator);
+  for (size_t center_idx = 0u; center_idx < num_centers; ++center_idx) {
+    centers->col(center_idx) = descriptors.col(descriptor_idx);
+    if (center_idx + 1u == num_centers) {
+      break;
+    }
+
+    ParallelProcessChunks(
+        num_descriptors, settings_.num_threads,
+        [&](const size_t begin, const size_t end) {
+          for (size_t i = begin; i < end; ++i) {
+            min_squared_distances[i] = std::min(
+                min_squared_distances[i],
+                (descriptors.col(i) - centers->col(center_idx)).squaredNorm());
+          }
+        });
+    double sum_squared_distances = 0.0;
+    for (size_t i = 0u; i < num_descriptors; ++i) {
+      sum_squared_distances += min_squared_distances[i];
+      cumulative_squared_distances[i] = sum_squared_distances;
+    }
+
+    if (sum_squared_distances > 0.0) {
+      std::uniform_real_distribution<double> cutoff_distribution(
+          0.0, sum_squared_distances);
+      const double cutoff = cutoff_distribution(*generator);
+      descriptor_idx = std::min<size_t>(
+          std::upper_bound(
+              cumulative_squared_distances.begin(),
+              cumulative_squared_distances.end(), cutoff) -
+              cumulative_squared_distances.begin(),
+          num_descriptors - 1u);
+    } else {
+      // All descriptors coincide with a center.
+      descriptor_idx = descriptor_distribution(*generator);
+    }
+  }
+}
+
+double ParallelKmeans::UpdateCentersFull(
+    const Eigen::MatrixXf& descriptors,
+    const std::vector<unsigned int>& membership,
+    const std::vector<float>& squared_distances,
+    Eigen::MatrixXf* centers) const {
+  CHECK_NOTNULL(centers);
+  const size_t num_descriptors = descriptors.cols();
+  const size_t num_centers = centers->cols();
+  CHECK_EQ(membership.size(), num_descriptors);
+  CHECK_EQ(squared_distances.size(), num_descriptors);
+
+  // Groups the descriptors by center, keeping the descriptor order.
+  std::vector<size_t> member_offsets(num_centers + 1u, 0u);
+  for (const unsigned int center_idx : membership) {
+    ++member_offsets[center_idx + 1u];
+  }
+  std::partial_sum(
+      member_offsets.begin(), member_offsets.end(), member_offsets.begin());
+  std::vector<size_t> members(num_descriptors);
+  std::vector<size_t> insert_positions(
+      member_offsets.begin(), member_offsets.end() - 1);
+  for (size_t i = 0u; i < num_descriptors; ++i) {
+    members[insert_positions[membership[i]]++] = i;
+  }
+
+  Eigen::MatrixXf new_centers = *centers;
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      num_centers,
+      [&](const std::vector<size_t>& range) {
+        Eigen::VectorXd sum(descriptors.rows());
+        for (const size_t center_idx : range) {
+          const size_t members_begin = member_offsets[center_idx];
+          const size_t members_end = member_offsets[center_idx + 1u];
+          if (members_begin == members_end) {
+            continue;
+          }
+          sum.setZero();
+          for (size_t i = members_begin; i < members_end; ++i) {
+            sum += descriptors.col(members[i]).cast<double>();
+          }
+          new_centers.col(center_idx) =
+              (sum / (members_end - members_begin)).cast<float>();
+        }
+      },
+      kAlwaysParallelize, settings_.num_threads);
+
+  // Empty clusters take over the descriptors that are farthest from their
+  // centers.
+  std::vector<size_t> empty_centers;
+  for (size_t center_idx = 0u; center_idx < num_centers; ++center_idx) {
+    if (member_offsets[center_idx] == member_offsets[center_idx + 1u]) {
+      empty_centers.push_back(center_idx);
+    }
+  }
+  if (!empty_centers.empty()) {
+    VLOG(3) << "Reseeding " << empty_centers.size() << " empty clusters.";
+    std::vector<size_t> farthest_descriptors(num_descriptors);
+    std::iota(farthest_descriptors.begin(), farthest_descriptors.end(), 0u);
+    std::partial_sort(
+        farthest_descriptors.begin(),
+        farthest_descriptors.begin() + empty_centers.size(),
+        farthest_descriptors.end(), [&](const size_t lhs, const size_t rhs) {
+          return squared_distances[lhs] > squared_distances[rhs];
+        });
+    for (size_t i = 0u; i < empty_centers.size(); ++i) {
+      new_centers.col(empty_centers[i]) =
+          descriptors.col(farthest_descriptors[i]);
+    }
+  }
+
+  const double max_center_movement =
+      (new_centers - *centers).colwise().norm().maxCoeff();
+  centers->swap(new_centers);
+  return max_center_movement;
+}
+
+double ParallelKmeans::UpdateCentersMiniBatch(
+    const Eigen::MatrixXf& batch, const std::vector<unsigned int>& membership,
+    std::vector<size_t>* center_counts, Eigen::MatrixXf* centers) const {
+  CHECK_NOTNULL(center_counts);
+  CHECK_NOTNULL(centers);
+  CHECK_EQ(membership.size(), static_cast<size_t>(batch.cols()));
+  CHECK_EQ(center_counts->size(), static_cast<size_t>(centers->cols()));
+
+  // Every center moves towards its descriptors with a per-center learning
+  // rate of 1 / (number of descriptors assigned to it so far), see
+  // D. Sculley, Web-Scale K-Means Clustering, WWW 2010.
+  const Eigen::MatrixXf old_centers = *centers;
+  for (int i = 0; i < batch.cols(); ++i) {
+    const unsigned int center_idx = membership[i];
+    const size_t count = ++(*center_counts)[center_idx];
+    centers->col(center_idx) +=
+        (batch.col(i) - centers->col(center_idx)) / static_cast<float>(count);
+  }
+  return (*centers - old_centers).colwise().norm().maxCoeff();
+}
+
+}  // namespace loop_closure
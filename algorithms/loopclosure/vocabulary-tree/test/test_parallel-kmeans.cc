@@ -0,0 +1,141 @@
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/memory.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <vocabulary-tree/parallel-kmeans.h>
+
+#include "./floating-point-test-helpers.h"
+
+namespace loop_closure {
+
+constexpr size_t kNumClusters = 100u;
+constexpr size_t kNumDescriptorsPerCluster = 100u;
+
+class ParallelKmeansTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    std::mt19937 generator(40);
+    DescriptorVector gt_centers;
+    DescriptorVector descriptor_vector;
+    std::vector<unsigned int> membership;
+    std::vector<unsigned int> gt_membership;
+    GenerateTestData(
+        kNumDescriptorsPerCluster, kNumClusters, generator(), &gt_centers,
+        &descriptor_vector, &membership, &gt_membership);
+
+    descriptors_.resize(kDescriptorDimensionality, descriptor_vector.size());
+    for (size_t i = 0u; i < descriptor_vector.size(); ++i) {
+      descriptors_.col(i) = descriptor_vector[i];
+    }
+  }
+
+  Eigen::MatrixXf descriptors_;
+};
+
+TEST_F(ParallelKmeansTest, AssignsToClosestCenter) {
+  ParallelKmeansSettings settings;
+  ParallelKmeans kmeans(settings);
+  const Eigen::MatrixXf centers = descriptors_.leftCols(kNumClusters);
+  std::vector<unsigned int> membership;
+  std::vector<float> squared_distances;
+  kmeans.Assign(descriptors_, centers, &membership, &squared_distances);
+
+  ASSERT_EQ(membership.size(), static_cast<size_t>(descriptors_.cols()));
+  for (int i = 0; i < descriptors_.cols(); ++i) {
+    Eigen::MatrixXf::Index closest_center;
+    const float min_squared_distance =
+        (centers.colwise() - descriptors_.col(i))
+            .colwise()
+            .squaredNorm()
+            .minCoeff(&closest_center);
+    // The distances are computed from the norms and the dot product.
+    const float tolerance = 1e-4f * (1.0f + descriptors_.col(i).squaredNorm());
+    EXPECT_NEAR(squared_distances[i], min_squared_distance, tolerance);
+    EXPECT_NEAR(
+        (descriptors_.col(i) - centers.col(membership[i])).squaredNorm(),
+        min_squared_distance, tolerance);
+  }
+}
+
+TEST_F(ParallelKmeansTest, FullIterationsRecoverClusters) {
+  constexpr size_t kNumSeparatedClusters = 10u;
+  DescriptorVector gt_centers;
+  DescriptorVector descriptor_vector;
+  std::vector<unsigned int> membership;
+  std::vector<unsigned int> gt_membership;
+  GenerateTestData(
+      kNumDescriptorsPerCluster, kNumSeparatedClusters, 42u, &gt_centers,
+      &descriptor_vector, &membership, &gt_membership);
+  Eigen::MatrixXf descriptors(
+      kDescriptorDimensionality, descriptor_vector.size());
+  for (size_t i = 0u; i < descriptor_vector.size(); ++i) {
+    descriptors.col(i) = descriptor_vector[i];
+  }
+
+  ParallelKmeansSettings settings;
+  ParallelKmeans kmeans(settings);
+  Eigen::MatrixXf centers;
+  kmeans.Cluster(descriptors, kNumSeparatedClusters, &centers, &membership);
+  ASSERT_EQ(centers.cols(), static_cast<int>(kNumSeparatedClusters));
+
+  // Every ground-truth cluster maps to its own center.
+  std::vector<int> center_of_gt_cluster(kNumSeparatedClusters, -1);
+  std::vector<int> gt_cluster_of_center(kNumSeparatedClusters, -1);
+  for (size_t i = 0u; i < membership.size(); ++i) {
+    ASSERT_LT(membership[i], kNumSeparatedClusters);
+    if (center_of_gt_cluster[gt_membership[i]] < 0) {
+      center_of_gt_cluster[gt_membership[i]] = membership[i];
+    }
+    if (gt_cluster_of_center[membership[i]] < 0) {
+      gt_cluster_of_center[membership[i]] = gt_membership[i];
+    }
+    EXPECT_EQ(center_of_gt_cluster[gt_membership[i]], membership[i]);
+    EXPECT_EQ(gt_cluster_of_center[membership[i]], gt_membership[i]);
+  }
+}
+
+TEST_F(ParallelKmeansTest, MiniBatchApproachesFullIterations) {
+  ParallelKmeansSettings settings;
+  ParallelKmeans kmeans(settings);
+  Eigen::MatrixXf centers;
+  std::vector<unsigned int> membership;
+  const double full_sse =
+      kmeans.Cluster(descriptors_, kNumClusters, &centers, &membership);
+
+  settings.mini_batch_size = 1000u;
+  settings.max_iterations = 50u;
+  ParallelKmeans mini_batch_kmeans(settings);
+  const double mini_batch_sse = mini_batch_kmeans.Cluster(
+      descriptors_, kNumClusters, &centers, &membership);
+  EXPECT_LE(mini_batch_sse, 1.1 * full_sse);
+}
+
+TEST_F(ParallelKmeansTest, ResultsDoNotDependOnNumThreads) {
+  for (const size_t mini_batch_size : {0u, 1000u}) {
+    ParallelKmeansSettings settings;
+    settings.mini_batch_size = mini_batch_size;
+    settings.num_threads = 1u;
+    Eigen::MatrixXf sequential_centers;
+    std::vector<unsigned int> sequential_membership;
+    ParallelKmeans(settings).Cluster(
+        descriptors_, kNumClusters, &sequential_centers,
+        &sequential_membership);
+
+    settings.num_threads = 4u;
+    Eigen::MatrixXf parallel_centers;
+    std::vector<unsigned int> parallel_membership;
+    ParallelKmeans(settings).Cluster(
+        descriptors_, kNumClusters, &parallel_centers, &parallel_membership);
+
+    EXPECT_TRUE(sequential_centers == parallel_centers);
+    EXPECT_EQ(sequential_membership, parallel_membership);
+  }
+}
+
+}  // namespace loop_closure
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -5,6 +5,7 @@
 #include <vector>
 
 #include <aslam/common/memory.h>
+#include <aslam/common/pose-types.h>
 #include <glog/logging.h>
 #include <vi-map/vi-map.h>
 
@@ -25,6 +26,16 @@ class OptimizationStateBuffer {
   double* get_sensor_extrinsics_q_RS_JPL(const vi_map::SensorId& id);
   double* get_sensor_extrinsics_R_p_RS(const vi_map::SensorId& id);
 
+  // Access to the current states in the convention of the map. Return false
+  // if the state is not part of the buffer.
+  bool get_T_M_I(
+      const pose_graph::VertexId& id, aslam::Transformation* T_M_I) const;
+  bool get_T_G_M(
+      const vi_map::MissionBaseFrameId& id,
+      aslam::Transformation* T_G_M) const;
+  bool get_T_C_I(
+      const aslam::CameraId& id, aslam::Transformation* T_C_I) const;
+
  private:
   void importKeyframePosesOfMissions(
       const vi_map::VIMap& map, const vi_map::MissionIdSet& mission_ids);
@@ -46,6 +46,54 @@ double* OptimizationStateBuffer::get_sensor_extrinsics_R_p_RS(
   return sensor_R_p_RS_.col(index).data();
 }
 
+bool OptimizationStateBuffer::get_T_M_I(
+    const pose_graph::VertexId& id, aslam::Transformation* T_M_I) const {
+  CHECK_NOTNULL(T_M_I);
+  const size_t* index = common::getValuePtr(vertex_id_to_vertex_idx_, id);
+  if (index == nullptr) {
+    return false;
+  }
+  CHECK_LT(*index, static_cast<size_t>(vertex_q_IM__M_p_MI_.cols()));
+  // The passive JPL quaternion q_IM equals the active Hamilton q_M_I.
+  Eigen::Quaterniond q_M_I;
+  q_M_I.coeffs() = vertex_q_IM__M_p_MI_.col(*index).head<4>();
+  *T_M_I = aslam::Transformation(
+      vertex_q_IM__M_p_MI_.col(*index).tail<3>(), q_M_I.normalized());
+  return true;
+}
+
+bool OptimizationStateBuffer::get_T_G_M(
+    const vi_map::MissionBaseFrameId& id, aslam::Transformation* T_G_M) const {
+  CHECK_NOTNULL(T_G_M);
+  const size_t* index = common::getValuePtr(baseframe_id_to_baseframe_idx_, id);
+  if (index == nullptr) {
+    return false;
+  }
+  CHECK_LT(*index, static_cast<size_t>(baseframe_q_GM__G_p_GM_.cols()));
+  Eigen::Quaterniond q_G_M_JPL;
+  q_G_M_JPL.coeffs() = baseframe_q_GM__G_p_GM_.col(*index).head<4>();
+  *T_G_M = aslam::Transformation(
+      baseframe_q_GM__G_p_GM_.col(*index).tail<3>(),
+      q_G_M_JPL.normalized().inverse());
+  return true;
+}
+
+bool OptimizationStateBuffer::get_T_C_I(
+    const aslam::CameraId& id, aslam::Transformation* T_C_I) const {
+  CHECK_NOTNULL(T_C_I);
+  const size_t* index = common::getValuePtr(camera_id_to_camera_idx_, id);
+  if (index == nullptr) {
+    return false;
+  }
+  CHECK_LT(*index, static_cast<size_t>(camera_q_CI__C_p_CI_.cols()));
+  Eigen::Quaterniond q_C_I_JPL;
+  q_C_I_JPL.coeffs() = camera_q_CI__C_p_CI_.col(*index).head<4>();
+  *T_C_I = aslam::Transformation(
+      camera_q_CI__C_p_CI_.col(*index).tail<3>(),
+      q_C_I_JPL.normalized().inverse());
+  return true;
+}
+
 void OptimizationStateBuffer::copyAllStatesBackToMap(vi_map::VIMap* map) const {
   copyAllKeyframePosesBackToMap(map);
   copyAllBaseframePosesBackToMap(map);
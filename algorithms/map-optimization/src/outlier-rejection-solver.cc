@@ -1,8 +1,18 @@
 #include "map-optimization/outlier-rejection-solver.h"
 
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <aslam/common/pose-types.h>
 #include <aslam/common/timer.h>
 #include <ceres/ceres.h>
 #include <gflags/gflags.h>
+#include <maplab-common/accessors.h>
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/profiler.h>
+#include <maplab-common/threading-helpers.h>
 
 DEFINE_int32(
     ba_outlier_rejection_reject_every_n_iters, 3,
@@ -24,98 +34,279 @@ namespace map_optimization {
 
 namespace {
 
+// Flat description of all landmark observations in the problem. It is built
+// once per solve such that the outlier evaluation in every round is a tight
+// loop over plain arrays instead of map lookups per observation.
+struct ObservationTable {
+  // Per landmark. The observations of landmark i are in the range
+  // [landmark_observations_begin[i], landmark_observations_begin[i + 1]).
+  vi_map::LandmarkIdList landmark_ids;
+  std::vector<const vi_map::Landmark*> landmarks;
+  std::vector<size_t> landmark_store_vertex_idx;
+  std::vector<size_t> landmark_observations_begin;
+  std::vector<bool> landmark_is_active;
+
+  // Per observation.
+  std::vector<size_t> observer_vertex_idx;
+  std::vector<size_t> observer_camera_idx;
+  std::vector<bool> observer_is_in_store_mission;
+  Eigen::Matrix2Xd keypoint_measurements;
+
+  // Per observer or store vertex and per camera.
+  pose_graph::VertexIdList vertex_ids;
+  std::vector<vi_map::MissionBaseFrameId> vertex_baseframe_ids;
+  std::vector<aslam::Camera::ConstPtr> cameras;
+  aslam::TransformationVector cameras_T_C_B_in_map;
+
+  size_t numLandmarks() const {
+    return landmark_ids.size();
+  }
+};
+
+void buildObservationTable(
+    const vi_map::VIMap& map, const vi_map::LandmarkIdSet& landmark_ids,
+    ObservationTable* table) {
+  CHECK_NOTNULL(table);
+  std::unordered_map<pose_graph::VertexId, size_t> vertex_id_to_idx;
+  std::unordered_map<aslam::CameraId, size_t> camera_id_to_idx;
+  const auto get_vertex_idx = [&](const vi_map::Vertex& vertex) -> size_t {
+    const auto inserted =
+        vertex_id_to_idx.emplace(vertex.id(), table->vertex_ids.size());
+    if (inserted.second) {
+      table->vertex_ids.emplace_back(vertex.id());
+      table->vertex_baseframe_ids.emplace_back(
+          map.getMissionForVertex(vertex.id()).getBaseFrameId());
+    }
+    return inserted.first->second;
+  };
+
+  const size_t num_landmarks = landmark_ids.size();
+  table->landmark_ids.assign(landmark_ids.begin(), landmark_ids.end());
+  table->landmarks.reserve(num_landmarks);
+  table->landmark_store_vertex_idx.reserve(num_landmarks);
+  table->landmark_observations_begin.reserve(num_landmarks + 1u);
+  table->landmark_is_active.assign(num_landmarks, true);
+
+  size_t num_observations = 0u;
+  for (const vi_map::LandmarkId& landmark_id : table->landmark_ids) {
+    num_observations += map.getLandmark(landmark_id).numberOfObservations();
+  }
+  table->observer_vertex_idx.reserve(num_observations);
+  table->observer_camera_idx.reserve(num_observations);
+  table->observer_is_in_store_mission.reserve(num_observations);
+  table->keypoint_measurements.resize(Eigen::NoChange, num_observations);
+
+  for (const vi_map::LandmarkId& landmark_id : table->landmark_ids) {
+    const vi_map::Landmark& landmark = map.getLandmark(landmark_id);
+    const vi_map::Vertex& landmark_store_vertex =
+        map.getLandmarkStoreVertex(landmark_id);
+    const vi_map::MissionId& landmark_store_mission_id =
+        landmark_store_vertex.getMissionId();
+    table->landmarks.emplace_back(&landmark);
+    table->landmark_store_vertex_idx.emplace_back(
+        get_vertex_idx(landmark_store_vertex));
+    table->landmark_observations_begin.emplace_back(
+        table->observer_vertex_idx.size());
+
+    landmark.forEachObservation(
+        [&](const vi_map::KeypointIdentifier& keypoint_id) {
+          const vi_map::Vertex& observer_vertex =
+              map.getVertex(keypoint_id.frame_id.vertex_id);
+
+          const int frame_idx = keypoint_id.frame_id.frame_index;
+          CHECK(observer_vertex.isVisualFrameSet(frame_idx));
+          CHECK(observer_vertex.isVisualFrameValid(frame_idx));
+
+          const aslam::VisualFrame& visual_frame =
+              observer_vertex.getVisualFrame(frame_idx);
+          CHECK_LT(
+              keypoint_id.keypoint_index,
+              visual_frame.getNumKeypointMeasurements());
+
+          aslam::Camera::ConstPtr camera = observer_vertex.getCamera(frame_idx);
+          CHECK(camera);
+          const auto inserted =
+              camera_id_to_idx.emplace(camera->getId(), table->cameras.size());
+          if (inserted.second) {
+            table->cameras.emplace_back(camera);
+            table->cameras_T_C_B_in_map.emplace_back(
+                map.getSensorManager()
+                    .getNCameraForMission(observer_vertex.getMissionId())
+                    .get_T_C_B(frame_idx));
+          }
+
+          table->keypoint_measurements.col(table->observer_vertex_idx.size()) =
+              visual_frame.getKeypointMeasurement(keypoint_id.keypoint_index);
+          table->observer_vertex_idx.emplace_back(
+              get_vertex_idx(observer_vertex));
+          table->observer_camera_idx.emplace_back(inserted.first->second);
+          table->observer_is_in_store_mission.push_back(
+              observer_vertex.getMissionId() == landmark_store_mission_id);
+        });
+  }
+  CHECK_EQ(table->observer_vertex_idx.size(), num_observations);
+  table->landmark_observations_begin.emplace_back(num_observations);
+
+  VLOG(1) << "Outlier rejection table with " << num_landmarks
+          << " landmarks, " << num_observations
+          << " observations, " << table->vertex_ids.size() << " vertices and "
+          << table->cameras.size() << " cameras.";
+}
+
+// Fetches the current vertex poses and camera extrinsics from the state
+// buffer. States that are not part of the optimization are taken from the map.
+void getCurrentPosesOfTable(
+    const vi_map::VIMap& map, const OptimizationStateBuffer& state_buffer,
+    const ObservationTable& table, aslam::TransformationVector* T_I_G,
+    aslam::TransformationVector* T_C_I) {
+  CHECK_NOTNULL(T_I_G);
+  CHECK_NOTNULL(T_C_I);
+
+  std::unordered_map<vi_map::MissionBaseFrameId, aslam::Transformation>
+      baseframe_T_G_M;
+  const size_t num_vertices = table.vertex_ids.size();
+  T_I_G->resize(num_vertices);
+  for (size_t i = 0u; i < num_vertices; ++i) {
+    const vi_map::MissionBaseFrameId& baseframe_id =
+        table.vertex_baseframe_ids[i];
+    auto it = baseframe_T_G_M.find(baseframe_id);
+    if (it == baseframe_T_G_M.end()) {
+      aslam::Transformation T_G_M;
+      if (!state_buffer.get_T_G_M(baseframe_id, &T_G_M)) {
+        T_G_M = map.getMissionBaseFrame(baseframe_id).get_T_G_M();
+      }
+      it = baseframe_T_G_M.emplace(baseframe_id, T_G_M).first;
+    }
+
+    aslam::Transformation T_M_I;
+    if (!state_buffer.get_T_M_I(table.vertex_ids[i], &T_M_I)) {
+      T_M_I = map.getVertex(table.vertex_ids[i]).get_T_M_I();
+    }
+    (*T_I_G)[i] = (it->second * T_M_I).inverse();
+  }
+
+  const size_t num_cameras = table.cameras.size();
+  T_C_I->resize(num_cameras);
+  for (size_t i = 0u; i < num_cameras; ++i) {
+    if (!state_buffer.get_T_C_I(table.cameras[i]->getId(), &(*T_C_I)[i])) {
+      (*T_C_I)[i] = table.cameras_T_C_B_in_map[i];
+    }
+  }
+}
+
 double computeSquaredReprojectionError(
-    const vi_map::Vertex& vertex, const int frame_idx, const int keypoint_idx,
+    const aslam::Camera& camera, const Eigen::Vector2d& keypoint_measurement,
     const Eigen::Vector3d& landmark_p_C) {
   Eigen::Vector2d reprojected_point;
   aslam::ProjectionResult projection_result =
-      vertex.getCamera(frame_idx)->project3(landmark_p_C, &reprojected_point);
+      camera.project3(landmark_p_C, &reprojected_point);
 
   if (projection_result == aslam::ProjectionResult::KEYPOINT_VISIBLE ||
       projection_result ==
           aslam::ProjectionResult::KEYPOINT_OUTSIDE_IMAGE_BOX) {
-    return (reprojected_point -
-            vertex.getVisualFrame(frame_idx).getKeypointMeasurement(
-                keypoint_idx))
-        .squaredNorm();
+    return (reprojected_point - keypoint_measurement).squaredNorm();
   }
   return std::numeric_limits<double>::max();
 }
 
+bool isOutlierLandmark(
+    const ObservationTable& table, const size_t landmark_idx,
+    const aslam::TransformationVector& T_I_G,
+    const aslam::TransformationVector& T_C_I, const bool use_reprojection_error,
+    const double same_mission_reproj_error_px_sq,
+    const double other_mission_reproj_error_px_sq) {
+  // The landmark position is optimized in place, hence is always current.
+  const Eigen::Vector3d p_G_fi =
+      T_I_G[table.landmark_store_vertex_idx[landmark_idx]].inverse() *
+      table.landmarks[landmark_idx]->get_p_B();
+
+  const size_t observations_end =
+      table.landmark_observations_begin[landmark_idx + 1u];
+  for (size_t i = table.landmark_observations_begin[landmark_idx];
+       i < observations_end; ++i) {
+    const size_t camera_idx = table.observer_camera_idx[i];
+    const Eigen::Vector3d p_C_fi =
+        T_C_I[camera_idx] * (T_I_G[table.observer_vertex_idx[i]] * p_G_fi);
+
+    if (p_C_fi[2] <= 0.0) {
+      return true;
+    }
+
+    if (use_reprojection_error) {
+      const double reprojection_error_sq = computeSquaredReprojectionError(
+          *table.cameras[camera_idx], table.keypoint_measurements.col(i),
+          p_C_fi);
+      if (table.observer_is_in_store_mission[i] &&
+          reprojection_error_sq > same_mission_reproj_error_px_sq) {
+        // The landmarks is in the same mission so we use the same
+        // mission reprojection error threshold.
+        return true;
+      } else if (reprojection_error_sq > other_mission_reproj_error_px_sq) {
+        // The other mission threshold applies to all observations, as it did
+        // before the outlier pass was parallelized.
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
 void findOutlierLandmarks(
-    const vi_map::VIMap& map, const vi_map::LandmarkIdSet& landmarks_in_problem,
-    const bool use_reprojection_error,
+    const vi_map::VIMap& map, const OptimizationStateBuffer& state_buffer,
+    const ObservationTable& table, const bool use_reprojection_error,
     const double same_mission_reprojection_error_px,
     const double other_mission_reprojection_error_px,
-    vi_map::LandmarkIdSet* outlier_landmarks) {
-  CHECK_NOTNULL(outlier_landmarks)->clear();
+    std::vector<size_t>* outlier_landmark_indices) {
+  CHECK_NOTNULL(outlier_landmark_indices)->clear();
 
   const double same_mission_reproj_error_px_sq =
       same_mission_reprojection_error_px * same_mission_reprojection_error_px;
   const double other_mission_reproj_error_px_sq =
       other_mission_reprojection_error_px * other_mission_reprojection_error_px;
 
-  for (const vi_map::LandmarkId& landmark_id : landmarks_in_problem) {
-    const vi_map::Landmark& landmark = map.getLandmark(landmark_id);
-
-    const vi_map::MissionId& landmark_store_mission_id =
-        map.getLandmarkStoreVertex(landmark_id).getMissionId();
-
-    landmark.forEachObservation(
-        [&](const vi_map::KeypointIdentifier& keypoint_id) {
-          const vi_map::Vertex& observer_vertex =
-              map.getVertex(keypoint_id.frame_id.vertex_id);
-
-          const int frame_idx = keypoint_id.frame_id.frame_index;
-          CHECK(observer_vertex.isVisualFrameSet(frame_idx));
-          CHECK(observer_vertex.isVisualFrameValid(frame_idx));
-
-          CHECK_LT(
-              keypoint_id.keypoint_index,
-              observer_vertex.getVisualFrame(frame_idx)
-                  .getNumKeypointMeasurements());
-
-          const Eigen::Vector3d p_C_fi =
-              map.getLandmark_p_C_fi(landmark_id, observer_vertex, frame_idx);
-
-          if (p_C_fi[2] <= 0.0) {
-            outlier_landmarks->emplace(landmark_id);
-            return;
-          }
-
-          if (use_reprojection_error) {
-            const double reprojection_error_sq =
-                computeSquaredReprojectionError(
-                    observer_vertex, frame_idx, keypoint_id.keypoint_index,
-                    p_C_fi);
-            if (observer_vertex.getMissionId() == landmark_store_mission_id &&
-                reprojection_error_sq > same_mission_reproj_error_px_sq) {
-              // The landmarks is in the same mission so we use the same
-              // mission reprojection error threshold.
-              outlier_landmarks->emplace(landmark_id);
-            } else if (
-                reprojection_error_sq > other_mission_reproj_error_px_sq) {
-              // The observation is coming from a different mission than the
-              // one where the landmark is stored.
-              outlier_landmarks->emplace(landmark_id);
-            }
-          }
-        });
-  }
+  timing::Timer timer_poses("BA: Outlier rejection - get poses");
+  aslam::TransformationVector T_I_G;
+  aslam::TransformationVector T_C_I;
+  getCurrentPosesOfTable(map, state_buffer, table, &T_I_G, &T_C_I);
+  timer_poses.Stop();
+
+  // Every thread collects its outliers locally; they are merged once the
+  // thread is done with its chunk of landmarks.
+  timing::Timer timer_evaluate("BA: Outlier rejection - evaluate");
+  std::mutex m_outlier_landmark_indices;
+  const auto evaluate_landmarks = [&](const std::vector<size_t>& range) {
+    MAPLAB_PROFILE_ZONE("BA: Outlier rejection - evaluate landmarks");
+    std::vector<size_t> thread_outlier_landmark_indices;
+    for (const size_t landmark_idx : range) {
+      if (table.landmark_is_active[landmark_idx] &&
+          isOutlierLandmark(
+              table, landmark_idx, T_I_G, T_C_I, use_reprojection_error,
+              same_mission_reproj_error_px_sq,
+              other_mission_reproj_error_px_sq)) {
+        thread_outlier_landmark_indices.emplace_back(landmark_idx);
+      }
+    }
+    std::lock_guard<std::mutex> lock(m_outlier_landmark_indices);
+    outlier_landmark_indices->insert(
+        outlier_landmark_indices->end(),
+        thread_outlier_landmark_indices.begin(),
+        thread_outlier_landmark_indices.end());
+  };
+  constexpr bool kAlwaysParallelize = false;
+  const size_t num_threads = common::getNumHardwareThreads();
+  common::ParallelProcess(
+      table.numLandmarks(), evaluate_landmarks, kAlwaysParallelize,
+      num_threads);
+  timer_evaluate.Stop();
 }
 
 ceres::TerminationType solveStep(
     const OutlierRejectionSolverOptions& rejection_options,
-    const ceres::Solver::Options& solver_options,
-    OptimizationProblem* optimization_problem,
+    const ceres::Solver::Options& solver_options, ceres::Problem* problem,
     OutlierRejectionCallback* callback) {
-  CHECK_NOTNULL(optimization_problem);
+  CHECK_NOTNULL(problem);
   CHECK_NOTNULL(callback);
 
-  ceres::Problem problem(ceres_error_terms::getDefaultProblemOptions());
-  ceres_error_terms::buildCeresProblemFromProblemInformation(
-      optimization_problem->getProblemInformationMutable(), &problem);
-
   ceres::Solver::Options local_options = solver_options;
   local_options.callbacks.push_back(callback);
   // Reusing the trust region size from the last iteration.
@@ -129,54 +320,63 @@ ceres::TerminationType solveStep(
   local_options.update_state_every_iteration = true;
 
   ceres::Solver::Summary summary;
-  ceres::Solve(local_options, &problem, &summary);
+  ceres::Solve(local_options, problem, &summary);
 
   return summary.termination_type;
 }
 
+// Removes the residual blocks of the outlier landmarks from the ceres problem
+// in place, such that it doesn't need to be rebuilt.
 void rejectOutliers(
     const OutlierRejectionSolverOptions& rejection_options,
-    OptimizationProblem* optimization_problem) {
+    OptimizationProblem* optimization_problem, ObservationTable* table,
+    ceres::Problem* problem) {
   CHECK_NOTNULL(optimization_problem);
+  CHECK_NOTNULL(table);
+  CHECK_NOTNULL(problem);
 
   vi_map::VIMap& map = *optimization_problem->getMapMutable();
+  std::unordered_multimap<vi_map::LandmarkId, ceres::CostFunction*>&
+      landmarks_in_problem =
+          optimization_problem->getProblemBookkeepingMutable()
+              ->landmarks_in_problem;
 
-  typedef std::unordered_multimap<vi_map::LandmarkId, ceres::CostFunction*>
-      ProblemLandmarksMap;
-  ProblemLandmarksMap& landmarks_in_problem =
-      optimization_problem->getProblemBookkeepingMutable()
-          ->landmarks_in_problem;
-
-  vi_map::LandmarkIdSet present_landmarks;
-  std::transform(
-      landmarks_in_problem.begin(), landmarks_in_problem.end(),
-      std::inserter(present_landmarks, present_landmarks.end()),
-      [](const ProblemLandmarksMap::value_type& key_elem) {
-        return key_elem.first;
-      });
-
-  vi_map::LandmarkIdSet outlier_landmarks;
+  std::vector<size_t> outlier_landmark_indices;
   findOutlierLandmarks(
-      map, present_landmarks,
+      map, *optimization_problem->getOptimizationStateBufferMutable(), *table,
       rejection_options.reject_landmarks_based_on_reprojection_errors,
       rejection_options.reprojection_error_same_mission_px,
       rejection_options.reprojection_error_other_mission_px,
-      &outlier_landmarks);
+      &outlier_landmark_indices);
 
-  for (const vi_map::LandmarkId& landmark_id : outlier_landmarks) {
+  timing::Timer timer_remove("BA: Outlier rejection - remove residuals");
+  ceres_error_terms::ProblemInformation* problem_information =
+      optimization_problem->getProblemInformationMutable();
+  for (const size_t landmark_idx : outlier_landmark_indices) {
+    const vi_map::LandmarkId& landmark_id = table->landmark_ids[landmark_idx];
     const auto range = landmarks_in_problem.equal_range(landmark_id);
-    // Deactivate all observation constraints of this landmark.
+    // Deactivate all observation constraints of this landmark and remove them
+    // from the ceres problem. The parameter blocks stay in the problem; ceres
+    // ignores blocks without residuals.
     for (auto it = range.first; it != range.second; ++it) {
-      optimization_problem->getProblemInformationMutable()
-          ->deactivateCostFunction(it->second);
+      const ceres_error_terms::ResidualInformation& residual_information =
+          common::getChecked(problem_information->residual_blocks, it->second);
+      if (residual_information.active_) {
+        problem->RemoveResidualBlock(
+            residual_information.latest_residual_block_id);
+      }
+      problem_information->deactivateCostFunction(it->second);
     }
     landmarks_in_problem.erase(landmark_id);
+    table->landmark_is_active[landmark_idx] = false;
     map.getLandmark(landmark_id).setQuality(vi_map::Landmark::Quality::kBad);
   }
+  timer_remove.Stop();
 
-  LOG_IF(INFO, !outlier_landmarks.empty())
-      << "Removed " << outlier_landmarks.size() << " outlier landmark(s) of "
-      << present_landmarks.size() << " present in the problem.";
+  LOG_IF(INFO, !outlier_landmark_indices.empty())
+      << "Removed " << outlier_landmark_indices.size()
+      << " outlier landmark(s) of " << table->numLandmarks()
+      << " present in the problem.";
 }
 }  // namespace
 
@@ -199,6 +399,7 @@ ceres::TerminationType solveWithOutlierRejection(
     const OutlierRejectionSolverOptions& rejection_options,
     OptimizationProblem* optimization_problem) {
   CHECK_NOTNULL(optimization_problem);
+  MAPLAB_PROFILE_ZONE("BA: Solve with outlier rejection");
 
   if (rejection_options.reject_outliers_every_n_iters == 0 ||
       solver_options.max_num_iterations == 0) {
@@ -214,21 +415,55 @@ ceres::TerminationType solveWithOutlierRejection(
 
   OutlierRejectionCallback callback(solver_options.initial_trust_region_radius);
 
+  // The problem is built once and kept across all rounds; outliers are
+  // removed from it in place. Fast removal makes removing a residual block
+  // independent of the problem size.
+  timing::Timer timer_build("BA: Build problem");
+  ceres::Problem::Options problem_options =
+      ceres_error_terms::getDefaultProblemOptions();
+  problem_options.enable_fast_removal = true;
+  ceres::Problem problem(problem_options);
+  {
+    MAPLAB_PROFILE_ZONE("BA: Build problem");
+    ceres_error_terms::buildCeresProblemFromProblemInformation(
+        optimization_problem->getProblemInformationMutable(), &problem);
+  }
+  timer_build.Stop();
+
+  timing::Timer timer_table("BA: Outlier rejection - build table");
+  ObservationTable table;
+  {
+    MAPLAB_PROFILE_ZONE("BA: Outlier rejection - build table");
+    vi_map::LandmarkIdSet present_landmarks;
+    for (const auto& landmark_id_and_cost_function :
+         optimization_problem->getProblemBookkeepingMutable()
+             ->landmarks_in_problem) {
+      present_landmarks.emplace(landmark_id_and_cost_function.first);
+    }
+    buildObservationTable(
+        *optimization_problem->getMapMutable(), present_landmarks, &table);
+  }
+  timer_table.Stop();
+
   ceres::TerminationType termination_type =
       ceres::TerminationType::NO_CONVERGENCE;
   for (int i = 0; i < num_outer_iters; ++i) {
     timing::Timer timer_solve("BA: Solve");
-    termination_type = solveStep(
-        rejection_options, solver_options, optimization_problem, &callback);
+    {
+      MAPLAB_PROFILE_ZONE("BA: Solve");
+      termination_type =
+          solveStep(rejection_options, solver_options, &problem, &callback);
+    }
     timer_solve.Stop();
 
-    timing::Timer timer_copy("BA: CopyDataToMap");
-    optimization_problem->getOptimizationStateBufferMutable()
-        ->copyAllStatesBackToMap(optimization_problem->getMapMutable());
-    timer_copy.Stop();
-
+    // The outliers are evaluated on the state buffer directly, so the states
+    // only need to be copied back to the map once at the end.
     timing::Timer timer_reject("BA: Outlier rejection");
-    rejectOutliers(rejection_options, optimization_problem);
+    {
+      MAPLAB_PROFILE_ZONE("BA: Outlier rejection");
+      rejectOutliers(
+          rejection_options, optimization_problem, &table, &problem);
+    }
     timer_reject.Stop();
 
     if (termination_type != ceres::TerminationType::NO_CONVERGENCE) {
@@ -236,6 +471,14 @@ ceres::TerminationType solveWithOutlierRejection(
     }
   }
 
+  timing::Timer timer_copy("BA: CopyDataToMap");
+  {
+    MAPLAB_PROFILE_ZONE("BA: CopyDataToMap");
+    optimization_problem->getOptimizationStateBufferMutable()
+        ->copyAllStatesBackToMap(optimization_problem->getMapMutable());
+  }
+  timer_copy.Stop();
+
   return termination_type;
 }
 
@@ -2,6 +2,7 @@
 
 #include <ceres-error-terms/problem-information.h>
 #include <ceres/ceres.h>
+#include <maplab-common/profiler.h>
 
 namespace map_optimization {
 
@@ -11,14 +12,23 @@ ceres::TerminationType solve(
   CHECK_NOTNULL(optimization_problem);
 
   ceres::Problem problem(ceres_error_terms::getDefaultProblemOptions());
-  ceres_error_terms::buildCeresProblemFromProblemInformation(
-      optimization_problem->getProblemInformationMutable(), &problem);
+  {
+    MAPLAB_PROFILE_ZONE("BA: Build problem");
+    ceres_error_terms::buildCeresProblemFromProblemInformation(
+        optimization_problem->getProblemInformationMutable(), &problem);
+  }
 
   ceres::Solver::Summary summary;
-  ceres::Solve(solver_options, &problem, &summary);
-
-  optimization_problem->getOptimizationStateBufferMutable()
-      ->copyAllStatesBackToMap(optimization_problem->getMapMutable());
+  {
+    MAPLAB_PROFILE_ZONE("BA: Solve");
+    ceres::Solve(solver_options, &problem, &summary);
+  }
+
+  {
+    MAPLAB_PROFILE_ZONE("BA: CopyDataToMap");
+    optimization_problem->getOptimizationStateBufferMutable()
+        ->copyAllStatesBackToMap(optimization_problem->getMapMutable());
+  }
 
   LOG(INFO) << summary.FullReport();
   return summary.termination_type;
@@ -10,6 +10,7 @@
 #include <map-optimization/solver.h>
 #include <map-optimization/vi-optimization-builder.h>
 #include <maplab-common/file-logger.h>
+#include <maplab-common/profiler.h>
 #include <maplab-common/progress-bar.h>
 #include <visualization/viwls-graph-plotter.h>
 
@@ -53,9 +54,14 @@ bool VIMapOptimizer::optimizeVisualInertial(
     LOG(WARNING) << "Nothing to optimize.";
     return false;
   }
+  MAPLAB_PROFILE_ZONE("BA: Optimize visual-inertial");
 
-  map_optimization::OptimizationProblem* optimization_problem =
-      map_optimization::constructViProblem(missions_to_optimize, options, map);
+  map_optimization::OptimizationProblem* optimization_problem;
+  {
+    MAPLAB_PROFILE_ZONE("BA: Construct problem");
+    optimization_problem = map_optimization::constructViProblem(
+        missions_to_optimize, options, map);
+  }
   CHECK_NOTNULL(optimization_problem);
 
   std::vector<std::shared_ptr<ceres::IterationCallback>> callbacks;
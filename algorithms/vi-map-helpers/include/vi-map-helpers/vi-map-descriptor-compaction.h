@@ -0,0 +1,54 @@
+#ifndef VI_MAP_HELPERS_VI_MAP_DESCRIPTOR_COMPACTION_H_
+#define VI_MAP_HELPERS_VI_MAP_DESCRIPTOR_COMPACTION_H_
+
+#include <cstddef>
+
+#include <vi-map/unique-id.h>
+
+namespace vi_map {
+class VIMap;
+}  // namespace vi_map
+
+namespace vi_map_helpers {
+
+struct DescriptorCompactionOptions {
+  enum class Mode {
+    // Discards the keypoints that are not associated with a landmark, together
+    // with their descriptors and all other keypoint channels. The landmarks
+    // and their observations are not changed.
+    kDiscardUnassociatedKeypoints,
+    // Additionally keeps at most max_observations_per_landmark observations
+    // of every landmark, namely the ones whose descriptors have the smallest
+    // summed Hamming distance to the other descriptors of the landmark, i.e.
+    // the medoid and its closest neighbors. The other observations are
+    // removed, so this should only be used on maps that are not optimized or
+    // retriangulated anymore, e.g. before building a localization map.
+    kKeepLandmarkRepresentatives
+  };
+
+  Mode mode = Mode::kDiscardUnassociatedKeypoints;
+  size_t max_observations_per_landmark = 3u;
+  // Unassociated keypoints with a valid track id are kept by default, as the
+  // track-based landmark initialization needs them. Discarding them as well
+  // saves more memory, but no new landmarks can be initialized from the
+  // tracks of the compacted frames afterwards.
+  bool discard_tracked_keypoints = false;
+  size_t num_threads = 1u;
+};
+
+struct DescriptorCompactionResult {
+  size_t num_removed_observations = 0u;
+  size_t num_discarded_keypoints = 0u;
+  size_t num_discarded_descriptor_bytes = 0u;
+};
+
+// Compacts the visual frames of the vertices of the given missions. The
+// keypoint indices of all landmark observations are updated accordingly.
+void compactDescriptors(
+    const DescriptorCompactionOptions& options,
+    const vi_map::MissionIdList& mission_ids, vi_map::VIMap* map,
+    DescriptorCompactionResult* result);
+
+}  // namespace vi_map_helpers
+
+#endif  // VI_MAP_HELPERS_VI_MAP_DESCRIPTOR_COMPACTION_H_
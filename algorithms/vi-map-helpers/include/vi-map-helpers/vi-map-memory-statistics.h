@@ -0,0 +1,93 @@
+#ifndef VI_MAP_HELPERS_VI_MAP_MEMORY_STATISTICS_H_
+#define VI_MAP_HELPERS_VI_MAP_MEMORY_STATISTICS_H_
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+
+#include <vi-map/unique-id.h>
+
+namespace vi_map {
+class VIMap;
+}  // namespace vi_map
+
+namespace vi_map_helpers {
+
+// Estimated memory of the parts of a map in bytes. The estimates cover the
+// objects and their heap allocations, but not the allocator overhead.
+struct VIMapMemoryBreakdown {
+  // Vertex objects, nframes and the landmark id list of every frame.
+  size_t vertices = 0u;
+  // Keypoint measurements and all other per-keypoint channels except the
+  // descriptors.
+  size_t keypoints = 0u;
+  size_t descriptors = 0u;
+  // Raw images that are kept in the visual frames.
+  size_t raw_images = 0u;
+  // Landmark objects including their observation and appearance lists.
+  size_t landmarks = 0u;
+  size_t landmark_covariances = 0u;
+  // Edge objects and the edge id sets of the vertices.
+  size_t edges = 0u;
+  // IMU measurements of the visual-inertial edges.
+  size_t imu_data = 0u;
+  size_t optional_sensor_data = 0u;
+
+  size_t total() const;
+  VIMapMemoryBreakdown& operator+=(const VIMapMemoryBreakdown& other);
+};
+
+// Memory that can most likely be freed without losing data used by the
+// mapping pipeline.
+struct VIMapMemoryWaste {
+  // Descriptors of keypoints that are not associated with a landmark.
+  size_t num_unassociated_keypoints = 0u;
+  size_t unassociated_descriptors = 0u;
+  // Per-keypoint channels that are allocated but hold the same value for all
+  // keypoints of a frame, e.g. unset scores or orientations.
+  size_t num_constant_keypoint_channels = 0u;
+  size_t constant_keypoint_channels = 0u;
+  // Raw images kept in the frames; usually these belong into the resources.
+  size_t num_raw_images = 0u;
+  size_t raw_images = 0u;
+  // Allocated landmark covariances.
+  size_t num_landmark_covariances = 0u;
+  size_t landmark_covariances = 0u;
+  // Reserved but unused capacity of the landmark observation and vertex
+  // landmark id lists.
+  size_t unused_list_capacity = 0u;
+
+  size_t total() const;
+  VIMapMemoryWaste& operator+=(const VIMapMemoryWaste& other);
+};
+
+struct VIMapMemoryStatistics {
+  std::unordered_map<vi_map::MissionId, VIMapMemoryBreakdown> missions;
+  // Sum over all missions.
+  VIMapMemoryBreakdown missions_total;
+
+  // Parts of the map that are not owned by a single mission.
+  size_t landmark_index = 0u;
+  size_t covisibility_graph = 0u;
+  size_t resource_cache = 0u;
+
+  VIMapMemoryWaste waste;
+
+  size_t total() const;
+  std::string toString() const;
+};
+
+// Walks over all vertices and edges of the map using num_threads threads.
+// The map must not be modified concurrently.
+void computeVIMapMemoryStatistics(
+    const vi_map::VIMap& map, const size_t num_threads,
+    VIMapMemoryStatistics* statistics);
+
+// Logs the memory statistics and adds the totals to the statistics module
+// under "VIMap memory: ..." such that they can be tracked over time.
+void logVIMapMemoryStatistics(
+    const vi_map::VIMap& map, const size_t num_threads);
+
+}  // namespace vi_map_helpers
+
+#endif  // VI_MAP_HELPERS_VI_MAP_MEMORY_STATISTICS_H_
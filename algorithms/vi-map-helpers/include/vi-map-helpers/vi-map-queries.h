@@ -31,7 +31,9 @@ pose_graph::VertexId getVertexIdWithMostOverlappingLandmarks(
     const vi_map::VIMap& map, vi_map::LandmarkIdSet* overlap_landmarks);
 
 // A collection of queries on a VIMap which involve more logic than simple
-// data retrieval.
+// data retrieval. The vertex covisibility queries use the covisibility graph
+// of the map, which is built on the first query, see
+// VIMap::getCovisibilityGraph().
 class VIMapQueries {
  public:
   explicit VIMapQueries(const vi_map::VIMap& map);
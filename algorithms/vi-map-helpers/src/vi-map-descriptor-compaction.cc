@@ -0,0 +1,259 @@
+#include "vi-map-helpers/vi-map-descriptor-compaction.h"
+
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <aslam/common/feature-descriptor-ref.h>
+#include <aslam/frames/visual-frame.h>
+#include <glog/logging.h>
+#include <maplab-common/parallel-process.h>
+#include <vi-map/vi-map.h>
+
+namespace vi_map_helpers {
+namespace {
+
+typedef std::vector<std::pair<vi_map::LandmarkId, vi_map::KeypointIdentifier>>
+    LandmarkObservationList;
+
+// New keypoint index for every old keypoint index of a frame, -1 if the
+// keypoint has been discarded. Empty if nothing has been discarded.
+typedef std::vector<int> KeypointIndexMap;
+
+// Appends the observations of the landmark that are not among the
+// max_observations observations with the smallest accumulated descriptor
+// distance to all other observations of the landmark.
+void getNonRepresentativeObservations(
+    const vi_map::Landmark& landmark, const vi_map::VIMap& map,
+    const size_t max_observations, LandmarkObservationList* observations) {
+  CHECK_NOTNULL(observations);
+  const vi_map::KeypointIdentifierList& landmark_observations =
+      landmark.getObservations();
+  const size_t num_observations = landmark_observations.size();
+  if (num_observations <= max_observations) {
+    return;
+  }
+
+  std::vector<aslam::common::FeatureDescriptorConstRef> descriptors;
+  descriptors.reserve(num_observations);
+  for (const vi_map::KeypointIdentifier& observation : landmark_observations) {
+    const aslam::VisualFrame& frame =
+        map.getVertex(observation.frame_id.vertex_id)
+            .getVisualFrame(observation.frame_id.frame_index);
+    CHECK_LT(
+        observation.keypoint_index,
+        static_cast<size_t>(frame.getDescriptors().cols()));
+    descriptors.emplace_back(
+        frame.getDescriptor(observation.keypoint_index),
+        frame.getDescriptorSizeBytes());
+  }
+
+  std::vector<size_t> accumulated_distances(num_observations, 0u);
+  for (size_t i = 0u; i < num_observations; ++i) {
+    for (size_t j = i + 1u; j < num_observations; ++j) {
+      const size_t distance =
+          aslam::common::GetNumBitsDifferent(descriptors[i], descriptors[j]);
+      accumulated_distances[i] += distance;
+      accumulated_distances[j] += distance;
+    }
+  }
+
+  std::vector<size_t> order(num_observations);
+  std::iota(order.begin(), order.end(), 0u);
+  std::stable_sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) {
+    return accumulated_distances[lhs] < accumulated_distances[rhs];
+  });
+  for (size_t i = max_observations; i < num_observations; ++i) {
+    observations->emplace_back(
+        landmark.id(), landmark_observations[order[i]]);
+  }
+}
+
+size_t removeNonRepresentativeObservations(
+    const size_t max_observations_per_landmark, const size_t num_threads,
+    const pose_graph::VertexIdList& vertex_ids, vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  CHECK_GT(max_observations_per_landmark, 0u);
+
+  // Selecting the representatives is the expensive part and only reads the
+  // map, removing the other observations is done sequentially afterwards.
+  std::vector<LandmarkObservationList> observations_to_remove(
+      vertex_ids.size());
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      vertex_ids.size(),
+      [&](const std::vector<size_t>& range) {
+        for (const size_t vertex_idx : range) {
+          const vi_map::Vertex& vertex =
+              map->getVertex(vertex_ids[vertex_idx]);
+          for (const vi_map::Landmark& landmark : vertex.getLandmarks()) {
+            getNonRepresentativeObservations(
+                landmark, *map, max_observations_per_landmark,
+                &observations_to_remove[vertex_idx]);
+          }
+        }
+      },
+      kAlwaysParallelize, num_threads);
+
+  vi_map::LandmarkId invalid_landmark_id;
+  invalid_landmark_id.setInvalid();
+  size_t num_removed_observations = 0u;
+  for (const LandmarkObservationList& observations : observations_to_remove) {
+    for (const LandmarkObservationList::value_type& landmark_observation :
+         observations) {
+      const vi_map::KeypointIdentifier& observation =
+          landmark_observation.second;
+      map->getLandmark(landmark_observation.first)
+          .removeObservation(observation);
+      map->getVertex(observation.frame_id.vertex_id)
+          .setObservedLandmarkId(observation, invalid_landmark_id);
+    }
+    num_removed_observations += observations.size();
+  }
+  if (num_removed_observations > 0u) {
+    map->dropCovisibilityGraph();
+  }
+  return num_removed_observations;
+}
+
+}  // namespace
+
+void compactDescriptors(
+    const DescriptorCompactionOptions& options,
+    const vi_map::MissionIdList& mission_ids, vi_map::VIMap* map,
+    DescriptorCompactionResult* result) {
+  CHECK_NOTNULL(map);
+  CHECK_NOTNULL(result);
+  CHECK_GT(options.num_threads, 0u);
+  *result = DescriptorCompactionResult();
+
+  pose_graph::VertexIdList vertex_ids;
+  for (const vi_map::MissionId& mission_id : mission_ids) {
+    pose_graph::VertexIdList mission_vertex_ids;
+    map->getAllVertexIdsInMission(mission_id, &mission_vertex_ids);
+    vertex_ids.insert(
+        vertex_ids.end(), mission_vertex_ids.begin(),
+        mission_vertex_ids.end());
+  }
+
+  if (options.mode ==
+      DescriptorCompactionOptions::Mode::kKeepLandmarkRepresentatives) {
+    result->num_removed_observations = removeNonRepresentativeObservations(
+        options.max_observations_per_landmark, options.num_threads,
+        vertex_ids, map);
+  }
+
+  // Discard the unassociated keypoints of every frame and remember how the
+  // keypoint indices changed.
+  std::unordered_map<pose_graph::VertexId, size_t> vertex_id_to_index;
+  vertex_id_to_index.reserve(vertex_ids.size());
+  for (size_t vertex_idx = 0u; vertex_idx < vertex_ids.size(); ++vertex_idx) {
+    vertex_id_to_index.emplace(vertex_ids[vertex_idx], vertex_idx);
+  }
+  std::vector<std::vector<KeypointIndexMap>> keypoint_index_maps(
+      vertex_ids.size());
+  std::vector<size_t> num_discarded_keypoints(vertex_ids.size(), 0u);
+  std::vector<size_t> num_discarded_descriptor_bytes(vertex_ids.size(), 0u);
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      vertex_ids.size(),
+      [&](const std::vector<size_t>& range) {
+        for (const size_t vertex_idx : range) {
+          vi_map::Vertex& vertex = map->getVertex(vertex_ids[vertex_idx]);
+          const size_t num_frames = vertex.numFrames();
+          std::vector<KeypointIndexMap>& frame_index_maps =
+              keypoint_index_maps[vertex_idx];
+          frame_index_maps.resize(num_frames);
+          for (size_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
+            if (!vertex.isVisualFrameSet(frame_idx)) {
+              continue;
+            }
+            const vi_map::LandmarkIdList& landmark_ids =
+                vertex.getFrameObservedLandmarkIds(frame_idx);
+            const aslam::VisualFrame& frame = vertex.getVisualFrame(frame_idx);
+            const bool keep_tracked_keypoints =
+                !options.discard_tracked_keypoints && frame.hasTrackIds();
+            std::vector<size_t> discarded_indices;
+            KeypointIndexMap index_map(landmark_ids.size(), -1);
+            int num_kept_keypoints = 0;
+            for (size_t keypoint_idx = 0u; keypoint_idx < landmark_ids.size();
+                 ++keypoint_idx) {
+              if (landmark_ids[keypoint_idx].isValid() ||
+                  (keep_tracked_keypoints &&
+                   frame.getTrackId(keypoint_idx) >= 0)) {
+                index_map[keypoint_idx] = num_kept_keypoints++;
+              } else {
+                discarded_indices.emplace_back(keypoint_idx);
+              }
+            }
+            if (discarded_indices.empty()) {
+              continue;
+            }
+
+            if (frame.hasDescriptors()) {
+              num_discarded_descriptor_bytes[vertex_idx] +=
+                  discarded_indices.size() * frame.getDescriptorSizeBytes();
+            }
+            num_discarded_keypoints[vertex_idx] += discarded_indices.size();
+            vertex.discardKeypoints(frame_idx, discarded_indices);
+            frame_index_maps[frame_idx].swap(index_map);
+          }
+        }
+      },
+      kAlwaysParallelize, options.num_threads);
+  for (size_t vertex_idx = 0u; vertex_idx < vertex_ids.size(); ++vertex_idx) {
+    result->num_discarded_keypoints += num_discarded_keypoints[vertex_idx];
+    result->num_discarded_descriptor_bytes +=
+        num_discarded_descriptor_bytes[vertex_idx];
+  }
+  if (result->num_discarded_keypoints == 0u) {
+    return;
+  }
+
+  // Landmarks of any mission can be observed from the compacted frames, so
+  // the observations of all landmarks are updated. Every landmark is only
+  // modified by the thread processing its storing vertex.
+  pose_graph::VertexIdList all_vertex_ids;
+  map->getAllVertexIds(&all_vertex_ids);
+  common::ParallelProcess(
+      all_vertex_ids.size(),
+      [&](const std::vector<size_t>& range) {
+        for (const size_t vertex_idx : range) {
+          vi_map::Vertex& vertex = map->getVertex(all_vertex_ids[vertex_idx]);
+          for (vi_map::Landmark& landmark : vertex.getLandmarks()) {
+            const vi_map::KeypointIdentifierList& observations =
+                landmark.getObservations();
+            for (size_t observation_idx = 0u;
+                 observation_idx < observations.size(); ++observation_idx) {
+              const vi_map::KeypointIdentifier& observation =
+                  observations[observation_idx];
+              const std::unordered_map<pose_graph::VertexId, size_t>::
+                  const_iterator it =
+                      vertex_id_to_index.find(observation.frame_id.vertex_id);
+              if (it == vertex_id_to_index.end()) {
+                continue;
+              }
+              const KeypointIndexMap& index_map =
+                  keypoint_index_maps[it->second]
+                                     [observation.frame_id.frame_index];
+              if (index_map.empty()) {
+                continue;
+              }
+              CHECK_LT(observation.keypoint_index, index_map.size());
+              const int new_keypoint_index =
+                  index_map[observation.keypoint_index];
+              CHECK_GE(new_keypoint_index, 0)
+                  << "Landmark " << landmark.id() << " observes a keypoint "
+                  << "that is not associated with it.";
+              landmark.setObservationKeypointIndex(
+                  observation_idx, new_keypoint_index);
+            }
+          }
+        }
+      },
+      kAlwaysParallelize, options.num_threads);
+}
+
+}  // namespace vi_map_helpers
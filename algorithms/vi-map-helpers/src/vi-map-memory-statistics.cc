@@ -0,0 +1,453 @@
+#include "vi-map-helpers/vi-map-memory-statistics.h"
+
+#include <iomanip>
+#include <mutex>
+#include <sstream>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include <aslam/common/statistics/statistics.h>
+#include <aslam/frames/visual-frame.h>
+#include <aslam/frames/visual-nframe.h>
+#include <glog/logging.h>
+#include <maplab-common/parallel-process.h>
+#include <opencv2/core/core.hpp>
+#include <vi-map/cklam-edge.h>
+#include <vi-map/laser-edge.h>
+#include <vi-map/loopclosure-edge.h>
+#include <vi-map/optional-sensor-data.h>
+#include <vi-map/structure-loopclosure-edge.h>
+#include <vi-map/trajectory-edge.h>
+#include <vi-map/transformation-edge.h>
+#include <vi-map/vi-map.h>
+#include <vi-map/viwls-edge.h>
+
+namespace vi_map_helpers {
+namespace {
+// Rough per-node overheads of the standard containers on top of the stored
+// value: a next pointer and the cached hash for hash maps, three pointers and
+// the color for ordered maps.
+constexpr size_t kHashNodeOverhead = 2u * sizeof(void*);
+constexpr size_t kTreeNodeOverhead = 4u * sizeof(void*);
+
+template <typename ValueType>
+size_t getHashMapEntryBytes() {
+  // Assumes a load factor of one, i.e. one bucket pointer per entry.
+  return sizeof(ValueType) + kHashNodeOverhead + sizeof(void*);
+}
+
+double bytesToMegabytes(const size_t num_bytes) {
+  return static_cast<double>(num_bytes) / (1024.0 * 1024.0);
+}
+
+std::string formatBytes(const size_t num_bytes) {
+  std::ostringstream oss;
+  oss << std::fixed << std::setprecision(2) << bytesToMegabytes(num_bytes)
+      << " MB";
+  return oss.str();
+}
+
+// Per-keypoint channel stored as an Eigen vector.
+template <typename ChannelType>
+void addKeypointChannel(
+    const ChannelType& channel, vi_map_helpers::VIMapMemoryBreakdown* breakdown,
+    vi_map_helpers::VIMapMemoryWaste* waste) {
+  CHECK_NOTNULL(breakdown);
+  CHECK_NOTNULL(waste);
+  const size_t num_bytes =
+      channel.size() * sizeof(typename ChannelType::Scalar);
+  breakdown->keypoints += num_bytes;
+  if (channel.size() > 1 && (channel.array() == channel(0)).all()) {
+    ++waste->num_constant_keypoint_channels;
+    waste->constant_keypoint_channels += num_bytes;
+  }
+}
+
+void addVisualFrame(
+    const aslam::VisualFrame& frame, const vi_map::LandmarkIdList& landmark_ids,
+    VIMapMemoryBreakdown* breakdown, VIMapMemoryWaste* waste) {
+  CHECK_NOTNULL(breakdown);
+  CHECK_NOTNULL(waste);
+  breakdown->vertices += sizeof(aslam::VisualFrame);
+
+  if (frame.hasKeypointMeasurements()) {
+    breakdown->keypoints +=
+        frame.getKeypointMeasurements().size() * sizeof(double);
+  }
+  if (frame.hasKeypointMeasurementUncertainties()) {
+    addKeypointChannel(
+        frame.getKeypointMeasurementUncertainties(), breakdown, waste);
+  }
+  if (frame.hasKeypointOrientations()) {
+    addKeypointChannel(frame.getKeypointOrientations(), breakdown, waste);
+  }
+  if (frame.hasKeypointScales()) {
+    addKeypointChannel(frame.getKeypointScales(), breakdown, waste);
+  }
+  if (frame.hasKeypointScores()) {
+    addKeypointChannel(frame.getKeypointScores(), breakdown, waste);
+  }
+  if (frame.hasTrackIds()) {
+    addKeypointChannel(frame.getTrackIds(), breakdown, waste);
+  }
+
+  if (frame.hasDescriptors()) {
+    const aslam::VisualFrame::DescriptorsT& descriptors =
+        frame.getDescriptors();
+    breakdown->descriptors += descriptors.size();
+    const size_t num_keypoints = static_cast<size_t>(descriptors.cols());
+    for (size_t keypoint_idx = 0u; keypoint_idx < num_keypoints;
+         ++keypoint_idx) {
+      if (keypoint_idx >= landmark_ids.size() ||
+          !landmark_ids[keypoint_idx].isValid()) {
+        ++waste->num_unassociated_keypoints;
+        waste->unassociated_descriptors += descriptors.rows();
+      }
+    }
+  }
+
+  if (frame.hasRawImage()) {
+    const cv::Mat& image = frame.getRawImage();
+    const size_t num_bytes = image.total() * image.elemSize();
+    breakdown->raw_images += num_bytes;
+    ++waste->num_raw_images;
+    waste->raw_images += num_bytes;
+  }
+}
+
+void addLandmark(
+    const vi_map::Landmark& landmark, VIMapMemoryBreakdown* breakdown,
+    VIMapMemoryWaste* waste) {
+  CHECK_NOTNULL(breakdown);
+  CHECK_NOTNULL(waste);
+  // The landmark store keeps the landmarks in a vector and an id to index
+  // map.
+  breakdown->landmarks +=
+      sizeof(vi_map::Landmark) +
+      getHashMapEntryBytes<std::pair<const vi_map::LandmarkId, int>>();
+
+  const vi_map::KeypointIdentifierList& observations =
+      landmark.getObservations();
+  breakdown->landmarks +=
+      observations.capacity() * sizeof(vi_map::KeypointIdentifier);
+  waste->unused_list_capacity +=
+      (observations.capacity() - observations.size()) *
+      sizeof(vi_map::KeypointIdentifier);
+  if (landmark.areAppearancesAllocated()) {
+    breakdown->landmarks += landmark.getAppearances().capacity() * sizeof(int);
+  }
+
+  Eigen::Matrix3d covariance;
+  if (landmark.get_p_B_Covariance(&covariance)) {
+    breakdown->landmark_covariances += sizeof(Eigen::Matrix3d);
+    ++waste->num_landmark_covariances;
+    waste->landmark_covariances += sizeof(Eigen::Matrix3d);
+  }
+}
+
+void addVertex(
+    const vi_map::Vertex& vertex, VIMapMemoryBreakdown* breakdown,
+    VIMapMemoryWaste* waste) {
+  CHECK_NOTNULL(breakdown);
+  CHECK_NOTNULL(waste);
+  // The pose graph stores the vertices in a hash map of pointers.
+  breakdown->vertices +=
+      sizeof(vi_map::Vertex) + sizeof(aslam::VisualNFrame) +
+      getHashMapEntryBytes<std::pair<const pose_graph::VertexId, void*>>();
+
+  const size_t num_frames = vertex.numFrames();
+  breakdown->vertices += num_frames * sizeof(aslam::VisualFrame::Ptr);
+  for (size_t frame_idx = 0u; frame_idx < num_frames; ++frame_idx) {
+    const vi_map::LandmarkIdList& landmark_ids =
+        vertex.getFrameObservedLandmarkIds(frame_idx);
+    breakdown->vertices +=
+        sizeof(landmark_ids) +
+        landmark_ids.capacity() * sizeof(vi_map::LandmarkId);
+    waste->unused_list_capacity +=
+        (landmark_ids.capacity() - landmark_ids.size()) *
+        sizeof(vi_map::LandmarkId);
+
+    if (vertex.isVisualFrameSet(frame_idx)) {
+      addVisualFrame(
+          vertex.getVisualFrame(frame_idx), landmark_ids, breakdown, waste);
+    }
+  }
+
+  for (const vi_map::Landmark& landmark : vertex.getLandmarks()) {
+    addLandmark(landmark, breakdown, waste);
+  }
+}
+
+size_t getEdgeObjectBytes(const pose_graph::Edge::EdgeType edge_type) {
+  switch (edge_type) {
+    case pose_graph::Edge::EdgeType::kViwls:
+      return sizeof(vi_map::ViwlsEdge);
+    case pose_graph::Edge::EdgeType::kOdometry:
+    case pose_graph::Edge::EdgeType::k6DoFGps:
+      return sizeof(vi_map::TransformationEdge);
+    case pose_graph::Edge::EdgeType::kLoopClosure:
+      return sizeof(vi_map::LoopClosureEdge);
+    case pose_graph::Edge::EdgeType::kStructureLoopClosure:
+      return sizeof(vi_map::StructureLoopclosureEdge);
+    case pose_graph::Edge::EdgeType::kLaser:
+      return sizeof(vi_map::LaserEdge);
+    case pose_graph::Edge::EdgeType::kTrajectory:
+      return sizeof(vi_map::TrajectoryEdge);
+    case pose_graph::Edge::EdgeType::kCklamImuLandmark:
+      return sizeof(vi_map::CklamEdge);
+    default:
+      return sizeof(vi_map::Edge);
+  }
+}
+
+void addEdge(const vi_map::Edge& edge, VIMapMemoryBreakdown* breakdown) {
+  CHECK_NOTNULL(breakdown);
+  // The edge is referenced from the pose graph and from the edge id sets of
+  // both of its vertices.
+  breakdown->edges +=
+      getEdgeObjectBytes(edge.getType()) +
+      getHashMapEntryBytes<std::pair<const pose_graph::EdgeId, void*>>() +
+      2u * (sizeof(pose_graph::EdgeId) + kTreeNodeOverhead);
+
+  if (edge.getType() == pose_graph::Edge::EdgeType::kViwls) {
+    const vi_map::ViwlsEdge& viwls_edge = edge.getAs<vi_map::ViwlsEdge>();
+    breakdown->imu_data +=
+        viwls_edge.getImuTimestamps().size() * sizeof(int64_t) +
+        viwls_edge.getImuData().size() * sizeof(double);
+  }
+}
+
+template <typename MeasurementType>
+size_t getMeasurementBufferBytes(
+    const vi_map::OptionalSensorData& optional_sensor_data,
+    const vi_map::SensorId& sensor_id) {
+  if (!optional_sensor_data.hasMeasurements<MeasurementType>(sensor_id)) {
+    return 0u;
+  }
+  return optional_sensor_data.getMeasurements<MeasurementType>(sensor_id)
+             .size() *
+         (sizeof(std::pair<const int64_t, MeasurementType>) +
+          kTreeNodeOverhead);
+}
+
+size_t getOptionalSensorDataBytes(
+    const vi_map::OptionalSensorData& optional_sensor_data) {
+  size_t num_bytes = sizeof(vi_map::OptionalSensorData);
+  vi_map::SensorIdSet sensor_ids;
+  optional_sensor_data.getAllSensorIds(&sensor_ids);
+  for (const vi_map::SensorId& sensor_id : sensor_ids) {
+    num_bytes += getMeasurementBufferBytes<vi_map::GpsUtmMeasurement>(
+        optional_sensor_data, sensor_id);
+    num_bytes += getMeasurementBufferBytes<vi_map::GpsWgsMeasurement>(
+        optional_sensor_data, sensor_id);
+  }
+  return num_bytes;
+}
+
+typedef std::unordered_map<vi_map::MissionId, VIMapMemoryBreakdown>
+    MissionBreakdownMap;
+
+void mergeMissionBreakdowns(
+    const MissionBreakdownMap& source, MissionBreakdownMap* destination) {
+  CHECK_NOTNULL(destination);
+  for (const MissionBreakdownMap::value_type& mission_and_breakdown : source) {
+    (*destination)[mission_and_breakdown.first] +=
+        mission_and_breakdown.second;
+  }
+}
+
+void printBreakdown(
+    const VIMapMemoryBreakdown& breakdown, const std::string& indent,
+    std::ostringstream* oss) {
+  CHECK_NOTNULL(oss);
+  const std::vector<std::pair<std::string, size_t>> components = {
+      {"vertices", breakdown.vertices},
+      {"keypoints", breakdown.keypoints},
+      {"descriptors", breakdown.descriptors},
+      {"raw images", breakdown.raw_images},
+      {"landmarks", breakdown.landmarks},
+      {"landmark covariances", breakdown.landmark_covariances},
+      {"edges", breakdown.edges},
+      {"IMU data", breakdown.imu_data},
+      {"optional sensor data", breakdown.optional_sensor_data}};
+  for (const std::pair<std::string, size_t>& component : components) {
+    *oss << indent << std::left << std::setw(24) << (component.first + ":")
+         << std::right << std::setw(14) << formatBytes(component.second)
+         << std::endl;
+  }
+}
+}  // namespace
+
+size_t VIMapMemoryBreakdown::total() const {
+  return vertices + keypoints + descriptors + raw_images + landmarks +
+         landmark_covariances + edges + imu_data + optional_sensor_data;
+}
+
+VIMapMemoryBreakdown& VIMapMemoryBreakdown::operator+=(
+    const VIMapMemoryBreakdown& other) {
+  vertices += other.vertices;
+  keypoints += other.keypoints;
+  descriptors += other.descriptors;
+  raw_images += other.raw_images;
+  landmarks += other.landmarks;
+  landmark_covariances += other.landmark_covariances;
+  edges += other.edges;
+  imu_data += other.imu_data;
+  optional_sensor_data += other.optional_sensor_data;
+  return *this;
+}
+
+size_t VIMapMemoryWaste::total() const {
+  return unassociated_descriptors + constant_keypoint_channels + raw_images +
+         landmark_covariances + unused_list_capacity;
+}
+
+VIMapMemoryWaste& VIMapMemoryWaste::operator+=(const VIMapMemoryWaste& other) {
+  num_unassociated_keypoints += other.num_unassociated_keypoints;
+  unassociated_descriptors += other.unassociated_descriptors;
+  num_constant_keypoint_channels += other.num_constant_keypoint_channels;
+  constant_keypoint_channels += other.constant_keypoint_channels;
+  num_raw_images += other.num_raw_images;
+  raw_images += other.raw_images;
+  num_landmark_covariances += other.num_landmark_covariances;
+  landmark_covariances += other.landmark_covariances;
+  unused_list_capacity += other.unused_list_capacity;
+  return *this;
+}
+
+size_t VIMapMemoryStatistics::total() const {
+  return missions_total.total() + landmark_index + covisibility_graph +
+         resource_cache;
+}
+
+std::string VIMapMemoryStatistics::toString() const {
+  std::ostringstream oss;
+  oss << "VIMap memory (estimated): " << formatBytes(total()) << std::endl;
+  printBreakdown(missions_total, "  ", &oss);
+  oss << "  " << std::left << std::setw(24) << "landmark index:" << std::right
+      << std::setw(14) << formatBytes(landmark_index) << std::endl;
+  oss << "  " << std::left << std::setw(24) << "covisibility graph:"
+      << std::right << std::setw(14) << formatBytes(covisibility_graph)
+      << std::endl;
+  oss << "  " << std::left << std::setw(24) << "resource cache:" << std::right
+      << std::setw(14) << formatBytes(resource_cache) << std::endl;
+
+  if (missions.size() > 1u) {
+    for (const MissionBreakdownMap::value_type& mission_and_breakdown :
+         missions) {
+      oss << "Mission " << mission_and_breakdown.first << ": "
+          << formatBytes(mission_and_breakdown.second.total()) << std::endl;
+      printBreakdown(mission_and_breakdown.second, "  ", &oss);
+    }
+  }
+
+  oss << "Potentially wasted memory: " << formatBytes(waste.total())
+      << std::endl;
+  oss << "  descriptors of " << waste.num_unassociated_keypoints
+      << " keypoints without landmark: "
+      << formatBytes(waste.unassociated_descriptors) << std::endl;
+  oss << "  " << waste.num_constant_keypoint_channels
+      << " constant keypoint channels: "
+      << formatBytes(waste.constant_keypoint_channels) << std::endl;
+  oss << "  " << waste.num_raw_images
+      << " raw images kept in frames: " << formatBytes(waste.raw_images)
+      << std::endl;
+  oss << "  " << waste.num_landmark_covariances
+      << " landmark covariances: " << formatBytes(waste.landmark_covariances)
+      << std::endl;
+  oss << "  unused list capacity: " << formatBytes(waste.unused_list_capacity)
+      << std::endl;
+  return oss.str();
+}
+
+void computeVIMapMemoryStatistics(
+    const vi_map::VIMap& map, const size_t num_threads,
+    VIMapMemoryStatistics* statistics) {
+  CHECK_GT(num_threads, 0u);
+  CHECK_NOTNULL(statistics);
+  *statistics = VIMapMemoryStatistics();
+
+  // Every thread accumulates into its own breakdowns, which are merged once
+  // the thread is done with its chunk.
+  std::mutex m_statistics;
+  constexpr bool kAlwaysParallelize = false;
+
+  pose_graph::VertexIdList vertex_ids;
+  map.getAllVertexIds(&vertex_ids);
+  common::ParallelProcess(
+      vertex_ids.size(),
+      [&](const std::vector<size_t>& range) {
+        MissionBreakdownMap thread_missions;
+        VIMapMemoryWaste thread_waste;
+        for (const size_t vertex_idx : range) {
+          const vi_map::Vertex& vertex = map.getVertex(vertex_ids[vertex_idx]);
+          addVertex(
+              vertex, &thread_missions[vertex.getMissionId()], &thread_waste);
+        }
+        std::lock_guard<std::mutex> lock(m_statistics);
+        mergeMissionBreakdowns(thread_missions, &statistics->missions);
+        statistics->waste += thread_waste;
+      },
+      kAlwaysParallelize, num_threads);
+
+  pose_graph::EdgeIdList edge_ids;
+  map.getAllEdgeIds(&edge_ids);
+  common::ParallelProcess(
+      edge_ids.size(),
+      [&](const std::vector<size_t>& range) {
+        MissionBreakdownMap thread_missions;
+        for (const size_t edge_idx : range) {
+          const vi_map::Edge& edge =
+              map.getEdgeAs<vi_map::Edge>(edge_ids[edge_idx]);
+          addEdge(
+              edge,
+              &thread_missions[map.getMissionIdForVertex(edge.from())]);
+        }
+        std::lock_guard<std::mutex> lock(m_statistics);
+        mergeMissionBreakdowns(thread_missions, &statistics->missions);
+      },
+      kAlwaysParallelize, num_threads);
+
+  vi_map::MissionIdList mission_ids;
+  map.getAllMissionIds(&mission_ids);
+  for (const vi_map::MissionId& mission_id : mission_ids) {
+    VIMapMemoryBreakdown& breakdown = statistics->missions[mission_id];
+    if (map.hasOptionalSensorData(mission_id)) {
+      breakdown.optional_sensor_data +=
+          getOptionalSensorDataBytes(map.getOptionalSensorData(mission_id));
+    }
+    statistics->missions_total += breakdown;
+  }
+
+  statistics->landmark_index =
+      map.numLandmarksInIndex() *
+      getHashMapEntryBytes<
+          std::pair<const vi_map::LandmarkId, pose_graph::VertexId>>();
+  // Only counted if it exists, the statistics should not build it.
+  if (map.hasCovisibilityGraph()) {
+    statistics->covisibility_graph =
+        map.getCovisibilityGraph()->getMemoryUsageBytes();
+  }
+  statistics->resource_cache = map.getResourceCacheMemoryUsageBytes();
+}
+
+void logVIMapMemoryStatistics(
+    const vi_map::VIMap& map, const size_t num_threads) {
+  VIMapMemoryStatistics memory_statistics;
+  computeVIMapMemoryStatistics(map, num_threads, &memory_statistics);
+  LOG(INFO) << memory_statistics.toString();
+
+  statistics::StatsCollector stats_total("VIMap memory: total [MB]");
+  stats_total.AddSample(bytesToMegabytes(memory_statistics.total()));
+  statistics::StatsCollector stats_descriptors(
+      "VIMap memory: descriptors [MB]");
+  stats_descriptors.AddSample(
+      bytesToMegabytes(memory_statistics.missions_total.descriptors));
+  statistics::StatsCollector stats_landmarks("VIMap memory: landmarks [MB]");
+  stats_landmarks.AddSample(
+      bytesToMegabytes(memory_statistics.missions_total.landmarks));
+  statistics::StatsCollector stats_waste("VIMap memory: waste [MB]");
+  stats_waste.AddSample(bytesToMegabytes(memory_statistics.waste.total()));
+}
+
+}  // namespace vi_map_helpers
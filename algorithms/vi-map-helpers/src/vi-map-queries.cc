@@ -378,29 +378,14 @@ int VIMapQueries::getVerticesWithCommonLandmarks(
   CHECK_NOTNULL(coobserver_vertex_ids)->clear();
   CHECK(map_.hasVertex(vertex_id));
 
-  vi_map::LandmarkIdList landmark_ids;
-  pose_graph::VertexIdSet visited_vertices;
-  map_.getVertexPtr(vertex_id)->getAllObservedLandmarkIds(&landmark_ids);
-  for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
-    if (landmark_id.isValid()) {
-      const vi_map::Landmark& landmark = map_.getLandmark(landmark_id);
-      landmark.forEachObservation(
-          [&](const vi_map::KeypointIdentifier& backlink) {
-            if (visited_vertices.insert(backlink.frame_id.vertex_id).second) {
-              // This vertex was not yet visited and was successfully inserted.
-              if (map_.hasVertex(backlink.frame_id.vertex_id)) {
-                int common = getNumberOfCommonLandmarks(
-                    vertex_id, backlink.frame_id.vertex_id);
-                if (common >= min_number_common_landmarks) {
-                  coobserver_vertex_ids->push_back(
-                      VertexCommonLandmarksCount(
-                          common, backlink.frame_id.vertex_id));
-                }
-              }
-            }
-          });
-    }
-  }
+  map_.getCovisibilityGraph()->forEachNeighbor(
+      vertex_id, [&](const pose_graph::VertexId& neighbor, size_t common) {
+        if (static_cast<int>(common) >= min_number_common_landmarks &&
+            map_.hasVertex(neighbor)) {
+          coobserver_vertex_ids->push_back(
+              VertexCommonLandmarksCount(common, neighbor));
+        }
+      });
   std::sort(
       coobserver_vertex_ids->begin(), coobserver_vertex_ids->end(),
       VertexCommonLandmarksCountComparator());
@@ -410,7 +395,7 @@ int VIMapQueries::getVerticesWithCommonLandmarks(
 int VIMapQueries::getNumberOfCommonLandmarks(
     const pose_graph::VertexId& vertex_1,
     const pose_graph::VertexId& vertex_2) const {
-  return getNumberOfCommonLandmarks(vertex_1, vertex_2, nullptr);
+  return map_.getCovisibilityGraph()->getWeight(vertex_1, vertex_2);
 }
 
 // Returns the number of common landmarks of vertex 1 and 2
@@ -425,6 +410,12 @@ int VIMapQueries::getNumberOfCommonLandmarks(
     landmarks->clear();
   }
 
+  // The landmarks themselves are not part of the covisibility graph, but it
+  // tells if there are any.
+  if (map_.getCovisibilityGraph()->getWeight(vertex_1_id, vertex_2_id) == 0u) {
+    return 0;
+  }
+
   vi_map::LandmarkIdList vector_landmark_ids_1;
   map_.getVertex(vertex_1_id).getAllObservedLandmarkIds(&vector_landmark_ids_1);
   vi_map::LandmarkIdSet landmark_ids_1(vector_landmark_ids_1.begin(),
@@ -437,17 +428,19 @@ int VIMapQueries::getNumberOfCommonLandmarks(
   vi_map::LandmarkIdList landmark_ids_2;
   map_.getVertex(vertex_2_id).getAllObservedLandmarkIds(&landmark_ids_2);
 
-  int result = 0;
+  // Landmarks observed several times by vertex 2 count only once.
+  vi_map::LandmarkIdSet common_landmark_ids;
   for (const vi_map::LandmarkId& landmark2_id : landmark_ids_2) {
     if (landmark2_id.isValid()) {
       if (landmark_ids_1.count(landmark2_id) != 0u) {
-        ++result;
-        if (landmarks) {
-          landmarks->emplace(landmark2_id);
-        }
+        common_landmark_ids.emplace(landmark2_id);
       }
     }
   }
+  const int result = common_landmark_ids.size();
+  if (landmarks) {
+    landmarks->swap(common_landmark_ids);
+  }
   return result;
 }
 
@@ -460,31 +453,14 @@ int VIMapQueries::getVertexWithMostLandmarksInCommon(
   int max = 0;
   pose_graph::VertexId max_vertex;
 
-  vi_map::LandmarkIdList landmark_ids;
-  pose_graph::VertexIdSet visited_vertices;
-  map_.getVertexPtr(vertex_id)->getAllObservedLandmarkIds(&landmark_ids);
-  for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
-    if (landmark_id.isValid()) {
-      const vi_map::Landmark& landmark = map_.getLandmark(landmark_id);
-      landmark.forEachObservation(
-          [&](const vi_map::KeypointIdentifier& backlink) {
-            if ((backlink.frame_id.vertex_id != vertex_id) &&
-                (visited_vertices.find(backlink.frame_id.vertex_id) ==
-                 visited_vertices.end())) {
-              visited_vertices.insert(backlink.frame_id.vertex_id);
-
-              if (map_.hasVertex(backlink.frame_id.vertex_id)) {
-                int common = getNumberOfCommonLandmarks(
-                    vertex_id, backlink.frame_id.vertex_id);
-                if (common > max) {
-                  max = common;
-                  max_vertex = backlink.frame_id.vertex_id;
-                }
-              }
-            }
-          });
-    }
-  }
+  map_.getCovisibilityGraph()->forEachNeighbor(
+      vertex_id, [&](const pose_graph::VertexId& neighbor, size_t common) {
+        if (neighbor != vertex_id && static_cast<int>(common) > max &&
+            map_.hasVertex(neighbor)) {
+          max = common;
+          max_vertex = neighbor;
+        }
+      });
   if ((max > 0) && (max_vertex.isValid())) {
     CHECK(max_vertex.isValid());
     *best_match_vertex_id = max_vertex;
@@ -516,20 +492,14 @@ void VIMapQueries::getCoobservingVertices(
   CHECK_NOTNULL(coobserving_vertices)->clear();
 
   pose_graph::VertexIdSet coobserver_candidates;
+  const vi_map::CovisibilityGraph* covisibility_graph =
+      map_.getCovisibilityGraph();
   for (const pose_graph::VertexId& vertex_id : given_vertices) {
-    vi_map::LandmarkIdList landmarks;
-    map_.getVertex(vertex_id).getAllObservedLandmarkIds(&landmarks);
-    for (const vi_map::LandmarkId& landmark_id : landmarks) {
-      if (!landmark_id.isValid()) {
-        continue;
-      }
-      const vi_map::Landmark& landmark = map_.getLandmark(landmark_id);
-      landmark.forEachObservation(
-          [&](const vi_map::KeypointIdentifier& backlink) {
-            CHECK(map_.hasVertex(backlink.frame_id.vertex_id));
-            coobserver_candidates.insert(backlink.frame_id.vertex_id);
-          });
-    }
+    covisibility_graph->forEachNeighbor(
+        vertex_id, [&](const pose_graph::VertexId& neighbor, size_t) {
+          CHECK(map_.hasVertex(neighbor));
+          coobserver_candidates.insert(neighbor);
+        });
   }
 
   for (const pose_graph::VertexId& vertex_id : coobserver_candidates) {
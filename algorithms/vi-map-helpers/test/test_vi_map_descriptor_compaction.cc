@@ -0,0 +1,181 @@
+#include <unordered_map>
+
+#include <maplab-common/test/testing-entrypoint.h>
+#include <vi-map/check-map-consistency.h>
+#include <vi-map/test/vi-map-test-helpers.h>
+#include <vi-map/vi-map.h>
+
+#include "vi-map-helpers/vi-map-descriptor-compaction.h"
+
+namespace vi_map_helpers {
+
+class VIMapDescriptorCompactionTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    vi_map::test::generateMap(kNumVertices, &map_);
+    map_.getAllMissionIds(&mission_ids_);
+    map_.getAllLandmarkIds(&landmark_ids_);
+    ASSERT_FALSE(landmark_ids_.empty());
+  }
+
+  size_t getNumUnassociatedKeypoints() const {
+    pose_graph::VertexIdList vertex_ids;
+    map_.getAllVertexIds(&vertex_ids);
+    size_t num_unassociated_keypoints = 0u;
+    for (const pose_graph::VertexId& vertex_id : vertex_ids) {
+      const vi_map::Vertex& vertex = map_.getVertex(vertex_id);
+      for (size_t frame_idx = 0u; frame_idx < vertex.numFrames();
+           ++frame_idx) {
+        vertex.forEachUnassociatedKeypoint(
+            frame_idx, [&](const int /*keypoint_index*/) {
+              ++num_unassociated_keypoints;
+            });
+      }
+    }
+    return num_unassociated_keypoints;
+  }
+
+  // Checks that every observation points to a keypoint that refers back to
+  // the landmark.
+  void expectObservationsConsistent() const {
+    for (const vi_map::LandmarkId& landmark_id : landmark_ids_) {
+      for (const vi_map::KeypointIdentifier& observation :
+           map_.getLandmark(landmark_id).getObservations()) {
+        EXPECT_EQ(
+            map_.getVertex(observation.frame_id.vertex_id)
+                .getObservedLandmarkId(observation),
+            landmark_id);
+      }
+    }
+    EXPECT_TRUE(vi_map::checkMapConsistency(map_));
+  }
+
+  static constexpr size_t kNumVertices = 20u;
+  vi_map::VIMap map_;
+  vi_map::MissionIdList mission_ids_;
+  vi_map::LandmarkIdList landmark_ids_;
+};
+
+TEST_F(VIMapDescriptorCompactionTest, DiscardsUnassociatedKeypoints) {
+  // Dissociate one observation such that there is something to discard.
+  vi_map::Landmark& landmark = map_.getLandmark(landmark_ids_.front());
+  ASSERT_GT(landmark.numberOfObservations(), 1u);
+  const vi_map::KeypointIdentifier observation =
+      landmark.getObservations().front();
+  landmark.removeObservation(observation);
+  vi_map::LandmarkId invalid_landmark_id;
+  invalid_landmark_id.setInvalid();
+  map_.getVertex(observation.frame_id.vertex_id)
+      .setObservedLandmarkId(observation, invalid_landmark_id);
+
+  const size_t num_unassociated_keypoints = getNumUnassociatedKeypoints();
+  ASSERT_GT(num_unassociated_keypoints, 0u);
+  std::unordered_map<vi_map::LandmarkId, vi_map::VIMap::DescriptorsType>
+      descriptors_before;
+  for (const vi_map::LandmarkId& landmark_id : landmark_ids_) {
+    map_.getLandmarkDescriptors(landmark_id, &descriptors_before[landmark_id]);
+  }
+
+  DescriptorCompactionOptions options;
+  options.discard_tracked_keypoints = true;
+  options.num_threads = 4u;
+  DescriptorCompactionResult result;
+  compactDescriptors(options, mission_ids_, &map_, &result);
+
+  EXPECT_EQ(result.num_removed_observations, 0u);
+  EXPECT_EQ(result.num_discarded_keypoints, num_unassociated_keypoints);
+  EXPECT_GT(result.num_discarded_descriptor_bytes, 0u);
+  EXPECT_EQ(getNumUnassociatedKeypoints(), 0u);
+  expectObservationsConsistent();
+
+  // The landmarks still see the same descriptors.
+  for (const vi_map::LandmarkId& landmark_id : landmark_ids_) {
+    vi_map::VIMap::DescriptorsType descriptors_after;
+    map_.getLandmarkDescriptors(landmark_id, &descriptors_after);
+    EXPECT_EQ(descriptors_after, descriptors_before[landmark_id]);
+  }
+
+  // Compacting again is a no-op.
+  compactDescriptors(options, mission_ids_, &map_, &result);
+  EXPECT_EQ(result.num_discarded_keypoints, 0u);
+}
+
+TEST_F(VIMapDescriptorCompactionTest, KeepsTrackedKeypointsByDefault) {
+  // Dissociate one observation and give its keypoint a track id, all other
+  // keypoints of the frame are untracked.
+  vi_map::Landmark& landmark = map_.getLandmark(landmark_ids_.front());
+  ASSERT_GT(landmark.numberOfObservations(), 1u);
+  const vi_map::KeypointIdentifier observation =
+      landmark.getObservations().front();
+  landmark.removeObservation(observation);
+  vi_map::LandmarkId invalid_landmark_id;
+  invalid_landmark_id.setInvalid();
+  vi_map::Vertex& vertex = map_.getVertex(observation.frame_id.vertex_id);
+  vertex.setObservedLandmarkId(observation, invalid_landmark_id);
+  aslam::VisualFrame& frame =
+      vertex.getVisualFrame(observation.frame_id.frame_index);
+  constexpr int kTrackId = 42;
+  Eigen::VectorXi track_ids =
+      Eigen::VectorXi::Constant(frame.getNumKeypointMeasurements(), -1);
+  track_ids(observation.keypoint_index) = kTrackId;
+  frame.swapTrackIds(&track_ids);
+
+  DescriptorCompactionOptions options;
+  options.num_threads = 4u;
+  DescriptorCompactionResult result;
+  compactDescriptors(options, mission_ids_, &map_, &result);
+  expectObservationsConsistent();
+
+  // Exactly the tracked keypoint is left unassociated, with its track id.
+  EXPECT_EQ(getNumUnassociatedKeypoints(), 1u);
+  const aslam::VisualFrame& compacted_frame =
+      map_.getVertex(observation.frame_id.vertex_id)
+          .getVisualFrame(observation.frame_id.frame_index);
+  ASSERT_TRUE(compacted_frame.hasTrackIds());
+  EXPECT_EQ((compacted_frame.getTrackIds().array() == kTrackId).count(), 1);
+
+  options.discard_tracked_keypoints = true;
+  compactDescriptors(options, mission_ids_, &map_, &result);
+  EXPECT_EQ(result.num_discarded_keypoints, 1u);
+  EXPECT_EQ(getNumUnassociatedKeypoints(), 0u);
+  expectObservationsConsistent();
+}
+
+TEST_F(VIMapDescriptorCompactionTest, KeepsLandmarkRepresentatives) {
+  constexpr size_t kMaxObservationsPerLandmark = 2u;
+  size_t num_expected_removed_observations = 0u;
+  for (const vi_map::LandmarkId& landmark_id : landmark_ids_) {
+    const size_t num_observations =
+        map_.getLandmark(landmark_id).numberOfObservations();
+    if (num_observations > kMaxObservationsPerLandmark) {
+      num_expected_removed_observations +=
+          num_observations - kMaxObservationsPerLandmark;
+    }
+  }
+  ASSERT_GT(num_expected_removed_observations, 0u);
+  map_.buildCovisibilityGraph();
+
+  DescriptorCompactionOptions options;
+  options.mode =
+      DescriptorCompactionOptions::Mode::kKeepLandmarkRepresentatives;
+  options.max_observations_per_landmark = kMaxObservationsPerLandmark;
+  options.discard_tracked_keypoints = true;
+  options.num_threads = 4u;
+  DescriptorCompactionResult result;
+  compactDescriptors(options, mission_ids_, &map_, &result);
+
+  EXPECT_EQ(result.num_removed_observations, num_expected_removed_observations);
+  EXPECT_GE(result.num_discarded_keypoints, num_expected_removed_observations);
+  EXPECT_FALSE(map_.hasCovisibilityGraph());
+  EXPECT_EQ(getNumUnassociatedKeypoints(), 0u);
+  for (const vi_map::LandmarkId& landmark_id : landmark_ids_) {
+    EXPECT_LE(
+        map_.getLandmark(landmark_id).numberOfObservations(),
+        kMaxObservationsPerLandmark);
+  }
+  expectObservationsConsistent();
+}
+
+}  // namespace vi_map_helpers
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,87 @@
+#include <Eigen/Core>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <vi-map/test/vi-map-test-helpers.h>
+#include <vi-map/vi-map.h>
+
+#include "vi-map-helpers/vi-map-memory-statistics.h"
+
+namespace vi_map_helpers {
+
+class VIMapMemoryStatisticsTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    vi_map::test::generateMap(kNumVertices, &map_);
+  }
+
+  static void expectBreakdownsEqual(
+      const VIMapMemoryBreakdown& lhs, const VIMapMemoryBreakdown& rhs) {
+    EXPECT_EQ(lhs.vertices, rhs.vertices);
+    EXPECT_EQ(lhs.keypoints, rhs.keypoints);
+    EXPECT_EQ(lhs.descriptors, rhs.descriptors);
+    EXPECT_EQ(lhs.raw_images, rhs.raw_images);
+    EXPECT_EQ(lhs.landmarks, rhs.landmarks);
+    EXPECT_EQ(lhs.landmark_covariances, rhs.landmark_covariances);
+    EXPECT_EQ(lhs.edges, rhs.edges);
+    EXPECT_EQ(lhs.imu_data, rhs.imu_data);
+    EXPECT_EQ(lhs.optional_sensor_data, rhs.optional_sensor_data);
+  }
+
+  static constexpr size_t kNumVertices = 20u;
+  vi_map::VIMap map_;
+};
+
+TEST_F(VIMapMemoryStatisticsTest, CoversAllMissionsAndComponents) {
+  VIMapMemoryStatistics statistics;
+  computeVIMapMemoryStatistics(map_, 1u, &statistics);
+
+  ASSERT_EQ(statistics.missions.size(), 1u);
+  expectBreakdownsEqual(
+      statistics.missions.begin()->second, statistics.missions_total);
+  EXPECT_GT(statistics.missions_total.vertices, 0u);
+  EXPECT_GT(statistics.missions_total.landmarks, 0u);
+  EXPECT_GT(statistics.missions_total.edges, 0u);
+  EXPECT_GT(statistics.landmark_index, 0u);
+  EXPECT_EQ(statistics.covisibility_graph, 0u);
+  EXPECT_GE(statistics.total(), statistics.missions_total.total());
+  EXPECT_FALSE(statistics.toString().empty());
+
+  map_.buildCovisibilityGraph();
+  computeVIMapMemoryStatistics(map_, 1u, &statistics);
+  EXPECT_GT(statistics.covisibility_graph, 0u);
+}
+
+TEST_F(VIMapMemoryStatisticsTest, ParallelMatchesSequential) {
+  VIMapMemoryStatistics sequential_statistics;
+  computeVIMapMemoryStatistics(map_, 1u, &sequential_statistics);
+  VIMapMemoryStatistics parallel_statistics;
+  constexpr size_t kNumThreads = 4u;
+  computeVIMapMemoryStatistics(map_, kNumThreads, &parallel_statistics);
+
+  expectBreakdownsEqual(
+      sequential_statistics.missions_total,
+      parallel_statistics.missions_total);
+  EXPECT_EQ(
+      sequential_statistics.waste.total(), parallel_statistics.waste.total());
+}
+
+TEST_F(VIMapMemoryStatisticsTest, FlagsLandmarkCovariances) {
+  VIMapMemoryStatistics statistics;
+  computeVIMapMemoryStatistics(map_, 1u, &statistics);
+  EXPECT_EQ(statistics.waste.num_landmark_covariances, 0u);
+
+  vi_map::LandmarkIdList landmark_ids;
+  map_.getAllLandmarkIds(&landmark_ids);
+  ASSERT_FALSE(landmark_ids.empty());
+  map_.getLandmark(landmark_ids.front())
+      .set_p_B_Covariance(Eigen::Matrix3d::Identity());
+
+  computeVIMapMemoryStatistics(map_, 1u, &statistics);
+  EXPECT_EQ(statistics.waste.num_landmark_covariances, 1u);
+  EXPECT_EQ(statistics.waste.landmark_covariances, sizeof(Eigen::Matrix3d));
+  EXPECT_EQ(
+      statistics.missions_total.landmark_covariances, sizeof(Eigen::Matrix3d));
+}
+
+}  // namespace vi_map_helpers
+
+MAPLAB_UNITTEST_ENTRYPOINT
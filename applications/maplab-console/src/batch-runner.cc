@@ -1,9 +1,24 @@
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>  // NOLINT
 #include <iostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include <console-common/console.h>
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <map-manager/map-manager.h>
+#include <maplab-common/threading-helpers.h>
 #include <vi-map/vi-map.h>
 #include <visualization/viwls-graph-plotter.h>
 #include <yaml-cpp/yaml.h>
@@ -25,6 +40,11 @@
 //     - command1
 //     - command2
 //     - command3
+//
+// With --batch_runner_num_parallel_jobs=N, N maps are processed concurrently,
+// each in its own process. A map that fails or crashes doesn't affect the
+// others. The status and timing of every map can be written to a yaml file
+// with --batch_runner_summary_file.
 
 const std::string kMapFolderTemplate("<CURRENT_VIMAP_FOLDER>");
 const std::string kConsoleName = "maplab-batch-runner";
@@ -56,6 +76,65 @@ DEFINE_string(
     batch_control_file, "",
     "Filename of the yaml file that "
     "contains the batch processing information.");
+DEFINE_int32(
+    batch_runner_num_parallel_jobs, 1,
+    "Number of maps that are processed concurrently. With more than one job, "
+    "every map is processed in its own process, such that a failing map "
+    "doesn't affect the others.");
+DEFINE_int32(
+    batch_runner_memory_limit_per_job_mb, 0,
+    "Address space limit of a parallel job in MB. (0: unlimited)");
+DEFINE_uint64(
+    batch_runner_num_threads_per_job, 0u,
+    "Number of hardware threads announced to a parallel job. (0: the number "
+    "of hardware threads divided by the number of parallel jobs)");
+DEFINE_string(
+    batch_runner_summary_file, "",
+    "If set, the status and timing of every map are written to this yaml "
+    "file.");
+
+DECLARE_bool(ros_free);
+DECLARE_uint64(num_hardware_threads);
+
+namespace {
+// Exit codes of a parallel job are the number of failed commands, capped to
+// stay clear of the codes used by the shell.
+constexpr int kMaxExitCodeForFailedCommands = 125;
+
+struct MapJobResult {
+  enum class Status { kNotRun, kSuccess, kFailedCommands, kCrashed };
+
+  MapJobResult()
+      : status(Status::kNotRun), num_failed_commands(0u), duration_s(0.0) {}
+
+  std::string map_folder;
+  Status status;
+  size_t num_failed_commands;
+  double duration_s;
+};
+
+const char* statusToString(const MapJobResult::Status status) {
+  switch (status) {
+    case MapJobResult::Status::kNotRun:
+      return "not_run";
+    case MapJobResult::Status::kSuccess:
+      return "success";
+    case MapJobResult::Status::kFailedCommands:
+      return "failed_commands";
+    case MapJobResult::Status::kCrashed:
+      return "crashed";
+    default:
+      LOG(FATAL) << "Unknown status " << static_cast<int>(status) << ".";
+  }
+  return "";
+}
+
+double secondsSince(const std::chrono::steady_clock::time_point& start) {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+}  // namespace
 
 bool replaceSubstring(
     const std::string& from, const std::string& to, std::string* full_string) {
@@ -68,6 +147,187 @@ bool replaceSubstring(
   return true;
 }
 
+// Runs all commands on the given map and returns the number of failed
+// commands.
+size_t runCommandsOnMap(
+    const std::vector<std::string>& commands, const std::string& map_folder,
+    maplab::MapLabConsole* console) {
+  CHECK_NOTNULL(console);
+  // Release all maps from memory.
+  vi_map::VIMapManager map_manager;
+  std::unordered_set<std::string> all_map_keys;
+  map_manager.getAllMapKeys(&all_map_keys);
+  for (const std::string& key : all_map_keys) {
+    map_manager.deleteMap(key);
+  }
+  const std::string kNoMapSelected = "";
+  console->setSelectedMapKey(kNoMapSelected);
+
+  // Run all commands on this map.
+  const size_t num_cmds = commands.size();
+  size_t num_failed_commands = 0u;
+  size_t cmd_idx = 1u;
+  for (const std::string& command : commands) {
+    // Replace the map_folder template string for the current command.
+    std::string actual_command = command;
+    replaceSubstring(kMapFolderTemplate, map_folder, &actual_command);
+
+    LOG(INFO) << "\t Running command (" << cmd_idx << " / " << num_cmds
+              << "): " << actual_command;
+
+    // Run the command.
+    if (console->RunCommand(actual_command) != common::kSuccess) {
+      LOG(ERROR) << "\t Command failed!";
+      ++num_failed_commands;
+    } else {
+      LOG(INFO) << "\t Command successful.";
+    }
+    ++cmd_idx;
+  }
+  return num_failed_commands;
+}
+
+void runSequentially(
+    const BatchControlInformation& control_information, int argc, char** argv,
+    std::vector<MapJobResult>* results) {
+  CHECK_NOTNULL(results);
+  visualization::ViwlsGraphRvizPlotter::Ptr plotter(
+      new visualization::ViwlsGraphRvizPlotter());
+  maplab::MapLabConsole console(kConsoleName, argc, argv);
+
+  const size_t num_maps = results->size();
+  for (size_t map_idx = 0u; map_idx < num_maps; ++map_idx) {
+    MapJobResult& result = (*results)[map_idx];
+    LOG(INFO) << "Running map (" << map_idx + 1u << " / " << num_maps
+              << "): " << result.map_folder;
+
+    const std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    result.num_failed_commands = runCommandsOnMap(
+        control_information.commands, result.map_folder, &console);
+    result.duration_s = secondsSince(start);
+    result.status = result.num_failed_commands == 0u
+                        ? MapJobResult::Status::kSuccess
+                        : MapJobResult::Status::kFailedCommands;
+    LOG(INFO) << "Done running map.";
+  }
+}
+
+// Processes every map in a forked process. The console commands communicate
+// through global flags and the map manager singleton, so processes are the
+// unit of isolation between concurrently processed maps.
+void runInParallel(
+    const BatchControlInformation& control_information, int argc, char** argv,
+    std::vector<MapJobResult>* results) {
+  CHECK_NOTNULL(results);
+  const size_t num_jobs = FLAGS_batch_runner_num_parallel_jobs;
+  CHECK_GT(num_jobs, 1u);
+  const size_t num_threads_per_job =
+      FLAGS_batch_runner_num_threads_per_job > 0u
+          ? FLAGS_batch_runner_num_threads_per_job
+          : std::max<size_t>(1u, common::getNumHardwareThreads() / num_jobs);
+  LOG(INFO) << "Processing " << num_jobs << " maps in parallel with "
+            << num_threads_per_job << " thread(s) each.";
+
+  // Every job would register the same ROS node.
+  LOG_IF(WARNING, !FLAGS_ros_free)
+      << "Visualization is disabled for parallel jobs.";
+  FLAGS_ros_free = true;
+
+  std::unordered_map<pid_t, size_t> running_jobs;
+  std::unordered_map<pid_t, std::chrono::steady_clock::time_point> start_times;
+  const size_t num_maps = results->size();
+  size_t next_map_idx = 0u;
+  while (next_map_idx < num_maps || !running_jobs.empty()) {
+    while (running_jobs.size() < num_jobs && next_map_idx < num_maps) {
+      const size_t map_idx = next_map_idx++;
+      const std::string& map_folder = (*results)[map_idx].map_folder;
+      LOG(INFO) << "Starting map (" << map_idx + 1u << " / " << num_maps
+                << "): " << map_folder;
+      const std::chrono::steady_clock::time_point start =
+          std::chrono::steady_clock::now();
+      const pid_t pid = fork();
+      CHECK_GE(pid, 0) << "Forking a job failed: " << std::strerror(errno);
+      if (pid == 0) {
+        if (FLAGS_batch_runner_memory_limit_per_job_mb > 0) {
+          struct rlimit limit;
+          limit.rlim_cur = limit.rlim_max =
+              static_cast<rlim_t>(FLAGS_batch_runner_memory_limit_per_job_mb) *
+              1024u * 1024u;
+          PCHECK(setrlimit(RLIMIT_AS, &limit) == 0);
+        }
+        FLAGS_num_hardware_threads = num_threads_per_job;
+        maplab::MapLabConsole console(kConsoleName, argc, argv);
+        const size_t num_failed_commands = runCommandsOnMap(
+            control_information.commands, map_folder, &console);
+        // Skip the destructors of the state inherited from the parent.
+        google::FlushLogFiles(google::INFO);
+        std::_Exit(
+            static_cast<int>(
+                std::min<size_t>(
+                    num_failed_commands, kMaxExitCodeForFailedCommands)));
+      }
+      running_jobs.emplace(pid, map_idx);
+      start_times.emplace(pid, start);
+    }
+
+    int wait_status;
+    const pid_t finished_pid = waitpid(-1, &wait_status, 0);
+    if (finished_pid < 0) {
+      PCHECK(errno == EINTR);
+      continue;
+    }
+    std::unordered_map<pid_t, size_t>::iterator it =
+        running_jobs.find(finished_pid);
+    CHECK(it != running_jobs.end());
+    MapJobResult& result = (*results)[it->second];
+    result.duration_s = secondsSince(start_times.at(finished_pid));
+    if (WIFEXITED(wait_status)) {
+      result.num_failed_commands = WEXITSTATUS(wait_status);
+      result.status = result.num_failed_commands == 0u
+                          ? MapJobResult::Status::kSuccess
+                          : MapJobResult::Status::kFailedCommands;
+    } else {
+      result.status = MapJobResult::Status::kCrashed;
+      LOG_IF(ERROR, WIFSIGNALED(wait_status))
+          << "Map " << result.map_folder << " crashed with signal "
+          << WTERMSIG(wait_status) << ".";
+    }
+    LOG(INFO) << "Done running map " << result.map_folder << " ("
+              << statusToString(result.status) << ", " << result.duration_s
+              << "s).";
+    running_jobs.erase(it);
+    start_times.erase(finished_pid);
+  }
+}
+
+bool writeSummaryFile(
+    const std::vector<MapJobResult>& results, const std::string& filename) {
+  YAML::Emitter emitter;
+  emitter << YAML::BeginMap << YAML::Key << "num_parallel_jobs"
+          << YAML::Value << FLAGS_batch_runner_num_parallel_jobs
+          << YAML::Key << "maps" << YAML::Value << YAML::BeginSeq;
+  for (const MapJobResult& result : results) {
+    emitter << YAML::BeginMap;
+    emitter << YAML::Key << "vi_map_folder_path" << YAML::Value
+            << result.map_folder;
+    emitter << YAML::Key << "status" << YAML::Value
+            << statusToString(result.status);
+    emitter << YAML::Key << "num_failed_commands" << YAML::Value
+            << result.num_failed_commands;
+    emitter << YAML::Key << "duration_s" << YAML::Value << result.duration_s;
+    emitter << YAML::EndMap;
+  }
+  emitter << YAML::EndSeq << YAML::EndMap;
+
+  std::ofstream summary_file(filename);
+  if (!summary_file.is_open()) {
+    return false;
+  }
+  summary_file << emitter.c_str() << std::endl;
+  return summary_file.good();
+}
+
 int main(int argc, char** argv) {
   google::InitGoogleLogging(argv[0]);
   google::ParseCommandLineFlags(&argc, &argv, true);
@@ -77,9 +337,8 @@ int main(int argc, char** argv) {
 
   CHECK_NE(FLAGS_batch_control_file, "")
       << "You have to provide the path to the batch control yaml-file.";
-
-  visualization::ViwlsGraphRvizPlotter::Ptr plotter(
-      new visualization::ViwlsGraphRvizPlotter());
+  CHECK_GT(FLAGS_batch_runner_num_parallel_jobs, 0);
+  CHECK_GE(FLAGS_batch_runner_memory_limit_per_job_mb, 0);
 
   BatchControlInformation control_information;
   if (!YAML::Load(FLAGS_batch_control_file, &control_information)) {
@@ -97,48 +356,33 @@ int main(int argc, char** argv) {
   LOG(INFO) << "Got " << num_cmds << " commands to apply on " << num_maps
             << " maps.";
 
+  std::vector<MapJobResult> results(num_maps);
+  for (size_t map_idx = 0u; map_idx < num_maps; ++map_idx) {
+    results[map_idx].map_folder =
+        control_information.vi_map_folder_paths[map_idx];
+  }
+
   // Process all commands for all maps.
-  maplab::MapLabConsole console(kConsoleName, argc, argv);
+  if (FLAGS_batch_runner_num_parallel_jobs > 1) {
+    runInParallel(control_information, argc, argv, &results);
+  } else {
+    runSequentially(control_information, argc, argv, &results);
+  }
 
-  size_t map_idx = 1u;
-  for (const std::string& map_folder :
-       control_information.vi_map_folder_paths) {
-    LOG(INFO) << "Running map (" << map_idx << " / " << num_maps
-              << "): " << map_folder;
-
-    // Release all maps from memory.
-    vi_map::VIMapManager map_manager;
-    std::unordered_set<std::string> all_map_keys;
-    map_manager.getAllMapKeys(&all_map_keys);
-    for (const std::string& key : all_map_keys) {
-      map_manager.deleteMap(key);
+  size_t num_successful_maps = 0u;
+  for (const MapJobResult& result : results) {
+    if (result.status == MapJobResult::Status::kSuccess) {
+      ++num_successful_maps;
     }
-    const std::string kNoMapSelected = "";
-    console.setSelectedMapKey(kNoMapSelected);
-
-    // Run all commands on this map.
-    size_t cmd_idx = 1u;
-    for (const std::string& command : control_information.commands) {
-      // Replace the map_folder template string for the current command.
-      std::string actual_command = command;
-      replaceSubstring(kMapFolderTemplate, map_folder, &actual_command);
-
-      LOG(INFO) << "\t Running command (" << cmd_idx << " / " << num_cmds
-                << "): " << actual_command;
-
-      // Run the command.
-      if (console.RunCommand(actual_command) != common::kSuccess) {
-        LOG(ERROR) << "\t Command failed!";
-      } else {
-        LOG(INFO) << "\t Command successful.";
-      }
-      ++cmd_idx;
-    }
-
-    LOG(INFO) << "Done running map.";
-    ++map_idx;
   }
-
   LOG(INFO) << "Done. Processed " << num_cmds << " commands for " << num_maps
-            << " maps.";
+            << " maps, " << num_successful_maps << " maps without errors.";
+
+  if (!FLAGS_batch_runner_summary_file.empty()) {
+    LOG_IF(
+        ERROR,
+        !writeSummaryFile(results, FLAGS_batch_runner_summary_file))
+        << "Writing the summary to " << FLAGS_batch_runner_summary_file
+        << " failed.";
+  }
 }
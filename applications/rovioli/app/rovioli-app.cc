@@ -1,8 +1,10 @@
 #include <memory>
+#include <string>
 
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <localization-summary-map/localization-summary-map-creation.h>
+#include <localization-summary-map/localization-summary-map-tiling.h>
 #include <localization-summary-map/localization-summary-map.h>
 #include <maplab-common/sigint-breaker.h>
 #include <maplab-common/threading-helpers.h>
@@ -18,8 +20,8 @@
 
 DEFINE_string(
     vio_localization_map_folder, "",
-    "Path to a localization summary map or a full VI-map used for "
-    "localization.");
+    "Path to a localization summary map, a tiled localization summary map or "
+    "a full VI-map used for localization.");
 DEFINE_string(
     ncamera_calibration, "ncamera.yaml",
     "Path to the camera calibration yaml.");
@@ -57,7 +59,13 @@ int main(int argc, char** argv) {
 
   // Optionally load localization map.
   std::unique_ptr<summary_map::LocalizationSummaryMap> localization_map;
-  if (!FLAGS_vio_localization_map_folder.empty()) {
+  std::string localization_tiled_map_folder;
+  if (!FLAGS_vio_localization_map_folder.empty() &&
+      summary_map::hasTiledLocalizationSummaryMapOnFileSystem(
+          FLAGS_vio_localization_map_folder)) {
+    // The tiles are loaded on demand by the localizer.
+    localization_tiled_map_folder = FLAGS_vio_localization_map_folder;
+  } else if (!FLAGS_vio_localization_map_folder.empty()) {
     localization_map.reset(new summary_map::LocalizationSummaryMap);
     if (!localization_map->loadFromFolder(FLAGS_vio_localization_map_folder)) {
       LOG(WARNING) << "Could not load a localization summary map from "
@@ -123,7 +131,8 @@ int main(int argc, char** argv) {
 
   rovioli::RovioliNode rovio_localization_node(
       camera_system, std::move(maplab_imu_sensor), rovio_imu_sigmas,
-      save_map_folder, localization_map.get(), flow.get());
+      save_map_folder, localization_map.get(), localization_tiled_map_folder,
+      flow.get());
 
   // Start the pipeline. The ROS spinner will handle SIGINT for us and abort
   // the application on CTRL+C.
@@ -0,0 +1,64 @@
+#ifndef ROVIOLI_LOCALIZATION_LANDMARK_INDEX_H_
+#define ROVIOLI_LOCALIZATION_LANDMARK_INDEX_H_
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/cameras/ncamera.h>
+#include <aslam/common/pose-types.h>
+#include <localization-summary-map/localization-summary-map.h>
+#include <maplab-common/macros.h>
+
+namespace rovioli {
+
+// Spatial index over the landmarks of a localization summary map. The
+// landmarks are hashed into a regular voxel grid such that the landmarks
+// around a position can be retrieved without touching the rest of the map.
+class LocalizationLandmarkIndex {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(LocalizationLandmarkIndex);
+
+  LocalizationLandmarkIndex() = delete;
+  LocalizationLandmarkIndex(
+      const summary_map::LocalizationSummaryMap& localization_summary_map,
+      const double voxel_size_meters);
+
+  // Returns the indices of all landmarks within the radius around p_G.
+  void getLandmarksWithinRadius(
+      const Eigen::Vector3d& p_G, const double radius_meters,
+      std::vector<int>* landmark_indices) const;
+
+  // Only keeps the landmarks that project into at least one camera of the
+  // ncamera at the given pose.
+  void filterLandmarksOutsideOfFrustum(
+      const aslam::NCamera& ncamera, const aslam::Transformation& T_G_I,
+      std::vector<int>* landmark_indices) const;
+
+  // Returns the summary map observations of the given landmarks.
+  void getObservationsOfLandmarks(
+      const std::vector<int>& landmark_indices,
+      std::vector<int>* observation_indices) const;
+
+  size_t numLandmarks() const;
+
+ private:
+  typedef uint64_t VoxelKey;
+  VoxelKey getVoxelKey(const Eigen::Vector3i& voxel) const;
+  Eigen::Vector3i getVoxel(const Eigen::Vector3d& p_G) const;
+
+  const summary_map::LocalizationSummaryMap& localization_summary_map_;
+  const double voxel_size_meters_;
+
+  std::unordered_map<VoxelKey, std::vector<int>> voxel_to_landmark_indices_;
+
+  // The observations of landmark i are observation_indices_[
+  // landmark_observations_begin_[i], landmark_observations_begin_[i + 1]).
+  std::vector<int> landmark_observations_begin_;
+  std::vector<int> observation_indices_;
+};
+
+}  // namespace rovioli
+
+#endif  // ROVIOLI_LOCALIZATION_LANDMARK_INDEX_H_
@@ -0,0 +1,116 @@
+#ifndef ROVIOLI_LOCALIZATION_TILE_MANAGER_H_
+#define ROVIOLI_LOCALIZATION_TILE_MANAGER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+#include <localization-summary-map/localization-summary-map-tiling.h>
+#include <localization-summary-map/localization-summary-map.h>
+#include <loop-closure-handler/loop-detector-node.h>
+#include <maplab-common/macros.h>
+
+namespace rovioli {
+
+// Keeps the tiles of a tiled localization summary map that are close to the
+// current position estimate loaded, each with its own localization database.
+// Tiles are loaded and evicted by a background thread such that the memory
+// used by the localization and the set of tiles searched per query stay
+// bounded, independent of the total size of the map. The budget covers the
+// tiles and the vocabulary that the database of every tile loads.
+class LocalizationTileManager {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(LocalizationTileManager);
+
+  struct LoadedTile {
+    MAPLAB_POINTER_TYPEDEFS(LoadedTile);
+    size_t tile_index;
+    summary_map::LocalizationSummaryMap::UniquePtr summary_map;
+    loop_detector_node::LoopDetectorNode::UniquePtr loop_detector;
+  };
+  typedef std::vector<LoadedTile::ConstPtr> LoadedTileList;
+
+  typedef std::function<bool(
+      const summary_map::LocalizationSummaryMapTile&,
+      summary_map::LocalizationSummaryMap*)>
+      TileLoader;
+
+  LocalizationTileManager() = delete;
+
+  // Loads the tiles from the folder of a tiled summary map.
+  LocalizationTileManager(
+      const std::string& tiled_map_folder, const double load_radius_meters,
+      const size_t memory_budget_bytes, const bool visualize_localization);
+  LocalizationTileManager(
+      const summary_map::TiledLocalizationSummaryMapIndex& index,
+      const TileLoader& tile_loader, const double load_radius_meters,
+      const size_t memory_budget_bytes, const bool visualize_localization);
+  ~LocalizationTileManager();
+
+  // Requests the tiles around the given position to be loaded. Only the most
+  // recent request is processed if the loading falls behind.
+  void setPosition(const Eigen::Vector3d& p_G_I);
+  // Requests the tiles around the next tile that isn't loaded to be loaded,
+  // going through all tiles in turn. Does nothing while tiles are being
+  // loaded. Lets the global search cover the whole map within the memory
+  // budget while there is no position estimate.
+  void loadNextTiles();
+  // Blocks until the most recent position request has been processed.
+  void waitUntilIdle();
+
+  // Returns a snapshot of the loaded tiles. The tiles stay valid while they
+  // are referenced, even if they get evicted in the meantime.
+  void getLoadedTiles(LoadedTileList* loaded_tiles) const;
+  size_t getNumLoadedTiles() const;
+  // Memory used by the loaded tiles as estimated when creating the tiles,
+  // including the vocabulary of their databases.
+  size_t getLoadedTilesNumBytes() const;
+  // Memory used by the vocabulary of the database of every loaded tile.
+  size_t getTileVocabularyNumBytes() const;
+
+  void shutdown();
+
+ private:
+  void updateWorker();
+  void updateLoadedTiles(const Eigen::Vector3d& p_G_I);
+  // Returns the tiles within the load radius, closest first, that fit into
+  // the memory budget.
+  void selectTiles(
+      const Eigen::Vector3d& p_G_I, std::vector<size_t>* tile_indices) const;
+  LoadedTile::Ptr loadTile(const size_t tile_index) const;
+  size_t getTileNumBytes(const size_t tile_index) const;
+
+  const summary_map::TiledLocalizationSummaryMapIndex index_;
+  const TileLoader tile_loader_;
+  const double load_radius_meters_;
+  const size_t memory_budget_bytes_;
+  const bool visualize_localization_;
+  // Measured once on construction, the vocabulary doesn't change.
+  size_t tile_vocabulary_num_bytes_;
+
+  std::unordered_map<size_t, LoadedTile::ConstPtr> loaded_tiles_;
+  size_t loaded_tiles_num_bytes_;
+  mutable std::mutex m_loaded_tiles_;
+
+  Eigen::Vector3d requested_p_G_I_;
+  bool has_pending_request_;
+  bool is_updating_;
+  size_t next_tile_index_;
+  std::mutex m_request_;
+  std::condition_variable cv_request_;
+  std::condition_variable cv_idle_;
+
+  std::atomic<bool> shutdown_;
+  std::thread update_thread_;
+};
+
+}  // namespace rovioli
+
+#endif  // ROVIOLI_LOCALIZATION_TILE_MANAGER_H_
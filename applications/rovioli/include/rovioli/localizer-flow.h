@@ -1,49 +1,56 @@
 #ifndef ROVIOLI_LOCALIZER_FLOW_H_
 #define ROVIOLI_LOCALIZER_FLOW_H_
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
 #include <localization-summary-map/localization-summary-map.h>
 #include <message-flow/message-flow.h>
 #include <vio-common/vio-types.h>
 
 #include "rovioli/flow-topics.h"
+#include "rovioli/localization-tile-manager.h"
 #include "rovioli/localizer.h"
 
 namespace rovioli {
 
+// Runs the localization on its own thread. Only the most recent throttled
+// nframe is localized; nframes that arrive while a localization is running
+// replace each other such that the results never lag behind because of
+// queued up nframes.
 class LocalizerFlow {
  public:
   explicit LocalizerFlow(
       const summary_map::LocalizationSummaryMap& localization_map,
-      const bool visualize_localization)
-      : localizer_(localization_map, visualize_localization) {}
-
-  void attachToMessageFlow(message_flow::MessageFlow* flow) {
-    CHECK_NOTNULL(flow);
-    static constexpr char kSubscriberNodeName[] = "LocalizerFlow";
-
-    // Subscribe-publish: nframe to localization.
-    std::function<void(vio::LocalizationResult::ConstPtr)> publish_result =
-        flow->registerPublisher<message_flow_topics::LOCALIZATION_RESULT>();
-
-    // NOTE: the publisher function pointer is copied intentionally; otherwise
-    // we would capture a reference to a temporary.
-    flow->registerSubscriber<
-        message_flow_topics::THROTTLED_TRACKED_NFRAMES_AND_IMU>(
-        kSubscriberNodeName, message_flow::DeliveryOptions(),
-        [publish_result,
-         this](const vio::SynchronizedNFrameImu::ConstPtr& nframe_imu) {
-          CHECK(nframe_imu);
-          vio::LocalizationResult::Ptr loc_result(new vio::LocalizationResult);
-          const bool success = this->localizer_.localizeNFrame(
-              nframe_imu->nframe, loc_result.get());
-          if (success) {
-            publish_result(loc_result);
-          }
-        });
-  }
+      const bool visualize_localization);
+  explicit LocalizerFlow(LocalizationTileManager::UniquePtr tile_manager);
+  ~LocalizerFlow();
+
+  void attachToMessageFlow(message_flow::MessageFlow* flow);
+
+  // Stops the localization thread; pending nframes are dropped.
+  void shutdown();
 
  private:
+  void queueNFrame(const vio::SynchronizedNFrameImu::ConstPtr& nframe_imu);
+  void localizationWorker();
+
   Localizer localizer_;
+  std::function<void(vio::LocalizationResult::ConstPtr)> publish_result_;
+
+  // The newest nframe that has not been localized yet and the wall time at
+  // which it was received.
+  vio::SynchronizedNFrameImu::ConstPtr pending_nframe_imu_;
+  int64_t pending_nframe_received_time_ns_;
+  std::mutex m_pending_nframe_;
+  std::condition_variable cv_pending_nframe_;
+
+  std::atomic<bool> shutdown_;
+  std::thread localization_thread_;
 };
 }  // namespace rovioli
 #endif  // ROVIOLI_LOCALIZER_FLOW_H_
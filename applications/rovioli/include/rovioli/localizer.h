@@ -1,11 +1,18 @@
 #ifndef ROVIOLI_LOCALIZER_H_
 #define ROVIOLI_LOCALIZER_H_
 
+#include <mutex>
+
+#include <Eigen/Core>
+#include <aslam/common/pose-types.h>
 #include <localization-summary-map/localization-summary-map.h>
 #include <loop-closure-handler/loop-detector-node.h>
 #include <maplab-common/macros.h>
 #include <vio-common/vio-types.h>
 
+#include "rovioli/localization-landmark-index.h"
+#include "rovioli/localization-tile-manager.h"
+
 namespace rovioli {
 
 class Localizer {
@@ -19,25 +26,55 @@ class Localizer {
   Localizer(
       const summary_map::LocalizationSummaryMap& localization_summary_map,
       const bool visualize_localization);
+  // Localizes against the tiles of a tiled summary map that are currently
+  // loaded by the tile manager. Until the first localization, every failed
+  // global search makes the tile manager load the next tiles.
+  explicit Localizer(LocalizationTileManager::UniquePtr tile_manager);
 
   LocalizationMode getCurrentLocalizationMode() const;
 
+  bool isTiled() const;
+  // Sets the pose prior used to select the landmarks during map tracking and
+  // lets the tile manager load the tiles around the given position.
+  void setPosePrior(const aslam::Transformation& T_G_I);
+
+  // After a successful localization, the following nframes are only matched
+  // against the landmarks around the pose prior (map tracking). Falls back to
+  // the global search of the whole map if map tracking fails.
   bool localizeNFrame(
       const aslam::VisualNFrame::ConstPtr& nframe,
-      vio::LocalizationResult* localization_result) const;
+      vio::LocalizationResult* localization_result);
 
  private:
   bool localizeNFrameGlobal(
       const aslam::VisualNFrame::ConstPtr& nframe,
-      aslam::Transformation* T_G_I_lc_pnp) const;
+      aslam::Transformation* T_G_I_lc_pnp);
+  bool localizeNFrameGlobalTiled(
+      const aslam::VisualNFrame::ConstPtr& nframe,
+      aslam::Transformation* T_G_I_lc_pnp);
   bool localizeNFrameMapTracking(
       const aslam::VisualNFrame::ConstPtr& nframe,
       aslam::Transformation* T_G_I_lc_pnp) const;
 
-  LocalizationMode current_localization_mode_;
+  void updateLocalizationState(
+      const bool localization_success,
+      const aslam::Transformation& T_G_I_lc_pnp);
+
   loop_detector_node::LoopDetectorNode::UniquePtr global_loop_detector_;
 
-  const summary_map::LocalizationSummaryMap& localization_summary_map_;
+  // Map tracking state, updated by every localization and by the pose priors,
+  // which arrive on another thread.
+  LocalizationMode current_localization_mode_;
+  aslam::Transformation T_G_I_prior_;
+  bool has_T_G_I_prior_;
+  mutable std::mutex m_localization_state_;
+
+  // Only set if a single summary map is used for localization.
+  const summary_map::LocalizationSummaryMap* const localization_summary_map_;
+  // Only set if map tracking is enabled and a single summary map is used.
+  LocalizationLandmarkIndex::UniquePtr landmark_index_;
+  // Only set if a tiled summary map is used for localization.
+  LocalizationTileManager::UniquePtr tile_manager_;
 };
 
 }  // namespace rovioli
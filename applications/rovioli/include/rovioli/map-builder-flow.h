@@ -2,6 +2,7 @@
 #define ROVIOLI_MAP_BUILDER_FLOW_H_
 
 #include <atomic>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <string>
@@ -33,7 +34,12 @@ class MapBuilderFlow {
       const bool process_to_localization_map);
 
  private:
+  // Logs the memory statistics of the map if the logging period has passed.
+  // Must be called with the map mutex locked.
+  void logMapMemoryStatisticsIfDue();
+
   VIMapWithMutex::Ptr map_with_mutex_;
+  int64_t last_memory_statistics_time_ns_;
 
   // If set then all incoming callbacks that cause operations on the map will be
   // rejected. This is used during shutdown.
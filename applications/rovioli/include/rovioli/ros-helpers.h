@@ -16,6 +16,8 @@
 #include <sensor_msgs/image_encodings.h>
 #pragma GCC diagnostic pop
 
+#include <opencv2/imgproc/imgproc.hpp>
+#include <vio-common/image-buffer-pool.h>
 #include <vio-common/vio-types.h>
 
 namespace rovioli {
@@ -40,22 +42,55 @@ inline vio::ImuMeasurement::Ptr convertRosImuToMaplabImu(
 inline vio::ImageMeasurement::Ptr convertRosImageToMaplabImage(
     const sensor_msgs::ImageConstPtr& image_message, size_t camera_idx) {
   CHECK(image_message);
-  cv_bridge::CvImageConstPtr cv_ptr;
-  try {
-    // Convert the image to MONO8 if necessary.
-    cv_ptr = cv_bridge::toCvShare(
-        image_message, sensor_msgs::image_encodings::MONO8);
-  } catch (const cv_bridge::Exception& e) {  // NOLINT
-    LOG(FATAL) << "cv_bridge exception: " << e.what();
-  }
-  CHECK(cv_ptr);
-
   vio::ImageMeasurement::Ptr image_measurement(new vio::ImageMeasurement);
-  // Unfortunately the clone is necessary as ROS stores the data in an
-  // uint8_t array inside CvImage and not the cv::Mat itself. Keeping the
-  // data alive without holding on to the CvImage is not possible without
-  // letting all the code depend on ROS and boost.
-  image_measurement->image = cv_ptr->image.clone();
+  const std::string& encoding = image_message->encoding;
+  if (encoding == sensor_msgs::image_encodings::MONO8) {
+    // Reference the data of the message instead of copying it. The image
+    // keeps the message alive, such that downstream code doesn't need to
+    // depend on ROS.
+    image_measurement->image = vio_common::wrapImageData(
+        image_message->height, image_message->width, CV_8UC1,
+        const_cast<uint8_t*>(image_message->data.data()), image_message->step,
+        std::shared_ptr<const void>(
+            image_message->data.data(),
+            [image_message](const void* /*data*/) {}));
+  } else {
+    int color_conversion_code = -1;
+    if (encoding == sensor_msgs::image_encodings::BGR8) {
+      color_conversion_code = cv::COLOR_BGR2GRAY;
+    } else if (encoding == sensor_msgs::image_encodings::RGB8) {
+      color_conversion_code = cv::COLOR_RGB2GRAY;
+    } else if (encoding == sensor_msgs::image_encodings::BGRA8) {
+      color_conversion_code = cv::COLOR_BGRA2GRAY;
+    } else if (encoding == sensor_msgs::image_encodings::RGBA8) {
+      color_conversion_code = cv::COLOR_RGBA2GRAY;
+    }
+
+    cv_bridge::CvImageConstPtr cv_ptr;
+    try {
+      // Convert the image to MONO8 if it can't be converted directly into a
+      // pooled buffer.
+      cv_ptr = color_conversion_code >= 0
+                   ? cv_bridge::toCvShare(image_message)
+                   : cv_bridge::toCvShare(
+                         image_message, sensor_msgs::image_encodings::MONO8);
+    } catch (const cv_bridge::Exception& e) {  // NOLINT
+      LOG(FATAL) << "cv_bridge exception: " << e.what();
+    }
+    CHECK(cv_ptr);
+
+    if (color_conversion_code >= 0) {
+      image_measurement->image =
+          vio_common::ImageBufferPool::getDefaultPool()->allocateImage(
+              image_message->height, image_message->width, CV_8UC1);
+      cv::cvtColor(
+          cv_ptr->image, image_measurement->image, color_conversion_code);
+    } else {
+      // The converted image is owned by its cv::Mat and not by the message,
+      // hence it can be shared without a copy.
+      image_measurement->image = cv_ptr->image;
+    }
+  }
   image_measurement->timestamp =
       rosTimeToNanoseconds(image_message->header.stamp);
   image_measurement->camera_index = camera_idx;
@@ -26,6 +26,7 @@ class RovioliNode final {
       const vi_map::ImuSigmas& rovio_imu_sigmas,
       const std::string& save_map_folder,
       const summary_map::LocalizationSummaryMap* const localization_map,
+      const std::string& localization_tiled_map_folder,
       message_flow::MessageFlow* flow);
   ~RovioliNode();
 
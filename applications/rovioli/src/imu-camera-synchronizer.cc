@@ -32,7 +32,8 @@ ImuCameraSynchronizer::ImuCameraSynchronizer(
   CHECK(camera_system_ != nullptr);
   CHECK_GT(FLAGS_vio_nframe_sync_max_output_frequency_hz, 0.);
 
-  // Initialize the pipeline.
+  // Initialize the pipeline. The nframes share the images of the image
+  // measurements, which are in turn not copied from the datasource.
   static constexpr bool kCopyImages = false;
   std::vector<aslam::VisualPipeline::Ptr> mono_pipelines;
   for (size_t camera_idx = 0; camera_idx < camera_system_->getNumCameras();
@@ -0,0 +1,174 @@
+#include "rovioli/localization-landmark-index.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <aslam/cameras/camera.h>
+#include <glog/logging.h>
+
+namespace rovioli {
+
+namespace {
+// Every voxel coordinate is stored with 21 bits in the voxel key.
+constexpr int kNumBitsPerVoxelCoordinate = 21;
+constexpr int64_t kVoxelCoordinateOffset = 1
+                                           << (kNumBitsPerVoxelCoordinate - 1);
+constexpr uint64_t kVoxelCoordinateMask =
+    (1u << kNumBitsPerVoxelCoordinate) - 1u;
+}  // namespace
+
+LocalizationLandmarkIndex::LocalizationLandmarkIndex(
+    const summary_map::LocalizationSummaryMap& localization_summary_map,
+    const double voxel_size_meters)
+    : localization_summary_map_(localization_summary_map),
+      voxel_size_meters_(voxel_size_meters) {
+  CHECK_GT(voxel_size_meters_, 0.0);
+  const Eigen::Matrix3Xf& G_landmark_position =
+      localization_summary_map_.GLandmarkPosition();
+  const int num_landmarks = G_landmark_position.cols();
+  for (int landmark_idx = 0; landmark_idx < num_landmarks; ++landmark_idx) {
+    const Eigen::Vector3i voxel =
+        getVoxel(G_landmark_position.col(landmark_idx).cast<double>());
+    voxel_to_landmark_indices_[getVoxelKey(voxel)].push_back(landmark_idx);
+  }
+
+  // Group the observations by landmark.
+  const Eigen::Matrix<unsigned int, Eigen::Dynamic, 1>&
+      observation_to_landmark_index =
+          localization_summary_map_.observationToLandmarkIndex();
+  const int num_observations = observation_to_landmark_index.rows();
+  landmark_observations_begin_.assign(num_landmarks + 1, 0);
+  for (int i = 0; i < num_observations; ++i) {
+    const int landmark_idx = observation_to_landmark_index(i);
+    CHECK_LT(landmark_idx, num_landmarks);
+    ++landmark_observations_begin_[landmark_idx + 1];
+  }
+  for (int landmark_idx = 0; landmark_idx < num_landmarks; ++landmark_idx) {
+    landmark_observations_begin_[landmark_idx + 1] +=
+        landmark_observations_begin_[landmark_idx];
+  }
+  std::vector<int> next_observation(
+      landmark_observations_begin_.begin(),
+      landmark_observations_begin_.end() - 1);
+  observation_indices_.resize(num_observations);
+  for (int i = 0; i < num_observations; ++i) {
+    observation_indices_[next_observation[observation_to_landmark_index(i)]++] =
+        i;
+  }
+
+  VLOG(1) << "Spatial index with " << voxel_to_landmark_indices_.size()
+          << " voxels of " << voxel_size_meters_ << "m for " << num_landmarks
+          << " landmarks.";
+}
+
+LocalizationLandmarkIndex::VoxelKey LocalizationLandmarkIndex::getVoxelKey(
+    const Eigen::Vector3i& voxel) const {
+  VoxelKey key = 0u;
+  for (int i = 0; i < 3; ++i) {
+    const int64_t coordinate = voxel(i) + kVoxelCoordinateOffset;
+    CHECK_GE(coordinate, 0);
+    CHECK_LE(static_cast<uint64_t>(coordinate), kVoxelCoordinateMask)
+        << "The map is too large for a voxel size of " << voxel_size_meters_
+        << "m.";
+    key = (key << kNumBitsPerVoxelCoordinate) |
+          static_cast<uint64_t>(coordinate);
+  }
+  return key;
+}
+
+Eigen::Vector3i LocalizationLandmarkIndex::getVoxel(
+    const Eigen::Vector3d& p_G) const {
+  return (p_G / voxel_size_meters_)
+      .array()
+      .floor()
+      .cast<int>()
+      .matrix();
+}
+
+void LocalizationLandmarkIndex::getLandmarksWithinRadius(
+    const Eigen::Vector3d& p_G, const double radius_meters,
+    std::vector<int>* landmark_indices) const {
+  CHECK_NOTNULL(landmark_indices)->clear();
+  CHECK_GE(radius_meters, 0.0);
+  const Eigen::Matrix3Xf& G_landmark_position =
+      localization_summary_map_.GLandmarkPosition();
+  const double squared_radius = radius_meters * radius_meters;
+
+  const Eigen::Vector3i min_voxel =
+      getVoxel(p_G - Eigen::Vector3d::Constant(radius_meters));
+  const Eigen::Vector3i max_voxel =
+      getVoxel(p_G + Eigen::Vector3d::Constant(radius_meters));
+  Eigen::Vector3i voxel;
+  for (voxel.x() = min_voxel.x(); voxel.x() <= max_voxel.x(); ++voxel.x()) {
+    for (voxel.y() = min_voxel.y(); voxel.y() <= max_voxel.y(); ++voxel.y()) {
+      for (voxel.z() = min_voxel.z(); voxel.z() <= max_voxel.z();
+           ++voxel.z()) {
+        std::unordered_map<VoxelKey, std::vector<int>>::const_iterator it =
+            voxel_to_landmark_indices_.find(getVoxelKey(voxel));
+        if (it == voxel_to_landmark_indices_.end()) {
+          continue;
+        }
+        for (const int landmark_idx : it->second) {
+          if ((G_landmark_position.col(landmark_idx).cast<double>() - p_G)
+                  .squaredNorm() <= squared_radius) {
+            landmark_indices->push_back(landmark_idx);
+          }
+        }
+      }
+    }
+  }
+}
+
+void LocalizationLandmarkIndex::filterLandmarksOutsideOfFrustum(
+    const aslam::NCamera& ncamera, const aslam::Transformation& T_G_I,
+    std::vector<int>* landmark_indices) const {
+  CHECK_NOTNULL(landmark_indices);
+  const Eigen::Matrix3Xf& G_landmark_position =
+      localization_summary_map_.GLandmarkPosition();
+  const size_t num_cameras = ncamera.numCameras();
+  aslam::TransformationVector T_C_G(num_cameras);
+  for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
+    T_C_G[camera_idx] = ncamera.get_T_C_B(camera_idx) * T_G_I.inverse();
+  }
+
+  std::vector<int>::iterator new_end = std::remove_if(
+      landmark_indices->begin(), landmark_indices->end(),
+      [&](const int landmark_idx) {
+        const Eigen::Vector3d p_G_fi =
+            G_landmark_position.col(landmark_idx).cast<double>();
+        Eigen::Vector2d keypoint;
+        for (size_t camera_idx = 0u; camera_idx < num_cameras; ++camera_idx) {
+          if (ncamera.getCamera(camera_idx)
+                  .project3(T_C_G[camera_idx].transform(p_G_fi), &keypoint)
+                  .isKeypointVisible()) {
+            return false;
+          }
+        }
+        return true;
+      });
+  landmark_indices->erase(new_end, landmark_indices->end());
+}
+
+void LocalizationLandmarkIndex::getObservationsOfLandmarks(
+    const std::vector<int>& landmark_indices,
+    std::vector<int>* observation_indices) const {
+  CHECK_NOTNULL(observation_indices)->clear();
+  for (const int landmark_idx : landmark_indices) {
+    CHECK_GE(landmark_idx, 0);
+    CHECK_LT(
+        landmark_idx + 1,
+        static_cast<int>(landmark_observations_begin_.size()));
+    observation_indices->insert(
+        observation_indices->end(),
+        observation_indices_.begin() +
+            landmark_observations_begin_[landmark_idx],
+        observation_indices_.begin() +
+            landmark_observations_begin_[landmark_idx + 1]);
+  }
+}
+
+size_t LocalizationLandmarkIndex::numLandmarks() const {
+  return localization_summary_map_.GLandmarkPosition().cols();
+}
+
+}  // namespace rovioli
@@ -0,0 +1,293 @@
+#include "rovioli/localization-tile-manager.h"
+
+#include <algorithm>
+#include <utility>
+
+#include <aslam/common/timer.h>
+#include <glog/logging.h>
+
+namespace rovioli {
+
+namespace {
+summary_map::TiledLocalizationSummaryMapIndex loadTileIndexFromFolder(
+    const std::string& tiled_map_folder) {
+  summary_map::TiledLocalizationSummaryMapIndex index;
+  CHECK(
+      summary_map::loadTiledLocalizationSummaryMapIndexFromFolder(
+          tiled_map_folder, &index))
+      << "Loading the tiled summary map from \"" << tiled_map_folder
+      << "\" failed.";
+  return index;
+}
+}  // namespace
+
+LocalizationTileManager::LocalizationTileManager(
+    const std::string& tiled_map_folder, const double load_radius_meters,
+    const size_t memory_budget_bytes, const bool visualize_localization)
+    : LocalizationTileManager(
+          loadTileIndexFromFolder(tiled_map_folder),
+          [tiled_map_folder](
+              const summary_map::LocalizationSummaryMapTile& tile,
+              summary_map::LocalizationSummaryMap* summary_map) {
+            return summary_map::loadLocalizationSummaryMapTileFromFolder(
+                tiled_map_folder, tile, summary_map);
+          },
+          load_radius_meters, memory_budget_bytes, visualize_localization) {}
+
+LocalizationTileManager::LocalizationTileManager(
+    const summary_map::TiledLocalizationSummaryMapIndex& index,
+    const TileLoader& tile_loader, const double load_radius_meters,
+    const size_t memory_budget_bytes, const bool visualize_localization)
+    : index_(index),
+      tile_loader_(tile_loader),
+      load_radius_meters_(load_radius_meters),
+      memory_budget_bytes_(memory_budget_bytes),
+      visualize_localization_(visualize_localization),
+      tile_vocabulary_num_bytes_(
+          loop_detector_node::LoopDetectorNode().getVocabularyNumBytes()),
+      loaded_tiles_num_bytes_(0u),
+      requested_p_G_I_(Eigen::Vector3d::Zero()),
+      has_pending_request_(false),
+      is_updating_(false),
+      next_tile_index_(0u),
+      shutdown_(false) {
+  CHECK(tile_loader_);
+  CHECK_GT(index_.tile_size_meters, 0.0);
+  CHECK_GE(load_radius_meters_, 0.0);
+  CHECK_GT(memory_budget_bytes_, 0u);
+  LOG(INFO) << "Tiled localization map with " << index_.tiles.size()
+            << " tiles of " << index_.tile_size_meters << "m, "
+            << index_.getTotalNumBytes() / (1024 * 1024) << "MB in total, "
+            << "plus " << tile_vocabulary_num_bytes_ / 1024
+            << "kB of vocabulary per loaded tile.";
+
+  update_thread_ = std::thread(&LocalizationTileManager::updateWorker, this);
+}
+
+LocalizationTileManager::~LocalizationTileManager() {
+  shutdown();
+}
+
+void LocalizationTileManager::shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(m_request_);
+    shutdown_ = true;
+  }
+  cv_request_.notify_all();
+  cv_idle_.notify_all();
+  if (update_thread_.joinable()) {
+    update_thread_.join();
+  }
+}
+
+void LocalizationTileManager::setPosition(const Eigen::Vector3d& p_G_I) {
+  {
+    std::lock_guard<std::mutex> lock(m_request_);
+    requested_p_G_I_ = p_G_I;
+    has_pending_request_ = true;
+  }
+  cv_request_.notify_one();
+}
+
+void LocalizationTileManager::loadNextTiles() {
+  if (index_.tiles.empty()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_request_);
+    if (has_pending_request_ || is_updating_) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock_loaded_tiles(m_loaded_tiles_);
+      for (size_t i = 0u; i < index_.tiles.size(); ++i) {
+        const size_t tile_index =
+            (next_tile_index_ + i) % index_.tiles.size();
+        if (loaded_tiles_.count(tile_index) == 0u) {
+          next_tile_index_ = tile_index;
+          break;
+        }
+      }
+    }
+    const summary_map::LocalizationSummaryMapTile& tile =
+        index_.tiles[next_tile_index_];
+    next_tile_index_ = (next_tile_index_ + 1u) % index_.tiles.size();
+    requested_p_G_I_ << (tile.x + 0.5) * index_.tile_size_meters,
+        (tile.y + 0.5) * index_.tile_size_meters, 0.0;
+    has_pending_request_ = true;
+  }
+  cv_request_.notify_one();
+}
+
+void LocalizationTileManager::waitUntilIdle() {
+  std::unique_lock<std::mutex> lock(m_request_);
+  cv_idle_.wait(lock, [this]() {
+    return shutdown_.load() || (!has_pending_request_ && !is_updating_);
+  });
+}
+
+void LocalizationTileManager::getLoadedTiles(
+    LoadedTileList* loaded_tiles) const {
+  CHECK_NOTNULL(loaded_tiles)->clear();
+  std::lock_guard<std::mutex> lock(m_loaded_tiles_);
+  loaded_tiles->reserve(loaded_tiles_.size());
+  for (const std::pair<const size_t, LoadedTile::ConstPtr>& value :
+       loaded_tiles_) {
+    loaded_tiles->push_back(value.second);
+  }
+}
+
+size_t LocalizationTileManager::getNumLoadedTiles() const {
+  std::lock_guard<std::mutex> lock(m_loaded_tiles_);
+  return loaded_tiles_.size();
+}
+
+size_t LocalizationTileManager::getLoadedTilesNumBytes() const {
+  std::lock_guard<std::mutex> lock(m_loaded_tiles_);
+  return loaded_tiles_num_bytes_;
+}
+
+size_t LocalizationTileManager::getTileVocabularyNumBytes() const {
+  return tile_vocabulary_num_bytes_;
+}
+
+size_t LocalizationTileManager::getTileNumBytes(
+    const size_t tile_index) const {
+  CHECK_LT(tile_index, index_.tiles.size());
+  return index_.tiles[tile_index].num_bytes + tile_vocabulary_num_bytes_;
+}
+
+void LocalizationTileManager::updateWorker() {
+  while (true) {
+    Eigen::Vector3d p_G_I;
+    {
+      std::unique_lock<std::mutex> lock(m_request_);
+      cv_request_.wait(lock, [this]() {
+        return shutdown_.load() || has_pending_request_;
+      });
+      if (shutdown_) {
+        return;
+      }
+      p_G_I = requested_p_G_I_;
+      has_pending_request_ = false;
+      is_updating_ = true;
+    }
+
+    updateLoadedTiles(p_G_I);
+
+    {
+      std::lock_guard<std::mutex> lock(m_request_);
+      is_updating_ = false;
+    }
+    cv_idle_.notify_all();
+  }
+}
+
+void LocalizationTileManager::selectTiles(
+    const Eigen::Vector3d& p_G_I, std::vector<size_t>* tile_indices) const {
+  CHECK_NOTNULL(tile_indices)->clear();
+
+  std::vector<std::pair<double, size_t>> distance_and_tile_index;
+  for (size_t i = 0u; i < index_.tiles.size(); ++i) {
+    const double distance =
+        index_.tiles[i].getDistanceToTile(p_G_I, index_.tile_size_meters);
+    if (distance <= load_radius_meters_) {
+      distance_and_tile_index.emplace_back(distance, i);
+    }
+  }
+  std::sort(distance_and_tile_index.begin(), distance_and_tile_index.end());
+
+  size_t num_bytes = 0u;
+  for (const std::pair<double, size_t>& value : distance_and_tile_index) {
+    const size_t tile_num_bytes = getTileNumBytes(value.second);
+    if (num_bytes + tile_num_bytes > memory_budget_bytes_) {
+      LOG_IF(WARNING, tile_indices->empty())
+          << "The closest tile " << index_.tiles[value.second].folder_name
+          << " (" << tile_num_bytes << " bytes) doesn't fit into the memory "
+          << "budget of " << memory_budget_bytes_ << " bytes.";
+      break;
+    }
+    num_bytes += tile_num_bytes;
+    tile_indices->push_back(value.second);
+  }
+}
+
+LocalizationTileManager::LoadedTile::Ptr LocalizationTileManager::loadTile(
+    const size_t tile_index) const {
+  CHECK_LT(tile_index, index_.tiles.size());
+  const summary_map::LocalizationSummaryMapTile& tile =
+      index_.tiles[tile_index];
+  timing::Timer timer("LocalizationTileManager: load tile");
+
+  LoadedTile::Ptr loaded_tile(new LoadedTile);
+  loaded_tile->tile_index = tile_index;
+  loaded_tile->summary_map.reset(new summary_map::LocalizationSummaryMap);
+  if (!tile_loader_(tile, loaded_tile->summary_map.get())) {
+    LOG(ERROR) << "Loading tile " << tile.folder_name << " failed.";
+    return nullptr;
+  }
+
+  loaded_tile->loop_detector.reset(new loop_detector_node::LoopDetectorNode);
+  if (visualize_localization_) {
+    loaded_tile->loop_detector->instantiateVisualizer();
+  }
+  if (!loaded_tile->loop_detector->addLocalizationSummaryMapToDatabase(
+          *loaded_tile->summary_map)) {
+    LOG(ERROR) << "Adding tile " << tile.folder_name
+               << " to the localization database failed.";
+    return nullptr;
+  }
+  timer.Stop();
+  VLOG(1) << "Loaded tile " << tile.folder_name << " with "
+          << tile.num_landmarks << " landmarks.";
+  return loaded_tile;
+}
+
+void LocalizationTileManager::updateLoadedTiles(const Eigen::Vector3d& p_G_I) {
+  std::vector<size_t> selected_tile_indices;
+  selectTiles(p_G_I, &selected_tile_indices);
+
+  // Evict first such that the memory budget also holds while loading.
+  {
+    std::lock_guard<std::mutex> lock(m_loaded_tiles_);
+    for (std::unordered_map<size_t, LoadedTile::ConstPtr>::iterator it =
+             loaded_tiles_.begin();
+         it != loaded_tiles_.end();) {
+      if (std::find(
+              selected_tile_indices.begin(), selected_tile_indices.end(),
+              it->first) == selected_tile_indices.end()) {
+        VLOG(1) << "Evicting tile " << index_.tiles[it->first].folder_name
+                << ".";
+        loaded_tiles_num_bytes_ -= getTileNumBytes(it->first);
+        it = loaded_tiles_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  for (const size_t tile_index : selected_tile_indices) {
+    {
+      std::lock_guard<std::mutex> lock(m_loaded_tiles_);
+      if (loaded_tiles_.count(tile_index) > 0u) {
+        continue;
+      }
+    }
+    {
+      // Stop early if a newer position is pending; it gets processed next.
+      std::lock_guard<std::mutex> lock(m_request_);
+      if (shutdown_ || has_pending_request_) {
+        return;
+      }
+    }
+
+    LoadedTile::ConstPtr loaded_tile = loadTile(tile_index);
+    if (loaded_tile) {
+      std::lock_guard<std::mutex> lock(m_loaded_tiles_);
+      loaded_tiles_.emplace(tile_index, loaded_tile);
+      loaded_tiles_num_bytes_ += getTileNumBytes(tile_index);
+    }
+  }
+}
+
+}  // namespace rovioli
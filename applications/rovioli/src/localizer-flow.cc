@@ -0,0 +1,130 @@
+#include "rovioli/localizer-flow.h"
+
+#include <utility>
+
+#include <aslam/common/statistics/statistics.h>
+#include <aslam/common/time.h>
+#include <glog/logging.h>
+
+namespace rovioli {
+
+LocalizerFlow::LocalizerFlow(
+    const summary_map::LocalizationSummaryMap& localization_map,
+    const bool visualize_localization)
+    : localizer_(localization_map, visualize_localization),
+      pending_nframe_received_time_ns_(aslam::time::getInvalidTime()),
+      shutdown_(false) {}
+
+LocalizerFlow::LocalizerFlow(LocalizationTileManager::UniquePtr tile_manager)
+    : localizer_(std::move(tile_manager)),
+      pending_nframe_received_time_ns_(aslam::time::getInvalidTime()),
+      shutdown_(false) {}
+
+LocalizerFlow::~LocalizerFlow() {
+  shutdown();
+}
+
+void LocalizerFlow::attachToMessageFlow(message_flow::MessageFlow* flow) {
+  CHECK_NOTNULL(flow);
+  CHECK(!localization_thread_.joinable()) << "Already attached.";
+  static constexpr char kSubscriberNodeName[] = "LocalizerFlow";
+
+  publish_result_ =
+      flow->registerPublisher<message_flow_topics::LOCALIZATION_RESULT>();
+
+  // The subscriber only hands the nframe over to the localization thread such
+  // that the message flow is never blocked by a running localization.
+  flow->registerSubscriber<
+      message_flow_topics::THROTTLED_TRACKED_NFRAMES_AND_IMU>(
+      kSubscriberNodeName, message_flow::DeliveryOptions(),
+      [this](const vio::SynchronizedNFrameImu::ConstPtr& nframe_imu) {
+        CHECK(nframe_imu);
+        this->queueNFrame(nframe_imu);
+      });
+
+  // Keep the pose prior for map tracking and the loaded tiles up to date
+  // with the current global pose estimate.
+  flow->registerSubscriber<message_flow_topics::ROVIO_ESTIMATES>(
+      kSubscriberNodeName, message_flow::DeliveryOptions(),
+      [this](const RovioEstimate::ConstPtr& estimate) {
+        CHECK(estimate);
+        if (estimate->has_T_G_M) {
+          this->localizer_.setPosePrior(
+              estimate->T_G_M * estimate->vinode.get_T_M_I());
+        }
+      });
+
+  localization_thread_ =
+      std::thread(&LocalizerFlow::localizationWorker, this);
+}
+
+void LocalizerFlow::shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(m_pending_nframe_);
+    shutdown_ = true;
+  }
+  cv_pending_nframe_.notify_all();
+  if (localization_thread_.joinable()) {
+    localization_thread_.join();
+  }
+}
+
+void LocalizerFlow::queueNFrame(
+    const vio::SynchronizedNFrameImu::ConstPtr& nframe_imu) {
+  CHECK(nframe_imu);
+  bool skipped_pending_nframe;
+  {
+    std::lock_guard<std::mutex> lock(m_pending_nframe_);
+    skipped_pending_nframe = pending_nframe_imu_ != nullptr;
+    pending_nframe_imu_ = nframe_imu;
+    pending_nframe_received_time_ns_ = aslam::time::nanoSecondsSinceEpoch();
+  }
+  cv_pending_nframe_.notify_one();
+
+  // The mean of this statistic is the fraction of skipped nframes.
+  statistics::StatsCollector stats_skipped("Localizer: skipped nframes");
+  stats_skipped.AddSample(skipped_pending_nframe ? 1.0 : 0.0);
+  VLOG_IF(3, skipped_pending_nframe)
+      << "Localization is falling behind, skipped an nframe.";
+}
+
+void LocalizerFlow::localizationWorker() {
+  statistics::StatsCollector stats_age("Localizer: result age [s]");
+  statistics::StatsCollector stats_success("Localizer: success rate");
+  while (true) {
+    vio::SynchronizedNFrameImu::ConstPtr nframe_imu;
+    int64_t received_time_ns;
+    {
+      std::unique_lock<std::mutex> lock(m_pending_nframe_);
+      cv_pending_nframe_.wait(lock, [this]() {
+        return shutdown_.load() || pending_nframe_imu_ != nullptr;
+      });
+      if (shutdown_) {
+        return;
+      }
+      nframe_imu = std::move(pending_nframe_imu_);
+      pending_nframe_imu_.reset();
+      received_time_ns = pending_nframe_received_time_ns_;
+    }
+    CHECK(nframe_imu);
+
+    // The result is stamped with the time of the nframe, so ROVIO can apply
+    // it at the correct point in its history regardless of the latency.
+    vio::LocalizationResult::Ptr loc_result(new vio::LocalizationResult);
+    const bool success =
+        localizer_.localizeNFrame(nframe_imu->nframe, loc_result.get());
+    stats_success.AddSample(success ? 1.0 : 0.0);
+    if (!success) {
+      continue;
+    }
+
+    // Wall time between receiving the nframe and publishing its result.
+    stats_age.AddSample(
+        aslam::time::nanoSecondsToSeconds(
+            aslam::time::nanoSecondsSinceEpoch() - received_time_ns));
+    CHECK(publish_result_);
+    publish_result_(loc_result);
+  }
+}
+
+}  // namespace rovioli
@@ -1,17 +1,50 @@
 #include "rovioli/localizer.h"
 
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <aslam/common/statistics/statistics.h>
+#include <aslam/common/timer.h>
+#include <gflags/gflags.h>
 #include <localization-summary-map/localization-summary-map.h>
 #include <loop-closure-handler/loop-detector-node.h>
+#include <maplab-common/mapped-memory.h>
 #include <vio-common/vio-types.h>
 
+DEFINE_bool(
+    rovioli_localization_map_tracking, true,
+    "If, once localized, only the landmarks around the current pose estimate "
+    "should be considered for localization. Only supported for non-tiled "
+    "localization maps.");
+DEFINE_double(
+    rovioli_map_tracking_radius_m, 30.0,
+    "Radius around the pose estimate within which landmarks are considered "
+    "during map tracking.");
+DEFINE_int32(
+    rovioli_map_tracking_min_num_landmarks, 20,
+    "Minimum number of landmarks within the field of view required for map "
+    "tracking. The global search is used otherwise.");
+DEFINE_string(
+    rovioli_shared_localization_database, "",
+    "Name of a POSIX shared memory object, e.g. /rovioli_localization, through "
+    "which ROVIOLI processes that localize against the same summary map share "
+    "a single read-only localization database. The first process builds and "
+    "publishes the database, the following ones attach to it. Empty disables "
+    "sharing.");
+
 namespace rovioli {
 
+namespace {
+constexpr double kLandmarkIndexVoxelSizeMeters = 5.0;
+}  // namespace
+
 Localizer::Localizer(
     const summary_map::LocalizationSummaryMap& localization_summary_map,
     const bool visualize_localization)
-    : localization_summary_map_(localization_summary_map) {
-  current_localization_mode_ = Localizer::LocalizationMode::kGlobal;
-
+    : current_localization_mode_(Localizer::LocalizationMode::kGlobal),
+      has_T_G_I_prior_(false),
+      localization_summary_map_(&localization_summary_map) {
   global_loop_detector_.reset(new loop_detector_node::LoopDetectorNode);
 
   CHECK(global_loop_detector_ != nullptr);
@@ -19,58 +52,219 @@ Localizer::Localizer(
     global_loop_detector_->instantiateVisualizer();
   }
 
-  LOG(INFO) << "Creating localization database...";
-  global_loop_detector_->addLocalizationSummaryMapToDatabase(
-      localization_summary_map_);
+  const common::MappedMemory::Type kSharedMemory =
+      common::MappedMemory::Type::kSharedMemory;
+  const std::string& shared_database_name =
+      FLAGS_rovioli_shared_localization_database;
+  if (!shared_database_name.empty() &&
+      global_loop_detector_->attachMappedDatabase(
+          kSharedMemory, shared_database_name, *localization_summary_map_)) {
+    LOG(INFO) << "Attached to the shared localization database "
+              << shared_database_name << ".";
+  } else {
+    LOG(INFO) << "Creating localization database...";
+    if (!global_loop_detector_->addLocalizationSummaryMapToDatabase(
+            *localization_summary_map_)) {
+      LOG(ERROR) << "The localization map can't be used with the current "
+                 << "loop-closure backend, global localization will fail.";
+    } else if (
+        !shared_database_name.empty() &&
+        !global_loop_detector_->publishMappedDatabase(
+            kSharedMemory, shared_database_name)) {
+      LOG(WARNING) << "Failed to publish the shared localization database "
+                   << shared_database_name << ".";
+    }
+  }
+  if (FLAGS_rovioli_localization_map_tracking) {
+    landmark_index_.reset(
+        new LocalizationLandmarkIndex(
+            *localization_summary_map_, kLandmarkIndexVoxelSizeMeters));
+  }
   LOG(INFO) << "Done.";
 }
 
+Localizer::Localizer(LocalizationTileManager::UniquePtr tile_manager)
+    : current_localization_mode_(Localizer::LocalizationMode::kGlobal),
+      has_T_G_I_prior_(false),
+      localization_summary_map_(nullptr),
+      tile_manager_(std::move(tile_manager)) {
+  CHECK(tile_manager_);
+
+  // Without any prior, start with the tiles around the origin of the map,
+  // which usually coincides with the start of the mapping run. The global
+  // search goes through the remaining tiles until the first localization.
+  LOG(INFO) << "Loading the initial localization tiles...";
+  tile_manager_->setPosition(Eigen::Vector3d::Zero());
+  tile_manager_->waitUntilIdle();
+  LOG(INFO) << "Done, loaded " << tile_manager_->getNumLoadedTiles()
+            << " tiles.";
+}
+
 Localizer::LocalizationMode Localizer::getCurrentLocalizationMode() const {
+  std::lock_guard<std::mutex> lock(m_localization_state_);
   return current_localization_mode_;
 }
 
+bool Localizer::isTiled() const {
+  return tile_manager_ != nullptr;
+}
+
+void Localizer::setPosePrior(const aslam::Transformation& T_G_I) {
+  if (tile_manager_ != nullptr) {
+    tile_manager_->setPosition(T_G_I.getPosition());
+  }
+  std::lock_guard<std::mutex> lock(m_localization_state_);
+  T_G_I_prior_ = T_G_I;
+  has_T_G_I_prior_ = true;
+}
+
 bool Localizer::localizeNFrame(
     const aslam::VisualNFrame::ConstPtr& nframe,
-    vio::LocalizationResult* localization_result) const {
+    vio::LocalizationResult* localization_result) {
   CHECK(nframe);
   CHECK_NOTNULL(localization_result);
 
+  LocalizationMode localization_mode = getCurrentLocalizationMode();
   bool result = false;
-  switch (current_localization_mode_) {
+  switch (localization_mode) {
     case Localizer::LocalizationMode::kGlobal:
       result = localizeNFrameGlobal(nframe, &localization_result->T_G_I_lc_pnp);
       break;
     case Localizer::LocalizationMode::kMapTracking:
       result =
           localizeNFrameMapTracking(nframe, &localization_result->T_G_I_lc_pnp);
+      if (!result) {
+        VLOG(1) << "Map tracking failed, falling back to global localization.";
+        localization_mode = Localizer::LocalizationMode::kGlobal;
+        result =
+            localizeNFrameGlobal(nframe, &localization_result->T_G_I_lc_pnp);
+      }
       break;
     default:
       LOG(FATAL) << "Unknown localization mode.";
       break;
   }
+  updateLocalizationState(result, localization_result->T_G_I_lc_pnp);
 
   localization_result->timestamp = nframe->getMinTimestampNanoseconds();
   localization_result->nframe_id = nframe->getId();
-  localization_result->localization_type = current_localization_mode_;
+  localization_result->localization_type = localization_mode;
   return result;
 }
 
+void Localizer::updateLocalizationState(
+    const bool localization_success,
+    const aslam::Transformation& T_G_I_lc_pnp) {
+  std::lock_guard<std::mutex> lock(m_localization_state_);
+  if (localization_success) {
+    T_G_I_prior_ = T_G_I_lc_pnp;
+    has_T_G_I_prior_ = true;
+  }
+  if (localization_success && landmark_index_ != nullptr) {
+    current_localization_mode_ = Localizer::LocalizationMode::kMapTracking;
+  } else {
+    current_localization_mode_ = Localizer::LocalizationMode::kGlobal;
+  }
+}
+
 bool Localizer::localizeNFrameGlobal(
     const aslam::VisualNFrame::ConstPtr& nframe,
-    aslam::Transformation* T_G_I_lc_pnp) const {
+    aslam::Transformation* T_G_I_lc_pnp) {
+  if (tile_manager_ != nullptr) {
+    return localizeNFrameGlobalTiled(nframe, T_G_I_lc_pnp);
+  }
+  CHECK_NOTNULL(localization_summary_map_);
   constexpr bool kSkipUntrackedKeypoints = false;
   unsigned int num_lc_matches;
   vi_map::VertexKeyPointToStructureMatchList inlier_structure_matches;
   return global_loop_detector_->findNFrameInSummaryMapDatabase(
-      *nframe, kSkipUntrackedKeypoints, localization_summary_map_, T_G_I_lc_pnp,
-      &num_lc_matches, &inlier_structure_matches);
+      *nframe, kSkipUntrackedKeypoints, *localization_summary_map_,
+      T_G_I_lc_pnp, &num_lc_matches, &inlier_structure_matches);
+}
+
+bool Localizer::localizeNFrameGlobalTiled(
+    const aslam::VisualNFrame::ConstPtr& nframe,
+    aslam::Transformation* T_G_I_lc_pnp) {
+  CHECK_NOTNULL(T_G_I_lc_pnp);
+  CHECK(tile_manager_);
+  LocalizationTileManager::LoadedTileList loaded_tiles;
+  tile_manager_->getLoadedTiles(&loaded_tiles);
+
+  // Every tile has its own database; keep the result with the most inliers.
+  constexpr bool kSkipUntrackedKeypoints = false;
+  unsigned int max_num_lc_matches = 0u;
+  for (const LocalizationTileManager::LoadedTile::ConstPtr& tile :
+       loaded_tiles) {
+    CHECK(tile);
+    aslam::Transformation T_G_I;
+    unsigned int num_lc_matches = 0u;
+    vi_map::VertexKeyPointToStructureMatchList inlier_structure_matches;
+    if (tile->loop_detector->findNFrameInSummaryMapDatabase(
+            *nframe, kSkipUntrackedKeypoints, *tile->summary_map, &T_G_I,
+            &num_lc_matches, &inlier_structure_matches) &&
+        num_lc_matches > max_num_lc_matches) {
+      max_num_lc_matches = num_lc_matches;
+      *T_G_I_lc_pnp = T_G_I;
+    }
+  }
+
+  if (max_num_lc_matches == 0u) {
+    bool has_T_G_I_prior;
+    {
+      std::lock_guard<std::mutex> lock(m_localization_state_);
+      has_T_G_I_prior = has_T_G_I_prior_;
+    }
+    if (!has_T_G_I_prior) {
+      tile_manager_->loadNextTiles();
+    }
+    return false;
+  }
+  tile_manager_->setPosition(T_G_I_lc_pnp->getPosition());
+  return true;
 }
 
 bool Localizer::localizeNFrameMapTracking(
-    const aslam::VisualNFrame::ConstPtr& /*nframe*/,
-    aslam::Transformation* /*T_G_I_lc_pnp*/) const {
-  LOG(FATAL) << "Not implemented yet.";
-  return false;
+    const aslam::VisualNFrame::ConstPtr& nframe,
+    aslam::Transformation* T_G_I_lc_pnp) const {
+  CHECK(nframe);
+  CHECK_NOTNULL(T_G_I_lc_pnp);
+  CHECK(landmark_index_);
+  CHECK_NOTNULL(localization_summary_map_);
+
+  aslam::Transformation T_G_I_prior;
+  {
+    std::lock_guard<std::mutex> lock(m_localization_state_);
+    CHECK(has_T_G_I_prior_);
+    T_G_I_prior = T_G_I_prior_;
+  }
+
+  // Only consider the landmarks around the prior that can be visible from it.
+  timing::Timer timer_select("Localizer: map tracking select landmarks");
+  std::vector<int> landmark_indices;
+  landmark_index_->getLandmarksWithinRadius(
+      T_G_I_prior.getPosition(), FLAGS_rovioli_map_tracking_radius_m,
+      &landmark_indices);
+  landmark_index_->filterLandmarksOutsideOfFrustum(
+      *nframe->getNCameraShared(), T_G_I_prior, &landmark_indices);
+  statistics::StatsCollector stats_num_landmarks(
+      "Localizer: map tracking num landmarks");
+  stats_num_landmarks.AddSample(landmark_indices.size());
+  if (static_cast<int>(landmark_indices.size()) <
+      FLAGS_rovioli_map_tracking_min_num_landmarks) {
+    return false;
+  }
+  std::vector<int> observation_indices;
+  landmark_index_->getObservationsOfLandmarks(
+      landmark_indices, &observation_indices);
+  timer_select.Stop();
+
+  constexpr bool kSkipUntrackedKeypoints = false;
+  unsigned int num_lc_matches;
+  vi_map::VertexKeyPointToStructureMatchList inlier_structure_matches;
+  return global_loop_detector_->findNFrameInSummaryMapObservations(
+      *nframe, kSkipUntrackedKeypoints, *localization_summary_map_,
+      observation_indices, T_G_I_lc_pnp, &num_lc_matches,
+      &inlier_structure_matches);
 }
 
 }  // namespace rovioli
@@ -2,14 +2,17 @@
 
 #include <functional>
 
+#include <aslam/common/time.h>
 #include <landmark-triangulation/landmark-triangulation.h>
 #include <localization-summary-map/localization-summary-map-creation.h>
 #include <localization-summary-map/localization-summary-map.h>
+#include <loop-closure-handler/loop-detector-node.h>
 #include <maplab-common/file-logger.h>
 #include <maplab-common/map-manager-config.h>
 #include <mapping-workflows-plugin/localization-map-creation.h>
 #include <vi-map-helpers/vi-map-landmark-quality-evaluation.h>
 #include <vi-map-helpers/vi-map-manipulation.h>
+#include <vi-map-helpers/vi-map-memory-statistics.h>
 #include <vi-map/vi-map-serialization.h>
 #include <vi-map/vi-map.h>
 #include <visualization/viwls-graph-plotter.h>
@@ -17,7 +20,13 @@
 DEFINE_double(
     localization_map_keep_landmark_fraction, 0.0,
     "Fraction of landmarks to keep when creating a localization summary map.");
+DEFINE_double(
+    rovioli_log_map_memory_every_s, 0.0,
+    "Period in seconds at which the memory statistics of the map that is being "
+    "built are logged. (0: disabled)");
 DECLARE_bool(rovioli_visualize_map);
+DECLARE_bool(lc_precompute_summary_map_word_indices);
+DECLARE_bool(lc_product_quantize_summary_map);
 
 namespace rovioli {
 
@@ -25,6 +34,7 @@ MapBuilderFlow::MapBuilderFlow(
     const std::shared_ptr<aslam::NCamera>& n_camera, vi_map::Imu::UniquePtr imu,
     const std::string& save_map_folder)
     : map_with_mutex_(aligned_shared<VIMapWithMutex>()),
+      last_memory_statistics_time_ns_(aslam::time::getInvalidTime()),
       mapping_terminated_(false),
       stream_map_builder_(n_camera, std::move(imu), &map_with_mutex_->vi_map) {
   if (!save_map_folder.empty()) {
@@ -53,6 +63,7 @@ void MapBuilderFlow::attachToMessageFlow(message_flow::MessageFlow* flow) {
           // added to the map might still be modified.
           constexpr bool kDeepCopyNFrame = false;
           stream_map_builder_.apply(*vio_update, kDeepCopyNFrame);
+          logMapMemoryStatisticsIfDue();
         }
         map_publish_function(map_with_mutex_);
       });
@@ -87,6 +98,25 @@ void MapBuilderFlow::attachToMessageFlow(message_flow::MessageFlow* flow) {
           std::placeholders::_1));
 }
 
+void MapBuilderFlow::logMapMemoryStatisticsIfDue() {
+  if (FLAGS_rovioli_log_map_memory_every_s <= 0.0) {
+    return;
+  }
+  const int64_t now_ns = aslam::time::nanoSecondsSinceEpoch();
+  if (aslam::time::isValidTime(last_memory_statistics_time_ns_) &&
+      aslam::time::nanoSecondsToSeconds(
+          now_ns - last_memory_statistics_time_ns_) <
+          FLAGS_rovioli_log_map_memory_every_s) {
+    return;
+  }
+  last_memory_statistics_time_ns_ = now_ns;
+
+  // The map is locked meanwhile, so keep some cores for the estimator.
+  constexpr size_t kNumThreads = 2u;
+  vi_map_helpers::logVIMapMemoryStatistics(
+      map_with_mutex_->vi_map, kNumThreads);
+}
+
 void MapBuilderFlow::saveMapAndOptionallyOptimize(
     const std::string& path, const bool overwrite_existing_map,
     const bool process_to_localization_map) {
@@ -155,6 +185,18 @@ void MapBuilderFlow::saveMapAndOptionallyOptimize(
           map_with_mutex_->vi_map, localization_map.get());
     }
 
+    if (FLAGS_lc_product_quantize_summary_map) {
+      loop_detector_node::LoopDetectorNode loop_detector;
+      loop_detector.productQuantizeLocalizationSummaryMap(
+          localization_map.get());
+    } else if (FLAGS_lc_precompute_summary_map_word_indices) {
+      // Store the visual word assignment such that the localization index can
+      // be built without quantizing all descriptors again on startup.
+      loop_detector_node::LoopDetectorNode loop_detector;
+      loop_detector.computeLocalizationSummaryMapWordIndices(
+          localization_map.get());
+    }
+
     std::string localization_map_path = path + "_localization";
     localization_map->saveToFolder(localization_map_path, save_config);
     LOG(INFO) << "Localization summary map saved to: " << localization_map_path;
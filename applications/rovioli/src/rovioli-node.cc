@@ -1,6 +1,7 @@
 #include "rovioli/rovioli-node.h"
 
 #include <string>
+#include <utility>
 
 #include <aslam/cameras/ncamera.h>
 #include <localization-summary-map/localization-summary-map.h>
@@ -11,6 +12,7 @@
 #include "rovioli/datasource-flow.h"
 #include "rovioli/feature-tracking-flow.h"
 #include "rovioli/imu-camera-synchronizer-flow.h"
+#include "rovioli/localization-tile-manager.h"
 #include "rovioli/localizer-flow.h"
 #include "rovioli/rovio-flow.h"
 #include "rovioli/synced-nframe-throttler-flow.h"
@@ -19,6 +21,15 @@ DEFINE_bool(
     rovioli_run_map_builder, true,
     "When set to false, the map builder will be deactivated and no map will be "
     "built. Rovio+Localization will still run as usual.");
+DEFINE_double(
+    rovioli_localization_tile_radius_m, 100.0,
+    "Tiles of a tiled localization map within this distance of the current "
+    "position estimate are loaded [m].");
+DEFINE_int32(
+    rovioli_localization_tile_memory_budget_mb, 1024,
+    "Maximum memory used by the loaded tiles of a tiled localization map, "
+    "including the vocabulary of their databases [MB]. The closest tiles are "
+    "loaded first.");
 
 namespace rovioli {
 RovioliNode::RovioliNode(
@@ -27,9 +38,12 @@ RovioliNode::RovioliNode(
     const vi_map::ImuSigmas& rovio_imu_sigmas,
     const std::string& save_map_folder,
     const summary_map::LocalizationSummaryMap* const localization_map,
+    const std::string& localization_tiled_map_folder,
     message_flow::MessageFlow* flow)
     : is_datasource_exhausted_(false) {
-  // localization_summary_map is optional and can be a nullptr.
+  // localization_summary_map is optional and can be a nullptr. Alternatively,
+  // a tiled localization map can be provided.
+  CHECK(localization_map == nullptr || localization_tiled_map_folder.empty());
   CHECK(camera_system);
   CHECK(maplab_imu_sensor);
   CHECK_NOTNULL(flow);
@@ -43,14 +57,28 @@ RovioliNode::RovioliNode(
   rovio_flow_.reset(new RovioFlow(*camera_system, rovio_imu_sigmas));
   rovio_flow_->attachToMessageFlow(flow);
 
-  const bool localization_enabled = localization_map != nullptr;
+  const bool localization_enabled =
+      localization_map != nullptr || !localization_tiled_map_folder.empty();
   if (FLAGS_rovioli_run_map_builder || localization_enabled) {
     // If there's no localization and no map should be built, no maplab feature
     // tracking is needed.
-    if (localization_enabled) {
-      constexpr bool kVisualizeLocalization = true;
+    constexpr bool kVisualizeLocalization = true;
+    if (localization_map != nullptr) {
       localizer_flow_.reset(
           new LocalizerFlow(*localization_map, kVisualizeLocalization));
+    } else if (!localization_tiled_map_folder.empty()) {
+      CHECK_GT(FLAGS_rovioli_localization_tile_memory_budget_mb, 0);
+      constexpr size_t kBytesPerMegabyte = 1024u * 1024u;
+      LocalizationTileManager::UniquePtr tile_manager(
+          new LocalizationTileManager(
+              localization_tiled_map_folder,
+              FLAGS_rovioli_localization_tile_radius_m,
+              FLAGS_rovioli_localization_tile_memory_budget_mb *
+                  kBytesPerMegabyte,
+              kVisualizeLocalization));
+      localizer_flow_.reset(new LocalizerFlow(std::move(tile_manager)));
+    }
+    if (localizer_flow_) {
       localizer_flow_->attachToMessageFlow(flow);
     }
 
@@ -108,6 +136,12 @@ void RovioliNode::start() {
 void RovioliNode::shutdown() {
   datasource_flow_->shutdown();
   VLOG(1) << "Closing data source...";
+  // The localization thread publishes into the message flow, it has to be
+  // stopped before the flow is shut down.
+  if (localizer_flow_) {
+    localizer_flow_->shutdown();
+    VLOG(1) << "Stopped localization thread.";
+  }
 }
 
 std::atomic<bool>& RovioliNode::isDataSourceExhausted() {
@@ -1,13 +1,24 @@
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <gflags/gflags.h>
 #include <gtest/gtest.h>
 #include <localization-summary-map/localization-summary-map-creation.h>
+#include <localization-summary-map/localization-summary-map-tiling.h>
 #include <localization-summary-map/localization-summary-map.h>
+#include <loop-closure-handler/loop-detector-node.h>
 #include <maplab-common/test/testing-entrypoint.h>
 #include <maplab-common/test/testing-predicates.h>
 #include <vi-mapping-test-app/vi-mapping-test-app.h>
 #include <vio-common/vio-types.h>
 
+#include "rovioli/localization-landmark-index.h"
+#include "rovioli/localization-tile-manager.h"
 #include "rovioli/localizer.h"
 
+DECLARE_bool(rovioli_localization_map_tracking);
+
 namespace rovioli {
 
 class ViMappingTest : public ::testing::Test {
@@ -16,7 +27,7 @@ class ViMappingTest : public ::testing::Test {
     test_app_.loadDataset("./test_maps/vi_app_test");
   }
 
-  void createSummaryMapAndInitLocalizer() {
+  void createSummaryMap() {
     const vi_map::VIMap& vi_map = *test_app_.getMapMutable();
 
     vi_map::LandmarkIdList landmark_ids;
@@ -27,23 +38,134 @@ class ViMappingTest : public ::testing::Test {
     CHECK_EQ(
         summary_map_.GLandmarkPosition().cols(),
         static_cast<int>(vi_map.numLandmarks()));
+  }
+
+  void precomputeSummaryMapWordIndices() {
+    loop_detector_node::LoopDetectorNode loop_detector;
+    CHECK(loop_detector.computeLocalizationSummaryMapWordIndices(
+        &summary_map_));
+  }
 
+  void initLocalizer() {
     constexpr bool kVisualizeLocalization = false;
     localizer_.reset(new Localizer(summary_map_, kVisualizeLocalization));
   }
 
+  // Splits the summary map into roughly kNumTilesPerAxis^2 tiles.
+  void createTiledSummaryMap() {
+    constexpr double kNumTilesPerAxis = 3.0;
+    const Eigen::Matrix3Xf& G_landmark_position =
+        summary_map_.GLandmarkPosition();
+    const Eigen::Vector2f extent =
+        G_landmark_position.topRows<2>().rowwise().maxCoeff() -
+        G_landmark_position.topRows<2>().rowwise().minCoeff();
+    const double tile_size_meters = extent.maxCoeff() / kNumTilesPerAxis;
+    CHECK_GT(tile_size_meters, 0.0);
+    summary_map::createTiledLocalizationSummaryMap(
+        summary_map_, tile_size_meters, &tile_index_, &tiles_);
+    CHECK_GT(tiles_.size(), 1u);
+  }
+
+  LocalizationTileManager::UniquePtr createTileManager(
+      const double load_radius_meters, const size_t memory_budget_bytes) {
+    CHECK_EQ(tile_index_.tiles.size(), tiles_.size());
+    const std::vector<summary_map::LocalizationSummaryMap::Ptr>& tiles = tiles_;
+    const summary_map::TiledLocalizationSummaryMapIndex& index = tile_index_;
+    LocalizationTileManager::TileLoader tile_loader = [&tiles, &index](
+        const summary_map::LocalizationSummaryMapTile& tile,
+        summary_map::LocalizationSummaryMap* summary_map) {
+      for (size_t i = 0u; i < index.tiles.size(); ++i) {
+        if (index.tiles[i].folder_name == tile.folder_name) {
+          *summary_map = *tiles[i];
+          return true;
+        }
+      }
+      return false;
+    };
+    constexpr bool kVisualizeLocalization = false;
+    return LocalizationTileManager::UniquePtr(
+        new LocalizationTileManager(
+            tile_index_, tile_loader, load_radius_meters, memory_budget_bytes,
+            kVisualizeLocalization));
+  }
+
+  // Returns the tile manager, which is owned by the localizer.
+  LocalizationTileManager* initTiledLocalizer(
+      const double load_radius_meters, const size_t memory_budget_bytes) {
+    LocalizationTileManager::UniquePtr tile_manager =
+        createTileManager(load_radius_meters, memory_budget_bytes);
+    LocalizationTileManager* tile_manager_ptr = tile_manager.get();
+    localizer_.reset(new Localizer(std::move(tile_manager)));
+    return tile_manager_ptr;
+  }
+
+  // Localizes the given vertex until it succeeds, at most max_num_attempts
+  // times, and lets the tile manager finish loading after every attempt.
+  bool localizeVertexRepeatedly(
+      const size_t vertex_index, const size_t max_num_attempts,
+      LocalizationTileManager* tile_manager) {
+    CHECK_NOTNULL(tile_manager);
+    const vi_map::VIMap& vi_map = *test_app_.getMapMutable();
+    pose_graph::VertexIdList vertex_ids;
+    vi_map.getAllVertexIdsAlongGraphsSortedByTimestamp(&vertex_ids);
+    CHECK_LT(vertex_index, vertex_ids.size());
+    const vi_map::Vertex& vertex = vi_map.getVertex(vertex_ids[vertex_index]);
+    for (size_t attempt = 0u; attempt < max_num_attempts; ++attempt) {
+      vio::LocalizationResult result;
+      if (localizer_->localizeNFrame(
+              vertex.getVisualNFrameShared(), &result)) {
+        return true;
+      }
+      tile_manager->waitUntilIdle();
+    }
+    return false;
+  }
+
+  size_t getNumTiles() const {
+    return tiles_.size();
+  }
+
+  size_t getMaxTileNumBytes() const {
+    size_t max_num_bytes = 0u;
+    for (const summary_map::LocalizationSummaryMapTile& tile :
+         tile_index_.tiles) {
+      max_num_bytes = std::max(max_num_bytes, tile.num_bytes);
+    }
+    return max_num_bytes;
+  }
+
+  Eigen::Vector3d getFirstLandmarkPosition() const {
+    return summary_map_.GLandmarkPosition().col(0).cast<double>();
+  }
+
+  void createSummaryMapAndInitLocalizer() {
+    createSummaryMap();
+    initLocalizer();
+  }
+
+  const summary_map::LocalizationSummaryMap& getSummaryMap() const {
+    return summary_map_;
+  }
+
+  // Localizes the vertices in temporal order, like during a live run.
   double evaluateRecall() {
     const vi_map::VIMap& vi_map = *test_app_.getMapMutable();
 
     pose_graph::VertexIdList vertex_ids;
-    test_app_.getMapMutable()->getAllVertexIds(&vertex_ids);
+    vi_map.getAllVertexIdsAlongGraphsSortedByTimestamp(&vertex_ids);
     CHECK(!vertex_ids.empty());
 
     double recall = 0.;
+    num_map_tracking_localizations_ = 0u;
     for (const pose_graph::VertexId& vertex_id : vertex_ids) {
       vio::LocalizationResult result;
       const bool success = localizer_->localizeNFrame(
           vi_map.getVertex(vertex_id).getVisualNFrameShared(), &result);
+      if (success &&
+          result.localization_type ==
+              Localizer::LocalizationMode::kMapTracking) {
+        ++num_map_tracking_localizations_;
+      }
       if (success) {
         const double localization_error = (result.T_G_I_lc_pnp.getPosition() -
                                            vi_map.getVertex_G_p_I(vertex_id))
@@ -58,10 +180,17 @@ class ViMappingTest : public ::testing::Test {
     return recall;
   }
 
+  size_t getNumMapTrackingLocalizations() const {
+    return num_map_tracking_localizations_;
+  }
+
  private:
   Localizer::UniquePtr localizer_;
   summary_map::LocalizationSummaryMap summary_map_;
+  summary_map::TiledLocalizationSummaryMapIndex tile_index_;
+  std::vector<summary_map::LocalizationSummaryMap::Ptr> tiles_;
   visual_inertial_mapping::VIMappingTestApp test_app_;
+  size_t num_map_tracking_localizations_ = 0u;
 
   static constexpr double kLocalizationPositionThresholdMeters = 0.01;
 };
@@ -74,6 +203,160 @@ TEST_F(ViMappingTest, LocalizerWithSummaryMapWorks) {
   EXPECT_GT(recall, kRecallThreshold);
 }
 
+TEST_F(ViMappingTest, LocalizerWithMapTrackingWorks) {
+  constexpr double kRecallThreshold = 0.6;
+  createSummaryMap();
+
+  FLAGS_rovioli_localization_map_tracking = false;
+  initLocalizer();
+  const double recall_global = evaluateRecall();
+  EXPECT_GT(recall_global, kRecallThreshold);
+  EXPECT_EQ(0u, getNumMapTrackingLocalizations());
+
+  FLAGS_rovioli_localization_map_tracking = true;
+  initLocalizer();
+  const double recall_map_tracking = evaluateRecall();
+  EXPECT_GT(recall_map_tracking, kRecallThreshold);
+  EXPECT_GT(getNumMapTrackingLocalizations(), 0u);
+
+  LOG(INFO) << "Recall: " << recall_global
+            << ", with map tracking: " << recall_map_tracking;
+}
+
+TEST_F(ViMappingTest, LandmarkIndexFindsLandmarksWithinRadius) {
+  createSummaryMap();
+  const summary_map::LocalizationSummaryMap& summary_map = getSummaryMap();
+  constexpr double kVoxelSizeMeters = 2.0;
+  const LocalizationLandmarkIndex landmark_index(
+      summary_map, kVoxelSizeMeters);
+  ASSERT_EQ(
+      static_cast<size_t>(summary_map.GLandmarkPosition().cols()),
+      landmark_index.numLandmarks());
+
+  const Eigen::Vector3d p_G = getFirstLandmarkPosition();
+  constexpr double kRadiusMeters = 5.0;
+  std::vector<int> landmark_indices;
+  landmark_index.getLandmarksWithinRadius(
+      p_G, kRadiusMeters, &landmark_indices);
+  ASSERT_FALSE(landmark_indices.empty());
+
+  std::vector<int> expected_landmark_indices;
+  for (int i = 0; i < summary_map.GLandmarkPosition().cols(); ++i) {
+    if ((summary_map.GLandmarkPosition().col(i).cast<double>() - p_G).norm() <=
+        kRadiusMeters) {
+      expected_landmark_indices.push_back(i);
+    }
+  }
+  std::sort(landmark_indices.begin(), landmark_indices.end());
+  EXPECT_EQ(expected_landmark_indices, landmark_indices);
+
+  // Every observation of the selected landmarks has to be returned.
+  std::vector<int> observation_indices;
+  landmark_index.getObservationsOfLandmarks(
+      landmark_indices, &observation_indices);
+  size_t expected_num_observations = 0u;
+  for (int i = 0; i < summary_map.numObservations(); ++i) {
+    const int landmark_idx = summary_map.observationToLandmarkIndex()(i);
+    if (std::binary_search(
+            landmark_indices.begin(), landmark_indices.end(), landmark_idx)) {
+      ++expected_num_observations;
+    }
+  }
+  EXPECT_EQ(expected_num_observations, observation_indices.size());
+  for (const int observation_index : observation_indices) {
+    EXPECT_TRUE(
+        std::binary_search(
+            landmark_indices.begin(), landmark_indices.end(),
+            static_cast<int>(
+                summary_map.observationToLandmarkIndex()(observation_index))));
+  }
+}
+
+TEST_F(ViMappingTest, LocalizerWithPrecomputedWordIndicesWorks) {
+  constexpr double kRecallThreshold = 0.6;
+
+  createSummaryMap();
+  initLocalizer();
+  const double recall = evaluateRecall();
+  EXPECT_GT(recall, kRecallThreshold);
+
+  // The startup time is measured by BM_LocalizationDatabaseStartup in the
+  // microbenchmarks.
+  precomputeSummaryMapWordIndices();
+  initLocalizer();
+  const double recall_precomputed = evaluateRecall();
+  EXPECT_GT(recall_precomputed, kRecallThreshold);
+}
+
+TEST_F(ViMappingTest, LocalizerWithTiledSummaryMapWorks) {
+  createSummaryMap();
+  createTiledSummaryMap();
+
+  // With all tiles loaded the recall has to match the one of a single map.
+  constexpr double kLoadAllTilesRadiusMeters = 1e6;
+  constexpr size_t kUnlimitedMemoryBytes = 1u << 31;
+  initTiledLocalizer(kLoadAllTilesRadiusMeters, kUnlimitedMemoryBytes);
+  const double recall = evaluateRecall();
+
+  constexpr double kRecallThreshold = 0.6;
+  EXPECT_GT(recall, kRecallThreshold);
+}
+
+TEST_F(ViMappingTest, TileManagerRespectsRadiusAndMemoryBudget) {
+  createSummaryMap();
+  createTiledSummaryMap();
+  const Eigen::Vector3d p_G = getFirstLandmarkPosition();
+
+  // Only the tile containing the position is within a radius of zero.
+  constexpr size_t kUnlimitedMemoryBytes = 1u << 31;
+  LocalizationTileManager::UniquePtr tile_manager =
+      createTileManager(0.0, kUnlimitedMemoryBytes);
+  tile_manager->setPosition(p_G);
+  tile_manager->waitUntilIdle();
+  EXPECT_EQ(1u, tile_manager->getNumLoadedTiles());
+
+  // Moving far away from the map evicts all tiles.
+  tile_manager->setPosition(p_G + Eigen::Vector3d(1e6, 0.0, 0.0));
+  tile_manager->waitUntilIdle();
+  EXPECT_EQ(0u, tile_manager->getNumLoadedTiles());
+  EXPECT_EQ(0u, tile_manager->getLoadedTilesNumBytes());
+
+  // With a budget of the largest tile, never more than that is loaded. The
+  // budget also has to cover the vocabulary of the database of the tile.
+  constexpr double kLoadAllTilesRadiusMeters = 1e6;
+  const size_t memory_budget_bytes =
+      getMaxTileNumBytes() + tile_manager->getTileVocabularyNumBytes();
+  tile_manager =
+      createTileManager(kLoadAllTilesRadiusMeters, memory_budget_bytes);
+  tile_manager->setPosition(p_G);
+  tile_manager->waitUntilIdle();
+  EXPECT_GE(tile_manager->getNumLoadedTiles(), 1u);
+  EXPECT_LE(tile_manager->getLoadedTilesNumBytes(), memory_budget_bytes);
+  EXPECT_GT(
+      tile_manager->getLoadedTilesNumBytes(),
+      tile_manager->getTileVocabularyNumBytes());
+}
+
+TEST_F(ViMappingTest, TiledLocalizerSearchesAllTilesWithoutPrior) {
+  createSummaryMap();
+  createTiledSummaryMap();
+
+  // Only a single tile is loaded at a time and the tiles around the origin
+  // don't necessarily contain the queried vertex. Without a prior, the global
+  // search has to go through the tiles until it finds the vertex.
+  constexpr double kSingleTileRadiusMeters = 0.0;
+  constexpr size_t kUnlimitedMemoryBytes = 1u << 31;
+  LocalizationTileManager* tile_manager =
+      initTiledLocalizer(kSingleTileRadiusMeters, kUnlimitedMemoryBytes);
+  const size_t max_num_attempts = getNumTiles() + 1u;
+  constexpr size_t kNumVertices = 5u;
+  bool localized = false;
+  for (size_t i = 0u; i < kNumVertices && !localized; ++i) {
+    localized = localizeVertexRepeatedly(i, max_num_attempts, tile_manager);
+  }
+  EXPECT_TRUE(localized);
+}
+
 }  // namespace rovioli
 
 MAPLAB_UNITTEST_ENTRYPOINT
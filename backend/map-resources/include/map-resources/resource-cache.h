@@ -63,6 +63,9 @@ class ResourceCache {
 
   const Config& getConfig() const;
 
+  // Estimated memory of all cached resources in bytes.
+  size_t getMemoryUsageBytes() const;
+
   template <typename DataType>
   struct Cache {
     typedef std::pair<ResourceId, DataType> Element;
@@ -5,6 +5,7 @@
 
 #include <glog/logging.h>
 #include <maplab-common/file-system-tools.h>
+#include <maplab-common/profiler.h>
 
 #include "map-resources/resource-common.h"
 
@@ -20,6 +21,7 @@ void ResourceLoader::addResource(
     cache_.putResource<DataType>(id, type, resource);
   }
 
+  MAPLAB_PROFILE_ZONE("Resources: Save to file");
   std::string file_path;
   getResourceFilePath(id, type, folder, &file_path);
   saveResourceToFile(file_path, type, resource);
@@ -34,6 +36,7 @@ void ResourceLoader::getResource(
   if (cache_.getResource<DataType>(id, type, resource)) {
     return;
   } else {
+    MAPLAB_PROFILE_ZONE("Resources: Load from file");
     std::string file_path;
     getResourceFilePath(id, type, folder, &file_path);
     CHECK(loadResourceFromFile(file_path, type, resource))
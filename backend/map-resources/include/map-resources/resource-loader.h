@@ -46,6 +46,8 @@ class ResourceLoader {
 
   const ResourceCache::Config& getCacheConfig() const;
 
+  size_t getCacheMemoryUsageBytes() const;
+
   bool resourceFileExists(
       const ResourceId& id, const ResourceType& type,
       const std::string& folder) const;
@@ -137,6 +137,9 @@ class ResourceMap {
   // Get a copy of the current cache statistic state.
   CacheStatistic getResourceCacheStatisticCopy() const;
 
+  // Estimated memory of all cached resources in bytes.
+  size_t getResourceCacheMemoryUsageBytes() const;
+
   size_t getNumResourceCacheMiss(const ResourceType& type) const;
   size_t getNumResourceCacheHits(const ResourceType& type) const;
 
@@ -1,6 +1,50 @@
 #include "map-resources/resource-cache.h"
 
 namespace backend {
+namespace {
+size_t getResourceMemoryBytes(const cv::Mat& image) {
+  return image.total() * image.elemSize();
+}
+
+size_t getResourceMemoryBytes(const std::string& text) {
+  return text.capacity();
+}
+
+size_t getResourceMemoryBytes(const resources::PointCloud& point_cloud) {
+  return point_cloud.xyz.capacity() * sizeof(float) +
+         point_cloud.normals.capacity() * sizeof(float) +
+         point_cloud.colors.capacity() * sizeof(unsigned char);
+}
+
+size_t getResourceMemoryBytes(const voxblox::TsdfMap& tsdf_map) {
+  return tsdf_map.getTsdfLayer().getMemorySize();
+}
+
+size_t getResourceMemoryBytes(const voxblox::EsdfMap& esdf_map) {
+  return esdf_map.getEsdfLayer().getMemorySize();
+}
+
+size_t getResourceMemoryBytes(const voxblox::OccupancyMap& occupancy_map) {
+  return occupancy_map.getOccupancyLayer().getMemorySize();
+}
+
+template <typename DataType>
+size_t getCacheMemoryBytes(
+    const typename ResourceCache::Cache<DataType>::ResourceTypeMap& cache) {
+  size_t num_bytes = 0u;
+  for (const typename ResourceCache::Cache<DataType>::ResourceTypeMap::
+           value_type& type_and_deque : cache) {
+    if (type_and_deque.second == nullptr) {
+      continue;
+    }
+    for (const typename ResourceCache::Cache<DataType>::Element& element :
+         *type_and_deque.second) {
+      num_bytes += sizeof(element) + getResourceMemoryBytes(element.second);
+    }
+  }
+  return num_bytes;
+}
+}  // namespace
 
 template <>
 typename ResourceCache::Cache<cv::Mat>::ResourceDequePtr&
@@ -87,4 +131,15 @@ const ResourceCache::Config& ResourceCache::getConfig() const {
   return config_;
 }
 
+size_t ResourceCache::getMemoryUsageBytes() const {
+  // NOTE: [ADD_RESOURCE_DATA_TYPE] Add the new cache here.
+  return getCacheMemoryBytes<cv::Mat>(image_cache_) +
+         getCacheMemoryBytes<std::string>(text_cache_) +
+         getCacheMemoryBytes<resources::PointCloud>(pointcloud_cache_) +
+         getCacheMemoryBytes<voxblox::TsdfMap>(voxblox_tsdf_map_cache_) +
+         getCacheMemoryBytes<voxblox::EsdfMap>(voxblox_esdf_map_cache_) +
+         getCacheMemoryBytes<voxblox::OccupancyMap>(
+             voxblox_occupancy_map_cache_);
+}
+
 }  // namespace backend
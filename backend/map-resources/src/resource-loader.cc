@@ -372,4 +372,8 @@ const ResourceCache::Config& ResourceLoader::getCacheConfig() const {
   return cache_.getConfig();
 }
 
+size_t ResourceLoader::getCacheMemoryUsageBytes() const {
+  return cache_.getMemoryUsageBytes();
+}
+
 }  // namespace backend
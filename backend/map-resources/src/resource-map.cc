@@ -489,6 +489,11 @@ CacheStatistic ResourceMap::getResourceCacheStatisticCopy() const {
   return resource_loader_.getCacheStatistic();
 }
 
+size_t ResourceMap::getResourceCacheMemoryUsageBytes() const {
+  aslam::ScopedReadLock lock(&resource_mutex_);
+  return resource_loader_.getCacheMemoryUsageBytes();
+}
+
 size_t ResourceMap::getNumResourceCacheMiss(const ResourceType& type) const {
   aslam::ScopedReadLock lock(&resource_mutex_);
   return resource_loader_.getCacheStatistic().getNumMiss(type);
@@ -14,6 +14,7 @@
 #include <aslam/common/timer.h>
 #include <glog/logging.h>
 #include <maplab-common/accessors.h>
+#include <maplab-common/profiler.h>
 
 namespace common {
 class Job {
@@ -176,7 +177,10 @@ int CommandRegisterer::processCommand(const std::string& command) {
     } else {
       try {
         wordfree(&result);
-        timing::Timer timer("exec - " + std::string(command_without_flags));
+        const std::string timer_name =
+            "exec - " + std::string(command_without_flags);
+        MAPLAB_PROFILE_ZONE(timer_name);
+        timing::Timer timer(timer_name);
         int status = command.callback();
         timer.Stop();
         return status;
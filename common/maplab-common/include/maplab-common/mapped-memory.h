@@ -0,0 +1,87 @@
+#ifndef MAPLAB_COMMON_MAPPED_MEMORY_H_
+#define MAPLAB_COMMON_MAPPED_MEMORY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <glog/logging.h>
+
+namespace common {
+
+// Memory mapping of a POSIX shared memory object or of a file, which allows
+// several processes to share the same physical memory. A mapping is either
+// created writable by one process, which fills it and then seals it, or opened
+// read-only. Shared memory object names need to start with a slash and must
+// not contain any further slashes, e.g. "/loop_detector". Removing the object
+// or the file doesn't invalidate existing mappings, the memory is released
+// once the last mapping is closed. The creator of a mapping owns its name and
+// is expected to remove it with removeCreatedName once the content should no
+// longer be opened.
+// Note: This is not thread safe.
+class MappedMemory {
+ public:
+  enum class Type { kSharedMemory, kFile };
+
+  ~MappedMemory();
+
+  // Creates a new shared memory object or file of the given size and maps it
+  // writable. Returns nullptr if the object already exists or can't be
+  // created.
+  static std::unique_ptr<MappedMemory> create(
+      const Type type, const std::string& name, const size_t size_bytes);
+
+  // Maps an existing shared memory object or file read-only. Returns nullptr
+  // if it doesn't exist or can't be mapped.
+  static std::unique_ptr<MappedMemory> openReadOnly(
+      const Type type, const std::string& name);
+
+  // Removes the shared memory object or the file. Returns false if it doesn't
+  // exist or can't be removed.
+  static bool remove(const Type type, const std::string& name);
+
+  // Removes the name of a mapping created with create, unless the name has
+  // been removed or refers to another object in the meantime. Returns false
+  // if nothing was removed.
+  bool removeCreatedName();
+
+  // Makes a writable mapping read-only once its content is complete. File
+  // mappings are also written back to the file.
+  void seal();
+
+  inline uint8_t* mutableData() {
+    CHECK(!is_read_only_) << "The mapping is read-only.";
+    return data_;
+  }
+  inline const uint8_t* data() const {
+    return data_;
+  }
+  inline size_t size() const {
+    return size_bytes_;
+  }
+  inline bool isReadOnly() const {
+    return is_read_only_;
+  }
+
+ private:
+  MappedMemory(uint8_t* data, const size_t size_bytes, const bool read_only);
+  MappedMemory(const MappedMemory&) = delete;
+  MappedMemory& operator=(const MappedMemory&) = delete;
+
+  uint8_t* data_;
+  const size_t size_bytes_;
+  bool is_read_only_;
+
+  // Only set for mappings created with create. The device and inode identify
+  // the created object, in case the name is reused.
+  bool has_created_name_;
+  Type type_;
+  std::string name_;
+  uint64_t device_;
+  uint64_t inode_;
+};
+
+}  // namespace common
+
+#endif  // MAPLAB_COMMON_MAPPED_MEMORY_H_
@@ -0,0 +1,88 @@
+#ifndef MAPLAB_COMMON_PROFILER_H_
+#define MAPLAB_COMMON_PROFILER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "maplab-common/macros.h"
+
+// Hierarchical profiler. Zones are opened with MAPLAB_PROFILE_ZONE and closed
+// at the end of the enclosing scope; zones opened while another zone is open
+// on the same thread are nested within it. The recorded zones can be written
+// out as Chrome trace-event JSON (chrome://tracing, Perfetto) or as folded
+// stacks (flamegraph.pl, speedscope).
+//
+// Zones are only recorded if --profiler_enabled is set.
+//
+// Allocations are only counted if the library is built with
+// MAPLAB_PROFILER_COUNT_ALLOCATIONS, which replaces the global operator new.
+
+namespace common {
+namespace profiler {
+
+struct ZoneEvent {
+  std::string name;
+  int64_t start_ns;
+  int64_t end_ns;
+  // Number of zones that were open on the same thread when this zone was
+  // opened.
+  size_t depth;
+  // Sequential index of the recording thread, in order of first use.
+  size_t thread_index;
+  // Number of allocations on the recording thread while the zone was open,
+  // including those of nested zones.
+  uint64_t num_allocations;
+};
+
+// Zone names are interned, the name given as C string has to have static
+// storage duration, e.g. be a string literal.
+class ScopedZone {
+ public:
+  explicit ScopedZone(const char* name);
+  explicit ScopedZone(const std::string& name);
+  ~ScopedZone();
+
+ private:
+  MAPLAB_DISALLOW_EVIL_CONSTRUCTORS(ScopedZone);
+  void start();
+
+  const bool enabled_;
+  uint32_t name_id_;
+  int64_t start_ns_;
+  size_t depth_;
+  uint64_t start_num_allocations_;
+};
+
+// Number of allocations done by the calling thread so far; always 0 if
+// allocation counting is not compiled in.
+uint64_t getThreadAllocationCount();
+
+// Discards all recorded zones. Zones that are open while calling this are
+// still recorded when they close.
+void reset();
+
+// Returns the recorded zones sorted by thread index and start time, with
+// parents before their children.
+void getEvents(std::vector<ZoneEvent>* events);
+
+// Number of zones that were dropped because of the profiler_max_num_events
+// limit.
+size_t getNumDroppedEvents();
+
+bool writeChromeTrace(const std::string& filename);
+
+// One line per distinct zone stack "outer;inner;innermost <self time [us]>".
+// Stacks of all threads are merged.
+bool writeFoldedStacks(const std::string& filename);
+
+}  // namespace profiler
+}  // namespace common
+
+#define MAPLAB_PROFILER_CONCAT_IMPL(a, b) a##b
+#define MAPLAB_PROFILER_CONCAT(a, b) MAPLAB_PROFILER_CONCAT_IMPL(a, b)
+#define MAPLAB_PROFILE_ZONE(name)                                           \
+  ::common::profiler::ScopedZone MAPLAB_PROFILER_CONCAT(                    \
+      maplab_profiler_zone_, __LINE__)(name)
+
+#endif  // MAPLAB_COMMON_PROFILER_H_
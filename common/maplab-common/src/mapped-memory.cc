@@ -0,0 +1,136 @@
+#include "maplab-common/mapped-memory.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include <glog/logging.h>
+
+namespace common {
+
+namespace {
+int openFileDescriptor(
+    const MappedMemory::Type type, const std::string& name, const int flags,
+    const mode_t mode) {
+  if (type == MappedMemory::Type::kSharedMemory) {
+    CHECK(!name.empty() && name[0] == '/' && name.find('/', 1u) == name.npos)
+        << "Invalid shared memory object name: " << name;
+    return shm_open(name.c_str(), flags, mode);
+  }
+  return open(name.c_str(), flags, mode);
+}
+}  // namespace
+
+MappedMemory::MappedMemory(
+    uint8_t* data, const size_t size_bytes, const bool read_only)
+    : data_(CHECK_NOTNULL(data)),
+      size_bytes_(size_bytes),
+      is_read_only_(read_only),
+      has_created_name_(false),
+      type_(Type::kFile),
+      device_(0u),
+      inode_(0u) {}
+
+MappedMemory::~MappedMemory() {
+  CHECK_EQ(munmap(data_, size_bytes_), 0) << strerror(errno);
+}
+
+std::unique_ptr<MappedMemory> MappedMemory::create(
+    const Type type, const std::string& name, const size_t size_bytes) {
+  CHECK_GT(size_bytes, 0u);
+  const int file_descriptor = openFileDescriptor(
+      type, name, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR | S_IRGRP);
+  if (file_descriptor == -1) {
+    LOG(ERROR) << "Failed to create " << name << ": " << strerror(errno);
+    return nullptr;
+  }
+  struct stat file_status;
+  void* data = MAP_FAILED;
+  if (fstat(file_descriptor, &file_status) == 0 &&
+      ftruncate(file_descriptor, size_bytes) == 0) {
+    data = mmap(
+        nullptr, size_bytes, PROT_READ | PROT_WRITE, MAP_SHARED,
+        file_descriptor, 0);
+  }
+  const int mapping_errno = errno;
+  // The mapping stays valid after closing the file descriptor.
+  close(file_descriptor);
+  if (data == MAP_FAILED) {
+    LOG(ERROR) << "Failed to map " << size_bytes << " bytes of " << name
+               << ": " << strerror(mapping_errno);
+    remove(type, name);
+    return nullptr;
+  }
+  std::unique_ptr<MappedMemory> memory(
+      new MappedMemory(static_cast<uint8_t*>(data), size_bytes, false));
+  memory->has_created_name_ = true;
+  memory->type_ = type;
+  memory->name_ = name;
+  memory->device_ = file_status.st_dev;
+  memory->inode_ = file_status.st_ino;
+  return memory;
+}
+
+std::unique_ptr<MappedMemory> MappedMemory::openReadOnly(
+    const Type type, const std::string& name) {
+  const int file_descriptor = openFileDescriptor(type, name, O_RDONLY, 0);
+  if (file_descriptor == -1) {
+    LOG(ERROR) << "Failed to open " << name << ": " << strerror(errno);
+    return nullptr;
+  }
+  struct stat file_status;
+  void* data = MAP_FAILED;
+  if (fstat(file_descriptor, &file_status) == 0 && file_status.st_size > 0) {
+    data = mmap(
+        nullptr, file_status.st_size, PROT_READ, MAP_SHARED, file_descriptor,
+        0);
+  }
+  const int mapping_errno = errno;
+  close(file_descriptor);
+  if (data == MAP_FAILED) {
+    LOG(ERROR) << "Failed to map " << name << ": " << strerror(mapping_errno);
+    return nullptr;
+  }
+  return std::unique_ptr<MappedMemory>(
+      new MappedMemory(
+          static_cast<uint8_t*>(data), file_status.st_size, true));
+}
+
+bool MappedMemory::remove(const Type type, const std::string& name) {
+  if (type == Type::kSharedMemory) {
+    return shm_unlink(name.c_str()) == 0;
+  }
+  return unlink(name.c_str()) == 0;
+}
+
+bool MappedMemory::removeCreatedName() {
+  if (!has_created_name_) {
+    return false;
+  }
+  has_created_name_ = false;
+  const int file_descriptor = openFileDescriptor(type_, name_, O_RDONLY, 0);
+  if (file_descriptor == -1) {
+    return false;
+  }
+  struct stat file_status;
+  const bool is_same_object =
+      fstat(file_descriptor, &file_status) == 0 &&
+      static_cast<uint64_t>(file_status.st_dev) == device_ &&
+      static_cast<uint64_t>(file_status.st_ino) == inode_;
+  close(file_descriptor);
+  return is_same_object && remove(type_, name_);
+}
+
+void MappedMemory::seal() {
+  CHECK(!is_read_only_) << "The mapping is already read-only.";
+  CHECK_EQ(msync(data_, size_bytes_, MS_SYNC), 0) << strerror(errno);
+  CHECK_EQ(mprotect(data_, size_bytes_, PROT_READ), 0) << strerror(errno);
+  is_read_only_ = true;
+}
+
+}  // namespace common
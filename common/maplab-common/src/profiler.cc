@@ -0,0 +1,518 @@
+#include "maplab-common/profiler.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <utility>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+DEFINE_bool(
+    profiler_enabled, false,
+    "Record the zones of the hierarchical profiler. They can be exported with "
+    "the timing console command. Enabled by the console if "
+    "--timing_chrome_trace_file or --timing_folded_stacks_file is set.");
+DEFINE_uint64(
+    profiler_max_num_events, 1000000u,
+    "Maximum number of profiler zones that are kept in memory over all "
+    "threads; any further zones are dropped.");
+
+namespace common {
+namespace profiler {
+namespace internal {
+
+thread_local uint64_t thread_num_allocations = 0u;
+
+int64_t getSteadyClockNanoseconds() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Zone as recorded by the thread, the name is resolved only on export.
+struct RecordedZone {
+  uint32_t name_id;
+  int64_t start_ns;
+  int64_t end_ns;
+  size_t depth;
+  uint64_t num_allocations;
+};
+
+// Interns the zone names, such that recording a zone neither copies nor
+// allocates its name.
+class ZoneNameTable {
+ public:
+  static ZoneNameTable& instance() {
+    // Never destroyed, as zones may be recorded while static objects are
+    // destroyed.
+    static ZoneNameTable* table = new ZoneNameTable;
+    return *table;
+  }
+
+  uint32_t intern(const std::string& name) {
+    std::lock_guard<std::mutex> lock(m_names_);
+    std::unordered_map<std::string, uint32_t>::const_iterator it =
+        name_to_id_.find(name);
+    if (it != name_to_id_.end()) {
+      return it->second;
+    }
+    const uint32_t name_id = static_cast<uint32_t>(names_.size());
+    names_.emplace_back(name);
+    name_to_id_.emplace(name, name_id);
+    return name_id;
+  }
+
+  // The returned reference stays valid, names are never removed.
+  const std::string& getName(const uint32_t name_id) {
+    std::lock_guard<std::mutex> lock(m_names_);
+    CHECK_LT(name_id, names_.size());
+    return names_[name_id];
+  }
+
+ private:
+  ZoneNameTable() = default;
+
+  std::mutex m_names_;
+  std::deque<std::string> names_;
+  std::unordered_map<std::string, uint32_t> name_to_id_;
+};
+
+uint32_t internZoneName(const char* name) {
+  // Names given as C strings have static storage duration, hence the address
+  // identifies the name and repeated zones are resolved without locking.
+  thread_local std::unordered_map<const char*, uint32_t> name_to_id;
+  std::unordered_map<const char*, uint32_t>::const_iterator it =
+      name_to_id.find(name);
+  if (it != name_to_id.end()) {
+    return it->second;
+  }
+  const uint32_t name_id = ZoneNameTable::instance().intern(name);
+  name_to_id.emplace(name, name_id);
+  return name_id;
+}
+
+struct ThreadBuffer {
+  explicit ThreadBuffer(const size_t _thread_index)
+      : thread_index(_thread_index), depth(0u) {}
+
+  const size_t thread_index;
+  // Number of open zones, only accessed by the thread owning the buffer.
+  size_t depth;
+
+  // Protects the events against concurrent exports and resets.
+  std::mutex m_events;
+  std::vector<RecordedZone> events;
+};
+
+// Owns the buffers of all threads. Buffers of finished threads are handed to
+// new threads, such that short-lived worker threads (e.g. of
+// common::ParallelProcess) do not add a new thread index each time.
+class Registry {
+ public:
+  static Registry& instance() {
+    // Never destroyed, as thread-local handles may outlive static objects.
+    static Registry* registry = new Registry;
+    return *registry;
+  }
+
+  ThreadBuffer* acquireBuffer() {
+    std::lock_guard<std::mutex> lock(m_buffers_);
+    if (!free_buffers_.empty()) {
+      ThreadBuffer* buffer = free_buffers_.back();
+      free_buffers_.pop_back();
+      return buffer;
+    }
+    buffers_.emplace_back(new ThreadBuffer(buffers_.size()));
+    return buffers_.back().get();
+  }
+
+  void releaseBuffer(ThreadBuffer* buffer) {
+    CHECK_NOTNULL(buffer);
+    std::lock_guard<std::mutex> lock(m_buffers_);
+    free_buffers_.push_back(buffer);
+  }
+
+  template <typename Action>
+  void forEachBuffer(const Action& action) {
+    std::lock_guard<std::mutex> lock(m_buffers_);
+    for (const std::unique_ptr<ThreadBuffer>& buffer : buffers_) {
+      std::lock_guard<std::mutex> buffer_lock(buffer->m_events);
+      action(buffer.get());
+    }
+  }
+
+  bool reserveEvent() {
+    if (num_events_.fetch_add(1u) < FLAGS_profiler_max_num_events) {
+      return true;
+    }
+    --num_events_;
+    ++num_dropped_events_;
+    return false;
+  }
+
+  void reset() {
+    forEachBuffer([](ThreadBuffer* buffer) { buffer->events.clear(); });
+    num_events_ = 0u;
+    num_dropped_events_ = 0u;
+  }
+
+  size_t getNumDroppedEvents() const {
+    return num_dropped_events_;
+  }
+
+ private:
+  Registry() : num_events_(0u), num_dropped_events_(0u) {}
+
+  std::mutex m_buffers_;
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+  std::vector<ThreadBuffer*> free_buffers_;
+
+  std::atomic<size_t> num_events_;
+  std::atomic<size_t> num_dropped_events_;
+};
+
+class ThreadBufferHandle {
+ public:
+  ThreadBufferHandle() : buffer_(Registry::instance().acquireBuffer()) {}
+  ~ThreadBufferHandle() {
+    Registry::instance().releaseBuffer(buffer_);
+  }
+  ThreadBuffer* get() const {
+    return buffer_;
+  }
+
+ private:
+  ThreadBuffer* const buffer_;
+};
+
+ThreadBuffer* getThreadBuffer() {
+  thread_local ThreadBufferHandle handle;
+  return handle.get();
+}
+
+void writeJsonString(const std::string& value, std::ostream* out) {
+  CHECK_NOTNULL(out);
+  *out << '"';
+  for (const char character : value) {
+    switch (character) {
+      case '"':
+        *out << "\\\"";
+        break;
+      case '\\':
+        *out << "\\\\";
+        break;
+      case '\n':
+        *out << "\\n";
+        break;
+      case '\t':
+        *out << "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(character) < 0x20u) {
+          char escaped[8];
+          snprintf(
+              escaped, sizeof(escaped), "\\u%04x",
+              static_cast<unsigned int>(character));
+          *out << escaped;
+        } else {
+          *out << character;
+        }
+    }
+  }
+  *out << '"';
+}
+
+void warnAboutDroppedEvents() {
+  const size_t num_dropped_events = getNumDroppedEvents();
+  LOG_IF(WARNING, num_dropped_events > 0u)
+      << "The profiler dropped " << num_dropped_events << " zones because "
+      << "of the limit of " << FLAGS_profiler_max_num_events << " zones. "
+      << "The limit can be changed with --profiler_max_num_events.";
+}
+
+}  // namespace internal
+
+ScopedZone::ScopedZone(const char* name)
+    : enabled_(FLAGS_profiler_enabled),
+      name_id_(0u),
+      start_ns_(0),
+      depth_(0u),
+      start_num_allocations_(0u) {
+  if (enabled_) {
+    name_id_ = internal::internZoneName(CHECK_NOTNULL(name));
+    start();
+  }
+}
+
+ScopedZone::ScopedZone(const std::string& name)
+    : enabled_(FLAGS_profiler_enabled),
+      name_id_(0u),
+      start_ns_(0),
+      depth_(0u),
+      start_num_allocations_(0u) {
+  if (enabled_) {
+    name_id_ = internal::ZoneNameTable::instance().intern(name);
+    start();
+  }
+}
+
+void ScopedZone::start() {
+  internal::ThreadBuffer* buffer = internal::getThreadBuffer();
+  depth_ = buffer->depth++;
+  start_num_allocations_ = getThreadAllocationCount();
+  start_ns_ = internal::getSteadyClockNanoseconds();
+}
+
+ScopedZone::~ScopedZone() {
+  if (!enabled_) {
+    return;
+  }
+  const int64_t end_ns = internal::getSteadyClockNanoseconds();
+  const uint64_t num_allocations =
+      getThreadAllocationCount() - start_num_allocations_;
+
+  internal::ThreadBuffer* buffer = internal::getThreadBuffer();
+  CHECK_GT(buffer->depth, 0u);
+  --buffer->depth;
+  if (!internal::Registry::instance().reserveEvent()) {
+    return;
+  }
+
+  internal::RecordedZone zone;
+  zone.name_id = name_id_;
+  zone.start_ns = start_ns_;
+  zone.end_ns = end_ns;
+  zone.depth = depth_;
+  zone.num_allocations = num_allocations;
+  std::lock_guard<std::mutex> lock(buffer->m_events);
+  buffer->events.push_back(zone);
+}
+
+uint64_t getThreadAllocationCount() {
+  return internal::thread_num_allocations;
+}
+
+void reset() {
+  internal::Registry::instance().reset();
+}
+
+void getEvents(std::vector<ZoneEvent>* events) {
+  CHECK_NOTNULL(events)->clear();
+  internal::ZoneNameTable& name_table = internal::ZoneNameTable::instance();
+  internal::Registry::instance().forEachBuffer(
+      [events, &name_table](internal::ThreadBuffer* buffer) {
+        for (const internal::RecordedZone& zone : buffer->events) {
+          ZoneEvent event;
+          event.name = name_table.getName(zone.name_id);
+          event.start_ns = zone.start_ns;
+          event.end_ns = zone.end_ns;
+          event.depth = zone.depth;
+          event.thread_index = buffer->thread_index;
+          event.num_allocations = zone.num_allocations;
+          events->emplace_back(std::move(event));
+        }
+      });
+  // Zones are recorded when they close, i.e. children before their parents.
+  std::sort(
+      events->begin(), events->end(),
+      [](const ZoneEvent& lhs, const ZoneEvent& rhs) {
+        if (lhs.thread_index != rhs.thread_index) {
+          return lhs.thread_index < rhs.thread_index;
+        }
+        if (lhs.start_ns != rhs.start_ns) {
+          return lhs.start_ns < rhs.start_ns;
+        }
+        return lhs.depth < rhs.depth;
+      });
+}
+
+size_t getNumDroppedEvents() {
+  return internal::Registry::instance().getNumDroppedEvents();
+}
+
+bool writeChromeTrace(const std::string& filename) {
+  CHECK(!filename.empty());
+  std::vector<ZoneEvent> events;
+  getEvents(&events);
+  internal::warnAboutDroppedEvents();
+
+  std::ofstream out(filename);
+  if (!out.is_open()) {
+    LOG(ERROR) << "Could not open " << filename << " for writing.";
+    return false;
+  }
+
+  int64_t first_start_ns = std::numeric_limits<int64_t>::max();
+  for (const ZoneEvent& event : events) {
+    first_start_ns = std::min(first_start_ns, event.start_ns);
+  }
+
+  // The trace-event format expects timestamps and durations in microseconds.
+  constexpr double kNanosecondsToMicroseconds = 1e-3;
+  const int pid = static_cast<int>(getpid());
+  out << std::fixed << std::setprecision(3);
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first_entry = true;
+  size_t last_thread_index = 0u;
+  for (const ZoneEvent& event : events) {
+    if (first_entry || event.thread_index != last_thread_index) {
+      out << (first_entry ? "\n" : ",\n");
+      out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+          << ",\"tid\":" << event.thread_index
+          << ",\"args\":{\"name\":\"thread " << event.thread_index << "\"}}";
+      last_thread_index = event.thread_index;
+      first_entry = false;
+    }
+    out << ",\n{\"name\":";
+    internal::writeJsonString(event.name, &out);
+    out << ",\"cat\":\"maplab\",\"ph\":\"X\",\"pid\":" << pid
+        << ",\"tid\":" << event.thread_index << ",\"ts\":"
+        << (event.start_ns - first_start_ns) * kNanosecondsToMicroseconds
+        << ",\"dur\":"
+        << (event.end_ns - event.start_ns) * kNanosecondsToMicroseconds
+        << ",\"args\":{\"allocations\":" << event.num_allocations << "}}";
+  }
+  out << "\n]}\n";
+  out.close();
+  if (out.fail()) {
+    LOG(ERROR) << "Failed to write the trace to " << filename << ".";
+    return false;
+  }
+  VLOG(1) << "Wrote " << events.size() << " profiler zones to " << filename
+          << ".";
+  return true;
+}
+
+bool writeFoldedStacks(const std::string& filename) {
+  CHECK(!filename.empty());
+  std::vector<ZoneEvent> events;
+  getEvents(&events);
+  internal::warnAboutDroppedEvents();
+
+  // Reconstruct the zone stacks from the depths; the events are sorted such
+  // that every parent directly precedes its subtree.
+  const size_t num_events = events.size();
+  std::vector<std::string> stacks(num_events);
+  std::vector<int64_t> self_ns(num_events);
+  std::vector<size_t> open_zones;
+  for (size_t i = 0u; i < num_events; ++i) {
+    const ZoneEvent& event = events[i];
+    while (!open_zones.empty() &&
+           (events[open_zones.back()].thread_index != event.thread_index ||
+            events[open_zones.back()].depth >= event.depth)) {
+      open_zones.pop_back();
+    }
+
+    // ';' separates the frames of a stack.
+    std::string frame = event.name;
+    std::replace(frame.begin(), frame.end(), ';', ':');
+
+    self_ns[i] = event.end_ns - event.start_ns;
+    if (open_zones.empty()) {
+      stacks[i] = frame;
+    } else {
+      const size_t parent = open_zones.back();
+      self_ns[parent] -= self_ns[i];
+      stacks[i] = stacks[parent] + ";" + frame;
+    }
+    open_zones.push_back(i);
+  }
+
+  std::map<std::string, int64_t> stack_to_self_ns;
+  for (size_t i = 0u; i < num_events; ++i) {
+    stack_to_self_ns[stacks[i]] += self_ns[i];
+  }
+
+  std::ofstream out(filename);
+  if (!out.is_open()) {
+    LOG(ERROR) << "Could not open " << filename << " for writing.";
+    return false;
+  }
+  constexpr int64_t kNanosecondsPerMicrosecond = 1000;
+  for (const std::pair<const std::string, int64_t>& stack_self_ns :
+       stack_to_self_ns) {
+    const int64_t self_us = stack_self_ns.second / kNanosecondsPerMicrosecond;
+    if (self_us > 0) {
+      out << stack_self_ns.first << ' ' << self_us << '\n';
+    }
+  }
+  out.close();
+  if (out.fail()) {
+    LOG(ERROR) << "Failed to write the folded stacks to " << filename << ".";
+    return false;
+  }
+  VLOG(1) << "Wrote " << stack_to_self_ns.size() << " profiler stacks to "
+          << filename << ".";
+  return true;
+}
+
+}  // namespace profiler
+}  // namespace common
+
+#ifdef MAPLAB_PROFILER_COUNT_ALLOCATIONS
+// Replacements of the global allocation functions that count the allocations
+// of each thread. The aligned overloads are left untouched.
+void* operator new(std::size_t size) {
+  ++common::profiler::internal::thread_num_allocations;
+  if (size == 0u) {
+    size = 1u;
+  }
+  while (true) {
+    void* pointer = std::malloc(size);
+    if (pointer != nullptr) {
+      return pointer;
+    }
+    std::new_handler handler = std::get_new_handler();
+    if (handler == nullptr) {
+      throw std::bad_alloc();
+    }
+    handler();
+  }
+}
+
+void* operator new[](std::size_t size) {
+  return ::operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  try {
+    return ::operator new(size);
+  } catch (const std::bad_alloc&) {
+    return nullptr;
+  }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return ::operator new(size, std::nothrow);
+}
+
+void operator delete(void* pointer) noexcept {
+  std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+  std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+  std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept {
+  std::free(pointer);
+}
+#endif  // MAPLAB_PROFILER_COUNT_ALLOCATIONS
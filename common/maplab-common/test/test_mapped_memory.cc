@@ -0,0 +1,105 @@
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include "maplab-common/mapped-memory.h"
+#include "maplab-common/test/testing-entrypoint.h"
+
+namespace common {
+
+class MappedMemoryTest : public ::testing::TestWithParam<MappedMemory::Type> {
+ protected:
+  MappedMemoryTest() {
+    // Unique names, so that concurrent test runs don't interfere.
+    if (GetParam() == MappedMemory::Type::kSharedMemory) {
+      name_ = "/test_mapped_memory_" + std::to_string(getpid());
+    } else {
+      name_ = "test_mapped_memory_" + std::to_string(getpid()) + ".bin";
+    }
+  }
+
+  virtual void TearDown() {
+    MappedMemory::remove(GetParam(), name_);
+  }
+
+  std::string name_;
+};
+
+TEST_P(MappedMemoryTest, ReadOnlyMappingSeesWrittenData) {
+  const std::string kContent = "shared read-only content";
+  std::unique_ptr<MappedMemory> writable_memory =
+      MappedMemory::create(GetParam(), name_, kContent.size());
+  ASSERT_TRUE(writable_memory != nullptr);
+  EXPECT_FALSE(writable_memory->isReadOnly());
+  ASSERT_EQ(writable_memory->size(), kContent.size());
+  memcpy(writable_memory->mutableData(), kContent.data(), kContent.size());
+  writable_memory->seal();
+  EXPECT_TRUE(writable_memory->isReadOnly());
+
+  std::unique_ptr<MappedMemory> read_only_memory =
+      MappedMemory::openReadOnly(GetParam(), name_);
+  ASSERT_TRUE(read_only_memory != nullptr);
+  EXPECT_TRUE(read_only_memory->isReadOnly());
+  ASSERT_EQ(read_only_memory->size(), kContent.size());
+  const MappedMemory& const_memory = *read_only_memory;
+  EXPECT_EQ(
+      std::string(
+          reinterpret_cast<const char*>(const_memory.data()),
+          const_memory.size()),
+      kContent);
+
+  // Existing mappings outlive the removal of the name.
+  writable_memory.reset();
+  EXPECT_TRUE(MappedMemory::remove(GetParam(), name_));
+  EXPECT_EQ(
+      std::string(
+          reinterpret_cast<const char*>(const_memory.data()),
+          const_memory.size()),
+      kContent);
+}
+
+TEST_P(MappedMemoryTest, CreateFailsIfNameExists) {
+  std::unique_ptr<MappedMemory> memory =
+      MappedMemory::create(GetParam(), name_, 16u);
+  ASSERT_TRUE(memory != nullptr);
+  EXPECT_TRUE(MappedMemory::create(GetParam(), name_, 16u) == nullptr);
+}
+
+TEST_P(MappedMemoryTest, RemoveCreatedNameKeepsReplacedNames) {
+  std::unique_ptr<MappedMemory> replaced_memory =
+      MappedMemory::create(GetParam(), name_, 16u);
+  ASSERT_TRUE(replaced_memory != nullptr);
+  ASSERT_TRUE(MappedMemory::remove(GetParam(), name_));
+  std::unique_ptr<MappedMemory> memory =
+      MappedMemory::create(GetParam(), name_, 16u);
+  ASSERT_TRUE(memory != nullptr);
+
+  // The name refers to the second object now.
+  EXPECT_FALSE(replaced_memory->removeCreatedName());
+  std::unique_ptr<MappedMemory> read_only_memory =
+      MappedMemory::openReadOnly(GetParam(), name_);
+  ASSERT_TRUE(read_only_memory != nullptr);
+  EXPECT_FALSE(read_only_memory->removeCreatedName());
+
+  EXPECT_TRUE(memory->removeCreatedName());
+  EXPECT_TRUE(MappedMemory::openReadOnly(GetParam(), name_) == nullptr);
+  EXPECT_FALSE(memory->removeCreatedName());
+}
+
+TEST_P(MappedMemoryTest, OpenFailsIfNameDoesNotExist) {
+  EXPECT_TRUE(MappedMemory::openReadOnly(GetParam(), name_) == nullptr);
+  EXPECT_FALSE(MappedMemory::remove(GetParam(), name_));
+}
+
+INSTANTIATE_TEST_CASE_P(
+    MappedMemoryTypes, MappedMemoryTest,
+    ::testing::Values(
+        MappedMemory::Type::kSharedMemory, MappedMemory::Type::kFile));
+
+}  // namespace common
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,157 @@
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <maplab-common/file-system-tools.h>
+#include <maplab-common/profiler.h>
+#include <maplab-common/test/testing-entrypoint.h>
+
+DECLARE_bool(profiler_enabled);
+DECLARE_uint64(profiler_max_num_events);
+
+namespace common {
+namespace profiler {
+
+class ProfilerTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    FLAGS_profiler_enabled = true;
+    reset();
+  }
+
+  static void runNestedZones() {
+    MAPLAB_PROFILE_ZONE("outer");
+    {
+      MAPLAB_PROFILE_ZONE("inner");
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+
+  static std::string readFile(const std::string& filename) {
+    std::ifstream in(filename);
+    std::stringstream content;
+    content << in.rdbuf();
+    return content.str();
+  }
+};
+
+TEST_F(ProfilerTest, RecordsNestedZones) {
+  runNestedZones();
+
+  std::vector<ZoneEvent> events;
+  getEvents(&events);
+  ASSERT_EQ(events.size(), 2u);
+  EXPECT_EQ(events[0].name, "outer");
+  EXPECT_EQ(events[0].depth, 0u);
+  EXPECT_EQ(events[1].name, "inner");
+  EXPECT_EQ(events[1].depth, 1u);
+  EXPECT_EQ(events[0].thread_index, events[1].thread_index);
+  EXPECT_LE(events[0].start_ns, events[1].start_ns);
+  EXPECT_GE(events[0].end_ns, events[1].end_ns);
+
+  reset();
+  getEvents(&events);
+  EXPECT_TRUE(events.empty());
+}
+
+TEST_F(ProfilerTest, DoesNotRecordIfDisabled) {
+  FLAGS_profiler_enabled = false;
+  runNestedZones();
+  FLAGS_profiler_enabled = true;
+
+  std::vector<ZoneEvent> events;
+  getEvents(&events);
+  EXPECT_TRUE(events.empty());
+}
+
+TEST_F(ProfilerTest, InternsZoneNames) {
+  for (int i = 0; i < 3; ++i) {
+    const std::string name = "zone " + std::to_string(i % 2);
+    MAPLAB_PROFILE_ZONE(name);
+  }
+
+  std::vector<ZoneEvent> events;
+  getEvents(&events);
+  ASSERT_EQ(events.size(), 3u);
+  EXPECT_EQ(events[0].name, "zone 0");
+  EXPECT_EQ(events[1].name, "zone 1");
+  EXPECT_EQ(events[2].name, "zone 0");
+}
+
+TEST_F(ProfilerTest, SeparatesThreads) {
+  std::thread thread_a(&ProfilerTest::runNestedZones);
+  thread_a.join();
+  std::thread thread_b(&ProfilerTest::runNestedZones);
+  {
+    MAPLAB_PROFILE_ZONE("main");
+    runNestedZones();
+  }
+  thread_b.join();
+
+  std::vector<ZoneEvent> events;
+  getEvents(&events);
+  ASSERT_EQ(events.size(), 7u);
+  size_t num_root_zones = 0u;
+  for (const ZoneEvent& event : events) {
+    if (event.depth == 0u) {
+      ++num_root_zones;
+    }
+    if (event.name == "main") {
+      EXPECT_EQ(event.depth, 0u);
+    }
+  }
+  EXPECT_EQ(num_root_zones, 3u);
+  // The events are sorted by thread.
+  for (size_t i = 1u; i < events.size(); ++i) {
+    EXPECT_LE(events[i - 1u].thread_index, events[i].thread_index);
+  }
+}
+
+TEST_F(ProfilerTest, DropsEventsAboveLimit) {
+  const uint64_t max_num_events = FLAGS_profiler_max_num_events;
+  FLAGS_profiler_max_num_events = 1u;
+  runNestedZones();
+  FLAGS_profiler_max_num_events = max_num_events;
+
+  std::vector<ZoneEvent> events;
+  getEvents(&events);
+  ASSERT_EQ(events.size(), 1u);
+  // The inner zone closes first.
+  EXPECT_EQ(events[0].name, "inner");
+  EXPECT_EQ(getNumDroppedEvents(), 1u);
+}
+
+TEST_F(ProfilerTest, WritesChromeTraceAndFoldedStacks) {
+  runNestedZones();
+  {
+    MAPLAB_PROFILE_ZONE("quote\"d;zone");
+  }
+
+  const std::string trace_file = "./profiler_test_trace.json";
+  ASSERT_TRUE(writeChromeTrace(trace_file));
+  const std::string trace = readFile(trace_file);
+  EXPECT_NE(trace.find("\"traceEvents\""), std::string::npos);
+  EXPECT_NE(trace.find("\"name\":\"outer\""), std::string::npos);
+  EXPECT_NE(trace.find("\"name\":\"inner\""), std::string::npos);
+  EXPECT_NE(trace.find("\"name\":\"quote\\\"d;zone\""), std::string::npos);
+  EXPECT_NE(trace.find("\"ph\":\"X\""), std::string::npos);
+  deleteFile(trace_file);
+
+  const std::string stacks_file = "./profiler_test_stacks.folded";
+  ASSERT_TRUE(writeFoldedStacks(stacks_file));
+  const std::string stacks = readFile(stacks_file);
+  EXPECT_NE(stacks.find("outer "), std::string::npos);
+  EXPECT_NE(stacks.find("outer;inner "), std::string::npos);
+  EXPECT_EQ(stacks.find("quote\"d;zone"), std::string::npos);
+  deleteFile(stacks_file);
+}
+
+}  // namespace profiler
+}  // namespace common
+
+MAPLAB_UNITTEST_ENTRYPOINT
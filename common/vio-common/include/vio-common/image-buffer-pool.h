@@ -0,0 +1,69 @@
+#ifndef VIO_COMMON_IMAGE_BUFFER_POOL_H_
+#define VIO_COMMON_IMAGE_BUFFER_POOL_H_
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace vio_common {
+
+/// \class ImageBufferPool
+/// Allocator for reference counted cv::Mat images whose buffers are recycled
+/// through a free-list. A buffer is returned to the pool when the last cv::Mat
+/// referencing it is released and is handed out again for the next image with
+/// the same size in bytes, such that a stream of equally sized images doesn't
+/// allocate in steady state. The images can be copied and passed on like any
+/// other cv::Mat, copies share the buffer.
+class ImageBufferPool : public cv::MatAllocator {
+ public:
+  /// At most max_num_free_buffers_per_size buffers of the same size are kept
+  /// in the free-list, further buffers are freed on release.
+  explicit ImageBufferPool(const size_t max_num_free_buffers_per_size);
+  /// All images allocated from the pool have to be released before.
+  virtual ~ImageBufferPool();
+
+  /// Process wide pool. It is never destroyed, hence images allocated from it
+  /// can outlive all static objects.
+  static ImageBufferPool* getDefaultPool();
+
+  cv::Mat allocateImage(const int rows, const int cols, const int type);
+
+  size_t getNumFreeBuffers() const;
+  size_t getNumBuffersInUse() const;
+  /// Number of buffers that had to be allocated on the heap because the
+  /// free-list was empty.
+  size_t getNumHeapAllocations() const;
+
+  // cv::MatAllocator interface.
+  cv::UMatData* allocate(
+      int dims, const int* sizes, int type, void* data, size_t* step,
+      int flags, cv::UMatUsageFlags usage_flags) const override;
+  bool allocate(
+      cv::UMatData* data, int access_flags,
+      cv::UMatUsageFlags usage_flags) const override;
+  void deallocate(cv::UMatData* data) const override;
+
+ private:
+  const size_t max_num_free_buffers_per_size_;
+
+  mutable std::mutex m_buffers_;
+  // Free buffers by their size in bytes.
+  mutable std::unordered_map<size_t, std::vector<uchar*>> free_buffers_;
+  mutable size_t num_free_buffers_;
+  mutable size_t num_buffers_in_use_;
+  mutable size_t num_heap_allocations_;
+};
+
+/// Returns an image that references the given data without copying it. The
+/// owner of the data is kept alive until the last cv::Mat referencing the data
+/// is released.
+cv::Mat wrapImageData(
+    const int rows, const int cols, const int type, void* data,
+    const size_t step, const std::shared_ptr<const void>& owner);
+
+}  // namespace vio_common
+
+#endif  // VIO_COMMON_IMAGE_BUFFER_POOL_H_
@@ -36,6 +36,7 @@ struct LocalizationResult {
   MAPLAB_POINTER_TYPEDEFS(LocalizationResult);
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
+  // Time of the localized nframe, not of the moment the result was computed.
   int64_t timestamp;
   aslam::NFramesId nframe_id;
   aslam::Transformation T_G_I_lc_pnp;
@@ -49,6 +50,9 @@ struct ImageMeasurement {
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
   int64_t timestamp;
   int camera_index;
+  // Shared with all consumers of the measurement without copies, it must not
+  // be modified. May reference a pooled buffer or the data of the message it
+  // was received with.
   cv::Mat image;
 
   ImageMeasurement()
@@ -0,0 +1,190 @@
+#include "vio-common/image-buffer-pool.h"
+
+#include <glog/logging.h>
+
+namespace vio_common {
+
+namespace {
+// Releases the owner of the referenced data instead of freeing the data.
+class SharedOwnerAllocator : public cv::MatAllocator {
+ public:
+  cv::UMatData* allocate(
+      int dims, const int* sizes, int type, void* data, size_t* step,
+      int flags, cv::UMatUsageFlags usage_flags) const override {
+    return cv::Mat::getStdAllocator()->allocate(
+        dims, sizes, type, data, step, flags, usage_flags);
+  }
+
+  bool allocate(
+      cv::UMatData* data, int access_flags,
+      cv::UMatUsageFlags usage_flags) const override {
+    return cv::Mat::getStdAllocator()->allocate(
+        data, access_flags, usage_flags);
+  }
+
+  void deallocate(cv::UMatData* data) const override {
+    if (data == nullptr) {
+      return;
+    }
+    CHECK_EQ(data->urefcount, 0);
+    CHECK_EQ(data->refcount, 0);
+    delete static_cast<std::shared_ptr<const void>*>(data->userdata);
+    delete data;
+  }
+};
+
+const SharedOwnerAllocator* getSharedOwnerAllocator() {
+  static const SharedOwnerAllocator* allocator = new SharedOwnerAllocator;
+  return allocator;
+}
+}  // namespace
+
+ImageBufferPool::ImageBufferPool(const size_t max_num_free_buffers_per_size)
+    : max_num_free_buffers_per_size_(max_num_free_buffers_per_size),
+      num_free_buffers_(0u),
+      num_buffers_in_use_(0u),
+      num_heap_allocations_(0u) {}
+
+ImageBufferPool::~ImageBufferPool() {
+  std::unique_lock<std::mutex> lock(m_buffers_);
+  CHECK_EQ(num_buffers_in_use_, 0u)
+      << "Images allocated from the pool are still in use.";
+  for (const std::pair<const size_t, std::vector<uchar*>>& size_and_buffers :
+       free_buffers_) {
+    for (uchar* buffer : size_and_buffers.second) {
+      cv::fastFree(buffer);
+    }
+  }
+}
+
+ImageBufferPool* ImageBufferPool::getDefaultPool() {
+  // Enough for a few frames of a multi-camera rig to be queued.
+  constexpr size_t kMaxNumFreeBuffersPerSize = 32u;
+  static ImageBufferPool* pool =
+      new ImageBufferPool(kMaxNumFreeBuffersPerSize);
+  return pool;
+}
+
+cv::Mat ImageBufferPool::allocateImage(
+    const int rows, const int cols, const int type) {
+  cv::Mat image;
+  image.allocator = this;
+  image.create(rows, cols, type);
+  return image;
+}
+
+size_t ImageBufferPool::getNumFreeBuffers() const {
+  std::unique_lock<std::mutex> lock(m_buffers_);
+  return num_free_buffers_;
+}
+
+size_t ImageBufferPool::getNumBuffersInUse() const {
+  std::unique_lock<std::mutex> lock(m_buffers_);
+  return num_buffers_in_use_;
+}
+
+size_t ImageBufferPool::getNumHeapAllocations() const {
+  std::unique_lock<std::mutex> lock(m_buffers_);
+  return num_heap_allocations_;
+}
+
+cv::UMatData* ImageBufferPool::allocate(
+    int dims, const int* sizes, int type, void* data, size_t* step,
+    int /*flags*/, cv::UMatUsageFlags /*usage_flags*/) const {
+  CHECK_NOTNULL(sizes);
+  size_t num_bytes = CV_ELEM_SIZE(type);
+  for (int dim = dims - 1; dim >= 0; --dim) {
+    if (step != nullptr) {
+      if (data != nullptr && step[dim] != CV_AUTOSTEP) {
+        CHECK_LE(num_bytes, step[dim]);
+        num_bytes = step[dim];
+      } else {
+        step[dim] = num_bytes;
+      }
+    }
+    num_bytes *= sizes[dim];
+  }
+
+  cv::UMatData* mat_data = new cv::UMatData(this);
+  mat_data->size = num_bytes;
+  if (data != nullptr) {
+    // Data provided by the user is neither taken from nor returned to the
+    // pool.
+    mat_data->data = mat_data->origdata = static_cast<uchar*>(data);
+    mat_data->flags |= cv::UMatData::USER_ALLOCATED;
+    return mat_data;
+  }
+
+  uchar* buffer = nullptr;
+  {
+    std::unique_lock<std::mutex> lock(m_buffers_);
+    std::unordered_map<size_t, std::vector<uchar*>>::iterator it =
+        free_buffers_.find(num_bytes);
+    if (it != free_buffers_.end() && !it->second.empty()) {
+      buffer = it->second.back();
+      it->second.pop_back();
+      --num_free_buffers_;
+    } else {
+      ++num_heap_allocations_;
+    }
+    ++num_buffers_in_use_;
+  }
+  if (buffer == nullptr) {
+    buffer = static_cast<uchar*>(cv::fastMalloc(num_bytes));
+  }
+  mat_data->data = mat_data->origdata = buffer;
+  return mat_data;
+}
+
+bool ImageBufferPool::allocate(
+    cv::UMatData* data, int /*access_flags*/,
+    cv::UMatUsageFlags /*usage_flags*/) const {
+  return data != nullptr;
+}
+
+void ImageBufferPool::deallocate(cv::UMatData* data) const {
+  if (data == nullptr) {
+    return;
+  }
+  CHECK_EQ(data->urefcount, 0);
+  CHECK_EQ(data->refcount, 0);
+  if ((data->flags & cv::UMatData::USER_ALLOCATED) == 0) {
+    uchar* buffer = data->origdata;
+    {
+      std::unique_lock<std::mutex> lock(m_buffers_);
+      CHECK_GT(num_buffers_in_use_, 0u);
+      --num_buffers_in_use_;
+      std::vector<uchar*>& free_buffers = free_buffers_[data->size];
+      if (free_buffers.size() < max_num_free_buffers_per_size_) {
+        free_buffers.push_back(buffer);
+        ++num_free_buffers_;
+        buffer = nullptr;
+      }
+    }
+    if (buffer != nullptr) {
+      cv::fastFree(buffer);
+    }
+  }
+  delete data;
+}
+
+cv::Mat wrapImageData(
+    const int rows, const int cols, const int type, void* data,
+    const size_t step, const std::shared_ptr<const void>& owner) {
+  CHECK_NOTNULL(data);
+  CHECK(owner);
+  cv::Mat image(rows, cols, type, data, step);
+
+  // Attach reference counted data to the image header, the owner is released
+  // by the allocator once the reference count drops to zero.
+  cv::UMatData* mat_data = new cv::UMatData(getSharedOwnerAllocator());
+  mat_data->data = mat_data->origdata = static_cast<uchar*>(data);
+  mat_data->size = image.step[0] * rows;
+  mat_data->flags |= cv::UMatData::USER_ALLOCATED;
+  mat_data->userdata = new std::shared_ptr<const void>(owner);
+  mat_data->refcount = 1;
+  image.u = mat_data;
+  return image;
+}
+
+}  // namespace vio_common
@@ -0,0 +1,82 @@
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <opencv2/core/core.hpp>
+
+#include <vio-common/image-buffer-pool.h>
+
+namespace vio_common {
+
+TEST(ImageBufferPool, RecyclesReleasedBuffers) {
+  ImageBufferPool pool(2u);
+  const uchar* buffer = nullptr;
+  {
+    cv::Mat image = pool.allocateImage(480, 752, CV_8UC1);
+    buffer = image.data;
+    EXPECT_EQ(pool.getNumBuffersInUse(), 1u);
+    EXPECT_EQ(pool.getNumFreeBuffers(), 0u);
+  }
+  EXPECT_EQ(pool.getNumBuffersInUse(), 0u);
+  EXPECT_EQ(pool.getNumFreeBuffers(), 1u);
+
+  for (int i = 0; i < 10; ++i) {
+    cv::Mat image = pool.allocateImage(480, 752, CV_8UC1);
+    EXPECT_EQ(image.data, buffer);
+  }
+  EXPECT_EQ(pool.getNumHeapAllocations(), 1u);
+
+  // Images with a different size in bytes don't share buffers.
+  cv::Mat other_image = pool.allocateImage(720, 1280, CV_8UC1);
+  EXPECT_NE(other_image.data, buffer);
+  EXPECT_EQ(pool.getNumHeapAllocations(), 2u);
+}
+
+TEST(ImageBufferPool, ReturnsBufferAfterLastCopyIsReleased) {
+  ImageBufferPool pool(2u);
+  cv::Mat image = pool.allocateImage(480, 752, CV_8UC1);
+  cv::Mat image_copy = image;
+  EXPECT_EQ(image_copy.data, image.data);
+
+  image.release();
+  EXPECT_EQ(pool.getNumBuffersInUse(), 1u);
+  image_copy.release();
+  EXPECT_EQ(pool.getNumBuffersInUse(), 0u);
+  EXPECT_EQ(pool.getNumFreeBuffers(), 1u);
+}
+
+TEST(ImageBufferPool, FreesBuffersBeyondLimit) {
+  constexpr size_t kMaxNumFreeBuffers = 2u;
+  ImageBufferPool pool(kMaxNumFreeBuffers);
+  {
+    cv::Mat images[4];
+    for (cv::Mat& image : images) {
+      image = pool.allocateImage(48, 64, CV_8UC1);
+    }
+  }
+  EXPECT_EQ(pool.getNumBuffersInUse(), 0u);
+  EXPECT_EQ(pool.getNumFreeBuffers(), kMaxNumFreeBuffers);
+}
+
+TEST(WrapImageData, KeepsOwnerAliveWithoutCopy) {
+  std::shared_ptr<std::vector<uchar>> data =
+      std::make_shared<std::vector<uchar>>(48 * 64, 7u);
+  std::weak_ptr<std::vector<uchar>> weak_data = data;
+
+  cv::Mat image = wrapImageData(48, 64, CV_8UC1, data->data(), 64u, data);
+  EXPECT_EQ(image.data, data->data());
+  data.reset();
+  ASSERT_FALSE(weak_data.expired());
+
+  cv::Mat image_copy = image;
+  image.release();
+  EXPECT_FALSE(weak_data.expired());
+  EXPECT_EQ(image_copy.at<uchar>(10, 10), 7u);
+  image_copy.release();
+  EXPECT_TRUE(weak_data.expired());
+}
+
+}  // namespace vio_common
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -20,6 +20,12 @@ LandmarkManipulationPlugin::LandmarkManipulationPlugin(
       {"retriangulate_landmarks", "rtl"},
       [this]() -> int { return retriangulateLandmarks(); },
       "Retriangulate all landmarks.", common::Processing::Sync);
+  addCommand(
+      {"retriangulate_dirty_landmarks", "rtdl"},
+      [this]() -> int { return retriangulateDirtyLandmarks(); },
+      "Retriangulate only the landmarks whose observations or observer poses "
+      "changed since the last retriangulation.",
+      common::Processing::Sync);
   addCommand(
       {"evaluate_landmark_quality", "elq"},
       [this]() -> int { return evaluateLandmarkQuality(); },
@@ -55,6 +61,21 @@ int LandmarkManipulationPlugin::retriangulateLandmarks() {
   return (success ? common::kSuccess : common::kUnknownError);
 }
 
+int LandmarkManipulationPlugin::retriangulateDirtyLandmarks() {
+  std::string selected_map_key;
+  if (!getSelectedMapKeyIfSet(&selected_map_key)) {
+    return common::kStupidUserError;
+  }
+
+  vi_map::VIMapManager map_manager;
+  vi_map::VIMapManager::MapWriteAccess map =
+      map_manager.getMapWriteAccess(selected_map_key);
+  const size_t num_retriangulated =
+      landmark_triangulation::retriangulateDirtyLandmarks(map.get());
+  LOG(INFO) << "Retriangulated " << num_retriangulated << " landmark(s).";
+  return common::kSuccess;
+}
+
 int LandmarkManipulationPlugin::evaluateLandmarkQuality() {
   std::string selected_map_key;
   if (!getSelectedMapKeyIfSet(&selected_map_key)) {
@@ -5,18 +5,63 @@
 #include <aslam/common/statistics/statistics.h>
 #include <aslam/common/timer.h>
 #include <console-common/console.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <maplab-common/profiler.h>
+
+DEFINE_string(
+    timing_chrome_trace_file, "",
+    "If set, the timing command writes the recorded profiler zones to this "
+    "file as Chrome trace-event JSON (chrome://tracing, Perfetto).");
+DEFINE_string(
+    timing_folded_stacks_file, "",
+    "If set, the timing command writes the recorded profiler zones to this "
+    "file as folded stacks for flame graphs.");
+DECLARE_bool(profiler_enabled);
+DEFINE_bool(
+    timing_reset_profiler, false,
+    "If set, the timing command discards the recorded profiler zones after "
+    "writing them.");
 
 namespace statistics_plugin {
 
 StatisticsPlugin::StatisticsPlugin(common::Console* console)
     : common::ConsolePluginBase(console) {
+  // The profiler is off by default, requesting an export enables it.
+  if (!FLAGS_timing_chrome_trace_file.empty() ||
+      !FLAGS_timing_folded_stacks_file.empty()) {
+    FLAGS_profiler_enabled = true;
+  }
+
   addCommand(
       {"timing"},
       []() -> int {
         timing::Timing::Print(std::cout);
+        LOG_IF(
+            WARNING, !FLAGS_profiler_enabled &&
+                         (!FLAGS_timing_chrome_trace_file.empty() ||
+                          !FLAGS_timing_folded_stacks_file.empty()))
+            << "The profiler is disabled, no zones were recorded. Enable it "
+            << "with --profiler_enabled.";
+        if (!FLAGS_timing_chrome_trace_file.empty() &&
+            !common::profiler::writeChromeTrace(
+                FLAGS_timing_chrome_trace_file)) {
+          return common::kUnknownError;
+        }
+        if (!FLAGS_timing_folded_stacks_file.empty() &&
+            !common::profiler::writeFoldedStacks(
+                FLAGS_timing_folded_stacks_file)) {
+          return common::kUnknownError;
+        }
+        if (FLAGS_timing_reset_profiler) {
+          common::profiler::reset();
+        }
         return common::kSuccess;
       },
-      "Print timing.", common::Processing::Sync);
+      "Print timing. The profiler zones can be exported with "
+      "--timing_chrome_trace_file and --timing_folded_stacks_file, setting "
+      "either at startup enables the profiler.",
+      common::Processing::Sync);
 
   addCommand(
       {"statistics", "stat"},
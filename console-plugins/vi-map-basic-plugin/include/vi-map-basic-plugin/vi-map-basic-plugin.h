@@ -65,6 +65,8 @@ class VIMapBasicPlugin : public common::ConsolePluginBaseWithPlotter {
 
   int mapStatistics();
   int printMissionCoobservabilityStatistics() const;
+  int printMemoryStatistics() const;
+  int compactDescriptors();
   int printBaseframeTransformations() const;
   int printCameraCalibrations() const;
   int visualizeMap();
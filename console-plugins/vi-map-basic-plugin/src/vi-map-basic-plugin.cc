@@ -17,8 +17,11 @@
 #include <map-resources/resource-map.h>
 #include <maplab-common/file-system-tools.h>
 #include <maplab-common/map-manager-config.h>
+#include <maplab-common/threading-helpers.h>
 #include <maplab-common/ui-utility.h>
 #include <vi-map-helpers/mission-clustering-coobservation.h>
+#include <vi-map-helpers/vi-map-descriptor-compaction.h>
+#include <vi-map-helpers/vi-map-memory-statistics.h>
 #include <vi-map/check-map-consistency.h>
 #include <vi-map/semantics-manager.h>
 #include <vi-map/vi-map.h>
@@ -63,6 +66,17 @@ DEFINE_string(
     maps_folder, ".",
     "Folder which contains one or more maps on the filesystem.");
 
+DEFINE_uint64(
+    compact_descriptors_max_observations_per_landmark, 0u,
+    "If larger than 0, compact_descriptors additionally keeps only this many "
+    "observations of every landmark, the ones with the most representative "
+    "descriptors. The other observations are removed.");
+DEFINE_bool(
+    compact_descriptors_discard_tracked_keypoints, false,
+    "If set, compact_descriptors also discards the unassociated keypoints "
+    "that have a valid track id. This saves more memory, but no new landmarks "
+    "can be initialized from the feature tracks of the map afterwards.");
+
 DEFINE_double(
     spatially_distribute_missions_meters, 20,
     "Amount to shift missions when distributing them spatially.");
@@ -284,6 +298,20 @@ VIMapBasicPlugin::VIMapBasicPlugin(
       {"mcs", "mission_coobservability_stats"},
       [this]() -> int { return printMissionCoobservabilityStatistics(); },
       "Print mission co-observability statistics.", common::Processing::Sync);
+  addCommand(
+      {"memory_statistics", "mem_stats"},
+      [this]() -> int { return printMemoryStatistics(); },
+      "Print an estimate of the memory used by the selected map, per mission "
+      "and per component, and of the memory that could likely be freed.",
+      common::Processing::Sync);
+  addCommand(
+      {"compact_descriptors"}, [this]() -> int { return compactDescriptors(); },
+      "Discards the keypoints and descriptors that are neither associated "
+      "with a landmark nor part of a feature track and prints the memory "
+      "before and after. See --compact_descriptors_discard_tracked_keypoints "
+      "to also discard tracked keypoints and "
+      "--compact_descriptors_max_observations_per_landmark for a lossy mode.",
+      common::Processing::Sync);
   addCommand(
       {"print_baseframes"},
       [this]() -> int { return printBaseframeTransformations(); },
@@ -1057,6 +1085,68 @@ int VIMapBasicPlugin::mapStatistics() {
   return common::kSuccess;
 }
 
+int VIMapBasicPlugin::printMemoryStatistics() const {
+  std::string selected_map_key;
+  if (!getSelectedMapKeyIfSet(&selected_map_key)) {
+    return common::kStupidUserError;
+  }
+  const vi_map::VIMapManager map_manager;
+  vi_map::VIMapManager::MapReadAccess map =
+      map_manager.getMapReadAccess(selected_map_key);
+
+  vi_map_helpers::VIMapMemoryStatistics memory_statistics;
+  vi_map_helpers::computeVIMapMemoryStatistics(
+      *map, common::getNumHardwareThreads(), &memory_statistics);
+  std::cout << memory_statistics.toString() << std::endl;
+  return common::kSuccess;
+}
+
+int VIMapBasicPlugin::compactDescriptors() {
+  std::string selected_map_key;
+  if (!getSelectedMapKeyIfSet(&selected_map_key)) {
+    return common::kStupidUserError;
+  }
+  vi_map::VIMapManager map_manager;
+  vi_map::VIMapManager::MapWriteAccess map =
+      map_manager.getMapWriteAccess(selected_map_key);
+
+  vi_map_helpers::DescriptorCompactionOptions options;
+  if (FLAGS_compact_descriptors_max_observations_per_landmark > 0u) {
+    options.mode = vi_map_helpers::DescriptorCompactionOptions::Mode::
+        kKeepLandmarkRepresentatives;
+    options.max_observations_per_landmark =
+        FLAGS_compact_descriptors_max_observations_per_landmark;
+  }
+  options.discard_tracked_keypoints =
+      FLAGS_compact_descriptors_discard_tracked_keypoints;
+  options.num_threads = common::getNumHardwareThreads();
+
+  vi_map_helpers::VIMapMemoryStatistics memory_before;
+  vi_map_helpers::computeVIMapMemoryStatistics(
+      *map, options.num_threads, &memory_before);
+
+  vi_map::MissionIdList mission_ids;
+  map->getAllMissionIds(&mission_ids);
+  vi_map_helpers::DescriptorCompactionResult result;
+  vi_map_helpers::compactDescriptors(
+      options, mission_ids, map.get(), &result);
+
+  vi_map_helpers::VIMapMemoryStatistics memory_after;
+  vi_map_helpers::computeVIMapMemoryStatistics(
+      *map, options.num_threads, &memory_after);
+
+  constexpr double kBytesToMegaBytes = 1.0 / (1024.0 * 1024.0);
+  std::cout << "Removed observations: " << result.num_removed_observations
+            << "\nDiscarded keypoints: " << result.num_discarded_keypoints
+            << "\nDiscarded descriptors: "
+            << result.num_discarded_descriptor_bytes * kBytesToMegaBytes
+            << " MB\n"
+            << "Memory before compaction:\n"
+            << memory_before.toString() << "\nMemory after compaction:\n"
+            << memory_after.toString() << std::endl;
+  return common::kSuccess;
+}
+
 int VIMapBasicPlugin::printMissionCoobservabilityStatistics() const {
   std::string selected_map_key;
   if (!getSelectedMapKeyIfSet(&selected_map_key)) {
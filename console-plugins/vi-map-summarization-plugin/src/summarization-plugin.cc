@@ -1,14 +1,24 @@
 #include "vi-map-summarization-plugin/summarization-plugin.h"
 
+#include <vector>
+
 #include <console-common/console.h>
 #include <localization-summary-map/localization-summary-map-creation.h>
+#include <localization-summary-map/localization-summary-map-tiling.h>
 #include <localization-summary-map/localization-summary-map.h>
+#include <loop-closure-handler/loop-detector-node.h>
 #include <map-manager/map-manager.h>
 #include <maplab-common/file-system-tools.h>
 #include <vi-map/vi-map.h>
 
 DEFINE_string(summary_map_save_path, "", "Save path of the summary map.");
+DEFINE_double(
+    summary_map_tile_size_m, 0.0,
+    "If positive, the summary map is split into square tiles of this size "
+    "[m] that can be loaded on demand during localization.");
 DECLARE_bool(overwrite);
+DECLARE_bool(lc_precompute_summary_map_word_indices);
+DECLARE_bool(lc_product_quantize_summary_map);
 
 namespace summarization_plugin {
 
@@ -41,8 +51,33 @@ int SummarizationPlugin::saveSummaryMapToDisk() const {
   summary_map::createLocalizationSummaryMapForWellConstrainedLandmarks(
       *map, &summary_map);
 
+  if (FLAGS_lc_product_quantize_summary_map) {
+    loop_detector_node::LoopDetectorNode loop_detector;
+    if (!loop_detector.productQuantizeLocalizationSummaryMap(&summary_map)) {
+      LOG(ERROR) << "Product quantizing the summary map failed.";
+      return common::kStupidUserError;
+    }
+  } else if (FLAGS_lc_precompute_summary_map_word_indices) {
+    loop_detector_node::LoopDetectorNode loop_detector;
+    loop_detector.computeLocalizationSummaryMapWordIndices(&summary_map);
+  }
+
   backend::SaveConfig save_config;
   save_config.overwrite_existing_files = FLAGS_overwrite;
+  if (FLAGS_summary_map_tile_size_m > 0.0) {
+    summary_map::TiledLocalizationSummaryMapIndex index;
+    std::vector<summary_map::LocalizationSummaryMap::Ptr> tiles;
+    summary_map::createTiledLocalizationSummaryMap(
+        summary_map, FLAGS_summary_map_tile_size_m, &index, &tiles);
+    if (!summary_map::saveTiledLocalizationSummaryMapToFolder(
+            FLAGS_summary_map_save_path, index, tiles, save_config)) {
+      LOG(ERROR) << "Saving tiled summary map failed.";
+      return common::kUnknownError;
+    }
+    LOG(INFO) << "Saved a tiled summary map with " << tiles.size()
+              << " tiles.";
+    return common::kSuccess;
+  }
   if (!summary_map.saveToFolder(FLAGS_summary_map_save_path, save_config)) {
     LOG(ERROR) << "Saving summary map failed.";
     return common::kUnknownError;
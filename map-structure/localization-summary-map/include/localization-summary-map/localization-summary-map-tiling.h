@@ -0,0 +1,68 @@
+#ifndef LOCALIZATION_SUMMARY_MAP_LOCALIZATION_SUMMARY_MAP_TILING_H_
+#define LOCALIZATION_SUMMARY_MAP_LOCALIZATION_SUMMARY_MAP_TILING_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+#include <maplab-common/map-manager-config.h>
+
+#include "localization-summary-map/localization-summary-map.h"
+
+namespace summary_map {
+
+// A tiled summary map splits the landmarks of a summary map into square
+// tiles on the xy-plane of the global frame. Every tile is a self-contained
+// summary map holding the landmarks of the tile together with all their
+// observations and observers, such that it can be loaded and added to a
+// localization database on its own.
+struct LocalizationSummaryMapTile {
+  // Grid coordinates of the tile, i.e. the tile covers
+  // [x, x + 1) * tile_size_meters and [y, y + 1) * tile_size_meters.
+  int x;
+  int y;
+  // Folder of the tile relative to the folder of the tiled map.
+  std::string folder_name;
+  size_t num_landmarks;
+  size_t num_observations;
+  // Approximate memory used by the tile once loaded, in bytes. Excludes the
+  // vocabulary of the localization database built from the tile.
+  size_t num_bytes;
+
+  // Distance from the given position to the closest point of the tile on the
+  // xy-plane. Returns 0 if the position lies within the tile.
+  double getDistanceToTile(
+      const Eigen::Vector3d& p_G, const double tile_size_meters) const;
+};
+
+struct TiledLocalizationSummaryMapIndex {
+  TiledLocalizationSummaryMapIndex() : tile_size_meters(0.0) {}
+
+  double tile_size_meters;
+  std::vector<LocalizationSummaryMapTile> tiles;
+
+  size_t getTotalNumBytes() const;
+};
+
+// Splits the summary map into tiles of the given size. Only non-empty tiles
+// are created. The tiles and index entries are in the same order.
+void createTiledLocalizationSummaryMap(
+    const LocalizationSummaryMap& summary_map, const double tile_size_meters,
+    TiledLocalizationSummaryMapIndex* index,
+    std::vector<LocalizationSummaryMap::Ptr>* tiles);
+
+bool saveTiledLocalizationSummaryMapToFolder(
+    const std::string& folder_path,
+    const TiledLocalizationSummaryMapIndex& index,
+    const std::vector<LocalizationSummaryMap::Ptr>& tiles,
+    const backend::SaveConfig& config);
+bool loadTiledLocalizationSummaryMapIndexFromFolder(
+    const std::string& folder_path, TiledLocalizationSummaryMapIndex* index);
+bool loadLocalizationSummaryMapTileFromFolder(
+    const std::string& folder_path, const LocalizationSummaryMapTile& tile,
+    LocalizationSummaryMap* summary_map);
+bool hasTiledLocalizationSummaryMapOnFileSystem(const std::string& folder_path);
+
+}  // namespace summary_map
+#endif  // LOCALIZATION_SUMMARY_MAP_LOCALIZATION_SUMMARY_MAP_TILING_H_
@@ -1,12 +1,16 @@
 #ifndef LOCALIZATION_SUMMARY_MAP_LOCALIZATION_SUMMARY_MAP_H_
 #define LOCALIZATION_SUMMARY_MAP_LOCALIZATION_SUMMARY_MAP_H_
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <Eigen/Core>
 
 #include <aslam/common/memory.h>
+#include <loopclosure-common/product-quantization-codebook.h>
 #include <maplab-common/macros.h>
 #include <maplab-common/map-manager-config.h>
 #include <vi-map/landmark.h>
@@ -29,6 +33,8 @@ class LocalizationSummaryMap {
   MAPLAB_POINTER_TYPEDEFS(LocalizationSummaryMap);
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
+  LocalizationSummaryMap();
+
   inline void setId(
       const LocalizationSummaryMapId& localization_summary_map_id) {
     id_ = localization_summary_map_id;
@@ -69,9 +75,51 @@ class LocalizationSummaryMap {
   const Eigen::Matrix<unsigned int, Eigen::Dynamic, 1>&
   observationToLandmarkIndex() const;
 
+  // The visual word assignment of the projected descriptors is optional. It
+  // is precomputed by the loop-closure backend and stored alongside the summary
+  // map such that the localization database can be built without quantizing
+  // every descriptor again. The fingerprint identifies the vocabulary the word
+  // indices refer to.
+  void setObservationWordIndices(
+      const Eigen::VectorXi& observation_word_indices,
+      const uint64_t vocabulary_fingerprint);
+  bool hasObservationWordIndices() const;
+  const Eigen::VectorXi& observationWordIndices() const;
+  uint64_t vocabularyFingerprint() const;
+
+  // The projected descriptors can alternatively be stored in product quantized
+  // form, i.e. as the word of the loop-closure vocabulary and the product
+  // quantized residual w.r.t. that word. This requires a few bytes per
+  // observation instead of a float per descriptor dimension. The projected
+  // descriptors are dropped when the product quantized descriptors are set.
+  void setProductQuantizedDescriptors(
+      const loop_closure::ProductQuantizationCodebook& codebook,
+      const Eigen::VectorXi& word_indices,
+      const loop_closure::ProductQuantizedDescriptorMatrix&
+          quantized_residuals);
+  bool hasProductQuantizedDescriptors() const;
+  const loop_closure::ProductQuantizationCodebook&
+  productQuantizationCodebook() const;
+  const Eigen::VectorXi& productQuantizedWordIndices() const;
+  const loop_closure::ProductQuantizedDescriptorMatrix&
+  productQuantizedResiduals() const;
+
+  // Returns the projected descriptors. They are approximately reconstructed
+  // if only the product quantized descriptors are stored.
+  void getProjectedDescriptors(Eigen::MatrixXf* projected_descriptors) const;
+  // Returns the projected descriptors of the given observations only, in the
+  // given order.
+  void getProjectedDescriptors(
+      const std::vector<int>& observation_indices,
+      Eigen::MatrixXf* projected_descriptors) const;
+  int numObservations() const;
+  // Memory used to store the descriptors of all observations, in bytes.
+  size_t getDescriptorMemoryBytes() const;
+
   bool hasLandmark(const vi_map::LandmarkId& landmark_id) const;
   Eigen::Vector3d getGLandmarkPosition(
       const vi_map::LandmarkId& landmark_id) const;
+  const vi_map::LandmarkId& getLandmarkIdForIndex(int landmark_index) const;
   bool hasVertex(const pose_graph::VertexId& vertex_id) const;
   void getAllObserverIds(pose_graph::VertexIdList* observer_ids) const;
   void getAllLandmarkIds(vi_map::LandmarkIdList* landmark_ids) const;
@@ -81,6 +129,12 @@ class LocalizationSummaryMap {
 
  private:
   static constexpr char kFileName[] = "localization_summary_map";
+  static constexpr char kWordIndicesFileName[] =
+      "localization_summary_map_word_indices";
+  enum { kWordIndicesSerializationVersion = 100 };
+
+  bool saveObservationWordIndicesToFolder(const std::string& folder_path) const;
+  bool loadObservationWordIndicesFromFolder(const std::string& folder_path);
 
   // The goal here is to get the most compact representation (memory).
   // So instead of storing for every descriptor a vertex+frame id pair, we just
@@ -91,6 +145,8 @@ class LocalizationSummaryMap {
   LocalizationSummaryMapId id_;
   /// Mapping of landmark-ids to landmark indices.
   std::unordered_map<vi_map::LandmarkId, int> landmark_id_to_landmark_index_;
+  /// Inverse of the mapping above, indexed by landmark index.
+  vi_map::LandmarkIdList landmark_index_to_landmark_id_;
   /// The position of the landmarks in the global frame of reference.
   Eigen::Matrix3Xf G_landmark_position_;
   /// Mapping of vertex-ids to vertex indices.
@@ -103,6 +159,16 @@ class LocalizationSummaryMap {
   Eigen::Matrix<unsigned int, Eigen::Dynamic, 1> observer_indices_;
   /// A mapping from observation (descriptor) to index in G_landmark_position.
   Eigen::Matrix<unsigned int, Eigen::Dynamic, 1> observation_to_landmark_index_;
+  /// Optional visual word of every observation (descriptor) in the vocabulary
+  /// of the loop-closure index.
+  Eigen::VectorXi observation_word_indices_;
+  /// Fingerprint of the vocabulary used to compute the word indices.
+  uint64_t vocabulary_fingerprint_;
+  /// Optional product quantized representation of the projected descriptors.
+  loop_closure::ProductQuantizationCodebook product_quantization_codebook_;
+  Eigen::VectorXi product_quantized_word_indices_;
+  loop_closure::ProductQuantizedDescriptorMatrix
+      product_quantized_residuals_;
 };
 
 typedef std::unordered_map<LocalizationSummaryMapId,
@@ -10,6 +10,7 @@
 #include <map-sparsification/sampler-factory.h>
 #include <maplab-common/binary-serialization.h>
 #include <maplab-common/eigen-proto.h>
+#include <maplab-common/profiler.h>
 #include <vi-map-helpers/vi-map-queries.h>
 #include <vi-map/vi-map.h>
 
@@ -44,7 +45,10 @@ void createLocalizationSummaryMapForSummarizedLandmarks(
       landmark_keep_fraction * num_good_landmarks;
 
   vi_map::LandmarkIdSet landmarks_to_keep;
-  sampler->sample(map, desired_num_landmarks, &landmarks_to_keep);
+  {
+    MAPLAB_PROFILE_ZONE("Summary map: Sample landmarks");
+    sampler->sample(map, desired_num_landmarks, &landmarks_to_keep);
+  }
 
   vi_map::LandmarkIdList landmarks_to_keep_list(
       landmarks_to_keep.begin(), landmarks_to_keep.end());
@@ -65,6 +69,7 @@ void createLocalizationSummaryMapFromLandmarkList(
     LocalizationSummaryMapCache* summary_map_cache,
     summary_map::LocalizationSummaryMap* summary_map) {
   CHECK_NOTNULL(summary_map);
+  MAPLAB_PROFILE_ZONE("Summary map: Create from landmark list");
   /// The position of the landmarks in the global frame of reference.
   Eigen::Matrix3Xd G_landmark_position;
   /// The position of the observers in the global frame of reference.
@@ -140,6 +145,7 @@ void createLocalizationSummaryMapFromLandmarkList(
   observer_indices.resize(observations.size());
   Aligned<std::vector, Eigen::Vector3d> G_observer_positions;
 
+  MAPLAB_PROFILE_ZONE("Summary map: Project descriptors");
   std::unordered_map<vi_map::VisualFrameIdentifier, int> frame_id_to_index;
   int observer_index = 0;
   for (size_t observation_index = 0; observation_index < observations.size();
@@ -0,0 +1,326 @@
+#include "localization-summary-map/localization-summary-map-tiling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+#include <utility>
+
+#include <glog/logging.h>
+#include <maplab-common/file-system-tools.h>
+#include <maplab-common/proto-serialization-helper.h>
+
+#include "localization-summary-map/localization-summary-map.pb.h"
+
+namespace summary_map {
+
+namespace {
+constexpr char kTileIndexFileName[] = "localization_summary_map_tiles";
+
+int getTileCoordinate(const double position, const double tile_size_meters) {
+  return static_cast<int>(std::floor(position / tile_size_meters));
+}
+
+size_t estimateTileMemoryBytes(const LocalizationSummaryMap& tile) {
+  const size_t num_observations = tile.numObservations();
+  // Landmark, observer and observation bookkeeping of the summary map.
+  size_t num_bytes = sizeof(float) * (tile.GLandmarkPosition().size() +
+                                      tile.GObserverPosition().size()) +
+                     2u * sizeof(unsigned int) * num_observations;
+  num_bytes += tile.getDescriptorMemoryBytes() +
+               sizeof(int) * tile.observationWordIndices().size();
+  // The localization database keeps its own copy of every descriptor and its
+  // index. Product quantized descriptors are inserted as codes, the codebook
+  // is part of the vocabulary of the database.
+  size_t num_bytes_per_database_descriptor = sizeof(int);
+  if (tile.hasProductQuantizedDescriptors()) {
+    num_bytes_per_database_descriptor +=
+        tile.productQuantizationCodebook().codeLength();
+  } else {
+    num_bytes_per_database_descriptor +=
+        sizeof(float) * tile.projectedDescriptors().rows();
+  }
+  num_bytes += num_bytes_per_database_descriptor * num_observations;
+  return num_bytes;
+}
+
+template <typename Derived>
+void selectColumns(
+    const Eigen::MatrixBase<Derived>& input, const std::vector<int>& columns,
+    Eigen::Matrix<
+        typename Derived::Scalar, Derived::RowsAtCompileTime, Eigen::Dynamic>*
+        output) {
+  CHECK_NOTNULL(output)->resize(input.rows(), columns.size());
+  for (size_t i = 0u; i < columns.size(); ++i) {
+    output->col(i) = input.col(columns[i]);
+  }
+}
+
+void extractTile(
+    const LocalizationSummaryMap& summary_map,
+    const std::vector<int>& landmark_indices, LocalizationSummaryMap* tile) {
+  CHECK_NOTNULL(tile);
+  CHECK(!landmark_indices.empty());
+
+  LocalizationSummaryMapId tile_id;
+  common::generateId(&tile_id);
+  tile->setId(tile_id);
+
+  const Eigen::Matrix3Xf& G_landmark_position =
+      summary_map.GLandmarkPosition();
+  std::vector<int> tile_landmark_index(G_landmark_position.cols(), -1);
+  Eigen::Matrix3Xd G_tile_landmark_position(3, landmark_indices.size());
+  for (size_t i = 0u; i < landmark_indices.size(); ++i) {
+    tile_landmark_index[landmark_indices[i]] = i;
+    G_tile_landmark_position.col(i) =
+        G_landmark_position.col(landmark_indices[i]).cast<double>();
+  }
+
+  // Keep all observations of the tile's landmarks and the observers they
+  // were made from.
+  const Eigen::Matrix<unsigned int, Eigen::Dynamic, 1>& observer_indices =
+      summary_map.observerIndices();
+  const Eigen::Matrix<unsigned int, Eigen::Dynamic, 1>&
+      observation_to_landmark_index = summary_map.observationToLandmarkIndex();
+  CHECK_EQ(observer_indices.rows(), observation_to_landmark_index.rows());
+  const Eigen::Matrix3Xf& G_observer_position = summary_map.GObserverPosition();
+  std::vector<int> tile_observer_index(G_observer_position.cols(), -1);
+  std::vector<int> observation_indices;
+  std::vector<int> observer_indices_in_map;
+  for (int i = 0; i < observation_to_landmark_index.rows(); ++i) {
+    if (tile_landmark_index[observation_to_landmark_index(i)] < 0) {
+      continue;
+    }
+    observation_indices.push_back(i);
+    int& observer_index = tile_observer_index[observer_indices(i)];
+    if (observer_index < 0) {
+      observer_index = observer_indices_in_map.size();
+      observer_indices_in_map.push_back(observer_indices(i));
+    }
+  }
+
+  const int num_observations = observation_indices.size();
+  Eigen::Matrix<unsigned int, Eigen::Dynamic, 1> tile_observer_indices(
+      num_observations);
+  Eigen::Matrix<unsigned int, Eigen::Dynamic, 1>
+      tile_observation_to_landmark_index(num_observations);
+  for (int i = 0; i < num_observations; ++i) {
+    const int observation_index = observation_indices[i];
+    tile_observer_indices(i) =
+        tile_observer_index[observer_indices(observation_index)];
+    tile_observation_to_landmark_index(i) = tile_landmark_index
+        [observation_to_landmark_index(observation_index)];
+  }
+  Eigen::Matrix3Xf G_tile_observer_position;
+  selectColumns(
+      G_observer_position, observer_indices_in_map, &G_tile_observer_position);
+
+  tile->setGLandmarkPosition(G_tile_landmark_position);
+  tile->setGObserverPosition(G_tile_observer_position.cast<double>());
+
+  // The descriptors are set first as this resets any derived data.
+  if (summary_map.hasProductQuantizedDescriptors()) {
+    tile->setProjectedDescriptors(Eigen::MatrixXf(
+        summary_map.productQuantizationCodebook().descriptorDimensionality(),
+        0));
+  } else {
+    Eigen::MatrixXf tile_descriptors;
+    selectColumns(
+        summary_map.projectedDescriptors(), observation_indices,
+        &tile_descriptors);
+    tile->setProjectedDescriptors(tile_descriptors);
+  }
+  tile->setObserverIndices(tile_observer_indices);
+  tile->setObservationToLandmarkIndex(tile_observation_to_landmark_index);
+
+  if (summary_map.hasProductQuantizedDescriptors()) {
+    Eigen::VectorXi word_indices(num_observations);
+    const Eigen::VectorXi& map_word_indices =
+        summary_map.productQuantizedWordIndices();
+    for (int i = 0; i < num_observations; ++i) {
+      word_indices(i) = map_word_indices(observation_indices[i]);
+    }
+    loop_closure::ProductQuantizedDescriptorMatrix quantized_residuals;
+    selectColumns(
+        summary_map.productQuantizedResiduals(), observation_indices,
+        &quantized_residuals);
+    tile->setProductQuantizedDescriptors(
+        summary_map.productQuantizationCodebook(), word_indices,
+        quantized_residuals);
+  } else if (summary_map.hasObservationWordIndices()) {
+    Eigen::VectorXi word_indices(num_observations);
+    const Eigen::VectorXi& map_word_indices =
+        summary_map.observationWordIndices();
+    for (int i = 0; i < num_observations; ++i) {
+      word_indices(i) = map_word_indices(observation_indices[i]);
+    }
+    tile->setObservationWordIndices(
+        word_indices, summary_map.vocabularyFingerprint());
+  }
+}
+}  // namespace
+
+double LocalizationSummaryMapTile::getDistanceToTile(
+    const Eigen::Vector3d& p_G, const double tile_size_meters) const {
+  CHECK_GT(tile_size_meters, 0.0);
+  const double min_x = x * tile_size_meters;
+  const double min_y = y * tile_size_meters;
+  const double dx = std::max(
+      std::max(min_x - p_G.x(), 0.0), p_G.x() - (min_x + tile_size_meters));
+  const double dy = std::max(
+      std::max(min_y - p_G.y(), 0.0), p_G.y() - (min_y + tile_size_meters));
+  return std::sqrt(dx * dx + dy * dy);
+}
+
+size_t TiledLocalizationSummaryMapIndex::getTotalNumBytes() const {
+  size_t num_bytes = 0u;
+  for (const LocalizationSummaryMapTile& tile : tiles) {
+    num_bytes += tile.num_bytes;
+  }
+  return num_bytes;
+}
+
+void createTiledLocalizationSummaryMap(
+    const LocalizationSummaryMap& summary_map, const double tile_size_meters,
+    TiledLocalizationSummaryMapIndex* index,
+    std::vector<LocalizationSummaryMap::Ptr>* tiles) {
+  CHECK_NOTNULL(index);
+  CHECK_NOTNULL(tiles);
+  CHECK_GT(tile_size_meters, 0.0);
+
+  // Bucket the landmarks by tile; the ordered map keeps the tile order
+  // deterministic.
+  const Eigen::Matrix3Xf& G_landmark_position =
+      summary_map.GLandmarkPosition();
+  std::map<std::pair<int, int>, std::vector<int>> tile_to_landmark_indices;
+  for (int i = 0; i < G_landmark_position.cols(); ++i) {
+    const std::pair<int, int> tile_coordinates(
+        getTileCoordinate(G_landmark_position(0, i), tile_size_meters),
+        getTileCoordinate(G_landmark_position(1, i), tile_size_meters));
+    tile_to_landmark_indices[tile_coordinates].push_back(i);
+  }
+
+  index->tile_size_meters = tile_size_meters;
+  index->tiles.clear();
+  index->tiles.reserve(tile_to_landmark_indices.size());
+  tiles->clear();
+  tiles->reserve(tile_to_landmark_indices.size());
+  for (const std::pair<const std::pair<int, int>, std::vector<int>>& value :
+       tile_to_landmark_indices) {
+    LocalizationSummaryMap::Ptr tile_map(new LocalizationSummaryMap);
+    extractTile(summary_map, value.second, tile_map.get());
+
+    LocalizationSummaryMapTile tile;
+    tile.x = value.first.first;
+    tile.y = value.first.second;
+    tile.folder_name =
+        "tile_" + std::to_string(tile.x) + "_" + std::to_string(tile.y);
+    tile.num_landmarks = value.second.size();
+    tile.num_observations = tile_map->numObservations();
+    tile.num_bytes = estimateTileMemoryBytes(*tile_map);
+
+    index->tiles.push_back(tile);
+    tiles->push_back(tile_map);
+  }
+  VLOG(1) << "Split the summary map into " << tiles->size() << " tiles of "
+          << tile_size_meters << "m.";
+}
+
+bool saveTiledLocalizationSummaryMapToFolder(
+    const std::string& folder_path,
+    const TiledLocalizationSummaryMapIndex& index,
+    const std::vector<LocalizationSummaryMap::Ptr>& tiles,
+    const backend::SaveConfig& config) {
+  CHECK(!folder_path.empty());
+  CHECK_EQ(index.tiles.size(), tiles.size());
+  if (!config.overwrite_existing_files &&
+      hasTiledLocalizationSummaryMapOnFileSystem(folder_path)) {
+    LOG(ERROR) << "A tiled summary map already exists under \"" << folder_path
+               << "\".";
+    return false;
+  }
+  if (!common::createPath(folder_path)) {
+    LOG(ERROR) << "Creating path to \"" << folder_path << "\" failed.";
+    return false;
+  }
+
+  proto::TiledLocalizationSummaryMapIndex proto;
+  proto.set_tile_size_meters(index.tile_size_meters);
+  for (size_t i = 0u; i < tiles.size(); ++i) {
+    const LocalizationSummaryMapTile& tile = index.tiles[i];
+    CHECK(tiles[i]);
+    if (!tiles[i]->saveToFolder(
+            common::concatenateFolderAndFileName(
+                folder_path, tile.folder_name),
+            config)) {
+      LOG(ERROR) << "Saving tile " << tile.folder_name << " failed.";
+      return false;
+    }
+
+    proto::LocalizationSummaryMapTile* tile_proto = proto.add_tiles();
+    tile_proto->set_x(tile.x);
+    tile_proto->set_y(tile.y);
+    tile_proto->set_folder_name(tile.folder_name);
+    tile_proto->set_num_landmarks(tile.num_landmarks);
+    tile_proto->set_num_observations(tile.num_observations);
+    tile_proto->set_num_bytes(tile.num_bytes);
+  }
+
+  // The index is written last such that a partially written tiled map is not
+  // picked up.
+  return common::proto_serialization_helper::serializeProtoToFile(
+      folder_path, kTileIndexFileName, proto);
+}
+
+bool loadTiledLocalizationSummaryMapIndexFromFolder(
+    const std::string& folder_path, TiledLocalizationSummaryMapIndex* index) {
+  CHECK_NOTNULL(index);
+  if (!hasTiledLocalizationSummaryMapOnFileSystem(folder_path)) {
+    LOG(ERROR) << "No tiled summary map could be found under \""
+               << folder_path << "\".";
+    return false;
+  }
+
+  proto::TiledLocalizationSummaryMapIndex proto;
+  if (!common::proto_serialization_helper::parseProtoFromFile(
+          folder_path, kTileIndexFileName, &proto)) {
+    LOG(ERROR) << "Tiled summary map index under \"" << folder_path
+               << "\" couldn't be parsed by protobuf.";
+    return false;
+  }
+
+  index->tile_size_meters = proto.tile_size_meters();
+  index->tiles.resize(proto.tiles_size());
+  for (int i = 0; i < proto.tiles_size(); ++i) {
+    const proto::LocalizationSummaryMapTile& tile_proto = proto.tiles(i);
+    LocalizationSummaryMapTile& tile = index->tiles[i];
+    tile.x = tile_proto.x();
+    tile.y = tile_proto.y();
+    tile.folder_name = tile_proto.folder_name();
+    tile.num_landmarks = tile_proto.num_landmarks();
+    tile.num_observations = tile_proto.num_observations();
+    tile.num_bytes = tile_proto.num_bytes();
+  }
+  return true;
+}
+
+bool loadLocalizationSummaryMapTileFromFolder(
+    const std::string& folder_path, const LocalizationSummaryMapTile& tile,
+    LocalizationSummaryMap* summary_map) {
+  CHECK_NOTNULL(summary_map);
+  return summary_map->loadFromFolder(
+      common::concatenateFolderAndFileName(folder_path, tile.folder_name));
+}
+
+bool hasTiledLocalizationSummaryMapOnFileSystem(
+    const std::string& folder_path) {
+  CHECK(!folder_path.empty());
+  if (!common::pathExists(folder_path)) {
+    return false;
+  }
+  return common::fileExists(
+      common::concatenateFolderAndFileName(
+          common::getRealPath(folder_path), kTileIndexFileName));
+}
+
+}  // namespace summary_map
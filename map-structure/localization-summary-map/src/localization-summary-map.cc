@@ -1,5 +1,9 @@
 #include "localization-summary-map/localization-summary-map.h"
 
+#include <algorithm>
+#include <fstream>  // NOLINT
+
+#include <maplab-common/binary-serialization.h>
 #include <maplab-common/eigen-proto.h>
 #include <maplab-common/file-system-tools.h>
 #include <maplab-common/proto-serialization-helper.h>
@@ -8,8 +12,23 @@
 #include "localization-summary-map/localization-summary-map.pb.h"
 
 namespace summary_map {
+namespace {
+// Unlike common::Deserialize, returns false instead of failing if the stream
+// ends early.
+template <typename Type>
+bool readValue(std::istream* in_stream, Type* value) {
+  CHECK_NOTNULL(in_stream);
+  CHECK_NOTNULL(value);
+  in_stream->read(reinterpret_cast<char*>(value), sizeof(Type));
+  return in_stream->gcount() == static_cast<std::streamsize>(sizeof(Type));
+}
+}  // namespace
 
 constexpr char LocalizationSummaryMap::kFileName[];
+constexpr char LocalizationSummaryMap::kWordIndicesFileName[];
+
+LocalizationSummaryMap::LocalizationSummaryMap()
+    : vocabulary_fingerprint_(0u) {}
 
 bool LocalizationSummaryMap::operator==(
     const LocalizationSummaryMap& other) const {
@@ -23,6 +42,17 @@ bool LocalizationSummaryMap::operator==(
   is_same &= observer_indices_ == other.observer_indices_;
   is_same &=
       observation_to_landmark_index_ == other.observation_to_landmark_index_;
+  is_same &=
+      product_quantization_codebook_ == other.product_quantization_codebook_;
+  is_same &= product_quantized_word_indices_.rows() ==
+                 other.product_quantized_word_indices_.rows() &&
+             product_quantized_word_indices_ ==
+                 other.product_quantized_word_indices_;
+  is_same &= product_quantized_residuals_.rows() ==
+                 other.product_quantized_residuals_.rows() &&
+             product_quantized_residuals_.cols() ==
+                 other.product_quantized_residuals_.cols() &&
+             product_quantized_residuals_ == other.product_quantized_residuals_;
   return is_same;
 }
 bool LocalizationSummaryMap::operator!=(
@@ -49,6 +79,36 @@ void LocalizationSummaryMap::serialize(
   common::eigen_proto::serialize(
       observation_to_landmark_index_,
       uncompressed_map->mutable_observation_to_landmark_index());
+
+  if (hasProductQuantizedDescriptors()) {
+    proto::ProductQuantizedDescriptors* product_quantized_descriptors =
+        uncompressed_map->mutable_product_quantized_descriptors();
+    proto::ProductQuantizationCodebook* codebook =
+        product_quantized_descriptors->mutable_codebook();
+    common::eigen_proto::serialize(
+        product_quantization_codebook_.words_1, codebook->mutable_words_1());
+    common::eigen_proto::serialize(
+        product_quantization_codebook_.words_2, codebook->mutable_words_2());
+    common::eigen_proto::serialize(
+        product_quantization_codebook_.quantizer_centers_1,
+        codebook->mutable_quantizer_centers_1());
+    common::eigen_proto::serialize(
+        product_quantization_codebook_.quantizer_centers_2,
+        codebook->mutable_quantizer_centers_2());
+    codebook->set_num_components(product_quantization_codebook_.num_components);
+    codebook->set_num_centers(product_quantization_codebook_.num_centers);
+    codebook->set_num_dimensions_per_component(
+        product_quantization_codebook_.num_dimensions_per_component);
+    codebook->set_vocabulary_fingerprint(
+        product_quantization_codebook_.vocabulary_fingerprint);
+
+    common::eigen_proto::serialize(
+        product_quantized_word_indices_,
+        product_quantized_descriptors->mutable_word_indices());
+    product_quantized_descriptors->set_quantized_residuals(
+        reinterpret_cast<const char*>(product_quantized_residuals_.data()),
+        product_quantized_residuals_.size());
+  }
 }
 void LocalizationSummaryMap::deserialize(
     const LocalizationSummaryMapId& localization_summary_map_id,
@@ -84,6 +144,48 @@ void LocalizationSummaryMap::deserialize(
     common::eigen_proto::deserialize(
         uncompressed_map.observation_to_landmark_index(),
         &observation_to_landmark_index_);
+
+    if (uncompressed_map.has_product_quantized_descriptors()) {
+      const proto::ProductQuantizedDescriptors& product_quantized_descriptors =
+          uncompressed_map.product_quantized_descriptors();
+      const proto::ProductQuantizationCodebook& codebook_proto =
+          product_quantized_descriptors.codebook();
+      loop_closure::ProductQuantizationCodebook codebook;
+      common::eigen_proto::deserialize(
+          codebook_proto.words_1(), &codebook.words_1);
+      common::eigen_proto::deserialize(
+          codebook_proto.words_2(), &codebook.words_2);
+      common::eigen_proto::deserialize(
+          codebook_proto.quantizer_centers_1(), &codebook.quantizer_centers_1);
+      common::eigen_proto::deserialize(
+          codebook_proto.quantizer_centers_2(), &codebook.quantizer_centers_2);
+      codebook.num_components = codebook_proto.num_components();
+      codebook.num_centers = codebook_proto.num_centers();
+      codebook.num_dimensions_per_component =
+          codebook_proto.num_dimensions_per_component();
+      codebook.vocabulary_fingerprint = codebook_proto.vocabulary_fingerprint();
+
+      Eigen::VectorXi word_indices;
+      common::eigen_proto::deserialize(
+          product_quantized_descriptors.word_indices(), &word_indices);
+      const std::string& quantized_residuals_data =
+          product_quantized_descriptors.quantized_residuals();
+      loop_closure::ProductQuantizedDescriptorMatrix quantized_residuals(
+          codebook.codeLength(), word_indices.rows());
+      CHECK_EQ(
+          quantized_residuals_data.size(),
+          static_cast<size_t>(quantized_residuals.size()));
+      std::copy(
+          quantized_residuals_data.begin(), quantized_residuals_data.end(),
+          quantized_residuals.data());
+      setProductQuantizedDescriptors(
+          codebook, word_indices, quantized_residuals);
+    } else {
+      product_quantization_codebook_ =
+          loop_closure::ProductQuantizationCodebook();
+      product_quantized_word_indices_.resize(0);
+      product_quantized_residuals_.resize(0, 0);
+    }
   } else {
     LOG(FATAL) << "Unsupported localization summary map format.";
   }
@@ -115,6 +217,12 @@ bool LocalizationSummaryMap::loadFromFolder(
   }
 
   deserialize(summary_map_id, proto);
+
+  if (!loadObservationWordIndicesFromFolder(folder_path)) {
+    LOG(WARNING) << "The precomputed visual words of the summary map under \""
+                 << folder_path << "\" couldn't be loaded. The localization "
+                 << "index will be built from scratch.";
+  }
   return true;
 }
 
@@ -134,8 +242,97 @@ bool LocalizationSummaryMap::saveToFolder(
 
   proto::LocalizationSummaryMap proto;
   serialize(&proto);
-  return common::proto_serialization_helper::serializeProtoToFile(
-      folder_path, kFileName, proto);
+  if (!common::proto_serialization_helper::serializeProtoToFile(
+          folder_path, kFileName, proto)) {
+    return false;
+  }
+  return saveObservationWordIndicesToFolder(folder_path);
+}
+
+bool LocalizationSummaryMap::saveObservationWordIndicesToFolder(
+    const std::string& folder_path) const {
+  const std::string file_path =
+      common::concatenateFolderAndFileName(folder_path, kWordIndicesFileName);
+  if (!hasObservationWordIndices()) {
+    // Make sure no stale word indices of a previous map are left behind.
+    if (common::fileExists(file_path) && !common::deleteFile(file_path)) {
+      LOG(ERROR) << "Failed to remove stale word indices \"" << file_path
+                 << "\".";
+      return false;
+    }
+    return true;
+  }
+
+  // The word indices are stored as one contiguous block after a fixed size
+  // header such that the file can also be mapped into memory directly.
+  std::ofstream out_stream(file_path, std::ios_base::binary);
+  if (!out_stream.is_open()) {
+    LOG(ERROR) << "Couldn't open \"" << file_path << "\" for writing.";
+    return false;
+  }
+  const int serialized_version = kWordIndicesSerializationVersion;
+  common::Serialize(serialized_version, &out_stream);
+  common::Serialize(vocabulary_fingerprint_, &out_stream);
+  common::Serialize(observation_word_indices_, &out_stream);
+  return out_stream.good();
+}
+
+bool LocalizationSummaryMap::loadObservationWordIndicesFromFolder(
+    const std::string& folder_path) {
+  observation_word_indices_.resize(0);
+  vocabulary_fingerprint_ = 0u;
+
+  const std::string file_path =
+      common::concatenateFolderAndFileName(folder_path, kWordIndicesFileName);
+  if (!common::fileExists(file_path)) {
+    // The word indices are optional.
+    return true;
+  }
+
+  std::ifstream in_stream(file_path, std::ios_base::binary);
+  if (!in_stream.is_open()) {
+    LOG(ERROR) << "Couldn't open \"" << file_path << "\" for reading.";
+    return false;
+  }
+  // The file is optional, so a damaged file must not take down the loading
+  // of the map. It is therefore read without common::Deserialize, which fails
+  // on truncated files.
+  int deserialized_version;
+  if (!readValue(&in_stream, &deserialized_version)) {
+    LOG(ERROR) << "Word indices in \"" << file_path << "\" are truncated.";
+    return false;
+  }
+  if (deserialized_version != kWordIndicesSerializationVersion) {
+    LOG(ERROR) << "Word indices in \"" << file_path << "\" were saved with "
+               << "version " << deserialized_version << ", expected "
+               << kWordIndicesSerializationVersion << ".";
+    return false;
+  }
+  uint64_t vocabulary_fingerprint;
+  int rows;
+  int cols;
+  if (!readValue(&in_stream, &vocabulary_fingerprint) ||
+      !readValue(&in_stream, &rows) || !readValue(&in_stream, &cols)) {
+    LOG(ERROR) << "Word indices in \"" << file_path << "\" are truncated.";
+    return false;
+  }
+  if (rows != projected_descriptors_.cols() || cols != 1) {
+    LOG(ERROR) << "The number of word indices (" << rows << "x" << cols
+               << ") doesn't match the number of observations ("
+               << projected_descriptors_.cols() << ").";
+    return false;
+  }
+  Eigen::VectorXi observation_word_indices(rows);
+  const std::streamsize num_bytes =
+      static_cast<std::streamsize>(sizeof(int)) * rows;
+  in_stream.read(
+      reinterpret_cast<char*>(observation_word_indices.data()), num_bytes);
+  if (in_stream.gcount() != num_bytes) {
+    LOG(ERROR) << "Word indices in \"" << file_path << "\" are truncated.";
+    return false;
+  }
+  setObservationWordIndices(observation_word_indices, vocabulary_fingerprint);
+  return true;
 }
 
 bool LocalizationSummaryMap::hasMapOnFileSystem(
@@ -165,6 +362,15 @@ Eigen::Vector3d LocalizationSummaryMap::getGLandmarkPosition(
   return G_landmark_position_.col(index).cast<double>();
 }
 
+const vi_map::LandmarkId& LocalizationSummaryMap::getLandmarkIdForIndex(
+    int landmark_index) const {
+  CHECK_GE(landmark_index, 0);
+  CHECK_LT(
+      landmark_index,
+      static_cast<int>(landmark_index_to_landmark_id_.size()));
+  return landmark_index_to_landmark_id_[landmark_index];
+}
+
 void LocalizationSummaryMap::getAllObserverIds(
     pose_graph::VertexIdList* observer_ids) const {
   CHECK_NOTNULL(observer_ids);
@@ -215,6 +421,7 @@ void LocalizationSummaryMap::setGLandmarkPosition(
 
 void LocalizationSummaryMap::initializeLandmarkIds(int num_landmarks) {
   landmark_id_to_landmark_index_.clear();
+  landmark_index_to_landmark_id_.resize(num_landmarks);
 
   // Create deterministic IDs based on the loc-summary-map-id.
   constexpr int kMarsennePrime = 524287;
@@ -228,6 +435,7 @@ void LocalizationSummaryMap::initializeLandmarkIds(int num_landmarks) {
         landmark_id_to_landmark_index_.insert(std::make_pair(landmark_id, i))
             .second)
         << "LandmarkID collision.";
+    landmark_index_to_landmark_id_[i] = landmark_id;
   }
 }
 
@@ -238,11 +446,118 @@ void LocalizationSummaryMap::setGObserverPosition(
 void LocalizationSummaryMap::setProjectedDescriptors(
     const Eigen::MatrixXf& descriptors) {
   projected_descriptors_ = descriptors;
+  // Any previously computed word assignment is no longer valid.
+  observation_word_indices_.resize(0);
+  vocabulary_fingerprint_ = 0u;
+  product_quantization_codebook_ = loop_closure::ProductQuantizationCodebook();
+  product_quantized_word_indices_.resize(0);
+  product_quantized_residuals_.resize(0, 0);
+}
+void LocalizationSummaryMap::setProductQuantizedDescriptors(
+    const loop_closure::ProductQuantizationCodebook& codebook,
+    const Eigen::VectorXi& word_indices,
+    const loop_closure::ProductQuantizedDescriptorMatrix& quantized_residuals) {
+  CHECK(!codebook.empty());
+  CHECK_EQ(word_indices.rows(), quantized_residuals.cols());
+  CHECK_EQ(quantized_residuals.rows(), codebook.codeLength());
+  CHECK_EQ(word_indices.rows(), observer_indices_.rows())
+      << "The observer indices need to be set first.";
+  product_quantization_codebook_ = codebook;
+  product_quantized_word_indices_ = word_indices;
+  product_quantized_residuals_ = quantized_residuals;
+
+  // The full descriptors and everything derived from them are dropped.
+  projected_descriptors_.resize(codebook.descriptorDimensionality(), 0);
+  observation_word_indices_.resize(0);
+  vocabulary_fingerprint_ = 0u;
+}
+bool LocalizationSummaryMap::hasProductQuantizedDescriptors() const {
+  return !product_quantization_codebook_.empty();
+}
+const loop_closure::ProductQuantizationCodebook&
+LocalizationSummaryMap::productQuantizationCodebook() const {
+  return product_quantization_codebook_;
+}
+const Eigen::VectorXi& LocalizationSummaryMap::productQuantizedWordIndices()
+    const {
+  return product_quantized_word_indices_;
+}
+const loop_closure::ProductQuantizedDescriptorMatrix&
+LocalizationSummaryMap::productQuantizedResiduals() const {
+  return product_quantized_residuals_;
+}
+void LocalizationSummaryMap::getProjectedDescriptors(
+    Eigen::MatrixXf* projected_descriptors) const {
+  CHECK_NOTNULL(projected_descriptors);
+  if (hasProductQuantizedDescriptors()) {
+    product_quantization_codebook_.reconstructDescriptors(
+        product_quantized_word_indices_, product_quantized_residuals_,
+        projected_descriptors);
+  } else {
+    *projected_descriptors = projected_descriptors_;
+  }
+}
+void LocalizationSummaryMap::getProjectedDescriptors(
+    const std::vector<int>& observation_indices,
+    Eigen::MatrixXf* projected_descriptors) const {
+  CHECK_NOTNULL(projected_descriptors);
+  const int num_observations = static_cast<int>(observation_indices.size());
+  if (hasProductQuantizedDescriptors()) {
+    Eigen::VectorXi word_indices(num_observations);
+    loop_closure::ProductQuantizedDescriptorMatrix quantized_residuals(
+        product_quantized_residuals_.rows(), num_observations);
+    for (int i = 0; i < num_observations; ++i) {
+      const int observation_index = observation_indices[i];
+      CHECK_LT(observation_index, product_quantized_residuals_.cols());
+      word_indices(i) = product_quantized_word_indices_(observation_index);
+      quantized_residuals.col(i) =
+          product_quantized_residuals_.col(observation_index);
+    }
+    product_quantization_codebook_.reconstructDescriptors(
+        word_indices, quantized_residuals, projected_descriptors);
+  } else {
+    projected_descriptors->resize(
+        projected_descriptors_.rows(), num_observations);
+    for (int i = 0; i < num_observations; ++i) {
+      const int observation_index = observation_indices[i];
+      CHECK_LT(observation_index, projected_descriptors_.cols());
+      projected_descriptors->col(i) =
+          projected_descriptors_.col(observation_index);
+    }
+  }
+}
+int LocalizationSummaryMap::numObservations() const {
+  return observer_indices_.rows();
+}
+size_t LocalizationSummaryMap::getDescriptorMemoryBytes() const {
+  size_t num_bytes = sizeof(float) * projected_descriptors_.size();
+  if (hasProductQuantizedDescriptors()) {
+    num_bytes += product_quantization_codebook_.getNumBytes() +
+                 sizeof(int) * product_quantized_word_indices_.size() +
+                 product_quantized_residuals_.size();
+  }
+  return num_bytes;
 }
 void LocalizationSummaryMap::setObserverIndices(
     const Eigen::Matrix<unsigned int, Eigen::Dynamic, 1>& observer_indices) {
   observer_indices_ = observer_indices;
 }
+void LocalizationSummaryMap::setObservationWordIndices(
+    const Eigen::VectorXi& observation_word_indices,
+    const uint64_t vocabulary_fingerprint) {
+  CHECK_EQ(observation_word_indices.rows(), projected_descriptors_.cols());
+  observation_word_indices_ = observation_word_indices;
+  vocabulary_fingerprint_ = vocabulary_fingerprint;
+}
+bool LocalizationSummaryMap::hasObservationWordIndices() const {
+  return observation_word_indices_.rows() > 0;
+}
+const Eigen::VectorXi& LocalizationSummaryMap::observationWordIndices() const {
+  return observation_word_indices_;
+}
+uint64_t LocalizationSummaryMap::vocabularyFingerprint() const {
+  return vocabulary_fingerprint_;
+}
 void LocalizationSummaryMap::setObservationToLandmarkIndex(
     const Eigen::Matrix<unsigned int, Eigen::Dynamic, 1>&
         observation_to_landmark_index) {
@@ -1,8 +1,12 @@
+#include <cstdint>
+#include <fstream>  // NOLINT
+#include <iterator>
 #include <memory>
 #include <string>
 
 #include <Eigen/Core>
 #include <aslam/common/hash-id.h>
+#include <maplab-common/file-system-tools.h>
 #include <maplab-common/pose_types.h>
 #include <maplab-common/test/testing-entrypoint.h>
 #include <maplab-common/test/testing-predicates.h>
@@ -123,6 +127,162 @@ TEST_F(
   EXPECT_NE(*initial_summary_map_, *summary_map_from_msg_);
 }
 
+TEST_F(LocalizationSummaryMapTest, LocalizationSummaryMapWordIndicesTest) {
+  constructLocalizationSummaryMap();
+  EXPECT_FALSE(initial_summary_map_->hasObservationWordIndices());
+
+  const int num_observations =
+      initial_summary_map_->projectedDescriptors().cols();
+  Eigen::VectorXi word_indices(num_observations);
+  for (int i = 0; i < num_observations; ++i) {
+    word_indices(i) = (7 * i) % 23;
+  }
+  constexpr uint64_t kVocabularyFingerprint = 0x0123456789abcdefu;
+  initial_summary_map_->setObservationWordIndices(
+      word_indices, kVocabularyFingerprint);
+  ASSERT_TRUE(initial_summary_map_->hasObservationWordIndices());
+
+  const std::string kFolderPath = "./summary_map_word_indices_test";
+  backend::SaveConfig save_config;
+  save_config.overwrite_existing_files = true;
+  ASSERT_TRUE(initial_summary_map_->saveToFolder(kFolderPath, save_config));
+
+  summary_map::LocalizationSummaryMap loaded_summary_map;
+  ASSERT_TRUE(loaded_summary_map.loadFromFolder(
+      initial_summary_map_->id(), kFolderPath));
+  EXPECT_EQ(*initial_summary_map_, loaded_summary_map);
+  ASSERT_TRUE(loaded_summary_map.hasObservationWordIndices());
+  EXPECT_EQ(kVocabularyFingerprint, loaded_summary_map.vocabularyFingerprint());
+  EXPECT_TRUE(loaded_summary_map.observationWordIndices() == word_indices);
+
+  // Changing the descriptors invalidates the word assignment.
+  loaded_summary_map.setProjectedDescriptors(
+      initial_summary_map_->projectedDescriptors());
+  EXPECT_FALSE(loaded_summary_map.hasObservationWordIndices());
+
+  // Saving a map without word indices must not leave stale ones behind.
+  ASSERT_TRUE(loaded_summary_map.saveToFolder(kFolderPath, save_config));
+  summary_map::LocalizationSummaryMap reloaded_summary_map;
+  ASSERT_TRUE(reloaded_summary_map.loadFromFolder(kFolderPath));
+  EXPECT_FALSE(reloaded_summary_map.hasObservationWordIndices());
+}
+
+TEST_F(LocalizationSummaryMapTest, TruncatedWordIndicesAreIgnored) {
+  constructLocalizationSummaryMap();
+  const int num_observations =
+      initial_summary_map_->projectedDescriptors().cols();
+  Eigen::VectorXi word_indices(num_observations);
+  for (int i = 0; i < num_observations; ++i) {
+    word_indices(i) = (7 * i) % 23;
+  }
+  initial_summary_map_->setObservationWordIndices(word_indices, 42u);
+
+  const std::string kFolderPath = "./summary_map_truncated_word_indices_test";
+  backend::SaveConfig save_config;
+  save_config.overwrite_existing_files = true;
+  ASSERT_TRUE(initial_summary_map_->saveToFolder(kFolderPath, save_config));
+  const std::string word_indices_file_path =
+      common::concatenateFolderAndFileName(
+          kFolderPath, "localization_summary_map_word_indices");
+  std::string file_content;
+  {
+    std::ifstream in_stream(word_indices_file_path, std::ios_base::binary);
+    ASSERT_TRUE(in_stream.is_open());
+    file_content.assign(
+        std::istreambuf_iterator<char>(in_stream),
+        std::istreambuf_iterator<char>());
+  }
+
+  // Cut within the header, within the size of the indices and within the
+  // indices themselves. The map is still loaded, without the word indices.
+  for (const size_t truncated_size :
+       {size_t(2u), size_t(14u), file_content.size() - 1u}) {
+    {
+      std::ofstream out_stream(
+          word_indices_file_path, std::ios_base::binary | std::ios_base::trunc);
+      out_stream.write(file_content.data(), truncated_size);
+    }
+    summary_map::LocalizationSummaryMap loaded_summary_map;
+    ASSERT_TRUE(loaded_summary_map.loadFromFolder(kFolderPath))
+        << "Truncated to " << truncated_size << " bytes.";
+    EXPECT_FALSE(loaded_summary_map.hasObservationWordIndices());
+    EXPECT_TRUE(
+        loaded_summary_map.projectedDescriptors() ==
+        initial_summary_map_->projectedDescriptors());
+  }
+}
+
+TEST_F(
+    LocalizationSummaryMapTest,
+    LocalizationSummaryMapProductQuantizedDescriptorsTest) {
+  constructLocalizationSummaryMap();
+  const int num_observations = initial_summary_map_->numObservations();
+  const size_t num_bytes_uncompressed =
+      initial_summary_map_->getDescriptorMemoryBytes();
+
+  // The descriptors have 10 dimensions, i.e. two halves with 5 components of
+  // one dimension each.
+  loop_closure::ProductQuantizationCodebook codebook;
+  codebook.num_components = 5;
+  codebook.num_centers = 4;
+  codebook.num_dimensions_per_component = 1;
+  codebook.words_1.setRandom(5, 3);
+  codebook.words_2.setRandom(5, 2);
+  codebook.quantizer_centers_1.setRandom(1, 5 * 4 * 3);
+  codebook.quantizer_centers_2.setRandom(1, 5 * 4 * 2);
+  codebook.vocabulary_fingerprint = 42u;
+
+  Eigen::VectorXi word_indices(num_observations);
+  loop_closure::ProductQuantizedDescriptorMatrix quantized_residuals(
+      codebook.codeLength(), num_observations);
+  for (int i = 0; i < num_observations; ++i) {
+    word_indices(i) = i % 6;
+    for (int j = 0; j < codebook.codeLength(); ++j) {
+      quantized_residuals(j, i) = (i + j) % codebook.num_centers;
+    }
+  }
+  initial_summary_map_->setProductQuantizedDescriptors(
+      codebook, word_indices, quantized_residuals);
+  ASSERT_TRUE(initial_summary_map_->hasProductQuantizedDescriptors());
+  EXPECT_EQ(0, initial_summary_map_->projectedDescriptors().cols());
+  EXPECT_LT(
+      initial_summary_map_->getDescriptorMemoryBytes(),
+      num_bytes_uncompressed);
+
+  // Checks the reconstruction of one descriptor: word 4 = (word_1 2, word_2 0).
+  Eigen::MatrixXf reconstructed_descriptors;
+  initial_summary_map_->getProjectedDescriptors(&reconstructed_descriptors);
+  ASSERT_EQ(10, reconstructed_descriptors.rows());
+  ASSERT_EQ(num_observations, reconstructed_descriptors.cols());
+  const int kObservationIndex = 4;
+  for (int component = 0; component < 5; ++component) {
+    const int center_1 = quantized_residuals(component, kObservationIndex);
+    const int center_2 = quantized_residuals(5 + component, kObservationIndex);
+    EXPECT_NEAR(
+        codebook.words_1(component, 2) +
+            codebook.quantizer_centers_1(0, 2 * 20 + component * 4 + center_1),
+        reconstructed_descriptors(component, kObservationIndex), 1e-6);
+    EXPECT_NEAR(
+        codebook.words_2(component, 0) +
+            codebook.quantizer_centers_2(0, component * 4 + center_2),
+        reconstructed_descriptors(5 + component, kObservationIndex), 1e-6);
+  }
+
+  serializeAndDeserialize();
+  EXPECT_EQ(*initial_summary_map_, *summary_map_from_msg_);
+  ASSERT_TRUE(summary_map_from_msg_->hasProductQuantizedDescriptors());
+  EXPECT_EQ(
+      codebook, summary_map_from_msg_->productQuantizationCodebook());
+  EXPECT_TRUE(
+      summary_map_from_msg_->productQuantizedWordIndices() == word_indices);
+  EXPECT_TRUE(
+      summary_map_from_msg_->productQuantizedResiduals() ==
+      quantized_residuals);
+
+  initial_summary_map_->setProjectedDescriptors(reconstructed_descriptors);
+  EXPECT_FALSE(initial_summary_map_->hasProductQuantizedDescriptors());
+}
+
 }  // namespace summary_map
 
 MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,225 @@
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+#include <maplab-common/file-system-tools.h>
+#include <maplab-common/map-manager-config.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <maplab-common/test/testing-predicates.h>
+#include <maplab-common/unique-id.h>
+
+#include "localization-summary-map/localization-summary-map-tiling.h"
+#include "localization-summary-map/localization-summary-map.h"
+
+namespace summary_map {
+
+namespace {
+constexpr double kTileSizeMeters = 10.0;
+constexpr int kNumLandmarks = 40;
+constexpr int kNumObserversPerLandmark = 3;
+constexpr int kNumDescriptorDimensions = 10;
+}  // namespace
+
+class LocalizationSummaryMapTilingTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    constructLocalizationSummaryMap();
+  }
+
+  // Creates landmarks along the x-axis, 1m apart, each observed from its own
+  // set of observers.
+  void constructLocalizationSummaryMap();
+
+  LocalizationSummaryMap summary_map_;
+};
+
+void LocalizationSummaryMapTilingTest::constructLocalizationSummaryMap() {
+  LocalizationSummaryMapId id;
+  common::generateId(&id);
+  summary_map_.setId(id);
+
+  Eigen::Matrix3Xd G_landmark_position(3, kNumLandmarks);
+  for (int i = 0; i < kNumLandmarks; ++i) {
+    G_landmark_position.col(i) << i + 0.5, 2.0, 1.0;
+  }
+  summary_map_.setGLandmarkPosition(G_landmark_position);
+
+  const int num_observations = kNumLandmarks * kNumObserversPerLandmark;
+  Eigen::Matrix3Xd G_observer_position(3, num_observations);
+  Eigen::Matrix<unsigned int, Eigen::Dynamic, 1> observer_indices(
+      num_observations);
+  Eigen::Matrix<unsigned int, Eigen::Dynamic, 1> observation_to_landmark_index(
+      num_observations);
+  for (int i = 0; i < num_observations; ++i) {
+    G_observer_position.col(i) = G_landmark_position.col(
+        i / kNumObserversPerLandmark) - Eigen::Vector3d(0.0, 2.0, 0.0);
+    observer_indices(i) = i;
+    observation_to_landmark_index(i) = i / kNumObserversPerLandmark;
+  }
+  summary_map_.setGObserverPosition(G_observer_position);
+
+  Eigen::MatrixXf descriptors(kNumDescriptorDimensions, num_observations);
+  descriptors.setRandom();
+  summary_map_.setProjectedDescriptors(descriptors);
+  summary_map_.setObserverIndices(observer_indices);
+  summary_map_.setObservationToLandmarkIndex(observation_to_landmark_index);
+}
+
+TEST_F(LocalizationSummaryMapTilingTest, TilesPartitionTheSummaryMap) {
+  TiledLocalizationSummaryMapIndex index;
+  std::vector<LocalizationSummaryMap::Ptr> tiles;
+  createTiledLocalizationSummaryMap(
+      summary_map_, kTileSizeMeters, &index, &tiles);
+
+  ASSERT_EQ(4u, tiles.size());
+  ASSERT_EQ(tiles.size(), index.tiles.size());
+  EXPECT_EQ(kTileSizeMeters, index.tile_size_meters);
+
+  int num_landmarks = 0;
+  int num_observations = 0;
+  for (size_t tile_idx = 0u; tile_idx < tiles.size(); ++tile_idx) {
+    const LocalizationSummaryMap& tile = *tiles[tile_idx];
+    const LocalizationSummaryMapTile& tile_info = index.tiles[tile_idx];
+    EXPECT_EQ(static_cast<int>(tile_idx), tile_info.x);
+    EXPECT_EQ(0, tile_info.y);
+    EXPECT_EQ(10u, tile_info.num_landmarks);
+    EXPECT_EQ(30u, tile_info.num_observations);
+    EXPECT_GT(tile_info.num_bytes, 0u);
+
+    ASSERT_EQ(10, tile.GLandmarkPosition().cols());
+    ASSERT_EQ(30, tile.numObservations());
+    EXPECT_EQ(30, tile.GObserverPosition().cols());
+    EXPECT_EQ(30, tile.projectedDescriptors().cols());
+
+    // Every observation needs to keep its landmark, observer and descriptor.
+    for (int i = 0; i < tile.numObservations(); ++i) {
+      const int map_observation_index = tile_idx * 30 + i;
+      const int landmark_index = tile.observationToLandmarkIndex()(i);
+      EXPECT_NEAR_EIGEN(
+          summary_map_.GLandmarkPosition().col(
+              summary_map_.observationToLandmarkIndex()(map_observation_index)),
+          tile.GLandmarkPosition().col(landmark_index), 1e-6);
+      EXPECT_NEAR_EIGEN(
+          summary_map_.GObserverPosition().col(map_observation_index),
+          tile.GObserverPosition().col(tile.observerIndices()(i)), 1e-6);
+      EXPECT_NEAR_EIGEN(
+          summary_map_.projectedDescriptors().col(map_observation_index),
+          tile.projectedDescriptors().col(i), 1e-6);
+    }
+    num_landmarks += tile.GLandmarkPosition().cols();
+    num_observations += tile.numObservations();
+  }
+  EXPECT_EQ(kNumLandmarks, num_landmarks);
+  EXPECT_EQ(summary_map_.numObservations(), num_observations);
+}
+
+TEST_F(LocalizationSummaryMapTilingTest, ProductQuantizedTiles) {
+  TiledLocalizationSummaryMapIndex uncompressed_index;
+  std::vector<LocalizationSummaryMap::Ptr> tiles;
+  createTiledLocalizationSummaryMap(
+      summary_map_, kTileSizeMeters, &uncompressed_index, &tiles);
+
+  // Two halves with 5 components of one dimension each.
+  loop_closure::ProductQuantizationCodebook codebook;
+  codebook.num_components = 5;
+  codebook.num_centers = 4;
+  codebook.num_dimensions_per_component = 1;
+  codebook.words_1.setRandom(5, 3);
+  codebook.words_2.setRandom(5, 2);
+  codebook.quantizer_centers_1.setRandom(1, 5 * 4 * 3);
+  codebook.quantizer_centers_2.setRandom(1, 5 * 4 * 2);
+  const int num_observations = summary_map_.numObservations();
+  Eigen::VectorXi word_indices(num_observations);
+  loop_closure::ProductQuantizedDescriptorMatrix quantized_residuals(
+      codebook.codeLength(), num_observations);
+  for (int i = 0; i < num_observations; ++i) {
+    word_indices(i) = i % 6;
+    for (int j = 0; j < codebook.codeLength(); ++j) {
+      quantized_residuals(j, i) = (i + j) % codebook.num_centers;
+    }
+  }
+  summary_map_.setProductQuantizedDescriptors(
+      codebook, word_indices, quantized_residuals);
+
+  TiledLocalizationSummaryMapIndex index;
+  createTiledLocalizationSummaryMap(
+      summary_map_, kTileSizeMeters, &index, &tiles);
+  ASSERT_EQ(uncompressed_index.tiles.size(), tiles.size());
+  for (size_t tile_idx = 0u; tile_idx < tiles.size(); ++tile_idx) {
+    const LocalizationSummaryMap& tile = *tiles[tile_idx];
+    ASSERT_TRUE(tile.hasProductQuantizedDescriptors());
+    EXPECT_EQ(codebook, tile.productQuantizationCodebook());
+    for (int i = 0; i < tile.numObservations(); ++i) {
+      const int map_observation_index = tile_idx * 30 + i;
+      EXPECT_EQ(
+          word_indices(map_observation_index),
+          tile.productQuantizedWordIndices()(i));
+      EXPECT_TRUE(
+          quantized_residuals.col(map_observation_index) ==
+          tile.productQuantizedResiduals().col(i));
+    }
+
+    // The tile and the database both keep a word or descriptor index and a
+    // code per observation instead of the float descriptors. The tile also
+    // keeps the codebook.
+    const size_t num_bytes_per_uncompressed_observation =
+        2u * sizeof(float) * kNumDescriptorDimensions + sizeof(int);
+    const size_t num_bytes_per_compressed_observation =
+        2u * (sizeof(int) + codebook.codeLength());
+    const size_t num_observations_in_tile = tile.numObservations();
+    EXPECT_EQ(
+        uncompressed_index.tiles[tile_idx].num_bytes -
+            num_bytes_per_uncompressed_observation * num_observations_in_tile,
+        index.tiles[tile_idx].num_bytes - codebook.getNumBytes() -
+            num_bytes_per_compressed_observation * num_observations_in_tile);
+  }
+}
+
+TEST_F(LocalizationSummaryMapTilingTest, DistanceToTile) {
+  LocalizationSummaryMapTile tile;
+  tile.x = 1;
+  tile.y = -1;
+  EXPECT_EQ(0.0, tile.getDistanceToTile(Eigen::Vector3d(15, -5, 3), 10.0));
+  EXPECT_NEAR(
+      5.0, tile.getDistanceToTile(Eigen::Vector3d(25, -5, 0), 10.0), 1e-9);
+  EXPECT_NEAR(
+      5.0, tile.getDistanceToTile(Eigen::Vector3d(6, 4, 0), 10.0), 1e-9);
+}
+
+TEST_F(LocalizationSummaryMapTilingTest, SaveAndLoadTiledSummaryMap) {
+  TiledLocalizationSummaryMapIndex index;
+  std::vector<LocalizationSummaryMap::Ptr> tiles;
+  createTiledLocalizationSummaryMap(
+      summary_map_, kTileSizeMeters, &index, &tiles);
+
+  const std::string kFolder = "./tiled_summary_map_test";
+  backend::SaveConfig save_config;
+  save_config.overwrite_existing_files = true;
+  ASSERT_TRUE(
+      saveTiledLocalizationSummaryMapToFolder(
+          kFolder, index, tiles, save_config));
+  ASSERT_TRUE(hasTiledLocalizationSummaryMapOnFileSystem(kFolder));
+
+  TiledLocalizationSummaryMapIndex loaded_index;
+  ASSERT_TRUE(
+      loadTiledLocalizationSummaryMapIndexFromFolder(kFolder, &loaded_index));
+  EXPECT_EQ(index.tile_size_meters, loaded_index.tile_size_meters);
+  ASSERT_EQ(index.tiles.size(), loaded_index.tiles.size());
+  EXPECT_EQ(index.getTotalNumBytes(), loaded_index.getTotalNumBytes());
+
+  for (size_t i = 0u; i < loaded_index.tiles.size(); ++i) {
+    EXPECT_EQ(index.tiles[i].folder_name, loaded_index.tiles[i].folder_name);
+    LocalizationSummaryMap tile;
+    ASSERT_TRUE(
+        loadLocalizationSummaryMapTileFromFolder(
+            kFolder, loaded_index.tiles[i], &tile));
+    EXPECT_TRUE(tiles[i]->GLandmarkPosition() == tile.GLandmarkPosition());
+    EXPECT_TRUE(
+        tiles[i]->projectedDescriptors() == tile.projectedDescriptors());
+    EXPECT_TRUE(tiles[i]->observerIndices() == tile.observerIndices());
+  }
+}
+
+}  // namespace summary_map
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -1,6 +1,8 @@
 #ifndef VI_MAP_CHECK_MAP_CONSISTENCY_H_
 #define VI_MAP_CHECK_MAP_CONSISTENCY_H_
 
+#include <cstddef>
+
 #include <posegraph/vertex.h>
 #include <vi-map/mission.h>
 
@@ -8,7 +10,11 @@ namespace vi_map {
 class VIMap;
 bool isGpsReferenceVertex(
     const vi_map::VIMap& vi_map, const pose_graph::VertexId& vertex_id);
+// Uses all hardware threads.
 bool checkMapConsistency(const vi_map::VIMap& vi_map);
+// The vertices, edges and landmarks are checked in parallel. The messages
+// are collected per thread and logged in vertex, edge and landmark order.
+bool checkMapConsistency(const vi_map::VIMap& vi_map, size_t num_threads);
 bool checkPosegraphConsistency(
     const vi_map::VIMap& vi_map, const vi_map::MissionId& mission_id);
 bool checkForOrphanedPosegraphItems(const vi_map::VIMap& vi_map);
@@ -0,0 +1,98 @@
+#ifndef VI_MAP_COVISIBILITY_GRAPH_H_
+#define VI_MAP_COVISIBILITY_GRAPH_H_
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include <maplab-common/macros.h>
+#include <posegraph/unique-id.h>
+
+namespace vi_map {
+class VIMap;
+
+// Weighted vertex-vertex covisibility of a map. The weight of two vertices is
+// the number of distinct landmarks that are observed by both of them; the
+// weight of a vertex with itself is the number of distinct landmarks it
+// observes.
+//
+// The adjacency is stored in compressed sparse row (CSR) form. Incremental
+// updates are collected in per-vertex delta rows which are folded into the
+// CSR arrays once they grow large compared to the graph.
+class CovisibilityGraph {
+ public:
+  MAPLAB_POINTER_TYPEDEFS(CovisibilityGraph);
+
+  CovisibilityGraph();
+
+  // Builds the graph from the landmark observations of the given vertices.
+  // Observations by vertices that are not in the list are ignored.
+  void build(
+      const VIMap& map, const pose_graph::VertexIdList& vertex_ids,
+      const size_t num_threads);
+
+  // Incremental updates for a single landmark, given by its distinct observer
+  // vertices.
+  void addLandmark(const pose_graph::VertexIdSet& observer_vertex_ids);
+  void removeLandmark(const pose_graph::VertexIdSet& observer_vertex_ids);
+  // The new observer must not be part of the existing observers.
+  void addLandmarkObserver(
+      const pose_graph::VertexId& new_observer_vertex_id,
+      const pose_graph::VertexIdSet& existing_observer_vertex_ids);
+
+  // Removes all edges of the vertex.
+  void removeVertex(const pose_graph::VertexId& vertex_id);
+
+  // Returns 0 if either vertex is not part of the graph.
+  size_t getWeight(
+      const pose_graph::VertexId& vertex_id_a,
+      const pose_graph::VertexId& vertex_id_b) const;
+
+  // Calls the action for every vertex with a non-zero weight to the given
+  // vertex, including the vertex itself.
+  void forEachNeighbor(
+      const pose_graph::VertexId& vertex_id,
+      const std::function<void(const pose_graph::VertexId&, size_t)>& action)
+      const;
+
+  bool hasVertex(const pose_graph::VertexId& vertex_id) const;
+  size_t numVertices() const;
+  // Number of stored non-zero entries, including the diagonal.
+  size_t numEntries() const;
+
+  // Estimated memory used by the graph in bytes.
+  size_t getMemoryUsageBytes() const;
+
+  // Folds the delta rows into the CSR arrays.
+  void compact();
+
+ private:
+  typedef uint32_t VertexIndex;
+
+  bool getVertexIndex(
+      const pose_graph::VertexId& vertex_id, VertexIndex* index) const;
+  VertexIndex getOrAddVertexIndex(const pose_graph::VertexId& vertex_id);
+  void addToWeight(VertexIndex row, VertexIndex column, int delta);
+  size_t getWeight(VertexIndex row, VertexIndex column) const;
+  // Returns the offset into the CSR arrays or -1 if the entry is not stored.
+  int64_t findCsrEntry(VertexIndex row, VertexIndex column) const;
+  size_t numCsrRows() const;
+  void compactIfNecessary();
+
+  std::unordered_map<pose_graph::VertexId, VertexIndex> vertex_id_to_index_;
+  pose_graph::VertexIdList vertex_ids_;
+
+  // The entries of row i are in [row_begin_[i], row_begin_[i + 1]), sorted by
+  // column.
+  std::vector<size_t> row_begin_;
+  std::vector<VertexIndex> column_index_;
+  std::vector<uint32_t> weight_;
+
+  std::vector<std::unordered_map<VertexIndex, int>> delta_rows_;
+  size_t num_delta_entries_;
+};
+
+}  // namespace vi_map
+
+#endif  // VI_MAP_COVISIBILITY_GRAPH_H_
@@ -0,0 +1,58 @@
+#ifndef VI_MAP_DIRTY_TRACKER_H_
+#define VI_MAP_DIRTY_TRACKER_H_
+
+#include <cstddef>
+
+#include <aslam/common/memory.h>
+#include <aslam/common/pose-types.h>
+#include <posegraph/unique-id.h>
+
+#include "vi-map/unique-id.h"
+
+namespace vi_map {
+class VIMap;
+
+// Tracks the vertices and landmarks that changed since the landmarks were
+// triangulated last, such that only those need to be retriangulated.
+//
+// The optimizers write the vertex poses through raw pointers, so pose changes
+// are detected by comparing the current global vertex poses with a snapshot
+// that is taken on reset(). Vertices without a snapshot, e.g. new or merged
+// ones, are dirty. Changes of the landmark observations are reported by the
+// VIMap operations that make them.
+class DirtyTracker {
+ public:
+  void markVertexDirty(const pose_graph::VertexId& vertex_id);
+  void markLandmarkDirty(const LandmarkId& landmark_id);
+  // Called if a landmark is removed from the map.
+  void removeLandmark(const LandmarkId& landmark_id);
+
+  // Returns the vertices that were marked dirty or whose global pose changed.
+  void getDirtyVertices(
+      const VIMap& map, const size_t num_threads,
+      pose_graph::VertexIdList* dirty_vertex_ids) const;
+  // Returns the landmarks that were marked dirty, are stored in a dirty vertex
+  // or are observed by a dirty vertex.
+  void getDirtyLandmarks(
+      const VIMap& map, const size_t num_threads,
+      LandmarkIdList* dirty_landmark_ids) const;
+
+  // Takes a new pose snapshot of all vertices and clears all marks.
+  void reset(const VIMap& map, const size_t num_threads);
+  // Drops the snapshot, all vertices and landmarks are dirty afterwards.
+  void clear();
+
+  void swap(DirtyTracker* other);
+
+ private:
+  typedef AlignedUnorderedMap<pose_graph::VertexId, pose::Transformation>
+      VertexPoseMap;
+
+  pose_graph::VertexIdSet dirty_vertex_ids_;
+  LandmarkIdSet dirty_landmark_ids_;
+  VertexPoseMap T_G_I_snapshot_;
+};
+
+}  // namespace vi_map
+
+#endif  // VI_MAP_DIRTY_TRACKER_H_
@@ -128,6 +128,11 @@ class Landmark {
     observations_.erase(observations_.begin() + index);
   }
 
+  // Changes the keypoint index of the observation with the given index, e.g.
+  // after keypoints have been discarded from the observing frame.
+  void setObservationKeypointIndex(
+      size_t observation_index, size_t keypoint_index);
+
   unsigned int numberOfObserverVertices() const;
 
   double* get_p_B_Mutable();
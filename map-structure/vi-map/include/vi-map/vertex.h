@@ -195,6 +195,13 @@ class Vertex : public pose_graph::Vertex {
   // landmark ids to invalid.
   void resetObservedLandmarkIdsToInvalid();
 
+  // Discards the keypoints with the given indices from the frame, including
+  // all their keypoint channels and observed landmark ids. The indices of the
+  // remaining keypoints shift accordingly, so the landmark observations that
+  // refer to them have to be updated by the caller.
+  void discardKeypoints(
+      unsigned int frame_idx, const std::vector<size_t>& keypoint_indices);
+
   inline void forEachUnassociatedKeypoint(
       const unsigned int frame_idx,
       const std::function<void(const int keypoint_index)>& action) const;
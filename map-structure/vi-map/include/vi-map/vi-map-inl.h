@@ -767,6 +767,13 @@ void VIMap::removeLandmark(const LandmarkId landmark_id) {
   // This is important for merged landmarks. We are just deleting one global
   // ID, we should remove all backlinks from the store landmark that point to
   // this specific one.
+  if (covisibility_graph_) {
+    pose_graph::VertexIdSet observer_vertex_ids;
+    getLandmarkObserverVertices(landmark_id, &observer_vertex_ids);
+    covisibility_graph_->removeLandmark(observer_vertex_ids);
+  }
+  dirty_tracker_.removeLandmark(landmark_id);
+
   KeypointIdentifierList observations = landmark.getObservations();
   for (const KeypointIdentifier& observation : observations) {
     vi_map::Vertex& observer_vertex = getVertex(observation.frame_id.vertex_id);
@@ -878,6 +885,9 @@ void VIMap::removeVertex(pose_graph::VertexId vertex_id) {
     }
   }
 
+  if (covisibility_graph_) {
+    covisibility_graph_->removeVertex(vertex_id);
+  }
   posegraph.removeVertex(vertex_id);
 }
 
@@ -1059,6 +1069,28 @@ void VIMap::clear() {
   mission_base_frames.clear();
   landmark_index.clear();
   selected_missions_.clear();
+  covisibility_graph_.reset();
+  dirty_tracker_.clear();
+}
+
+void VIMap::markVertexDirty(const pose_graph::VertexId& vertex_id) {
+  CHECK(hasVertex(vertex_id));
+  dirty_tracker_.markVertexDirty(vertex_id);
+}
+
+void VIMap::markLandmarkDirty(const LandmarkId& landmark_id) {
+  CHECK(hasLandmark(landmark_id));
+  dirty_tracker_.markLandmarkDirty(landmark_id);
+}
+
+void VIMap::getDirtyVertices(
+    const size_t num_threads, pose_graph::VertexIdList* vertex_ids) const {
+  dirty_tracker_.getDirtyVertices(*this, num_threads, vertex_ids);
+}
+
+void VIMap::getDirtyLandmarks(
+    const size_t num_threads, LandmarkIdList* landmark_ids) const {
+  dirty_tracker_.getDirtyLandmarks(*this, num_threads, landmark_ids);
 }
 
 template <typename DataType>
@@ -25,6 +25,8 @@
 #include <posegraph/unique-id.h>
 
 #include "vi-map/cklam-edge.h"
+#include "vi-map/covisibility-graph.h"
+#include "vi-map/dirty-tracker.h"
 #include "vi-map/landmark-index.h"
 #include "vi-map/landmark.h"
 #include "vi-map/laser-edge.h"
@@ -473,6 +475,34 @@ class VIMap : public backend::ResourceMap,
       const vi_map::LandmarkId landmark_id_to_merge,
       const vi_map::LandmarkId& landmark_id_into);
 
+  /// The covisibility graph is a materialized view of the landmark
+  /// observations of the selected missions. It is built on the first call of
+  /// getCovisibilityGraph() and then kept up to date by the landmark
+  /// operations of this class: associating keypoints, merging and removing
+  /// landmarks and merging and removing vertices. Operations that modify many
+  /// observations at once, as well as changes of the mission selection, drop
+  /// the graph such that the next query rebuilds it. Observations modified
+  /// directly on vertices or landmarks bypass it; call dropCovisibilityGraph()
+  /// in that case.
+  void buildCovisibilityGraph();
+  void dropCovisibilityGraph() const;
+  bool hasCovisibilityGraph() const;
+  /// Builds the graph if necessary, never returns nullptr.
+  const CovisibilityGraph* getCovisibilityGraph() const;
+
+  /// Tracks the vertices and landmarks that changed since the last call of
+  /// clearDirtyState(), see DirtyTracker. Vertices whose pose changed are
+  /// detected automatically, the landmark operations of this class mark the
+  /// landmarks whose observations they change. Code modifying observations
+  /// directly on vertices or landmarks should mark them itself.
+  inline void markVertexDirty(const pose_graph::VertexId& vertex_id);
+  inline void markLandmarkDirty(const LandmarkId& landmark_id);
+  inline void getDirtyVertices(
+      const size_t num_threads, pose_graph::VertexIdList* vertex_ids) const;
+  inline void getDirtyLandmarks(
+      const size_t num_threads, LandmarkIdList* landmark_ids) const;
+  void clearDirtyState(const size_t num_threads);
+
   /// Moves a given landmark to be stored in the "to" vertex
   /// and updating all the references to it.
   void moveLandmarkToOtherVertex(
@@ -809,6 +839,14 @@ class VIMap : public backend::ResourceMap,
   OptionalSensorDataMap optional_sensor_data_map_;
   // Adding new data? Don't forget to add it to deepCopy() and swap()!
 
+  // Derived from the landmark observations. Mutable such that the const
+  // mission selection methods can drop it and the const queries can build it.
+  mutable CovisibilityGraph::UniquePtr covisibility_graph_;
+  mutable std::mutex covisibility_graph_mutex_;
+
+  // Not copied, a copied map is entirely dirty.
+  DirtyTracker dirty_tracker_;
+
   // Used for mission-selective VIMap.
   mutable std::unordered_set<vi_map::MissionId> selected_missions_;
   mutable std::default_random_engine generator_;
@@ -1,10 +1,386 @@
 #include <vi-map/check-map-consistency.h>
 
+#include <deque>
+#include <map>
+#include <mutex>
+#include <sstream>  // NOLINT
+#include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include <maplab-common/parallel-process.h>
+#include <maplab-common/threading-helpers.h>
 #include <vi-map/vi-map.h>
 
 namespace vi_map {
+namespace {
+
+// Collects the messages of a parallel check such that they can be logged in
+// the same order as in a sequential check.
+class ConsistencyLog {
+ public:
+  std::ostream& error() {
+    return addEntry(true);
+  }
+  std::ostream& warning() {
+    return addEntry(false);
+  }
+
+  void flush() const {
+    for (const Entry& entry : entries_) {
+      if (entry.first) {
+        LOG(ERROR) << entry.second.str();
+      } else {
+        LOG(WARNING) << entry.second.str();
+      }
+    }
+  }
+
+ private:
+  // Is error and message.
+  typedef std::pair<bool, std::ostringstream> Entry;
+
+  std::ostream& addEntry(const bool is_error) {
+    entries_.emplace_back();
+    entries_.back().first = is_error;
+    return entries_.back().second;
+  }
+
+  std::deque<Entry> entries_;
+};
+
+// Calls check(item_idx, log) for all items using num_threads threads, where
+// check returns false if the item is inconsistent. The items are processed in
+// contiguous blocks and the messages are logged in item order once all blocks
+// are done.
+template <typename CheckFunction>
+bool checkItemsInParallel(
+    const size_t num_items, const size_t num_threads,
+    const CheckFunction& check) {
+  struct BlockResult {
+    ConsistencyLog log;
+    bool is_consistent = true;
+  };
+  std::mutex m_block_results;
+  std::map<size_t, BlockResult> block_results;
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      num_items,
+      [&](const std::vector<size_t>& range) {
+        BlockResult block_result;
+        for (const size_t item_idx : range) {
+          block_result.is_consistent &= check(item_idx, &block_result.log);
+        }
+        std::lock_guard<std::mutex> lock(m_block_results);
+        block_results.emplace(range.front(), std::move(block_result));
+      },
+      kAlwaysParallelize, num_threads);
+
+  bool is_consistent = true;
+  for (const std::pair<const size_t, BlockResult>& block_result :
+       block_results) {
+    block_result.second.log.flush();
+    is_consistent &= block_result.second.is_consistent;
+  }
+  return is_consistent;
+}
+
+// Number of references from the vertices to every landmark, as found in the
+// observed landmark id lists of the vertices. The index is split into shards
+// by landmark id such that every shard can be built by its own thread.
+class LandmarkObserverIndex {
+ public:
+  typedef std::unordered_map<pose_graph::VertexId, int> ObserverCounts;
+
+  LandmarkObserverIndex(
+      const pose_graph::VertexIdList& vertex_ids,
+      const std::vector<LandmarkIdList>& vertex_observed_landmark_ids,
+      const size_t num_threads)
+      : shards_(num_threads) {
+    CHECK_EQ(vertex_ids.size(), vertex_observed_landmark_ids.size());
+    constexpr bool kAlwaysParallelize = true;
+    common::ParallelProcess(
+        shards_.size(),
+        [&](const std::vector<size_t>& range) {
+          for (const size_t shard_idx : range) {
+            Shard& shard = shards_[shard_idx];
+            for (size_t vertex_idx = 0u; vertex_idx < vertex_ids.size();
+                 ++vertex_idx) {
+              for (const LandmarkId& landmark_id :
+                   vertex_observed_landmark_ids[vertex_idx]) {
+                if (getShardIndex(landmark_id) == shard_idx) {
+                  ++shard[landmark_id][vertex_ids[vertex_idx]];
+                }
+              }
+            }
+          }
+        },
+        kAlwaysParallelize, num_threads);
+  }
+
+  const ObserverCounts& getObserverCounts(
+      const LandmarkId& landmark_id) const {
+    const Shard& shard = shards_[getShardIndex(landmark_id)];
+    const Shard::const_iterator it = shard.find(landmark_id);
+    return it == shard.end() ? kNoObservers : it->second;
+  }
+
+ private:
+  typedef std::unordered_map<LandmarkId, ObserverCounts> Shard;
+
+  size_t getShardIndex(const LandmarkId& landmark_id) const {
+    return std::hash<LandmarkId>()(landmark_id) % shards_.size();
+  }
+
+  const ObserverCounts kNoObservers;
+  std::vector<Shard> shards_;
+};
+
+// Checks the landmark ids observed by the frames of the vertex. If the same
+// landmark is observed several times from the same frame, the observations
+// should be close to each other in image space.
+bool checkObservedLandmarkIds(
+    const Vertex& vertex, const pose_graph::VertexId& vertex_id,
+    ConsistencyLog* log) {
+  CHECK_NOTNULL(log);
+  bool is_consistent = true;
+
+  // Verify that the Landmark IDs in the visual frame are sane:
+  // These tests look for errors that have a soft bound, the thresholds
+  // here are rather arbitrary.
+  // If we find two times the same landmark ID, how far are they allowed to
+  // be apart in image space before we warn or fail.
+  static constexpr double kImageDisparitySameLandmarkWarn = 10.;
+  static constexpr double kImageDisparitySameLandmarkError = 75;
+  // How often can the same landmark ID occur before we declare a map
+  // inconsistent.
+  static constexpr int kMaxNumSameLandmarkId = 5;
+  std::unordered_map<LandmarkId, int> appearance_count;
+  const int num_frames = vertex.numFrames();
+  for (int i = 0; i < num_frames; ++i) {
+    if (!vertex.isVisualFrameSet(i)) {
+      continue;
+    }
+    const aslam::VisualFrame& frame = vertex.getVisualFrame(i);
+    if (!frame.getId().isValid()) {
+      log->error() << "Visual frame id for frame " << i << " in vertex "
+                   << vertex_id << " is invalid.";
+      is_consistent = false;
+      continue;
+    }
+
+    // Group the keypoints by landmark in a single pass instead of comparing
+    // all pairs of keypoints.
+    const LandmarkIdList& observed_landmark_ids =
+        vertex.getFrameObservedLandmarkIds(i);
+    const int num_observed_landmarks = observed_landmark_ids.size();
+    std::unordered_map<LandmarkId, std::vector<int>> landmark_keypoints;
+    for (int j = 0; j < num_observed_landmarks; ++j) {
+      const LandmarkId& observed_landmark_j = observed_landmark_ids[j];
+      if (!observed_landmark_j.isValid()) {
+        continue;
+      }
+      landmark_keypoints[observed_landmark_j].emplace_back(j);
+      int& count = appearance_count[observed_landmark_j];
+      ++count;
+      if (count > kMaxNumSameLandmarkId) {
+        log->error() << "Landmark " << observed_landmark_j << " is observed "
+                     << count << "times in the same frame (" << vertex_id
+                     << ") which is considered an "
+                     << "error (threshold evaluates to "
+                     << kMaxNumSameLandmarkId << ").";
+      }
+    }
+    if (landmark_keypoints.size() ==
+            static_cast<size_t>(num_observed_landmarks) ||
+        !frame.hasKeypointMeasurements()) {
+      continue;
+    }
+
+    // Visit the pairs of keypoints observing the same landmark in the order
+    // of the first keypoint.
+    std::unordered_map<LandmarkId, size_t> num_visited_keypoints;
+    for (int j = 0; j < num_observed_landmarks; ++j) {
+      const LandmarkId& observed_landmark_j = observed_landmark_ids[j];
+      if (!observed_landmark_j.isValid()) {
+        continue;
+      }
+      const std::vector<int>& keypoints =
+          landmark_keypoints[observed_landmark_j];
+      if (keypoints.size() == 1u) {
+        continue;
+      }
+      const size_t position_j = num_visited_keypoints[observed_landmark_j]++;
+      for (size_t position_k = position_j + 1u; position_k < keypoints.size();
+           ++position_k) {
+        const int k = keypoints[position_k];
+        // Same landmark id, check the distance in image space.
+        Eigen::Matrix<double, 2, 1> measurement_i =
+            frame.getKeypointMeasurement(j);
+        Eigen::Matrix<double, 2, 1> measurement_j =
+            frame.getKeypointMeasurement(k);
+        double distance = (measurement_i - measurement_j).norm();
+        if (distance > kImageDisparitySameLandmarkError) {
+          log->error() << "Landmark " << observed_landmark_j
+                       << " is observed "
+                       << " twice from the same frame (" << vertex_id
+                       << "), but the "
+                       << "observations evaluate to ["
+                       << measurement_i.transpose() << "] and ["
+                       << measurement_j.transpose() << "] (distance of "
+                       << distance << ") and threshold evaluates to "
+                       << kImageDisparitySameLandmarkError;
+          is_consistent = false;
+        } else if (distance > kImageDisparitySameLandmarkWarn) {
+          log->warning()
+              << "Landmark " << observed_landmark_j << " is observed "
+              << " twice from the same frame (" << vertex_id << "), but the "
+              << "observations evaluate to [" << measurement_i.transpose()
+              << "] and [" << measurement_j.transpose() << "] (distance of "
+              << distance << ") and threshold evaluates to "
+              << kImageDisparitySameLandmarkWarn;
+        }
+      }
+    }
+  }
+  return is_consistent;
+}
+
+// Checks that the landmarks stored in the vertex are in the global map and
+// that their observations match the back-references of the observer vertices.
+bool checkStoredLandmarks(
+    const vi_map::VIMap& vi_map, const Vertex& vertex,
+    const pose_graph::VertexId& vertex_id,
+    const LandmarkObserverIndex& landmark_observer_index, ConsistencyLog* log) {
+  CHECK_NOTNULL(log);
+  bool is_consistent = true;
+  const vi_map::LandmarkStore& landmark_store = vertex.getLandmarks();
+
+  for (const vi_map::Landmark& landmark : landmark_store) {
+    const vi_map::LandmarkId& landmark_id = landmark.id();
+
+    // If this landmark id is non valid, it should not be in the global map.
+    if (!landmark_id.isValid()) {
+      log->error() << "Landmark " << landmark_id.hexString()
+                   << " stored in vertex " << vertex_id.hexString()
+                   << " is invalid. Only valid landmarks should be in the "
+                      "store.";
+      is_consistent = false;
+    }
+    // Every landmark in the store should be in the global map.
+    if (!vi_map.hasLandmark(landmark_id)) {
+      log->error() << "Landmark " << landmark_id.hexString()
+                   << " stored in vertex " << vertex_id.hexString()
+                   << " is not found in the global map.";
+      is_consistent = false;
+    }
+
+    const KeypointIdentifierList& vertex_id_frame_idx_kp_idx =
+        landmark.getObservations();
+
+    // Count how often we expect to find every vertex in the backwards
+    // reference list of the current landmark.
+    LandmarkObserverIndex::ObserverCounts refound_map =
+        landmark_observer_index.getObserverCounts(landmark_id);
+
+    VLOG(5) << "refound map:";
+    for (const std::pair<const pose_graph::VertexId, int>& observation_counts :
+         refound_map) {
+      VLOG(5) << "Back-references to vertex "
+              << observation_counts.first.hexString() << " from landmark "
+              << landmark_id.hexString() << "  " << observation_counts.second;
+    }
+
+    // Check that all other observing vertices of this landmark have
+    // set the ID to the same state.
+    for (unsigned int j = 0; j < vertex_id_frame_idx_kp_idx.size(); ++j) {
+      const pose_graph::VertexId& observer_vertex_id =
+          vertex_id_frame_idx_kp_idx[j].frame_id.vertex_id;
+      if (!vi_map.hasVertex(observer_vertex_id)) {
+        log->error() << "Landmark " << landmark_id.hexString()
+                     << " stored in vertex " << vertex_id
+                     << " lists the vertex " << observer_vertex_id
+                     << " as observer, but that vertex does not exist.";
+        is_consistent = false;
+      }
+
+      const Vertex& observer_vertex = vi_map.getVertex(observer_vertex_id);
+
+      // Check that we have seen this vertex before.
+      if (refound_map.count(observer_vertex_id) == 0u) {
+        log->error() << "Landmark " << landmark_id.hexString()
+                     << " has an unknown vertex listed as observer: "
+                     << observer_vertex_id.hexString();
+        is_consistent = false;
+      }
+      // Check that there is still an unmatched observation for this vertex.
+      if (refound_map[observer_vertex_id] <= 0) {
+        log->error()
+            << "The landmark " << landmark_id.hexString() << " has the vertex "
+            << observer_vertex_id.hexString()
+            << " in the list of back-references, but all back-references to"
+            << " this vertex have already been matched.";
+        is_consistent = false;
+      }
+      // Mark as found.
+      --refound_map[observer_vertex_id];
+
+      if (vertex_id_frame_idx_kp_idx[j].keypoint_index >=
+          observer_vertex.observedLandmarkIdsSize(
+              vertex_id_frame_idx_kp_idx[j].frame_id.frame_index)) {
+        log->error() << "Keypoint index "
+                     << vertex_id_frame_idx_kp_idx[j].keypoint_index
+                     << " to retrieve landmark ID "
+                     << vertex_id_frame_idx_kp_idx[j].frame_id.vertex_id
+                     << " is out of bounds.";
+        is_consistent = false;
+        continue;
+      }
+
+      const vi_map::LandmarkId& observer_landmark_id =
+          observer_vertex.getObservedLandmarkId(
+              vertex_id_frame_idx_kp_idx[j].frame_id.frame_index,
+              vertex_id_frame_idx_kp_idx[j].keypoint_index);
+      if (!observer_landmark_id.isValid()) {
+        log->error() << "The store landmark id " << landmark_id.hexString()
+                     << " has a backlink to an observer that has an invalid"
+                     << " landmark ID.";
+        is_consistent = false;
+      } else if (observer_landmark_id != landmark_id) {
+        log->error() << "The store vertex of landmark id "
+                     << landmark_id.hexString()
+                     << " and landmark id in the observer table "
+                     << observer_landmark_id.hexString()
+                     << " are inconsistent";
+        is_consistent = false;
+      }
+
+      if (landmark_id.isValid() != observer_landmark_id.isValid()) {
+        log->error()
+            << "The valid state of corresponding landmarks stored in vertex "
+            << vertex_id.hexString() << " and "
+            << vertex_id_frame_idx_kp_idx[j].frame_id.vertex_id.hexString()
+            << " are inconsistent";
+        is_consistent = false;
+      }
+    }
+
+    for (const std::pair<const pose_graph::VertexId, int>& observation_counts :
+         refound_map) {
+      if (observation_counts.second != 0) {
+        log->error() << "Back-references to vertex "
+                     << observation_counts.first.hexString()
+                     << " missing in the list of back-references of landmark "
+                     << landmark_id.hexString();
+        is_consistent = false;
+      }
+    }
+  }
+  return is_consistent;
+}
+
+}  // namespace
 
 /// Checks whether a given vertex is a GPS reference vertex.
 /// GPS reference vertices have no incoming edges and only GPS outgoing edges,
@@ -29,6 +405,12 @@ bool isGpsReferenceVertex(
 }
 
 bool checkMapConsistency(const vi_map::VIMap& vi_map) {
+  return checkMapConsistency(vi_map, common::getNumHardwareThreads());
+}
+
+bool checkMapConsistency(
+    const vi_map::VIMap& vi_map, const size_t num_threads) {
+  CHECK_GT(num_threads, 0u);
   bool is_consistent = true;
   // Verify that every mission has a valid base-frame.
   LOG(INFO) << "Verifying mission base-frames...";
@@ -87,24 +469,30 @@ bool checkMapConsistency(const vi_map::VIMap& vi_map) {
   LOG(INFO) << "Verifying  map vertices and edges...";
   pose_graph::VertexIdList all_vertices;
   vi_map.getAllVertexIds(&all_vertices);
-  for (const pose_graph::VertexId& vertex_id : all_vertices) {
-    if (!vi_map.hasVertex(vertex_id)) {
-      LOG(ERROR) << "VI map claims to have vertex " << vertex_id
-                 << " but then returns false when retrieving it.";
-      is_consistent = false;
-      continue;
-    }
-  }
+  is_consistent &= checkItemsInParallel(
+      all_vertices.size(), num_threads,
+      [&](const size_t vertex_idx, ConsistencyLog* log) -> bool {
+        const pose_graph::VertexId& vertex_id = all_vertices[vertex_idx];
+        if (!vi_map.hasVertex(vertex_id)) {
+          log->error() << "VI map claims to have vertex " << vertex_id
+                       << " but then returns false when retrieving it.";
+          return false;
+        }
+        return true;
+      });
   pose_graph::EdgeIdList all_edges;
   vi_map.getAllEdgeIds(&all_edges);
-  for (const pose_graph::EdgeId& edge_id : all_edges) {
-    if (!vi_map.hasEdge(edge_id)) {
-      LOG(ERROR) << "VI map claims to have edge " << edge_id
-                 << " but then returns false when retrieving it.";
-      is_consistent = false;
-      continue;
-    }
-  }
+  is_consistent &= checkItemsInParallel(
+      all_edges.size(), num_threads,
+      [&](const size_t edge_idx, ConsistencyLog* log) -> bool {
+        const pose_graph::EdgeId& edge_id = all_edges[edge_idx];
+        if (!vi_map.hasEdge(edge_id)) {
+          log->error() << "VI map claims to have edge " << edge_id
+                       << " but then returns false when retrieving it.";
+          return false;
+        }
+        return true;
+      });
   LOG_IF(INFO, is_consistent) << "OK.";
 
   // Verify that all landmark IDs in the map are valid.
@@ -112,6 +500,35 @@ bool checkMapConsistency(const vi_map::VIMap& vi_map) {
   vi_map::LandmarkIdList all_landmark_ids;
   vi_map.getAllLandmarkIds(&all_landmark_ids);
 
+  // Look up the storing vertex of every landmark in parallel. Invalid if the
+  // landmark or its storing vertex is missing.
+  pose_graph::VertexIdList landmark_storing_vertex_ids(all_landmark_ids.size());
+  is_consistent &= checkItemsInParallel(
+      all_landmark_ids.size(), num_threads,
+      [&](const size_t landmark_idx, ConsistencyLog* log) -> bool {
+        const vi_map::LandmarkId& landmark_id = all_landmark_ids[landmark_idx];
+        pose_graph::VertexId& storing_vertex_id =
+            landmark_storing_vertex_ids[landmark_idx];
+        storing_vertex_id.setInvalid();
+        if (!vi_map.hasLandmark(landmark_id)) {
+          log->error() << "Vi map claims to have global landmark "
+                       << landmark_id
+                       << " but then returns false when retrieving it.";
+          return false;
+        }
+
+        const pose_graph::VertexId& landmark_vertex_id =
+            vi_map.getLandmarkStoreVertexId(landmark_id);
+        if (!vi_map.hasVertex(landmark_vertex_id)) {
+          log->error() << "Landmark: " << landmark_id << " points to vertex "
+                       << landmark_vertex_id
+                       << " but this vertex is not in the map.";
+          return false;
+        }
+        storing_vertex_id = landmark_vertex_id;
+        return true;
+      });
+
   // Build a list of landmarks that we expect to find in every vertex, so
   // we can then check every vertex in batch for its landmarks which is more
   // cache efficient.
@@ -119,327 +536,105 @@ bool checkMapConsistency(const vi_map::VIMap& vi_map) {
                              std::vector<vi_map::LandmarkId> >
       ExpectedVertexLandmarks;
   ExpectedVertexLandmarks vertex_expected_landmarks;
-
-  for (const vi_map::LandmarkId& landmark_id : all_landmark_ids) {
-    if (!vi_map.hasLandmark(landmark_id)) {
-      LOG(ERROR) << "Vi map claims to have global landmark " << landmark_id
-                 << " but then returns false when retrieving it.";
-      is_consistent = false;
-      continue;
-    }
-
-    const pose_graph::VertexId& storing_vertex_id =
-        vi_map.getLandmarkStoreVertexId(landmark_id);
-
-    if (!vi_map.hasVertex(storing_vertex_id)) {
-      LOG(ERROR) << "Landmark: " << landmark_id
-                 << " points to vertex " << storing_vertex_id
-                 << " but this vertex is not in the map.";
-      is_consistent = false;
-      continue;
+  for (size_t landmark_idx = 0u; landmark_idx < all_landmark_ids.size();
+       ++landmark_idx) {
+    if (landmark_storing_vertex_ids[landmark_idx].isValid()) {
+      vertex_expected_landmarks[landmark_storing_vertex_ids[landmark_idx]]
+          .push_back(all_landmark_ids[landmark_idx]);
     }
-
-    vertex_expected_landmarks[storing_vertex_id].push_back(landmark_id);
   }
 
   // Now check all landmarks for every vertex in batch. Iterate through vertices
   // in cache friendly order too.
-  for (const pose_graph::VertexId& vertex_id : all_vertices) {
-    ExpectedVertexLandmarks::const_iterator it =
-        vertex_expected_landmarks.find(vertex_id);
-    if (it == vertex_expected_landmarks.end()) {
-      LOG(WARNING) << "Skip vertex " << vertex_id << " since no landmarks.";
-      continue;
-    }
-    CHECK(vi_map.hasVertex(vertex_id)) << "No vertex with id "
-                                       << vertex_id.hexString();
-    const vi_map::Vertex& vertex = vi_map.getVertex(vertex_id);
-    const vi_map::LandmarkStore& landmark_store = vertex.getLandmarks();
-    for (const vi_map::LandmarkId& landmark_id : it->second) {
-      if (!landmark_store.hasLandmark(landmark_id)) {
-        LOG(ERROR) << "Landmark to vertex table claims that landmark: "
-                   << landmark_id.hexString() << " resides in vertex "
-                   << vertex_id.hexString() << " which is not the case.";
-        is_consistent = false;
-      }
-    }
-
-    for (const vi_map::Landmark& landmark : landmark_store) {
-      if (!landmark.id().isValid()) {
-        LOG(ERROR) << "Landmark stored in vertex " << vertex_id.hexString()
-                   << " has an invalid ID.";
-        is_consistent = false;
-      } else if (!vi_map.hasLandmark(landmark.id())) {
-        LOG(ERROR) << "Landmark " << landmark.id().hexString() << " stored in "
-                   << "vertex " << vertex_id.hexString() << " has no entry in "
-                   << "landmark index.";
-        is_consistent = false;
-      }
-    }
-  }
-
-  LOG_IF(INFO, is_consistent) << "OK.";
-
-  // Create a map of all vertices that have a reference to a given landmark
-  // in order to check the back-reference from landmark to vertices.
-  typedef std::unordered_multimap<vi_map::LandmarkId, pose_graph::VertexId>
-      LandmarkToVertexMap;
-  LandmarkToVertexMap landmark_observing_vertices;
-  LOG(INFO) << "Building landmark observers list...";
-  for (const pose_graph::VertexId& vertex_id : all_vertices) {
-    if (!vi_map.hasVertex(vertex_id)) {
-      LOG(ERROR) << "Vi map claims to have vertex " << vertex_id
-                 << " but then returns false when retrieving it.";
-      is_consistent = false;
-      continue;
-    }
-
-    const vi_map::Vertex& vertex = vi_map.getVertex(vertex_id);
+  is_consistent &= checkItemsInParallel(
+      all_vertices.size(), num_threads,
+      [&](const size_t vertex_idx, ConsistencyLog* log) -> bool {
+        const pose_graph::VertexId& vertex_id = all_vertices[vertex_idx];
+        ExpectedVertexLandmarks::const_iterator it =
+            vertex_expected_landmarks.find(vertex_id);
+        if (it == vertex_expected_landmarks.end()) {
+          log->warning() << "Skip vertex " << vertex_id
+                         << " since no landmarks.";
+          return true;
+        }
+        CHECK(vi_map.hasVertex(vertex_id)) << "No vertex with id "
+                                           << vertex_id.hexString();
+        bool is_vertex_consistent = true;
+        const vi_map::Vertex& vertex = vi_map.getVertex(vertex_id);
+        const vi_map::LandmarkStore& landmark_store = vertex.getLandmarks();
+        for (const vi_map::LandmarkId& landmark_id : it->second) {
+          if (!landmark_store.hasLandmark(landmark_id)) {
+            log->error() << "Landmark to vertex table claims that landmark: "
+                         << landmark_id.hexString() << " resides in vertex "
+                         << vertex_id.hexString() << " which is not the case.";
+            is_vertex_consistent = false;
+          }
+        }
 
-    for (unsigned int i = 0; i < vertex.numFrames(); ++i) {
-      if (vertex.isVisualFrameSet(i)) {
-        for (size_t j = 0; j < vertex.observedLandmarkIdsSize(i); ++j) {
-          vi_map::LandmarkId landmark_id =
-              vertex.getObservedLandmarkId(i, j);
-          if (landmark_id.isValid()) {
-            landmark_observing_vertices.emplace(landmark_id, vertex_id);
+        for (const vi_map::Landmark& landmark : landmark_store) {
+          if (!landmark.id().isValid()) {
+            log->error() << "Landmark stored in vertex "
+                         << vertex_id.hexString() << " has an invalid ID.";
+            is_vertex_consistent = false;
+          } else if (!vi_map.hasLandmark(landmark.id())) {
+            log->error() << "Landmark " << landmark.id().hexString()
+                         << " stored in vertex " << vertex_id.hexString()
+                         << " has no entry in landmark index.";
+            is_vertex_consistent = false;
           }
         }
-      }
-    }
-  }
+        return is_vertex_consistent;
+      });
+
   LOG_IF(INFO, is_consistent) << "OK.";
 
-  LOG(INFO) << "Verifying landmark references...";
-  int num_checked = 0;
-  for (const pose_graph::VertexId& vertex_id : all_vertices) {
-    // Existence in map verified above.
-    const Vertex& vertex = vi_map.getVertex(vertex_id);
-
-    LOG_EVERY_N(INFO, static_cast<int>(all_vertices.size()) / 10)
-        << "Verifying vertices... "
-        << std::round(
-               static_cast<double>(num_checked + 1) / all_vertices.size() *
-               100.)
-        << "%";
-
-    // Verify that the Landmark IDs in the visual frame are sane:
-    // These tests look for errors that have a soft bound, the thresholds
-    // here are rather arbitrary.
-    // If we find two times the same landmark ID, how far are they allowed to
-    // be apart in image space before we warn or fail.
-    static constexpr double kImageDisparitySameLandmarkWarn = 10.;
-    static constexpr double kImageDisparitySameLandmarkError = 75;
-    // How often can the same landmark ID occur before we declare a map
-    // inconsistent.
-    static constexpr int kMaxNumSameLandmarkId = 5;
-    std::unordered_map<LandmarkId, int> appearance_count;
-    const int num_frames = vertex.numFrames();
-    for (int i = 0; i < num_frames; ++i) {
-      if (vertex.isVisualFrameSet(i)) {
-        if (!vertex.getVisualFrame(i).getId().isValid()) {
-          LOG(ERROR) << "Visual frame id for frame " << i << " in vertex "
-                     << vertex_id << " is invalid.";
-          is_consistent = false;
-          continue;
+  // Collect all vertices that have a reference to a given landmark in order to
+  // check the back-reference from landmark to vertices.
+  LOG(INFO) << "Building landmark observers list...";
+  std::vector<LandmarkIdList> vertex_observed_landmark_ids(all_vertices.size());
+  is_consistent &= checkItemsInParallel(
+      all_vertices.size(), num_threads,
+      [&](const size_t vertex_idx, ConsistencyLog* log) -> bool {
+        const pose_graph::VertexId& vertex_id = all_vertices[vertex_idx];
+        if (!vi_map.hasVertex(vertex_id)) {
+          log->error() << "Vi map claims to have vertex " << vertex_id
+                       << " but then returns false when retrieving it.";
+          return false;
         }
-        const int num_observed_landmarks = vertex.observedLandmarkIdsSize(i);
-        for (int j = 0; j < num_observed_landmarks; ++j) {
-          LandmarkId observed_landmark_j = vertex.getObservedLandmarkId(i, j);
-          if (!observed_landmark_j.isValid()) {
-            continue;
-          }
-          ++appearance_count[observed_landmark_j];
-          if (appearance_count[observed_landmark_j] > kMaxNumSameLandmarkId) {
-            LOG(ERROR) << "Landmark " << observed_landmark_j << " is observed "
-                       << appearance_count[observed_landmark_j]
-                       << "times in the same frame (" << vertex_id
-                       << ") which is considered an "
-                       << "error (threshold evaluates to "
-                       << kMaxNumSameLandmarkId << ").";
-          }
 
-          for (int k = j + 1; k < num_observed_landmarks; ++k) {
-            LandmarkId observed_landmark_k =
-                vertex.getObservedLandmarkId(i, k);
-            if (!observed_landmark_k.isValid()) {
-              continue;
-            }
-            if (observed_landmark_j != observed_landmark_k) {
-              continue;
-            }
-            // Same landmark id, check the distance in image space.
-            if (vertex.getVisualFrame(i).hasKeypointMeasurements()) {
-              Eigen::Matrix<double, 2, 1> measurement_i =
-                  vertex.getVisualFrame(i).getKeypointMeasurement(j);
-              Eigen::Matrix<double, 2, 1> measurement_j =
-                  vertex.getVisualFrame(i).getKeypointMeasurement(k);
-              double distance = (measurement_i - measurement_j).norm();
-              if (distance > kImageDisparitySameLandmarkError) {
-                LOG(ERROR) << "Landmark " << observed_landmark_j
-                           << " is observed "
-                           << " twice from the same frame (" << vertex_id
-                           << "), but the "
-                           << "observations evaluate to ["
-                           << measurement_i.transpose() << "] and ["
-                           << measurement_j.transpose() << "] (distance of "
-                           << distance << ") and threshold evaluates to "
-                           << kImageDisparitySameLandmarkError;
-                is_consistent = false;
-              } else if (distance > kImageDisparitySameLandmarkWarn) {
-                LOG(WARNING)
-                    << "Landmark " << observed_landmark_j << " is observed "
-                    << " twice from the same frame (" << vertex_id
-                    << "), but the "
-                    << "observations evaluate to [" << measurement_i.transpose()
-                    << "] and [" << measurement_j.transpose()
-                    << "] (distance of " << distance
-                    << ") and threshold evaluates to "
-                    << kImageDisparitySameLandmarkWarn;
+        const vi_map::Vertex& vertex = vi_map.getVertex(vertex_id);
+        LandmarkIdList& observed_landmark_ids =
+            vertex_observed_landmark_ids[vertex_idx];
+        for (unsigned int i = 0; i < vertex.numFrames(); ++i) {
+          if (vertex.isVisualFrameSet(i)) {
+            for (const LandmarkId& landmark_id :
+                 vertex.getFrameObservedLandmarkIds(i)) {
+              if (landmark_id.isValid()) {
+                observed_landmark_ids.emplace_back(landmark_id);
               }
             }
           }
         }
-      }
-    }
-
-    const vi_map::LandmarkStore& landmark_store = vertex.getLandmarks();
-
-    for (const vi_map::Landmark& landmark : landmark_store) {
-      const vi_map::LandmarkId& landmark_id = landmark.id();
-
-      // If this landmark id is non valid, it should not be in the global map.
-      if (!landmark_id.isValid()) {
-        LOG(ERROR) << "Landmark " << landmark_id.hexString()
-                   << " stored in vertex " << vertex_id.hexString()
-                   << " is invalid. Only valid landmarks should be in the "
-                      "store.";
-        is_consistent = false;
-      }
-      // Every landmark in the store should be in the global map.
-      if (!vi_map.hasLandmark(landmark_id)) {
-        LOG(ERROR) << "Landmark " << landmark_id.hexString()
-                   << " stored in vertex " << vertex_id.hexString()
-                   << " is not found in the global map.";
-        is_consistent = false;
-      }
-
-      const KeypointIdentifierList& vertex_id_frame_idx_kp_idx =
-          landmark_store.getLandmark(landmark_id).getObservations();
-
-      // Count how often we expect to find every vertex in the backwards
-      // reference list of the current landmark.
-      std::pair<LandmarkToVertexMap::iterator,
-                LandmarkToVertexMap::iterator>
-          range = landmark_observing_vertices.equal_range(landmark_id);
-      std::unordered_map<pose_graph::VertexId, int> refound_map;
-      for (LandmarkToVertexMap::iterator it_vertex = range.first;
-           it_vertex != range.second; ++it_vertex) {
-        // Increment the number of times we expect to find this to be
-        // back-referenced from the landmarks.
-        if (refound_map.count(it_vertex->second) == 0) {
-          refound_map[it_vertex->second] = 1;
-        } else {
-          ++refound_map[it_vertex->second];
-        }
-      }
-
-      VLOG(5) << "refound map:";
-      for (const std::pair<pose_graph::VertexId, int>& observation_counts :
-           refound_map) {
-        VLOG(5) << "Back-references to vertex "
-                << observation_counts.first.hexString() << " from landmark "
-                << landmark_id.hexString() << "  " << observation_counts.second;
-      }
-
-      // Check that all other observing vertices of this landmark have
-      // set the ID to the same state.
-      for (unsigned int j = 0; j < vertex_id_frame_idx_kp_idx.size(); ++j) {
-        const pose_graph::VertexId& observer_vertex_id =
-            vertex_id_frame_idx_kp_idx[j].frame_id.vertex_id;
-        if (!vi_map.hasVertex(observer_vertex_id)) {
-          LOG(ERROR) << "Landmark " << landmark_id.hexString()
-                     << " stored in vertex " << vertex_id
-                     << " lists the vertex " << observer_vertex_id
-                     << " as observer, but that vertex does not exist.";
-          is_consistent = false;
-        }
-
-        const Vertex& observer_vertex = vi_map.getVertex(observer_vertex_id);
-
-        // Check that we have seen this vertex before.
-        if (refound_map.count(observer_vertex_id) == 0u) {
-          LOG(ERROR) << "Landmark " << landmark_id.hexString()
-                     << " has an unknown vertex listed as observer: "
-                     << observer_vertex_id.hexString();
-          is_consistent = false;
-        }
-        // Check that there is still an unmatched observation for this vertex.
-        if (refound_map[observer_vertex_id] <= 0) {
-          LOG(ERROR)
-              << "The landmark " << landmark_id.hexString()
-              << " has the vertex " << observer_vertex_id.hexString()
-              << " in the list of back-references, but all back-references to"
-              << " this vertex have already been matched.";
-          is_consistent = false;
-        }
-        // Mark as found.
-        --refound_map[observer_vertex_id];
-
-        if (vertex_id_frame_idx_kp_idx[j].keypoint_index >=
-            observer_vertex.observedLandmarkIdsSize(
-                vertex_id_frame_idx_kp_idx[j].frame_id.frame_index)) {
-          LOG(ERROR) << "Keypoint index "
-                     << vertex_id_frame_idx_kp_idx[j].keypoint_index
-                     << " to retrieve landmark ID "
-                     << vertex_id_frame_idx_kp_idx[j].frame_id.vertex_id
-                     << " is out of bounds.";
-          is_consistent = false;
-          continue;
-        }
-
-        const vi_map::LandmarkId& observer_landmark_id =
-            observer_vertex.getObservedLandmarkId(
-                vertex_id_frame_idx_kp_idx[j].frame_id.frame_index,
-                vertex_id_frame_idx_kp_idx[j].keypoint_index);
-        if (!observer_landmark_id.isValid()) {
-          LOG(ERROR) << "The store landmark id " << landmark_id.hexString()
-                     << " has a backlink to an observer that has an invalid"
-                     << " landmark ID.";
-          is_consistent = false;
-        } else if (
-            observer_landmark_id != landmark_id) {
-          LOG(ERROR) << "The store vertex of landmark id "
-                     << landmark_id.hexString()
-                     << " and landmark id in the observer table "
-                     << observer_landmark_id.hexString()
-                     << " are inconsistent";
-          is_consistent = false;
-        }
-
-        if (landmark_id.isValid() != observer_landmark_id.isValid()) {
-          LOG(ERROR)
-              << "The valid state of corresponding landmarks stored in vertex "
-              << vertex_id.hexString() << " and "
-              << vertex_id_frame_idx_kp_idx[j].frame_id.vertex_id.hexString()
-              << " are inconsistent";
-          is_consistent = false;
-        }
-      }
+        return true;
+      });
+  const LandmarkObserverIndex landmark_observer_index(
+      all_vertices, vertex_observed_landmark_ids, num_threads);
+  vertex_observed_landmark_ids.clear();
+  LOG_IF(INFO, is_consistent) << "OK.";
 
-      for (const std::pair<pose_graph::VertexId, int>& observation_counts :
-           refound_map) {
-        if (observation_counts.second != 0) {
-          LOG(ERROR) << "Back-references to vertex "
-                     << observation_counts.first.hexString()
-                     << " missing in the list of back-references of landmark "
-                     << landmark_id.hexString();
-          is_consistent = false;
-        }
-      }
-    }
-    ++num_checked;
-  }
+  LOG(INFO) << "Verifying landmark references...";
+  is_consistent &= checkItemsInParallel(
+      all_vertices.size(), num_threads,
+      [&](const size_t vertex_idx, ConsistencyLog* log) -> bool {
+        const pose_graph::VertexId& vertex_id = all_vertices[vertex_idx];
+        // Existence in map verified above.
+        const Vertex& vertex = vi_map.getVertex(vertex_id);
+        bool is_vertex_consistent =
+            checkObservedLandmarkIds(vertex, vertex_id, log);
+        is_vertex_consistent &= checkStoredLandmarks(
+            vi_map, vertex, vertex_id, landmark_observer_index, log);
+        return is_vertex_consistent;
+      });
   LOG_IF(INFO, is_consistent) << "OK.";
 
   LOG(INFO) << "Verifying sensor consistency...";
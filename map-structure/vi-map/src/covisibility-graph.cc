@@ -0,0 +1,401 @@
+#include "vi-map/covisibility-graph.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#include <glog/logging.h>
+#include <maplab-common/parallel-process.h>
+
+#include "vi-map/vi-map.h"
+
+namespace vi_map {
+
+namespace {
+// The delta rows are folded into the CSR arrays once they hold more than
+// 1/kCompactionRatio of the CSR entries, but not below a minimum size.
+constexpr size_t kCompactionRatio = 4u;
+constexpr size_t kMinNumDeltaEntriesForCompaction = 1024u;
+}  // namespace
+
+CovisibilityGraph::CovisibilityGraph()
+    : row_begin_(1u, 0u), num_delta_entries_(0u) {}
+
+void CovisibilityGraph::build(
+    const VIMap& map, const pose_graph::VertexIdList& vertex_ids,
+    const size_t num_threads) {
+  CHECK_GT(num_threads, 0u);
+  const size_t num_vertices = vertex_ids.size();
+  CHECK_LT(num_vertices, std::numeric_limits<VertexIndex>::max());
+
+  vertex_ids_ = vertex_ids;
+  vertex_id_to_index_.clear();
+  vertex_id_to_index_.reserve(num_vertices);
+  for (size_t i = 0u; i < num_vertices; ++i) {
+    CHECK(vertex_id_to_index_.emplace(vertex_ids_[i], i).second)
+        << "Vertex " << vertex_ids_[i] << " is listed more than once.";
+  }
+  delta_rows_.clear();
+  num_delta_entries_ = 0u;
+
+  // Every row is computed independently from the landmarks its vertex
+  // observes, hence the rows can be built in parallel without locking.
+  std::vector<std::vector<std::pair<VertexIndex, uint32_t>>> rows(
+      num_vertices);
+  const auto build_rows = [&](const std::vector<size_t>& range) {
+    std::vector<uint32_t> row_weight(num_vertices, 0u);
+    // Ensures that every landmark counts only once per observer vertex.
+    std::vector<size_t> last_landmark_of_column(
+        num_vertices, std::numeric_limits<size_t>::max());
+    std::vector<VertexIndex> touched_columns;
+    size_t landmark_counter = 0u;
+    for (const size_t row : range) {
+      vi_map::LandmarkIdList observed_landmark_ids;
+      map.getVertex(vertex_ids_[row])
+          .getAllObservedLandmarkIds(&observed_landmark_ids);
+      vi_map::LandmarkIdSet landmark_ids(
+          observed_landmark_ids.begin(), observed_landmark_ids.end());
+
+      for (const vi_map::LandmarkId& landmark_id : landmark_ids) {
+        if (!landmark_id.isValid()) {
+          continue;
+        }
+        ++landmark_counter;
+        map.getLandmark(landmark_id)
+            .forEachObservation([&](const KeypointIdentifier& keypoint_id) {
+              VertexIndex column;
+              if (!getVertexIndex(keypoint_id.frame_id.vertex_id, &column) ||
+                  last_landmark_of_column[column] == landmark_counter) {
+                return;
+              }
+              last_landmark_of_column[column] = landmark_counter;
+              if (row_weight[column]++ == 0u) {
+                touched_columns.emplace_back(column);
+              }
+            });
+      }
+
+      std::sort(touched_columns.begin(), touched_columns.end());
+      rows[row].reserve(touched_columns.size());
+      for (const VertexIndex column : touched_columns) {
+        rows[row].emplace_back(column, row_weight[column]);
+        row_weight[column] = 0u;
+      }
+      touched_columns.clear();
+    }
+  };
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      num_vertices, build_rows, kAlwaysParallelize, num_threads);
+
+  row_begin_.resize(num_vertices + 1u);
+  row_begin_[0] = 0u;
+  for (size_t row = 0u; row < num_vertices; ++row) {
+    row_begin_[row + 1u] = row_begin_[row] + rows[row].size();
+  }
+  column_index_.resize(row_begin_.back());
+  weight_.resize(row_begin_.back());
+  for (size_t row = 0u; row < num_vertices; ++row) {
+    size_t offset = row_begin_[row];
+    for (const std::pair<VertexIndex, uint32_t>& entry : rows[row]) {
+      column_index_[offset] = entry.first;
+      weight_[offset] = entry.second;
+      ++offset;
+    }
+  }
+  VLOG(1) << "Built covisibility graph with " << num_vertices
+          << " vertices and " << column_index_.size() << " entries.";
+}
+
+void CovisibilityGraph::addLandmark(
+    const pose_graph::VertexIdSet& observer_vertex_ids) {
+  std::vector<VertexIndex> observers;
+  observers.reserve(observer_vertex_ids.size());
+  for (const pose_graph::VertexId& vertex_id : observer_vertex_ids) {
+    observers.emplace_back(getOrAddVertexIndex(vertex_id));
+  }
+  for (const VertexIndex row : observers) {
+    for (const VertexIndex column : observers) {
+      addToWeight(row, column, 1);
+    }
+  }
+  compactIfNecessary();
+}
+
+void CovisibilityGraph::removeLandmark(
+    const pose_graph::VertexIdSet& observer_vertex_ids) {
+  std::vector<VertexIndex> observers;
+  observers.reserve(observer_vertex_ids.size());
+  for (const pose_graph::VertexId& vertex_id : observer_vertex_ids) {
+    // Vertices that are not part of the graph don't have any weights.
+    VertexIndex index;
+    if (getVertexIndex(vertex_id, &index)) {
+      observers.emplace_back(index);
+    }
+  }
+  for (const VertexIndex row : observers) {
+    for (const VertexIndex column : observers) {
+      addToWeight(row, column, -1);
+    }
+  }
+  compactIfNecessary();
+}
+
+void CovisibilityGraph::addLandmarkObserver(
+    const pose_graph::VertexId& new_observer_vertex_id,
+    const pose_graph::VertexIdSet& existing_observer_vertex_ids) {
+  CHECK_EQ(existing_observer_vertex_ids.count(new_observer_vertex_id), 0u);
+  const VertexIndex new_observer = getOrAddVertexIndex(new_observer_vertex_id);
+  addToWeight(new_observer, new_observer, 1);
+  for (const pose_graph::VertexId& vertex_id : existing_observer_vertex_ids) {
+    const VertexIndex existing_observer = getOrAddVertexIndex(vertex_id);
+    addToWeight(new_observer, existing_observer, 1);
+    addToWeight(existing_observer, new_observer, 1);
+  }
+  compactIfNecessary();
+}
+
+void CovisibilityGraph::removeVertex(const pose_graph::VertexId& vertex_id) {
+  VertexIndex row;
+  if (!getVertexIndex(vertex_id, &row)) {
+    return;
+  }
+  std::vector<std::pair<pose_graph::VertexId, size_t>> neighbors;
+  forEachNeighbor(
+      vertex_id,
+      [&neighbors](const pose_graph::VertexId& neighbor, size_t weight) {
+        neighbors.emplace_back(neighbor, weight);
+      });
+  for (const std::pair<pose_graph::VertexId, size_t>& neighbor : neighbors) {
+    const VertexIndex column = vertex_id_to_index_.at(neighbor.first);
+    const int weight = static_cast<int>(neighbor.second);
+    addToWeight(row, column, -weight);
+    if (column != row) {
+      addToWeight(column, row, -weight);
+    }
+  }
+  compactIfNecessary();
+}
+
+size_t CovisibilityGraph::getWeight(
+    const pose_graph::VertexId& vertex_id_a,
+    const pose_graph::VertexId& vertex_id_b) const {
+  VertexIndex row, column;
+  if (!getVertexIndex(vertex_id_a, &row) ||
+      !getVertexIndex(vertex_id_b, &column)) {
+    return 0u;
+  }
+  return getWeight(row, column);
+}
+
+void CovisibilityGraph::forEachNeighbor(
+    const pose_graph::VertexId& vertex_id,
+    const std::function<void(const pose_graph::VertexId&, size_t)>& action)
+    const {
+  CHECK(action);
+  VertexIndex row;
+  if (!getVertexIndex(vertex_id, &row)) {
+    return;
+  }
+  const std::unordered_map<VertexIndex, int>* delta_row =
+      row < delta_rows_.size() ? &delta_rows_[row] : nullptr;
+
+  if (row < numCsrRows()) {
+    for (size_t offset = row_begin_[row]; offset < row_begin_[row + 1u];
+         ++offset) {
+      const VertexIndex column = column_index_[offset];
+      int64_t weight = weight_[offset];
+      if (delta_row != nullptr) {
+        std::unordered_map<VertexIndex, int>::const_iterator it =
+            delta_row->find(column);
+        if (it != delta_row->end()) {
+          weight += it->second;
+        }
+      }
+      if (weight > 0) {
+        action(vertex_ids_[column], static_cast<size_t>(weight));
+      }
+    }
+  }
+
+  if (delta_row != nullptr) {
+    for (const std::pair<const VertexIndex, int>& entry : *delta_row) {
+      if (entry.second > 0 && findCsrEntry(row, entry.first) < 0) {
+        action(vertex_ids_[entry.first], static_cast<size_t>(entry.second));
+      }
+    }
+  }
+}
+
+bool CovisibilityGraph::hasVertex(const pose_graph::VertexId& vertex_id) const {
+  return vertex_id_to_index_.count(vertex_id) > 0u;
+}
+
+size_t CovisibilityGraph::numVertices() const {
+  return vertex_ids_.size();
+}
+
+size_t CovisibilityGraph::numEntries() const {
+  size_t num_entries = 0u;
+  for (const pose_graph::VertexId& vertex_id : vertex_ids_) {
+    forEachNeighbor(
+        vertex_id, [&num_entries](const pose_graph::VertexId&, size_t) {
+          ++num_entries;
+        });
+  }
+  return num_entries;
+}
+
+size_t CovisibilityGraph::getMemoryUsageBytes() const {
+  // Hash map entries are estimated as the value plus a next pointer and the
+  // cached hash.
+  constexpr size_t kHashNodeOverhead = 2u * sizeof(void*);
+  size_t num_bytes = sizeof(*this);
+  num_bytes += vertex_id_to_index_.bucket_count() * sizeof(void*) +
+               vertex_id_to_index_.size() *
+                   (sizeof(std::pair<pose_graph::VertexId, VertexIndex>) +
+                    kHashNodeOverhead);
+  num_bytes += vertex_ids_.capacity() * sizeof(pose_graph::VertexId);
+  num_bytes += row_begin_.capacity() * sizeof(size_t);
+  num_bytes += column_index_.capacity() * sizeof(VertexIndex);
+  num_bytes += weight_.capacity() * sizeof(uint32_t);
+  num_bytes += delta_rows_.capacity() *
+               sizeof(std::unordered_map<VertexIndex, int>);
+  for (const std::unordered_map<VertexIndex, int>& delta_row : delta_rows_) {
+    num_bytes += delta_row.bucket_count() * sizeof(void*) +
+                 delta_row.size() * (sizeof(std::pair<VertexIndex, int>) +
+                                     kHashNodeOverhead);
+  }
+  return num_bytes;
+}
+
+void CovisibilityGraph::compact() {
+  const size_t num_vertices = vertex_ids_.size();
+  std::vector<size_t> row_begin(num_vertices + 1u, 0u);
+  std::vector<VertexIndex> column_index;
+  std::vector<uint32_t> weight;
+  column_index.reserve(column_index_.size() + num_delta_entries_);
+  weight.reserve(column_index_.size() + num_delta_entries_);
+
+  std::vector<std::pair<VertexIndex, uint32_t>> row_entries;
+  for (VertexIndex row = 0u; row < num_vertices; ++row) {
+    row_entries.clear();
+    forEachNeighbor(
+        vertex_ids_[row],
+        [&](const pose_graph::VertexId& neighbor, size_t neighbor_weight) {
+          row_entries.emplace_back(
+              vertex_id_to_index_.at(neighbor), neighbor_weight);
+        });
+    std::sort(row_entries.begin(), row_entries.end());
+    for (const std::pair<VertexIndex, uint32_t>& entry : row_entries) {
+      column_index.emplace_back(entry.first);
+      weight.emplace_back(entry.second);
+    }
+    row_begin[row + 1u] = column_index.size();
+  }
+
+  row_begin_.swap(row_begin);
+  column_index_.swap(column_index);
+  weight_.swap(weight);
+  delta_rows_.clear();
+  num_delta_entries_ = 0u;
+}
+
+bool CovisibilityGraph::getVertexIndex(
+    const pose_graph::VertexId& vertex_id, VertexIndex* index) const {
+  CHECK_NOTNULL(index);
+  std::unordered_map<pose_graph::VertexId, VertexIndex>::const_iterator it =
+      vertex_id_to_index_.find(vertex_id);
+  if (it == vertex_id_to_index_.end()) {
+    return false;
+  }
+  *index = it->second;
+  return true;
+}
+
+CovisibilityGraph::VertexIndex CovisibilityGraph::getOrAddVertexIndex(
+    const pose_graph::VertexId& vertex_id) {
+  CHECK(vertex_id.isValid());
+  std::pair<std::unordered_map<pose_graph::VertexId, VertexIndex>::iterator,
+            bool>
+      inserted = vertex_id_to_index_.emplace(vertex_id, vertex_ids_.size());
+  if (inserted.second) {
+    CHECK_LT(vertex_ids_.size(), std::numeric_limits<VertexIndex>::max());
+    vertex_ids_.emplace_back(vertex_id);
+  }
+  return inserted.first->second;
+}
+
+void CovisibilityGraph::addToWeight(
+    const VertexIndex row, const VertexIndex column, const int delta) {
+  CHECK_LT(row, vertex_ids_.size());
+  CHECK_LT(column, vertex_ids_.size());
+  if (delta_rows_.size() <= row) {
+    delta_rows_.resize(vertex_ids_.size());
+  }
+  std::unordered_map<VertexIndex, int>& delta_row = delta_rows_[row];
+  std::pair<std::unordered_map<VertexIndex, int>::iterator, bool> inserted =
+      delta_row.emplace(column, 0);
+  if (inserted.second) {
+    ++num_delta_entries_;
+  }
+  inserted.first->second += delta;
+
+  const int64_t offset = findCsrEntry(row, column);
+  const int64_t csr_weight = offset < 0 ? 0 : weight_[offset];
+  CHECK_GE(csr_weight + inserted.first->second, 0)
+      << "Negative covisibility between vertices " << vertex_ids_[row]
+      << " and " << vertex_ids_[column] << ".";
+
+  if (inserted.first->second == 0) {
+    delta_row.erase(inserted.first);
+    --num_delta_entries_;
+  }
+}
+
+size_t CovisibilityGraph::getWeight(
+    const VertexIndex row, const VertexIndex column) const {
+  const int64_t offset = findCsrEntry(row, column);
+  int64_t weight = offset < 0 ? 0 : weight_[offset];
+  if (row < delta_rows_.size()) {
+    std::unordered_map<VertexIndex, int>::const_iterator it =
+        delta_rows_[row].find(column);
+    if (it != delta_rows_[row].end()) {
+      weight += it->second;
+    }
+  }
+  CHECK_GE(weight, 0);
+  return static_cast<size_t>(weight);
+}
+
+int64_t CovisibilityGraph::findCsrEntry(
+    const VertexIndex row, const VertexIndex column) const {
+  if (row >= numCsrRows()) {
+    return -1;
+  }
+  const std::vector<VertexIndex>::const_iterator row_begin =
+      column_index_.begin() + row_begin_[row];
+  const std::vector<VertexIndex>::const_iterator row_end =
+      column_index_.begin() + row_begin_[row + 1u];
+  const std::vector<VertexIndex>::const_iterator it =
+      std::lower_bound(row_begin, row_end, column);
+  if (it == row_end || *it != column) {
+    return -1;
+  }
+  return it - column_index_.begin();
+}
+
+size_t CovisibilityGraph::numCsrRows() const {
+  return row_begin_.size() - 1u;
+}
+
+void CovisibilityGraph::compactIfNecessary() {
+  if (num_delta_entries_ >
+      std::max(
+          kMinNumDeltaEntriesForCompaction,
+          column_index_.size() / kCompactionRatio)) {
+    compact();
+  }
+}
+
+}  // namespace vi_map
@@ -0,0 +1,144 @@
+#include "vi-map/dirty-tracker.h"
+
+#include <vector>
+
+#include <aslam/common/memory.h>
+#include <glog/logging.h>
+#include <maplab-common/parallel-process.h>
+
+#include "vi-map/vi-map.h"
+
+namespace vi_map {
+
+void DirtyTracker::markVertexDirty(const pose_graph::VertexId& vertex_id) {
+  CHECK(vertex_id.isValid());
+  dirty_vertex_ids_.emplace(vertex_id);
+}
+
+void DirtyTracker::markLandmarkDirty(const LandmarkId& landmark_id) {
+  CHECK(landmark_id.isValid());
+  dirty_landmark_ids_.emplace(landmark_id);
+}
+
+void DirtyTracker::removeLandmark(const LandmarkId& landmark_id) {
+  dirty_landmark_ids_.erase(landmark_id);
+}
+
+void DirtyTracker::getDirtyVertices(
+    const VIMap& map, const size_t num_threads,
+    pose_graph::VertexIdList* dirty_vertex_ids) const {
+  CHECK_NOTNULL(dirty_vertex_ids)->clear();
+  CHECK_GT(num_threads, 0u);
+
+  pose_graph::VertexIdList vertex_ids;
+  map.getAllVertexIds(&vertex_ids);
+  // Not std::vector<bool>, its elements can't be written concurrently.
+  std::vector<unsigned char> is_dirty(vertex_ids.size(), 0u);
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      vertex_ids.size(),
+      [&](const std::vector<size_t>& range) {
+        for (const size_t vertex_idx : range) {
+          const pose_graph::VertexId& vertex_id = vertex_ids[vertex_idx];
+          if (dirty_vertex_ids_.count(vertex_id) > 0u) {
+            is_dirty[vertex_idx] = 1u;
+            continue;
+          }
+          const VertexPoseMap::const_iterator it =
+              T_G_I_snapshot_.find(vertex_id);
+          // Poses are compared exactly, any write of the optimizers counts.
+          if (it == T_G_I_snapshot_.end() ||
+              !(map.getVertex_T_G_I(vertex_id) == it->second)) {
+            is_dirty[vertex_idx] = 1u;
+          }
+        }
+      },
+      kAlwaysParallelize, num_threads);
+
+  for (size_t vertex_idx = 0u; vertex_idx < vertex_ids.size(); ++vertex_idx) {
+    if (is_dirty[vertex_idx] != 0u) {
+      dirty_vertex_ids->emplace_back(vertex_ids[vertex_idx]);
+    }
+  }
+}
+
+void DirtyTracker::getDirtyLandmarks(
+    const VIMap& map, const size_t num_threads,
+    LandmarkIdList* dirty_landmark_ids) const {
+  CHECK_NOTNULL(dirty_landmark_ids)->clear();
+  CHECK_GT(num_threads, 0u);
+
+  pose_graph::VertexIdList dirty_vertex_ids;
+  getDirtyVertices(map, num_threads, &dirty_vertex_ids);
+
+  std::vector<LandmarkIdList> vertex_landmark_ids(dirty_vertex_ids.size());
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      dirty_vertex_ids.size(),
+      [&](const std::vector<size_t>& range) {
+        for (const size_t vertex_idx : range) {
+          const Vertex& vertex = map.getVertex(dirty_vertex_ids[vertex_idx]);
+          LandmarkIdList& landmark_ids = vertex_landmark_ids[vertex_idx];
+          vertex.getStoredLandmarkIdList(&landmark_ids);
+          for (size_t frame_idx = 0u; frame_idx < vertex.numFrames();
+               ++frame_idx) {
+            for (const LandmarkId& landmark_id :
+                 vertex.getFrameObservedLandmarkIds(frame_idx)) {
+              if (landmark_id.isValid() && map.hasLandmark(landmark_id)) {
+                landmark_ids.emplace_back(landmark_id);
+              }
+            }
+          }
+        }
+      },
+      kAlwaysParallelize, num_threads);
+
+  LandmarkIdSet landmark_id_set;
+  for (const LandmarkId& landmark_id : dirty_landmark_ids_) {
+    if (map.hasLandmark(landmark_id)) {
+      landmark_id_set.emplace(landmark_id);
+    }
+  }
+  for (const LandmarkIdList& landmark_ids : vertex_landmark_ids) {
+    landmark_id_set.insert(landmark_ids.begin(), landmark_ids.end());
+  }
+  dirty_landmark_ids->assign(landmark_id_set.begin(), landmark_id_set.end());
+}
+
+void DirtyTracker::reset(const VIMap& map, const size_t num_threads) {
+  CHECK_GT(num_threads, 0u);
+  clear();
+
+  pose_graph::VertexIdList vertex_ids;
+  map.getAllVertexIds(&vertex_ids);
+  Aligned<std::vector, pose::Transformation> T_G_I(vertex_ids.size());
+  constexpr bool kAlwaysParallelize = false;
+  common::ParallelProcess(
+      vertex_ids.size(),
+      [&](const std::vector<size_t>& range) {
+        for (const size_t vertex_idx : range) {
+          T_G_I[vertex_idx] = map.getVertex_T_G_I(vertex_ids[vertex_idx]);
+        }
+      },
+      kAlwaysParallelize, num_threads);
+
+  T_G_I_snapshot_.reserve(vertex_ids.size());
+  for (size_t vertex_idx = 0u; vertex_idx < vertex_ids.size(); ++vertex_idx) {
+    T_G_I_snapshot_.emplace(vertex_ids[vertex_idx], T_G_I[vertex_idx]);
+  }
+}
+
+void DirtyTracker::clear() {
+  dirty_vertex_ids_.clear();
+  dirty_landmark_ids_.clear();
+  T_G_I_snapshot_.clear();
+}
+
+void DirtyTracker::swap(DirtyTracker* other) {
+  CHECK_NOTNULL(other);
+  dirty_vertex_ids_.swap(other->dirty_vertex_ids_);
+  dirty_landmark_ids_.swap(other->dirty_landmark_ids_);
+  T_G_I_snapshot_.swap(other->T_G_I_snapshot_);
+}
+
+}  // namespace vi_map
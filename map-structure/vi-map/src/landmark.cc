@@ -119,6 +119,12 @@ void Landmark::removeAllObservationsOfVertexAndFrame(
   removeAllObservationsAccordingToPredicate(predicate);
 }
 
+void Landmark::setObservationKeypointIndex(
+    size_t observation_index, size_t keypoint_index) {
+  CHECK_LT(observation_index, observations_.size());
+  observations_[observation_index].keypoint_index = keypoint_index;
+}
+
 unsigned int Landmark::numberOfObserverVertices() const {
   pose_graph::VertexIdSet vertices;
   for (const KeypointIdentifier& backlink : observations_) {
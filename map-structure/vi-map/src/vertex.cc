@@ -2,6 +2,7 @@
 
 #include <string>
 #include <unordered_set>
+#include <vector>
 
 #include <glog/logging.h>
 
@@ -15,6 +16,29 @@
 #include "vi-map/vi_map.pb.h"
 
 namespace vi_map {
+namespace {
+
+template <typename MatrixType>
+void keepColumns(const std::vector<size_t>& kept_indices, MatrixType* matrix) {
+  CHECK_NOTNULL(matrix);
+  MatrixType kept_columns(matrix->rows(), kept_indices.size());
+  for (size_t i = 0u; i < kept_indices.size(); ++i) {
+    kept_columns.col(i) = matrix->col(kept_indices[i]);
+  }
+  matrix->swap(kept_columns);
+}
+
+template <typename VectorType>
+void keepRows(const std::vector<size_t>& kept_indices, VectorType* vector) {
+  CHECK_NOTNULL(vector);
+  VectorType kept_rows(kept_indices.size());
+  for (size_t i = 0u; i < kept_indices.size(); ++i) {
+    kept_rows(i) = (*vector)(kept_indices[i]);
+  }
+  vector->swap(kept_rows);
+}
+
+}  // namespace
 
 Vertex::Vertex(
     const pose_graph::VertexId& vertex_id,
@@ -722,6 +746,73 @@ void Vertex::resetObservedLandmarkIdsToInvalid() {
   checkConsistencyOfVisualObservationContainers();
 }
 
+void Vertex::discardKeypoints(
+    unsigned int frame_idx, const std::vector<size_t>& keypoint_indices) {
+  CHECK(isFrameIndexValid(frame_idx));
+  if (keypoint_indices.empty()) {
+    return;
+  }
+  LandmarkIdList& landmark_ids = observed_landmark_ids_[frame_idx];
+  const size_t num_keypoints = landmark_ids.size();
+  std::vector<bool> is_discarded(num_keypoints, false);
+  for (const size_t keypoint_idx : keypoint_indices) {
+    CHECK_LT(keypoint_idx, num_keypoints);
+    is_discarded[keypoint_idx] = true;
+  }
+  std::vector<size_t> kept_indices;
+  kept_indices.reserve(num_keypoints);
+  for (size_t keypoint_idx = 0u; keypoint_idx < num_keypoints;
+       ++keypoint_idx) {
+    if (!is_discarded[keypoint_idx]) {
+      kept_indices.emplace_back(keypoint_idx);
+    }
+  }
+
+  aslam::VisualFrame& frame = getVisualFrame(frame_idx);
+  if (frame.hasKeypointMeasurements()) {
+    Eigen::Matrix2Xd measurements = frame.getKeypointMeasurements();
+    keepColumns(kept_indices, &measurements);
+    frame.swapKeypointMeasurements(&measurements);
+  }
+  if (frame.hasKeypointMeasurementUncertainties()) {
+    Eigen::VectorXd uncertainties = frame.getKeypointMeasurementUncertainties();
+    keepRows(kept_indices, &uncertainties);
+    frame.swapKeypointMeasurementUncertainties(&uncertainties);
+  }
+  if (frame.hasKeypointOrientations()) {
+    Eigen::VectorXd orientations = frame.getKeypointOrientations();
+    keepRows(kept_indices, &orientations);
+    frame.swapKeypointOrientations(&orientations);
+  }
+  if (frame.hasKeypointScales()) {
+    Eigen::VectorXd scales = frame.getKeypointScales();
+    keepRows(kept_indices, &scales);
+    frame.swapKeypointScales(&scales);
+  }
+  if (frame.hasKeypointScores()) {
+    Eigen::VectorXd scores = frame.getKeypointScores();
+    keepRows(kept_indices, &scores);
+    frame.swapKeypointScores(&scores);
+  }
+  if (frame.hasTrackIds()) {
+    Eigen::VectorXi track_ids = frame.getTrackIds();
+    keepRows(kept_indices, &track_ids);
+    frame.swapTrackIds(&track_ids);
+  }
+  if (frame.hasDescriptors()) {
+    aslam::VisualFrame::DescriptorsT descriptors = frame.getDescriptors();
+    keepColumns(kept_indices, &descriptors);
+    frame.swapDescriptors(&descriptors);
+  }
+
+  LandmarkIdList kept_landmark_ids;
+  kept_landmark_ids.reserve(kept_indices.size());
+  for (const size_t keypoint_idx : kept_indices) {
+    kept_landmark_ids.emplace_back(landmark_ids[keypoint_idx]);
+  }
+  landmark_ids.swap(kept_landmark_ids);
+}
+
 int Vertex::numValidObservedLandmarkIdsInAllFrames() const {
   int valid_observed_landmark_id_count = 0;
   for (unsigned int i = 0; i < numFrames(); ++i) {
@@ -14,6 +14,7 @@
 #include <maplab-common/map-manager-config.h>
 #include <maplab-common/multi-threaded-progress-bar.h>
 #include <maplab-common/parallel-process.h>
+#include <maplab-common/profiler.h>
 #include <maplab-common/proto-serialization-helper.h>
 
 #include "vi-map/vi-map.h"
@@ -224,6 +225,7 @@ void deserializeLandmarkIndex(
             vertex.setObservedLandmarkId(keypoint_id, actual_landmark_id);
           });
     }
+    map->dropCovisibilityGraph();
   }
 }
 
@@ -462,6 +464,7 @@ std::string getFileNameFromIndex(const size_t index) {
 
 bool loadMapFromFolder(const std::string& folder_path, vi_map::VIMap* map) {
   CHECK_NOTNULL(map);
+  MAPLAB_PROFILE_ZONE("VIMap: Load map");
   std::string sensors_yaml_filepath;
   std::vector<std::string> list_of_resource_filepaths;
   std::vector<std::string> list_of_map_proto_filepaths;
@@ -504,6 +507,7 @@ bool loadMapFromFolder(const std::string& folder_path, vi_map::VIMap* map) {
         size_t num_processed_tasks = 0u;
 
         for (const size_t& task_idx : range) {
+          MAPLAB_PROFILE_ZONE("VIMap: Load proto");
           CHECK_LT(task_idx, list_of_map_proto_filepaths.size());
           const std::string file_name =
               list_of_map_proto_filepaths[task_idx].substr(
@@ -569,6 +573,7 @@ bool loadMapFromFolder(const std::string& folder_path, vi_map::VIMap* map) {
   const size_t start_index = internal::kProtoListVerticesStartIndex;
   if (end_index > start_index) {
     VLOG(1) << "Reading vertices...";
+    MAPLAB_PROFILE_ZONE("VIMap: Load vertices");
     common::ParallelProcess(
         start_index, end_index, load_function, kAlwaysParallelize, num_threads);
   } else {
@@ -584,8 +589,12 @@ bool loadMapFromFolder(const std::string& folder_path, vi_map::VIMap* map) {
   VLOG(1) << "Reading optional sensor data...";
   load_function({internal::kProtoListOptionalSensorData});
 
-  CHECK(
-      backend::resource_map_serialization::loadMapFromFolder(folder_path, map));
+  {
+    MAPLAB_PROFILE_ZONE("VIMap: Load resource info");
+    CHECK(
+        backend::resource_map_serialization::loadMapFromFolder(
+            folder_path, map));
+  }
 
   LOG(INFO) << "Loaded VIMap from \"" << folder_path << "\".";
   return true;
@@ -594,6 +603,7 @@ bool loadMapFromFolder(const std::string& folder_path, vi_map::VIMap* map) {
 bool saveMapToFolder(
     const std::string& folder_path, const backend::SaveConfig& config,
     vi_map::VIMap* map) {
+  MAPLAB_PROFILE_ZONE("VIMap: Save map");
   std::string complete_folder_path;
   common::concatenateFolderAndFileName(
       folder_path, getSubFolderName(), &complete_folder_path);
@@ -7,6 +7,7 @@
 #include <aslam/common/time.h>
 #include <map-resources/resource_metadata.pb.h>
 #include <maplab-common/file-system-tools.h>
+#include <maplab-common/threading-helpers.h>
 
 #include "vi-map/deprecated/vi-map-serialization-deprecated.h"
 #include "vi-map/semantics-manager.h"
@@ -43,6 +44,7 @@ void VIMap::deepCopy(const VIMap& other) {
 
 void VIMap::mergeAllMissionsFromMapWithoutResources(
     const vi_map::VIMap& other) {
+  dropCovisibilityGraph();
   const SensorManager& other_sensor_manager = other.getSensorManager();
 
   // Get all missions from old map and add them into the new map.
@@ -145,6 +147,8 @@ void VIMap::swap(VIMap* other) {
   mission_base_frames.swap(other->mission_base_frames);
   landmark_index.swap(&other->landmark_index);
   optional_sensor_data_map_.swap(other->optional_sensor_data_map_);
+  covisibility_graph_.swap(other->covisibility_graph_);
+  dirty_tracker_.swap(&other->dirty_tracker_);
 }
 
 bool VIMap::hexStringToMissionIdIfValid(
@@ -844,7 +848,16 @@ void VIMap::associateKeypointWithExistingLandmark(
 
   // Update landmark.
   vi_map::Landmark& landmark = getLandmark(landmark_id);
+  if (covisibility_graph_) {
+    pose_graph::VertexIdSet observer_vertex_ids;
+    getLandmarkObserverVertices(landmark_id, &observer_vertex_ids);
+    if (observer_vertex_ids.count(keypoint_vertex_id) == 0u) {
+      covisibility_graph_->addLandmarkObserver(
+          keypoint_vertex_id, observer_vertex_ids);
+    }
+  }
   landmark.addObservation(keypoint_vertex_id, frame_index, keypoint_index);
+  dirty_tracker_.markLandmarkDirty(landmark_id);
 }
 
 void VIMap::associateKeypointWithExistingLandmark(
@@ -854,6 +867,38 @@ void VIMap::associateKeypointWithExistingLandmark(
       keypoint_id.keypoint_index, landmark_id);
 }
 
+void VIMap::buildCovisibilityGraph() {
+  dropCovisibilityGraph();
+  getCovisibilityGraph();
+}
+
+void VIMap::dropCovisibilityGraph() const {
+  std::lock_guard<std::mutex> lock(covisibility_graph_mutex_);
+  covisibility_graph_.reset();
+}
+
+bool VIMap::hasCovisibilityGraph() const {
+  std::lock_guard<std::mutex> lock(covisibility_graph_mutex_);
+  return covisibility_graph_ != nullptr;
+}
+
+const CovisibilityGraph* VIMap::getCovisibilityGraph() const {
+  // Concurrent queries build the graph only once.
+  std::lock_guard<std::mutex> lock(covisibility_graph_mutex_);
+  if (!covisibility_graph_) {
+    pose_graph::VertexIdList vertex_ids;
+    getAllVertexIds(&vertex_ids);
+    covisibility_graph_.reset(new CovisibilityGraph);
+    covisibility_graph_->build(
+        *this, vertex_ids, common::getNumHardwareThreads());
+  }
+  return covisibility_graph_.get();
+}
+
+void VIMap::clearDirtyState(const size_t num_threads) {
+  dirty_tracker_.reset(*this, num_threads);
+}
+
 void VIMap::getAllVertex_p_G_I(
     const MissionId& mission_id, Eigen::Matrix3Xd* result) const {
   CHECK_NOTNULL(result);
@@ -1047,6 +1092,9 @@ void VIMap::mergeNeighboringVertices(
   }
 
   // Remove the vertex.
+  if (covisibility_graph_) {
+    covisibility_graph_->removeVertex(next_vertex_id);
+  }
   posegraph.removeVertex(next_vertex_id);
 }
 
@@ -1078,6 +1126,22 @@ void VIMap::mergeLandmarks(
   const vi_map::Landmark& landmark_to_merge =
       landmark_vertex_to_merge.getLandmarks().getLandmark(landmark_id_to_merge);
 
+  if (covisibility_graph_) {
+    pose_graph::VertexIdSet observer_vertex_ids_to_merge;
+    getLandmarkObserverVertices(
+        landmark_id_to_merge, &observer_vertex_ids_to_merge);
+    pose_graph::VertexIdSet observer_vertex_ids_into;
+    getLandmarkObserverVertices(landmark_id_into, &observer_vertex_ids_into);
+    covisibility_graph_->removeLandmark(observer_vertex_ids_to_merge);
+    covisibility_graph_->removeLandmark(observer_vertex_ids_into);
+    observer_vertex_ids_into.insert(
+        observer_vertex_ids_to_merge.begin(),
+        observer_vertex_ids_to_merge.end());
+    covisibility_graph_->addLandmark(observer_vertex_ids_into);
+  }
+  dirty_tracker_.removeLandmark(landmark_id_to_merge);
+  dirty_tracker_.markLandmarkDirty(landmark_id_into);
+
   // Move backlinks in landmark object to the new landmark.
   landmark_into.addObservations(landmark_to_merge.getObservations());
 
@@ -1114,6 +1178,7 @@ void VIMap::mergeLandmarks(
 
 void VIMap::duplicateMission(const vi_map::MissionId& source_mission_id) {
   CHECK(hasMission(source_mission_id));
+  dropCovisibilityGraph();
 
   const vi_map::VIMission& source_mission = getMission(source_mission_id);
   const vi_map::MissionBaseFrame& source_baseframe =
@@ -1545,6 +1610,7 @@ void VIMap::removeMission(
   // Delete all the vertices and edges in the mission.
   CHECK(mission_id.isValid());
   CHECK(hasMission(mission_id));
+  dropCovisibilityGraph();
 
   vi_map::VIMission& mission = getMission(mission_id);
   pose_graph::VertexIdList vertices;
@@ -1911,14 +1977,17 @@ void VIMap::setRandIntGeneratorSeed(int seed) {
 
 void VIMap::selectMissions(
     const vi_map::MissionIdSet& selected_missions_ids) const {
+  dropCovisibilityGraph();
   selected_missions_ = selected_missions_ids;
 }
 
 void VIMap::deselectMission(const vi_map::MissionId& mission_id) const {
+  dropCovisibilityGraph();
   selected_missions_.erase(mission_id);
 }
 
 void VIMap::resetMissionSelection() const {
+  dropCovisibilityGraph();
   selected_missions_.clear();
 }
 
@@ -0,0 +1,143 @@
+#include <unordered_map>
+#include <vector>
+
+#include <maplab-common/test/testing-entrypoint.h>
+
+#include "vi-map/covisibility-graph.h"
+#include "vi-map/test/vi-map-test-helpers.h"
+#include "vi-map/vi-map.h"
+
+namespace vi_map {
+
+class CovisibilityGraphTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    test::generateMap(kNumVertices, &map_);
+    map_.getAllVertexIds(&vertex_ids_);
+  }
+
+  // Number of distinct landmarks observed by both vertices.
+  size_t countCommonLandmarks(
+      const pose_graph::VertexId& vertex_id_a,
+      const pose_graph::VertexId& vertex_id_b) const {
+    LandmarkIdSet landmarks_a;
+    map_.getAllLandmarkIdsObservedAtVertices({vertex_id_a}, &landmarks_a);
+    LandmarkIdSet landmarks_b;
+    map_.getAllLandmarkIdsObservedAtVertices({vertex_id_b}, &landmarks_b);
+    size_t num_common_landmarks = 0u;
+    for (const LandmarkId& landmark_id : landmarks_a) {
+      num_common_landmarks += landmarks_b.count(landmark_id);
+    }
+    return num_common_landmarks;
+  }
+
+  void expectGraphMatchesObservations() const {
+    const CovisibilityGraph* graph = map_.getCovisibilityGraph();
+    ASSERT_NE(graph, nullptr);
+    for (const pose_graph::VertexId& vertex_id_a : vertex_ids_) {
+      std::unordered_map<pose_graph::VertexId, size_t> neighbors;
+      graph->forEachNeighbor(
+          vertex_id_a,
+          [&neighbors](const pose_graph::VertexId& neighbor, size_t weight) {
+            EXPECT_GT(weight, 0u);
+            EXPECT_TRUE(neighbors.emplace(neighbor, weight).second);
+          });
+      for (const pose_graph::VertexId& vertex_id_b : vertex_ids_) {
+        const size_t expected_weight =
+            countCommonLandmarks(vertex_id_a, vertex_id_b);
+        EXPECT_EQ(expected_weight, graph->getWeight(vertex_id_a, vertex_id_b));
+        const size_t neighbor_weight =
+            neighbors.count(vertex_id_b) > 0u ? neighbors[vertex_id_b] : 0u;
+        EXPECT_EQ(expected_weight, neighbor_weight);
+      }
+    }
+  }
+
+  static constexpr size_t kNumVertices = 30u;
+  VIMap map_;
+  pose_graph::VertexIdList vertex_ids_;
+};
+
+TEST_F(CovisibilityGraphTest, BuildMatchesObservations) {
+  EXPECT_FALSE(map_.hasCovisibilityGraph());
+  map_.buildCovisibilityGraph();
+  EXPECT_EQ(map_.getCovisibilityGraph()->numVertices(), vertex_ids_.size());
+  expectGraphMatchesObservations();
+}
+
+TEST_F(CovisibilityGraphTest, FirstQueryBuildsGraph) {
+  EXPECT_FALSE(map_.hasCovisibilityGraph());
+  const CovisibilityGraph* graph = map_.getCovisibilityGraph();
+  ASSERT_NE(graph, nullptr);
+  EXPECT_TRUE(map_.hasCovisibilityGraph());
+  EXPECT_EQ(graph->numVertices(), vertex_ids_.size());
+  expectGraphMatchesObservations();
+  // Later queries reuse the graph.
+  EXPECT_EQ(map_.getCovisibilityGraph(), graph);
+}
+
+TEST_F(CovisibilityGraphTest, MergingVerticesUpdatesGraph) {
+  map_.getCovisibilityGraph();
+
+  const MissionId mission_id = map_.getVertex(vertex_ids_[0]).getMissionId();
+  const pose_graph::VertexId root_vertex_id =
+      map_.getMission(mission_id).getRootVertexId();
+  constexpr size_t kNumMergedVertices = 3u;
+  for (size_t i = 0u; i < kNumMergedVertices; ++i) {
+    pose_graph::VertexId next_vertex_id;
+    ASSERT_TRUE(
+        map_.getNextVertex(
+            root_vertex_id, map_.getGraphTraversalEdgeType(mission_id),
+            &next_vertex_id));
+    map_.mergeNeighboringVertices(root_vertex_id, next_vertex_id);
+  }
+  map_.getAllVertexIds(&vertex_ids_);
+  ASSERT_EQ(vertex_ids_.size(), kNumVertices - kNumMergedVertices);
+  expectGraphMatchesObservations();
+}
+
+TEST_F(CovisibilityGraphTest, IncrementalUpdatesMatchObservations) {
+  map_.buildCovisibilityGraph();
+
+  LandmarkIdList landmark_ids;
+  map_.getAllLandmarkIds(&landmark_ids);
+  ASSERT_GT(landmark_ids.size(), 6u);
+
+  // Merge and remove a few landmarks.
+  for (size_t i = 0u; i + 1u < landmark_ids.size() / 2u; i += 4u) {
+    map_.mergeLandmarks(landmark_ids[i], landmark_ids[i + 1u]);
+  }
+  for (size_t i = 2u; i < landmark_ids.size(); i += 4u) {
+    map_.removeLandmark(landmark_ids[i]);
+  }
+  expectGraphMatchesObservations();
+
+  // A graph built from scratch must be identical to the updated one, also
+  // after folding the updates into the CSR arrays.
+  CovisibilityGraph rebuilt_graph;
+  constexpr size_t kNumThreads = 4u;
+  rebuilt_graph.build(map_, vertex_ids_, kNumThreads);
+  CovisibilityGraph compacted_graph = *map_.getCovisibilityGraph();
+  compacted_graph.compact();
+  EXPECT_EQ(
+      rebuilt_graph.numEntries(), map_.getCovisibilityGraph()->numEntries());
+  EXPECT_EQ(rebuilt_graph.numEntries(), compacted_graph.numEntries());
+  for (const pose_graph::VertexId& vertex_id_a : vertex_ids_) {
+    for (const pose_graph::VertexId& vertex_id_b : vertex_ids_) {
+      EXPECT_EQ(
+          rebuilt_graph.getWeight(vertex_id_a, vertex_id_b),
+          compacted_graph.getWeight(vertex_id_a, vertex_id_b));
+    }
+  }
+}
+
+TEST_F(CovisibilityGraphTest, MissionSelectionDropsGraph) {
+  map_.buildCovisibilityGraph();
+  ASSERT_TRUE(map_.hasCovisibilityGraph());
+  map_.resetMissionSelection();
+  EXPECT_FALSE(map_.hasCovisibilityGraph());
+}
+
+}  // namespace vi_map
+
+MAPLAB_UNITTEST_ENTRYPOINT
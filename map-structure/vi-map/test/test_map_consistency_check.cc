@@ -417,6 +417,62 @@ TEST_F(MapConsistencyCheckTest, mapInconsistentMissingBackLink) {
   EXPECT_FALSE(vi_map::checkMapConsistency(map_));
 }
 
+TEST_F(MapConsistencyCheckTest, mapInconsistentMissingBackLinkInParallel) {
+  vi_map::Vertex& vertex0 = map_.getVertex(vertex_ids_mission_1_[2]);
+  vi_map::LandmarkId landmark_id;
+  generateId(&landmark_id);
+  vi_map::Landmark landmark;
+  landmark.setId(landmark_id);
+  vertex0.getLandmarks().addLandmark(landmark);
+  addLandmarkAndVertexReference(landmark_id, vertex_ids_mission_1_[2]);
+  const unsigned int keypoint_index =
+      vertex0.numValidObservedLandmarkIds(kVisualFrameIndex);
+  vertex0.setObservedLandmarkId(kVisualFrameIndex, keypoint_index, landmark_id);
+
+  constexpr size_t kSingleThread = 1u;
+  constexpr size_t kNumThreads = 4u;
+  EXPECT_FALSE(vi_map::checkMapConsistency(map_, kSingleThread));
+  EXPECT_FALSE(vi_map::checkMapConsistency(map_, kNumThreads));
+}
+
+TEST_F(MapConsistencyCheckTest, mapConsistencyDuplicateLandmarkObservations) {
+  const pose_graph::VertexId& vertex_id = vertex_ids_mission_1_[1];
+  vi_map::Vertex& vertex = map_.getVertex(vertex_id);
+  aslam::VisualFrame& frame = vertex.getVisualFrame(kVisualFrameIndex);
+  Eigen::Matrix2Xd keypoints =
+      Eigen::Matrix2Xd::Zero(2, kNumOfKeypointsPerVertex);
+  frame.setKeypointMeasurements(keypoints);
+
+  // Observe the first landmark of the vertex a second time from an unused
+  // keypoint.
+  vi_map::LandmarkStore& landmark_store = vertex.getLandmarks();
+  ASSERT_GT(landmark_store.size(), 0);
+  vi_map::Landmark& landmark = *landmark_store.begin();
+  const KeypointIdentifier& first_observation =
+      landmark.getObservations().front();
+  ASSERT_EQ(first_observation.frame_id.vertex_id, vertex_id);
+  const size_t first_keypoint_index = first_observation.keypoint_index;
+  const size_t second_keypoint_index = kNumOfKeypointsPerVertex - 1u;
+  ASSERT_FALSE(
+      vertex.getObservedLandmarkId(kVisualFrameIndex, second_keypoint_index)
+          .isValid());
+  vertex.setObservedLandmarkId(
+      kVisualFrameIndex, second_keypoint_index, landmark.id());
+  landmark.addObservation(
+      vertex_id, kVisualFrameIndex, second_keypoint_index);
+
+  constexpr size_t kNumThreads = 4u;
+  keypoints.col(second_keypoint_index) =
+      keypoints.col(first_keypoint_index) + Eigen::Vector2d(1.0, 0.0);
+  frame.setKeypointMeasurements(keypoints);
+  EXPECT_TRUE(vi_map::checkMapConsistency(map_, kNumThreads));
+
+  keypoints.col(second_keypoint_index) =
+      keypoints.col(first_keypoint_index) + Eigen::Vector2d(100.0, 0.0);
+  frame.setKeypointMeasurements(keypoints);
+  EXPECT_FALSE(vi_map::checkMapConsistency(map_, kNumThreads));
+}
+
 TEST_F(MapConsistencyCheckTest, mapInconsistentPosegraphInvalidEdge) {
   addInvalidEdge();
   EXPECT_FALSE(vi_map::checkMapConsistency(map_));
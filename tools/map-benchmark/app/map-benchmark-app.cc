@@ -0,0 +1,58 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <maplab-common/string-tools.h>
+
+#include "map-benchmark/benchmark-suite.h"
+#include "map-benchmark/synthetic-map-generator.h"
+
+DEFINE_string(
+    map_benchmark_stages, "all",
+    "Comma-separated list of the benchmark stages to run after generating the "
+    "map, or 'all'. Available stages: generate, save, load, "
+    "landmark_iteration, retriangulation, loop_closure, summary_map, "
+    "ba_construction, ba_solve, consistency_check.");
+DEFINE_string(
+    map_benchmark_output_json, "",
+    "File to which the benchmark results are written as JSON; if empty they "
+    "are written to stdout.");
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InstallFailureSignalHandler();
+  FLAGS_alsologtostderr = true;
+  FLAGS_colorlogtostderr = true;
+
+  std::vector<std::string> stage_names;
+  if (FLAGS_map_benchmark_stages != "all") {
+    constexpr bool kRemoveEmpty = true;
+    common::tokenizeString(
+        FLAGS_map_benchmark_stages, ',', kRemoveEmpty, &stage_names);
+    CHECK(!stage_names.empty()) << "No benchmark stages given.";
+  }
+
+  map_benchmark::BenchmarkSuite benchmark_suite(
+      map_benchmark::SyntheticMapOptions::initFromGFlags());
+  benchmark_suite.run(stage_names);
+
+  if (FLAGS_map_benchmark_output_json.empty()) {
+    benchmark_suite.writeJson(&std::cout);
+  } else {
+    std::ofstream output(FLAGS_map_benchmark_output_json);
+    CHECK(output.is_open()) << "Failed to open "
+                            << FLAGS_map_benchmark_output_json << ".";
+    benchmark_suite.writeJson(&output);
+  }
+
+  bool success = true;
+  for (const map_benchmark::BenchmarkStageResult& result :
+       benchmark_suite.getResults()) {
+    success &= result.success;
+  }
+  return success ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+#ifndef MAP_BENCHMARK_BENCHMARK_SUITE_H_
+#define MAP_BENCHMARK_BENCHMARK_SUITE_H_
+
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "map-benchmark/synthetic-map-generator.h"
+
+namespace map_optimization {
+class OptimizationProblem;
+}  // namespace map_optimization
+
+namespace vi_map {
+class VIMap;
+}  // namespace vi_map
+
+namespace map_benchmark {
+
+struct BenchmarkStageResult {
+  std::string name;
+  bool success;
+  double wall_time_seconds;
+  // Number of processed items, e.g. vertices or landmarks, the throughput is
+  // reported in items per second.
+  size_t num_items;
+  std::string item_type;
+  // Peak resident set size while the stage was running. This is the peak of
+  // the whole process up to the end of the stage if the kernel doesn't
+  // support resetting it.
+  size_t peak_resident_set_size_bytes;
+};
+
+// Generates a synthetic map and runs a fixed sequence of map processing stages
+// on it, measuring the wall time, the throughput and the peak memory usage of
+// every stage. The stages run in the order in which they are listed by
+// getStageNames(), later stages work on the map as left by the earlier ones.
+class BenchmarkSuite {
+ public:
+  explicit BenchmarkSuite(const SyntheticMapOptions& options);
+  ~BenchmarkSuite();
+
+  static const std::vector<std::string>& getStageNames();
+
+  // Runs the map generation followed by the given stages. An empty list runs
+  // all stages.
+  void run(const std::vector<std::string>& stage_names);
+
+  const std::vector<BenchmarkStageResult>& getResults() const {
+    return results_;
+  }
+
+  void writeJson(std::ostream* out) const;
+
+ private:
+  typedef std::function<bool(size_t* num_items)> StageFunction;
+  void runStage(
+      const std::string& name, const std::string& item_type,
+      const StageFunction& stage);
+
+  bool generate(size_t* num_vertices);
+  bool save(size_t* num_vertices);
+  bool load(size_t* num_vertices);
+  bool iterateLandmarks(size_t* num_landmarks);
+  bool retriangulate(size_t* num_landmarks);
+  bool detectLoopClosures(size_t* num_query_vertices);
+  bool createSummaryMap(size_t* num_landmarks);
+  bool constructBundleAdjustment(size_t* num_vertices);
+  bool solveBundleAdjustment(size_t* num_vertices);
+  bool checkConsistency(size_t* num_vertices);
+
+  const SyntheticMapOptions options_;
+  const std::string map_folder_;
+  SyntheticMapGenerator generator_;
+  std::unique_ptr<vi_map::VIMap> map_;
+  std::unique_ptr<map_optimization::OptimizationProblem> ba_problem_;
+  std::vector<BenchmarkStageResult> results_;
+  bool is_peak_resident_set_size_per_stage_;
+};
+
+}  // namespace map_benchmark
+
+#endif  // MAP_BENCHMARK_BENCHMARK_SUITE_H_
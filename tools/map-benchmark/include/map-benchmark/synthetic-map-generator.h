@@ -0,0 +1,86 @@
+#ifndef MAP_BENCHMARK_SYNTHETIC_MAP_GENERATOR_H_
+#define MAP_BENCHMARK_SYNTHETIC_MAP_GENERATOR_H_
+
+#include <cstdint>
+#include <random>
+
+#include <Eigen/Core>
+#include <aslam/cameras/ncamera.h>
+#include <aslam/common/pose-types.h>
+#include <aslam/frames/visual-frame.h>
+#include <vi-map/unique-id.h>
+
+namespace vi_map {
+class VIMap;
+}  // namespace vi_map
+
+namespace map_benchmark {
+
+struct SyntheticMapOptions {
+  static SyntheticMapOptions initFromGFlags();
+
+  size_t num_missions;
+  size_t num_vertices_per_mission;
+  // Number of landmarks every vertex observes.
+  size_t num_observations_per_vertex;
+  // Number of consecutive vertices of a mission that observe a landmark.
+  size_t landmark_track_length;
+  // Fraction of the path of a mission that is also traversed by the next
+  // mission. The missions observe the same scene there, which is what loop
+  // closure and the multi-mission stages work on.
+  double mission_overlap;
+  double vertex_spacing_meters;
+  double speed_meters_per_second;
+  double imu_rate_hz;
+  double keypoint_noise_pixels;
+  int descriptor_noise_bits;
+  double vertex_position_noise_meters;
+  uint64_t seed;
+
+ protected:
+  SyntheticMapOptions() = default;
+};
+
+// Procedurally generates multi-mission VI maps of arbitrary size. The missions
+// drive along a straight road through a scene of landmarks with a single
+// forward-looking camera and constant velocity. The scene is a deterministic
+// function of the landmark index, such that overlapping missions observe the
+// same landmarks with the same descriptors up to noise, and the map is built
+// vertex by vertex without keeping more than one landmark track window per
+// mission in memory.
+class SyntheticMapGenerator {
+ public:
+  explicit SyntheticMapGenerator(const SyntheticMapOptions& options);
+
+  // Adds the missions to the given map, which has to be empty.
+  void generateMap(vi_map::VIMap* map);
+
+  size_t getNumObservations() const {
+    return num_observations_;
+  }
+
+ private:
+  void generateMission(
+      const size_t mission_index, const vi_map::SensorId& imu_sensor_id,
+      vi_map::VIMap* map);
+
+  // Position and descriptor of the landmark with the given index along the
+  // road.
+  void getScenePoint(
+      const int64_t point_index, Eigen::Vector3d* p_G_fi,
+      aslam::VisualFrame::DescriptorsT* descriptor) const;
+
+  const SyntheticMapOptions options_;
+  const double point_spacing_meters_;
+  const double min_point_depth_meters_;
+  aslam::NCamera::Ptr n_camera_;
+  // Rotation of the body (and camera) frame w.r.t. the global frame, the
+  // camera looks along the road.
+  Eigen::Matrix3d R_G_I_;
+  std::mt19937_64 random_engine_;
+  size_t num_observations_;
+};
+
+}  // namespace map_benchmark
+
+#endif  // MAP_BENCHMARK_SYNTHETIC_MAP_GENERATOR_H_
@@ -0,0 +1,392 @@
+#include "map-benchmark/benchmark-suite.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/pose-types.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <landmark-triangulation/landmark-triangulation.h>
+#include <localization-summary-map/localization-summary-map-creation.h>
+#include <localization-summary-map/localization-summary-map.h>
+#include <loop-closure-handler/loop-detector-node.h>
+#include <map-optimization/optimization-problem.h>
+#include <map-optimization/solver-options.h>
+#include <map-optimization/solver.h>
+#include <map-optimization/vi-optimization-builder.h>
+#include <maplab-common/map-manager-config.h>
+#include <sys/resource.h>
+#include <vi-map/check-map-consistency.h>
+#include <vi-map/loop-constraint.h>
+#include <vi-map/vi-map-serialization.h>
+#include <vi-map/vi-map.h>
+
+DEFINE_string(
+    map_benchmark_map_folder, "/tmp/map_benchmark_map",
+    "Folder to which the save stage of the map benchmark writes the map. Any "
+    "existing map in this folder is overwritten.");
+
+namespace map_benchmark {
+
+namespace {
+const char kGenerateStage[] = "generate";
+const char kSaveStage[] = "save";
+const char kLoadStage[] = "load";
+const char kLandmarkIterationStage[] = "landmark_iteration";
+const char kRetriangulationStage[] = "retriangulation";
+const char kLoopClosureStage[] = "loop_closure";
+const char kSummaryMapStage[] = "summary_map";
+const char kBundleAdjustmentConstructionStage[] = "ba_construction";
+const char kBundleAdjustmentSolveStage[] = "ba_solve";
+const char kConsistencyCheckStage[] = "consistency_check";
+
+// Resets the peak resident set size of the process to the current resident
+// set size. Only supported by Linux kernels >= 4.0.
+bool resetPeakResidentSetSize() {
+  std::ofstream clear_refs("/proc/self/clear_refs");
+  if (!clear_refs.is_open()) {
+    return false;
+  }
+  clear_refs << "5";
+  clear_refs.close();
+  return !clear_refs.fail();
+}
+
+size_t getPeakResidentSetSizeBytes() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, 6, "VmHWM:") == 0) {
+      return std::stoull(line.substr(6)) * 1024u;
+    }
+  }
+  // ru_maxrss can't be reset and is given in kilobytes.
+  struct rusage usage;
+  CHECK_EQ(getrusage(RUSAGE_SELF, &usage), 0);
+  return static_cast<size_t>(usage.ru_maxrss) * 1024u;
+}
+}  // namespace
+
+BenchmarkSuite::BenchmarkSuite(const SyntheticMapOptions& options)
+    : options_(options),
+      map_folder_(FLAGS_map_benchmark_map_folder),
+      generator_(options),
+      is_peak_resident_set_size_per_stage_(false) {
+  CHECK(!map_folder_.empty());
+}
+
+BenchmarkSuite::~BenchmarkSuite() {}
+
+const std::vector<std::string>& BenchmarkSuite::getStageNames() {
+  static const std::vector<std::string> kStageNames = {
+      kGenerateStage,
+      kSaveStage,
+      kLoadStage,
+      kLandmarkIterationStage,
+      kRetriangulationStage,
+      kLoopClosureStage,
+      kSummaryMapStage,
+      kBundleAdjustmentConstructionStage,
+      kBundleAdjustmentSolveStage,
+      kConsistencyCheckStage};
+  return kStageNames;
+}
+
+void BenchmarkSuite::run(const std::vector<std::string>& stage_names) {
+  const std::vector<std::string>& all_stage_names = getStageNames();
+  for (const std::string& stage_name : stage_names) {
+    CHECK(
+        std::find(
+            all_stage_names.begin(), all_stage_names.end(), stage_name) !=
+        all_stage_names.end())
+        << "Unknown benchmark stage: " << stage_name;
+  }
+  auto is_selected = [&stage_names](const std::string& stage_name) {
+    return stage_names.empty() ||
+           std::find(stage_names.begin(), stage_names.end(), stage_name) !=
+               stage_names.end();
+  };
+
+  results_.clear();
+  map_.reset(new vi_map::VIMap);
+  ba_problem_.reset();
+  is_peak_resident_set_size_per_stage_ = resetPeakResidentSetSize();
+  LOG_IF(WARNING, !is_peak_resident_set_size_per_stage_)
+      << "The peak resident set size can't be reset, the reported peak memory "
+      << "usage of a stage includes all previous stages.";
+
+  // All other stages need the map.
+  runStage(kGenerateStage, "vertices", [this](size_t* num_items) {
+    return generate(num_items);
+  });
+
+  if (is_selected(kSaveStage)) {
+    runStage(kSaveStage, "vertices", [this](size_t* num_items) {
+      return save(num_items);
+    });
+  }
+  if (is_selected(kLoadStage)) {
+    runStage(kLoadStage, "vertices", [this](size_t* num_items) {
+      return load(num_items);
+    });
+  }
+  if (is_selected(kLandmarkIterationStage)) {
+    runStage(kLandmarkIterationStage, "landmarks", [this](size_t* num_items) {
+      return iterateLandmarks(num_items);
+    });
+  }
+  if (is_selected(kRetriangulationStage)) {
+    runStage(kRetriangulationStage, "landmarks", [this](size_t* num_items) {
+      return retriangulate(num_items);
+    });
+  }
+  if (is_selected(kLoopClosureStage)) {
+    runStage(kLoopClosureStage, "query vertices", [this](size_t* num_items) {
+      return detectLoopClosures(num_items);
+    });
+  }
+  if (is_selected(kSummaryMapStage)) {
+    runStage(kSummaryMapStage, "landmarks", [this](size_t* num_items) {
+      return createSummaryMap(num_items);
+    });
+  }
+  if (is_selected(kBundleAdjustmentConstructionStage)) {
+    runStage(
+        kBundleAdjustmentConstructionStage, "vertices",
+        [this](size_t* num_items) {
+          return constructBundleAdjustment(num_items);
+        });
+  }
+  if (is_selected(kBundleAdjustmentSolveStage)) {
+    if (!ba_problem_) {
+      // The solve stage only measures the optimization itself.
+      size_t num_vertices;
+      constructBundleAdjustment(&num_vertices);
+    }
+    runStage(
+        kBundleAdjustmentSolveStage, "vertices", [this](size_t* num_items) {
+          return solveBundleAdjustment(num_items);
+        });
+  }
+  ba_problem_.reset();
+  if (is_selected(kConsistencyCheckStage)) {
+    runStage(kConsistencyCheckStage, "vertices", [this](size_t* num_items) {
+      return checkConsistency(num_items);
+    });
+  }
+}
+
+void BenchmarkSuite::runStage(
+    const std::string& name, const std::string& item_type,
+    const StageFunction& stage) {
+  CHECK(stage);
+  VLOG(1) << "Running benchmark stage " << name << ".";
+  if (is_peak_resident_set_size_per_stage_) {
+    resetPeakResidentSetSize();
+  }
+
+  BenchmarkStageResult result;
+  result.name = name;
+  result.item_type = item_type;
+  result.num_items = 0u;
+  const std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  result.success = stage(&result.num_items);
+  result.wall_time_seconds = std::chrono::duration<double>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count();
+  result.peak_resident_set_size_bytes = getPeakResidentSetSizeBytes();
+
+  LOG_IF(ERROR, !result.success) << "Benchmark stage " << name << " failed.";
+  LOG(INFO) << "Benchmark stage " << name << ": " << result.wall_time_seconds
+            << " s for " << result.num_items << ' ' << item_type
+            << ", peak RSS "
+            << result.peak_resident_set_size_bytes / (1024u * 1024u)
+            << " MiB.";
+  results_.push_back(result);
+}
+
+bool BenchmarkSuite::generate(size_t* num_vertices) {
+  CHECK_NOTNULL(num_vertices);
+  CHECK(map_);
+  generator_.generateMap(map_.get());
+  *num_vertices = map_->numVertices();
+  return true;
+}
+
+bool BenchmarkSuite::save(size_t* num_vertices) {
+  CHECK_NOTNULL(num_vertices);
+  CHECK(map_);
+  backend::SaveConfig save_config;
+  save_config.overwrite_existing_files = true;
+  *num_vertices = map_->numVertices();
+  return vi_map::serialization::saveMapToFolder(
+      map_folder_, save_config, map_.get());
+}
+
+bool BenchmarkSuite::load(size_t* num_vertices) {
+  CHECK_NOTNULL(num_vertices);
+  // The loaded map replaces the generated one, such that the following stages
+  // run on a map as it is used in practice. Both maps are in memory while
+  // loading.
+  std::unique_ptr<vi_map::VIMap> loaded_map(new vi_map::VIMap);
+  if (!vi_map::serialization::loadMapFromFolder(
+          map_folder_, loaded_map.get())) {
+    return false;
+  }
+  *num_vertices = loaded_map->numVertices();
+  map_.swap(loaded_map);
+  return true;
+}
+
+bool BenchmarkSuite::iterateLandmarks(size_t* num_landmarks) {
+  CHECK_NOTNULL(num_landmarks);
+  CHECK(map_);
+  // Computes the global landmark positions, which is the most common access
+  // pattern of the map processing algorithms.
+  size_t num_observations = 0u;
+  Eigen::Vector3d p_G_sum = Eigen::Vector3d::Zero();
+  *num_landmarks = 0u;
+  map_->forEachLandmark(
+      [&](const vi_map::LandmarkId& landmark_id,
+          const vi_map::Landmark& landmark,
+          const vi_map::Vertex& /*storing_vertex*/,
+          const vi_map::MissionBaseFrame& /*mission_base_frame*/,
+          size_t /*landmark_counter*/) {
+        num_observations += landmark.numberOfObservations();
+        p_G_sum += map_->getLandmark_G_p_fi(landmark_id);
+        ++(*num_landmarks);
+      });
+  if (*num_landmarks > 0u) {
+    VLOG(2) << "Visited " << num_observations << " observations, mean "
+            << "landmark position: " << (p_G_sum / *num_landmarks).transpose();
+  }
+  return num_observations == generator_.getNumObservations();
+}
+
+bool BenchmarkSuite::retriangulate(size_t* num_landmarks) {
+  CHECK_NOTNULL(num_landmarks);
+  CHECK(map_);
+  *num_landmarks = map_->numLandmarks();
+  return landmark_triangulation::retriangulateLandmarks(map_.get());
+}
+
+bool BenchmarkSuite::detectLoopClosures(size_t* num_query_vertices) {
+  CHECK_NOTNULL(num_query_vertices);
+  CHECK(map_);
+  // The first mission is the database, the others are queried against it
+  // without modifying the map. Building the database is part of the stage.
+  vi_map::MissionIdList mission_ids;
+  map_->getAllMissionIdsSortedByTimestamp(&mission_ids);
+  *num_query_vertices = 0u;
+  if (mission_ids.size() < 2u) {
+    return false;
+  }
+  loop_detector_node::LoopDetectorNode loop_detector;
+  loop_detector.addMissionToDatabase(mission_ids.front(), *map_);
+
+  constexpr bool kMergeLandmarks = false;
+  constexpr bool kAddLoopClosureEdges = false;
+  for (size_t mission_idx = 1u; mission_idx < mission_ids.size();
+       ++mission_idx) {
+    const vi_map::MissionId& mission_id = mission_ids[mission_idx];
+    int num_vertex_candidate_links;
+    double summary_landmark_match_inlier_ratio;
+    pose::Transformation T_G_M_estimate;
+    vi_map::LoopClosureConstraintVector inlier_constraints;
+    loop_detector.detectLoopClosuresMissionToDatabase(
+        mission_id, kMergeLandmarks, kAddLoopClosureEdges,
+        &num_vertex_candidate_links, &summary_landmark_match_inlier_ratio,
+        map_.get(), &T_G_M_estimate, &inlier_constraints);
+    VLOG(2) << "Mission " << mission_id << ": " << inlier_constraints.size()
+            << " inlier loop closures.";
+
+    pose_graph::VertexIdList vertex_ids;
+    map_->getAllVertexIdsInMission(mission_id, &vertex_ids);
+    *num_query_vertices += vertex_ids.size();
+  }
+  return true;
+}
+
+bool BenchmarkSuite::createSummaryMap(size_t* num_landmarks) {
+  CHECK_NOTNULL(num_landmarks);
+  CHECK(map_);
+  summary_map::LocalizationSummaryMap summary_map;
+  summary_map::createLocalizationSummaryMapForWellConstrainedLandmarks(
+      *map_, &summary_map);
+  *num_landmarks = summary_map.GLandmarkPosition().cols();
+  return *num_landmarks > 0u;
+}
+
+bool BenchmarkSuite::constructBundleAdjustment(size_t* num_vertices) {
+  CHECK_NOTNULL(num_vertices);
+  CHECK(map_);
+  vi_map::MissionIdSet mission_ids;
+  map_->getAllMissionIds(&mission_ids);
+  map_optimization::ViProblemOptions options =
+      map_optimization::ViProblemOptions::initFromGFlags();
+  options.add_inertial_constraints = true;
+  options.add_visual_constraints = true;
+  ba_problem_.reset(
+      map_optimization::constructViProblem(mission_ids, options, map_.get()));
+  *num_vertices = map_->numVertices();
+  return ba_problem_ != nullptr;
+}
+
+bool BenchmarkSuite::solveBundleAdjustment(size_t* num_vertices) {
+  CHECK_NOTNULL(num_vertices);
+  CHECK(map_);
+  CHECK(ba_problem_);
+  // The number of iterations is given by --ba_num_iterations.
+  ceres::Solver::Options solver_options =
+      map_optimization::initSolverOptionsFromFlags();
+  solver_options.minimizer_progress_to_stdout = false;
+  const ceres::TerminationType termination_type =
+      map_optimization::solve(solver_options, ba_problem_.get());
+  *num_vertices = map_->numVertices();
+  return termination_type != ceres::FAILURE;
+}
+
+bool BenchmarkSuite::checkConsistency(size_t* num_vertices) {
+  CHECK_NOTNULL(num_vertices);
+  CHECK(map_);
+  *num_vertices = map_->numVertices();
+  return vi_map::checkMapConsistency(*map_);
+}
+
+void BenchmarkSuite::writeJson(std::ostream* out) const {
+  CHECK_NOTNULL(out);
+  CHECK(map_);
+  // Stage names and item types are fixed identifiers, no escaping needed.
+  *out << "{\n  \"map\": {\"num_missions\": " << map_->numMissions()
+       << ", \"num_vertices\": " << map_->numVertices()
+       << ", \"num_landmarks\": " << map_->numLandmarks()
+       << ", \"num_observations\": " << generator_.getNumObservations()
+       << ", \"seed\": " << options_.seed << "},\n"
+       << "  \"peak_rss_per_stage\": "
+       << (is_peak_resident_set_size_per_stage_ ? "true" : "false") << ",\n"
+       << "  \"stages\": [";
+  for (size_t result_idx = 0u; result_idx < results_.size(); ++result_idx) {
+    const BenchmarkStageResult& result = results_[result_idx];
+    const double items_per_second =
+        result.wall_time_seconds > 0.0
+            ? result.num_items / result.wall_time_seconds
+            : 0.0;
+    *out << (result_idx == 0u ? "\n" : ",\n") << "    {\"name\": \""
+         << result.name << "\", \"success\": "
+         << (result.success ? "true" : "false")
+         << ", \"wall_time_s\": " << result.wall_time_seconds
+         << ", \"num_items\": " << result.num_items << ", \"item_type\": \""
+         << result.item_type << "\", \"items_per_s\": " << items_per_second
+         << ", \"peak_rss_bytes\": " << result.peak_resident_set_size_bytes
+         << "}";
+  }
+  *out << "\n  ]\n}\n";
+}
+
+}  // namespace map_benchmark
@@ -0,0 +1,370 @@
+#include "map-benchmark/synthetic-map-generator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/common/memory.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <maplab-common/unique-id.h>
+#include <sensors/imu.h>
+#include <vi-map/landmark.h>
+#include <vi-map/vertex.h>
+#include <vi-map/vi-map.h>
+#include <vi-map/viwls-edge.h>
+
+DEFINE_uint64(
+    map_benchmark_num_missions, 4u,
+    "Number of missions of the synthetic benchmark map.");
+DEFINE_uint64(
+    map_benchmark_num_vertices_per_mission, 1000u,
+    "Number of vertices of every mission of the synthetic benchmark map.");
+DEFINE_uint64(
+    map_benchmark_num_observations_per_vertex, 100u,
+    "Number of landmarks observed by every vertex of the synthetic benchmark "
+    "map.");
+DEFINE_uint64(
+    map_benchmark_landmark_track_length, 10u,
+    "Number of consecutive vertices of a mission that observe a landmark of "
+    "the synthetic benchmark map.");
+DEFINE_double(
+    map_benchmark_mission_overlap, 0.5,
+    "Fraction of the path of a mission that is traversed again by the next "
+    "mission of the synthetic benchmark map.");
+DEFINE_double(
+    map_benchmark_vertex_spacing_m, 0.5,
+    "Distance between consecutive vertices of the synthetic benchmark map.");
+DEFINE_double(
+    map_benchmark_speed_m_per_s, 1.0,
+    "Speed of the missions of the synthetic benchmark map.");
+DEFINE_double(
+    map_benchmark_imu_rate_hz, 20.0,
+    "Rate of the IMU measurements stored in the edges of the synthetic "
+    "benchmark map.");
+DEFINE_double(
+    map_benchmark_keypoint_noise_px, 0.8,
+    "Standard deviation of the keypoint noise of the synthetic benchmark map.");
+DEFINE_int32(
+    map_benchmark_descriptor_noise_bits, 10,
+    "Number of flipped bits per observed descriptor of the synthetic benchmark "
+    "map.");
+DEFINE_double(
+    map_benchmark_vertex_position_noise_m, 0.02,
+    "Standard deviation of the noise added to the vertex positions of the "
+    "synthetic benchmark map.");
+DEFINE_uint64(
+    map_benchmark_seed, 42u, "Seed of the synthetic benchmark map generator.");
+
+namespace map_benchmark {
+
+namespace {
+constexpr int kDescriptorSizeBytes = 48;
+constexpr uint32_t kImageWidth = 640u;
+constexpr uint32_t kImageHeight = 480u;
+constexpr double kFocalLengthPixels = 320.0;
+constexpr double kMinPointDepthMeters = 3.0;
+// Landmarks stay within this fraction of the field of view.
+constexpr double kFieldOfViewMargin = 0.8;
+constexpr double kGravityMagnitude = 9.81;
+// Missions are recorded on different days.
+constexpr int64_t kMissionTimeOffsetNanoseconds = 86400ll * 1000000000ll;
+
+// Counter-based random numbers, the scene must not depend on the order in
+// which it is generated.
+inline uint64_t splitMix64(uint64_t value) {
+  value += 0x9e3779b97f4a7c15ull;
+  value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+  value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+  return value ^ (value >> 31);
+}
+
+inline double toUnitInterval(const uint64_t value) {
+  return static_cast<double>(value >> 11) * (1.0 / 9007199254740992.0);
+}
+}  // namespace
+
+SyntheticMapOptions SyntheticMapOptions::initFromGFlags() {
+  SyntheticMapOptions options;
+  options.num_missions = FLAGS_map_benchmark_num_missions;
+  options.num_vertices_per_mission =
+      FLAGS_map_benchmark_num_vertices_per_mission;
+  options.num_observations_per_vertex =
+      FLAGS_map_benchmark_num_observations_per_vertex;
+  options.landmark_track_length = FLAGS_map_benchmark_landmark_track_length;
+  options.mission_overlap = FLAGS_map_benchmark_mission_overlap;
+  options.vertex_spacing_meters = FLAGS_map_benchmark_vertex_spacing_m;
+  options.speed_meters_per_second = FLAGS_map_benchmark_speed_m_per_s;
+  options.imu_rate_hz = FLAGS_map_benchmark_imu_rate_hz;
+  options.keypoint_noise_pixels = FLAGS_map_benchmark_keypoint_noise_px;
+  options.descriptor_noise_bits = FLAGS_map_benchmark_descriptor_noise_bits;
+  options.vertex_position_noise_meters =
+      FLAGS_map_benchmark_vertex_position_noise_m;
+  options.seed = FLAGS_map_benchmark_seed;
+  return options;
+}
+
+SyntheticMapGenerator::SyntheticMapGenerator(
+    const SyntheticMapOptions& options)
+    : options_(options),
+      point_spacing_meters_(
+          options.vertex_spacing_meters * options.landmark_track_length /
+          options.num_observations_per_vertex),
+      min_point_depth_meters_(kMinPointDepthMeters),
+      random_engine_(options.seed),
+      num_observations_(0u) {
+  CHECK_GT(options_.num_missions, 0u);
+  CHECK_GT(options_.num_vertices_per_mission, 1u);
+  CHECK_GT(options_.num_observations_per_vertex, 0u);
+  CHECK_GT(options_.landmark_track_length, 0u);
+  CHECK_GE(options_.mission_overlap, 0.0);
+  CHECK_LT(options_.mission_overlap, 1.0);
+  CHECK_GT(options_.vertex_spacing_meters, 0.0);
+  CHECK_GT(options_.speed_meters_per_second, 0.0);
+  CHECK_GT(options_.imu_rate_hz, 0.0);
+  CHECK_GT(options_.keypoint_noise_pixels, 0.0);
+  CHECK_GE(options_.descriptor_noise_bits, 0);
+  CHECK_GE(options_.vertex_position_noise_meters, 0.0);
+
+  Eigen::VectorXd intrinsics(4);
+  intrinsics << kFocalLengthPixels, kFocalLengthPixels, 0.5 * kImageWidth,
+      0.5 * kImageHeight;
+  aslam::Camera::Ptr camera = std::shared_ptr<aslam::PinholeCamera>(
+      new aslam::PinholeCamera(intrinsics, kImageWidth, kImageHeight));
+  aslam::CameraId camera_id;
+  common::generateId(&camera_id);
+  camera->setId(camera_id);
+  aslam::NCameraId n_camera_id;
+  common::generateId(&n_camera_id);
+  n_camera_.reset(
+      new aslam::NCamera(
+          n_camera_id, aslam::TransformationVector(1u), {camera},
+          "Synthetic benchmark camera"));
+
+  // The camera z-axis points along the road (global x-axis), the camera
+  // y-axis points down.
+  R_G_I_ << 0.0, 0.0, 1.0, -1.0, 0.0, 0.0, 0.0, -1.0, 0.0;
+}
+
+void SyntheticMapGenerator::generateMap(vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  CHECK_EQ(map->numMissions(), 0u);
+
+  vi_map::SensorId imu_sensor_id;
+  common::generateId(&imu_sensor_id);
+  vi_map::Imu::UniquePtr imu_sensor =
+      aligned_unique<vi_map::Imu>(imu_sensor_id, std::string("imu0"));
+  imu_sensor->setImuSigmas(vi_map::ImuSigmas(1e-3, 1e-4, 1e-2, 1e-3));
+  map->getSensorManager().addSensor(std::move(imu_sensor));
+
+  num_observations_ = 0u;
+  for (size_t mission_idx = 0u; mission_idx < options_.num_missions;
+       ++mission_idx) {
+    generateMission(mission_idx, imu_sensor_id, map);
+  }
+}
+
+void SyntheticMapGenerator::generateMission(
+    const size_t mission_index, const vi_map::SensorId& imu_sensor_id,
+    vi_map::VIMap* map) {
+  CHECK_NOTNULL(map);
+  vi_map::MissionId mission_id;
+  common::generateId(&mission_id);
+  // The baseframes coincide with the global frame.
+  map->addNewMissionWithBaseframe(
+      mission_id, pose::Transformation(), Eigen::Matrix<double, 6, 6>::Zero(),
+      n_camera_, vi_map::Mission::BackBone::kViwls);
+  map->getSensorManager().associateExistingSensorWithMission(
+      imu_sensor_id, mission_id);
+
+  const double track_window_meters =
+      options_.landmark_track_length * options_.vertex_spacing_meters;
+  const double mission_length_meters =
+      (options_.num_vertices_per_mission - 1u) *
+      options_.vertex_spacing_meters;
+  const double start_x_meters = mission_index *
+                                (1.0 - options_.mission_overlap) *
+                                mission_length_meters;
+  const double vertex_period_seconds =
+      options_.vertex_spacing_meters / options_.speed_meters_per_second;
+  const int64_t vertex_period_nanoseconds =
+      static_cast<int64_t>(std::llround(vertex_period_seconds * 1e9));
+  const int64_t start_timestamp_nanoseconds =
+      static_cast<int64_t>(mission_index + 1u) * kMissionTimeOffsetNanoseconds;
+  const int num_imu_measurements_per_edge = std::max(
+      2, static_cast<int>(std::lround(
+             vertex_period_seconds * options_.imu_rate_hz)) + 1);
+
+  // A constant velocity without rotation only leaves gravity in the IMU
+  // measurements.
+  Eigen::Matrix<double, 6, 1> imu_measurement;
+  imu_measurement.head<3>() =
+      R_G_I_.transpose() * Eigen::Vector3d(0.0, 0.0, kGravityMagnitude);
+  imu_measurement.tail<3>().setZero();
+  const Eigen::Matrix<double, 6, Eigen::Dynamic> imu_data =
+      imu_measurement.replicate(1, num_imu_measurements_per_edge);
+  const Eigen::Vector3d v_M(options_.speed_meters_per_second, 0.0, 0.0);
+  const Eigen::Quaterniond q_G_I(R_G_I_);
+
+  // Scaled afterwards, the noise levels may be zero.
+  std::normal_distribution<double> standard_normal(0.0, 1.0);
+  const double keypoint_sigma = options_.keypoint_noise_pixels;
+  const double position_sigma = options_.vertex_position_noise_meters;
+  std::uniform_int_distribution<int> bit_distribution(
+      0, kDescriptorSizeBytes * 8 - 1);
+  const aslam::Camera& camera = n_camera_->getCamera(0u);
+
+  // The landmarks of the scene points within the current track window.
+  std::unordered_map<int64_t, vi_map::LandmarkId> point_landmark_ids;
+  int64_t first_active_point_index = 0;
+  pose_graph::VertexId previous_vertex_id;
+  int64_t previous_timestamp_nanoseconds = 0;
+
+  Eigen::Vector3d p_G_fi;
+  aslam::VisualFrame::DescriptorsT descriptor;
+  std::vector<int64_t> observed_point_indices;
+  for (size_t vertex_idx = 0u; vertex_idx < options_.num_vertices_per_mission;
+       ++vertex_idx) {
+    const double x_meters =
+        start_x_meters + vertex_idx * options_.vertex_spacing_meters;
+    const pose::Transformation T_G_I_true(
+        q_G_I, Eigen::Vector3d(x_meters, 0.0, 0.0));
+    const pose::Transformation T_I_G_true = T_G_I_true.inverse();
+
+    const int64_t begin_point_index = static_cast<int64_t>(std::floor(
+                                          (x_meters + min_point_depth_meters_) /
+                                          point_spacing_meters_)) +
+                                      1;
+    const int64_t end_point_index = static_cast<int64_t>(std::floor(
+        (x_meters + min_point_depth_meters_ + track_window_meters) /
+        point_spacing_meters_));
+
+    observed_point_indices.clear();
+    Eigen::Matrix2Xd keypoints(2, end_point_index - begin_point_index + 1);
+    aslam::VisualFrame::DescriptorsT descriptors(
+        kDescriptorSizeBytes, end_point_index - begin_point_index + 1);
+    for (int64_t point_idx = begin_point_index; point_idx <= end_point_index;
+         ++point_idx) {
+      getScenePoint(point_idx, &p_G_fi, &descriptor);
+      Eigen::Vector2d keypoint;
+      if (!camera.project3(T_I_G_true * p_G_fi, &keypoint)
+               .isKeypointVisible()) {
+        continue;
+      }
+      const int keypoint_idx = observed_point_indices.size();
+      keypoints(0, keypoint_idx) =
+          keypoint(0) + keypoint_sigma * standard_normal(random_engine_);
+      keypoints(1, keypoint_idx) =
+          keypoint(1) + keypoint_sigma * standard_normal(random_engine_);
+      for (int i = 0; i < options_.descriptor_noise_bits; ++i) {
+        const int bit = bit_distribution(random_engine_);
+        descriptor(bit / 8, 0) ^= static_cast<unsigned char>(1u << (bit % 8));
+      }
+      descriptors.col(keypoint_idx) = descriptor;
+      observed_point_indices.push_back(point_idx);
+    }
+    const int num_keypoints = observed_point_indices.size();
+    keypoints.conservativeResize(Eigen::NoChange, num_keypoints);
+    descriptors.conservativeResize(Eigen::NoChange, num_keypoints);
+
+    pose_graph::VertexId vertex_id;
+    common::generateId(&vertex_id);
+    aslam::FrameId frame_id;
+    common::generateId(&frame_id);
+    const int64_t timestamp_nanoseconds =
+        start_timestamp_nanoseconds +
+        static_cast<int64_t>(vertex_idx) * vertex_period_nanoseconds;
+    vi_map::Vertex::UniquePtr vertex(
+        new vi_map::Vertex(
+            vertex_id, Eigen::Matrix<double, 6, 1>::Zero(), keypoints,
+            Eigen::VectorXd::Constant(
+                num_keypoints, options_.keypoint_noise_pixels),
+            descriptors, vi_map::LandmarkIdList(num_keypoints), mission_id,
+            frame_id, timestamp_nanoseconds, n_camera_));
+    const Eigen::Vector3d p_M_I(
+        x_meters + position_sigma * standard_normal(random_engine_),
+        position_sigma * standard_normal(random_engine_),
+        position_sigma * standard_normal(random_engine_));
+    const pose::Transformation T_M_I(q_G_I, p_M_I);
+    vertex->set_T_M_I(T_M_I);
+    vertex->set_v_M(v_M);
+    map->addVertex(std::move(vertex));
+
+    if (previous_vertex_id.isValid()) {
+      const Eigen::Matrix<int64_t, 1, Eigen::Dynamic> imu_timestamps =
+          Eigen::Matrix<double, 1, Eigen::Dynamic>::LinSpaced(
+              num_imu_measurements_per_edge, previous_timestamp_nanoseconds,
+              timestamp_nanoseconds)
+              .cast<int64_t>();
+      pose_graph::EdgeId edge_id;
+      common::generateId(&edge_id);
+      map->addEdge(
+          vi_map::Edge::UniquePtr(
+              new vi_map::ViwlsEdge(
+                  edge_id, previous_vertex_id, vertex_id, imu_timestamps,
+                  imu_data)));
+    } else {
+      map->getMission(mission_id).setRootVertexId(vertex_id);
+    }
+
+    // The first observer of a scene point stores its landmark.
+    const pose::Transformation T_I_M = T_M_I.inverse();
+    for (int keypoint_idx = 0; keypoint_idx < num_keypoints; ++keypoint_idx) {
+      const int64_t point_idx = observed_point_indices[keypoint_idx];
+      const std::unordered_map<int64_t, vi_map::LandmarkId>::const_iterator
+          it = point_landmark_ids.find(point_idx);
+      if (it != point_landmark_ids.end()) {
+        map->associateKeypointWithExistingLandmark(
+            vertex_id, 0u, keypoint_idx, it->second);
+      } else {
+        getScenePoint(point_idx, &p_G_fi, &descriptor);
+        vi_map::Landmark landmark;
+        vi_map::LandmarkId landmark_id;
+        common::generateId(&landmark_id);
+        landmark.setId(landmark_id);
+        landmark.set_p_B(T_I_M * p_G_fi);
+        map->addNewLandmark(landmark, vertex_id, 0u, keypoint_idx);
+        point_landmark_ids.emplace(point_idx, landmark_id);
+      }
+    }
+    num_observations_ += num_keypoints;
+
+    // Scene points behind the track window won't be observed again.
+    for (; first_active_point_index < begin_point_index;
+         ++first_active_point_index) {
+      point_landmark_ids.erase(first_active_point_index);
+    }
+    previous_vertex_id = vertex_id;
+    previous_timestamp_nanoseconds = timestamp_nanoseconds;
+  }
+}
+
+void SyntheticMapGenerator::getScenePoint(
+    const int64_t point_index, Eigen::Vector3d* p_G_fi,
+    aslam::VisualFrame::DescriptorsT* descriptor) const {
+  CHECK_NOTNULL(p_G_fi);
+  CHECK_NOTNULL(descriptor);
+  const uint64_t point_seed = splitMix64(
+      options_.seed ^ splitMix64(static_cast<uint64_t>(point_index)));
+  const double max_y_meters = kFieldOfViewMargin * min_point_depth_meters_ *
+                              0.5 * kImageWidth / kFocalLengthPixels;
+  const double max_z_meters = kFieldOfViewMargin * min_point_depth_meters_ *
+                              0.5 * kImageHeight / kFocalLengthPixels;
+  *p_G_fi << point_index * point_spacing_meters_,
+      max_y_meters * (2.0 * toUnitInterval(splitMix64(point_seed)) - 1.0),
+      max_z_meters * (2.0 * toUnitInterval(splitMix64(point_seed + 1u)) - 1.0);
+
+  descriptor->resize(kDescriptorSizeBytes, 1);
+  for (int word_idx = 0; word_idx < kDescriptorSizeBytes / 8; ++word_idx) {
+    const uint64_t word = splitMix64(point_seed + 2u + word_idx);
+    for (int byte_idx = 0; byte_idx < 8; ++byte_idx) {
+      (*descriptor)(8 * word_idx + byte_idx, 0) =
+          static_cast<unsigned char>(word >> (8 * byte_idx));
+    }
+  }
+}
+
+}  // namespace map_benchmark
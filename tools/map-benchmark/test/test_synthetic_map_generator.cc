@@ -0,0 +1,101 @@
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <maplab-common/test/testing-entrypoint.h>
+#include <vi-map/check-map-consistency.h>
+#include <vi-map/vi-map.h>
+
+#include "map-benchmark/benchmark-suite.h"
+#include "map-benchmark/synthetic-map-generator.h"
+
+namespace map_benchmark {
+
+class SyntheticMapGeneratorTest : public ::testing::Test {
+ protected:
+  SyntheticMapGeneratorTest()
+      : options_(SyntheticMapOptions::initFromGFlags()) {
+    options_.num_missions = 3u;
+    options_.num_vertices_per_mission = 30u;
+    options_.num_observations_per_vertex = 20u;
+    options_.landmark_track_length = 5u;
+  }
+
+  SyntheticMapOptions options_;
+};
+
+TEST_F(SyntheticMapGeneratorTest, GeneratesConsistentMap) {
+  SyntheticMapGenerator generator(options_);
+  vi_map::VIMap map;
+  generator.generateMap(&map);
+
+  ASSERT_EQ(map.numMissions(), options_.num_missions);
+  EXPECT_EQ(
+      map.numVertices(),
+      options_.num_missions * options_.num_vertices_per_mission);
+  EXPECT_TRUE(vi_map::checkMapConsistency(map));
+
+  vi_map::MissionIdList mission_ids;
+  map.getAllMissionIds(&mission_ids);
+  for (const vi_map::MissionId& mission_id : mission_ids) {
+    pose_graph::VertexIdList vertex_ids;
+    map.getAllVertexIdsInMission(mission_id, &vertex_ids);
+    EXPECT_EQ(vertex_ids.size(), options_.num_vertices_per_mission);
+  }
+
+  size_t num_observations = 0u;
+  map.forEachLandmark([&](const vi_map::Landmark& landmark) {
+    EXPECT_GE(landmark.numberOfObservations(), 1u);
+    EXPECT_LE(
+        landmark.numberOfObservations(), options_.landmark_track_length);
+    num_observations += landmark.numberOfObservations();
+  });
+  EXPECT_EQ(num_observations, generator.getNumObservations());
+  EXPECT_GT(num_observations, 0u);
+}
+
+TEST_F(SyntheticMapGeneratorTest, SameSeedGeneratesSameMap) {
+  SyntheticMapGenerator generator(options_);
+  vi_map::VIMap map;
+  generator.generateMap(&map);
+  SyntheticMapGenerator other_generator(options_);
+  vi_map::VIMap other_map;
+  other_generator.generateMap(&other_map);
+
+  EXPECT_EQ(map.numLandmarks(), other_map.numLandmarks());
+  EXPECT_EQ(
+      generator.getNumObservations(), other_generator.getNumObservations());
+}
+
+TEST_F(SyntheticMapGeneratorTest, BenchmarkSuiteReportsStages) {
+  BenchmarkSuite benchmark_suite(options_);
+  const std::vector<std::string> stage_names = {"landmark_iteration",
+                                                "consistency_check"};
+  benchmark_suite.run(stage_names);
+
+  // The map is always generated first.
+  const std::vector<BenchmarkStageResult>& results =
+      benchmark_suite.getResults();
+  ASSERT_EQ(results.size(), 3u);
+  EXPECT_EQ(results[0].name, "generate");
+  EXPECT_EQ(results[1].name, "landmark_iteration");
+  EXPECT_EQ(results[2].name, "consistency_check");
+  for (const BenchmarkStageResult& result : results) {
+    EXPECT_TRUE(result.success) << result.name;
+    EXPECT_GT(result.num_items, 0u) << result.name;
+    EXPECT_GT(result.peak_resident_set_size_bytes, 0u) << result.name;
+  }
+
+  std::ostringstream json;
+  benchmark_suite.writeJson(&json);
+  for (const BenchmarkStageResult& result : results) {
+    EXPECT_NE(
+        json.str().find("\"name\": \"" + result.name + "\""),
+        std::string::npos);
+  }
+}
+
+}  // namespace map_benchmark
+
+MAPLAB_UNITTEST_ENTRYPOINT
@@ -0,0 +1,16 @@
+#ifndef MAPLAB_MICROBENCHMARKS_BENCHMARK_MAP_H_
+#define MAPLAB_MICROBENCHMARKS_BENCHMARK_MAP_H_
+
+namespace vi_map {
+class VIMap;
+}  // namespace vi_map
+
+namespace maplab_microbenchmarks {
+
+// Returns a synthetic map of two overlapping missions with 500 vertices each,
+// generated from a fixed seed on the first call.
+const vi_map::VIMap& getBenchmarkMap();
+
+}  // namespace maplab_microbenchmarks
+
+#endif  // MAPLAB_MICROBENCHMARKS_BENCHMARK_MAP_H_
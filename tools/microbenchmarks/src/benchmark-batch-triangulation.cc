@@ -0,0 +1,101 @@
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/memory.h>
+#include <aslam/triangulation/triangulation.h>
+#include <benchmark/benchmark.h>
+#include <glog/logging.h>
+#include <landmark-triangulation/batch-triangulation.h>
+#include <vi-map/landmark-quality-metrics.h>
+
+namespace landmark_triangulation {
+namespace {
+Eigen::Vector3d randomVector(const double scale, std::mt19937* random_engine) {
+  std::uniform_real_distribution<double> distribution(-scale, scale);
+  return Eigen::Vector3d(
+      distribution(*random_engine), distribution(*random_engine),
+      distribution(*random_engine));
+}
+
+// Landmarks with 2 to 8 noisy observations from cameras around them.
+void generateBatch(const size_t num_landmarks, TriangulationBatch* batch) {
+  CHECK_NOTNULL(batch);
+  std::mt19937 random_engine(42u);
+  std::uniform_int_distribution<size_t> num_observations_distribution(2u, 8u);
+  std::vector<size_t> num_observations_per_landmark(num_landmarks);
+  for (size_t& num_observations : num_observations_per_landmark) {
+    num_observations = num_observations_distribution(random_engine);
+  }
+  batch->resize(num_observations_per_landmark);
+
+  constexpr double kLandmarkRange = 20.0;
+  constexpr double kObserverDistance = 5.0;
+  constexpr double kBearingNoise = 0.01;
+  for (size_t landmark_idx = 0u; landmark_idx < num_landmarks;
+       ++landmark_idx) {
+    const Eigen::Vector3d p_G_fi = randomVector(kLandmarkRange, &random_engine);
+    for (size_t i = batch->observation_offsets[landmark_idx];
+         i < batch->observation_offsets[landmark_idx + 1u]; ++i) {
+      batch->p_G_C[i] =
+          p_G_fi + randomVector(kObserverDistance, &random_engine);
+      const Eigen::Vector3d G_direction = p_G_fi - batch->p_G_C[i];
+      batch->G_optical_axes[i] = G_direction.normalized();
+      batch->G_bearing_vectors[i] =
+          G_direction +
+          G_direction.norm() * randomVector(kBearingNoise, &random_engine);
+    }
+  }
+}
+
+// Triangulation of every landmark with aslam::linearTriangulateFromNViews, as
+// done by the per-landmark retriangulation.
+void BM_TriangulatePerLandmark(benchmark::State& state) {
+  TriangulationBatch batch;
+  generateBatch(state.range(0), &batch);
+  const size_t num_landmarks = batch.numLandmarks();
+
+  Eigen::Vector3d p_G_fi;
+  while (state.KeepRunning()) {
+    for (size_t landmark_idx = 0u; landmark_idx < num_landmarks;
+         ++landmark_idx) {
+      const size_t begin = batch.observation_offsets[landmark_idx];
+      const size_t num_observations =
+          batch.observation_offsets[landmark_idx + 1u] - begin;
+      Eigen::Matrix3Xd G_bearing_vectors(3, num_observations);
+      Eigen::Matrix3Xd p_G_C(3, num_observations);
+      for (size_t i = 0u; i < num_observations; ++i) {
+        G_bearing_vectors.col(i) = batch.G_bearing_vectors[begin + i];
+        p_G_C.col(i) = batch.p_G_C[begin + i];
+      }
+      aslam::linearTriangulateFromNViews(G_bearing_vectors, p_G_C, &p_G_fi);
+      benchmark::DoNotOptimize(p_G_fi.data());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * num_landmarks);
+}
+BENCHMARK(BM_TriangulatePerLandmark)
+    ->Arg(50000)
+    ->Unit(benchmark::kMillisecond);
+
+// Batch triangulation including the quality scoring, with the given number of
+// landmarks and threads.
+void BM_TriangulateBatch(benchmark::State& state) {
+  TriangulationBatch batch;
+  generateBatch(state.range(0), &batch);
+  const size_t num_threads = state.range(1);
+  const vi_map::LandmarkWellConstrainedSettings settings;
+
+  TriangulationBatchResult result;
+  while (state.KeepRunning()) {
+    triangulateBatch(batch, settings, num_threads, &result);
+    benchmark::DoNotOptimize(result.p_G_fi.data());
+  }
+  state.SetItemsProcessed(state.iterations() * batch.numLandmarks());
+}
+BENCHMARK(BM_TriangulateBatch)
+    ->Args({50000, 1})
+    ->Args({50000, 4})
+    ->Unit(benchmark::kMillisecond);
+}  // namespace
+}  // namespace landmark_triangulation
@@ -0,0 +1,47 @@
+#include <random>
+
+#include <Eigen/Core>
+#include <benchmark/benchmark.h>
+#include <descriptor-projection/descriptor-projection.h>
+
+namespace descriptor_projection {
+namespace {
+constexpr int kDescriptorSizeBytes = 48;
+constexpr int kDescriptorSizeBits = 8 * kDescriptorSizeBytes;
+constexpr int kTargetDimensions = 10;
+
+// Projects a block of binary descriptors, as done for every keyframe that is
+// added to or queried against the loop closure database.
+void BM_ProjectDescriptorBlock(benchmark::State& state) {
+  const int num_descriptors = state.range(0);
+  std::mt19937 random_engine(42u);
+  std::uniform_int_distribution<int> byte_distribution(0, 255);
+  std::normal_distribution<float> normal_distribution(0.f, 1.f);
+
+  Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic> raw_descriptors(
+      kDescriptorSizeBytes, num_descriptors);
+  for (int i = 0; i < raw_descriptors.size(); ++i) {
+    raw_descriptors(i) =
+        static_cast<unsigned char>(byte_distribution(random_engine));
+  }
+  Eigen::MatrixXf projection_matrix(kDescriptorSizeBits, kDescriptorSizeBits);
+  for (int i = 0; i < projection_matrix.size(); ++i) {
+    projection_matrix(i) = normal_distribution(random_engine);
+  }
+
+  Eigen::MatrixXf projected_descriptors;
+  while (state.KeepRunning()) {
+    ProjectDescriptorBlock(
+        raw_descriptors, projection_matrix, kTargetDimensions,
+        &projected_descriptors);
+    benchmark::DoNotOptimize(projected_descriptors.data());
+  }
+  state.SetItemsProcessed(state.iterations() * num_descriptors);
+}
+BENCHMARK(BM_ProjectDescriptorBlock)
+    ->Arg(100)
+    ->Arg(1000)
+    ->Arg(10000)
+    ->Unit(benchmark::kMicrosecond);
+}  // namespace
+}  // namespace descriptor_projection
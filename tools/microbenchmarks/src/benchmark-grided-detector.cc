@@ -0,0 +1,124 @@
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <feature-tracking/feature-tracking-types.h>
+#include <feature-tracking/grided-detector.h>
+#include <feature-tracking/image-pyramid.h>
+#include <opencv2/core/core.hpp>
+#include <opencv2/core/types.hpp>
+#include <opencv2/features2d.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+namespace feature_tracking {
+namespace {
+constexpr size_t kImageWidth = 752u;
+constexpr size_t kImageHeight = 480u;
+// Default settings of the feature tracking.
+constexpr float kNonMaxSuppressionRadius = 8.0f;
+constexpr float kNonMaxSuppressionRatioThreshold = 0.9f;
+
+// Suppresses the non-maxima of the given number of uniformly distributed
+// keypoints with random responses.
+void BM_LocalNonMaximumSuppression(benchmark::State& state) {
+  const int num_keypoints = state.range(0);
+  std::mt19937 random_engine(42u);
+  std::uniform_real_distribution<float> x_distribution(0.f, kImageWidth);
+  std::uniform_real_distribution<float> y_distribution(0.f, kImageHeight);
+  std::uniform_real_distribution<float> response_distribution(0.f, 100.f);
+  std::vector<cv::KeyPoint> detected_keypoints;
+  detected_keypoints.reserve(num_keypoints);
+  for (int i = 0; i < num_keypoints; ++i) {
+    detected_keypoints.emplace_back(
+        x_distribution(random_engine), y_distribution(random_engine), 31.f,
+        -1.f, response_distribution(random_engine));
+  }
+
+  std::vector<cv::KeyPoint> keypoints;
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    keypoints = detected_keypoints;
+    state.ResumeTiming();
+    localNonMaximumSuppression(
+        kImageHeight, kNonMaxSuppressionRadius,
+        kNonMaxSuppressionRatioThreshold, &keypoints);
+    benchmark::DoNotOptimize(keypoints.data());
+  }
+  state.SetItemsProcessed(state.iterations() * num_keypoints);
+}
+BENCHMARK(BM_LocalNonMaximumSuppression)
+    ->Arg(500)
+    ->Arg(2000)
+    ->Arg(10000)
+    ->Unit(benchmark::kMicrosecond);
+
+// Grid layout of FeatureDetectorExtractor.
+constexpr size_t kNumGridCols = 3u;
+constexpr size_t kNumGridRows = 2u;
+
+// Blurred noise, which has corners at all scales.
+cv::Mat createTexturedImage(const int width, const int height) {
+  cv::Mat image(height, width, CV_8UC1);
+  cv::RNG random_number_generator(42u);
+  random_number_generator.fill(image, cv::RNG::UNIFORM, 0, 255);
+  cv::GaussianBlur(image, image, cv::Size(5, 5), 1.5);
+  return image;
+}
+
+// Grided detection of a frame at the resolution given by the arguments, with
+// the ORB detector building its own pyramid for every grid cell.
+void BM_GridedDetection(benchmark::State& state) {
+  const cv::Mat image = createTexturedImage(state.range(0), state.range(1));
+  const SweFeatureTrackingDetectorSettings settings;
+  const cv::Ptr<cv::FeatureDetector> detector = cv::ORB::create(
+      settings.orb_detector_number_features, settings.orb_detector_scale_factor,
+      settings.orb_detector_pyramid_levels, /*edgeThreshold=*/0,
+      settings.orb_detector_first_level, settings.orb_detector_WTA_K,
+      settings.orb_detector_score_type, settings.orb_detector_patch_size,
+      settings.orb_detector_fast_threshold);
+
+  std::vector<cv::KeyPoint> keypoints;
+  while (state.KeepRunning()) {
+    detectKeypointsGrided(
+        detector, image, /*detection_mask=*/cv::Mat(),
+        settings.max_feature_count, settings.detector_nonmaxsuppression_radius,
+        settings.detector_nonmaxsuppression_ratio_threshold, kNumGridCols,
+        kNumGridRows, &keypoints);
+    benchmark::DoNotOptimize(keypoints.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GridedDetection)
+    ->Args({752, 480})
+    ->Args({1280, 720})
+    ->Unit(benchmark::kMillisecond);
+
+// Same as BM_GridedDetection but with the image pyramid built once per frame
+// into reused buffers, as done by FeatureDetectorExtractor.
+void BM_GridedDetectionOnPyramidCache(benchmark::State& state) {
+  const cv::Mat image = createTexturedImage(state.range(0), state.range(1));
+  const SweFeatureTrackingDetectorSettings settings;
+  std::vector<cv::Ptr<cv::FeatureDetector>> level_detectors;
+  createPyramidLevelOrbDetectors(
+      settings, /*edge_threshold=*/0, &level_detectors);
+  ImagePyramid image_pyramid(
+      settings.orb_detector_pyramid_levels, settings.orb_detector_scale_factor);
+
+  std::vector<cv::KeyPoint> keypoints;
+  while (state.KeepRunning()) {
+    image_pyramid.build(image);
+    detectKeypointsGridedOnPyramid(
+        level_detectors, image_pyramid, /*detection_mask=*/cv::Mat(),
+        settings.max_feature_count, settings.detector_nonmaxsuppression_radius,
+        settings.detector_nonmaxsuppression_ratio_threshold, kNumGridCols,
+        kNumGridRows, &keypoints);
+    benchmark::DoNotOptimize(keypoints.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GridedDetectionOnPyramidCache)
+    ->Args({752, 480})
+    ->Args({1280, 720})
+    ->Unit(benchmark::kMillisecond);
+}  // namespace
+}  // namespace feature_tracking
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+#include <benchmark/benchmark.h>
+#include <descriptor-projection/descriptor-projection.h>
+#include <glog/logging.h>
+#include <inverted-multi-index/inverted-multi-index.h>
+#include <matching-based-loopclosure/hamming-index.h>
+#include <vocabulary-tree/hamming.h>
+
+namespace loop_closure {
+namespace {
+typedef hamming_index::HammingIndex::DescriptorMatrixType DescriptorMatrixType;
+
+// BRISK descriptors, searched with the default settings of the Hamming index.
+constexpr int kNumBits = 384;
+constexpr int kNumQueries = 1000;
+constexpr int kNumFlippedBits = 30;
+constexpr int kNumNeighbors = 3;
+constexpr int kMaxSubstringRadius = 1;
+constexpr int kMaxDistance = 70;
+
+// Random database descriptors and queries that are copies of the first
+// database descriptors with kNumFlippedBits distinct bits flipped. The nearest
+// neighbor of query i is database descriptor i.
+void generateDescriptors(
+    const int num_descriptors, DescriptorMatrixType* database,
+    DescriptorMatrixType* queries) {
+  CHECK_NOTNULL(database);
+  CHECK_NOTNULL(queries);
+  CHECK_GE(num_descriptors, kNumQueries);
+  std::mt19937 random_engine(42u);
+  std::uniform_int_distribution<int> byte_distribution(0, 255);
+  database->resize(kNumBits / 8, num_descriptors);
+  for (int i = 0; i < database->size(); ++i) {
+    (*database)(i) =
+        static_cast<unsigned char>(byte_distribution(random_engine));
+  }
+  *queries = database->leftCols(kNumQueries);
+  std::vector<int> bits(kNumBits);
+  for (int bit = 0; bit < kNumBits; ++bit) {
+    bits[bit] = bit;
+  }
+  for (int col = 0; col < kNumQueries; ++col) {
+    std::shuffle(bits.begin(), bits.end(), random_engine);
+    for (int i = 0; i < kNumFlippedBits; ++i) {
+      (*queries)(bits[i] / 8, col) ^= 1u << (bits[i] % 8);
+    }
+  }
+}
+
+// Fraction of the queries whose source descriptor is among the neighbors.
+template <typename Derived>
+double recall(const Eigen::MatrixBase<Derived>& indices) {
+  int num_found = 0;
+  for (int query_idx = 0; query_idx < indices.cols(); ++query_idx) {
+    num_found += (indices.col(query_idx).array() == query_idx).any() ? 1 : 0;
+  }
+  return static_cast<double>(num_found) / indices.cols();
+}
+
+// Queries against a Hamming index of the given number of descriptors.
+void BM_HammingIndexGetNNearestNeighbors(benchmark::State& state) {
+  DescriptorMatrixType database;
+  DescriptorMatrixType queries;
+  generateDescriptors(state.range(0), &database, &queries);
+  hamming_index::HammingIndex index(
+      kNumBits, kMaxSubstringRadius, kMaxDistance);
+  index.AddDescriptors(database);
+
+  Eigen::MatrixXi indices(kNumNeighbors, kNumQueries);
+  Eigen::MatrixXf distances(kNumNeighbors, kNumQueries);
+  while (state.KeepRunning()) {
+    index.GetNNearestNeighbors(queries, kNumNeighbors, &indices, &distances);
+    benchmark::DoNotOptimize(indices.data());
+  }
+  state.SetItemsProcessed(state.iterations() * kNumQueries);
+  state.counters["recall"] = recall(indices);
+}
+BENCHMARK(BM_HammingIndexGetNNearestNeighbors)
+    ->Arg(10000)
+    ->Arg(100000)
+    ->Unit(benchmark::kMillisecond);
+
+// Same queries with a linear search over all descriptors.
+void BM_HammingLinearSearch(benchmark::State& state) {
+  DescriptorMatrixType database;
+  DescriptorMatrixType queries;
+  generateDescriptors(state.range(0), &database, &queries);
+
+  Eigen::MatrixXi indices(kNumNeighbors, kNumQueries);
+  std::vector<std::pair<int, int>> candidates;
+  candidates.reserve(database.cols());
+  while (state.KeepRunning()) {
+    indices.setConstant(-1);
+    for (int query_idx = 0; query_idx < kNumQueries; ++query_idx) {
+      candidates.clear();
+      for (int i = 0; i < database.cols(); ++i) {
+        const int distance = HammingDistance(
+            database.col(i).data(), queries.col(query_idx).data(), kNumBits);
+        if (distance <= kMaxDistance) {
+          candidates.emplace_back(distance, i);
+        }
+      }
+      const int num_results = std::min<int>(kNumNeighbors, candidates.size());
+      std::partial_sort(
+          candidates.begin(), candidates.begin() + num_results,
+          candidates.end());
+      for (int i = 0; i < num_results; ++i) {
+        indices(i, query_idx) = candidates[i].second;
+      }
+    }
+    benchmark::DoNotOptimize(indices.data());
+  }
+  state.SetItemsProcessed(state.iterations() * kNumQueries);
+  state.counters["recall"] = recall(indices);
+}
+BENCHMARK(BM_HammingLinearSearch)
+    ->Arg(10000)
+    ->Arg(100000)
+    ->Unit(benchmark::kMillisecond);
+
+// Same queries with the inverted multi-index backend on projected
+// descriptors. The projection matrix and the words are random instead of
+// trained, such that the recall is a lower bound of the trained backend.
+void BM_InvertedMultiIndexOnProjectedDescriptors(benchmark::State& state) {
+  constexpr int kDimSubVectors = 5;
+  constexpr int kNumWordsPerSubspace = 100;
+  constexpr int kNumClosestWords = 10;
+  typedef inverted_multi_index::InvertedMultiIndex<kDimSubVectors> Index;
+
+  DescriptorMatrixType database;
+  DescriptorMatrixType queries;
+  generateDescriptors(state.range(0), &database, &queries);
+  std::mt19937 random_engine(42u);
+  std::normal_distribution<float> normal_distribution(0.f, 1.f);
+  Eigen::MatrixXf projection_matrix(kNumBits, kNumBits);
+  for (int i = 0; i < projection_matrix.size(); ++i) {
+    projection_matrix(i) = normal_distribution(random_engine);
+  }
+  Eigen::MatrixXf projected_database;
+  descriptor_projection::ProjectDescriptorBlock(
+      database, projection_matrix, 2 * kDimSubVectors, &projected_database);
+  Eigen::MatrixXf projected_queries;
+  descriptor_projection::ProjectDescriptorBlock(
+      queries, projection_matrix, 2 * kDimSubVectors, &projected_queries);
+
+  // The words are sampled from the projected database.
+  std::uniform_int_distribution<int> descriptor_distribution(
+      0, projected_database.cols() - 1);
+  Eigen::MatrixXf words_first_half(kDimSubVectors, kNumWordsPerSubspace);
+  Eigen::MatrixXf words_second_half(kDimSubVectors, kNumWordsPerSubspace);
+  for (int word = 0; word < kNumWordsPerSubspace; ++word) {
+    words_first_half.col(word) =
+        projected_database.col(descriptor_distribution(random_engine))
+            .head<kDimSubVectors>();
+    words_second_half.col(word) =
+        projected_database.col(descriptor_distribution(random_engine))
+            .tail<kDimSubVectors>();
+  }
+  Index index(words_first_half, words_second_half, kNumClosestWords);
+  index.AddDescriptors(projected_database);
+
+  Eigen::MatrixXi indices(kNumNeighbors, kNumQueries);
+  Eigen::MatrixXf distances(kNumNeighbors, kNumQueries);
+  while (state.KeepRunning()) {
+    for (int query_idx = 0; query_idx < kNumQueries; ++query_idx) {
+      const Eigen::Matrix<float, 2 * kDimSubVectors, 1> query =
+          projected_queries.col(query_idx);
+      index.GetNNearestNeighbors(
+          query, kNumNeighbors, indices.col(query_idx),
+          distances.col(query_idx));
+    }
+    benchmark::DoNotOptimize(indices.data());
+  }
+  state.SetItemsProcessed(state.iterations() * kNumQueries);
+  state.counters["recall"] = recall(indices);
+}
+BENCHMARK(BM_InvertedMultiIndexOnProjectedDescriptors)
+    ->Arg(10000)
+    ->Arg(100000)
+    ->Unit(benchmark::kMillisecond);
+}  // namespace
+}  // namespace loop_closure
@@ -0,0 +1,53 @@
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <benchmark/benchmark.h>
+#include <imu-integrator/imu-integrator.h>
+
+namespace imu_integrator {
+namespace {
+constexpr double kGravityMagnitude = 9.81;
+constexpr double kDeltaTimeSeconds = 0.005;
+
+// Integrates one IMU interval, as done for every measurement between two
+// keyframes by the inertial error term. The argument selects whether the
+// transition and covariance matrices are propagated.
+void BM_ImuIntegratorRK4Integrate(benchmark::State& state) {
+  const bool propagate_covariance = state.range(0) != 0;
+  const ImuIntegratorRK4 integrator(
+      1e-3, 1e-4, 1e-2, 1e-3, kGravityMagnitude);
+
+  Eigen::Matrix<double, kStateSize, 1> current_state;
+  current_state.setZero();
+  current_state.segment<kStateOrientationBlockSize>(kStateOrientationOffset) =
+      Eigen::Quaterniond(Eigen::AngleAxisd(0.3, Eigen::Vector3d::UnitZ()))
+          .coeffs();
+  current_state.segment<kVelocityBlockSize>(kStateVelocityOffset) << 1.0, 0.2,
+      0.0;
+  Eigen::Matrix<double, 2 * kImuReadingSize, 1> debiased_imu_readings;
+  debiased_imu_readings << 0.1, -0.2, kGravityMagnitude, 0.01, 0.02, 0.03, 0.2,
+      -0.1, kGravityMagnitude, 0.02, 0.01, 0.04;
+
+  Eigen::Matrix<double, kStateSize, 1> next_state;
+  Eigen::Matrix<double, kErrorStateSize, kErrorStateSize> next_phi;
+  Eigen::Matrix<double, kErrorStateSize, kErrorStateSize> next_cov;
+  while (state.KeepRunning()) {
+    if (propagate_covariance) {
+      integrator.integrate(
+          current_state, debiased_imu_readings, kDeltaTimeSeconds,
+          &next_state, &next_phi, &next_cov);
+      benchmark::DoNotOptimize(next_cov.data());
+    } else {
+      integrator.integrateStateOnly(
+          current_state, debiased_imu_readings, kDeltaTimeSeconds,
+          &next_state);
+    }
+    benchmark::DoNotOptimize(next_state.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ImuIntegratorRK4Integrate)
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kNanosecond);
+}  // namespace
+}  // namespace imu_integrator
@@ -0,0 +1,63 @@
+#include <random>
+
+#include <Eigen/Core>
+#include <benchmark/benchmark.h>
+#include <glog/logging.h>
+#include <inverted-multi-index/inverted-multi-index.h>
+
+namespace loop_closure {
+namespace inverted_multi_index {
+namespace {
+// Same subspace dimensionality as used by the loop closure engine.
+constexpr int kDimSubVectors = 5;
+constexpr int kNumWordsPerSubspace = 100;
+constexpr int kNumClosestWords = 10;
+constexpr int kNumNeighbors = 10;
+constexpr int kNumQueries = 1000;
+
+typedef InvertedMultiIndex<kDimSubVectors> Index;
+
+Eigen::MatrixXf randomMatrix(
+    const int rows, const int cols, std::mt19937* random_engine) {
+  CHECK_NOTNULL(random_engine);
+  std::normal_distribution<float> distribution(0.f, 1.f);
+  Eigen::MatrixXf matrix(rows, cols);
+  for (int i = 0; i < matrix.size(); ++i) {
+    matrix(i) = distribution(*random_engine);
+  }
+  return matrix;
+}
+
+// Nearest neighbor queries against a database of the given number of
+// projected descriptors.
+void BM_InvertedMultiIndexGetNNearestNeighbors(benchmark::State& state) {
+  const int num_database_descriptors = state.range(0);
+  std::mt19937 random_engine(42u);
+  Index index(
+      randomMatrix(kDimSubVectors, kNumWordsPerSubspace, &random_engine),
+      randomMatrix(kDimSubVectors, kNumWordsPerSubspace, &random_engine),
+      kNumClosestWords);
+  index.AddDescriptors(
+      randomMatrix(
+          2 * kDimSubVectors, num_database_descriptors, &random_engine));
+  const Index::DescriptorMatrixType queries =
+      randomMatrix(2 * kDimSubVectors, kNumQueries, &random_engine);
+
+  Eigen::VectorXi indices(kNumNeighbors, 1);
+  Eigen::VectorXf distances(kNumNeighbors, 1);
+  int query_idx = 0;
+  while (state.KeepRunning()) {
+    index.GetNNearestNeighbors(
+        queries.col(query_idx), kNumNeighbors, indices, distances);
+    benchmark::DoNotOptimize(indices.data());
+    query_idx = (query_idx + 1) % kNumQueries;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_InvertedMultiIndexGetNNearestNeighbors)
+    ->Arg(10000)
+    ->Arg(100000)
+    ->Unit(benchmark::kMicrosecond);
+}  // namespace
+}  // namespace inverted_multi_index
+}  // namespace loop_closure
@@ -0,0 +1,50 @@
+#include <benchmark/benchmark.h>
+#include <localization-summary-map/localization-summary-map-creation.h>
+#include <localization-summary-map/localization-summary-map.h>
+#include <loop-closure-handler/loop-detector-node.h>
+#include <vi-map/vi-map.h>
+
+#include "maplab-microbenchmarks/benchmark-map.h"
+
+namespace loop_detector_node {
+namespace {
+// Startup of the localization database from a summary map of the benchmark
+// map. With a non-zero argument, the visual words are precomputed and stored
+// in the summary map, as done when saving summary maps with
+// --lc_precompute_summary_map_word_indices.
+void BM_LocalizationDatabaseStartup(benchmark::State& state) {
+  const bool use_precomputed_word_indices = state.range(0) != 0;
+  const vi_map::VIMap& map = maplab_microbenchmarks::getBenchmarkMap();
+  vi_map::LandmarkIdList landmark_ids;
+  map.getAllLandmarkIds(&landmark_ids);
+  summary_map::LocalizationSummaryMap summary_map;
+  summary_map::createLocalizationSummaryMapFromLandmarkList(
+      map, landmark_ids, &summary_map);
+  if (use_precomputed_word_indices) {
+    const LoopDetectorNode loop_detector;
+    if (!loop_detector.computeLocalizationSummaryMapWordIndices(
+            &summary_map)) {
+      state.SkipWithError("The loop closure backend has no visual words.");
+      return;
+    }
+  }
+
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    LoopDetectorNode loop_detector;
+    state.ResumeTiming();
+    if (!loop_detector.addLocalizationSummaryMapToDatabase(summary_map)) {
+      state.SkipWithError("The loop closure backend can't use summary maps.");
+      return;
+    }
+    benchmark::DoNotOptimize(&loop_detector);
+  }
+  state.SetItemsProcessed(
+      state.iterations() * summary_map.numObservations());
+}
+BENCHMARK(BM_LocalizationDatabaseStartup)
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMillisecond);
+}  // namespace
+}  // namespace loop_detector_node
@@ -0,0 +1,64 @@
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <glog/logging.h>
+#include <maplab-common/map-manager-config.h>
+#include <vi-map/vi-map-serialization.h>
+#include <vi-map/vi-map.h>
+#include <vi-map/vi_map.pb.h>
+
+#include "maplab-microbenchmarks/benchmark-map.h"
+
+namespace vi_map {
+namespace serialization {
+namespace {
+size_t serializeBenchmarkMap(std::vector<std::string>* serialized_protos) {
+  CHECK_NOTNULL(serialized_protos)->clear();
+  std::vector<proto::VIMap> protos;
+  serializeToListOfProtos(
+      maplab_microbenchmarks::getBenchmarkMap(), backend::SaveConfig(),
+      &protos);
+  size_t num_bytes = 0u;
+  serialized_protos->resize(protos.size());
+  for (size_t proto_idx = 0u; proto_idx < protos.size(); ++proto_idx) {
+    CHECK(protos[proto_idx].SerializeToString(
+        &(*serialized_protos)[proto_idx]));
+    num_bytes += (*serialized_protos)[proto_idx].size();
+  }
+  return num_bytes;
+}
+
+// Serializes the benchmark map to protos and the protos to bytes, as done when
+// saving a map.
+void BM_MapSerialization(benchmark::State& state) {
+  maplab_microbenchmarks::getBenchmarkMap();
+  std::vector<std::string> serialized_protos;
+  size_t num_bytes = 0u;
+  while (state.KeepRunning()) {
+    num_bytes = serializeBenchmarkMap(&serialized_protos);
+  }
+  state.SetBytesProcessed(state.iterations() * num_bytes);
+}
+BENCHMARK(BM_MapSerialization)->Unit(benchmark::kMillisecond);
+
+// Parses the bytes of the serialized benchmark map and deserializes the map
+// from the protos, as done when loading a map.
+void BM_MapDeserialization(benchmark::State& state) {
+  std::vector<std::string> serialized_protos;
+  const size_t num_bytes = serializeBenchmarkMap(&serialized_protos);
+  while (state.KeepRunning()) {
+    std::vector<proto::VIMap> protos(serialized_protos.size());
+    for (size_t proto_idx = 0u; proto_idx < protos.size(); ++proto_idx) {
+      CHECK(protos[proto_idx].ParseFromString(serialized_protos[proto_idx]));
+    }
+    VIMap map;
+    deserializeFromListOfProtos(protos, &map);
+    benchmark::DoNotOptimize(map.numVertices());
+  }
+  state.SetBytesProcessed(state.iterations() * num_bytes);
+}
+BENCHMARK(BM_MapDeserialization)->Unit(benchmark::kMillisecond);
+}  // namespace
+}  // namespace serialization
+}  // namespace vi_map
@@ -0,0 +1,36 @@
+#include "maplab-microbenchmarks/benchmark-map.h"
+
+#include <memory>
+
+#include <map-benchmark/synthetic-map-generator.h>
+#include <vi-map/vi-map.h>
+
+namespace maplab_microbenchmarks {
+
+const vi_map::VIMap& getBenchmarkMap() {
+  static std::unique_ptr<vi_map::VIMap> map;
+  if (!map) {
+    // All options are set explicitly, such that the map doesn't depend on the
+    // map benchmark flags.
+    map_benchmark::SyntheticMapOptions options =
+        map_benchmark::SyntheticMapOptions::initFromGFlags();
+    options.num_missions = 2u;
+    options.num_vertices_per_mission = 500u;
+    options.num_observations_per_vertex = 100u;
+    options.landmark_track_length = 10u;
+    options.mission_overlap = 0.5;
+    options.vertex_spacing_meters = 0.5;
+    options.speed_meters_per_second = 1.0;
+    options.imu_rate_hz = 20.0;
+    options.keypoint_noise_pixels = 0.8;
+    options.descriptor_noise_bits = 10;
+    options.vertex_position_noise_meters = 0.02;
+    options.seed = 42u;
+    map_benchmark::SyntheticMapGenerator generator(options);
+    map.reset(new vi_map::VIMap);
+    generator.generateMap(map.get());
+  }
+  return *map;
+}
+
+}  // namespace maplab_microbenchmarks
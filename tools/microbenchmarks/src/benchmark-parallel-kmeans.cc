@@ -0,0 +1,91 @@
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+#include <aslam/common/memory.h>
+#include <benchmark/benchmark.h>
+#include <vocabulary-tree/distance.h>
+#include <vocabulary-tree/parallel-kmeans.h>
+#include <vocabulary-tree/simple-kmeans.h>
+
+namespace loop_closure {
+namespace {
+typedef Eigen::Matrix<float, Eigen::Dynamic, 1> DescriptorType;
+typedef Aligned<std::vector, DescriptorType> DescriptorVector;
+
+constexpr int kDescriptorDimensionality = 10;
+constexpr size_t kNumCenters = 256u;
+constexpr size_t kMaxIterations = 20u;
+
+// Descriptors scattered around 100 random cluster centers.
+Eigen::MatrixXf generateDescriptors(const int num_descriptors) {
+  constexpr int kNumClusters = 100;
+  std::mt19937 random_engine(42u);
+  std::uniform_real_distribution<float> center_distribution(-10.f, 10.f);
+  std::normal_distribution<float> noise_distribution(0.f, 1.f);
+  Eigen::MatrixXf cluster_centers(kDescriptorDimensionality, kNumClusters);
+  for (int i = 0; i < cluster_centers.size(); ++i) {
+    cluster_centers(i) = center_distribution(random_engine);
+  }
+  Eigen::MatrixXf descriptors(kDescriptorDimensionality, num_descriptors);
+  for (int col = 0; col < num_descriptors; ++col) {
+    for (int row = 0; row < kDescriptorDimensionality; ++row) {
+      descriptors(row, col) = cluster_centers(row, col % kNumClusters) +
+                              noise_distribution(random_engine);
+    }
+  }
+  return descriptors;
+}
+
+// Training of kNumCenters centers with SimpleKmeans on the given number of
+// descriptors.
+void BM_SimpleKmeans(benchmark::State& state) {
+  const Eigen::MatrixXf descriptors = generateDescriptors(state.range(0));
+  DescriptorVector descriptor_vector(descriptors.cols());
+  for (int i = 0; i < descriptors.cols(); ++i) {
+    descriptor_vector[i] = descriptors.col(i);
+  }
+  DescriptorType descriptor_zero;
+  descriptor_zero.setZero(kDescriptorDimensionality, 1);
+  SimpleKmeans<DescriptorType, distance::L2<DescriptorType> > simple_kmeans(
+      descriptor_zero);
+  simple_kmeans.SetMaxIterations(kMaxIterations);
+
+  std::vector<unsigned int> membership;
+  double sse = 0.0;
+  while (state.KeepRunning()) {
+    std::shared_ptr<DescriptorVector> centers =
+        aligned_shared<DescriptorVector>();
+    sse = simple_kmeans.Cluster(
+        descriptor_vector, kNumCenters, 42, &membership, &centers);
+  }
+  state.counters["sse"] = sse;
+}
+BENCHMARK(BM_SimpleKmeans)->Arg(50000)->Unit(benchmark::kMillisecond);
+
+// Same with ParallelKmeans. The second argument is the mini-batch size, zero
+// for full iterations. Mini-batch runs are given five times the iterations.
+void BM_ParallelKmeans(benchmark::State& state) {
+  const Eigen::MatrixXf descriptors = generateDescriptors(state.range(0));
+  ParallelKmeansSettings settings;
+  settings.mini_batch_size = state.range(1);
+  settings.max_iterations =
+      settings.mini_batch_size > 0u ? 5u * kMaxIterations : kMaxIterations;
+  const ParallelKmeans parallel_kmeans(settings);
+
+  Eigen::MatrixXf centers;
+  std::vector<unsigned int> membership;
+  double sse = 0.0;
+  while (state.KeepRunning()) {
+    sse = parallel_kmeans.Cluster(
+        descriptors, kNumCenters, &centers, &membership);
+  }
+  state.counters["sse"] = sse;
+}
+BENCHMARK(BM_ParallelKmeans)
+    ->Args({50000, 0})
+    ->Args({50000, 10 * kNumCenters})
+    ->Unit(benchmark::kMillisecond);
+}  // namespace
+}  // namespace loop_closure
@@ -0,0 +1,44 @@
+#include <unordered_set>
+
+#include <Eigen/Core>
+#include <benchmark/benchmark.h>
+#include <glog/logging.h>
+#include <vi-map-helpers/spatial-database.h>
+#include <vi-map/vi-map.h>
+
+#include "maplab-microbenchmarks/benchmark-map.h"
+
+namespace vi_map_helpers {
+namespace {
+// Radius queries at the vertex positions of the benchmark map, in a database
+// of all landmarks. The argument is the radius in meters.
+void BM_SpatialDatabaseGetObjectIdsInRadius(benchmark::State& state) {
+  const double radius_meters = state.range(0);
+  const vi_map::VIMap& map = maplab_microbenchmarks::getBenchmarkMap();
+  const SpatialDatabase<vi_map::LandmarkId> spatial_database(
+      map, Eigen::Vector3d(2.0, 2.0, 2.0));
+
+  pose_graph::VertexIdList vertex_ids;
+  map.getAllVertexIds(&vertex_ids);
+  CHECK(!vertex_ids.empty());
+
+  std::unordered_set<vi_map::LandmarkId> neighbors;
+  size_t num_neighbors = 0u;
+  size_t vertex_idx = 0u;
+  while (state.KeepRunning()) {
+    spatial_database.getObjectIdsInRadius(
+        map.getVertex_G_p_I(vertex_ids[vertex_idx]), radius_meters,
+        &neighbors);
+    num_neighbors += neighbors.size();
+    vertex_idx = (vertex_idx + 1u) % vertex_ids.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["neighbors"] = benchmark::Counter(
+      num_neighbors, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_SpatialDatabaseGetObjectIdsInRadius)
+    ->Arg(5)
+    ->Arg(10)
+    ->Unit(benchmark::kMicrosecond);
+}  // namespace
+}  // namespace vi_map_helpers
@@ -0,0 +1,76 @@
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+#include <benchmark/benchmark.h>
+#include <glog/logging.h>
+#include <maplab-common/temporal-buffer.h>
+#include <vio-common/vio-types.h>
+
+namespace common {
+namespace {
+// IMU buffers are the most frequently used temporal buffers.
+constexpr int64_t kImuPeriodNanoseconds = 5000000;
+typedef std::pair<const int64_t, vio::ImuMeasurement> BufferElement;
+typedef Eigen::aligned_allocator<BufferElement> BufferAllocator;
+typedef TemporalBuffer<vio::ImuMeasurement, BufferAllocator> ImuBuffer;
+
+vio::ImuMeasurement imuMeasurement(const int64_t timestamp_ns) {
+  vio::ImuData imu_data;
+  imu_data << 0.0, 0.0, 9.81, 0.01, 0.02, 0.03;
+  return vio::ImuMeasurement(timestamp_ns, imu_data);
+}
+
+void fillBuffer(const int num_measurements, ImuBuffer* buffer) {
+  CHECK_NOTNULL(buffer);
+  for (int i = 0; i < num_measurements; ++i) {
+    const int64_t timestamp_ns = i * kImuPeriodNanoseconds;
+    buffer->addValue(timestamp_ns, imuMeasurement(timestamp_ns));
+  }
+}
+
+// Appends measurements in temporal order to a buffer of the given length.
+void BM_TemporalBufferInsert(benchmark::State& state) {
+  const int num_measurements = state.range(0);
+  while (state.KeepRunning()) {
+    ImuBuffer buffer;
+    fillBuffer(num_measurements, &buffer);
+    benchmark::DoNotOptimize(buffer.size());
+  }
+  state.SetItemsProcessed(state.iterations() * num_measurements);
+}
+BENCHMARK(BM_TemporalBufferInsert)
+    ->Arg(1000)
+    ->Arg(100000)
+    ->Unit(benchmark::kMicrosecond);
+
+// Queries the measurements between two keyframes, i.e. 20 measurements, in a
+// buffer of the given length.
+void BM_TemporalBufferGetValuesBetweenTimes(benchmark::State& state) {
+  constexpr int kNumMeasurementsPerQuery = 20;
+  const int num_measurements = state.range(0);
+  CHECK_GT(num_measurements, kNumMeasurementsPerQuery);
+  ImuBuffer buffer;
+  fillBuffer(num_measurements, &buffer);
+
+  std::vector<vio::ImuMeasurement,
+              Eigen::aligned_allocator<vio::ImuMeasurement>>
+      values;
+  int64_t query_start_index = 0;
+  while (state.KeepRunning()) {
+    buffer.getValuesBetweenTimes(
+        query_start_index * kImuPeriodNanoseconds,
+        (query_start_index + kNumMeasurementsPerQuery) * kImuPeriodNanoseconds,
+        &values);
+    benchmark::DoNotOptimize(values.data());
+    query_start_index = (query_start_index + kNumMeasurementsPerQuery) %
+                        (num_measurements - kNumMeasurementsPerQuery);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TemporalBufferGetValuesBetweenTimes)
+    ->Arg(1000)
+    ->Arg(100000)
+    ->Unit(benchmark::kNanosecond);
+}  // namespace
+}  // namespace common
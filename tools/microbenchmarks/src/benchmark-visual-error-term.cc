@@ -0,0 +1,110 @@
+#include <memory>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <aslam/cameras/camera-pinhole.h>
+#include <aslam/cameras/distortion-radtan.h>
+#include <benchmark/benchmark.h>
+#include <ceres-error-terms/visual-error-term.h>
+
+namespace ceres_error_terms {
+namespace {
+typedef aslam::PinholeCamera CameraType;
+typedef aslam::RadTanDistortion DistortionType;
+typedef VisualReprojectionError<CameraType, DistortionType> ErrorTerm;
+
+constexpr int kNumIntrinsics = CameraType::parameterCount();
+constexpr int kNumDistortionParameters = DistortionType::parameterCount();
+
+// Evaluates the visual reprojection error of an observation of a landmark of
+// another mission, the most expensive variant of the error term. This is done
+// for every observation in every iteration of the bundle adjustment. The
+// argument selects whether the jacobians are evaluated.
+void BM_VisualReprojectionErrorEvaluate(benchmark::State& state) {
+  const bool evaluate_jacobians = state.range(0) != 0;
+
+  Eigen::VectorXd distortion_parameters(kNumDistortionParameters);
+  distortion_parameters << -0.28, 0.07, 1e-4, -2e-5;
+  aslam::Distortion::UniquePtr distortion(
+      new DistortionType(distortion_parameters));
+  Eigen::VectorXd intrinsics(kNumIntrinsics);
+  intrinsics << 460.0, 458.0, 367.0, 248.0;
+  std::unique_ptr<CameraType> camera(
+      new CameraType(intrinsics, 752u, 480u, distortion));
+
+  const ErrorTerm error_term(
+      Eigen::Vector2d(400.0, 260.0), 0.8, visual::VisualErrorType::kGlobal,
+      camera.get());
+
+  // Ordering of the poses is [orientation position] -> [xyzw xyz].
+  Eigen::Vector3d landmark_position(0.5, -0.2, 4.0);
+  Eigen::Matrix<double, 7, 1> landmark_base_pose;
+  landmark_base_pose << Eigen::Quaterniond(
+                            Eigen::AngleAxisd(0.2, Eigen::Vector3d::UnitY()))
+                            .coeffs(),
+      0.1, 0.0, 0.2;
+  Eigen::Matrix<double, 7, 1> landmark_mission_base_pose;
+  landmark_mission_base_pose << 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0;
+  Eigen::Matrix<double, 7, 1> imu_mission_base_pose =
+      landmark_mission_base_pose;
+  Eigen::Matrix<double, 7, 1> imu_pose;
+  imu_pose << Eigen::Quaterniond(
+                  Eigen::AngleAxisd(-0.1, Eigen::Vector3d::UnitX()))
+                  .coeffs(),
+      0.3, 0.1, -0.2;
+  Eigen::Vector4d q_C_I(0.0, 0.0, 0.0, 1.0);
+  Eigen::Vector3d p_C_I(0.02, -0.01, 0.0);
+
+  const double* parameters[] = {landmark_position.data(),
+                                landmark_base_pose.data(),
+                                landmark_mission_base_pose.data(),
+                                imu_mission_base_pose.data(),
+                                imu_pose.data(),
+                                q_C_I.data(),
+                                p_C_I.data(),
+                                camera->getParametersMutable(),
+                                camera->getDistortionMutable()
+                                    ->getParametersMutable()};
+
+  Eigen::Vector2d residuals;
+  Eigen::Matrix<double, visual::kResidualSize, visual::kPositionBlockSize,
+                Eigen::RowMajor>
+      J_landmark_position, J_p_C_I;
+  Eigen::Matrix<double, visual::kResidualSize, visual::kPoseBlockSize,
+                Eigen::RowMajor>
+      J_landmark_base_pose, J_landmark_mission_base_pose,
+      J_imu_mission_base_pose, J_imu_pose;
+  Eigen::Matrix<double, visual::kResidualSize, visual::kOrientationBlockSize,
+                Eigen::RowMajor>
+      J_q_C_I;
+  Eigen::Matrix<double, visual::kResidualSize, kNumIntrinsics,
+                Eigen::RowMajor>
+      J_intrinsics;
+  Eigen::Matrix<double, visual::kResidualSize, kNumDistortionParameters,
+                Eigen::RowMajor>
+      J_distortion;
+  double* jacobians[] = {J_landmark_position.data(),
+                         J_landmark_base_pose.data(),
+                         J_landmark_mission_base_pose.data(),
+                         J_imu_mission_base_pose.data(),
+                         J_imu_pose.data(),
+                         J_q_C_I.data(),
+                         J_p_C_I.data(),
+                         J_intrinsics.data(),
+                         J_distortion.data()};
+
+  while (state.KeepRunning()) {
+    const bool success = error_term.Evaluate(
+        parameters, residuals.data(),
+        evaluate_jacobians ? jacobians : nullptr);
+    benchmark::DoNotOptimize(success);
+    benchmark::DoNotOptimize(residuals.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_VisualReprojectionErrorEvaluate)
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kNanosecond);
+}  // namespace
+}  // namespace ceres_error_terms
@@ -0,0 +1,18 @@
+#include <benchmark/benchmark.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+// All inputs of the microbenchmarks are synthetic and generated from fixed
+// seeds, such that the results are comparable across commits.
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  // Consumes the benchmark arguments, e.g. --benchmark_filter, before gflags
+  // parses the remaining ones.
+  benchmark::Initialize(&argc, argv);
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InstallFailureSignalHandler();
+  FLAGS_alsologtostderr = true;
+
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}